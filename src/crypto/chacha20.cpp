@@ -32,6 +32,7 @@
 
 #include <iostream>
 #include <stdlib.h>
+#include <vector>
 
 #include "crypto/chacha20.h"
 #include "util/rsprint.h"
@@ -48,6 +49,15 @@
     #define AEAD_chacha20_poly1305_rs AEAD_chacha20_poly1305
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define CHACHA20_X86_SIMD
+    #include <immintrin.h>
+#endif
+
+#ifdef __SIZEOF_INT128__
+    #define POLY1305_64BITS_LIMBS
+#endif
+
 namespace librs {
 namespace crypto {
 
@@ -361,9 +371,20 @@ static void print(const chacha20_state& s)
 }
 #endif
 
-void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+typedef void (*chacha20_encrypt_fn)(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size) ;
+
+static inline void store_le32(uint8_t *p,uint32_t v)
+{
+    p[0] = v & 0xff ; p[1] = (v >> 8) & 0xff ; p[2] = (v >> 16) & 0xff ; p[3] = (v >> 24) & 0xff ;
+}
+
+// Portable backend: one 64 bytes block at a time. Full blocks are xored 8 bytes at a time.
+//
+static void chacha20_encrypt_scalar(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
 {
-    for(uint32_t i=0;i<size/64 + 1;++i)
+    uint8_t keystream[64] ;
+
+    for(uint32_t i=0;64*i < size;++i)
     {
         chacha20_state s(key,block_counter+i,nonce) ;
 
@@ -377,13 +398,210 @@ void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[
         fprintf(stdout,"Cipher %d:\n",i) ;
         print(s) ;
 #endif
+        for(uint32_t k=0;k<16;++k)
+            store_le32(keystream + 4*k,s.c[k]) ;
 
-        for(uint32_t k=0;k<64;++k)
-            if(k+64*i < size)
-                data[k + 64*i] ^= uint8_t(((s.c[k/4]) >> (8*(k%4))) & 0xff) ;
+        uint8_t *block = data + 64*i ;
+
+        if(size - 64*i >= 64)
+            for(uint32_t k=0;k<64;k+=8)
+            {
+                uint64_t d,ks ;
+                memcpy(&d,block+k,8) ;
+                memcpy(&ks,keystream+k,8) ;
+                d ^= ks ;
+                memcpy(block+k,&d,8) ;
+            }
+        else
+            for(uint32_t k=0;k<size - 64*i;++k)
+                block[k] ^= keystream[k] ;
     }
 }
 
+#ifdef CHACHA20_X86_SIMD
+// The SIMD backends compute 4 (resp. 8) consecutive blocks in parallel: each vector register holds the same
+// state word for all blocks, so that the rounds are the scalar ones applied lane-wise. The keystream is then
+// transposed back into per-block order before being xored to the data. Tails are handed to the narrower backend.
+
+#define CHACHA20_SSE2_ROTL(v,n) _mm_or_si128(_mm_slli_epi32(v,n),_mm_srli_epi32(v,32-(n)))
+
+#define CHACHA20_SSE2_QR(a,b,c,d) { \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_SSE2_ROTL(d,16) ; \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_SSE2_ROTL(b,12) ; \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_SSE2_ROTL(d, 8) ; \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_SSE2_ROTL(b, 7) ; }
+
+__attribute__((target("sse2")))
+static void chacha20_encrypt_sse2(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    chacha20_state s(key,block_counter,nonce) ;
+
+    for(;size >= 4*64;size -= 4*64,data += 4*64,s.c[12] += 4)
+    {
+        __m128i x[16],o[16] ;
+
+        for(uint32_t k=0;k<16;++k)
+            o[k] = _mm_set1_epi32(s.c[k]) ;
+
+        o[12] = _mm_add_epi32(o[12],_mm_set_epi32(3,2,1,0)) ;
+
+        for(uint32_t k=0;k<16;++k)
+            x[k] = o[k] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_SSE2_QR(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_SSE2_QR(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_SSE2_QR(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_SSE2_QR(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_SSE2_QR(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_SSE2_QR(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_SSE2_QR(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_SSE2_QR(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        for(uint32_t k=0;k<16;++k)
+            x[k] = _mm_add_epi32(x[k],o[k]) ;
+
+        // Transpose each group of 4 words so that r[b] holds 16 consecutive keystream bytes of block b.
+
+        for(uint32_t g=0;g<4;++g)
+        {
+            __m128i t0 = _mm_unpacklo_epi32(x[4*g+0],x[4*g+1]) ;
+            __m128i t1 = _mm_unpacklo_epi32(x[4*g+2],x[4*g+3]) ;
+            __m128i t2 = _mm_unpackhi_epi32(x[4*g+0],x[4*g+1]) ;
+            __m128i t3 = _mm_unpackhi_epi32(x[4*g+2],x[4*g+3]) ;
+
+            __m128i r[4] = { _mm_unpacklo_epi64(t0,t1), _mm_unpackhi_epi64(t0,t1), _mm_unpacklo_epi64(t2,t3), _mm_unpackhi_epi64(t2,t3) } ;
+
+            for(uint32_t b=0;b<4;++b)
+            {
+                __m128i *p = (__m128i*)(data + 64*b + 16*g) ;
+                _mm_storeu_si128(p,_mm_xor_si128(_mm_loadu_si128(p),r[b])) ;
+            }
+        }
+    }
+
+    chacha20_encrypt_scalar(key,s.c[12],nonce,data,size) ;
+}
+
+#define CHACHA20_AVX2_ROTL(v,n) _mm256_or_si256(_mm256_slli_epi32(v,n),_mm256_srli_epi32(v,32-(n)))
+
+#define CHACHA20_AVX2_QR(a,b,c,d) { \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = _mm256_shuffle_epi8(d,rot16) ; \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_AVX2_ROTL(b,12) ;    \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = _mm256_shuffle_epi8(d,rot8) ;  \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_AVX2_ROTL(b, 7) ; }
+
+__attribute__((target("avx2")))
+static void chacha20_encrypt_avx2(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    chacha20_state s(key,block_counter,nonce) ;
+
+    // byte shuffles for the 16 and 8 bits rotations, which are cheaper than shift+or.
+
+    const __m256i rot16 = _mm256_setr_epi8(2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13, 2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13) ;
+    const __m256i rot8  = _mm256_setr_epi8(3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14, 3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14) ;
+
+    for(;size >= 8*64;size -= 8*64,data += 8*64,s.c[12] += 8)
+    {
+        __m256i x[16],o[16] ;
+
+        for(uint32_t k=0;k<16;++k)
+            o[k] = _mm256_set1_epi32(s.c[k]) ;
+
+        o[12] = _mm256_add_epi32(o[12],_mm256_setr_epi32(0,1,2,3,4,5,6,7)) ;
+
+        for(uint32_t k=0;k<16;++k)
+            x[k] = o[k] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_AVX2_QR(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_AVX2_QR(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_AVX2_QR(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_AVX2_QR(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_AVX2_QR(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_AVX2_QR(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_AVX2_QR(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_AVX2_QR(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        for(uint32_t k=0;k<16;++k)
+            x[k] = _mm256_add_epi32(x[k],o[k]) ;
+
+        // Unpacks work within 128 bits lanes, so after the 4x4 transpose r[b][g] holds words 4g..4g+3 of
+        // block b in its low lane and of block b+4 in its high lane.
+
+        __m256i r[4][4] ;
+
+        for(uint32_t g=0;g<4;++g)
+        {
+            __m256i t0 = _mm256_unpacklo_epi32(x[4*g+0],x[4*g+1]) ;
+            __m256i t1 = _mm256_unpacklo_epi32(x[4*g+2],x[4*g+3]) ;
+            __m256i t2 = _mm256_unpackhi_epi32(x[4*g+0],x[4*g+1]) ;
+            __m256i t3 = _mm256_unpackhi_epi32(x[4*g+2],x[4*g+3]) ;
+
+            r[0][g] = _mm256_unpacklo_epi64(t0,t1) ;
+            r[1][g] = _mm256_unpackhi_epi64(t0,t1) ;
+            r[2][g] = _mm256_unpacklo_epi64(t2,t3) ;
+            r[3][g] = _mm256_unpackhi_epi64(t2,t3) ;
+        }
+
+        for(uint32_t b=0;b<4;++b)
+        {
+            __m256i *p0 = (__m256i*)(data + 64*b) ;
+            __m256i *p4 = (__m256i*)(data + 64*(b+4)) ;
+
+            _mm256_storeu_si256(p0+0,_mm256_xor_si256(_mm256_loadu_si256(p0+0),_mm256_permute2x128_si256(r[b][0],r[b][1],0x20))) ;
+            _mm256_storeu_si256(p0+1,_mm256_xor_si256(_mm256_loadu_si256(p0+1),_mm256_permute2x128_si256(r[b][2],r[b][3],0x20))) ;
+            _mm256_storeu_si256(p4+0,_mm256_xor_si256(_mm256_loadu_si256(p4+0),_mm256_permute2x128_si256(r[b][0],r[b][1],0x31))) ;
+            _mm256_storeu_si256(p4+1,_mm256_xor_si256(_mm256_loadu_si256(p4+1),_mm256_permute2x128_si256(r[b][2],r[b][3],0x31))) ;
+        }
+    }
+
+    chacha20_encrypt_sse2(key,s.c[12],nonce,data,size) ;
+}
+#endif
+
+struct chacha20_backend
+{
+    const char *name ;
+    chacha20_encrypt_fn encrypt ;
+};
+
+// Returns the chacha20 implementations that the current CPU can run, the fastest one last.
+//
+static std::vector<chacha20_backend> chacha20_supported_backends()
+{
+    std::vector<chacha20_backend> res ;
+
+    res.push_back( { "scalar", chacha20_encrypt_scalar } ) ;
+#ifdef CHACHA20_X86_SIMD
+    __builtin_cpu_init() ;
+
+    if(__builtin_cpu_supports("sse2"))
+        res.push_back( { "SSE2 x4", chacha20_encrypt_sse2 } ) ;
+
+    if(__builtin_cpu_supports("avx2"))
+        res.push_back( { "AVX2 x8", chacha20_encrypt_avx2 } ) ;
+#endif
+    return res ;
+}
+
+void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    // selected once. Static initialisation is thread safe.
+    static const chacha20_encrypt_fn best = chacha20_supported_backends().back().encrypt ;
+
+    best(key,block_counter,nonce,data,size) ;
+}
+
+void chacha20_encrypt(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    chacha20_encrypt_rs(key,block_counter,nonce,data,size) ;
+}
+
 #if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
 void chacha20_encrypt_openssl(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
 {
@@ -428,7 +646,10 @@ out:
 }
 #endif
 
-struct poly1305_state
+// Reference poly1305 implementation, computing with 256 bits integers. Only used when 128 bits integers
+// are not available, and to cross-check the optimised version in perform_tests().
+//
+struct poly1305_ref_state
 {
     uint256_32 r ;
     uint256_32 s ;
@@ -436,7 +657,7 @@ struct poly1305_state
     uint256_32 a ;
 };
 
-static void poly1305_init(poly1305_state& s,uint8_t key[32])
+static void poly1305_ref_init(poly1305_ref_state& s,uint8_t key[32])
 {
     s.r =   uint256_32( 0,0,0,0,
             ((uint32_t)key[12] << 0) + ((uint32_t)key[13] << 8) + ((uint32_t)key[14] << 16) + ((uint32_t)key[15] << 24),
@@ -460,7 +681,7 @@ static void poly1305_init(poly1305_state& s,uint8_t key[32])
 
 // Warning: each call will automatically *pad* the data to a multiple of 16 bytes.
 //
-static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false)
+static void poly1305_ref_add(poly1305_ref_state& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false)
 {
 #ifdef DEBUG_CHACHA20
     std::cerr << "Poly1305: digesting " << RsUtil::BinToHex(message,size) << std::endl;
@@ -488,7 +709,7 @@ static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool p
     }
 }
 
-static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
+static void poly1305_ref_finish(poly1305_ref_state& s,uint8_t tag[16])
 {
     s.a += s.s ;
 
@@ -498,6 +719,166 @@ static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
     tag[12] = (s.a.b[3] >> 0) & 0xff ; tag[13] = (s.a.b[3] >> 8) & 0xff ; tag[14] = (s.a.b[3] >>16) & 0xff ; tag[15] = (s.a.b[3] >>24) & 0xff ;
 }
 
+#ifdef POLY1305_64BITS_LIMBS
+// Poly1305 using 64 bits limbs. The accumulator and r are split into 44/44/42 bits limbs, so that all partial
+// products fit in 128 bits and the reduction modulo 2^130-5 only needs shifts and a multiplication by 5.
+
+typedef unsigned __int128 poly1305_uint128 ;
+
+static const uint64_t POLY1305_MASK44 = 0xfffffffffffULL ;
+static const uint64_t POLY1305_MASK42 = 0x3ffffffffffULL ;
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+    uint64_t r = 0 ;
+
+    for(int i=7;i>=0;--i)
+        r = (r << 8) | p[i] ;
+
+    return r ;
+}
+
+static inline void store_le64(uint8_t *p,uint64_t v)
+{
+    for(int i=0;i<8;++i)
+        p[i] = (v >> (8*i)) & 0xff ;
+}
+
+struct poly1305_state
+{
+    uint64_t r[3] ;
+    uint64_t h[3] ;
+    uint64_t pad[2] ;
+};
+
+static void poly1305_init(poly1305_state& s,uint8_t key[32])
+{
+    uint64_t t0 = load_le64(key) ;
+    uint64_t t1 = load_le64(key+8) ;
+
+    // clamping is merged into the limb masks
+
+    s.r[0] = ( t0                    ) & 0xffc0fffffffULL ;
+    s.r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL ;
+    s.r[2] = ((t1 >> 24)             ) & 0x00ffffffc0fULL ;
+
+    s.h[0] = s.h[1] = s.h[2] = 0 ;
+
+    s.pad[0] = load_le64(key+16) ;
+    s.pad[1] = load_le64(key+24) ;
+}
+
+// Digests nb_blocks 16 bytes blocks. hibit is the 2^128 bit, relative to the last limb.
+//
+static void poly1305_blocks(poly1305_state& s,const uint8_t *m,uint32_t nb_blocks,uint64_t hibit)
+{
+    const uint64_t r0 = s.r[0], r1 = s.r[1], r2 = s.r[2] ;
+    const uint64_t s1 = r1 * (5 << 2) ;
+    const uint64_t s2 = r2 * (5 << 2) ;
+
+    uint64_t h0 = s.h[0], h1 = s.h[1], h2 = s.h[2] ;
+
+    for(;nb_blocks > 0;--nb_blocks,m += 16)
+    {
+        uint64_t t0 = load_le64(m) ;
+        uint64_t t1 = load_le64(m+8) ;
+
+        h0 += ( t0                    ) & POLY1305_MASK44 ;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44 ;
+        h2 += (((t1 >> 24)             ) & POLY1305_MASK42) | hibit ;
+
+        poly1305_uint128 d0 = (poly1305_uint128)h0 * r0 + (poly1305_uint128)h1 * s2 + (poly1305_uint128)h2 * s1 ;
+        poly1305_uint128 d1 = (poly1305_uint128)h0 * r1 + (poly1305_uint128)h1 * r0 + (poly1305_uint128)h2 * s2 ;
+        poly1305_uint128 d2 = (poly1305_uint128)h0 * r2 + (poly1305_uint128)h1 * r1 + (poly1305_uint128)h2 * r0 ;
+
+        uint64_t c ;
+                  c = (uint64_t)(d0 >> 44) ; h0 = (uint64_t)d0 & POLY1305_MASK44 ;
+        d1 += c ; c = (uint64_t)(d1 >> 44) ; h1 = (uint64_t)d1 & POLY1305_MASK44 ;
+        d2 += c ; c = (uint64_t)(d2 >> 42) ; h2 = (uint64_t)d2 & POLY1305_MASK42 ;
+        h0 += c * 5 ; c = h0 >> 44 ; h0 &= POLY1305_MASK44 ;
+        h1 += c ;
+    }
+
+    s.h[0] = h0 ; s.h[1] = h1 ; s.h[2] = h2 ;
+}
+
+// Same semantics as poly1305_ref_add(): each call starts on a fresh block.
+//
+static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false)
+{
+#ifdef DEBUG_CHACHA20
+    std::cerr << "Poly1305: digesting " << RsUtil::BinToHex(message,size) << std::endl;
+#endif
+    poly1305_blocks(s,message,size/16,1ULL << 40) ;
+
+    uint32_t remaining = size % 16 ;
+
+    if(remaining > 0)
+    {
+        uint8_t block[16] ;
+        memset(block,0,16) ;
+        memcpy(block,message + size - remaining,remaining) ;
+
+        if(pad_to_16_bytes)
+            poly1305_blocks(s,block,1,1ULL << 40) ;
+        else
+        {
+            block[remaining] = 0x01 ;
+            poly1305_blocks(s,block,1,0) ;
+        }
+    }
+}
+
+static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
+{
+    uint64_t h0 = s.h[0], h1 = s.h[1], h2 = s.h[2] ;
+    uint64_t c ;
+
+    // fully carry h
+
+                 c = h1 >> 44 ; h1 &= POLY1305_MASK44 ;
+    h2 += c ;    c = h2 >> 42 ; h2 &= POLY1305_MASK42 ;
+    h0 += c*5 ;  c = h0 >> 44 ; h0 &= POLY1305_MASK44 ;
+    h1 += c ;    c = h1 >> 44 ; h1 &= POLY1305_MASK44 ;
+    h2 += c ;    c = h2 >> 42 ; h2 &= POLY1305_MASK42 ;
+    h0 += c*5 ;  c = h0 >> 44 ; h0 &= POLY1305_MASK44 ;
+    h1 += c ;
+
+    // compute h - p = h + 5 - 2^130 and select it in constant time if h >= p
+
+    uint64_t g0 = h0 + 5 ; c = g0 >> 44 ; g0 &= POLY1305_MASK44 ;
+    uint64_t g1 = h1 + c ; c = g1 >> 44 ; g1 &= POLY1305_MASK44 ;
+    uint64_t g2 = h2 + c - (1ULL << 42) ;
+
+    c = (g2 >> 63) - 1 ;
+    g0 &= c ; g1 &= c ; g2 &= c ;
+    c = ~c ;
+    h0 = (h0 & c) | g0 ;
+    h1 = (h1 & c) | g1 ;
+    h2 = (h2 & c) | g2 ;
+
+    // tag = (h + s) mod 2^128
+
+    uint64_t t0 = s.pad[0] ;
+    uint64_t t1 = s.pad[1] ;
+
+    h0 += (( t0                    ) & POLY1305_MASK44)     ; c = h0 >> 44 ; h0 &= POLY1305_MASK44 ;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44) + c ; c = h1 >> 44 ; h1 &= POLY1305_MASK44 ;
+    h2 += (((t1 >> 24)             ) & POLY1305_MASK42) + c ;                h2 &= POLY1305_MASK42 ;
+
+    store_le64(tag  ,(h0      ) | (h1 << 44)) ;
+    store_le64(tag+8,(h1 >> 20) | (h2 << 24)) ;
+}
+#else
+// No 128 bits integers available: fall back to the generic 256 bits implementation.
+
+typedef poly1305_ref_state poly1305_state ;
+
+static void poly1305_init(poly1305_state& s,uint8_t key[32]) { poly1305_ref_init(s,key) ; }
+static void poly1305_add(poly1305_state& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false) { poly1305_ref_add(s,message,size,pad_to_16_bytes) ; }
+static void poly1305_finish(poly1305_state& s,uint8_t tag[16]) { poly1305_ref_finish(s,tag) ; }
+#endif
+
 void poly1305_tag(uint8_t key[32],uint8_t *message,uint32_t size,uint8_t tag[16])
 {
     poly1305_state s;
@@ -1365,6 +1746,88 @@ bool perform_tests()
     }
     std::cerr << "  RFC7539 AEAD test vector #1           OK" << std::endl;
 
+    // Check all chacha20 backends against the scalar one, on random sizes that exercise the multi-block
+    // paths, their tails and the wrapping of the block counter.
+    //
+    std::vector<chacha20_backend> backends = chacha20_supported_backends() ;
+    {
+        uint32_t MAX_SIZE = 8*64*3 + 63 ;
+        std::vector<uint8_t> ref_data(MAX_SIZE),test_data(MAX_SIZE) ;
+
+        for(uint32_t i=0;i<200;++i)
+        {
+            uint8_t key[32] ;
+            uint8_t nonce[12] ;
+
+            RSRandom::random_bytes(key,32) ;
+            RSRandom::random_bytes(nonce,12) ;
+            RSRandom::random_bytes(ref_data.data(),MAX_SIZE) ;
+
+            uint32_t size = (i < 10)?(i*64):(RSRandom::random_u32() % (MAX_SIZE+1)) ;
+            uint32_t counter = (i%2)?RSRandom::random_u32():(0xffffffff - (i%8)) ;
+
+            for(uint32_t b=1;b<backends.size();++b)
+            {
+                test_data = ref_data ;
+
+                chacha20_encrypt_scalar(key,counter,nonce,ref_data.data(),size) ;
+                backends[b].encrypt    (key,counter,nonce,test_data.data(),size) ;
+
+                if(ref_data != test_data)
+                {
+                    std::cerr << " chacha20 backend " << backends[b].name << " differs from scalar version for size " << size << std::endl;
+                    return false ;
+                }
+            }
+        }
+    }
+    std::cerr << "  Chacha20 backends cross-check         OK" << std::endl;
+
+    // Check the optimised poly1305 against the 256 bits reference implementation
+    //
+    {
+        uint32_t MAX_SIZE = 1000 ;
+        std::vector<uint8_t> msg(MAX_SIZE) ;
+
+        for(uint32_t i=0;i<200;++i)
+        {
+            uint8_t key[32] ;
+            uint8_t tag[16] ;
+            uint8_t ref_tag[16] ;
+
+            // also try keys that make r and s saturate
+
+            if(i < 4)
+                memset(key,0xff,32) ;
+            else
+                RSRandom::random_bytes(key,32) ;
+
+            if(i < 2)
+                memset(msg.data(),0xff,MAX_SIZE) ;
+            else
+                RSRandom::random_bytes(msg.data(),MAX_SIZE) ;
+
+            uint32_t size = RSRandom::random_u32() % (MAX_SIZE+1) ;
+            bool pad = (i%2) ;
+
+            poly1305_state s ;
+            poly1305_init(s,key) ;
+            poly1305_add(s,msg.data(),size,pad) ;
+            poly1305_add(s,msg.data(),size/3,pad) ;
+            poly1305_finish(s,tag) ;
+
+            poly1305_ref_state rs ;
+            poly1305_ref_init(rs,key) ;
+            poly1305_ref_add(rs,msg.data(),size,pad) ;
+            poly1305_ref_add(rs,msg.data(),size/3,pad) ;
+            poly1305_ref_finish(rs,ref_tag) ;
+
+            if(!constant_time_memory_compare(tag,ref_tag,16))
+                return false ;
+        }
+    }
+    std::cerr << "  Poly1305 vs. 256bits reference        OK" << std::endl;
+
     // bandwidth test
     //
 
@@ -1382,11 +1845,50 @@ bool perform_tests()
 
         uint8_t received_tag[16] ;
 
+        // chacha20 throughput of each backend available on this CPU. The one listed last is used by default.
+        // Fast implementations are run several times over the data so that the timer resolution does not matter.
+
+        const uint32_t ROUNDS = 16 ;
+
+        for(uint32_t b=0;b<backends.size();++b)
+        {
+            rstime::RsScopeTimer s("CHACHA20") ;
+
+            for(uint32_t i=0;i<ROUNDS;++i)
+                backends[b].encrypt(key, 1, nonce, ten_megabyte_data,SIZE) ;
+
+            std::cerr << "  Chacha20 " << backends[b].name << std::string(29 - strlen(backends[b].name),' ') << ": " << ROUNDS * SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
         {
-            rstime::RsScopeTimer s("AEAD1") ;
-            chacha20_encrypt_rs(key, 1, nonce, ten_megabyte_data,SIZE) ;
+            rstime::RsScopeTimer s("CHACHA20") ;
+
+            for(uint32_t i=0;i<ROUNDS;++i)
+                chacha20_encrypt_openssl(key, 1, nonce, ten_megabyte_data,SIZE) ;
+
+            std::cerr << "  Chacha20 openssl                      : " << ROUNDS * SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+#endif
+        {
+            rstime::RsScopeTimer s("POLY1") ;
+            poly1305_ref_state ps ;
+            poly1305_ref_init(ps,key) ;
+            poly1305_ref_add(ps,ten_megabyte_data,SIZE,true) ;
+            poly1305_ref_finish(ps,received_tag) ;
+
+            std::cerr << "  Poly1305 256bits reference            : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+        {
+            rstime::RsScopeTimer s("POLY2") ;
+            poly1305_state ps ;
+            poly1305_init(ps,key) ;
+
+            for(uint32_t i=0;i<ROUNDS;++i)
+                poly1305_add(ps,ten_megabyte_data,SIZE,true) ;
+
+            poly1305_finish(ps,received_tag) ;
 
-            std::cerr << "  Chacha20 encryption speed             : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+            std::cerr << "  Poly1305 own                          : " << ROUNDS * SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
         }
         {
             rstime::RsScopeTimer s("AEAD2") ;
@@ -43,38 +43,16 @@ static const uint32_t ENCRYPTED_MEMORY_EDATA_SIZE                 =  4 ;
 static const uint8_t  ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_POLY1305 = 0x01 ;
 static const uint8_t  ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_SHA256   = 0x02 ;
 
-bool encryptAuthenticateData(const unsigned char *clear_data,uint32_t clear_data_size,uint8_t *encryption_master_key,unsigned char *& encrypted_data,uint32_t& encrypted_data_len)
+// Fills the header of an encrypted chunk and encrypts in place the edata_size bytes of clear data that follow it.
+// The IV is copied into the header, where it is also part of the authenticated data.
+//
+static bool encryptChunkInPlace(uint8_t *encryption_master_key,const uint8_t *initialization_vector,uint8_t format,uint8_t *edata,uint32_t edata_size)
 {
-	uint8_t initialization_vector[ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE] ;
-
-	RSRandom::random_bytes(initialization_vector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
-
-#ifdef CRYPTO_DEBUG
-	RSCRYPTO_DEBUG() << "ftServer::Encrypting ft item." << std::endl;
-	RSCRYPTO_DEBUG() << "  random nonce    : " << RsUtil::BinToHex(initialization_vector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) << std::endl;
-#endif
-
-	uint32_t item_serialized_size = clear_data_size;//RsGenericSerializer().size(clear_item) ;
-	uint32_t total_data_size = ENCRYPTED_MEMORY_HEADER_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_EDATA_SIZE + item_serialized_size + ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE  ;
-
-#ifdef CRYPTO_DEBUG
-	RSCRYPTO_DEBUG() << "  clear part size : " << size(clear_item) << std::endl;
-	RSCRYPTO_DEBUG() << "  total item size : " << total_data_size << std::endl;
-#endif
-
-	encrypted_data = (unsigned char*)rs_malloc( total_data_size ) ;
-	encrypted_data_len  = total_data_size ;
-
-	if(encrypted_data == NULL)
-		return false ;
-
-	uint8_t *edata = (uint8_t*)encrypted_data;
-	uint32_t edata_size = item_serialized_size;
 	uint32_t offset = 0;
 
 	edata[0] = 0xae ;
 	edata[1] = 0xad ;
-	edata[2] = ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_SHA256 ;       // means AEAD_chacha20_sha256
+	edata[2] = format ;
 	edata[3] = 0x01 ;
 
 	offset += ENCRYPTED_MEMORY_HEADER_SIZE;
@@ -82,6 +60,7 @@ bool encryptAuthenticateData(const unsigned char *clear_data,uint32_t clear_data
 	uint32_t aad_size = ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_EDATA_SIZE ;
 
 	memcpy(&edata[offset], initialization_vector, ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
+	uint8_t *nonce = &edata[offset] ;
 	offset += ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE ;
 
 	edata[offset+0] = (edata_size >>  0) & 0xff ;
@@ -91,44 +70,34 @@ bool encryptAuthenticateData(const unsigned char *clear_data,uint32_t clear_data
 
 	offset += ENCRYPTED_MEMORY_EDATA_SIZE ;
 
-	memcpy(&edata[offset],clear_data,clear_data_size);
-
 #ifdef CRYPTO_DEBUG
-	RSCRYPTO_DEBUG() << "  clear item      : " << RsUtil::BinToHex(&edata[offset],std::min(50,(int)total_data_size-(int)offset)) << "(...)" << std::endl;
+	RSCRYPTO_DEBUG() << "  clear item      : " << RsUtil::BinToHex(&edata[offset],std::min(50u,edata_size)) << "(...)" << std::endl;
 #endif
 
 	uint32_t clear_item_offset = offset ;
 	offset += edata_size ;
 
 	uint32_t authentication_tag_offset = offset ;
-	assert(ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE + offset == total_data_size) ;
 
-	//uint8_t encryption_key[32] ;
-	//deriveEncryptionKey(hash,encryption_key) ;
-
-	if(edata[2] == ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_POLY1305)
-		librs::crypto::AEAD_chacha20_poly1305(encryption_master_key,initialization_vector,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
-	else if(edata[2] == ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_SHA256)
-		librs::crypto::AEAD_chacha20_sha256  (encryption_master_key,initialization_vector,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
+	if(format == ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_POLY1305)
+		librs::crypto::AEAD_chacha20_poly1305(encryption_master_key,nonce,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
+	else if(format == ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_SHA256)
+		librs::crypto::AEAD_chacha20_sha256  (encryption_master_key,nonce,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
 	else
 		return false ;
 
 #ifdef CRYPTO_DEBUG
-	RSCRYPTO_DEBUG() << "  encryption key  : " << RsUtil::BinToHex(encryption_key,32) << std::endl;
 	RSCRYPTO_DEBUG() << "  authen. tag     : " << RsUtil::BinToHex(&edata[authentication_tag_offset],ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE) << std::endl;
-	RSCRYPTO_DEBUG() << "  final item      : " << RsUtil::BinToHex(&edata[0],std::min(50u,total_data_size)) << "(...)" << std::endl;
+	RSCRYPTO_DEBUG() << "  final item      : " << RsUtil::BinToHex(&edata[0],std::min(50u,authentication_tag_offset)) << "(...)" << std::endl;
 #endif
 
 	return true ;
 }
 
-// Decrypts the given item using aead-chacha20-poly1305
-bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encrypted_data_len,uint8_t *encryption_master_key, unsigned char *& decrypted_data, uint32_t& decrypted_data_size)
+// Checks the header of an encrypted chunk, and decrypts + authenticates it in place.
+//
+static bool decryptChunkInPlace(uint8_t *encryption_master_key,uint8_t *edata,uint32_t encrypted_data_len,uint32_t& clear_item_offset,uint32_t& edata_size)
 {
-	//uint8_t encryption_key[32] ;
-	//deriveEncryptionKey(hash,encryption_key) ;
-
-	uint8_t *edata = (uint8_t*)encrypted_data;
 	uint32_t offset = 0;
 
 	if(encrypted_data_len < ENCRYPTED_MEMORY_HEADER_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_EDATA_SIZE) return false ;
@@ -146,28 +115,27 @@ bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encryp
 
 #ifdef CRYPTO_DEBUG
 	RSCRYPTO_DEBUG() << "ftServer::decrypting ft item." << std::endl;
-	RSCRYPTO_DEBUG() << "  item data       : " << RsUtil::BinToHex(edata,std::min(50u,encrypted_data_len) << "(...)" << std::endl;
-	RSCRYPTO_DEBUG() << "  hash            : " << hash << std::endl;
-	RSCRYPTO_DEBUG() << "  encryption key  : " << RsUtil::BinToHex(encryption_key,32) << std::endl;
+	RSCRYPTO_DEBUG() << "  item data       : " << RsUtil::BinToHex(edata,std::min(50u,encrypted_data_len)) << "(...)" << std::endl;
+	RSCRYPTO_DEBUG() << "  encryption key  : " << RsUtil::BinToHex(encryption_master_key,32) << std::endl;
 	RSCRYPTO_DEBUG() << "  random nonce    : " << RsUtil::BinToHex(initialization_vector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) << std::endl;
 #endif
 
 	offset += ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE ;
 
-	uint32_t edata_size = 0 ;
+	edata_size = 0 ;
 	edata_size += ((uint32_t)edata[offset+0]) <<  0 ;
 	edata_size += ((uint32_t)edata[offset+1]) <<  8 ;
 	edata_size += ((uint32_t)edata[offset+2]) << 16 ;
 	edata_size += ((uint32_t)edata[offset+3]) << 24 ;
 
-	if(edata_size + ENCRYPTED_MEMORY_EDATA_SIZE + ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_HEADER_SIZE != encrypted_data_len)
+	if((uint64_t)edata_size + ENCRYPTED_MEMORY_EDATA_SIZE + ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_HEADER_SIZE != encrypted_data_len)
 	{
 		RSCRYPTO_ERROR() << "  ERROR: encrypted data size is " << edata_size << ", should be " << encrypted_data_len - (ENCRYPTED_MEMORY_EDATA_SIZE + ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_HEADER_SIZE ) << std::endl;
 		return false ;
 	}
 
 	offset += ENCRYPTED_MEMORY_EDATA_SIZE ;
-	uint32_t clear_item_offset = offset ;
+	clear_item_offset = offset ;
 
 	uint32_t authentication_tag_offset = offset + edata_size ;
 #ifdef CRYPTO_DEBUG
@@ -193,6 +161,46 @@ bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encryp
 		RSCRYPTO_ERROR() << "(EE) decryption/authentication went wrong." << std::endl;
 		return false ;
 	}
+	return true ;
+}
+
+bool encryptAuthenticateData(const unsigned char *clear_data,uint32_t clear_data_size,uint8_t *encryption_master_key,unsigned char *& encrypted_data,uint32_t& encrypted_data_len)
+{
+	uint8_t initialization_vector[ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE] ;
+
+	RSRandom::random_bytes(initialization_vector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
+
+#ifdef CRYPTO_DEBUG
+	RSCRYPTO_DEBUG() << "ftServer::Encrypting ft item." << std::endl;
+	RSCRYPTO_DEBUG() << "  random nonce    : " << RsUtil::BinToHex(initialization_vector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) << std::endl;
+#endif
+
+	uint32_t total_data_size = EncryptionContext::encryptedSize(clear_data_size) ;
+
+#ifdef CRYPTO_DEBUG
+	RSCRYPTO_DEBUG() << "  clear part size : " << clear_data_size << std::endl;
+	RSCRYPTO_DEBUG() << "  total item size : " << total_data_size << std::endl;
+#endif
+
+	encrypted_data = (unsigned char*)rs_malloc( total_data_size ) ;
+	encrypted_data_len  = total_data_size ;
+
+	if(encrypted_data == NULL)
+		return false ;
+
+	memcpy(&encrypted_data[EncryptionContext::CLEAR_DATA_OFFSET],clear_data,clear_data_size);
+
+	return encryptChunkInPlace(encryption_master_key,initialization_vector,ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_SHA256,encrypted_data,clear_data_size) ;
+}
+
+// Decrypts the given item using aead-chacha20-poly1305
+bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encrypted_data_len,uint8_t *encryption_master_key, unsigned char *& decrypted_data, uint32_t& decrypted_data_size)
+{
+	uint32_t clear_item_offset = 0 ;
+	uint32_t edata_size = 0 ;
+
+	if(!decryptChunkInPlace(encryption_master_key,(uint8_t*)encrypted_data,encrypted_data_len,clear_item_offset,edata_size))
+		return false ;
 
 	decrypted_data_size = edata_size ;
 	decrypted_data = (unsigned char*)rs_malloc(edata_size) ;
@@ -202,11 +210,82 @@ bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encryp
 		std::cerr << "Failed to allocate memory for decrypted data chunk of size " << edata_size << std::endl;
 		return false ;
 	}
-	memcpy(decrypted_data,&edata[clear_item_offset],edata_size) ;
+	memcpy(decrypted_data,&encrypted_data[clear_item_offset],edata_size) ;
 
 	return true ;
 }
 
+//===========================================================================================================================//
+//                                                   EncryptionContext                                                       //
+//===========================================================================================================================//
+
+const uint32_t EncryptionContext::CLEAR_DATA_OFFSET = ENCRYPTED_MEMORY_HEADER_SIZE + ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE + ENCRYPTED_MEMORY_EDATA_SIZE ;
+
+EncryptionContext::EncryptionContext()
+{
+	memset(mKey,0,32) ;
+	memset(mInitializationVector,0,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
+}
+
+EncryptionContext::EncryptionContext(const uint8_t *encryption_master_key)
+{
+	memcpy(mKey,encryption_master_key,32) ;
+
+	// A random start point is needed since the same key can be used by several contexts (e.g. all tunnels of a given file).
+	// Two contexts will only reuse an IV if their ranges of 2^96 possible values overlap.
+
+	RSRandom::random_bytes(mInitializationVector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
+}
+
+uint32_t EncryptionContext::encryptedSize(uint32_t clear_data_size)
+{
+	return CLEAR_DATA_OFFSET + clear_data_size + ENCRYPTED_MEMORY_AUTHENTICATION_TAG_SIZE ;
+}
+
+EncryptionContext EncryptionContext::reserve(uint32_t nb_chunks)
+{
+	EncryptionContext ctx(*this) ;
+
+	// add nb_chunks to the little endian 96 bits IV
+
+	uint64_t carry = nb_chunks ;
+
+	for(uint32_t i=0;i<ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE && carry > 0;++i)
+	{
+		carry += mInitializationVector[i] ;
+		mInitializationVector[i] = carry & 0xff ;
+		carry >>= 8 ;
+	}
+
+	return ctx ;
+}
+
+bool EncryptionContext::encryptInPlace(uint8_t *buffer,uint32_t clear_data_size)
+{
+	uint8_t initialization_vector[ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE] ;
+	memcpy(initialization_vector,mInitializationVector,ENCRYPTED_MEMORY_INITIALIZATION_VECTOR_SIZE) ;
+
+	reserve(1) ;
+
+	// Poly1305 is faster than HMAC-sha256, and supported by all versions of decryptAuthenticateData().
+
+	return encryptChunkInPlace(mKey,initialization_vector,ENCRYPTED_MEMORY_FORMAT_AEAD_CHACHA20_POLY1305,buffer,clear_data_size) ;
+}
+
+uint32_t EncryptionContext::encryptBatch(uint8_t * const *buffers,const uint32_t *clear_data_sizes,uint32_t nb_chunks)
+{
+	for(uint32_t i=0;i<nb_chunks;++i)
+		if(!encryptInPlace(buffers[i],clear_data_sizes[i]))
+			return i ;
+
+	return nb_chunks ;
+}
+
+bool EncryptionContext::decryptInPlace(uint8_t *encrypted_data,uint32_t encrypted_data_size,uint32_t& clear_data_offset,uint32_t& clear_data_size) const
+{
+	return decryptChunkInPlace(const_cast<uint8_t*>(mKey),encrypted_data,encrypted_data_size,clear_data_offset,clear_data_size) ;
+}
+
 }
 }
 
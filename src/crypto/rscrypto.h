@@ -21,6 +21,8 @@
  *                                                                             *
  *******************************************************************************/
 
+#pragma once
+
 #include "crypto/chacha20.h"
 
 namespace librs
@@ -54,6 +56,68 @@ bool encryptAuthenticateData(const unsigned char *clear_data,uint32_t clear_data
  * 			true if decryption + authentication are ok.
  */
 bool decryptAuthenticateData(const unsigned char *encrypted_data,uint32_t encrypted_data_size, uint8_t* encryption_master_key, unsigned char *& decrypted_data,uint32_t& decrypted_data_size);
+
+/*!
+ * \brief The EncryptionContext class
+ * 			Encrypts a stream of data chunks with the same master key, producing the same format as encryptAuthenticateData(), so
+ *          that the result can be read by decryptAuthenticateData(). Instead of drawing a random IV for each chunk, the IV is a
+ *          random 96 bits value chosen when the context is created, incremented for each chunk. Chunks are encrypted in place, in
+ *          a buffer of size encryptedSize() where the caller has written the clear data at offset CLEAR_DATA_OFFSET.
+ *
+ *          A context is not thread safe. To use it from several threads, reserve() a range of IVs under a lock, and encrypt
+ *          with the returned context.
+ */
+class EncryptionContext
+{
+public:
+	static const uint32_t CLEAR_DATA_OFFSET ;
+
+	EncryptionContext() ;
+	explicit EncryptionContext(const uint8_t *encryption_master_key) ;
+
+	/// total size of an encrypted chunk holding clear_data_size bytes of data
+	static uint32_t encryptedSize(uint32_t clear_data_size) ;
+
+	/*!
+	 * \brief reserve
+	 * 			Returns a context able to encrypt nb_chunks chunks, and skips the corresponding IVs in this context.
+	 */
+	EncryptionContext reserve(uint32_t nb_chunks) ;
+
+	/*!
+	 * \brief encryptInPlace
+	 * 			Writes the header and encrypts the clear data found at offset CLEAR_DATA_OFFSET of the buffer.
+	 * \param buffer				memory block of size encryptedSize(clear_data_size)
+	 * \param clear_data_size		size of the clear data
+	 * \return
+	 * 			true if everything went well.
+	 */
+	bool encryptInPlace(uint8_t *buffer,uint32_t clear_data_size) ;
+
+	/*!
+	 * \brief encryptBatch
+	 * 			Encrypts a batch of buffers prepared as for encryptInPlace(). clear_data_sizes[i] is the size of the clear data in buffers[i].
+	 * \return
+	 * 			the number of chunks successfully encrypted, starting from the first one.
+	 */
+	uint32_t encryptBatch(uint8_t * const *buffers,const uint32_t *clear_data_sizes,uint32_t nb_chunks) ;
+
+	/*!
+	 * \brief decryptInPlace
+	 * 			Checks and decrypts data produced by encryptAuthenticateData() or an EncryptionContext with the same key. Does not allocate.
+	 * \param encrypted_data			encrypted data, decrypted in place
+	 * \param encrypted_data_size		size of the encrypted data
+	 * \param clear_data_offset		offset of the decrypted data in encrypted_data
+	 * \param clear_data_size			size of the decrypted data
+	 * \return
+	 * 			true if decryption + authentication are ok.
+	 */
+	bool decryptInPlace(uint8_t *encrypted_data,uint32_t encrypted_data_size,uint32_t& clear_data_offset,uint32_t& clear_data_size) const ;
+
+private:
+	uint8_t mKey[32] ;
+	uint8_t mInitializationVector[12] ;	// IV of the next chunk, as a little endian 96 bits integer
+};
 }
 }
 
@@ -57,7 +57,7 @@ template<class T> typename std::set<T>::iterator erase_from_set(typename std::se
 // A Mutex is used to ensure total coherence at this level. So only abstracted operations are allowed,
 // so that the hierarchy stays completely coherent between calls.
 
-InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
+InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0), mNameIndexBuilt(false)
 {
     DirEntry *de = new DirEntry("") ;
 
@@ -73,13 +73,176 @@ InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
     mTotalFiles = 0 ;
 }
 
+/******************************************************************************************************************/
+/*                                                   Node table                                                   */
+/******************************************************************************************************************/
+
+void InternalFileHierarchyStorage::NodeTable::clear()
+{
+    for(auto& it: std::as_const(mCopied))
+        delete it.second ;
+
+    for(uint32_t i=0;i<mTail.size();++i)
+        delete mTail[i] ;
+
+    mCopied.clear();
+    mTail.clear();
+
+    delete mMapping ;
+    mMapping = NULL ;
+    mMappedCount = 0 ;
+}
+
+void InternalFileHierarchyStorage::NodeTable::resize(uint32_t n,FileStorageNode *node)
+{
+    if(n < mMappedCount)
+    {
+        RS_ERR("cannot resize node table below the number of mapped nodes (", mMappedCount, ")");
+        return ;
+    }
+    mTail.resize(n - mMappedCount,node) ;
+}
+
+void InternalFileHierarchyStorage::NodeTable::setMapping(MappedFileHierarchy *mapping)
+{
+    clear();
+
+    mMapping = mapping ;
+    mMappedCount = mapping->nodeCount() ;
+}
+
+InternalFileHierarchyStorage::FileStorageNode *& InternalFileHierarchyStorage::NodeTable::operator[](uint32_t i)
+{
+    if(i >= mMappedCount)
+        return mTail[i - mMappedCount] ;
+
+    auto it = mCopied.find(i) ;
+
+    if(it != mCopied.end())
+        return it->second ;
+
+    return copyMappedNode(i) ;
+}
+
+InternalFileHierarchyStorage::FileStorageNode *InternalFileHierarchyStorage::NodeTable::operator[](uint32_t i) const
+{
+    if(i >= mMappedCount)
+        return mTail[i - mMappedCount] ;
+
+    auto it = mCopied.find(i) ;
+
+    if(it != mCopied.end())
+        return it->second ;
+
+    return copyMappedNode(i) ;
+}
+
+// Copies a mapped node to the heap. From then on, the heap node replaces the mapped one, even if it gets deleted.
+
+InternalFileHierarchyStorage::FileStorageNode *& InternalFileHierarchyStorage::NodeTable::copyMappedNode(uint32_t i) const
+{
+    const MappedFileHierarchy::Node& n(mMapping->node(i)) ;
+    FileStorageNode *node = NULL ;
+
+    if(n.type == MappedFileHierarchy::TYPE_FILE)
+        node = new FileEntry(mMapping->name(i),n.size,n.modtime,mMapping->hash(i)) ;
+    else if(n.type == MappedFileHierarchy::TYPE_DIR)
+    {
+        DirEntry *de = new DirEntry(mMapping->name(i)) ;
+        const uint32_t *children = mMapping->children(i) ;
+
+        de->dir_parent_path      = mMapping->parentPath(i) ;
+        de->dir_hash             = mMapping->hash(i) ;
+        de->dir_cumulated_size   = n.size ;
+        de->dir_modtime          = n.modtime ;
+        de->dir_most_recent_time = n.most_recent_time ;
+        de->dir_update_time      = n.update_time ;
+
+        de->subdirs.assign(children,children + n.n_subdirs) ;
+        de->subfiles.assign(children + n.n_subdirs,children + n.n_subdirs + n.n_subfiles) ;
+
+        node = de ;
+    }
+
+    if(node != NULL)
+    {
+        node->parent_index = n.parent_index ;
+        node->row = n.row ;
+    }
+    return mCopied[i] = node ;
+}
+
+// Read access without copying mapped nodes
+
+uint32_t InternalFileHierarchyStorage::nodeType(DirectoryStorage::EntryIndex indx) const
+{
+    if(indx >= mNodes.size())
+        return FileStorageNode::TYPE_UNKNOWN ;
+
+    if(mNodes.isMapped(indx))
+        return mNodes.mapping()->node(indx).type ;
+
+    return mNodes[indx] ? mNodes[indx]->type() : FileStorageNode::TYPE_UNKNOWN ;
+}
+
+DirectoryStorage::EntryIndex InternalFileHierarchyStorage::nodeParent(DirectoryStorage::EntryIndex indx) const
+{
+    return mNodes.isMapped(indx) ? mNodes.mapping()->node(indx).parent_index : mNodes[indx]->parent_index ;
+}
+
+uint32_t InternalFileHierarchyStorage::nodeRow(DirectoryStorage::EntryIndex indx) const
+{
+    return mNodes.isMapped(indx) ? mNodes.mapping()->node(indx).row : mNodes[indx]->row ;
+}
+
+std::string InternalFileHierarchyStorage::nodeName(DirectoryStorage::EntryIndex indx) const
+{
+    if(mNodes.isMapped(indx))
+        return mNodes.mapping()->name(indx) ;
+
+    if(mNodes[indx]->type() == FileStorageNode::TYPE_FILE)
+        return static_cast<FileEntry*>(mNodes[indx])->file_name ;
+    else
+        return static_cast<DirEntry*>(mNodes[indx])->dir_name ;
+}
+
+rstime_t InternalFileHierarchyStorage::nodeModTime(DirectoryStorage::EntryIndex indx) const
+{
+    if(mNodes.isMapped(indx))
+        return mNodes.mapping()->node(indx).modtime ;
+
+    if(mNodes[indx]->type() == FileStorageNode::TYPE_FILE)
+        return static_cast<FileEntry*>(mNodes[indx])->file_modtime ;
+    else
+        return static_cast<DirEntry*>(mNodes[indx])->dir_modtime ;
+}
+
+RsFileHash InternalFileHierarchyStorage::nodeHash(DirectoryStorage::EntryIndex indx) const
+{
+    if(mNodes.isMapped(indx))
+        return mNodes.mapping()->hash(indx) ;
+
+    if(mNodes[indx]->type() == FileStorageNode::TYPE_FILE)
+        return static_cast<FileEntry*>(mNodes[indx])->file_hash ;
+    else
+        return static_cast<DirEntry*>(mNodes[indx])->dir_hash ;
+}
+
+uint64_t InternalFileHierarchyStorage::nodeFileSize(DirectoryStorage::EntryIndex indx) const
+{
+    if(mNodes.isMapped(indx))
+        return mNodes.mapping()->node(indx).size ;
+
+    return mNodes[indx] ? static_cast<FileEntry*>(mNodes[indx])->file_size : 0 ;
+}
+
 bool InternalFileHierarchyStorage::getDirHashFromIndex(
         const DirectoryStorage::EntryIndex& index, RsFileHash& hash ) const
 {
     if(!checkIndex(index,FileStorageNode::TYPE_DIR))
         return false ;
 
-    hash = static_cast<DirEntry*>(mNodes[index])->dir_hash ;
+    hash = nodeHash(index) ;
 
     return true;
 }
@@ -89,19 +252,18 @@ bool InternalFileHierarchyStorage::getIndexFromDirHash(const RsFileHash& hash,Di
     std::map<RsFileHash,DirectoryStorage::EntryIndex>::iterator it = mDirHashes.find(hash) ;
 
     if(it == mDirHashes.end())
-        return false;
+        return lookupMappedHash(hash,FileStorageNode::TYPE_DIR,index);
 
     index = it->second;
 
 	/* make sure the hash actually points to some existing directory. If not,
 	 * remove it. This is an opportunistic update of dir hashes: when we need
 	 * them, we check them. */
-	if( !checkIndex(index, FileStorageNode::TYPE_DIR) ||
-	        static_cast<DirEntry*>(mNodes[index])->dir_hash != hash )
+	if( !checkIndex(index, FileStorageNode::TYPE_DIR) || nodeHash(index) != hash )
 	{
 		RS_INFO("removing non existing dir hash: ", hash, " from dir hash list");
 		mDirHashes.erase(it);
-		return false;
+		return lookupMappedHash(hash,FileStorageNode::TYPE_DIR,index);
 	}
     return true;
 }
@@ -110,7 +272,8 @@ bool InternalFileHierarchyStorage::getIndexFromFileHash(
         const RsFileHash& hash, DirectoryStorage::EntryIndex& index )
 {
 	auto it = std::as_const(mFileHashes).find(hash);
-	if(it == mFileHashes.end()) return false;
+	if(it == mFileHashes.end())
+		return lookupMappedHash(hash, FileStorageNode::TYPE_FILE, index);
 
 	index = it->second;
 
@@ -118,13 +281,55 @@ bool InternalFileHierarchyStorage::getIndexFromFileHash(
 	 * it. This is an opportunistic update of file hashes: when we need them,
 	 * we check them. */
 	if( !checkIndex(it->second, FileStorageNode::TYPE_FILE) ||
-	        static_cast<FileEntry*>(mNodes[index])->file_hash != hash )
+	        nodeHash(index) != hash )
 	{
 		RS_INFO("removing non existing file hash: ", hash, " from file hash list");
 		mFileHashes.erase(it);
+		return lookupMappedHash(hash, FileStorageNode::TYPE_FILE, index);
+	}
+
+	return true;
+}
+
+bool InternalFileHierarchyStorage::lookupMappedHash(
+        const RsFileHash& hash, uint32_t type,
+        DirectoryStorage::EntryIndex& index ) const
+{
+	const MappedFileHierarchy *mapping = mNodes.mapping();
+	uint32_t indx = 0;
+
+	if(mapping == NULL)
 		return false;
+
+	if(!(type == FileStorageNode::TYPE_FILE ? mapping->findFileHash(hash,indx)
+	                                        : mapping->findDirHash(hash,indx)))
+		return false;
+
+	// The node may have been deleted or changed since the file was mapped.
+	if(nodeType(indx) != type || nodeHash(indx) != hash)
+		return false;
+
+	index = indx;
+	return true;
+}
+
+bool InternalFileHierarchyStorage::lookupFileHash(
+        const RsFileHash& hash, DirectoryStorage::EntryIndex& index ) const
+{
+	auto it = mFileHashes.find(hash);
+
+	if(it != mFileHashes.end())
+	{
+		index = it->second;
+		return true;
 	}
 
+	uint32_t indx = 0;
+
+	if(mNodes.mapping() == NULL || !mNodes.mapping()->findFileHash(hash,indx))
+		return false;
+
+	index = indx;
 	return true;
 }
 
@@ -133,6 +338,17 @@ bool InternalFileHierarchyStorage::getChildIndex(DirectoryStorage::EntryIndex e,
     if(!checkIndex(e,FileStorageNode::TYPE_DIR))
         return false ;
 
+    if(mNodes.isMapped(e))
+    {
+        const MappedFileHierarchy::Node& n(mNodes.mapping()->node(e)) ;
+
+        if(row < 0 || (uint32_t)row >= n.n_subdirs + n.n_subfiles)
+            return false ;
+
+        c = mNodes.mapping()->children(e)[row] ;	// subdirs are followed by subfiles
+        return true ;
+    }
+
     const DirEntry& d = *static_cast<DirEntry*>(mNodes[e]) ;
 
     if((uint32_t)row < d.subdirs.size())
@@ -154,14 +370,14 @@ int InternalFileHierarchyStorage::parentRow(DirectoryStorage::EntryIndex e)
     if(!checkIndex(e,FileStorageNode::TYPE_DIR | FileStorageNode::TYPE_FILE) || e==0)
         return -1 ;
 
-    return mNodes[mNodes[e]->parent_index]->row;
+    return nodeRow(nodeParent(e));
 }
 
 // high level modification routines
 
 bool InternalFileHierarchyStorage::isIndexValid(DirectoryStorage::EntryIndex e) const
 {
-    return e < mNodes.size() && mNodes[e] != NULL ;
+    return nodeType(e) != FileStorageNode::TYPE_UNKNOWN ;
 }
 
 bool InternalFileHierarchyStorage::updateSubDirectoryList(
@@ -287,10 +503,12 @@ bool InternalFileHierarchyStorage::removeDirectory(DirectoryStorage::EntryIndex
 
 bool InternalFileHierarchyStorage::checkIndex(DirectoryStorage::EntryIndex indx,uint8_t type) const
 {
-    if(mNodes.empty() || indx==DirectoryStorage::NO_INDEX || indx >= mNodes.size() || mNodes[indx] == NULL)
+    uint32_t node_type = nodeType(indx) ;
+
+    if(node_type == FileStorageNode::TYPE_UNKNOWN)
         return nodeAccessError("checkIndex(): Node does not exist") ;
 
-    if(! (mNodes[indx]->type() & type))
+    if(! (node_type & type))
         return nodeAccessError("checkIndex(): Node is of wrong type") ;
 
     return true;
@@ -358,9 +576,16 @@ bool InternalFileHierarchyStorage::updateSubFilesList(
         mNodes.back()->row = mNodes.size()-1;
         mNodes.back()->parent_index = indx;
 
+        if(mNameIndexBuilt)
+            mNameIndex.insert(mNodes.size()-1,it->first) ;
+
         mTotalSize  += it->second.size;
         mTotalFiles += 1;
     }
+
+    if(mNameIndexBuilt && mNameIndex.needsRebuild())
+        rebuildNameIndex();
+
     return true;
 }
 bool InternalFileHierarchyStorage::updateHash(
@@ -402,6 +627,12 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
 
 	mTotalSize += size ;
 
+    if(fe.file_name != fname && mNameIndexBuilt)
+    {
+        mNameIndex.remove(file_index) ;
+        mNameIndex.insert(file_index,fname) ;
+    }
+
     fe.file_hash = hash;
     fe.file_size = size;
     fe.file_modtime = modf_time;
@@ -430,6 +661,9 @@ void InternalFileHierarchyStorage::deleteFileNode(uint32_t index)
         if(mTotalFiles > 0)
 			mTotalFiles -= 1;
 
+		if(mNameIndexBuilt)
+			mNameIndex.remove(index) ;
+
 		delete mNodes[index] ;
 		mFreeNodes.push_back(index) ;
 		mNodes[index] = NULL ;
@@ -439,6 +673,9 @@ void InternalFileHierarchyStorage::deleteNode(uint32_t index)
 {
     if(mNodes[index] != NULL)
     {
+        if(mNodes[index]->type() == FileStorageNode::TYPE_FILE && mNameIndexBuilt)
+            mNameIndex.remove(index) ;
+
         delete mNodes[index] ;
         mFreeNodes.push_back(index) ;
         mNodes[index] = NULL ;
@@ -586,6 +823,9 @@ bool InternalFileHierarchyStorage::updateDirEntry(
 
             mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
             mFileHashes[f.file_hash] = file_index ;
+
+            if(mNameIndexBuilt)
+                mNameIndex.insert(file_index,f.file_name) ;
             mTotalSize += f.file_size ;
             mTotalFiles++;
 
@@ -628,6 +868,8 @@ bool InternalFileHierarchyStorage::updateDirEntry(
         mNodes[d.subfiles[i]]->row = n++ ;
     }
 
+    if(mNameIndexBuilt && mNameIndex.needsRebuild())
+        rebuildNameIndex();
 
     return true;
 }
@@ -646,6 +888,20 @@ bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& ind
         return false;
     }
 
+    if(mNodes.isMapped(index))
+    {
+        const MappedFileHierarchy::Node& n(mNodes.mapping()->node(index)) ;
+
+        if(m == &DirEntry::dir_modtime)
+            TS = n.modtime ;
+        else if(m == &DirEntry::dir_most_recent_time)
+            TS = n.most_recent_time ;
+        else
+            TS = n.update_time ;
+
+        return true;
+    }
+
     DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
 
     TS = d.*m ;
@@ -672,18 +928,43 @@ bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& ind
 
 uint64_t InternalFileHierarchyStorage::recursUpdateCumulatedSize(const DirectoryStorage::EntryIndex& dir_index)
 {
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[dir_index])) ;
+    return recursCumulatedSize(dir_index,NULL) ;
+}
 
+// Mapped dirs are not copied for this. Their size is saved with the next mapping.
+
+uint64_t InternalFileHierarchyStorage::recursCumulatedSize(DirectoryStorage::EntryIndex dir_index,std::vector<uint64_t> *sizes)
+{
     uint64_t local_cumulative_size = 0;
 
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-        if(mNodes[d.subfiles[i]])		// normally not needed, but an extra-security
-            local_cumulative_size += static_cast<FileEntry*>(mNodes[d.subfiles[i]])->file_size;
+    if(mNodes.isMapped(dir_index))
+    {
+        const MappedFileHierarchy::Node& n(mNodes.mapping()->node(dir_index)) ;
+        const uint32_t *children = mNodes.mapping()->children(dir_index) ;
 
-    for(uint32_t i=0;i<d.subdirs.size();++i)
-        local_cumulative_size += recursUpdateCumulatedSize(d.subdirs[i]);
+        for(uint32_t i=0;i<n.n_subfiles;++i)
+            local_cumulative_size += nodeFileSize(children[n.n_subdirs+i]) ;
+
+        for(uint32_t i=0;i<n.n_subdirs;++i)
+            local_cumulative_size += recursCumulatedSize(children[i],sizes) ;
+    }
+    else
+    {
+        DirEntry& d(*static_cast<DirEntry*>(mNodes[dir_index])) ;
+
+        for(uint32_t i=0;i<d.subfiles.size();++i)
+            if(nodeType(d.subfiles[i]) == FileStorageNode::TYPE_FILE)		// normally not needed, but an extra-security
+                local_cumulative_size += nodeFileSize(d.subfiles[i]);
+
+        for(uint32_t i=0;i<d.subdirs.size();++i)
+            local_cumulative_size += recursCumulatedSize(d.subdirs[i],sizes);
+
+        d.dir_cumulated_size = local_cumulative_size;
+    }
+
+    if(sizes != NULL)
+        (*sizes)[dir_index] = local_cumulative_size ;
 
-    d.dir_cumulated_size = local_cumulative_size;
     return local_cumulative_size;
 }
 // Do a complete recursive sweep over sub-directories and files, and update the lst modf TS. This could be also performed by a cleanup method.
@@ -747,10 +1028,72 @@ InternalFileHierarchyStorage::getFileEntry(DirectoryStorage::EntryIndex indx) co
 
     return static_cast<FileEntry*>(mNodes[indx]) ;
 }
+
+bool InternalFileHierarchyStorage::getDirEntry(DirectoryStorage::EntryIndex indx,DirEntry& de) const
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
+        return false ;
+
+    if(!mNodes.isMapped(indx))
+    {
+        const DirEntry& d(*static_cast<const DirEntry*>(mNodes[indx])) ;
+
+        de.dir_name             = d.dir_name ;
+        de.dir_parent_path      = d.dir_parent_path ;
+        de.dir_hash             = d.dir_hash ;
+        de.dir_cumulated_size   = d.dir_cumulated_size ;
+        de.dir_modtime          = d.dir_modtime ;
+        de.dir_most_recent_time = d.dir_most_recent_time ;
+        de.dir_update_time      = d.dir_update_time ;
+    }
+    else
+    {
+        const MappedFileHierarchy *mapping = mNodes.mapping() ;
+        const MappedFileHierarchy::Node& n(mapping->node(indx)) ;
+
+        de.dir_name             = mapping->name(indx) ;
+        de.dir_parent_path      = mapping->parentPath(indx) ;
+        de.dir_hash             = mapping->hash(indx) ;
+        de.dir_cumulated_size   = n.size ;
+        de.dir_modtime          = n.modtime ;
+        de.dir_most_recent_time = n.most_recent_time ;
+        de.dir_update_time      = n.update_time ;
+    }
+
+    de.parent_index = nodeParent(indx) ;
+    de.row          = nodeRow(indx) ;
+    de.subdirs.clear() ;
+    de.subfiles.clear() ;
+
+    return true ;
+}
+
+bool InternalFileHierarchyStorage::getFileEntry(DirectoryStorage::EntryIndex indx,FileEntry& fe) const
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_FILE))
+        return false ;
+
+    if(!mNodes.isMapped(indx))
+        fe = *static_cast<const FileEntry*>(mNodes[indx]) ;
+    else
+    {
+        const MappedFileHierarchy *mapping = mNodes.mapping() ;
+        const MappedFileHierarchy::Node& n(mapping->node(indx)) ;
+
+        fe.file_name    = mapping->name(indx) ;
+        fe.file_size    = n.size ;
+        fe.file_modtime = n.modtime ;
+        fe.file_hash    = mapping->hash(indx) ;
+        fe.parent_index = n.parent_index ;
+        fe.row          = n.row ;
+    }
+    return true ;
+}
+
 uint32_t InternalFileHierarchyStorage::getType(DirectoryStorage::EntryIndex indx) const
 {
     if(checkIndex(indx,FileStorageNode::TYPE_FILE | FileStorageNode::TYPE_DIR))
-        return mNodes[indx]->type() ;
+        return nodeType(indx) ;
     else
         return FileStorageNode::TYPE_UNKNOWN;
 }
@@ -760,6 +1103,16 @@ DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubFileIndex(Direc
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
+    if(mNodes.isMapped(parent_index))
+    {
+        const MappedFileHierarchy::Node& n(mNodes.mapping()->node(parent_index)) ;
+
+        if(n.n_subfiles <= file_tab_index)
+            return DirectoryStorage::NO_INDEX;
+
+        return mNodes.mapping()->children(parent_index)[n.n_subdirs + file_tab_index];
+    }
+
     if(static_cast<DirEntry*>(mNodes[parent_index])->subfiles.size() <= file_tab_index)
         return DirectoryStorage::NO_INDEX;
 
@@ -770,6 +1123,14 @@ DirectoryStorage::EntryIndex InternalFileHierarchyStorage::getSubDirIndex(Direct
     if(!checkIndex(parent_index,FileStorageNode::TYPE_DIR))
         return DirectoryStorage::NO_INDEX;
 
+    if(mNodes.isMapped(parent_index))
+    {
+        if(mNodes.mapping()->node(parent_index).n_subdirs <= dir_tab_index)
+            return DirectoryStorage::NO_INDEX;
+
+        return mNodes.mapping()->children(parent_index)[dir_tab_index];
+    }
+
     if(static_cast<DirEntry*>(mNodes[parent_index])->subdirs.size() <= dir_tab_index)
         return DirectoryStorage::NO_INDEX;
 
@@ -801,10 +1162,170 @@ private:
     const InternalFileHierarchyStorage::DirEntry& mDe ;
 };
 
+void InternalFileHierarchyStorage::rebuildNameIndex() const
+{
+    mNameIndex.clear();
+    mNameIndexBuilt = false ;
+
+    if(!useNameIndex())
+        return ;
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+            mNameIndex.insert(i,static_cast<const FileEntry*>(mNodes[i])->file_name) ;
+
+    mNameIndexBuilt = true ;
+}
+
+// The name index is only built when the hierarchy is first searched, so that friend lists that are never searched
+// do not pay for it. Once built, it is kept up to date by the update methods.
+
+const FileNameIndex *InternalFileHierarchyStorage::nameIndex() const
+{
+    if(!useNameIndex())
+        return NULL ;
+
+    if(!mNameIndexBuilt)
+        rebuildNameIndex();
+
+    return &mNameIndex ;
+}
+
+// Search only reports files that are referenced in mFileHashes, once per hash. This is what the former linear
+// search over mFileHashes did, and we keep it when answering from the name index.
+
+bool InternalFileHierarchyStorage::isSearchableFile(DirectoryStorage::EntryIndex indx) const
+{
+    if(nodeType(indx) != FileStorageNode::TYPE_FILE)
+        return false ;
+
+    DirectoryStorage::EntryIndex hash_index ;
+
+    return lookupFileHash(nodeHash(indx),hash_index) && hash_index == indx ;
+}
+
+// Computes a sorted superset of the files matching the expression, from the name conditions it contains. Returns
+// false when the expression cannot be narrowed down this way (e.g. it only constrains size or date).
+
+bool InternalFileHierarchyStorage::searchCandidates(const RsRegularExpression::Expression *exp,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    candidates.clear();
+
+    const FileNameIndex *index = nameIndex() ;
+
+    if(index == NULL)
+        return false ;
+
+    if(const RsRegularExpression::CompoundExpression *ce = dynamic_cast<const RsRegularExpression::CompoundExpression*>(exp))
+    {
+        if(ce->leftExpression() == NULL || ce->rightExpression() == NULL)
+            return false ;
+
+        std::vector<DirectoryStorage::EntryIndex> lc,rc ;
+        bool l = searchCandidates(ce->leftExpression(),lc) ;
+        bool r = searchCandidates(ce->rightExpression(),rc) ;
+
+        switch(ce->logicalOperator())
+        {
+        case RsRegularExpression::AndOp:
+            if(l && r) { candidates.swap(lc) ; FileNameIndex::intersect(candidates,rc) ; return true ; }
+            if(l)      { candidates.swap(lc) ; return true ; }
+            if(r)      { candidates.swap(rc) ; return true ; }
+            return false ;
+
+        case RsRegularExpression::OrOp:
+        case RsRegularExpression::XorOp:
+            if(!l || !r)
+                return false ;
+
+            candidates.swap(lc) ;
+            FileNameIndex::merge(candidates,rc) ;
+            return true ;
+
+        default:
+            return false ;
+        }
+    }
+
+    // Only names are indexed. ExtExpression also works on the name, but extensions are often shorter than a trigram.
+
+    const RsRegularExpression::NameExpression *ne = dynamic_cast<const RsRegularExpression::NameExpression*>(exp) ;
+
+    if(!ne || ne->stringTerms().empty())
+        return false ;
+
+    bool found_one = false ;
+
+    for(auto& term: ne->stringTerms())
+    {
+        std::vector<DirectoryStorage::EntryIndex> tc ;
+
+        if(!index->candidates(term,tc))
+        {
+            if(ne->stringOperator() == RsRegularExpression::ContainsAllStrings)
+                continue ;		// other terms still narrow the search
+
+            return false ;
+        }
+
+        if(!found_one)
+            candidates.swap(tc) ;
+        else if(ne->stringOperator() == RsRegularExpression::ContainsAllStrings)
+            FileNameIndex::intersect(candidates,tc) ;
+        else
+            FileNameIndex::merge(candidates,tc) ;
+
+        found_one = true ;
+    }
+    return found_one ;
+}
+
 int InternalFileHierarchyStorage::searchBoolExp(
         RsRegularExpression::Expression* exp,
         std::list<DirectoryStorage::EntryIndex>& results ) const
 {
+	std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+	if(searchCandidates(exp,candidates))
+	{
+		for(auto indx: std::as_const(candidates))
+			if(isSearchableFile(indx))
+				if(exp->eval(
+				            DirectoryStorageExprFileEntry(
+				                *static_cast<const FileEntry*>(mNodes[indx]),
+				                *static_cast<const DirEntry*>(mNodes[mNodes[indx]->parent_index])
+				                                      ) ))
+					results.push_back(indx);
+
+		return 0;
+	}
+
+	if(mNodes.mapping() != NULL)
+	{
+		/* Go through all entries, with copies of the mapped ones. Files of the
+		 * same directory are next to each other, so the parent is only copied
+		 * once for all of them. */
+		FileEntry fe ;
+		DirEntry parent("") ;
+		DirectoryStorage::EntryIndex parent_index = DirectoryStorage::NO_INDEX ;
+
+		for(uint32_t i=0;i<mNodes.size();++i)
+			if(isSearchableFile(i) && getFileEntry(i,fe))
+			{
+				if(fe.parent_index != parent_index)
+				{
+					if(!getDirEntry(fe.parent_index,parent))
+						continue ;
+
+					parent_index = fe.parent_index ;
+				}
+				if(exp->eval(DirectoryStorageExprFileEntry(fe,parent)))
+					results.push_back(i);
+			}
+
+		return 0;
+	}
+
 	for(auto& it: std::as_const(mFileHashes))
 		if(mNodes[it.second])
 			if(exp->eval(
@@ -817,10 +1338,99 @@ int InternalFileHierarchyStorage::searchBoolExp(
     return 0;
 }
 
+static bool fileNameMatchesTerms(const char *name_begin,const char *name_end,const std::list<std::string>& terms)
+{
+	/* Most file will just have file name stored, but single file shared
+	 * without a shared dir will contain full path instead of just the
+	 * name, so purify it to perform the search */
+	if(std::find(name_begin, name_end, '/') != name_end)
+	{
+		std::string _tParentDir, tFilename;
+		RsDirUtil::splitDirFromFile(
+		            std::string(name_begin, name_end), _tParentDir, tFilename );
+
+		return fileNameMatchesTerms(
+		            tFilename.data(), tFilename.data() + tFilename.size(), terms );
+	}
+
+	for(auto& termIt : std::as_const(terms))
+	{
+		/* always ignore case */
+		if(name_end != std::search(
+		            name_begin, name_end,
+		            termIt.begin(), termIt.end(),
+		            RsRegularExpression::CompareCharIC() ))
+			return true;
+	}
+	return false;
+}
+
+static bool fileNameMatchesTerms(const std::string& file_name,const std::list<std::string>& terms)
+{
+	return fileNameMatchesTerms(
+	            file_name.data(), file_name.data() + file_name.size(), terms );
+}
+
 int InternalFileHierarchyStorage::searchTerms(
         const std::list<std::string>& terms,
         std::list<DirectoryStorage::EntryIndex>& results ) const
 {
+	/* Terms are OR-ed, so the candidates are the union of the candidates of
+	 * each term. If one of them is too short for the index, fall back to the
+	 * linear search. */
+
+	std::vector<DirectoryStorage::EntryIndex> candidates ;
+	const FileNameIndex *index = terms.empty() ? NULL : nameIndex() ;
+	bool indexed = index != NULL ;
+
+	for(auto& termIt : std::as_const(terms))
+	{
+		if(!indexed)
+			break ;
+
+		std::vector<DirectoryStorage::EntryIndex> tc ;
+
+		if(!index->candidates(termIt,tc))
+		{
+			indexed = false ;
+			break ;
+		}
+		FileNameIndex::merge(candidates,tc) ;
+	}
+
+	if(indexed)
+	{
+		for(auto indx : std::as_const(candidates))
+			if(isSearchableFile(indx) && fileNameMatchesTerms(static_cast<const FileEntry*>(mNodes[indx])->file_name,terms))
+				results.push_back(indx);
+
+		return 0;
+	}
+
+	/* Mapped hierarchies have no name index: go through the entries tab, and
+	 * read the names of mapped files in place. */
+
+	if(const MappedFileHierarchy *mapping = mNodes.mapping())
+	{
+		for(uint32_t i=0;i<mNodes.size();++i)
+			if(mNodes.isMapped(i))
+			{
+				const MappedFileHierarchy::Node& n(mapping->node(i));
+
+				if( n.type == MappedFileHierarchy::TYPE_FILE &&
+				        fileNameMatchesTerms(mapping->nameData(i), mapping->nameData(i) + n.name_length, terms) &&
+				        isSearchableFile(i) )
+					results.push_back(i);
+			}
+			else if( mNodes[i] != NULL &&
+			         mNodes[i]->type() == FileStorageNode::TYPE_FILE &&
+			         fileNameMatchesTerms(static_cast<const FileEntry*>(mNodes[i])->file_name, terms) &&
+			         isSearchableFile(i) )
+				results.push_back(i);
+
+		return 0;
+	}
+
 	/* most entries are likely to be files, so we could do a linear search over
 	 * the entries tab. Instead we go through the table of hashes.*/
 
@@ -832,29 +1442,8 @@ int InternalFileHierarchyStorage::searchTerms(
 			rs_view_ptr<FileEntry> tFileEntry =
 			        static_cast<FileEntry*>(mNodes[it.second]);
 
-			/* Most file will just have file name stored, but single file shared
-			 * without a shared dir will contain full path instead of just the
-			 * name, so purify it to perform the search */
-			std::string tFilename = tFileEntry->file_name;
-			if(tFileEntry->file_name.find("/") != std::string::npos)
-			{
-				std::string _tParentDir;
-				RsDirUtil::splitDirFromFile(
-				            tFileEntry->file_name, _tParentDir, tFilename );
-			}
-
-			for(auto& termIt : std::as_const(terms))
-			{
-				/* always ignore case */
-				if(tFilename.end() != std::search(
-				            tFilename.begin(), tFilename.end(),
-				            termIt.begin(), termIt.end(),
-				            RsRegularExpression::CompareCharIC() ))
-				{
-					results.push_back(it.second);
-					break;
-				}
-			}
+			if(fileNameMatchesTerms(tFileEntry->file_name,terms))
+				results.push_back(it.second);
 		}
 	}
 	return 0;
@@ -877,7 +1466,29 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
     mFreeNodes.clear();
 
     for(uint32_t i=0;i<mNodes.size();++i)
-        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+    {
+        uint32_t type = nodeType(i) ;
+
+        if(type == FileStorageNode::TYPE_DIR && mNodes.isMapped(i))
+        {
+            // Mapped dirs are only copied when they need to be fixed.
+
+            const MappedFileHierarchy::Node& n(mNodes.mapping()->node(i)) ;
+            const uint32_t *children = mNodes.mapping()->children(i) ;
+            bool ok = true ;
+
+            for(uint32_t j=0;j<n.n_subdirs+n.n_subfiles && ok;++j)
+                ok = hits[children[j]] == 0 ;
+
+            if(ok)
+            {
+                for(uint32_t j=0;j<n.n_subdirs+n.n_subfiles;++j)
+                    hits[children[j]] = 1 ;
+                continue ;
+            }
+        }
+
+        if(type == FileStorageNode::TYPE_DIR)
         {
             // stamp the kids
             DirEntry& de = *static_cast<DirEntry*>(mNodes[i]) ;
@@ -923,11 +1534,12 @@ bool InternalFileHierarchyStorage::check(std::string& error_string) // checks co
                 }
             }
         }
-        else if( mNodes[i] == NULL )
+        else if( type == FileStorageNode::TYPE_UNKNOWN )
             mFreeNodes.push_back(i) ;
+    }
 
     for(uint32_t i=0;i<hits.size();++i)
-        if(hits[i] == 0 && mNodes[i] != NULL)
+        if(hits[i] == 0 && nodeType(i) != FileStorageNode::TYPE_UNKNOWN)
         {
             if(!bOrphean){ error_string += " - Orphean node!"; bOrphean = true;}
 
@@ -1126,6 +1738,141 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
     }
 }
 
+// Writes all nodes in the flat format, reading mapped nodes in place, saves them encrypted like the other file lists, and
+// maps the new data. Entry indices do not change, since they are used by the GUI and by pending sync requests.
+
+bool InternalFileHierarchyStorage::saveMapped(const std::string& fname)
+{
+    const MappedFileHierarchy *mapping = mNodes.mapping() ;
+    uint32_t n_nodes = mNodes.size() ;
+
+    std::vector<uint64_t> cumulated_sizes(n_nodes,0) ;
+    recursCumulatedSize(mRoot,&cumulated_sizes) ;
+
+    MappedFileHierarchy::Builder builder(n_nodes) ;
+
+    for(uint32_t i=0;i<n_nodes;++i)
+    {
+        uint32_t type = nodeType(i) ;
+
+        if(type == FileStorageNode::TYPE_UNKNOWN)
+        {
+            builder.addEmptyNode() ;
+            continue ;
+        }
+
+        RsFileHash hash = nodeHash(i) ;
+
+        if(mNodes.isMapped(i))
+        {
+            const MappedFileHierarchy::Node& n(mapping->node(i)) ;
+
+            if(type == FileStorageNode::TYPE_FILE)
+                builder.addFileNode(n.parent_index,n.row,mapping->nameData(i),n.name_length,n.size,n.modtime,hash) ;
+            else
+            {
+                const uint32_t *children = mapping->children(i) ;
+                std::string parent_path = mapping->parentPath(i) ;
+
+                builder.addDirNode(n.parent_index,n.row,mapping->nameData(i),n.name_length,parent_path.data(),parent_path.size(),
+                                   cumulated_sizes[i],n.modtime,n.most_recent_time,n.update_time,hash,
+                                   children,n.n_subdirs,children+n.n_subdirs,n.n_subfiles) ;
+            }
+        }
+        else if(type == FileStorageNode::TYPE_FILE)
+        {
+            const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
+
+            builder.addFileNode(fe.parent_index,fe.row,fe.file_name.data(),fe.file_name.size(),fe.file_size,fe.file_modtime,fe.file_hash) ;
+        }
+        else
+        {
+            const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
+
+            builder.addDirNode(de.parent_index,de.row,de.dir_name.data(),de.dir_name.size(),de.dir_parent_path.data(),de.dir_parent_path.size(),
+                               cumulated_sizes[i],de.dir_modtime,de.dir_most_recent_time,de.dir_update_time,de.dir_hash,
+                               de.subdirs.data(),de.subdirs.size(),de.subfiles.data(),de.subfiles.size()) ;
+        }
+
+        // Files that share a hash get a single entry. The one in use for searches and FT comes first.
+
+        DirectoryStorage::EntryIndex hash_index ;
+
+        if(type == FileStorageNode::TYPE_FILE)
+            builder.addFileHash(hash,i,lookupFileHash(hash,hash_index) && hash_index == i) ;
+        else
+            builder.addDirHash(hash,i) ;
+    }
+
+    std::vector<unsigned char> data ;
+
+    if(!builder.build(data,mTotalFiles,mTotalSize))
+        return false ;
+
+    if(data.size() > 0xffffffffull || !FileListIO::saveEncryptedDataToFile(fname,data.data(),data.size()))
+        return false ;
+
+    if(!mapData(data.data(),data.size()))
+        RS_WARN("saved file list ", fname, " cannot be mapped. Keeping it in memory.");
+
+    return true ;
+}
+
+bool InternalFileHierarchyStorage::loadMapped(const std::string& fname)
+{
+    unsigned char *data = NULL ;
+    uint32_t data_size = 0 ;
+
+    if(!FileListIO::loadEncryptedDataFromFile(fname,data,data_size))
+        return false ;
+
+    bool mapped_format = MappedFileHierarchy::isMappedData(data,data_size) ;
+    bool res = mapped_format && mapData(data,data_size) ;
+
+    free(data) ;
+
+    if(mapped_format)
+        return res ;
+
+    // Former format. Convert it right away, so that the heap nodes can be dropped.
+
+    if(!load(fname))
+        return false ;
+
+    RS_INFO("converting file list ", fname, " to the mapped format");
+
+    return saveMapped(fname) ;
+}
+
+bool InternalFileHierarchyStorage::mapData(const unsigned char *data,uint64_t size)
+{
+    MappedFileHierarchy *mapping = new MappedFileHierarchy ;
+
+    if(!mapping->open(data,size))
+    {
+        delete mapping ;
+        return false ;
+    }
+
+    mNodes.setMapping(mapping) ;
+
+    mFileHashes.clear() ;
+    mDirHashes.clear() ;
+    mNameIndex.clear() ;
+    mNameIndexBuilt = false ;
+    mFreeNodes.clear() ;
+
+    for(uint32_t i=0;i<mapping->nodeCount();++i)
+        if(mapping->node(i).type == MappedFileHierarchy::TYPE_EMPTY)
+            mFreeNodes.push_back(i) ;
+
+    mRoot = 0 ;
+    mTotalFiles = mapping->totalFiles() ;
+    mTotalSize = mapping->totalSize() ;
+
+    return true ;
+}
+
 bool InternalFileHierarchyStorage::load(const std::string& fname)
 {
     unsigned char *buffer = NULL ;
@@ -1152,11 +1899,7 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
         // Write all file/dir entries
 
-        for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i])
-                delete mNodes[i] ;
-
-        mNodes.clear();
+        mNodes.clear();		// also deletes the nodes
         mNodes.resize(n_nodes,NULL) ;
 
         for(uint32_t i=0;i<mNodes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
@@ -1271,6 +2014,10 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
         if(!check(err_str))
             std::cerr << "(EE) Error while loading file hierarchy " << fname << std::endl;
 
+        // The name index is built when the hierarchy is first searched.
+
+        mNameIndex.clear();
+        mNameIndexBuilt = false ;
         recursUpdateCumulatedSize(mRoot);
 
         return true ;
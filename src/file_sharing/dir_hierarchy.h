@@ -24,8 +24,11 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unordered_map>
 
 #include "directory_storage.h"
+#include "filename_index.h"
+#include "mapped_hierarchy.h"
 
 class InternalFileHierarchyStorage
 {
@@ -82,12 +85,63 @@ public:
         rstime_t dir_update_time;		// last time the information was updated for that directory. Includes subdirs indexes and subfile info.
     };
 
+    /*!
+     * \brief The NodeTable class
+     * 		Table of nodes indexed by EntryIndex, that behaves like a vector of node pointers. It can sit on top of a mapped
+     * 		hierarchy: mapped nodes are only copied into heap nodes when accessed through operator[], which is what the
+     * 		modification routines do. Read-only methods of the storage use isMapped() to read mapped nodes in place.
+     */
+    class NodeTable
+    {
+    public:
+        NodeTable() : mMapping(NULL), mMappedCount(0) {}
+        ~NodeTable() { clear() ; }
+
+        uint32_t size() const { return mMappedCount + mTail.size() ; }
+        bool empty() const { return size() == 0 ; }
+
+        void clear() ;											// deletes all nodes, and the mapping
+        void resize(uint32_t n,FileStorageNode *node = NULL) ;	// only changes the nodes above the mapped ones
+        void push_back(FileStorageNode *node) { mTail.push_back(node) ; }
+
+        FileStorageNode *& back() { return (*this)[size()-1] ; }
+        FileStorageNode *& operator[](uint32_t i) ;
+        FileStorageNode *  operator[](uint32_t i) const ;
+
+        // Clears the table and makes it point to the given mapping, which the table now owns.
+
+        void setMapping(MappedFileHierarchy *mapping) ;
+        const MappedFileHierarchy *mapping() const { return mMapping ; }
+
+        // True when the node at index i has never been copied out of the mapping.
+
+        bool isMapped(uint32_t i) const { return i < mMappedCount && mCopied.find(i) == mCopied.end() ; }
+
+    private:
+        NodeTable(const NodeTable&) = delete ;
+        NodeTable& operator=(const NodeTable&) = delete ;
+
+        FileStorageNode *& copyMappedNode(uint32_t i) const ;
+
+        MappedFileHierarchy *mMapping ;
+        uint32_t mMappedCount ;
+        mutable std::unordered_map<uint32_t,FileStorageNode*> mCopied ;	// mapped nodes that have been copied to the heap, or deleted
+        std::vector<FileStorageNode*> mTail ;							// nodes created after the mapping
+    };
+
     // class stuff
     InternalFileHierarchyStorage() ;
 
     bool load(const std::string& fname) ;
     bool save(const std::string& fname) ;
 
+    // Flat memory-mapped format, used for friend file lists. The file is encrypted, and decrypted into a read-only
+    // mapping when loaded. Saving maps the new data and drops the heap nodes. loadMapped() converts files saved by
+    // save() to the new format.
+
+    bool loadMapped(const std::string& fname) ;
+    bool saveMapped(const std::string& fname) ;
+
     int parentRow(DirectoryStorage::EntryIndex e);
     bool isIndexValid(DirectoryStorage::EntryIndex e) const;
     bool getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const;
@@ -124,7 +178,7 @@ public:
 
     uint32_t mRoot ;
     std::list<uint32_t > mFreeNodes ;	// keeps a list of free nodes in order to make insert effcieint
-    std::vector<FileStorageNode*> mNodes;// uses pointers to keep information about valid/invalid objects.
+    NodeTable mNodes;// uses pointers to keep information about valid/invalid objects.
 
     void compress() ;					// use empty space in the vector, mostly due to deleted entries. This is a complicated operation, mostly due to
                                             // all the indirections used. Nodes need to be moved, renamed, etc. The operation discards all file entries that
@@ -138,11 +192,17 @@ public:
     const FileStorageNode *getNode(DirectoryStorage::EntryIndex indx) const;
     const DirEntry *getDirEntry(DirectoryStorage::EntryIndex indx) const;
     const FileEntry *getFileEntry(DirectoryStorage::EntryIndex indx) const;
+
+    // Same, but copy the entry, so that mapped nodes are not copied to the heap. Subdirs and subfiles are not copied.
+
+    bool getDirEntry(DirectoryStorage::EntryIndex indx,DirEntry& de) const;
+    bool getFileEntry(DirectoryStorage::EntryIndex indx,FileEntry& fe) const;
     uint32_t getType(DirectoryStorage::EntryIndex indx) const;
     DirectoryStorage::EntryIndex getSubFileIndex(DirectoryStorage::EntryIndex parent_index,uint32_t file_tab_index);
     DirectoryStorage::EntryIndex getSubDirIndex(DirectoryStorage::EntryIndex parent_index,uint32_t dir_tab_index);
 
-    // search. SearchHash is logarithmic. The other two are linear.
+    // search. SearchHash is logarithmic. The other two look up file names in the trigram index when
+    // the terms are long enough, and are linear otherwise. Mapped hierarchies have no trigram index.
 
     bool searchHash(const RsFileHash& hash, DirectoryStorage::EntryIndex &result);
     int searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const ;
@@ -175,10 +235,43 @@ private:
 
     bool recursRemoveDirectory(DirectoryStorage::EntryIndex dir);
 
+    // Read access to nodes that works on mapped nodes without copying them.
+
+    uint32_t nodeType(DirectoryStorage::EntryIndex indx) const;
+    DirectoryStorage::EntryIndex nodeParent(DirectoryStorage::EntryIndex indx) const;
+    uint32_t nodeRow(DirectoryStorage::EntryIndex indx) const;
+    RsFileHash nodeHash(DirectoryStorage::EntryIndex indx) const;
+    std::string nodeName(DirectoryStorage::EntryIndex indx) const;
+    rstime_t nodeModTime(DirectoryStorage::EntryIndex indx) const;
+    uint64_t nodeFileSize(DirectoryStorage::EntryIndex indx) const;
+
+    // Computes the cumulated size of all dirs below dir_index, and stores it in heap nodes and, if not null, in sizes.
+
+    uint64_t recursCumulatedSize(DirectoryStorage::EntryIndex dir_index,std::vector<uint64_t> *sizes);
+
+    // Replaces all nodes with the content of the given mapped hierarchy data, which is copied.
+
+    bool mapData(const unsigned char *data,uint64_t size);
+
+    // Hash lookups in the heap maps first, then in the mapping. The mapped hash index cannot be updated, so mapped
+    // results are checked against the node before being returned.
+
+    bool lookupFileHash(const RsFileHash& hash,DirectoryStorage::EntryIndex& index) const;
+    bool lookupMappedHash(const RsFileHash& hash,uint32_t type,DirectoryStorage::EntryIndex& index) const;
+
+    // File name index maintenance and lookup.
+
+    void rebuildNameIndex() const;
+    const FileNameIndex *nameIndex() const;
+    bool useNameIndex() const { return mNodes.mapping() == NULL ; }
+    bool searchCandidates(const RsRegularExpression::Expression *exp,std::vector<DirectoryStorage::EntryIndex>& candidates) const;
+    bool isSearchableFile(DirectoryStorage::EntryIndex indx) const;
+
     // Map of the hash of all files. The file hashes are the sha1sum of the file data.
     // is used for fast search access for FT.
     // Note: We should try something faster than std::map. hash_map??
     // Unlike directories, multiple files may have the same hash. So this cannot be used for anything else than FT.
+    // When the hierarchy is mapped, this and mDirHashes only hold the entries that changed since the file was mapped.
 
     std::map<RsFileHash,DirectoryStorage::EntryIndex> mFileHashes ;
 
@@ -191,6 +284,12 @@ private:
     //
     std::map<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
 
+    // Trigram index of file names, built on the first search and then kept up to date when files are added, renamed
+    // or deleted. Searches are const, hence the mutable.
+
+    mutable FileNameIndex mNameIndex ;
+    mutable bool mNameIndexBuilt ;
+
     // high level statistics on the full hierarchy. Should be kept up to date.
 
     uint32_t mTotalFiles ;
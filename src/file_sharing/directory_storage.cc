@@ -22,9 +22,12 @@
  *                                                                             *
  ******************************************************************************/
 #include <set>
+#include <algorithm>
+#include <iterator>
 
 #include "util/rstime.h"
 #include "serialiser/rstlvbinary.h"
+#include "serialiser/rsbaseserial.h"
 #include "retroshare/rspeers.h"
 #include "util/rsdir.h"
 #include "util/rsstring.h"
@@ -79,19 +82,24 @@ DirectoryStorage::EntryIndex DirectoryStorage::DirIterator::operator*() const
 DirectoryStorage::FileIterator::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 DirectoryStorage::DirIterator ::operator bool() const { return **this != DirectoryStorage::NO_INDEX; }
 
-RsFileHash  DirectoryStorage::FileIterator::hash()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_hash):RsFileHash(); }
-uint64_t    DirectoryStorage::FileIterator::size()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_size):0; }
-std::string DirectoryStorage::FileIterator::name()     const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_name):std::string(); }
-rstime_t      DirectoryStorage::FileIterator::modtime()  const { const InternalFileHierarchyStorage::FileEntry *f = mStorage->getFileEntry(**this) ; return f?(f->file_modtime):0; }
+// Fields are read one by one, so that browsing neither copies whole entries nor nodes of mapped hierarchies to the heap.
 
-std::string DirectoryStorage::DirIterator::name()      const { const InternalFileHierarchyStorage::DirEntry *d = mStorage->getDirEntry(**this) ; return d?(d->dir_name):std::string(); }
+bool DirectoryStorage::FileIterator::isFile() const { return mStorage->nodeType(**this) == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE; }
+bool DirectoryStorage::DirIterator ::isDir()  const { return mStorage->nodeType(**this) == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR; }
+
+RsFileHash  DirectoryStorage::FileIterator::hash()     const { return isFile()?mStorage->nodeHash(**this):RsFileHash(); }
+uint64_t    DirectoryStorage::FileIterator::size()     const { return isFile()?mStorage->nodeFileSize(**this):0; }
+std::string DirectoryStorage::FileIterator::name()     const { return isFile()?mStorage->nodeName(**this):std::string(); }
+rstime_t      DirectoryStorage::FileIterator::modtime()  const { return isFile()?mStorage->nodeModTime(**this):0; }
+
+std::string DirectoryStorage::DirIterator::name()      const { return isDir()?mStorage->nodeName(**this):std::string(); }
 
 /******************************************************************************************************************/
 /*                                                 Directory Storage                                              */
 /******************************************************************************************************************/
 
-DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname)
-    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
+DirectoryStorage::DirectoryStorage(const RsPeerId &pid, const std::string& fname, bool mapped_format)
+    : mPeerId(pid), mMappedFormat(mapped_format), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
 {
 	{
 		RS_STACK_MUTEX(mDirStorageMtx) ;
@@ -180,12 +188,20 @@ bool DirectoryStorage::load(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
     mChanged = false ;
-    return mFileHierarchy->load(local_file_name);
+
+    if(mMappedFormat)
+        return mFileHierarchy->loadMapped(local_file_name);
+    else
+        return mFileHierarchy->load(local_file_name);
 }
 void DirectoryStorage::save(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->save(local_file_name);
+
+    if(mMappedFormat)
+        mFileHierarchy->saveMapped(local_file_name);
+    else
+        mFileHierarchy->save(local_file_name);
 }
 void DirectoryStorage::print()
 {
@@ -217,7 +233,8 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 
     if (type == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR) /* has children --- fill */
     {
-        const InternalFileHierarchyStorage::DirEntry *dir_entry = mFileHierarchy->getDirEntry(indx) ;
+        InternalFileHierarchyStorage::DirEntry dir_entry("") ;
+        mFileHierarchy->getDirEntry(indx,dir_entry) ;
 
         /* extract all the entries */
 
@@ -243,12 +260,12 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 
         d.type = DIR_TYPE_DIR;
         d.hash.clear() ;
-        d.size   = dir_entry->dir_cumulated_size;//dir_entry->subdirs.size() + dir_entry->subfiles.size();
-        d.max_mtime = dir_entry->dir_most_recent_time ;
-        d.mtime     = dir_entry->dir_modtime ;
-        d.name    = dir_entry->dir_name;
-		d.path    = RsDirUtil::makePath(dir_entry->dir_parent_path, dir_entry->dir_name) ;
-        d.parent  = (void*)(intptr_t)dir_entry->parent_index ;
+        d.size   = dir_entry.dir_cumulated_size;//dir_entry.subdirs.size() + dir_entry.subfiles.size();
+        d.max_mtime = dir_entry.dir_most_recent_time ;
+        d.mtime     = dir_entry.dir_modtime ;
+        d.name    = dir_entry.dir_name;
+		d.path    = RsDirUtil::makePath(dir_entry.dir_parent_path, dir_entry.dir_name) ;
+        d.parent  = (void*)(intptr_t)dir_entry.parent_index ;
 
         if(indx == 0)
         {
@@ -258,20 +275,21 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     }
     else if(type == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
     {
-        const InternalFileHierarchyStorage::FileEntry *file_entry = mFileHierarchy->getFileEntry(indx) ;
+        InternalFileHierarchyStorage::FileEntry file_entry ;
+        mFileHierarchy->getFileEntry(indx,file_entry) ;
 
         d.type    = DIR_TYPE_FILE;
-        d.size   = file_entry->file_size;
-        d.max_mtime = file_entry->file_modtime ;
-        d.name    = file_entry->file_name;
-        d.hash    = file_entry->file_hash;
-        d.mtime     = file_entry->file_modtime;
-        d.parent  = (void*)(intptr_t)file_entry->parent_index ;
+        d.size   = file_entry.file_size;
+        d.max_mtime = file_entry.file_modtime ;
+        d.name    = file_entry.file_name;
+        d.hash    = file_entry.file_hash;
+        d.mtime     = file_entry.file_modtime;
+        d.parent  = (void*)(intptr_t)file_entry.parent_index ;
 
-        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = mFileHierarchy->getDirEntry(file_entry->parent_index);
+        InternalFileHierarchyStorage::DirEntry parent_dir_entry("") ;
 
-        if(parent_dir_entry != NULL)
-			d.path = RsDirUtil::makePath(parent_dir_entry->dir_parent_path, parent_dir_entry->dir_name) ;
+        if(mFileHierarchy->getDirEntry(file_entry.parent_index,parent_dir_entry))
+			d.path = RsDirUtil::makePath(parent_dir_entry.dir_parent_path, parent_dir_entry.dir_name) ;
         else
             d.path = "" ;
     }
@@ -746,27 +764,125 @@ std::string LocalDirectoryStorage::locked_getVirtualPath(EntryIndex indx) const
    return it->second.virtualname + "/" + res;
 }
 
-bool LocalDirectoryStorage::serialiseDirEntry(
-        const EntryIndex& indx, RsTlvBinaryData& bindata,
-        const RsPeerId& client_id )
+/* Fingerprint of a file entry as seen by friends. Both sides compute it from the
+ * fields that are actually transmitted, so that a friend can tell us which files
+ * it already knows in a directory without sending them back. */
+static uint64_t fileEntryFingerprint(const InternalFileHierarchyStorage::FileEntry& f)
 {
-	RS_STACK_MUTEX(mDirStorageMtx);
+	std::vector<uint8_t> buff(f.file_name.begin(),f.file_name.end());
+	uint32_t offset = buff.size();
+
+	buff.resize(offset + 8 + RsFileHash::SIZE_IN_BYTES + 4);
+
+	setRawUInt64(buff.data(),buff.size(),&offset,f.file_size);
+	memcpy(&buff[offset],f.file_hash.toByteArray(),RsFileHash::SIZE_IN_BYTES);
+	offset += RsFileHash::SIZE_IN_BYTES;
+	setRawUInt32(buff.data(),buff.size(),&offset,(uint32_t)f.file_modtime);
+
+	Sha1CheckSum h = RsDirUtil::sha1sum(buff.data(),buff.size());
+
+	uint64_t res = 0;
+	for(uint32_t i=0;i<8;++i)
+		res = (res << 8) | h.toByteArray()[i];
+
+	return res;
+}
+
+static void packFingerprints(const std::vector<uint64_t>& fps,RsTlvBinaryData& bindata)
+{
+	std::vector<uint8_t> buff(8*fps.size());
+	uint32_t offset = 0;
+
+	for(uint32_t i=0;i<fps.size();++i)
+		setRawUInt64(buff.data(),buff.size(),&offset,fps[i]);
+
+	bindata.setBinData(buff.data(),buff.size());
+}
+
+static bool unpackFingerprints(const unsigned char *data,uint32_t size,std::vector<uint64_t>& fps)
+{
+	fps.clear();
+
+	if(size % 8 != 0)
+		return false;
+
+	uint32_t offset = 0;
+	uint64_t fp;
+
+	while(offset < size)
+		if(getRawUInt64(const_cast<unsigned char*>(data),size,&offset,&fp))
+			fps.push_back(fp);
+		else
+			return false;
+
+	std::sort(fps.begin(),fps.end());
+	fps.erase(std::unique(fps.begin(),fps.end()),fps.end());
+
+	return true;
+}
+
+static bool writeRemoteFileEntry(
+        unsigned char*& section_data, uint32_t& section_size,
+        uint32_t& section_offset, unsigned char*& file_section_data,
+        uint32_t& file_section_size,
+        const InternalFileHierarchyStorage::FileEntry& file )
+{
+	uint32_t file_section_offset = 0;
+
+	if(!FileListIO::writeField(
+	            file_section_data, file_section_size, file_section_offset,
+	            FILE_LIST_IO_TAG_FILE_NAME, file.file_name )) return false;
+	if(!FileListIO::writeField(
+	            file_section_data, file_section_size, file_section_offset,
+	            FILE_LIST_IO_TAG_FILE_SIZE, file.file_size )) return false;
+	if(!FileListIO::writeField(
+	            file_section_data, file_section_size, file_section_offset,
+	            FILE_LIST_IO_TAG_FILE_SHA1_HASH, file.file_hash )) return false;
+	if(!FileListIO::writeField(
+	            file_section_data, file_section_size, file_section_offset,
+	            FILE_LIST_IO_TAG_MODIF_TS, (uint32_t)file.file_modtime ))
+		return false;
+
+	// now write the whole string into a single section in the file
+	return FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,
+	            file_section_data, file_section_offset );
+}
+
+static bool readRemoteFileEntry(const unsigned char *section_data,uint32_t section_size,uint32_t& section_offset,unsigned char *& file_section_data,uint32_t& file_section_size,InternalFileHierarchyStorage::FileEntry& f)
+{
+    // Read the full data section for the file
+
+    if(!FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,file_section_data,file_section_size)) return false ;
+
+    uint32_t file_section_offset = 0 ;
+    uint32_t modtime =0;
 
+    if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,f.file_name   )) return false ;
+    if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,f.file_size   )) return false ;
+    if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,f.file_hash   )) return false ;
+    if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,modtime       )) return false ;
+
+    f.file_modtime = modtime ;
+
+    return true ;
+}
+
+bool LocalDirectoryStorage::locked_getBrowsableDirContent(
+        const EntryIndex& indx, const RsPeerId& client_id,
+        std::vector<RsFileHash>& allowed_subdirs,
+        std::vector<EntryIndex>& allowed_subfiles )
+{
 	const InternalFileHierarchyStorage::DirEntry* dir =
 	        mFileHierarchy->getDirEntry(indx);
 
-#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-    std::cerr << "Serialising Dir entry " << std::hex << indx << " for client id " << client_id << std::endl;
-#endif
-
 	if(!dir)
 	{
 		RS_ERR("Cannot find entry ", indx);
 		return false;
 	}
 
-	// compute list of allowed subdirs
-	std::vector<RsFileHash> allowed_subdirs;
 	FileStorageFlags node_flags;
 	std::list<RsNodeGroupId> node_groups;
 
@@ -798,28 +914,72 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 		}
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
         else
-            std::cerr << "  not pushing subdir " << hash << ", array position=" << i << " indx=" << dir->subdirs[i] << ": permission denied for this peer." << std::endl;
+            std::cerr << "  not pushing subdir " << dir->subdirs[i] << ", array position=" << i << ": permission denied for this peer." << std::endl;
 #endif
 
-	/* now count the files that do not have a null hash (meaning the hash has
+	/* now keep the files that do not have a null hash (meaning the hash has
 	 * indeed been computed), also in case files are shared singularly (without
 	 * a shared directory) so they are child of root check browsability
 	 * permission */
-	uint32_t allowed_subfiles = 0;
 	for(uint32_t i=0; i<dir->subfiles.size(); ++i)
 	{
 		const InternalFileHierarchyStorage::FileEntry* file =
 		        mFileHierarchy->getFileEntry(dir->subfiles[i]);
-		if(file != nullptr && !file->file_hash.isNull()
-		        && ( indx !=0 || (
-		                 locked_getFileSharingPermissions(
-		                     dir->subfiles[i], node_flags, node_groups ) &&
-		                 rsPeers->computePeerPermissionFlags(
-		                     client_id, node_flags, node_groups ) &
-		                 RS_FILE_HINTS_BROWSABLE ) ))
-			allowed_subfiles++;
+
+		if(file == nullptr || file->file_hash.isNull())
+		{
+			RS_INFO( "skipping unhashed or Null file entry ",
+			         dir->subfiles[i], " to get/send file info." );
+			continue;
+		}
+
+		if(indx == 0)
+		{
+			if(!locked_getFileSharingPermissions(
+			            dir->subfiles[i], node_flags, node_groups ))
+			{
+				RS_ERR( "Failure getting sharing permission for single file: ",
+				        dir->subfiles[i] );
+				print_stacktrace();
+				continue;
+			}
+
+			if(!( rsPeers->computePeerPermissionFlags(
+			          client_id, node_flags, node_groups ) &
+			      RS_FILE_HINTS_BROWSABLE ))
+			{
+				RS_INFO( "Skipping single file shared without browse "
+				         "permission" );
+				continue;
+			}
+		}
+
+		allowed_subfiles.push_back(dir->subfiles[i]);
 	}
 
+	return true;
+}
+
+bool LocalDirectoryStorage::serialiseDirEntry(
+        const EntryIndex& indx, RsTlvBinaryData& bindata,
+        const RsPeerId& client_id )
+{
+	RS_STACK_MUTEX(mDirStorageMtx);
+
+#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
+    std::cerr << "Serialising Dir entry " << std::hex << indx << " for client id " << client_id << std::endl;
+#endif
+
+	std::vector<RsFileHash> allowed_subdirs;
+	std::vector<EntryIndex> allowed_subfiles;
+
+	if(!locked_getBrowsableDirContent(
+	            indx, client_id, allowed_subdirs, allowed_subfiles ))
+		return false;
+
+	const InternalFileHierarchyStorage::DirEntry* dir =
+	        mFileHierarchy->getDirEntry(indx);
+
 	unsigned char* section_data = (unsigned char *)
 	        rs_malloc(FL_BASE_TMP_SECTION_SIZE);
 	if(!section_data) return false;
@@ -858,7 +1018,7 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 	{ free(section_data); return false; }
 	if(!FileListIO::writeField(
 	            section_data, section_size, section_offset,
-	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)allowed_subfiles ))
+	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)allowed_subfiles.size() ))
 	{ free(section_data); return false; }
 
 	// serialise subdirs entry indexes
@@ -880,67 +1040,16 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 
 	uint32_t file_section_size = FL_BASE_TMP_SECTION_SIZE;
 
-	for(uint32_t i=0; i<dir->subfiles.size(); ++i)
+	for(uint32_t i=0; i<allowed_subfiles.size(); ++i)
 	{
-		uint32_t file_section_offset = 0;
-
-		const InternalFileHierarchyStorage::FileEntry* file =
-		        mFileHierarchy->getFileEntry(dir->subfiles[i]);
-
-		if(file == nullptr || file->file_hash.isNull())
-		{
-			RS_INFO( "skipping unhashed or Null file entry ",
-			         dir->subfiles[i], " to get/send file info." );
-			continue;
-		}
-
-		if(indx == 0)
-		{
-			if(!locked_getFileSharingPermissions(
-			            dir->subfiles[i], node_flags, node_groups ))
-			{
-				RS_ERR( "Failure getting sharing permission for single file: ",
-				        dir->subfiles[i] );
-				print_stacktrace();
-				continue;
-			}
-
-			if(!( rsPeers->computePeerPermissionFlags(
-			          client_id, node_flags, node_groups ) &
-			      RS_FILE_HINTS_BROWSABLE ))
-			{
-				RS_INFO( "Skipping single file shared without browse "
-				         "permission" );
-				continue;
-			}
-		}
-
-		if(!FileListIO::writeField(
-		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_NAME, file->file_name ))
-		{ free(section_data); free(file_section_data); return false; }
-		if(!FileListIO::writeField(
-		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_SIZE, file->file_size ))
-		{ free(section_data); free(file_section_data); return false; }
-		if(!FileListIO::writeField(
-		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_FILE_SHA1_HASH, file->file_hash ))
-		{ free(section_data); free(file_section_data); return false; }
-		if(!FileListIO::writeField(
-		            file_section_data, file_section_size, file_section_offset,
-		            FILE_LIST_IO_TAG_MODIF_TS, (uint32_t)file->file_modtime ))
-		{ free(section_data); free(file_section_data); return false; }
-
-		// now write the whole string into a single section in the file
-		if(!FileListIO::writeField(
+		if(!writeRemoteFileEntry(
 		            section_data, section_size, section_offset,
-		            FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,
-		            file_section_data, file_section_offset ))
+		            file_section_data, file_section_size,
+		            *mFileHierarchy->getFileEntry(allowed_subfiles[i]) ))
 		{ free(section_data); free(file_section_data); return false; }
 
 #ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-        std::cerr << "  pushing subfile " << file->hash << ", array position=" << i << " indx=" << dir->subfiles[i] << std::endl;
+        std::cerr << "  pushing subfile " << allowed_subfiles[i] << ", array position=" << i << std::endl;
 #endif
 	}
 	free(file_section_data);
@@ -956,13 +1065,147 @@ bool LocalDirectoryStorage::serialiseDirEntry(
 	return true;
 }
 
+bool LocalDirectoryStorage::serialiseDirEntryDelta(
+        const EntryIndex& indx, const RsTlvBinaryData& known_entries,
+        RsTlvBinaryData& bindata, const RsPeerId& client_id )
+{
+	std::vector<uint64_t> known_fps;
+
+	if(!unpackFingerprints( (unsigned char*)known_entries.bin_data,
+	                        known_entries.bin_len, known_fps ))
+	{
+		RS_ERR("Malformed list of known entries from ", client_id);
+		return false;
+	}
+
+	RS_STACK_MUTEX(mDirStorageMtx);
+
+	std::vector<RsFileHash> allowed_subdirs;
+	std::vector<EntryIndex> allowed_subfiles;
+
+	if(!locked_getBrowsableDirContent(
+	            indx, client_id, allowed_subdirs, allowed_subfiles ))
+		return false;
+
+	const InternalFileHierarchyStorage::DirEntry* dir =
+	        mFileHierarchy->getDirEntry(indx);
+
+	/* Split the files into the ones the client already has (same name, size,
+	 * hash and modification time) and the ones it needs. Whatever the client
+	 * knows and we do not have anymore is reported as removed. */
+
+	std::vector<uint64_t> kept_fps;
+	std::vector<const InternalFileHierarchyStorage::FileEntry*> added_subfiles;
+
+	for(uint32_t i=0; i<allowed_subfiles.size(); ++i)
+	{
+		const InternalFileHierarchyStorage::FileEntry* file =
+		        mFileHierarchy->getFileEntry(allowed_subfiles[i]);
+		uint64_t fp = fileEntryFingerprint(*file);
+
+		if(std::binary_search(known_fps.begin(),known_fps.end(),fp))
+			kept_fps.push_back(fp);
+		else
+			added_subfiles.push_back(file);
+	}
+	std::sort(kept_fps.begin(),kept_fps.end());
+
+	std::vector<uint64_t> removed_fps;
+	std::set_difference( known_fps.begin(), known_fps.end(),
+	                     kept_fps.begin(), kept_fps.end(),
+	                     std::back_inserter(removed_fps) );
+
+	unsigned char* section_data = (unsigned char *)
+	        rs_malloc(FL_BASE_TMP_SECTION_SIZE);
+	if(!section_data) return false;
+
+	uint32_t section_size = FL_BASE_TMP_SECTION_SIZE;
+	uint32_t section_offset = 0;
+
+	/* Same layout as serialiseDirEntry(), except that the file count is
+	 * followed by the number of removed and added files, and that the subdirs
+	 * are followed by the fingerprints of removed files. Only added/changed
+	 * files are sent. */
+
+	std::string virtual_dir_name = locked_getVirtualDirName(indx);
+
+	bool ok = FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_DIR_NAME, virtual_dir_name )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_RECURS_MODIF_TS,
+	            (uint32_t)dir->dir_most_recent_time )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_MODIF_TS, (uint32_t)dir->dir_modtime )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)allowed_subdirs.size() )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)allowed_subfiles.size() )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)removed_fps.size() )
+	        && FileListIO::writeField(
+	            section_data, section_size, section_offset,
+	            FILE_LIST_IO_TAG_RAW_NUMBER, (uint32_t)added_subfiles.size() );
+
+	for(uint32_t i=0; ok && i<allowed_subdirs.size(); ++i)
+		ok = FileListIO::writeField(
+		            section_data, section_size, section_offset,
+		            FILE_LIST_IO_TAG_ENTRY_INDEX, allowed_subdirs[i] );
+
+	for(uint32_t i=0; ok && i<removed_fps.size(); ++i)
+		ok = FileListIO::writeField(
+		            section_data, section_size, section_offset,
+		            FILE_LIST_IO_TAG_FILE_FINGERPRINT, removed_fps[i] );
+
+	unsigned char* file_section_data =
+	        (unsigned char *) rs_malloc(FL_BASE_TMP_SECTION_SIZE);
+	uint32_t file_section_size = FL_BASE_TMP_SECTION_SIZE;
+
+	ok = ok && file_section_data != nullptr;
+
+	for(uint32_t i=0; ok && i<added_subfiles.size(); ++i)
+		ok = writeRemoteFileEntry(
+		            section_data, section_size, section_offset,
+		            file_section_data, file_section_size, *added_subfiles[i] );
+
+	free(file_section_data);
+
+	unsigned char *compressed_data = nullptr;
+	uint32_t compressed_size = 0;
+
+	ok = ok && FileListIO::compressData(
+	            section_data, section_offset, compressed_data, compressed_size );
+
+	free(section_data);
+
+	if(!ok)
+	{
+		RS_ERR("Cannot serialise delta of dir entry ", indx);
+		return false;
+	}
+
+#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
+    std::cerr << "Serialised delta for entry index " << (void*)(intptr_t)indx << ": " << added_subfiles.size() << " added, " << removed_fps.size() << " removed, " << section_offset << " bytes compressed into " << compressed_size << std::endl;
+#endif
+
+	bindata.bin_data = compressed_data;
+	bindata.bin_len = compressed_size;
+
+	return true;
+}
+
 
 /******************************************************************************************************************/
 /*                                           Remote Directory Storage                                              */
 /******************************************************************************************************************/
 
 RemoteDirectoryStorage::RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname)
-    : DirectoryStorage(pid,fname)
+    : DirectoryStorage(pid,fname,true)
 {
     mLastSweepTime = time(NULL) - (RSRandom::random_u32() % DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP) ;
 
@@ -1034,21 +1277,9 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
 
     for(uint32_t i=0;i<n_subfiles;++i)
     {
-        // Read the full data section for the file
-
-        if(!FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,file_section_data,file_section_size)) { free(file_section_data); return false ; }
-
-        uint32_t file_section_offset = 0 ;
-
         InternalFileHierarchyStorage::FileEntry f;
-        uint32_t modtime =0;
-
-        if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,f.file_name   )) { free(file_section_data); return false ; }
-        if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,f.file_size   )) { free(file_section_data); return false ; }
-        if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,f.file_hash   )) { free(file_section_data); return false ; }
-        if(!FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,modtime       )) { free(file_section_data); return false ; }
 
-        f.file_modtime = modtime ;
+        if(!readRemoteFileEntry(section_data,section_size,section_offset,file_section_data,file_section_size,f)) { free(file_section_data); return false ; }
 
         subfiles_array.push_back(f) ;
     }
@@ -1071,6 +1302,131 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
     return true ;
 }
 
+bool RemoteDirectoryStorage::getKnownEntries(const EntryIndex& indx,RsTlvBinaryData& known_entries) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(mFileHierarchy->getType(indx) != InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
+        return false ;
+
+    std::vector<uint64_t> fps ;
+    InternalFileHierarchyStorage::FileEntry f ;
+    EntryIndex e ;
+
+    for(uint32_t i=0;(e = mFileHierarchy->getSubFileIndex(indx,i)) != NO_INDEX;++i)
+        if(mFileHierarchy->getFileEntry(e,f))
+            fps.push_back(fileEntryFingerprint(f)) ;
+
+    std::sort(fps.begin(),fps.end()) ;
+    packFingerprints(fps,known_entries) ;
+
+    return true ;
+}
+
+bool RemoteDirectoryStorage::deserialiseUpdateDirEntryDelta(const EntryIndex& indx,const RsTlvBinaryData& bindata)
+{
+    unsigned char *section_data = NULL ;
+    uint32_t section_size = 0 ;
+    uint32_t section_offset=0 ;
+
+    if(!FileListIO::uncompressData((unsigned char*)bindata.bin_data,bindata.bin_len,section_data,section_size,MAX_DIR_SYNC_DELTA_UNCOMPRESSED_SIZE))
+        return false ;
+
+    std::string dir_name ;
+    uint32_t most_recent_time ,dir_modtime ;
+    uint32_t n_subdirs,n_subfiles,n_removed,n_added ;
+
+    std::vector<RsFileHash> subdirs_hashes ;
+    std::vector<uint64_t> removed_fps ;
+    std::vector<InternalFileHierarchyStorage::FileEntry> added_files ;
+
+    unsigned char *file_section_data = NULL ;
+    uint32_t file_section_size = 0 ;
+
+    bool ok =  FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_DIR_NAME       ,dir_name        )
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,most_recent_time)
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,dir_modtime     )
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,n_subdirs       )
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,n_subfiles      )
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,n_removed       )
+            && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,n_added         ) ;
+
+    RsFileHash subdir_hash ;
+
+    for(uint32_t i=0;ok && i<n_subdirs;++i)
+        if((ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX ,subdir_hash)))
+            subdirs_hashes.push_back(subdir_hash) ;
+
+    uint64_t fp ;
+
+    for(uint32_t i=0;ok && i<n_removed;++i)
+        if((ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_FILE_FINGERPRINT,fp)))
+            removed_fps.push_back(fp) ;
+
+    std::sort(removed_fps.begin(),removed_fps.end()) ;
+
+    for(uint32_t i=0;ok && i<n_added;++i)
+    {
+        InternalFileHierarchyStorage::FileEntry f;
+
+        if((ok = readRemoteFileEntry(section_data,section_size,section_offset,file_section_data,file_section_size,f)))
+            added_files.push_back(f) ;
+    }
+
+    free(file_section_data) ;
+    free(section_data) ;
+
+    if(!ok)
+    {
+        std::cerr << "(EE) Cannot deserialise delta of dir entry " << indx << " from friend " << peerId() << std::endl;
+        return false ;
+    }
+
+#ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
+    std::cerr << "RemoteDirectoryStorage::deserialiseUpdateDirEntryDelta(): dir " << indx << " \"" << dir_name << "\": " << n_subfiles << " files, " << n_removed << " removed, " << n_added << " added." << std::endl;
+#endif
+
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    // Rebuild the full list of files from what we have, minus removed files, plus added files. When all files are
+    // sent, nothing is kept, which also covers requests that did not list the known files.
+
+    if(mFileHierarchy->getType(indx) != InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
+    {
+        std::cerr << "(EE) Cannot update dir entry with index " << indx << ": entry does not exist." << std::endl;
+        return false ;
+    }
+
+    std::vector<InternalFileHierarchyStorage::FileEntry> subfiles_array ;
+    InternalFileHierarchyStorage::FileEntry f ;
+    EntryIndex e ;
+
+    if(n_added < n_subfiles)
+        for(uint32_t i=0;(e = mFileHierarchy->getSubFileIndex(indx,i)) != NO_INDEX;++i)
+            if(mFileHierarchy->getFileEntry(e,f) && !std::binary_search(removed_fps.begin(),removed_fps.end(),fileEntryFingerprint(f)))
+                subfiles_array.push_back(f) ;
+
+    subfiles_array.insert(subfiles_array.end(),added_files.begin(),added_files.end()) ;
+
+    // If our copy changed since the request was sent, the delta does not apply. The client will ask for the full content.
+
+    if(subfiles_array.size() != n_subfiles)
+    {
+        std::cerr << "(WW) Delta for dir entry " << indx << " of friend " << peerId() << " does not match local content (" << subfiles_array.size() << " files instead of " << n_subfiles << ")." << std::endl;
+        return false ;
+    }
+
+    if(!mFileHierarchy->updateDirEntry(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,subfiles_array))
+    {
+        std::cerr << "(EE) Cannot update dir entry with index " << indx << ": entry does not exist." << std::endl;
+        return false ;
+    }
+
+    mChanged = true ;
+
+    return true ;
+}
+
 int RemoteDirectoryStorage::searchHash(const RsFileHash& hash, EntryIndex& result) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
@@ -24,6 +24,7 @@
 #include <string>
 #include <stdint.h>
 #include <list>
+#include <vector>
 
 #include "retroshare/rsids.h"
 #include "retroshare/rsfiles.h"
@@ -38,7 +39,10 @@ class RsTlvBinaryData ;
 class DirectoryStorage
 {
 	public:
-        DirectoryStorage(const RsPeerId& pid, const std::string& fname) ;
+        // When mapped_format is true, the storage is saved in a flat file that is memory-mapped when loaded. Nodes
+        // are only copied to memory when they get modified.
+
+        DirectoryStorage(const RsPeerId& pid, const std::string& fname, bool mapped_format = false) ;
         virtual ~DirectoryStorage() {}
 
         typedef uint32_t EntryIndex ;
@@ -85,6 +89,8 @@ class DirectoryStorage
                 rstime_t last_modif_time() const ; // last time a file in this directory or in the directories below has been modified.
                 rstime_t last_update_time() const ; // last time this directory was updated
             private:
+                bool isDir() const ;
+
                 EntryIndex mParentIndex ;		// index of the parent dir.
                 uint32_t mDirTabIndex ;				// index in the vector of subdirs.
                 InternalFileHierarchyStorage *mStorage ;
@@ -110,6 +116,8 @@ class DirectoryStorage
                 rstime_t modtime() const ;
 
             private:
+                bool isFile() const ;
+
                 EntryIndex mParentIndex ;		// index of the parent dir.
                 uint32_t   mFileTabIndex ;		// index in the vector of subdirs.
                 InternalFileHierarchyStorage *mStorage ;
@@ -166,6 +174,7 @@ class DirectoryStorage
         // storage of internal structure. Totally hidden from the outside. EntryIndex is simply the index of the entry in the vector.
 
         RsPeerId mPeerId;
+        bool mMappedFormat ;
 
     protected:
         mutable RsMutex mDirStorageMtx ;
@@ -194,6 +203,28 @@ public:
      */
     bool deserialiseUpdateDirEntry(const EntryIndex& indx,const RsTlvBinaryData& data) ;
 
+    /*!
+     * \brief getKnownEntries
+     * 			Computes the fingerprints of the files we currently have in the given directory, so that the friend
+     * 			can only send what changed.
+     *
+     * \param indx				index of the directory
+     * \param known_entries	packed fingerprints of the directory subfiles
+     * \return 				false when the directory cannot be found.
+     */
+    bool getKnownEntries(const EntryIndex& indx,RsTlvBinaryData& known_entries) const ;
+
+    /*!
+     * \brief deserialiseUpdateDirEntryDelta
+     * 			Same as deserialiseUpdateDirEntry, for a compressed delta produced by LocalDirectoryStorage::serialiseDirEntryDelta.
+     * 			Fails if the delta does not apply to the current directory content.
+     *
+     * \param indx		index of the directory to update
+     * \param bindata   binary data to deserialise from
+     * \return 			false when the directory cannot be found or the delta does not apply.
+     */
+    bool deserialiseUpdateDirEntryDelta(const EntryIndex& indx,const RsTlvBinaryData& data) ;
+
     /*!
      * \brief lastSweepTime
      * 			returns the last time a sweep has been done over the directory in order to check update TS.
@@ -291,6 +322,19 @@ public:
      */
     bool serialiseDirEntry(const EntryIndex& indx, RsTlvBinaryData& bindata, const RsPeerId &client_id) ;
 
+    /*!
+     * \brief serialiseDirEntryDelta
+     * 			Same as serialiseDirEntry, but only sends the files the client does not already know, the fingerprints of the
+     * 			files it should remove, and compresses the result.
+     *
+     * \param indx					index of the directory to serialise
+     * \param known_entries			fingerprints of the files the client has, as computed by RemoteDirectoryStorage::getKnownEntries
+     * \param bindata   			binary data created by serialisation
+     * \param client_id      		Peer id to be serialised to. Depending on permissions, some subdirs can be removed.
+     * \return 						false when the directory cannot be found.
+     */
+    bool serialiseDirEntryDelta(const EntryIndex& indx, const RsTlvBinaryData& known_entries, RsTlvBinaryData& bindata, const RsPeerId &client_id) ;
+
 private:
 	static RsFileHash makeEncryptedHash(const RsFileHash& hash);
 	bool locked_findRealHash(const RsFileHash& hash, RsFileHash& real_hash) const;
@@ -298,6 +342,7 @@ private:
 	std::string locked_getVirtualDirName(EntryIndex indx) const ;
 
 	bool locked_getFileSharingPermissions(const EntryIndex& indx, FileStorageFlags &flags, std::list<RsNodeGroupId>& parent_groups);
+	bool locked_getBrowsableDirContent(const EntryIndex& indx, const RsPeerId& client_id, std::vector<RsFileHash>& allowed_subdirs, std::vector<EntryIndex>& allowed_subfiles);
 	std::string locked_findRealRootFromVirtualFilename(const std::string& virtual_rootdir) const;
 
 	std::map<std::string,SharedDirInfo> mLocalDirs ;	// map is better for search. it->first=it->second.filename
@@ -22,6 +22,14 @@
  *                                                                             *
  ******************************************************************************/
 
+#ifdef __linux__
+#	include <sys/inotify.h>
+#	include <poll.h>
+#	include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstring>
+
 #include "util/cxx17retrocompat.h"
 #include "util/folderiterator.h"
 #include "util/rstime.h"
@@ -46,9 +54,19 @@ LocalDirectoryUpdater::LocalDirectoryUpdater(HashStorage *hc,LocalDirectoryStora
     /* Can be left to false, but setting it to true will force to re-hash any file that has been left unhashed in the last session.*/
     , mNeedsFullRecheck(true)
     , mIsChecking(false), mForceUpdate(false), mIgnoreFlags (0),  mMaxShareDepth(0)
+    , mNotificationsEnabled(WATCH_NOTIFICATIONS_DEFAULT), mNotificationsFailed(false), mNotifyFd(-1)
+    , mWatchInfoMtx("LocalDirectoryUpdater watch info")
 {
 }
 
+LocalDirectoryUpdater::~LocalDirectoryUpdater()
+{
+#ifdef __linux__
+    if(mNotifyFd >= 0)
+        close(mNotifyFd) ;
+#endif
+}
+
 bool LocalDirectoryUpdater::isEnabled() const
 {
     return mIsEnabled ;
@@ -67,7 +85,13 @@ void LocalDirectoryUpdater::threadTick()
 
     if (mIsEnabled || mForceUpdate)
     {
-        if(now > mDelayBetweenDirectoryUpdates + mLastSweepTime)
+        // When directories are watched, changes are caught as they happen and full sweeps are only a safety net.
+        rstime_t sweep_delay = mDelayBetweenDirectoryUpdates ;
+
+        if(mNotifyFd >= 0 && !mNeedsFullRecheck && !mForceUpdate && sweep_delay < rstime_t(DELAY_BETWEEN_FULL_SWEEPS_WITH_NOTIFICATIONS))
+            sweep_delay = DELAY_BETWEEN_FULL_SWEEPS_WITH_NOTIFICATIONS ;
+
+        if(now > sweep_delay + mLastSweepTime)
         {
             bool some_files_not_ready = false ;
 
@@ -92,6 +116,8 @@ void LocalDirectoryUpdater::threadTick()
             else
                 std::cerr << "(WW) sweepSharedDirectories() failed. Will do it again in a short time." << std::endl;
         }
+        else if(mNotifyFd >= 0)
+            updateChangedDirectories() ;
 
         if(now > DELAY_BETWEEN_LOCAL_DIRECTORIES_TS_UPDATE + mLastTSUpdateTime)
         {
@@ -102,7 +128,7 @@ void LocalDirectoryUpdater::threadTick()
 
 	for(uint32_t i=0;i<10;++i)
 	{
-		rstime::rs_usleep(1*1000*1000);
+		waitForNotifications(1000);
 
 		{
 		if(mForceUpdate)
@@ -134,9 +160,14 @@ bool LocalDirectoryUpdater::sweepSharedDirectories(bool& some_files_not_ready)
 	}
 
 	mIsChecking = true;
+	double start_time = rstime::RsScopeTimer::currentTime();
 
 	RsServer::notify()->notifyListPreChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
 
+	/* Watches are set again on every directory during the sweep, which also
+	 * drops the ones of directories that are not shared anymore. */
+	resetNotifications();
+
 	/* recursive update algorithm works that way:
 	 * - the external loop starts on the shared directory list and goes through
 	 *   sub-directories
@@ -222,10 +253,19 @@ bool LocalDirectoryUpdater::sweepSharedDirectories(bool& some_files_not_ready)
 		/* here we need to use the list that was stored, instead of the shared
 		 * dir list, because the two are not necessarily in the same order. */
 	}
+	mExistingDirectories.swap(existing_dirs);
 
 	RsServer::notify()->notifyListChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
 	mIsChecking = false;
 
+	{
+		RS_STACK_MUTEX(mWatchInfoMtx);
+		++mWatchInfo.fullSweeps;
+		mWatchInfo.lastFullSweepTS = time(nullptr);
+		mWatchInfo.lastFullSweepDurationMs = static_cast<uint32_t>(
+		            1000 * (rstime::RsScopeTimer::currentTime() - start_time) );
+	}
+
 	return true;
 }
 
@@ -233,9 +273,27 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(
         const std::string& cumulated_path, DirectoryStorage::EntryIndex indx,
         std::set<std::string>& existing_directories, uint32_t current_depth,
         bool& some_files_not_ready )
+{
+	updateSharedDir( cumulated_path, indx, existing_directories, current_depth,
+	                 mNeedsFullRecheck, some_files_not_ready );
+
+	// go through the list of sub-dirs and recursively update
+	for( DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories, indx);
+	     stored_dir_it; ++stored_dir_it )
+		recursUpdateSharedDir( cumulated_path + "/" + stored_dir_it.name(),
+		                       *stored_dir_it, existing_directories,
+		                       current_depth+1, some_files_not_ready );
+}
+
+void LocalDirectoryUpdater::updateSharedDir(
+        const std::string& cumulated_path, DirectoryStorage::EntryIndex indx,
+        std::set<std::string>& existing_directories, uint32_t current_depth,
+        bool force_recheck, bool& some_files_not_ready )
 {
 	RS_DBG4("parsing directory \"", cumulated_path, "\" index: ", indx);
 
+	watchDirectory(cumulated_path);
+
 	/* make sure list of subdirs is the same
 	 * make sure list of subfiles is the same
 	 * request all hashes to the hashcache */
@@ -255,7 +313,7 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(
 	/* the > is because we may have changed the virtual name, and therefore the
 	 * TS wont match. We only want to detect when the directory has changed on
 	 * the disk */
-	if(mNeedsFullRecheck || dirIt.dir_modtime() > dir_local_mod_time)
+	if(force_recheck || dirIt.dir_modtime() > dir_local_mod_time)
 	{
 		// collect subdirs and subfiles
 		std::map<std::string, DirectoryStorage::FileTS> subfiles;
@@ -351,13 +409,290 @@ void LocalDirectoryUpdater::recursUpdateSharedDir(
 				mSharedDirectories->updateHash(*dit, hash, hash != dit.hash());
 		}
 	}
+}
 
-	// go through the list of sub-dirs and recursively update
-	for( DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories, indx);
-	     stored_dir_it; ++stored_dir_it )
-		recursUpdateSharedDir( cumulated_path + "/" + stored_dir_it.name(),
-		                       *stored_dir_it, existing_directories,
-		                       current_depth+1, some_files_not_ready );
+void LocalDirectoryUpdater::updateChangedDirectories()
+{
+	rstime_t now = time(nullptr);
+
+	/* Wait for directories to be left alone for a while, so that files being
+	 * written are not re-indexed over and over. */
+	std::vector<std::string> ready_dirs;
+	for(auto& it: std::as_const(mChangedDirs))
+		if(now >= it.second + rstime_t(MIN_TIME_AFTER_LAST_MODIFICATION))
+			ready_dirs.push_back(it.first);
+
+	if(ready_dirs.empty() || mHashSalt.isNull()) return;
+
+	mIsChecking = true;
+	double start_time = rstime::RsScopeTimer::currentTime();
+
+	RsServer::notify()->notifyListPreChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
+
+	uint32_t updated_dirs = 0;
+	for(const std::string& path: std::as_const(ready_dirs))
+	{
+		mChangedDirs.erase(path);
+
+		DirectoryStorage::EntryIndex indx;
+		uint32_t depth;
+
+		/* Directories that are not indexed anymore have been removed or
+		 * excluded, which their parent directory takes care of. */
+		if(!findSharedDir(path, indx, depth)) continue;
+
+		/* The sub-directories are about to be listed again. Forget about
+		 * them, so that they are not taken for duplicates. Real paths can
+		 * only be resolved for directories that are still there. */
+		if(mFollowSymLinks && mIgnoreDuplicates)
+		{
+			const std::string real_path = RsDirUtil::checkDirectory(path) ?
+			            RsDirUtil::removeSymLinks(path) : path;
+
+			for( DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories, indx);
+			     stored_dir_it; ++stored_dir_it )
+			{
+				const std::string sub_path = path + "/" + stored_dir_it.name();
+
+				mExistingDirectories.erase(
+				            RsDirUtil::checkDirectory(sub_path) ?
+				                RsDirUtil::removeSymLinks(sub_path) :
+				                real_path + "/" + stored_dir_it.name() );
+			}
+		}
+
+		bool some_files_not_ready = false;
+		updateSharedDir( path, indx, mExistingDirectories, depth, true,
+		                 some_files_not_ready );
+
+		/* Sub-directories that have never been parsed are new ones, that
+		 * need to be indexed and watched as a whole. */
+		for( DirectoryStorage::DirIterator stored_dir_it(mSharedDirectories, indx);
+		     stored_dir_it; ++stored_dir_it )
+		{
+			rstime_t sub_dir_mod_time;
+			if( mSharedDirectories->getDirectoryLocalModTime(
+			            *stored_dir_it, sub_dir_mod_time )
+			        && sub_dir_mod_time == 0 )
+				recursUpdateSharedDir( path + "/" + stored_dir_it.name(),
+				                       *stored_dir_it, mExistingDirectories,
+				                       depth+1, some_files_not_ready );
+		}
+
+		if(some_files_not_ready) mChangedDirs[path] = now;
+		++updated_dirs;
+	}
+
+	RsServer::notify()->notifyListChange(NOTIFY_LIST_DIRLIST_LOCAL, 0);
+	mSharedDirectories->notifyTSChanged();
+	mIsChecking = false;
+
+	RS_DBG4("re-indexed ", updated_dirs, " changed directories");
+
+	RS_STACK_MUTEX(mWatchInfoMtx);
+	mWatchInfo.watchedDirectories = mWatchedDirs.size();
+	mWatchInfo.pendingChangedDirectories = mChangedDirs.size();
+	mWatchInfo.changedDirectories += updated_dirs;
+	mWatchInfo.lastChangedDirectoriesUpdateTS = now;
+	mWatchInfo.lastChangedDirectoriesUpdateCount = updated_dirs;
+	mWatchInfo.lastChangedDirectoriesUpdateDurationMs = static_cast<uint32_t>(
+	            1000 * (rstime::RsScopeTimer::currentTime() - start_time) );
+}
+
+bool LocalDirectoryUpdater::findSharedDir(
+        const std::string& path, DirectoryStorage::EntryIndex& indx,
+        uint32_t& depth ) const
+{
+	/* Top level shared directories are stored with their full path, and
+	 * sub-directories with their name only. */
+	for( DirectoryStorage::DirIterator top_it(
+	         mSharedDirectories, mSharedDirectories->root() ); top_it; ++top_it )
+	{
+		const std::string top_name = top_it.name();
+
+		if(path.compare(0, top_name.size(), top_name) != 0) continue;
+		if(path.size() > top_name.size() && path[top_name.size()] != '/')
+			continue;
+
+		DirectoryStorage::EntryIndex current = *top_it;
+		uint32_t current_depth = 1;
+		bool found = true;
+
+		for(size_t pos = top_name.size() + 1; found && pos < path.size(); )
+		{
+			size_t next = path.find('/', pos);
+			if(next == std::string::npos) next = path.size();
+
+			const std::string name = path.substr(pos, next - pos);
+			found = false;
+
+			for( DirectoryStorage::DirIterator it(mSharedDirectories, current);
+			     it; ++it )
+				if(it.name() == name)
+				{
+					current = *it;
+					found = true;
+					break;
+				}
+
+			++current_depth;
+			pos = next + 1;
+		}
+
+		if(found)
+		{
+			indx = current;
+			depth = current_depth;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LocalDirectoryUpdater::watchDirectory(const std::string& path)
+{
+#ifdef __linux__
+	if(mNotifyFd < 0) return;
+
+	int wd = inotify_add_watch(
+	            mNotifyFd, path.c_str(),
+	            IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+	            IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR );
+	if(wd < 0)
+	{
+		/* Most likely fs.inotify.max_user_watches has been reached. Timed
+		 * sweeps still work, so fall back to them. */
+		RS_WARN( "Cannot watch directory \"", path, "\": ", strerror(errno),
+		         ". Falling back to periodic sweeps of shared directories." );
+		mNotificationsFailed = true;
+		resetNotifications();
+		return;
+	}
+
+	mWatchedDirs[wd] = path;
+#else
+	(void)path;
+#endif
+}
+
+void LocalDirectoryUpdater::resetNotifications()
+{
+#ifdef __linux__
+	// closing the inotify instance also removes all its watches
+	if(mNotifyFd >= 0) close(mNotifyFd);
+	mNotifyFd = -1;
+	mWatchedDirs.clear();
+
+	if(mNotificationsEnabled && !mNotificationsFailed)
+	{
+		mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+		if(mNotifyFd < 0)
+			RS_WARN( "Cannot create inotify instance: ", strerror(errno),
+			         ". Shared directories will only be swept periodically." );
+	}
+	else
+		mChangedDirs.clear();
+#endif
+
+	RS_STACK_MUTEX(mWatchInfoMtx);
+	mWatchInfo.notificationsActive = (mNotifyFd >= 0);
+	mWatchInfo.watchedDirectories = 0;
+	mWatchInfo.pendingChangedDirectories = mChangedDirs.size();
+}
+
+void LocalDirectoryUpdater::waitForNotifications(uint32_t ms)
+{
+#ifdef __linux__
+	if(mNotifyFd >= 0 && !mNotificationsEnabled) resetNotifications();
+
+	if(mNotifyFd < 0)
+	{
+		rstime::rs_usleep(ms*1000);
+		return;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = mNotifyFd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if(poll(&pfd, 1, ms) <= 0) return;
+
+	alignas(struct inotify_event) char buf[16384];
+	rstime_t now = time(nullptr);
+	bool overflow = false;
+
+	for(;;)
+	{
+		ssize_t len = read(mNotifyFd, buf, sizeof(buf));
+		if(len <= 0) break;
+
+		for(char* ptr = buf; ptr < buf + len; )
+		{
+			const struct inotify_event* ev =
+			        reinterpret_cast<const struct inotify_event*>(ptr);
+			ptr += sizeof(struct inotify_event) + ev->len;
+
+			if(ev->mask & IN_Q_OVERFLOW)
+			{
+				overflow = true;
+				continue;
+			}
+
+			auto it = mWatchedDirs.find(ev->wd);
+			if(it == mWatchedDirs.end()) continue;
+
+			/* the directory has been removed or moved away, which is seen
+			 * by its parent directory as well */
+			if(ev->mask & IN_IGNORED)
+			{
+				mWatchedDirs.erase(it);
+				continue;
+			}
+
+			mChangedDirs[it->second] = now;
+		}
+	}
+
+	if(overflow)
+	{
+		RS_WARN("Lost file system notifications. Scheduling a full sweep of shared directories.");
+		mNeedsFullRecheck = true;
+		mLastSweepTime = 0;
+	}
+
+	RS_STACK_MUTEX(mWatchInfoMtx);
+	mWatchInfo.watchedDirectories = mWatchedDirs.size();
+	mWatchInfo.pendingChangedDirectories = mChangedDirs.size();
+#else
+	rstime::rs_usleep(ms*1000);
+#endif
+}
+
+void LocalDirectoryUpdater::setNotificationsEnabled(bool b)
+{
+	/* Called from client threads while the updater thread runs: both flags
+	 * and mLastSweepTime are atomic. */
+	if(mNotificationsEnabled.exchange(b) == b) return;
+
+	mNotificationsFailed = false;
+
+	/* Watches are set during sweeps, so schedule one to get them. Without
+	 * notifications, the watcher thread drops them by itself. */
+	if(b) mLastSweepTime = 0;
+}
+
+bool LocalDirectoryUpdater::notificationsEnabled() const
+{
+	return mNotificationsEnabled;
+}
+
+void LocalDirectoryUpdater::getWatchInfo(RsSharedDirectoriesWatchInfo& info) const
+{
+	RS_STACK_MUTEX(mWatchInfoMtx);
+	info = mWatchInfo;
 }
 
 bool LocalDirectoryUpdater::filterFile(const std::string& fname) const
@@ -25,15 +25,20 @@
 // 	- local: directories are crawled n disk and files are hashed / requested from a cache
 // 	- remote: directories are requested remotely to a providing client
 //
+#include <atomic>
+#include <map>
+#include <set>
+
 #include "file_sharing/hash_cache.h"
 #include "file_sharing/directory_storage.h"
+#include "retroshare/rsfiles.h"
 #include "util/rstime.h"
 
 class LocalDirectoryUpdater: public HashStorageClient, public RsTickingThread
 {
 public:
     LocalDirectoryUpdater(HashStorage *hash_cache,LocalDirectoryStorage *lds) ;
-    virtual ~LocalDirectoryUpdater() {}
+    virtual ~LocalDirectoryUpdater() ;
 
     void forceUpdate(bool add_safe_delay);
     bool inDirectoryCheck() const ;
@@ -61,6 +66,13 @@ public:
 	void setIgnoreDuplicates(bool b) ;
 	bool ignoreDuplicates() const;
 
+	// When enabled, directories are watched through kernel notifications (inotify on Linux), and
+	// only the directories that changed are re-indexed. Full sweeps still happen, but less often.
+	void setNotificationsEnabled(bool b) ;
+	bool notificationsEnabled() const ;
+
+	void getWatchInfo(RsSharedDirectoriesWatchInfo& info) const ;
+
 protected:
 	void threadTick() override; /// @see RsTickingThread
 
@@ -68,17 +80,26 @@ protected:
     virtual bool hash_confirm(uint32_t client_param) ;
 
     void recursUpdateSharedDir(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, std::set<std::string>& existing_directories, uint32_t current_depth,bool& files_not_ready);
+    void updateSharedDir(const std::string& cumulated_path, DirectoryStorage::EntryIndex indx, std::set<std::string>& existing_directories, uint32_t current_depth,bool force_recheck,bool& files_not_ready);
     bool sweepSharedDirectories(bool &some_files_not_ready);
 
+    // Re-indexes the directories reported as changed by the kernel, once they have not been touched for a while.
+    void updateChangedDirectories();
+    bool findSharedDir(const std::string& path,DirectoryStorage::EntryIndex& indx,uint32_t& depth) const ;
+
 private:
 	bool filterFile(const std::string& fname) const ;	// reponds true if the file passes the ignore lists test.
 
+	void waitForNotifications(uint32_t ms) ;
+	void resetNotifications() ;
+	void watchDirectory(const std::string& path) ;
+
     HashStorage *mHashCache ;
     LocalDirectoryStorage *mSharedDirectories ;
 
     RsFileHash mHashSalt ;
 
-    rstime_t mLastSweepTime;
+    std::atomic<rstime_t> mLastSweepTime;	// also reset from other threads, e.g. by setNotificationsEnabled()
     rstime_t mLastTSUpdateTime;
 
     uint32_t mDelayBetweenDirectoryUpdates;
@@ -94,5 +115,15 @@ private:
 
 	std::list<std::string> mIgnoredPrefixes ;
 	std::list<std::string> mIgnoredSuffixes ;
+
+	std::atomic<bool> mNotificationsEnabled ;		// set from the client threads, read by the updater thread
+	std::atomic<bool> mNotificationsFailed ;		// watch limit reached. Do not retry until notifications are re-enabled.
+	int  mNotifyFd ;								// inotify instance, or -1 when directories are not watched
+	std::map<int,std::string> mWatchedDirs ;		// watch descriptor -> directory path
+	std::map<std::string,rstime_t> mChangedDirs ;	// directory path -> time of the last change notification
+	std::set<std::string> mExistingDirectories ;	// real paths of indexed directories, for duplicate detection between sweeps
+
+	mutable RsMutex mWatchInfoMtx ;
+	RsSharedDirectoriesWatchInfo mWatchInfo ;
 };
 
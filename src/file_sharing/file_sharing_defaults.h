@@ -26,6 +26,7 @@ static const uint32_t DELAY_BETWEEN_REMOTE_DIRECTORY_SYNC_REQ   =  120 ; // 2 mi
 static const uint32_t DELAY_BETWEEN_LOCAL_DIRECTORIES_TS_UPDATE =   20 ; // 20 sec. But we only update for real if something has changed.
 static const uint32_t DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP    =   60 ; // 60 sec.
 static const uint32_t DELAY_BETWEEN_EXTRA_FILES_CACHE_UPDATES   =    2 ; //  2 sec.
+static const uint32_t DELAY_BETWEEN_FULL_SWEEPS_WITH_NOTIFICATIONS = 6*3600 ; // 6 hours. Changes are caught by kernel notifications in between.
 
 static const uint32_t DELAY_BEFORE_DELETE_NON_EMPTY_REMOTE_DIR  = 60*24*86400 ; // delete non empty remoe directories after 60 days of inactivity
 static const uint32_t DELAY_BEFORE_DELETE_EMPTY_REMOTE_DIR      =  5*24*86400 ; // delete empty remote directories after 5 days of inactivity
@@ -41,6 +42,8 @@ static const std::string IGNORED_PREFIXES_SS                    = "IGNORED_PREFI
 static const std::string IGNORED_SUFFIXES_SS                    = "IGNORED_SUFFIXES"; 	 	             // ignore file suffixes
 static const std::string IGNORE_LIST_FLAGS_SS                   = "IGNORED_FLAGS"; 	 	 	             // ignore file flags
 static const std::string MAX_SHARE_DEPTH                        = "MAX_SHARE_DEPTH"; 	 	             // maximum depth of shared directories
+static const std::string HASHING_THREADS_SS                     = "HASHING_THREADS"; 	 	             // number of threads used to hash files
+static const std::string WATCH_NOTIFICATIONS_SS                 = "WATCH_FILES_NOTIFICATIONS";          // use kernel notifications to detect changes in shared directories
 
 static const std::string FILE_SHARING_DIR_NAME       = "file_sharing" ;			 // hard-coded directory name to store friend file lists, hash cache, etc.
 static const std::string HASH_CACHE_FILE_NAME        = "hash_cache.bin" ;		 // hard-coded directory name to store encrypted hash cache.
@@ -51,7 +54,11 @@ static const uint32_t MIN_INTERVAL_BETWEEN_REMOTE_DIRECTORY_SAVE   = 23 ;    //
 static const uint32_t MIN_TIME_AFTER_LAST_MODIFICATION             = 10 ;    // never hash a file that is just being modified, otherwise we end up with a corrupted hash
 
 static const uint32_t MAX_DIR_SYNC_RESPONSE_DATA_SIZE              = 20000 ; // Maximum RsItem data size in bytes for serialised directory transmission
+static const uint32_t MAX_DIR_SYNC_DELTA_UNCOMPRESSED_SIZE         = 64*1024*1024 ; // Never uncompress a directory delta bigger than this
+static const uint32_t MAX_DIR_SYNC_KNOWN_ENTRIES                   = 2500 ;  // Above this number of files, sync requests do not list known files, and get the full (compressed) content
 static const uint32_t DEFAULT_HASH_STORAGE_DURATION_DAYS           = 30 ;    // remember deleted/inaccessible files for 30 days
+static const uint32_t DEFAULT_HASHING_THREADS                      = 4 ;     // size of the hashing pool. Spinning disks only get one of them.
+static const uint32_t MAX_HASHING_THREADS                          = 16 ;    // upper bound for the hashing pool size
 
 static const uint32_t NB_FRIEND_INDEX_BITS_32BITS                    = 10 ;			// Do not change this!
 static const uint32_t NB_ENTRY_INDEX_BITS_32BITS                     = 22 ;			// Do not change this!
@@ -64,6 +71,7 @@ static const uint64_t ENTRY_INDEX_BIT_MASK_64BITS                    = 0x0000000
 static const uint32_t DELAY_BEFORE_DROP_REQUEST               = 600; 			// every 10 min
 
 static const bool FOLLOW_SYMLINKS_DEFAULT                     = true;
+static const bool WATCH_NOTIFICATIONS_DEFAULT                 = true;
 static const bool TRUST_FRIEND_NODES_FOR_BANNED_FILES_DEFAULT = true;
 
 static const uint32_t FL_BASE_TMP_SECTION_SIZE = 4096 ;
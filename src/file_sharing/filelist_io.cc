@@ -20,6 +20,7 @@
  *                                                                             *
  ******************************************************************************/
 #include <sstream>
+#include <zlib.h>
 #include "retroshare/rsids.h"
 #include "pqi/authssl.h"
 #include "util/rsdir.h"
@@ -150,6 +151,62 @@ bool FileListIO::read125Size(const unsigned char *data,uint32_t data_size,uint32
     return true;
 }
 
+bool FileListIO::compressData(const unsigned char *data,uint32_t size,unsigned char *& compressed_data,uint32_t& compressed_size)
+{
+    uLongf zsize = compressBound(size) ;
+
+    compressed_data = (unsigned char *)rs_malloc(zsize + 4) ;
+
+    if(!compressed_data)
+        return false ;
+
+    uint32_t offset = 0 ;
+
+    if(!setRawUInt32(compressed_data,zsize+4,&offset,size) || compress2(compressed_data+4,&zsize,data,size,Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        std::cerr << "(EE) FileListIO: cannot compress " << size << " bytes of data." << std::endl;
+        free(compressed_data) ;
+        compressed_data = NULL ;
+        return false ;
+    }
+
+    compressed_size = zsize + 4 ;
+    return true ;
+}
+
+bool FileListIO::uncompressData(const unsigned char *compressed_data,uint32_t compressed_size,unsigned char *& data,uint32_t& size,uint32_t max_size)
+{
+    uint32_t offset = 0 ;
+    uint32_t announced_size = 0 ;
+
+    if(!getRawUInt32(const_cast<uint8_t*>(compressed_data),compressed_size,&offset,&announced_size))
+        return false ;
+
+    if(announced_size > max_size)
+    {
+        std::cerr << "(EE) FileListIO: refusing to uncompress " << announced_size << " bytes of data (max is " << max_size << ")." << std::endl;
+        return false ;
+    }
+
+    data = (unsigned char *)rs_malloc(std::max(announced_size,1u)) ;
+
+    if(!data)
+        return false ;
+
+    uLongf zsize = announced_size ;
+
+    if(uncompress(data,&zsize,compressed_data+4,compressed_size-4) != Z_OK || zsize != announced_size)
+    {
+        std::cerr << "(EE) FileListIO: cannot uncompress data, or size mismatch." << std::endl;
+        free(data) ;
+        data = NULL ;
+        return false ;
+    }
+
+    size = announced_size ;
+    return true ;
+}
+
 bool FileListIO::saveEncryptedDataToFile(const std::string& fname,const unsigned char *data,uint32_t total_size)
 {
     void *encryptedData = NULL ;
@@ -44,6 +44,7 @@ static const uint8_t FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY         =  0x13 ;
 static const uint8_t FILE_LIST_IO_TAG_FILE_SHA1_HASH            =  0x20 ;
 static const uint8_t FILE_LIST_IO_TAG_FILE_NAME                 =  0x21 ;
 static const uint8_t FILE_LIST_IO_TAG_FILE_SIZE                 =  0x22 ;
+static const uint8_t FILE_LIST_IO_TAG_FILE_FINGERPRINT          =  0x23 ;
 
 static const uint8_t FILE_LIST_IO_TAG_MODIF_TS                  =  0x30 ;
 static const uint8_t FILE_LIST_IO_TAG_RECURS_MODIF_TS           =  0x31 ;
@@ -109,6 +110,12 @@ public:
     template<class T> static bool deserialise(const unsigned char *buff,uint32_t size,uint32_t& offset,T& val) ;
     template<class T> static uint32_t serial_size(const T& val) ;
 
+    // zlib (de)compression of serialised directory content sent to friends. The compressed buffer starts with the
+    // uncompressed size as a 32 bits big endian number. Uncompression refuses to allocate more than max_size bytes.
+
+    static bool compressData(const unsigned char *data,uint32_t size,unsigned char *& compressed_data,uint32_t& compressed_size) ;
+    static bool uncompressData(const unsigned char *compressed_data,uint32_t compressed_size,unsigned char *& data,uint32_t& size,uint32_t max_size) ;
+
     static bool saveEncryptedDataToFile(const std::string& fname,const unsigned char *data,uint32_t total_size);
     static bool loadEncryptedDataFromFile(const std::string& fname,unsigned char *& data,uint32_t& total_size);
 
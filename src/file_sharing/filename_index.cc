@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: filename_index.cc                           *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <algorithm>
+#include <iterator>
+#include <ctype.h>
+
+#include "filename_index.h"
+
+static const uint32_t MIN_STALE_ENTRIES_BEFORE_REBUILD = 10000 ;
+
+void FileNameIndex::trigrams(const std::string& s,std::vector<uint32_t>& tri)
+{
+    tri.clear();
+
+    if(s.size() < MIN_TERM_LENGTH)
+        return ;
+
+    // Same case folding than RsRegularExpression::CompareCharIC, so that candidates are a superset of its matches.
+
+    for(uint32_t i=0;i+2<s.size();++i)
+        tri.push_back(  (uint32_t(tolower((unsigned char)s[i  ])) << 16)
+                      | (uint32_t(tolower((unsigned char)s[i+1])) <<  8)
+                      |  uint32_t(tolower((unsigned char)s[i+2])) ) ;
+
+    std::sort(tri.begin(),tri.end()) ;
+    tri.erase(std::unique(tri.begin(),tri.end()),tri.end()) ;
+}
+
+void FileNameIndex::insert(uint32_t entry,const std::string& name)
+{
+    std::vector<uint32_t> tri ;
+    trigrams(name,tri) ;
+
+    for(uint32_t i=0;i<tri.size();++i)
+    {
+        PostingList& p(mPostings[tri[i]]) ;
+
+        if(!p.entries.empty() && p.entries.back() >= entry)
+            p.sorted = false ;
+
+        p.entries.push_back(entry) ;
+    }
+    ++mLiveEntries ;
+}
+
+void FileNameIndex::remove(uint32_t /*entry*/)
+{
+    if(mLiveEntries > 0)
+        --mLiveEntries ;
+
+    ++mStaleEntries ;
+}
+
+void FileNameIndex::clear()
+{
+    mPostings.clear();
+    mLiveEntries = 0 ;
+    mStaleEntries = 0 ;
+}
+
+bool FileNameIndex::needsRebuild() const
+{
+    return mStaleEntries > MIN_STALE_ENTRIES_BEFORE_REBUILD && mStaleEntries > mLiveEntries ;
+}
+
+const std::vector<uint32_t> *FileNameIndex::postings(uint32_t trigram) const
+{
+    auto it = mPostings.find(trigram) ;
+
+    if(it == mPostings.end())
+        return NULL ;
+
+    if(!it->second.sorted)
+    {
+        std::vector<uint32_t>& v(it->second.entries) ;
+
+        std::sort(v.begin(),v.end()) ;
+        v.erase(std::unique(v.begin(),v.end()),v.end()) ;
+        it->second.sorted = true ;
+    }
+    return &it->second.entries ;
+}
+
+bool FileNameIndex::candidates(const std::string& term,std::vector<uint32_t>& entries) const
+{
+    entries.clear();
+
+    std::vector<uint32_t> tri ;
+    trigrams(term,tri) ;
+
+    if(tri.empty())
+        return false ;
+
+    std::vector<const std::vector<uint32_t>*> lists ;
+
+    for(uint32_t i=0;i<tri.size();++i)
+    {
+        const std::vector<uint32_t> *p = postings(tri[i]) ;
+
+        if(!p)
+            return true ;		// one trigram is not present anywhere: nothing can match
+
+        lists.push_back(p) ;
+    }
+
+    // start from the shortest list, so that intersections stay small
+
+    std::sort(lists.begin(),lists.end(),[](const std::vector<uint32_t> *a,const std::vector<uint32_t> *b) { return a->size() < b->size(); }) ;
+
+    entries = *lists[0] ;
+
+    for(uint32_t i=1;i<lists.size() && !entries.empty();++i)
+        intersect(entries,*lists[i]) ;
+
+    return true ;
+}
+
+void FileNameIndex::intersect(std::vector<uint32_t>& a,const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> res ;
+    std::set_intersection(a.begin(),a.end(),b.begin(),b.end(),std::back_inserter(res)) ;
+    a.swap(res) ;
+}
+
+void FileNameIndex::merge(std::vector<uint32_t>& a,const std::vector<uint32_t>& b)
+{
+    std::vector<uint32_t> res ;
+    std::set_union(a.begin(),a.end(),b.begin(),b.end(),std::back_inserter(res)) ;
+    a.swap(res) ;
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: filename_index.h                            *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*!
+ * \brief The FileNameIndex class
+ * 		Trigram index over file names, used to answer substring searches without going through all shared files.
+ * 		Trigrams are case-insensitive, so that the index returns a superset of the entries matching a term, with or
+ * 		without case. Callers must check the candidates against the actual file name.
+ *
+ * 		Removing an entry only marks it as stale: posting lists are not updated, since candidates are checked anyway.
+ * 		When stale entries outnumber live ones, needsRebuild() tells the owner to clear() and re-insert everything.
+ */
+class FileNameIndex
+{
+public:
+    FileNameIndex() : mLiveEntries(0), mStaleEntries(0) {}
+
+    static const uint32_t MIN_TERM_LENGTH = 3 ;			// terms shorter than this cannot be looked up
+
+    void insert(uint32_t entry,const std::string& name) ;
+    void remove(uint32_t entry) ;
+    void clear() ;
+
+    bool needsRebuild() const ;
+
+    /*!
+     * \brief candidates
+     * 			Computes the sorted list of entries whose name may contain the given term.
+     * \return  false if the term is too short to be looked up. In this case all entries are candidates.
+     */
+    bool candidates(const std::string& term,std::vector<uint32_t>& entries) const ;
+
+    // set operations on sorted candidate lists
+
+    static void intersect(std::vector<uint32_t>& a,const std::vector<uint32_t>& b) ;
+    static void merge(std::vector<uint32_t>& a,const std::vector<uint32_t>& b) ;
+
+private:
+    struct PostingList
+    {
+        PostingList() : sorted(true) {}
+
+        std::vector<uint32_t> entries ;
+        bool sorted ;
+    };
+
+    static void trigrams(const std::string& s,std::vector<uint32_t>& tri) ;
+    const std::vector<uint32_t> *postings(uint32_t trigram) const ;
+
+    mutable std::unordered_map<uint32_t,PostingList> mPostings ;	// sorted lazily, when first queried after an update
+    uint32_t mLiveEntries ;
+    uint32_t mStaleEntries ;
+};
@@ -29,24 +29,34 @@
 #include "file_sharing_defaults.h"
 #include "retroshare/rsinit.h"
 
+#ifndef WINDOWS_SYS
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
 //#define HASHSTORAGE_DEBUG 1
 
 static const uint32_t DEFAULT_INACTIVITY_SLEEP_TIME = 50*1000;
 static const uint32_t     MAX_INACTIVITY_SLEEP_TIME = 2*1000*1000;
+static const uint32_t          WORKER_IDLE_WAIT_TIME = 1000;		// in ms. Idle workers are woken up when files are queued, this only bounds stopping.
 
 HashStorage::HashStorage(const std::string& save_file_name)
-    : mFilePath(save_file_name), mHashMtx("Hash Storage mutex")
+    : mFilePath(save_file_name), mHashMtx("Hash Storage mutex"), mWorkersMtx("Hash Storage workers mutex")
 {
     mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
     mRunning = false ;
     mLastSaveTime = 0 ;
+    mChanged = false ;
     mTotalSizeToHash = 0;
     mTotalFilesToHash = 0;
 	mCurrentHashingSpeed = 0 ;
     mMaxStorageDurationDays = DEFAULT_HASH_STORAGE_DURATION_DAYS ;
 	mHashingProcessPaused = false;
 	mHashedBytes = 0 ;
-	mHashingTime = 0 ;
+	mHashingSpeedWindowStart = 0 ;
+    mMaxHashingThreads = DEFAULT_HASHING_THREADS ;
 
     {
         RS_STACK_MUTEX(mHashMtx) ;
@@ -56,10 +66,80 @@ HashStorage::HashStorage(const std::string& save_file_name)
     }
 }
 
-void HashStorage::togglePauseHashingProcess()
+HashStorage::~HashStorage()
+{
+    RS_STACK_MUTEX(mWorkersMtx) ;
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        mWorkers[i]->askForStop();
+
+    mWorkersCv.notify_all();
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+    {
+        mWorkers[i]->fullstop();
+        delete mWorkers[i];
+    }
+}
+
+// Also called from stopHashThread() with mHashMtx locked, hence the separate mutex.
+
+void HashStorage::onStopRequested()
+{
+    {
+        RS_STACK_MUTEX(mWorkersMtx) ;
+
+        for(uint32_t i=0;i<mWorkers.size();++i)
+            mWorkers[i]->askForStop();
+    }
+    mWorkersCv.notify_all();
+}
+
+void HashStorage::setHashingThreadsCount(uint32_t n)
+{
+	std::vector<HashStorageWorker*> surplus ;
+
+	{
+		RS_STACK_MUTEX(mHashMtx) ;
+		mMaxHashingThreads = std::max(1u,std::min(n,MAX_HASHING_THREADS)) ;
+
+		{
+			RS_STACK_MUTEX(mWorkersMtx) ;
+
+			while(mWorkers.size() > mMaxHashingThreads)
+			{
+				surplus.push_back(mWorkers.back()) ;
+				mWorkers.pop_back() ;
+				surplus.back()->askForStop() ;
+			}
+		}
+
+		if(mRunning)
+			locked_startWorkers();
+	}
+	mWorkersCv.notify_all();
+
+	// Surplus workers need mHashMtx to give back the file they were hashing, so they are joined off mutex.
+
+	for(uint32_t i=0;i<surplus.size();++i)
+	{
+		surplus[i]->fullstop();
+		delete surplus[i];
+	}
+}
+uint32_t HashStorage::hashingThreadsCount()
 {
 	RS_STACK_MUTEX(mHashMtx) ;
-	mHashingProcessPaused = !mHashingProcessPaused ;
+	return mMaxHashingThreads ;
+}
+
+void HashStorage::togglePauseHashingProcess()
+{
+	{
+		RS_STACK_MUTEX(mHashMtx) ;
+		mHashingProcessPaused = !mHashingProcessPaused ;
+	}
+	mWorkersCv.notify_all();
 }
 bool HashStorage::hashingProcessPaused()
 {
@@ -87,164 +167,313 @@ static std::string friendlyUnit(uint64_t val)
     return  std::string(buf) + " TB";
 }
 
-void HashStorage::threadTick()
+// Returns the device a file is stored on, so that the hashing pool can be scheduled per device.
+// On Windows all files are considered to be on the same device, which hashes them one at a time.
+
+static uint64_t fileDevice(const std::string& path)
 {
-    FileHashJob job;
-    RsFileHash hash;
-    uint64_t size = 0;
+#ifndef WINDOWS_SYS
+    struct stat buf ;
 
+    if(stat(path.c_str(),&buf) == 0)
+        return (uint64_t)buf.st_dev ;
+#else
+    (void)path;
+#endif
+    return 0 ;
+}
+
+// Returns true when the device is known not to suffer from concurrent reads (SSD, NVMe). Anything we
+// cannot tell (spinning disks, network file systems, other OSes) gets a single hashing thread.
+
+static bool deviceSupportsParallelReads(uint64_t device)
+{
+#ifdef __linux__
+    // /sys/dev/block/<major>:<minor> points to either the whole disk or one of its partitions. Only
+    // the former has a queue/ directory.
+
+    std::string dir = "/sys/dev/block/" + std::to_string(major(device)) + ":" + std::to_string(minor(device)) ;
+    const char *candidates[2] = { "/queue/rotational", "/../queue/rotational" } ;
 
+    for(uint32_t i=0;i<2;++i)
     {
-        bool empty ;
-        uint32_t st ;
+        FILE *f = RsDirUtil::rs_fopen((dir + candidates[i]).c_str(),"r") ;
 
-        {
-            RS_STACK_MUTEX(mHashMtx) ;
+        if(!f)
+            continue ;
 
-            if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
-            {
-                locked_save();
-                mLastSaveTime = time(NULL) ;
-                mChanged = false ;
-            }
-        }
+        int c = fgetc(f) ;
+        fclose(f) ;
 
-        {
-            RS_STACK_MUTEX(mHashMtx) ;
+        return c == '0' ;
+    }
+#else
+    (void)device;
+#endif
+    return false ;
+}
 
-            empty = mFilesToHash.empty();
-            st = mInactivitySleepTime ;
-        }
+void HashStorage::threadTick()
+{
+    bool empty ;
+    bool paused ;
+    uint32_t st ;
 
-        // sleep off mutex!
-        if(empty)
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
         {
+            locked_save();
+            mLastSaveTime = time(NULL) ;
+            mChanged = false ;
+        }
+    }
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        empty = mFilesToHash.empty() && mActiveWorkersPerDevice.empty();
+        paused = mHashingProcessPaused ;
+        st = mInactivitySleepTime ;
+    }
+
+    // sleep off mutex!
+    if(empty)
+    {
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
+        std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
 #endif
 
-            rstime::rs_usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
+        rstime::rs_usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
+
+        if(st > MAX_INACTIVITY_SLEEP_TIME)
+        {
+            RS_STACK_MUTEX(mHashMtx) ;
+
+            mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
 
-            if(st > MAX_INACTIVITY_SLEEP_TIME)
+            if(!mChanged)	// otherwise it might prevent from saving the hash cache
             {
-                RS_STACK_MUTEX(mHashMtx) ;
-
-                mInactivitySleepTime = MAX_INACTIVITY_SLEEP_TIME;
-
-                if(!mChanged)	// otherwise it might prevent from saving the hash cache
-                {
-                    stopHashThread();
-                }
-
-                if(rsEvents)
-                {
-                    auto ev = std::make_shared<RsSharedDirectoriesEvent>();
-                    ev->mEventCode = RsSharedDirectoriesEventCode::DIRECTORY_SWEEP_ENDED;
-                    rsEvents->postEvent(ev);
-                }
-                //RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
+                stopHashThread();
             }
-            else
+
+            if(rsEvents)
             {
-                RS_STACK_MUTEX(mHashMtx) ;
-                mInactivitySleepTime = 2*st ;
+                auto ev = std::make_shared<RsSharedDirectoriesEvent>();
+                ev->mEventCode = RsSharedDirectoriesEventCode::DIRECTORY_SWEEP_ENDED;
+                rsEvents->postEvent(ev);
             }
-
-            return ;
+            //RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
         }
-        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
-
-		bool paused = false ;
+        else
         {
             RS_STACK_MUTEX(mHashMtx) ;
-			paused = mHashingProcessPaused ;
-		}
+            mInactivitySleepTime = 2*st ;
+        }
 
-		if(paused)	// we need to wait off mutex!!
-		{
-			rstime::rs_usleep(MAX_INACTIVITY_SLEEP_TIME) ;
-			std::cerr << "Hashing process currently paused." << std::endl;
-			return;
-		}
-		else
-        {
-            RS_STACK_MUTEX(mHashMtx) ;
+        return ;
+    }
 
-            job = mFilesToHash.begin()->second ;
-            mFilesToHash.erase(mFilesToHash.begin()) ;
-        }
+    if(paused)	// we need to wait off mutex!!
+    {
+        rstime::rs_usleep(MAX_INACTIVITY_SLEEP_TIME) ;
+        std::cerr << "Hashing process currently paused." << std::endl;
+        return;
+    }
+
+    // The actual hashing is done by the workers. Here we only make sure that they are all up, since
+    // some of them may have been stopping when new files were queued.
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
+        locked_startWorkers() ;
+    }
+
+    rstime::rs_usleep(DEFAULT_INACTIVITY_SLEEP_TIME) ;
+}
+
+void HashStorageWorker::threadTick()
+{
+    mStorage->workerTick(this) ;
+}
+
+void HashStorage::workerTick(HashStorageWorker *worker)
+{
+    FileHashJob job ;
+    bool found = false ;
+
+    {
+        std::unique_lock<RsMutex> lock(mHashMtx) ;
+
+        // Idle workers wait until a file they can hash is queued, or a device they wait for is released.
 
-        if(job.client->hash_confirm(job.client_param))
+        mWorkersCv.wait_for(lock,std::chrono::milliseconds(WORKER_IDLE_WAIT_TIME),[this,worker,&job,&found]()
         {
+            found = !worker->shouldStop() && !mHashingProcessPaused && locked_pickJob(job) ;
+            return found || worker->shouldStop() ;
+        }) ;
+
+        if(!found)
+            return ;
+
+        ++mActiveWorkersPerDevice[job.device] ;
+    }
+
+    hashFile(job,worker) ;
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        if(--mActiveWorkersPerDevice[job.device] == 0)
+            mActiveWorkersPerDevice.erase(job.device) ;
+    }
+    mWorkersCv.notify_all();
+}
+
+bool HashStorage::locked_pickJob(FileHashJob& job)
+{
+    // Take the first file of a device that still has room for one more thread. Within a device, files
+    // are taken in path order, which keeps the reads of spinning disks mostly sequential.
+
+    for(auto it(mFilesToHash.begin());it!=mFilesToHash.end();++it)
+    {
+        std::map<uint64_t,uint32_t>::const_iterator ait = mActiveWorkersPerDevice.find(it->first) ;
+
+        if(ait != mActiveWorkersPerDevice.end() && ait->second >= locked_maxWorkersOnDevice(it->first))
+            continue ;
+
+        job = it->second.begin()->second ;
+        it->second.erase(it->second.begin()) ;
+
+        if(it->second.empty())
+            mFilesToHash.erase(it) ;
+
+        return true ;
+    }
+    return false ;
+}
+
+uint32_t HashStorage::locked_maxWorkersOnDevice(uint64_t device)
+{
+    std::map<uint64_t,bool>::const_iterator it = mParallelReadDevices.find(device) ;
+
+    if(it == mParallelReadDevices.end())
+        it = mParallelReadDevices.insert(std::make_pair(device,deviceSupportsParallelReads(device))).first ;
+
+    return it->second ? mMaxHashingThreads : 1 ;
+}
+
+void HashStorage::locked_startWorkers()
+{
+    RS_STACK_MUTEX(mWorkersMtx) ;
+
+    while(mWorkers.size() < mMaxHashingThreads)
+        mWorkers.push_back(new HashStorageWorker(this)) ;
+
+    for(uint32_t i=0;i<mWorkers.size();++i)
+        if(!mWorkers[i]->isRunning())
+            mWorkers[i]->start("fs hash worker") ;
+}
+
+void HashStorage::hashFile(const FileHashJob& job,RsThread *worker)
+{
+    RsFileHash hash;
+    uint64_t size = 0;
+
+    if(!job.client->hash_confirm(job.client_param))
+        return ;
+
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
+    std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
 #endif
 
-            std::string tmpout;
+    std::string tmpout;
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
 
-			if(mCurrentHashingSpeed > 0)
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
-			else
-				rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+        if(mCurrentHashingSpeed > 0)
+            rs_sprintf(tmpout, "%lu/%lu (%s - %d%%, %d MB/s) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), mCurrentHashingSpeed,job.full_path.c_str()) ;
+        else
+            rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+    }
 
-			{
-				/* Emit deprecated event only for retrocompatibility
-				 * TODO: create a proper event with structured data instead of a
-				 * formatted string */
-				auto ev = std::make_shared<RsSharedDirectoriesEvent>();
-				ev->mEventCode = RsSharedDirectoriesEventCode::HASHING_FILE;
-				ev->mMessage = tmpout;
-				rsEvents->postEvent(ev);
-			}
+    {
+        /* Emit deprecated event only for retrocompatibility
+         * TODO: create a proper event with structured data instead of a
+         * formatted string */
+        auto ev = std::make_shared<RsSharedDirectoriesEvent>();
+        ev->mEventCode = RsSharedDirectoriesEventCode::HASHING_FILE;
+        ev->mMessage = tmpout;
+
+        if(rsEvents)
+            rsEvents->postEvent(ev);
+    }
 
-			double seconds_origin = rstime::RsScopeTimer::currentTime() ;
+    bool ok = RsDirUtil::getFileHash(job.full_path, hash, size, worker) ;
 
-			if(RsDirUtil::getFileHash(job.full_path, hash, size, this))
-			{
-				// store the result
+    uint32_t hashing_speed ;
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        // A worker stopped while hashing gives its file back, so that the rest of the pool can hash it.
+
+        if(!ok && worker->shouldStop())
+        {
+            mFilesToHash[job.device][job.real_path] = job ;
+            return ;
+        }
+
+        if(ok)
+        {
+            // store the result
 
 #ifdef HASHSTORAGE_DEBUG
-				std::cerr << "done."<< std::endl;
+            std::cerr << "done."<< std::endl;
 #endif
+            HashStorageInfo& info(mFiles[job.real_path]);
 
-				RS_STACK_MUTEX(mHashMtx) ;
-				HashStorageInfo& info(mFiles[job.real_path]);
-
-				info.filename = job.real_path ;
-				info.size = size ;
-				info.modf_stamp = job.ts ;
-				info.time_stamp = time(NULL);
-				info.hash = hash;
+            info.filename = job.real_path ;
+            info.size = size ;
+            info.modf_stamp = job.ts ;
+            info.time_stamp = time(NULL);
+            info.hash = hash;
 
-				mChanged = true ;
-				mTotalHashedSize += size ;
-			}
-			else RS_ERR("Failure hashing file: ", job.full_path);
+            mChanged = true ;
+            mTotalHashedSize += size ;
+        }
+        else RS_ERR("Failure hashing file: ", job.full_path);
 
-			mHashingTime += rstime::RsScopeTimer::currentTime() - seconds_origin ;
-			mHashedBytes += size ;
+        // The speed is measured over wall clock time, so that it accounts for all the threads of the pool.
 
-			if(mHashingTime > 3)
-			{
-				mCurrentHashingSpeed = (int)(mHashedBytes / mHashingTime ) / (1024*1024) ;
-				mHashingTime = 0 ;
-				mHashedBytes = 0 ;
-			}
+        double now = rstime::RsScopeTimer::currentTime() ;
+        mHashedBytes += size ;
 
-            ++mHashCounter ;
+        if(now > mHashingSpeedWindowStart + 3)
+        {
+            mCurrentHashingSpeed = (int)(mHashedBytes / (now - mHashingSpeedWindowStart)) / (1024*1024) ;
+            mHashingSpeedWindowStart = now ;
+            mHashedBytes = 0 ;
         }
-	}
+
+        ++mHashCounter ;
+        hashing_speed = mCurrentHashingSpeed ;
+    }
 
 	// call the client
-	if(!hash.isNull())
+	if(ok)
 		job.client->hash_callback(job.client_param, job.full_path, hash, size);
 
 	/* Notify we completed hashing a file */
 	auto ev = std::make_shared<RsFileHashingCompletedEvent>();
 	ev->mFilePath = job.full_path;
-	ev->mHashingSpeed = mCurrentHashingSpeed;
+	ev->mHashingSpeed = hashing_speed;
 	ev->mFileHash = hash;
-	rsEvents->postEvent(ev);
+
+	if(rsEvents)
+		rsEvents->postEvent(ev);
 }
 
 bool HashStorage::requestHash(const std::string& full_path,uint64_t size,rstime_t mod_time,RsFileHash& known_hash,HashStorageClient *c,uint32_t client_param)
@@ -298,7 +527,10 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,rstime_
 
     // we need to schedule a re-hashing
 
-    if(mFilesToHash.find(real_path) != mFilesToHash.end())
+    uint64_t device = fileDevice(real_path) ;
+    std::map<std::string,FileHashJob>& device_jobs(mFilesToHash[device]) ;
+
+    if(device_jobs.find(real_path) != device_jobs.end())
         return false ;
 
     FileHashJob job ;
@@ -309,16 +541,18 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,rstime_
     job.full_path = full_path ;
     job.real_path = real_path ;
     job.ts = mod_time ;
+    job.device = device ;
 
 	// We store the files indexed by their real path, so that we allow to not re-hash files that are pointed multiple times through the directory links
 	// The client will be notified with the full path instead of the real path.
 
-    mFilesToHash[real_path] = job;
+    device_jobs[real_path] = job;
 
     mTotalSizeToHash += size ;
     ++mTotalFilesToHash;
 
     startHashThread();
+    mWorkersCv.notify_all();
 
     return false;
 }
@@ -331,8 +565,11 @@ void HashStorage::startHashThread()
         std::cerr << "Starting hashing thread." << std::endl;
         mHashCounter = 0;
         mTotalHashedSize = 0;
+        mHashedBytes = 0;
+        mHashingSpeedWindowStart = rstime::RsScopeTimer::currentTime() ;
 
         start("fs hash cache") ;
+        locked_startWorkers() ;
     }
 }
 
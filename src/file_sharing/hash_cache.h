@@ -24,6 +24,8 @@
 #pragma once
 
 #include <map>
+#include <vector>
+#include <condition_variable>
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 #include "util/rstime.h"
@@ -49,10 +51,30 @@ public:
     virtual bool hash_confirm(uint32_t client_param)=0 ;
 };
 
+class HashStorage ;
+
+/*!
+ * \brief The HashStorageWorker class
+ * 		One thread of the hashing pool. Workers pick files to hash from the HashStorage queue, so that several
+ * 		files can be hashed at the same time when they sit on different devices, or on devices that handle
+ * 		parallel reads well.
+ */
+class HashStorageWorker: public RsTickingThread
+{
+public:
+    explicit HashStorageWorker(HashStorage *storage) : mStorage(storage) {}
+
+    void threadTick() override; /// @see RsTickingThread
+
+private:
+    HashStorage *mStorage ;
+};
+
 class HashStorage: public RsTickingThread
 {
 public:
     explicit HashStorage(const std::string& save_file_name) ;
+    ~HashStorage() override;
 
     /*!
      * \brief requestHash  Requests the hash for the given file, assuming size and mod_time are the same.
@@ -85,9 +107,18 @@ public:
 	void togglePauseHashingProcess() ;
 	bool hashingProcessPaused();
 
+    // size of the pool of hashing threads. Files on a spinning disk are never hashed by more than one thread at a time.
+    // When the pool shrinks, the surplus threads are stopped, and the files they were hashing are queued again.
+    void setHashingThreadsCount(uint32_t n) ;
+    uint32_t hashingThreadsCount() ;
+
 	void threadTick() override; /// @see RsTickingThread
 
     friend std::ostream& operator<<(std::ostream& o,const HashStorageInfo& info) ;
+    friend class HashStorageWorker ;
+protected:
+    void onStopRequested() override;
+
 private:
     /*!
      * \brief clean
@@ -97,6 +128,16 @@ private:
 
     void startHashThread();
     void stopHashThread();
+    void locked_startWorkers();
+
+    struct FileHashJob ;
+
+    // called by the workers of the pool
+
+    void workerTick(HashStorageWorker *worker) ;
+    void hashFile(const FileHashJob& job,RsThread *worker) ;
+    bool locked_pickJob(FileHashJob& job) ;
+    uint32_t locked_maxWorkersOnDevice(uint64_t device) ;
 
     // loading/saving the entire hash database to a file
 
@@ -123,15 +164,23 @@ private:
         HashStorageClient *client;
         uint32_t client_param ;
         rstime_t ts;
+        uint64_t device ;			// device the file is stored on. Used to schedule the hashing pool.
     };
 
-    // current work
+    // current work, sorted by device, then by real path.
+
+    std::map<uint64_t,std::map<std::string,FileHashJob> > mFilesToHash ;
+    std::map<uint64_t,uint32_t> mActiveWorkersPerDevice ;
+    std::map<uint64_t,bool> mParallelReadDevices ;		// cache of which devices do not suffer from parallel reads (SSDs)
 
-    std::map<std::string,FileHashJob> mFilesToHash ;
+    uint32_t mMaxHashingThreads ;
 
     // thread/mutex stuff
 
     RsMutex mHashMtx ;
+    std::condition_variable_any mWorkersCv ;	// signaled when files are queued, or when a worker is done with a file
+    RsMutex mWorkersMtx ;					// protects mWorkers. Always locked after mHashMtx.
+    std::vector<HashStorageWorker*> mWorkers ;
     bool mRunning;
     uint64_t mHashCounter;
     uint32_t mInactivitySleepTime ;
@@ -142,7 +191,7 @@ private:
 
 	// The following is used to estimate hashing speed.
 
-	double mHashingTime ;
+	double mHashingSpeedWindowStart ;
 	uint64_t mHashedBytes ;
 	uint32_t mCurrentHashingSpeed ; // in MB/s
 };
@@ -0,0 +1,477 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: mapped_hierarchy.cc                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef WINDOWS_SYS
+#	include <sys/mman.h>
+#endif
+
+#include "mapped_hierarchy.h"
+
+//#define DEBUG_MAPPED_HIERARCHY 1
+
+static const char     MAPPED_HIERARCHY_MAGIC[8]  = { 'R','S','D','I','R','M','A','P' } ;
+static const uint32_t MAPPED_HIERARCHY_BYTE_ORDER = 0x01020304 ;
+static const uint64_t MAPPED_HIERARCHY_ALIGNMENT  = 8 ;
+
+struct MappedFileHierarchy::Header
+{
+    char     magic[8] ;
+    uint32_t version ;
+    uint32_t byte_order ;
+    uint32_t node_count ;
+    uint32_t children_count ;
+    uint32_t file_hash_count ;
+    uint32_t dir_hash_count ;
+    uint32_t total_files ;
+    uint32_t reserved ;
+    uint64_t total_size ;
+    uint64_t nodes_offset ;
+    uint64_t children_offset ;
+    uint64_t file_hashes_offset ;
+    uint64_t dir_hashes_offset ;
+    uint64_t strings_offset ;
+    uint64_t strings_size ;
+};
+
+static_assert(sizeof(MappedFileHierarchy::Node) == 96,"Unexpected padding in mapped hierarchy nodes") ;
+static_assert(sizeof(MappedFileHierarchy::HashIndexEntry) == 24,"Unexpected padding in mapped hierarchy hash entries") ;
+
+static bool hashEntryLess(const MappedFileHierarchy::HashIndexEntry& e1,const MappedFileHierarchy::HashIndexEntry& e2)
+{
+    return memcmp(e1.hash,e2.hash,RsFileHash::SIZE_IN_BYTES) < 0 ;
+}
+
+static uint64_t alignedOffset(uint64_t offset)
+{
+    return (offset + MAPPED_HIERARCHY_ALIGNMENT - 1) & ~(MAPPED_HIERARCHY_ALIGNMENT - 1) ;
+}
+
+/******************************************************************************************************************/
+/*                                              Mapped File Hierarchy                                             */
+/******************************************************************************************************************/
+
+MappedFileHierarchy::MappedFileHierarchy()
+    : mData(NULL), mDataSize(0), mMapped(false), mHeader(NULL), mNodes(NULL), mChildren(NULL),
+      mFileHashes(NULL), mDirHashes(NULL), mStrings(NULL), mNodeCount(0)
+{
+}
+
+MappedFileHierarchy::~MappedFileHierarchy()
+{
+    close() ;
+}
+
+void MappedFileHierarchy::close()
+{
+    if(mData != NULL)
+    {
+#ifndef WINDOWS_SYS
+        if(mMapped)
+            munmap(mData,mDataSize) ;
+        else
+#endif
+            free(mData) ;
+    }
+
+    mData = NULL ;
+    mDataSize = 0 ;
+    mMapped = false ;
+    mHeader = NULL ;
+    mNodes = NULL ;
+    mChildren = NULL ;
+    mFileHashes = NULL ;
+    mDirHashes = NULL ;
+    mStrings = NULL ;
+    mNodeCount = 0 ;
+}
+
+bool MappedFileHierarchy::isMappedData(const unsigned char *data,uint64_t size)
+{
+    return size >= sizeof(MAPPED_HIERARCHY_MAGIC) && !memcmp(data,MAPPED_HIERARCHY_MAGIC,sizeof(MAPPED_HIERARCHY_MAGIC)) ;
+}
+
+bool MappedFileHierarchy::open(const unsigned char *data,uint64_t size)
+{
+    close() ;
+
+    if(size < sizeof(Header))
+        return false ;
+
+#ifdef WINDOWS_SYS
+    mData = (unsigned char*)malloc(size) ;
+
+    if(mData == NULL)
+    {
+        std::cerr << "(EE) MappedFileHierarchy: cannot allocate " << size << " bytes." << std::endl;
+        return false ;
+    }
+    memcpy(mData,data,size) ;
+#else
+    // The data is copied into its own anonymous mapping, which is then made read-only, so that nothing can change it
+    // after it has been validated.
+
+    void *mem = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0) ;
+
+    if(mem == MAP_FAILED)
+    {
+        std::cerr << "(EE) MappedFileHierarchy: cannot map " << size << " bytes: " << strerror(errno) << std::endl;
+        return false ;
+    }
+    memcpy(mem,data,size) ;
+    mprotect(mem,size,PROT_READ) ;
+
+    mData = (unsigned char*)mem ;
+    mMapped = true ;
+#endif
+    mDataSize = size ;
+    mHeader = reinterpret_cast<const Header*>(mData) ;
+
+    if(!validate())
+    {
+        std::cerr << "(EE) MappedFileHierarchy: data is not a valid mapped file list, or has a different version. It will be ignored." << std::endl;
+        close() ;
+        return false ;
+    }
+
+    mNodeCount  = mHeader->node_count ;
+    mNodes      = reinterpret_cast<const Node*>          (mData + mHeader->nodes_offset) ;
+    mChildren   = reinterpret_cast<const uint32_t*>      (mData + mHeader->children_offset) ;
+    mFileHashes = reinterpret_cast<const HashIndexEntry*>(mData + mHeader->file_hashes_offset) ;
+    mDirHashes  = reinterpret_cast<const HashIndexEntry*>(mData + mHeader->dir_hashes_offset) ;
+    mStrings    = reinterpret_cast<const char*>          (mData + mHeader->strings_offset) ;
+
+#ifdef DEBUG_MAPPED_HIERARCHY
+    std::cerr << "MappedFileHierarchy: mapped " << mNodeCount << " nodes, " << mDataSize << " bytes." << std::endl;
+#endif
+    return true ;
+}
+
+// Checks that all offsets stay within the data, so that no accessor can read outside of it, and that directories form a
+// tree below the root, so that walking down the children or up the parents always ends.
+
+bool MappedFileHierarchy::validate() const
+{
+    const Header& h(*mHeader) ;
+
+    if(memcmp(h.magic,MAPPED_HIERARCHY_MAGIC,sizeof(MAPPED_HIERARCHY_MAGIC)) || h.version != FORMAT_VERSION || h.byte_order != MAPPED_HIERARCHY_BYTE_ORDER)
+        return false ;
+
+    auto section_ok = [this](uint64_t offset,uint64_t count,uint64_t elem_size)
+    {
+        return offset % MAPPED_HIERARCHY_ALIGNMENT == 0 && offset <= mDataSize && count * elem_size <= mDataSize - offset ;
+    };
+
+    if(  !section_ok(h.nodes_offset,h.node_count,sizeof(Node))
+      || !section_ok(h.children_offset,h.children_count,sizeof(uint32_t))
+      || !section_ok(h.file_hashes_offset,h.file_hash_count,sizeof(HashIndexEntry))
+      || !section_ok(h.dir_hashes_offset,h.dir_hash_count,sizeof(HashIndexEntry))
+      || !section_ok(h.strings_offset,h.strings_size,1))
+        return false ;
+
+    if(h.node_count == 0)
+        return false ;
+
+    const Node *nodes = reinterpret_cast<const Node*>(mData + h.nodes_offset) ;
+    const uint32_t *children = reinterpret_cast<const uint32_t*>(mData + h.children_offset) ;
+
+    if(nodes[0].type != TYPE_DIR)
+        return false ;
+
+    for(uint32_t i=0;i<h.node_count;++i)
+    {
+        const Node& n(nodes[i]) ;
+
+        if(n.type == TYPE_EMPTY)
+            continue ;
+
+        if(n.type != TYPE_FILE && n.type != TYPE_DIR)
+            return false ;
+
+        if(n.parent_index >= h.node_count || uint64_t(n.name_offset) + n.name_length > h.strings_size)
+            return false ;
+
+        if(n.type == TYPE_DIR)
+            if(  uint64_t(n.parent_path_offset) + n.parent_path_length > h.strings_size
+              || uint64_t(n.first_child) + n.n_subdirs + n.n_subfiles > h.children_count)
+                return false ;
+    }
+
+    for(uint32_t i=0;i<h.children_count;++i)
+        if(children[i] >= h.node_count)
+            return false ;
+
+    // Each node is the child of at most one directory, which must also be its parent. Every node has a directory as
+    // parent, and every directory is reached from the root: parent chains cannot loop.
+
+    std::vector<bool> reached(h.node_count,false) ;
+    std::vector<uint32_t> to_visit(1,0) ;
+    reached[0] = true ;
+
+    while(!to_visit.empty())
+    {
+        uint32_t d = to_visit.back() ;
+        to_visit.pop_back() ;
+
+        const Node& n(nodes[d]) ;
+
+        for(uint32_t j=0;j<n.n_subdirs+n.n_subfiles;++j)
+        {
+            uint32_t c = children[n.first_child + j] ;
+
+            if(reached[c] || nodes[c].parent_index != d || nodes[c].type != (j < n.n_subdirs ? TYPE_DIR : TYPE_FILE))
+                return false ;
+
+            reached[c] = true ;
+
+            if(nodes[c].type == TYPE_DIR)
+                to_visit.push_back(c) ;
+        }
+    }
+
+    for(uint32_t i=0;i<h.node_count;++i)
+        if(nodes[i].type != TYPE_EMPTY && (nodes[nodes[i].parent_index].type != TYPE_DIR || (nodes[i].type == TYPE_DIR && !reached[i])))
+            return false ;
+
+    const HashIndexEntry *file_hashes = reinterpret_cast<const HashIndexEntry*>(mData + h.file_hashes_offset) ;
+    const HashIndexEntry *dir_hashes  = reinterpret_cast<const HashIndexEntry*>(mData + h.dir_hashes_offset) ;
+
+    for(uint32_t i=0;i<h.file_hash_count;++i)
+        if(file_hashes[i].index >= h.node_count)
+            return false ;
+
+    for(uint32_t i=0;i<h.dir_hash_count;++i)
+        if(dir_hashes[i].index >= h.node_count)
+            return false ;
+
+    return true ;
+}
+
+std::string MappedFileHierarchy::name(uint32_t indx) const
+{
+    return std::string(mStrings + mNodes[indx].name_offset,mNodes[indx].name_length) ;
+}
+
+std::string MappedFileHierarchy::parentPath(uint32_t indx) const
+{
+    return std::string(mStrings + mNodes[indx].parent_path_offset,mNodes[indx].parent_path_length) ;
+}
+
+uint32_t MappedFileHierarchy::totalFiles() const { return mHeader?mHeader->total_files:0 ; }
+uint64_t MappedFileHierarchy::totalSize()  const { return mHeader?mHeader->total_size :0 ; }
+
+bool MappedFileHierarchy::findHash(const HashIndexEntry *tab,uint32_t n,const RsFileHash& hash,uint32_t& indx)
+{
+    HashIndexEntry e ;
+    memcpy(e.hash,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+
+    const HashIndexEntry *it = std::lower_bound(tab,tab+n,e,hashEntryLess) ;
+
+    if(it == tab+n || memcmp(it->hash,e.hash,RsFileHash::SIZE_IN_BYTES))
+        return false ;
+
+    indx = it->index ;
+    return true ;
+}
+
+bool MappedFileHierarchy::findFileHash(const RsFileHash& hash,uint32_t& indx) const
+{
+    return mHeader != NULL && findHash(mFileHashes,mHeader->file_hash_count,hash,indx) ;
+}
+bool MappedFileHierarchy::findDirHash(const RsFileHash& hash,uint32_t& indx) const
+{
+    return mHeader != NULL && findHash(mDirHashes,mHeader->dir_hash_count,hash,indx) ;
+}
+
+/******************************************************************************************************************/
+/*                                                     Builder                                                    */
+/******************************************************************************************************************/
+
+MappedFileHierarchy::Builder::Builder(uint32_t n_nodes)
+    : mOverflow(false)
+{
+    mNodes.reserve(n_nodes) ;
+}
+
+uint32_t MappedFileHierarchy::Builder::addString(const char *s,uint32_t len)
+{
+    // offsets are 32 bits. That leaves 4GB for names, which is far more than any file list.
+
+    if(mStrings.size() + len > 0xffffffffull)
+    {
+        mOverflow = true ;
+        return 0 ;
+    }
+    uint32_t offset = mStrings.size() ;
+    mStrings.append(s,len) ;
+
+    return offset ;
+}
+
+void MappedFileHierarchy::Builder::addEmptyNode()
+{
+    Node n ;
+    memset(&n,0,sizeof(Node)) ;
+
+    n.type = TYPE_EMPTY ;
+    mNodes.push_back(n) ;
+}
+
+void MappedFileHierarchy::Builder::addFileNode(uint32_t parent_index,uint32_t row,const char *name,uint32_t name_length,uint64_t size,rstime_t modtime,const RsFileHash& hash)
+{
+    Node n ;
+    memset(&n,0,sizeof(Node)) ;
+
+    n.type         = TYPE_FILE ;
+    n.parent_index = parent_index ;
+    n.row          = row ;
+    n.name_offset  = addString(name,name_length) ;
+    n.name_length  = name_length ;
+    n.size         = size ;
+    n.modtime      = modtime ;
+
+    memcpy(n.hash,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+
+    mNodes.push_back(n) ;
+}
+
+void MappedFileHierarchy::Builder::addDirNode(uint32_t parent_index, uint32_t row, const char *name, uint32_t name_length, const char *parent_path, uint32_t parent_path_length,
+                                              uint64_t cumulated_size, rstime_t modtime, rstime_t most_recent_time, rstime_t update_time, const RsFileHash& hash,
+                                              const uint32_t *subdirs, uint32_t n_subdirs, const uint32_t *subfiles, uint32_t n_subfiles)
+{
+    Node n ;
+    memset(&n,0,sizeof(Node)) ;
+
+    n.type               = TYPE_DIR ;
+    n.parent_index       = parent_index ;
+    n.row                = row ;
+    n.name_offset        = addString(name,name_length) ;
+    n.name_length        = name_length ;
+    n.parent_path_offset = addString(parent_path,parent_path_length) ;
+    n.parent_path_length = parent_path_length ;
+    n.first_child        = mChildren.size() ;
+    n.n_subdirs          = n_subdirs ;
+    n.n_subfiles         = n_subfiles ;
+    n.size               = cumulated_size ;
+    n.modtime            = modtime ;
+    n.most_recent_time   = most_recent_time ;
+    n.update_time        = update_time ;
+
+    memcpy(n.hash,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+
+    mChildren.insert(mChildren.end(),subdirs,subdirs+n_subdirs) ;
+    mChildren.insert(mChildren.end(),subfiles,subfiles+n_subfiles) ;
+
+    mNodes.push_back(n) ;
+}
+
+void MappedFileHierarchy::Builder::addFileHash(const RsFileHash& hash,uint32_t indx,bool preferred)
+{
+    HashIndexEntry e ;
+    memcpy(e.hash,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+    e.index = indx ;
+
+    if(preferred)
+        mFileHashes.push_back(e) ;
+    else
+        mOtherFileHashes.push_back(e) ;
+}
+void MappedFileHierarchy::Builder::addDirHash(const RsFileHash& hash,uint32_t indx)
+{
+    HashIndexEntry e ;
+    memcpy(e.hash,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES) ;
+    e.index = indx ;
+
+    mDirHashes.push_back(e) ;
+}
+
+// Sorts by hash and removes duplicates, keeping the first entry added for each hash.
+
+void MappedFileHierarchy::Builder::sortHashes(std::vector<HashIndexEntry>& tab)
+{
+    std::stable_sort(tab.begin(),tab.end(),hashEntryLess) ;
+
+    tab.erase(std::unique(tab.begin(),tab.end(),[](const HashIndexEntry& e1,const HashIndexEntry& e2)
+    {
+        return !memcmp(e1.hash,e2.hash,RsFileHash::SIZE_IN_BYTES) ;
+    }),tab.end()) ;
+}
+
+bool MappedFileHierarchy::Builder::build(std::vector<unsigned char>& data,uint32_t total_files,uint64_t total_size)
+{
+    if(mOverflow || mNodes.empty() || mChildren.size() > 0xffffffffull)
+    {
+        std::cerr << "(EE) MappedFileHierarchy: hierarchy is too large, or empty." << std::endl;
+        return false ;
+    }
+
+    mFileHashes.insert(mFileHashes.end(),mOtherFileHashes.begin(),mOtherFileHashes.end()) ;
+    mOtherFileHashes.clear() ;
+
+    sortHashes(mFileHashes) ;
+    sortHashes(mDirHashes) ;
+
+    Header h ;
+    memset(&h,0,sizeof(Header)) ;
+
+    memcpy(h.magic,MAPPED_HIERARCHY_MAGIC,sizeof(MAPPED_HIERARCHY_MAGIC)) ;
+    h.version            = FORMAT_VERSION ;
+    h.byte_order         = MAPPED_HIERARCHY_BYTE_ORDER ;
+    h.node_count         = mNodes.size() ;
+    h.children_count     = mChildren.size() ;
+    h.file_hash_count    = mFileHashes.size() ;
+    h.dir_hash_count     = mDirHashes.size() ;
+    h.total_files        = total_files ;
+    h.total_size         = total_size ;
+    h.nodes_offset       = alignedOffset(sizeof(Header)) ;
+    h.children_offset    = alignedOffset(h.nodes_offset       + mNodes.size()      * sizeof(Node)) ;
+    h.file_hashes_offset = alignedOffset(h.children_offset    + mChildren.size()   * sizeof(uint32_t)) ;
+    h.dir_hashes_offset  = alignedOffset(h.file_hashes_offset + mFileHashes.size() * sizeof(HashIndexEntry)) ;
+    h.strings_offset     = alignedOffset(h.dir_hashes_offset  + mDirHashes.size()  * sizeof(HashIndexEntry)) ;
+    h.strings_size       = mStrings.size() ;
+
+    // Padding between sections stays zero.
+
+    data.assign(h.strings_offset + mStrings.size(),0) ;
+
+    auto write_section = [&data](uint64_t offset,const void *section,uint64_t size)
+    {
+        if(size > 0)
+            memcpy(data.data() + offset,section,size) ;
+    };
+
+    write_section(0                   ,&h                ,sizeof(Header)) ;
+    write_section(h.nodes_offset      ,mNodes.data()     ,mNodes.size()      * sizeof(Node)) ;
+    write_section(h.children_offset   ,mChildren.data()  ,mChildren.size()   * sizeof(uint32_t)) ;
+    write_section(h.file_hashes_offset,mFileHashes.data(),mFileHashes.size() * sizeof(HashIndexEntry)) ;
+    write_section(h.dir_hashes_offset ,mDirHashes.data() ,mDirHashes.size()  * sizeof(HashIndexEntry)) ;
+    write_section(h.strings_offset    ,mStrings.data()   ,mStrings.size()) ;
+
+#ifdef DEBUG_MAPPED_HIERARCHY
+    std::cerr << "MappedFileHierarchy: built " << mNodes.size() << " nodes, " << data.size() << " bytes." << std::endl;
+#endif
+    return true ;
+}
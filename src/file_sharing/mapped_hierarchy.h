@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * libretroshare/src/file_sharing: mapped_hierarchy.h                          *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "retroshare/rstypes.h"
+#include "util/rstime.h"
+
+/*!
+ * \brief The MappedFileHierarchy class
+ * 		Read-only view of a directory hierarchy stored in a flat buffer. It is used for friend file lists, so that they
+ * 		can be browsed and searched without being loaded into individually allocated heap nodes. The buffer is saved
+ * 		encrypted like the other file lists, and is decrypted into an anonymous read-only mapping when loaded.
+ *
+ * 		The buffer contains, in this order:
+ * 			- a header (magic, format version, byte order mark, section offsets and sizes, statistics)
+ * 			- an array of fixed-size node records, one per entry index (empty slots are kept, so that indices are stable)
+ * 			- the children table: for each directory, the indices of its subdirs followed by the indices of its subfiles
+ * 			- the file hash index and the dir hash index, both sorted by hash
+ * 			- the string pool, where names and parent paths are stored
+ *
+ * 		All numbers are in host byte order: the file is a local cache that is re-synced from the friend when it cannot be
+ * 		used. The data is validated when opened, so that the accessors below never read outside of it.
+ */
+class MappedFileHierarchy
+{
+public:
+    static const uint32_t FORMAT_VERSION = 0x0001 ;
+
+    // Node types. These are the same values than InternalFileHierarchyStorage::FileStorageNode::TYPE_*.
+
+    static const uint8_t TYPE_EMPTY = 0x00 ;
+    static const uint8_t TYPE_FILE  = 0x01 ;
+    static const uint8_t TYPE_DIR   = 0x02 ;
+
+    struct Node
+    {
+        uint8_t  type ;					// TYPE_FILE, TYPE_DIR or TYPE_EMPTY
+        uint8_t  reserved[3] ;
+        uint32_t parent_index ;
+        uint32_t row ;
+        uint32_t name_offset ;			// in the string pool
+        uint32_t name_length ;
+        uint32_t parent_path_offset ;	// dirs only
+        uint32_t parent_path_length ;
+        uint32_t first_child ;			// dirs only, in the children table
+        uint32_t n_subdirs ;
+        uint32_t n_subfiles ;
+        uint64_t size ;					// file size, or cumulated size of dirs
+        int64_t  modtime ;
+        int64_t  most_recent_time ;		// dirs only
+        int64_t  update_time ;			// dirs only
+        uint8_t  hash[RsFileHash::SIZE_IN_BYTES] ;
+        uint8_t  padding[4] ;
+    };
+
+    struct HashIndexEntry
+    {
+        uint8_t  hash[RsFileHash::SIZE_IN_BYTES] ;
+        uint32_t index ;
+    };
+
+    MappedFileHierarchy() ;
+    ~MappedFileHierarchy() ;
+
+    // Returns true when the data starts like a mapped hierarchy, whatever its version.
+
+    static bool isMappedData(const unsigned char *data,uint64_t size) ;
+
+    // Copies the data into a new read-only mapping, and validates it.
+
+    bool open(const unsigned char *data,uint64_t size) ;
+
+    uint32_t nodeCount() const { return mNodeCount ; }
+    const Node& node(uint32_t indx) const { return mNodes[indx] ; }
+
+    const char *nameData(uint32_t indx) const { return mStrings + mNodes[indx].name_offset ; }
+    std::string name(uint32_t indx) const ;
+    std::string parentPath(uint32_t indx) const ;
+    RsFileHash hash(uint32_t indx) const { return RsFileHash(mNodes[indx].hash) ; }
+
+    // Children of a dir: n_subdirs subdir indices followed by n_subfiles subfile indices.
+
+    const uint32_t *children(uint32_t indx) const { return mChildren + mNodes[indx].first_child ; }
+
+    // Hash lookups, in log time. Results still need to be checked against the current content of the hierarchy.
+
+    bool findFileHash(const RsFileHash& hash,uint32_t& indx) const ;
+    bool findDirHash(const RsFileHash& hash,uint32_t& indx) const ;
+
+    uint32_t totalFiles() const ;
+    uint64_t totalSize() const ;
+
+    /*!
+     * \brief The Builder class
+     * 		Writes a new mapped hierarchy. Nodes must be supplied in index order, starting from 0.
+     */
+    class Builder
+    {
+    public:
+        explicit Builder(uint32_t n_nodes) ;
+
+        void addEmptyNode() ;
+        void addFileNode(uint32_t parent_index,uint32_t row,const char *name,uint32_t name_length,uint64_t size,rstime_t modtime,const RsFileHash& hash) ;
+        void addDirNode(uint32_t parent_index, uint32_t row, const char *name, uint32_t name_length, const char *parent_path, uint32_t parent_path_length,
+                        uint64_t cumulated_size, rstime_t modtime, rstime_t most_recent_time, rstime_t update_time, const RsFileHash& hash,
+                        const uint32_t *subdirs, uint32_t n_subdirs, const uint32_t *subfiles, uint32_t n_subfiles) ;
+
+        // Only one entry is kept per hash: the first preferred one, or else the first one.
+
+        void addFileHash(const RsFileHash& hash,uint32_t indx,bool preferred) ;
+        void addDirHash(const RsFileHash& hash,uint32_t indx) ;
+
+        // Writes the whole hierarchy into data.
+
+        bool build(std::vector<unsigned char>& data,uint32_t total_files,uint64_t total_size) ;
+
+    private:
+        uint32_t addString(const char *s,uint32_t len) ;
+        static void sortHashes(std::vector<HashIndexEntry>& tab) ;
+
+        std::vector<Node> mNodes ;
+        std::vector<uint32_t> mChildren ;
+        std::vector<HashIndexEntry> mFileHashes ;
+        std::vector<HashIndexEntry> mOtherFileHashes ;
+        std::vector<HashIndexEntry> mDirHashes ;
+        std::string mStrings ;
+        bool mOverflow ;
+    };
+
+private:
+    struct Header ;
+
+    void close() ;
+    bool validate() const ;
+    static bool findHash(const HashIndexEntry *tab,uint32_t n,const RsFileHash& hash,uint32_t& indx) ;
+
+    MappedFileHierarchy(const MappedFileHierarchy&) = delete ;
+    MappedFileHierarchy& operator=(const MappedFileHierarchy&) = delete ;
+
+    unsigned char *mData ;
+    uint64_t mDataSize ;
+    bool mMapped ;		// false when the data was copied to the heap instead
+
+    const Header *mHeader ;
+    const Node *mNodes ;
+    const uint32_t *mChildren ;
+    const HashIndexEntry *mFileHashes ;
+    const HashIndexEntry *mDirHashes ;
+    const char *mStrings ;
+
+    uint32_t mNodeCount ;
+};
@@ -340,6 +340,17 @@ cleanup = true;
 
         rskv->tlvkvs.pairs.push_back(kv);
     }
+    {
+        std::string s ;
+        rs_sprintf(s, "%u", mHashCache->hashingThreadsCount()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = HASHING_THREADS_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
 
     {
         std::string s ;
@@ -390,6 +401,14 @@ cleanup = true;
     {
         RsTlvKeyValue kv;
 
+        kv.key = WATCH_NOTIFICATIONS_SS;
+        kv.value = watchNotificationsEnabled()?"YES":"NO" ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
+    {
+        RsTlvKeyValue kv;
+
         kv.key = TRUST_FRIEND_NODES_FOR_BANNED_FILES_SS;
         kv.value = trustFriendNodesForBannedFiles()?"YES":"NO" ;
 
@@ -473,6 +492,12 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
                 if(sscanf(kit->value.c_str(),"%u",&t) == 1)
                     mHashCache->setRememberHashFilesDuration(t);
             }
+            else if(kit->key == HASHING_THREADS_SS)
+            {
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setHashingThreadsCount(t);
+            }
             else if(kit->key == WATCH_FILE_DURATION_SS)
             {
                 int t=0 ;
@@ -491,6 +516,10 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
             {
                 setWatchEnabled(kit->value == "YES") ;
             }
+            else if(kit->key == WATCH_NOTIFICATIONS_SS)
+            {
+                setWatchNotificationsEnabled(kit->value == "YES") ;
+            }
             else if(kit->key == TRUST_FRIEND_NODES_FOR_BANNED_FILES_SS)
             {
                 setTrustFriendNodesForBannedFiles(kit->value == "YES") ;
@@ -697,6 +726,16 @@ void p3FileDatabase::cleanup()
                 ++it ;
             }
 
+        // Friends may reconnect with another version. Delta support is learned again from their next response.
+
+        for(std::set<RsPeerId>::iterator it(mDeltaSyncPeers.begin());it!=mDeltaSyncPeers.end();)
+        {
+            if(online_peers.find(*it) == online_peers.end())
+                it = mDeltaSyncPeers.erase(it) ;
+            else
+                ++it ;
+        }
+
 		// This is needed at least here, because loadList() might never have been called, if there is no config file present.
 
 		if(mLocalDirWatcher->hashSalt().isNull())
@@ -1263,6 +1302,15 @@ bool p3FileDatabase::hashingProcessPaused()
     RS_STACK_MUTEX(mFLSMtx) ;
     return  mLocalDirWatcher->hashingProcessPaused();
 }
+void p3FileDatabase::setHashingThreadsCount(uint32_t n)
+{
+    mHashCache->setHashingThreadsCount(n) ;
+    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+}
+uint32_t p3FileDatabase::hashingThreadsCount()
+{
+    return mHashCache->hashingThreadsCount() ;
+}
 bool p3FileDatabase::inDirectoryCheck()
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1312,6 +1360,23 @@ bool p3FileDatabase::watchEnabled()
     RS_STACK_MUTEX(mFLSMtx) ;
     return mLocalDirWatcher->isEnabled() ;
 }
+void p3FileDatabase::setWatchNotificationsEnabled(bool b)
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mLocalDirWatcher->setNotificationsEnabled(b) ;
+    IndicateConfigChanged(RsConfigMgr::CheckPriority::SAVE_OFTEN);
+}
+bool p3FileDatabase::watchNotificationsEnabled()
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    return mLocalDirWatcher->notificationsEnabled() ;
+}
+bool p3FileDatabase::getSharedDirectoriesWatchInfo(RsSharedDirectoriesWatchInfo& info)
+{
+    RS_STACK_MUTEX(mFLSMtx) ;
+    mLocalDirWatcher->getWatchInfo(info) ;
+    return true ;
+}
 void p3FileDatabase::setWatchPeriod(uint32_t seconds)
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1695,10 +1760,17 @@ void p3FileDatabase::handleDirSyncRequest(RsFileListsSyncRequestItem *item)
 
 				/* We supply the peer id, in order to possibly remove some
 				 * subdirs, if entries are not allowed to be seen by this peer.
-				 */
-				mLocalSharedDirs->serialiseDirEntry(
-				            entry_index, ritem->directory_content_data,
-				            item->PeerId() );
+				 * Peers that support it only get what changed w.r.t. the files
+				 * they already know, compressed. Older peers get everything. */
+				if( (item->flags & RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED)
+				        && mLocalSharedDirs->serialiseDirEntryDelta(
+				            entry_index, item->known_entries,
+				            ritem->directory_content_data, item->PeerId() ) )
+					ritem->flags |= RsFileListsItem::FLAGS_SYNC_DELTA;
+				else
+					mLocalSharedDirs->serialiseDirEntry(
+					            entry_index, ritem->directory_content_data,
+					            item->PeerId() );
 			}
 			else
 			{
@@ -1712,6 +1784,10 @@ void p3FileDatabase::handleDirSyncRequest(RsFileListsSyncRequestItem *item)
 		}
 	}
 
+	/* Tell the friend that we accept the list of files it knows in its
+	 * requests. Older peers ignore the flag. */
+	ritem->flags |= RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED;
+
 	// sends the response.
 	splitAndSendItem(ritem);
 }
@@ -1873,6 +1949,9 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
         RS_STACK_MUTEX(mFLSMtx) ;
         fi = locked_getFriendIndex(item->PeerId());
 
+        if(item->flags & RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED)
+            mDeltaSyncPeers.insert(item->PeerId()) ;
+
 #ifdef DEBUG_P3FILELISTS
         P3FILELISTS_DEBUG() << "  friend index is " << fi ;
 #endif
@@ -1925,7 +2004,22 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
         P3FILELISTS_DEBUG() << "Performing update of directory index " << std::hex << entry_index << std::dec << " from friend " << item->PeerId() << std::endl;
 #endif
 
-        if(mRemoteDirectories[fi]->deserialiseUpdateDirEntry(entry_index,item->directory_content_data))
+        if(item->flags & RsFileListsItem::FLAGS_SYNC_DELTA)
+        {
+            if(mRemoteDirectories[fi]->deserialiseUpdateDirEntryDelta(entry_index,item->directory_content_data))
+                mRemoteDirectories[fi]->lastSweepTime() = now - DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP + 10 ;  // force re-sweep in 10 secs, so as to fasten updated
+            else
+            {
+                // The delta does not apply to what we have. Ask again for the full content at next sweep.
+
+                P3FILELISTS_ERROR() << "Cannot apply dir entry delta. Asking for full content." << std::endl;
+
+                mFullSyncRequired.insert(item->request_id) ;
+                mRemoteDirectories[fi]->setDirectoryUpdateTime(entry_index,0) ;
+                mRemoteDirectories[fi]->lastSweepTime() = now - DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP + 10 ;
+            }
+        }
+        else if(mRemoteDirectories[fi]->deserialiseUpdateDirEntry(entry_index,item->directory_content_data))
 			mRemoteDirectories[fi]->lastSweepTime() = now - DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP + 10 ;  // force re-sweep in 10 secs, so as to fasten updated
         else
             P3FILELISTS_ERROR() << "(EE) Cannot deserialise dir entry. ERROR. "<< std::endl;
@@ -2056,6 +2150,21 @@ bool p3FileDatabase::locked_generateAndSendSyncRequest(RemoteDirectoryStorage *r
     item->last_known_recurs_modf_TS = max_known_recurs_modf_time ;
     item->PeerId(rds->peerId()) ;
 
+    // Tell the friend which files we already have, so that it only sends what changed. If a previous delta
+    // did not apply, or the directory is too large for the list to fit in a request, the friend sends
+    // everything (still compressed). The list is only sent to friends that advertised delta support in a
+    // previous response, because older peers drop requests that are longer than they expect.
+
+    item->flags |= RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED ;
+
+    if(mFullSyncRequired.erase(sync_req_id) == 0 && mDeltaSyncPeers.find(rds->peerId()) != mDeltaSyncPeers.end())
+    {
+        rds->getKnownEntries(e,item->known_entries) ;
+
+        if(item->known_entries.bin_len > 8*MAX_DIR_SYNC_KNOWN_ENTRIES)
+            item->known_entries.TlvClear() ;
+    }
+
     DirSyncRequestData data ;
 
     data.request_TS = now ;
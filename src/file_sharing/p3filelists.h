@@ -59,6 +59,8 @@
 //
 #pragma once
 
+#include <set>
+
 #include "ft/ftsearch.h"
 #include "ft/ftextralist.h"
 #include "retroshare/rsfiles.h"
@@ -177,6 +179,9 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
         uint32_t watchPeriod() ;
         void setWatchEnabled(bool b) ;
         bool watchEnabled() ;
+        void setWatchNotificationsEnabled(bool b) ;
+        bool watchNotificationsEnabled() ;
+        bool getSharedDirectoriesWatchInfo(RsSharedDirectoriesWatchInfo& info) ;
 
         bool followSymLinks() const;
         void setFollowSymLinks(bool b) ;
@@ -187,6 +192,8 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 		bool inDirectoryCheck();
 		void togglePauseHashingProcess();
 		bool hashingProcessPaused();
+		void setHashingThreadsCount(uint32_t n);
+		uint32_t hashingThreadsCount();
 
     protected:
         void getExtraFilesDirDetails_locked(void *ref,DirectoryStorage::EntryIndex e,DirDetails& d) const;
@@ -268,6 +275,8 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
         rstime_t mLastRemoteDirSweepTS ; // TS for friend list update
         std::map<DirSyncRequestId,DirSyncRequestData> mPendingSyncRequests ; // pending requests, waiting for an answer
         std::map<DirSyncRequestId,RsFileListsSyncResponseItem *> mPartialResponseItems;
+        std::set<DirSyncRequestId> mFullSyncRequired ;                       // directories for which a delta did not apply. Next request asks for full content.
+        std::set<RsPeerId> mDeltaSyncPeers ;                                 // connected friends that accept known entries in sync requests.
 
         void locked_recursSweepRemoteDirectory(RemoteDirectoryStorage *rds, DirectoryStorage::EntryIndex e, int depth);
 
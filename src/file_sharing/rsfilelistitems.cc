@@ -31,6 +31,17 @@ void RsFileListsSyncRequestItem::serial_process(RsGenericSerializer::SerializeJo
     RsTypeSerializer::serial_process<uint32_t>(j,ctx,flags     ,"flags") ;
     RsTypeSerializer::serial_process<uint32_t>(j,ctx,last_known_recurs_modf_TS,"last_known_recurs_modf_TS") ;
     RsTypeSerializer::serial_process<uint64_t>(j,ctx,request_id,"request_id") ;
+
+    // known_entries was added later. Older peers drop items that are longer than they expect, so the field is
+    // only written when it is not empty, which only happens for peers that advertised delta support. Items from
+    // older peers do not have it.
+    if(j == RsGenericSerializer::DESERIALIZE && ctx.mOffset == ctx.mSize)
+        return ;
+
+    if((j == RsGenericSerializer::SIZE_ESTIMATE || j == RsGenericSerializer::SERIALIZE) && known_entries.bin_len == 0)
+        return ;
+
+    RsTypeSerializer::serial_process<RsTlvItem>(j,ctx,known_entries,"known_entries") ;
 }
 void RsFileListsSyncResponseItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
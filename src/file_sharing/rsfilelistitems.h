@@ -64,6 +64,8 @@ public:
     static const uint32_t FLAGS_ENTRY_WAS_REMOVED = 0x0010 ;
     static const uint32_t FLAGS_SYNC_PARTIAL      = 0x0020 ;
     static const uint32_t FLAGS_SYNC_PARTIAL_END  = 0x0040 ;
+    static const uint32_t FLAGS_SYNC_DELTA_SUPPORTED = 0x0080 ;	// request: the client can handle compressed deltas. response: the server accepts known entries in requests.
+    static const uint32_t FLAGS_SYNC_DELTA        = 0x0100 ;	// response: content is a compressed delta against the known files in the request.
 };
 
 /*!
@@ -83,6 +85,8 @@ public:
     uint32_t   flags;                     // used to say that it's a request or a response, say that the directory has been removed, ask for further update, etc.
     uint32_t   last_known_recurs_modf_TS; // time of last modification, computed over all files+directories below.
     uint64_t   request_id;                // use to determine if changes that have occured since last hash
+
+    RsTlvBinaryData known_entries ;       // optional. Fingerprints of the files the client has in this directory. Only sent to peers that support it.
 };
 
 class RsFileListsSyncResponseItem : public RsFileListsItem
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * libretroshare/src/ft: ftchunkbitset.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <bitset>
+
+#include "ft/ftchunkbitset.h"
+#include "retroshare/rstypes.h"
+
+uint32_t ChunkBitSet::popcount(uint64_t w)
+{
+	return std::bitset<64>(w).count() ;
+}
+
+void ChunkBitSet::resize(uint32_t n,bool value)
+{
+	_size = n ;
+	_count = value?n:0 ;
+	_bits.assign((n+63) >> 6,value?~uint64_t(0):uint64_t(0)) ;
+
+	if(value && (n & 63))
+		_bits.back() &= (uint64_t(1) << (n & 63)) - 1 ;	// keep trailing bits at 0
+
+	buildTree() ;
+}
+
+void ChunkBitSet::buildTree()
+{
+	uint32_t W = _bits.size() ;
+	_tree.assign(W+1,0) ;
+
+	// linear time construction: each node pushes its total to its parent.
+
+	for(uint32_t i=1;i<=W;++i)
+	{
+		_tree[i] += popcount(_bits[i-1]) ;
+
+		uint32_t j = i + (i & (~i+1)) ;
+
+		if(j <= W)
+			_tree[j] += _tree[i] ;
+	}
+}
+
+void ChunkBitSet::addToTree(uint32_t word,int32_t delta)
+{
+	uint32_t W = _bits.size() ;
+
+	for(uint32_t j=word+1;j<=W;j += j & (~j+1))
+		_tree[j] += delta ;
+}
+
+void ChunkBitSet::set(uint32_t i)
+{
+	if(test(i))
+		return ;
+
+	_bits[i >> 6] |= uint64_t(1) << (i & 63) ;
+	++_count ;
+	addToTree(i >> 6,1) ;
+}
+
+void ChunkBitSet::reset(uint32_t i)
+{
+	if(!test(i))
+		return ;
+
+	_bits[i >> 6] &= ~(uint64_t(1) << (i & 63)) ;
+	--_count ;
+	addToTree(i >> 6,-1) ;
+}
+
+uint32_t ChunkBitSet::rank(uint32_t i) const
+{
+	if(i >= _size)
+		return _count ;
+
+	uint32_t res = 0 ;
+
+	for(uint32_t j=i >> 6;j>0;j -= j & (~j+1))
+		res += _tree[j] ;
+
+	if(i & 63)
+		res += popcount(_bits[i >> 6] & ((uint64_t(1) << (i & 63)) - 1)) ;
+
+	return res ;
+}
+
+uint32_t ChunkBitSet::findWord(uint32_t& k,bool zeros) const
+{
+	uint32_t W = _bits.size() ;
+	uint32_t step = 1 ;
+
+	while(2*step <= W)
+		step *= 2 ;
+
+	// Fenwick tree descent: node pos+step covers exactly the words [pos,pos+step[
+
+	uint32_t pos = 0 ;
+
+	for(;step>0;step >>= 1)
+		if(pos+step <= W)
+		{
+			uint32_t n = zeros?(64*step - _tree[pos+step]):_tree[pos+step] ;
+
+			if(n <= k)
+			{
+				pos += step ;
+				k -= n ;
+			}
+		}
+
+	return pos ;
+}
+
+uint32_t ChunkBitSet::selectInWord(uint64_t w,uint32_t k)
+{
+	uint32_t pos = 0 ;
+
+	for(uint32_t shift=32;shift>0;shift >>= 1)
+	{
+		uint32_t n = popcount(w & ((uint64_t(1) << shift) - 1)) ;
+
+		if(k >= n)
+		{
+			k -= n ;
+			w >>= shift ;
+			pos += shift ;
+		}
+	}
+	return pos ;
+}
+
+uint32_t ChunkBitSet::select(uint32_t k) const
+{
+	if(k >= _count)
+		return _size ;
+
+	uint32_t w = findWord(k,false) ;
+
+	return 64*w + selectInWord(_bits[w],k) ;
+}
+
+uint32_t ChunkBitSet::selectZero(uint32_t k) const
+{
+	// The padding bits of the last word are zeros, but they always come after all
+	// the real zeros, so they cannot be selected here.
+
+	if(k >= _size - _count)
+		return _size ;
+
+	uint32_t w = findWord(k,true) ;
+
+	return 64*w + selectInWord(~_bits[w],k) ;
+}
+
+void ChunkBitSet::assignAnd(const ChunkBitSet& a,const CompressedChunkMap& m)
+{
+	_size = a._size ;
+	_count = 0 ;
+	_bits.resize(a._bits.size()) ;
+
+	for(uint32_t w=0;w<_bits.size();++w)
+	{
+		uint64_t lo = (2*w   < m._map.size())?m._map[2*w  ]:0 ;
+		uint64_t hi = (2*w+1 < m._map.size())?m._map[2*w+1]:0 ;
+
+		_bits[w] = a._bits[w] & (lo | (hi << 32)) ;
+		_count += popcount(_bits[w]) ;
+	}
+
+	buildTree() ;
+}
+
+void ChunkBitSet::toCompressedChunkMap(CompressedChunkMap& m) const
+{
+	m._map.resize(CompressedChunkMap::getCompressedSize(_size)) ;
+
+	for(uint32_t j=0;j<m._map.size();++j)
+		m._map[j] = (uint32_t)(_bits[j >> 1] >> (32*(j & 1))) ;
+}
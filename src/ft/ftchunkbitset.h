@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * libretroshare/src/ft: ftchunkbitset.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+class CompressedChunkMap ;
+
+// ChunkBitSet: one bit per chunk, with rank/select support.
+//
+// Bits are stored in 64 bits words. On top of them we keep a Fenwick tree of the
+// per-word population counts, so that:
+// 	- set/reset of a single bit costs O(log(n/64))
+// 	- rank(i), the number of set bits strictly before i, costs O(log(n/64))
+// 	- select(k), the position of the k-th set bit, costs O(log(n/64))
+// 	- count() is O(1)
+//
+// This is what ChunkMap uses to pick the k-th outstanding chunk available from a given
+// source without scanning the whole file, which matters for files with 10^5 chunks and more.
+//
+class ChunkBitSet
+{
+	public:
+		ChunkBitSet(): _size(0),_count(0) {}
+
+		/// Resizes to n bits, all set to the given value.
+		void resize(uint32_t n,bool value) ;
+
+		/// Number of bits
+		uint32_t size() const { return _size ; }
+
+		/// Number of bits set to 1
+		uint32_t count() const { return _count ; }
+
+		bool test(uint32_t i) const { return (_bits[i >> 6] >> (i & 63)) & 1 ; }
+
+		void set(uint32_t i) ;
+		void reset(uint32_t i) ;
+
+		/// Number of set bits in [0,i[
+		uint32_t rank(uint32_t i) const ;
+
+		/// Position of the k-th set bit (k starting at 0). Returns size() if there is no such bit.
+		uint32_t select(uint32_t k) const ;
+
+		/// Position of the k-th unset bit (k starting at 0). Returns size() if there is no such bit.
+		uint32_t selectZero(uint32_t k) const ;
+
+		/// True if all bits in [b,e[ are set.
+		bool allSet(uint32_t b,uint32_t e) const { return b >= e || rank(e) - rank(b) == e - b ; }
+
+		/// True if no bit in [b,e[ is set.
+		bool noneSet(uint32_t b,uint32_t e) const { return b >= e || rank(e) == rank(b) ; }
+
+		/// Sets *this to (a AND m), where m is a peer compressed chunk map of the same size.
+		void assignAnd(const ChunkBitSet& a,const CompressedChunkMap& m) ;
+
+		/// Converts to the compressed map format that is sent to peers.
+		void toCompressedChunkMap(CompressedChunkMap& m) const ;
+
+		static uint32_t popcount(uint64_t w) ;
+
+	private:
+		void buildTree() ;
+		void addToTree(uint32_t word,int32_t delta) ;
+
+		/// Finds the word containing the k-th set (resp. unset) bit and updates k to be the rank within that word.
+		uint32_t findWord(uint32_t& k,bool zeros) const ;
+
+		static uint32_t selectInWord(uint64_t w,uint32_t k) ;
+
+		uint32_t _size ;
+		uint32_t _count ;
+		std::vector<uint64_t> _bits ;	// bits beyond _size are always 0
+		std::vector<uint32_t> _tree ;	// Fenwick tree of per-word popcounts. 1-based.
+};
@@ -73,6 +73,9 @@ ChunkMap::ChunkMap(uint64_t s,bool availability)
 		++n ;
 
 	_map.resize(n,FileChunksInfo::CHUNK_OUTSTANDING) ;
+	_outstanding_chunks.resize(n,true) ;
+	_done_chunks.resize(n,false) ;
+	_nb_checking_chunks = 0 ;
 	_strategy = FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE ;
 	_total_downloaded = 0 ;
 	_file_is_complete = false ;
@@ -116,6 +119,69 @@ void ChunkMap::setAvailabilityMap(const CompressedChunkMap& map)
 			_map[i] = FileChunksInfo::CHUNK_OUTSTANDING ;
 			_file_is_complete = false ;
 		}
+
+	rebuildChunkBitSets() ;
+}
+
+void ChunkMap::setChunkState(uint32_t c,FileChunksInfo::ChunkState state)
+{
+	FileChunksInfo::ChunkState old_state = _map[c] ;
+
+	if(old_state == state)
+		return ;
+
+	_map[c] = state ;
+
+	if(old_state == FileChunksInfo::CHUNK_CHECKING) --_nb_checking_chunks ;
+	if(    state == FileChunksInfo::CHUNK_CHECKING) ++_nb_checking_chunks ;
+
+	if(old_state == FileChunksInfo::CHUNK_DONE) _done_chunks.reset(c) ;
+	if(    state == FileChunksInfo::CHUNK_DONE) _done_chunks.set(c) ;
+
+	if(old_state != FileChunksInfo::CHUNK_OUTSTANDING && state != FileChunksInfo::CHUNK_OUTSTANDING)
+		return ;
+
+	bool outstanding = (state == FileChunksInfo::CHUNK_OUTSTANDING) ;
+
+	if(outstanding)
+		_outstanding_chunks.set(c) ;
+	else
+		_outstanding_chunks.reset(c) ;
+
+	// Also update the outstanding chunks that each source can provide.
+
+	for(std::map<RsPeerId,SourceChunksInfo>::iterator it(_peers_chunks_availability.begin());it!=_peers_chunks_availability.end();++it)
+		if(!it->second.is_full && it->second.cmap[c])
+		{
+			if(outstanding)
+				it->second.available.set(c) ;
+			else
+				it->second.available.reset(c) ;
+		}
+}
+
+void ChunkMap::rebuildChunkBitSets()
+{
+	_outstanding_chunks.resize(_map.size(),false) ;
+	_done_chunks.resize(_map.size(),false) ;
+	_nb_checking_chunks = 0 ;
+
+	for(uint32_t i=0;i<_map.size();++i)
+		switch(_map[i])
+		{
+			case FileChunksInfo::CHUNK_OUTSTANDING: _outstanding_chunks.set(i) ;
+																 break ;
+			case FileChunksInfo::CHUNK_DONE:        _done_chunks.set(i) ;
+																 break ;
+			case FileChunksInfo::CHUNK_CHECKING:    ++_nb_checking_chunks ;
+																 break ;
+			default:
+																 break ;
+		}
+
+	for(std::map<RsPeerId,SourceChunksInfo>::iterator it(_peers_chunks_availability.begin());it!=_peers_chunks_availability.end();++it)
+		if(!it->second.is_full)
+			it->second.available.assignAnd(_outstanding_chunks,it->second.cmap) ;
 }
 
 void ChunkMap::dataReceived(const ftChunk::OffsetInFile& cid)
@@ -162,12 +228,12 @@ void ChunkMap::dataReceived(const ftChunk::OffsetInFile& cid)
 		std::cerr << "*** ChunkMap::dataReceived: Chunk is complete. Removing it." << std::endl ;
 #endif
 
-		_map[n] = FileChunksInfo::CHUNK_CHECKING ;
+		setChunkState(n,FileChunksInfo::CHUNK_CHECKING) ;
 
 		if(n > 0 || _file_size > CHUNKMAP_FIXED_CHUNK_SIZE)	// dont' put <1MB files into checking mode. This is useless.
 			_chunks_checking_queue.push_back(n) ;
 		else
-			_map[n] = FileChunksInfo::CHUNK_DONE ;
+			setChunkState(n,FileChunksInfo::CHUNK_DONE) ;
 
 		_slices_to_download.erase(itc) ;
 
@@ -177,21 +243,13 @@ void ChunkMap::dataReceived(const ftChunk::OffsetInFile& cid)
 
 void ChunkMap::updateTotalDownloaded()
 {
-	_total_downloaded = 0 ;
-	_file_is_complete = true ;
-
-	// First, round over chunk map to get the raw info.
+	// First, count done and checking chunks. Only the last chunk may be smaller than _chunk_size.
 	//
-	for(uint32_t i=0;i<_map.size();++i)
-		switch(_map[i])
-		{
-			case FileChunksInfo::CHUNK_CHECKING: _file_is_complete = false ;
-				/* fallthrough */
-			case FileChunksInfo::CHUNK_DONE:		 _total_downloaded += sizeOfChunk(i) ;
-															 break ;
-			default:
-															 _file_is_complete = false ;
-		}
+	_file_is_complete = (_done_chunks.count() == _map.size()) ;
+	_total_downloaded = (_done_chunks.count() + (uint64_t)_nb_checking_chunks) * _chunk_size ;
+
+	if(!_map.empty() && (_map.back() == FileChunksInfo::CHUNK_DONE || _map.back() == FileChunksInfo::CHUNK_CHECKING))
+		_total_downloaded -= _chunk_size - sizeOfChunk(_map.size()-1) ;
 
 	// Then go through active chunks.
 	//
@@ -234,23 +292,16 @@ void ChunkMap::setChunkCheckingResult(uint32_t chunk_number,bool check_succeeded
 	
 	if(check_succeeded)
 	{
-		_map[chunk_number] = FileChunksInfo::CHUNK_DONE ;
+		setChunkState(chunk_number,FileChunksInfo::CHUNK_DONE) ;
 
 		// We also check whether the file is complete or not.
 
-		_file_is_complete = true ;
-
-		for(uint32_t i=0;i<_map.size();++i)
-			if(_map[i] != FileChunksInfo::CHUNK_DONE)
-			{
-				_file_is_complete = false ;
-				break ;
-			}
+		_file_is_complete = (_done_chunks.count() == _map.size()) ;
 	}
 	else
 	{
 		_total_downloaded -= sizeOfChunk(chunk_number) ;	// restore completion.
-		_map[chunk_number] = FileChunksInfo::CHUNK_OUTSTANDING ;
+		setChunkState(chunk_number,FileChunksInfo::CHUNK_OUTSTANDING) ;
 	}
 }
 
@@ -260,9 +311,8 @@ bool ChunkMap::reAskPendingChunk( const RsPeerId& peer_id,
 {
 	// make sure that we're at the end of the file. No need to be too greedy in the middle of it.
 
-	for(uint32_t i=0;i<_map.size();++i)
-		if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING)
-			return false ;
+	if(_outstanding_chunks.count() > 0)
+		return false ;
 
 	rstime_t now = time(NULL);
 
@@ -361,7 +411,7 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 				//
 				uint32_t soc = sizeOfChunk(c) ;
 				_active_chunks_feed[peer_id] = Chunk( c*(uint64_t)_chunk_size, soc ) ;
-				_map[c] = FileChunksInfo::CHUNK_ACTIVE ;
+				setChunkState(c,FileChunksInfo::CHUNK_ACTIVE) ;
 				_slices_to_download[c]._remains = soc ;			// init the list of slices to download
 				it = _active_chunks_feed.find(peer_id) ;
 #ifdef DEBUG_FTCHUNK
@@ -415,7 +465,7 @@ void ChunkMap::removeInactiveChunks(std::vector<ftChunk::OffsetInFile>& to_remov
 			for(std::map<ftChunk::OffsetInFile,ChunkDownloadInfo::SliceRequestInfo>::const_iterator it2(it->second._slices.begin());it2!=it->second._slices.end();++it2)
 				to_remove.push_back(it2->first) ;
 
-			_map[it->first] = FileChunksInfo::CHUNK_OUTSTANDING ;	// reset the chunk
+			setChunkState(it->first,FileChunksInfo::CHUNK_OUTSTANDING) ;	// reset the chunk
 
 			_total_downloaded -= (sizeOfChunk(it->first) - it->second._remains) ;	// restore completion.
 
@@ -459,6 +509,12 @@ bool ChunkMap::hasChunkState(uint64_t offset, uint32_t chunk_size, FileChunksInf
 	// It's possible that chunk_number_start==chunk_number_end+1, but for this we need to have
 	// chunk_size=0, and offset%_chunk_size=0, so the response "true" is still valid.
 	//
+	if(state == FileChunksInfo::CHUNK_DONE && chunk_number_end <= _map.size())
+		return _done_chunks.allSet(chunk_number_start,chunk_number_end) ;
+
+	if(state == FileChunksInfo::CHUNK_OUTSTANDING && chunk_number_end <= _map.size())
+		return _outstanding_chunks.allSet(chunk_number_start,chunk_number_end) ;
+
 	for(uint32_t i=chunk_number_start;i<chunk_number_end;++i)
         if(_map[i] != state)
 		{
@@ -493,14 +549,21 @@ void ChunkMap::setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedCh
 	mi.TS = time(NULL) ;
 	mi.is_full = true ;
 
-	// Checks wether the map is full of not.
+	// Checks wether the map is full of not, one word at a time.
 	//
-	for(uint32_t i=0;i<_map.size();++i)
-		if(!cmap[i])
-		{
+	for(uint32_t i=0;i<cmap._map.size() && mi.is_full;++i)
+	{
+		uint32_t nb_bits = std::min((uint32_t)32,(uint32_t)_map.size() - 32*i) ;
+		uint32_t mask = (nb_bits == 32)?(~(uint32_t)0):(((uint32_t)1 << nb_bits) - 1) ;
+
+		if((cmap._map[i] & mask) != mask)
 			mi.is_full = false ;
-			break ;
-		}
+	}
+
+	// For partial sources, keep the outstanding chunks they have, so that selecting one is O(log n).
+	//
+	if(!mi.is_full)
+		mi.available.assignAnd(_outstanding_chunks,cmap) ;
 
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "ChunkMap::setPeerAvailabilityMap: Setting chunk availability info for peer " << peer_id << std::endl ;
@@ -547,6 +610,7 @@ SourceChunksInfo *ChunkMap::getSourceChunksInfo(const RsPeerId& peer_id)
 			pchunks.cmap._map.resize( CompressedChunkMap::getCompressedSize(_map.size()),0 ) ;
 			pchunks.TS = 0 ;
 			pchunks.is_full = false ;
+			pchunks.available.resize(_map.size(),false) ;
 		}
 
 		it = _peers_chunks_availability.find(peer_id) ;
@@ -583,17 +647,19 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 	else
 		map_is_too_old = false ;// the map is not too old
 
-	uint32_t available_chunks = 0 ;
+	// Outstanding chunks that this peer can send us. For full sources this is just the outstanding chunks.
+	//
+	const ChunkBitSet& available(peer_chunks->is_full?_outstanding_chunks:peer_chunks->available) ;
+
+	uint32_t available_chunks = available.count() ;
 	uint32_t available_chunks_before_max_dist = 0 ;
 
-	for(unsigned int i=0;i<_map.size();++i)
-		if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING)
-		{
-			if(peer_chunks->is_full || peer_chunks->cmap[i])
-				++available_chunks ;
-		}
-		else
-			available_chunks_before_max_dist = available_chunks ;
+	// Number of available chunks located before the last chunk that is not outstanding anymore.
+	//
+	uint32_t nb_not_outstanding = _map.size() - _outstanding_chunks.count() ;
+
+	if(nb_not_outstanding > 0)
+		available_chunks_before_max_dist = available.rank(_outstanding_chunks.selectZero(nb_not_outstanding-1)) ;
 
 	if(available_chunks > 0)
 	{
@@ -610,21 +676,11 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 			default:
 																			 chosen_chunk_number = 0 ;
 		}
-		uint32_t j=0 ;
-
-		for(uint32_t i=0;i<_map.size();++i)
-			if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING && (peer_chunks->is_full || peer_chunks->cmap[i]))
-			{
-				if(j == chosen_chunk_number)
-				{
+		uint32_t i = available.select(chosen_chunk_number) ;
 #ifdef DEBUG_FTCHUNK
-					std::cerr << "ChunkMap::getAvailableChunk: returning chunk " << i << " for peer " << peer_id << std::endl;
+		std::cerr << "ChunkMap::getAvailableChunk: returning chunk " << i << " for peer " << peer_id << std::endl;
 #endif
-					return i ;
-				}
-				else
-					++j ;
-			}
+		return i ;
 	}
 
 #ifdef DEBUG_FTCHUNK
@@ -663,7 +719,11 @@ void ChunkMap::removeFileSource(const RsPeerId& peer_id)
 
 void ChunkMap::getAvailabilityMap(CompressedChunkMap& compressed_map) const 
 {
+#ifdef USE_NEW_CHUNK_CHECKING_CODE
+	_done_chunks.toCompressedChunkMap(compressed_map) ;
+#else
 	compressed_map = CompressedChunkMap(_map) ; 
+#endif
 
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "ChunkMap:: retrieved availability map of size " << _map.size() << ", chunk_size=" << _chunk_size << std::endl ;
@@ -678,6 +738,8 @@ void ChunkMap::forceCheck()
 		_chunks_checking_queue.push_back(i) ;
 	}
 
+	rebuildChunkBitSets() ;
+
 	updateTotalDownloaded() ;
 }
 
@@ -24,6 +24,7 @@
 
 #include <map>
 #include "retroshare/rstypes.h"
+#include "ft/ftchunkbitset.h"
 
 // ftChunkMap: 
 // 	- handles chunk map over a complete file
@@ -113,6 +114,7 @@ class SourceChunksInfo
 		CompressedChunkMap cmap ;	//! map of what the peer has/doens't have
 		rstime_t TS ;						//! last update time for this info
 		bool is_full ;					//! is the map full ? In such a case, re-asking for it is unnecessary.
+		ChunkBitSet available ;		//! outstanding chunks that this peer has. Not maintained when is_full is true.
 
 		// Returns true if the offset is starting in a mapped chunk.
 		//
@@ -244,6 +246,12 @@ class ChunkMap
 	private:
         bool hasChunkState(uint64_t offset, uint32_t chunk_size, FileChunksInfo::ChunkState state) const;
 
+		/// Changes the state of a single chunk, keeping the chunk bit sets and per-source availability in sync with _map.
+		void setChunkState(uint32_t chunk_number,FileChunksInfo::ChunkState state) ;
+
+		/// Recomputes the chunk bit sets from _map. Used after changing _map as a whole.
+		void rebuildChunkBitSets() ;
+
 		uint64_t												_file_size ;						//! total size of the file in bytes.
 		uint32_t												_chunk_size ;						//! Size of chunks. Common to all chunks.
 		FileChunksInfo::ChunkStrategy 				_strategy ;							//! how do we allocate new chunks
@@ -255,6 +263,9 @@ class ChunkMap
 		bool													_file_is_complete ;           //! set to true when the file is complete.
 		bool													_assume_availability ;			//! true if all sources always have the complete file.
 		std::vector<uint32_t>							_chunks_checking_queue ;		//! Queue of downloaded chunks to be checked.
+		ChunkBitSet											_outstanding_chunks ;			//! chunks in CHUNK_OUTSTANDING state
+		ChunkBitSet											_done_chunks ;					//! chunks in CHUNK_DONE state
+		uint32_t												_nb_checking_chunks ;			//! number of chunks in CHUNK_CHECKING state
 };
 
 
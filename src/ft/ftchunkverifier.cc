@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * libretroshare/src/ft: ftchunkverifier.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <thread>
+
+#include "ft/ftchunkverifier.h"
+#include "ft/ftfilecreator.h"
+
+/********
+ * #define DEBUG_CHUNK_VERIFIER 1
+ *********/
+
+static const uint32_t MAX_CHUNK_VERIFIER_THREADS     =      4 ;	//! chunks are 1MB, so a few threads are enough to follow a fast LAN
+static const uint32_t CHUNK_VERIFIER_IDLE_WAIT_TIME  =    500 ;	//! 0.5 sec. Only bounds how long stopping a worker takes
+
+ftChunkVerifier::ftChunkVerifier() : mStopping(false) {}
+
+ftChunkVerifier::~ftChunkVerifier()
+{
+	std::vector<ftChunkVerifierWorker*> workers ;
+	{
+		std::lock_guard<std::mutex> lock(mVerifierMtx) ;
+		mStopping = true ;
+		mJobs.clear() ;
+		workers.swap(mWorkers) ;
+	}
+	mVerifierCv.notify_all() ;
+
+	for(uint32_t i=0;i<workers.size();++i)
+	{
+		workers[i]->fullstop();
+		delete workers[i];
+	}
+}
+
+void ftChunkVerifier::locked_startWorkers()
+{
+	uint32_t n = std::max(1u,std::min((uint32_t)std::thread::hardware_concurrency(),MAX_CHUNK_VERIFIER_THREADS)) ;
+
+	while(mWorkers.size() < n)
+	{
+		mWorkers.push_back(new ftChunkVerifierWorker(this)) ;
+		mWorkers.back()->start("ft chunk check") ;
+	}
+}
+
+void ftChunkVerifier::queueChunk(ftFileCreator *creator,uint32_t chunk_number,const Sha1CheckSum& sum)
+{
+	{
+		std::lock_guard<std::mutex> lock(mVerifierMtx) ;
+
+		if(mStopping)
+			return ;
+
+		// The same sum may come from several sources. Only check the chunk once.
+
+		for(std::list<ChunkJob>::const_iterator it(mJobs.begin());it!=mJobs.end();++it)
+			if(it->creator == creator && it->chunk_number == chunk_number)
+				return ;
+
+		ChunkJob job ;
+		job.creator = creator ;
+		job.chunk_number = chunk_number ;
+		job.sum = sum ;
+
+		mJobs.push_back(job) ;
+
+#ifdef DEBUG_CHUNK_VERIFIER
+		std::cerr << "ftChunkVerifier: queued chunk " << chunk_number << " of creator " << (void*)creator << ". " << mJobs.size() << " chunks pending." << std::endl;
+#endif
+		locked_startWorkers() ;
+	}
+	mVerifierCv.notify_all() ;
+}
+
+void ftChunkVerifier::removeFileCreator(ftFileCreator *creator)
+{
+	std::unique_lock<std::mutex> lock(mVerifierMtx) ;
+
+	for(std::list<ChunkJob>::iterator it(mJobs.begin());it!=mJobs.end();)
+		if(it->creator == creator)
+			it = mJobs.erase(it) ;
+		else
+			++it ;
+
+	// A worker may still be reading from this file. Wait until it is done.
+
+	mVerifierCv.wait(lock,[this,creator]() { return mActiveJobs.find(creator) == mActiveJobs.end() ; }) ;
+}
+
+uint32_t ftChunkVerifier::pendingChunks()
+{
+	std::lock_guard<std::mutex> lock(mVerifierMtx) ;
+	return mJobs.size() ;
+}
+
+void ftChunkVerifierWorker::threadTick()
+{
+	mVerifier->workerTick() ;
+}
+
+void ftChunkVerifier::workerTick()
+{
+	ChunkJob job ;
+	{
+		std::unique_lock<std::mutex> lock(mVerifierMtx) ;
+
+		mVerifierCv.wait_for(lock,std::chrono::milliseconds(CHUNK_VERIFIER_IDLE_WAIT_TIME),[this]()
+		{
+			return mStopping || !mJobs.empty() ;
+		}) ;
+
+		if(mStopping || mJobs.empty())
+			return ;
+
+		job = mJobs.front() ;
+		mJobs.pop_front() ;
+
+		++mActiveJobs[job.creator] ;
+	}
+
+#ifdef DEBUG_CHUNK_VERIFIER
+	std::cerr << "ftChunkVerifier: checking chunk " << job.chunk_number << " of creator " << (void*)job.creator << std::endl;
+#endif
+	job.creator->verifyChunk(job.chunk_number,job.sum) ;
+
+	{
+		std::lock_guard<std::mutex> lock(mVerifierMtx) ;
+
+		if(--mActiveJobs[job.creator] == 0)
+			mActiveJobs.erase(job.creator) ;
+	}
+	mVerifierCv.notify_all() ;
+}
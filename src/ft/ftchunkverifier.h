@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * libretroshare/src/ft: ftchunkverifier.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "util/rsthreads.h"
+#include "retroshare/rstypes.h"
+
+class ftFileCreator ;
+class ftChunkVerifier ;
+
+/*!
+ * \brief The ftChunkVerifierWorker class
+ * 		One thread of the chunk verification pool. Reads a downloaded chunk, hashes it and reports
+ * 		the result to the file creator.
+ */
+class ftChunkVerifierWorker: public RsTickingThread
+{
+public:
+	explicit ftChunkVerifierWorker(ftChunkVerifier *verifier) : mVerifier(verifier) {}
+
+	void threadTick() override; /// @see RsTickingThread
+
+private:
+	ftChunkVerifier *mVerifier ;
+};
+
+/*!
+ * \brief The ftChunkVerifier class
+ * 		Checks downloaded chunks against the sha1 sums received from the sources, away from the
+ * 		ftDataMultiplex thread, so that hashing 1MB chunks does not delay the dispatch of incoming data.
+ * 		Results are given back to each file creator with ftFileCreator::verifyChunk().
+ */
+class ftChunkVerifier
+{
+public:
+	ftChunkVerifier() ;
+	~ftChunkVerifier() ;
+
+	/// Queues a chunk for verification. Workers are started on demand.
+	void queueChunk(ftFileCreator *creator,uint32_t chunk_number,const Sha1CheckSum& sum) ;
+
+	/// Drops the pending jobs of this file creator, and waits until no worker uses it anymore.
+	/// Must be called before the file creator gets deleted.
+	void removeFileCreator(ftFileCreator *creator) ;
+
+	/// Number of chunks waiting for a worker.
+	uint32_t pendingChunks() ;
+
+private:
+	struct ChunkJob
+	{
+		ftFileCreator *creator ;
+		uint32_t chunk_number ;
+		Sha1CheckSum sum ;
+	};
+
+	void workerTick() ;
+	void locked_startWorkers() ;
+
+	std::mutex mVerifierMtx ;
+	std::condition_variable mVerifierCv ;	// signaled when a chunk is queued or done being checked
+
+	bool mStopping ;
+	std::list<ChunkJob> mJobs ;
+	std::map<ftFileCreator*,uint32_t> mActiveJobs ;			// number of jobs being processed for each file creator
+	std::vector<ftChunkVerifierWorker*> mWorkers ;
+
+	friend class ftChunkVerifierWorker ;
+};
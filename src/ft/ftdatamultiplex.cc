@@ -35,6 +35,7 @@
 #include "util/rsmemory.h"
 #include "retroshare/rsturtle.h"
 #include "util/rstime.h"
+#include "util/rsperfstats.h"
 #include "util/largefile_retrocompat.hpp"
 
 
@@ -65,7 +66,8 @@ const uint32_t FT_CLIENT_CHUNK_CRC_REQ	= 0x0006;		// chunk sha1 crc request to b
 
 ftRequest::ftRequest(uint32_t type, const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunk, void *data)
 	:mType(type), mPeerId(peerId), mHash(hash), mSize(size),
-	mOffset(offset), mChunk(chunk), mData(data)
+	mOffset(offset), mChunk(chunk), mData(data),
+	mQueuedUs(RsPerfStats::nowUs())
 {
 	return;
 }
@@ -137,6 +139,12 @@ bool	ftDataMultiplex::removeTransferModule(const RsFileHash& hash)
 		/* error */
 		return false;
 	}
+
+	// ftController deletes the file creator right after this call, so make sure that
+	// no chunk verification thread still uses it.
+	//
+	mChunkVerifier.removeFileCreator(it->second.mCreator) ;
+
 	mClients.erase(it);
 
 	// This is very important to delete the hash from servers as well, because
@@ -342,6 +350,9 @@ bool 	ftDataMultiplex::workQueued()
 	
 bool 	ftDataMultiplex::doWork()
 {
+	RS_PERF_TICK_SCOPE("ftDataMultiplex::doWork");
+	static RsPerfCounter& queue_wait(RsPerfStats::counter("ftDataMultiplex/queue_wait"));
+
 	bool doRequests = true;
 
 	/* Handle All the current Requests */		
@@ -360,6 +371,7 @@ bool 	ftDataMultiplex::doWork()
 			req = mRequestQueue.front();
 			mRequestQueue.pop_front();
 		}
+		queue_wait.record(RsPerfStats::nowUs() - req.mQueuedUs);
 
 		/* MUTEX FREE */
 
@@ -430,6 +442,7 @@ bool 	ftDataMultiplex::doWork()
 		req = mSearchQueue.front();
 		mSearchQueue.pop_front();
 	}
+	queue_wait.record(RsPerfStats::nowUs() - req.mQueuedUs);
 
 #ifdef MPLEX_DEBUG
 	std::cerr << "ftDataMultiplex::doWork() Handling Search Request";
@@ -526,7 +539,7 @@ bool ftDataMultiplex::dispatchReceivedChunkCheckSum()
 #ifdef MPLEX_DEBUG
 				std::cerr << "ftDataMultiplex::dispatchReceivedChunkCheckSum(): checking chunk " << chunk_number << " with hash " << it->second._map[chunk_number].toStdString() << std::endl;
 #endif
-				client->verifyChunk(chunk_number,it->second._map[chunk_number]) ;
+				mChunkVerifier.queueChunk(client,chunk_number,it->second._map[chunk_number]) ;
 			}
 			it->second._received.pop_back() ;
 		}
@@ -42,6 +42,7 @@ class ftSearch;
 #include "util/rsthreads.h"
 
 #include "ft/ftdata.h"
+#include "ft/ftchunkverifier.h"
 #include "retroshare/rsfiles.h"
 
 
@@ -63,7 +64,7 @@ class ftRequest
 	ftRequest(uint32_t type, const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunk, void *data);
 
 	ftRequest()
-	:mType(0), mSize(0), mOffset(0), mChunk(0), mData(NULL) { return; }
+	:mType(0), mSize(0), mOffset(0), mChunk(0), mData(NULL), mQueuedUs(0) { return; }
 
 	uint32_t mType;
 	RsPeerId mPeerId;
@@ -72,6 +73,7 @@ class ftRequest
 	uint64_t mOffset;
 	uint32_t mChunk;
 	void *mData;
+	uint64_t mQueuedUs;	// when the request was queued, to measure queue wait
 };
 
 typedef std::map<RsPeerId,rstime_t> ChunkCheckSumSourceList ;
@@ -182,6 +184,8 @@ class ftDataMultiplex: public ftDataRecv, public RsQueueThread
 
 		std::map<RsFileHash,Sha1CacheEntry> _cached_sha1maps ;						// one cache entry per file hash. Handled dynamically.
 
+		ftChunkVerifier mChunkVerifier ;		// checks received chunks in separate threads
+
 		ftDataSend *mDataSend;
 		ftSearch   *mSearch;
 		RsPeerId mOwnId;
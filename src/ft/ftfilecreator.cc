@@ -23,6 +23,7 @@
 #include <cerrno>
 #include <cstdio>
 #include <sys/stat.h>
+#include <memory>
 
 #include "ftfilecreator.h"
 #include "util/rstime.h"
@@ -49,8 +50,11 @@
 ***********************************************************/
 
 ftFileCreator::ftFileCreator(const std::string& path, uint64_t size, const RsFileHash& hash,bool assume_availability)
-	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability)
+	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability),
+	  mFileHashMtx("ftFileCreator file hash"), mHashedChunks(0), mFileHashNeedsReset(false)
 {
+	SHA1_Init(&mFileHashCtx) ;
+
 	/* 
          * FIXME any inits to do?
          */
@@ -405,7 +409,15 @@ int ftFileCreator::locked_notifyReceived(uint64_t offset, uint32_t chunk_size)
 #endif
 		bool found = false ;
 
-		for(std::map<uint64_t,ftChunk>::iterator it2=mChunks.begin();it2!=mChunks.end();++it2)
+		// Pending slices never overlap, and mChunks is sorted by offset, so the only candidate
+		// is the last slice starting strictly before the received data.
+
+		std::map<uint64_t,ftChunk>::iterator it2 = mChunks.lower_bound(offset) ;
+
+		if(it2 != mChunks.begin())
+		{
+			--it2 ;
+
 			if( it2->second.offset < offset && it2->second.size+it2->second.offset >= chunk_size+offset) // found it if it started strictly after the beginning of the chunk and ends before its end.
 			{
 				it = it2 ;
@@ -440,8 +452,8 @@ int ftFileCreator::locked_notifyReceived(uint64_t offset, uint32_t chunk_size)
 #endif
 
 				found = true ;
-				break ;
 			}
+		}
 
 		if(!found)
 		{
@@ -700,15 +712,95 @@ bool ftFileCreator::hashReceivedData(RsFileHash& hash)
 		return false ;
 	}
 
+	// Hash the chunks that were not hashed yet (e.g. chunks that were not checked, or
+	// were checked out of order), then finish the running hash.
+
+	uint32_t nb_chunks = ChunkMap::getNumberOfChunks(mSize) ;
+
+	updateFileHash(nb_chunks,NULL,0) ;
+
+	{
+		RsStackMutex stack(mFileHashMtx); /********** STACK LOCKED MTX ******/
+		bool needs_reset ;
+
+		{
+			RsStackMutex stack2(ftcMutex); /********** STACK LOCKED MTX ******/
+			needs_reset = mFileHashNeedsReset ;
+		}
+
+		if(mHashedChunks == nb_chunks && !needs_reset)
+		{
+			SHA_CTX ctx(mFileHashCtx) ;
+			unsigned char sha_buf[SHA_DIGEST_LENGTH];
+
+			SHA1_Final(&sha_buf[0], &ctx);
+			hash = Sha1CheckSum(sha_buf) ;
+
+			return true ;
+		}
+	}
+
+	std::cerr << "ftFileCreator::hashReceivedData(): incremental hash could not be completed. Hashing the whole file." << std::endl;
+
 	uint64_t tmpsize ;
 	return RsDirUtil::getFileHash(file_name,hash,tmpsize) ;
 }
 
+void ftFileCreator::updateFileHash(uint32_t chunk_number,const unsigned char *data,uint32_t len)
+{
+	RsStackMutex stack(mFileHashMtx); /********** STACK LOCKED MTX ******/
+
+	{
+		RsStackMutex stack2(ftcMutex); /********** STACK LOCKED MTX ******/
+
+		if(mFileHashNeedsReset)
+		{
+			SHA1_Init(&mFileHashCtx) ;
+			mHashedChunks = 0 ;
+			mFileHashNeedsReset = false ;
+		}
+	}
+
+	if(data != NULL && chunk_number == mHashedChunks)
+	{
+		SHA1_Update(&mFileHashCtx, data, len);
+		++mHashedChunks ;
+	}
+
+	// Now catch up with chunks that were verified before the previous ones.
+
+	uint32_t nb_chunks = ChunkMap::getNumberOfChunks(mSize) ;
+
+	if(mHashedChunks >= nb_chunks)
+		return ;
+
+	std::unique_ptr<unsigned char[]> buff(new unsigned char[ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE]) ;
+
+	while(mHashedChunks < nb_chunks)
+	{
+		uint32_t size ;
+		{
+			RsStackMutex stack2(ftcMutex); /********** STACK LOCKED MTX ******/
+
+			if(mFileHashNeedsReset || !chunkMap.isChunkAvailable(mHashedChunks*(uint64_t)ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,1))
+				return ;
+
+			if(!locked_readChunk(mHashedChunks,buff.get(),size))
+				return ;
+		}
+		SHA1_Update(&mFileHashCtx, buff.get(), size);
+		++mHashedChunks ;
+	}
+}
+
 void ftFileCreator::forceCheck()
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	chunkMap.forceCheck(); 
+
+	// chunks that fail the check will be downloaded again, so the hashed data is not reliable anymore.
+	mFileHashNeedsReset = true ;
 }
 
 void ftFileCreator::getSourcesList(uint32_t chunk_num,std::vector<RsPeerId>& sources)
@@ -725,39 +817,64 @@ void ftFileCreator::getChunksToCheck(std::vector<uint32_t>& chunks_to_ask)
 	chunkMap.getChunksToCheck(chunks_to_ask) ;
 }
 
-bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
+bool ftFileCreator::locked_readChunk(uint32_t chunk_number,unsigned char *buff,uint32_t& len)
 {
-	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
-
 	if(!locked_initializeFileAttrs() )
 		return false ;
 
 	static const uint32_t chunk_size = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
-	unsigned char *buff = new unsigned char[chunk_size] ;
-	uint32_t len ;
 
-	if(fseeko64(fd,(uint64_t)chunk_number * (uint64_t)chunk_size,SEEK_SET)==0 && (len = fread(buff,1,chunk_size,fd)) > 0)
+	if(fseeko64(fd,(uint64_t)chunk_number * (uint64_t)chunk_size,SEEK_SET)!=0)
+		return false ;
+
+	len = fread(buff,1,chunk_size,fd) ;
+
+	return len > 0 ;
+}
+
+bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
+{
+	std::unique_ptr<unsigned char[]> buff(new unsigned char[ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE]) ;
+	uint32_t len = 0 ;
+	bool read_ok ;
+
+	// Only keep the file locked while reading. Hashing is done without the lock, so that
+	// incoming data for this file can still be written in the mean time.
 	{
-		Sha1CheckSum comp = RsDirUtil::sha1sum(buff,len) ;
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+		if(!locked_initializeFileAttrs() )
+			return false ;
+
+		read_ok = locked_readChunk(chunk_number,buff.get(),len) ;
+	}
+
+	bool check_succeeded = false ;
+
+	if(read_ok)
+	{
+		Sha1CheckSum comp = RsDirUtil::sha1sum(buff.get(),len) ;
 
 		if(sum == comp)
-			chunkMap.setChunkCheckingResult(chunk_number,true) ;
+			check_succeeded = true ;
 		else
 		{
 			std::cerr << "Sum mismatch for chunk " << chunk_number << std::endl;
 			std::cerr << "    Computed  hash = " << comp.toStdString() << std::endl;
 			std::cerr << "    Reference hash = " << sum.toStdString() << std::endl;
-
-			chunkMap.setChunkCheckingResult(chunk_number,false) ;
 		}
 	}
 	else
-	{
 		printf("Chunk verification: cannot fseek!\n") ;
-		chunkMap.setChunkCheckingResult(chunk_number,false) ;
+
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+		chunkMap.setChunkCheckingResult(chunk_number,check_succeeded) ;
 	}
 
-	delete[] buff ;
+	if(check_succeeded)
+		updateFileHash(chunk_number,buff.get(),len) ;
+
 	return true ;
 }
 
@@ -32,6 +32,7 @@
 #include "ftfileprovider.h"
 #include "ftchunkmap.h"
 #include <map>
+#include <openssl/sha.h>
 
 class ZeroInitCounter
 {
@@ -65,6 +66,8 @@ class ftFileCreator: public ftFileProvider
 		// This function is not mutexed. This is a bit dangerous, but otherwise we might stuck the GUI for a 
 		// long time. Therefore, we must pay attention not to call this function
 		// at a time file_name nor hash can be modified, which is quite easy.
+		// The file hash is computed incrementally as verified chunks arrive in order, so that only the
+		// chunks that have not been hashed yet are read again here.
 
 		bool hashReceivedData(RsFileHash& hash) ;
 
@@ -72,6 +75,9 @@ class ftFileCreator: public ftFileProvider
 		//
 		void forceCheck() ; 
 
+		// Checks a downloaded chunk against its sha1 sum and updates the chunk map accordingly.
+		// The file is only locked while reading, so this can be called from the chunk verifier threads.
+		//
 		bool verifyChunk(uint32_t, const Sha1CheckSum&) ;
 
 		// Looks into the chunkmap for downloaded chunks that have not yet been certified.
@@ -135,6 +141,12 @@ class ftFileCreator: public ftFileProvider
 
 		bool 	locked_printChunkMap();
 		int 	locked_notifyReceived(uint64_t offset, uint32_t chunk_size);
+		bool	locked_readChunk(uint32_t chunk_number,unsigned char *buff,uint32_t& len);
+
+		// Feeds the whole file hash with all verified chunks that follow the already hashed ones. data is
+		// the content of chunk chunk_number if the caller has it at hand, or NULL.
+		//
+		void	updateFileHash(uint32_t chunk_number,const unsigned char *data,uint32_t len);
 		/* 
 		 * structure to track missing chunks 
 		 */
@@ -146,6 +158,11 @@ class ftFileCreator: public ftFileProvider
 
 		rstime_t _last_recv_time_t ;	/// last time stamp when data was received. Used for queue control.
 		rstime_t _creation_time ;		/// time at which the file creator was created. Used to spot long-inactive transfers.
+
+		RsMutex mFileHashMtx ;			/// protects mFileHashCtx and mHashedChunks. Always locked before ftcMutex.
+		SHA_CTX mFileHashCtx ;			/// running sha1 of the first mHashedChunks chunks of the file
+		uint32_t mHashedChunks ;
+		bool mFileHashNeedsReset ;		/// set under ftcMutex when hashed chunks may have changed on disk
 };
 
 #endif // FT_FILE_CREATOR_HEADER
@@ -704,6 +704,7 @@ void ftServer::removeVirtualPeer(const TurtleFileHash& hash,const TurtleVirtualP
 
 	RS_STACK_MUTEX(srvMutex) ;
 	mEncryptedPeerIds.erase(virtual_peer_id) ;
+	mEncryptionContexts.erase(virtual_peer_id) ;
 }
 
 bool ftServer::handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_id)
@@ -1005,8 +1006,14 @@ void ftServer::setFollowSymLinks(bool b)           { mFileDatabase->setFollowSym
 void ftServer::setIgnoreDuplicates(bool ignore)    { mFileDatabase->setIgnoreDuplicates(ignore); }
 void ftServer::setMaxShareDepth(int depth)         { mFileDatabase->setMaxShareDepth(depth) ; }
 
+void ftServer::setWatchNotificationsEnabled(bool b) { mFileDatabase->setWatchNotificationsEnabled(b) ; }
+bool ftServer::watchNotificationsEnabled()          { return mFileDatabase->watchNotificationsEnabled() ; }
+bool ftServer::getSharedDirectoriesWatchInfo(RsSharedDirectoriesWatchInfo& info) { return mFileDatabase->getSharedDirectoriesWatchInfo(info) ; }
+
 void ftServer::togglePauseHashingProcess()  { mFileDatabase->togglePauseHashingProcess() ; }
 bool ftServer::hashingProcessPaused() { return mFileDatabase->hashingProcessPaused() ; }
+void ftServer::setHashingThreadsCount(uint32_t threads) { mFileDatabase->setHashingThreadsCount(threads) ; }
+uint32_t ftServer::hashingThreadsCount() { return mFileDatabase->hashingThreadsCount() ; }
 
 bool ftServer::getShareDownloadDirectory()
 {
@@ -1056,37 +1063,43 @@ bool ftServer::shareDownloadDirectory(bool share)
 /***************************************************************/
 
 bool ftServer::sendTurtleItem(const RsPeerId& peerId,const RsFileHash& hash,RsTurtleGenericTunnelItem *item)
+{
+	return sendTurtleItems(peerId,hash,std::vector<RsTurtleGenericTunnelItem*>(1,item)) ;
+}
+
+bool ftServer::sendTurtleItems(const RsPeerId& peerId,const RsFileHash& hash,const std::vector<RsTurtleGenericTunnelItem*>& items)
 {
 	// we cannot look in the encrypted hash map, since the same hash--on this side of the FT--can be used with both
 	// encrypted and unencrypted peers ids. So the information comes from the virtual peer Id.
 
-	RsFileHash encrypted_hash;
-
-	if(findEncryptedHash(peerId,encrypted_hash))
+	if(isEncryptedSource(peerId))
 	{
-		// we encrypt the item
+		// we encrypt the items
 
 #ifdef SERVER_DEBUG
-		FTSERVER_DEBUG() << "Sending turtle item to peer ID " << peerId << " using encrypted tunnel." << std::endl;
+		FTSERVER_DEBUG() << "Sending " << items.size() << " turtle items to peer ID " << peerId << " using encrypted tunnel." << std::endl;
 #endif
 
-		RsTurtleGenericDataItem *encrypted_item ;
+		std::vector<RsTurtleGenericDataItem*> encrypted_items ;
 
-		if(!encryptItem(item, hash, encrypted_item))
-			return false ;
+		bool ok = encryptItems(peerId,hash,items,encrypted_items) ;
 
-                encrypted_item->setPriorityLevel(item->priority_level());
+		for(uint32_t i=0;i<items.size();++i)
+			delete items[i] ;
 
-		delete item ;
+		if(!ok)
+			return false ;
 
-		mTurtleRouter->sendTurtleData(peerId,encrypted_item) ;
+		for(uint32_t i=0;i<encrypted_items.size();++i)
+			mTurtleRouter->sendTurtleData(peerId,encrypted_items[i]) ;
 	}
 	else
 	{
 #ifdef SERVER_DEBUG
 		FTSERVER_DEBUG() << "Sending turtle item to peer ID " << peerId << " using non uncrypted tunnel." << std::endl;
 #endif
-		mTurtleRouter->sendTurtleData(peerId,item) ;
+		for(uint32_t i=0;i<items.size();++i)
+			mTurtleRouter->sendTurtleData(peerId,items[i]) ;
 	}
 
 	return true ;
@@ -1267,6 +1280,10 @@ bool	ftServer::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t
 	FTSERVER_DEBUG() << "ftServer::sendData() to " << peerId << ", hash: " << hash << " offset: " << baseoffset << " chunk: " << chunksize << " data: " << data << std::endl;
 #endif
 
+	// turtle data items are sent together, so that they get encrypted in a single batch
+
+	std::vector<RsTurtleGenericTunnelItem*> turtle_items ;
+
 	while(tosend > 0)
 	{
 		//static const uint32_t	MAX_FT_CHUNK  = 32 * 1024; /* 32K */
@@ -1294,11 +1311,15 @@ bool	ftServer::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t
 			if(item->chunk_data == NULL)
 			{
 				delete item;
+
+				for(uint32_t i=0;i<turtle_items.size();++i)
+					delete turtle_items[i] ;
+
 				return false;
 			}
 			memcpy(item->chunk_data,&(((uint8_t *) data)[offset]),chunk) ;
 
-			sendTurtleItem(peerId,hash,item) ;
+			turtle_items.push_back(item) ;
 		}
 		else
 		{
@@ -1332,6 +1353,9 @@ bool	ftServer::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t
 		tosend -= chunk;
 	}
 
+	if(!turtle_items.empty())
+		sendTurtleItems(peerId,hash,turtle_items) ;
+
 	/* clean up data */
 	free(data);
 
@@ -1578,6 +1602,109 @@ bool ftServer::decryptItem(const RsTurtleGenericDataItem *encrypted_item,const R
 #endif
 }
 
+bool ftServer::reserveEncryptionContext(const RsPeerId& virtual_peer_id,const RsFileHash& hash,uint32_t nb_chunks,librs::crypto::EncryptionContext& ctx)
+{
+	RS_STACK_MUTEX(srvMutex);
+
+	std::map<RsPeerId,librs::crypto::EncryptionContext>::iterator it = mEncryptionContexts.find(virtual_peer_id) ;
+
+	if(it == mEncryptionContexts.end())
+	{
+		// only create contexts for tunnels that are known, so that removeVirtualPeer() cleans them up.
+
+		if(mEncryptedPeerIds.find(virtual_peer_id) == mEncryptedPeerIds.end())
+			return false ;
+
+		uint8_t encryption_key[32] ;
+		deriveEncryptionKey(hash,encryption_key) ;
+
+		it = mEncryptionContexts.insert(std::make_pair(virtual_peer_id,librs::crypto::EncryptionContext(encryption_key))).first ;
+	}
+
+	ctx = it->second.reserve(nb_chunks) ;
+	return true ;
+}
+
+bool ftServer::encryptItems(const RsPeerId& virtual_peer_id,const RsFileHash& hash,const std::vector<RsTurtleGenericTunnelItem*>& clear_items,std::vector<RsTurtleGenericDataItem*>& encrypted_items)
+{
+	encrypted_items.clear() ;
+
+	if(clear_items.empty())
+		return true ;
+
+	librs::crypto::EncryptionContext ctx ;
+
+	if(!reserveEncryptionContext(virtual_peer_id,hash,clear_items.size(),ctx))
+	{
+		FTSERVER_ERROR() << "(EE) Cannot find encryption context for virtual peer " << virtual_peer_id << std::endl;
+		return false ;
+	}
+
+	std::vector<uint8_t*> buffers(clear_items.size()) ;
+	std::vector<uint32_t> clear_sizes(clear_items.size()) ;
+
+	encrypted_items.reserve(clear_items.size()) ;
+	bool ok = true ;
+
+	for(uint32_t i=0;ok && i<clear_items.size();++i)
+	{
+		uint32_t item_serialized_size = size(clear_items[i]) ;
+
+		RsTurtleGenericDataItem *encrypted_item = new RsTurtleGenericDataItem ;
+		encrypted_items.push_back(encrypted_item) ;
+
+		encrypted_item->data_size  = librs::crypto::EncryptionContext::encryptedSize(item_serialized_size) ;
+		encrypted_item->data_bytes = rs_malloc(encrypted_item->data_size) ;
+		encrypted_item->setPriorityLevel(clear_items[i]->priority_level()) ;
+
+		buffers[i] = (uint8_t*)encrypted_item->data_bytes ;
+		clear_sizes[i] = item_serialized_size ;
+
+		ok = buffers[i] != NULL && serialise(clear_items[i],buffers[i] + librs::crypto::EncryptionContext::CLEAR_DATA_OFFSET,&clear_sizes[i]) ;
+	}
+
+	if(!ok || ctx.encryptBatch(buffers.data(),clear_sizes.data(),clear_items.size()) != clear_items.size())
+	{
+		for(uint32_t i=0;i<encrypted_items.size();++i)
+			delete encrypted_items[i] ;
+
+		encrypted_items.clear() ;
+		return false ;
+	}
+
+	return true ;
+}
+
+bool ftServer::decryptItem(const RsTurtleGenericDataItem *encrypted_item, const RsPeerId& virtual_peer_id, const RsFileHash& hash, RsTurtleGenericTunnelItem *& decrypted_item)
+{
+	librs::crypto::EncryptionContext ctx ;
+
+	if(!reserveEncryptionContext(virtual_peer_id,hash,0,ctx))
+	{
+		uint8_t encryption_key[32] ;
+		deriveEncryptionKey(hash,encryption_key) ;
+
+		ctx = librs::crypto::EncryptionContext(encryption_key) ;
+	}
+
+	// Decrypt a copy: the item belongs to the turtle router and must stay untouched.
+	const uint8_t *encrypted_data = static_cast<const uint8_t*>(encrypted_item->data_bytes) ;
+	std::vector<uint8_t> data(encrypted_data,encrypted_data + encrypted_item->data_size) ;
+
+	uint32_t clear_data_offset = 0 ;
+	uint32_t clear_data_size = 0 ;
+
+	if(data.empty() || !ctx.decryptInPlace(data.data(),data.size(),clear_data_offset,clear_data_size))
+	{
+		FTSERVER_ERROR() << "Cannot decrypt data!" << std::endl;
+		return false ;
+	}
+
+	decrypted_item = dynamic_cast<RsTurtleGenericTunnelItem*>(deserialise(data.data() + clear_data_offset,&clear_data_size)) ;
+
+	return (decrypted_item != NULL);
+}
+
 bool ftServer::encryptHash(const RsFileHash& hash, RsFileHash& hash_of_hash)
 {
 	hash_of_hash = RsDirUtil::sha1sum(hash.toByteArray(),hash.SIZE_IN_BYTES);
@@ -1660,7 +1787,7 @@ void ftServer::receiveTurtleData(const RsTurtleGenericTunnelItem *i,
 		}
 
 		RsTurtleGenericTunnelItem *decrypted_item ;
-		if(!decryptItem(dynamic_cast<const RsTurtleGenericDataItem *>(i),real_hash,decrypted_item))
+		if(!decryptItem(dynamic_cast<const RsTurtleGenericDataItem *>(i),virtual_peer_id,real_hash,decrypted_item))
 		{
 			FTSERVER_ERROR() << "(EE) decryption error." << std::endl;
 			return ;
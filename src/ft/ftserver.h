@@ -38,6 +38,7 @@
 
 #include <map>
 #include <list>
+#include <vector>
 #include <iostream>
 #include <functional>
 #include <chrono>
@@ -50,6 +51,7 @@
 #include "serialiser/rsserial.h"
 #include "pqi/pqi.h"
 #include "pqi/p3cfgmgr.h"
+#include "crypto/rscrypto.h"
 
 class p3ConnectMgr;
 class p3FileDatabase;
@@ -330,10 +332,15 @@ public:
     virtual int watchPeriod() const ;
     virtual void setWatchEnabled(bool b) ;
     virtual bool watchEnabled() ;
+    virtual void setWatchNotificationsEnabled(bool enable) ;
+    virtual bool watchNotificationsEnabled() ;
+    virtual bool getSharedDirectoriesWatchInfo(RsSharedDirectoriesWatchInfo& info) ;
 	virtual bool followSymLinks() const;
 	virtual void setFollowSymLinks(bool b);
 	virtual void togglePauseHashingProcess();
 	virtual bool hashingProcessPaused();
+	virtual void setHashingThreadsCount(uint32_t threads);
+	virtual uint32_t hashingThreadsCount();
 
 	virtual void setMaxShareDepth(int depth) ;
 	virtual int  maxShareDepth() const;
@@ -361,6 +368,26 @@ public:
     bool encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHash& hash,RsTurtleGenericDataItem *& encrypted_item);
     bool decryptItem(const RsTurtleGenericDataItem *encrypted_item, const RsFileHash& hash, RsTurtleGenericTunnelItem *&decrypted_item);
 
+    /*!
+     * \brief encryptItems
+     * 			Encrypts a batch of items for the given end-to-end encrypted tunnel, using the tunnel's encryption context: the IVs come
+     *          from a counter and each item is serialised directly into its encrypted buffer. Clear items are not deleted.
+     * \param virtual_peer_id		virtual peer id of the tunnel
+     * \param hash					real hash of the file, from which the encryption key is derived
+     * \param clear_items			items to encrypt
+     * \param encrypted_items		resulting items, in the same order.
+     * \return
+     * 			true if all items could be encrypted. Otherwise encrypted_items is left empty.
+     */
+    bool encryptItems(const RsPeerId& virtual_peer_id,const RsFileHash& hash,const std::vector<RsTurtleGenericTunnelItem*>& clear_items,std::vector<RsTurtleGenericDataItem*>& encrypted_items);
+
+    /*!
+     * \brief decryptItem
+     * 			Same as above, using the key cached in the tunnel's encryption context. The item is left untouched: its data
+     *          is decrypted into a private copy.
+     */
+    bool decryptItem(const RsTurtleGenericDataItem *encrypted_item, const RsPeerId& virtual_peer_id, const RsFileHash& hash, RsTurtleGenericTunnelItem *&decrypted_item);
+
     /*************** Internal Transfer Fns *************************/
     virtual int tick();
 
@@ -385,6 +412,17 @@ protected:
      */
     bool sendTurtleItem(const RsPeerId& peerId,const RsFileHash& hash,RsTurtleGenericTunnelItem *item);
 
+    /*!
+     * \brief sendTurtleItems
+     * 			Same as sendTurtleItem() for a batch of items, which are encrypted in one go when the tunnel requires it. Items are
+     *          taken over in all cases.
+     */
+    bool sendTurtleItems(const RsPeerId& peerId,const RsFileHash& hash,const std::vector<RsTurtleGenericTunnelItem*>& items);
+
+    // Copies into ctx the encryption context of the given encrypted tunnel after reserving nb_chunks IVs in it. The context is
+    // created on first use. Returns false if the virtual peer is not an end-to-end encrypted tunnel.
+    bool reserveEncryptionContext(const RsPeerId& virtual_peer_id,const RsFileHash& hash,uint32_t nb_chunks,librs::crypto::EncryptionContext& ctx);
+
     // fnds out what is the real hash of encrypted hash hash
     bool findRealHash(const RsFileHash& hash, RsFileHash& real_hash);
     bool findEncryptedHash(const RsPeerId& virtual_peer_id, RsFileHash& encrypted_hash);
@@ -417,6 +455,7 @@ private:
 
     std::map<RsFileHash,RsFileHash> mEncryptedHashes ; // This map is such that sha1(it->second) = it->first
     std::map<RsPeerId,RsFileHash> mEncryptedPeerIds ;  // This map holds the hash to be used with each peer id
+    std::map<RsPeerId,librs::crypto::EncryptionContext> mEncryptionContexts ;  // encryption state of each encrypted tunnel, by virtual peer id
     std::map<RsPeerId,std::map<RsFileHash,rstime_t> > mUploadLimitMap ;
 
 	/** Store search callbacks with timeout*/
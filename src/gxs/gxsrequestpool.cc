@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: gxsrequestpool.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "gxs/gxsrequestpool.h"
+
+static const uint32_t MAX_REQUEST_POOL_THREADS    =   4 ;	//! services are processed in parallel, requests of one service are not
+static const uint32_t REQUEST_POOL_IDLE_WAIT_TIME = 500 ;	//! 0.5 sec. Only bounds how long stopping a worker takes
+
+GxsRequestPool::GxsRequestPool() : mStopping(false) {}
+
+GxsRequestPool::~GxsRequestPool()
+{
+	std::vector<GxsRequestPoolWorker*> workers ;
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+		mStopping = true ;
+		mScheduled.clear() ;
+		workers.swap(mWorkers) ;
+	}
+	mPoolCv.notify_all() ;
+
+	for(uint32_t i=0;i<workers.size();++i)
+	{
+		workers[i]->fullstop();
+		delete workers[i];
+	}
+}
+
+GxsRequestPool& GxsRequestPool::instance()
+{
+	static GxsRequestPool pool ;
+	return pool ;
+}
+
+void GxsRequestPool::locked_startWorkers()
+{
+	uint32_t n = std::max(1u,std::min((uint32_t)std::thread::hardware_concurrency(),MAX_REQUEST_POOL_THREADS)) ;
+
+	while(mWorkers.size() < n)
+	{
+		mWorkers.push_back(new GxsRequestPoolWorker(this)) ;
+		mWorkers.back()->start("gxs requests") ;
+	}
+}
+
+void GxsRequestPool::schedule(GxsRequestProcessor *processor)
+{
+	GxsRequestPool& pool(instance()) ;
+	{
+		std::lock_guard<std::mutex> lock(pool.mPoolMtx) ;
+
+		if(pool.mStopping)
+			return ;
+
+		// Already waiting to be run: the next run will also process the new request.
+
+		if(std::find(pool.mScheduled.begin(),pool.mScheduled.end(),processor) != pool.mScheduled.end())
+			return ;
+
+		pool.mScheduled.push_back(processor) ;
+		pool.locked_startWorkers() ;
+	}
+	pool.mPoolCv.notify_all() ;
+}
+
+void GxsRequestPool::unregister(GxsRequestProcessor *processor)
+{
+	GxsRequestPool& pool(instance()) ;
+	std::unique_lock<std::mutex> lock(pool.mPoolMtx) ;
+
+	pool.mScheduled.remove(processor) ;
+	pool.mPoolCv.wait(lock,[&pool,processor]() { return pool.mRunning.find(processor) == pool.mRunning.end() ; }) ;
+}
+
+GxsRequestProcessor *GxsRequestPool::locked_popRunnable()
+{
+	// Skip processors that are being run by another worker. They will be picked up when it is done.
+
+	for(auto it(mScheduled.begin());it!=mScheduled.end();++it)
+		if(mRunning.find(*it) == mRunning.end())
+		{
+			GxsRequestProcessor *p = *it ;
+			mScheduled.erase(it) ;
+			return p ;
+		}
+
+	return nullptr ;
+}
+
+void GxsRequestPoolWorker::threadTick()
+{
+	mPool->workerTick() ;
+}
+
+void GxsRequestPool::workerTick()
+{
+	GxsRequestProcessor *processor = nullptr ;
+	{
+		std::unique_lock<std::mutex> lock(mPoolMtx) ;
+
+		mPoolCv.wait_for(lock,std::chrono::milliseconds(REQUEST_POOL_IDLE_WAIT_TIME),[this,&processor]()
+		{
+			return mStopping || (processor = locked_popRunnable()) != nullptr ;
+		}) ;
+
+		if(processor == nullptr)
+			return ;
+
+		mRunning.insert(processor) ;
+	}
+
+	processor->processPendingRequests() ;
+
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+		mRunning.erase(processor) ;
+	}
+	mPoolCv.notify_all() ;
+}
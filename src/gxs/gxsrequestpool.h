@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: gxsrequestpool.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "util/rsthreads.h"
+
+class GxsRequestPool ;
+
+/*!
+ * \brief The GxsRequestProcessor class
+ * 		Anything that has pending GXS token requests to process, typically a GXS service.
+ */
+class GxsRequestProcessor
+{
+public:
+	virtual ~GxsRequestProcessor() {}
+
+	/// Processes all pending requests. Never called by two pool workers at the same time.
+	virtual void processPendingRequests() = 0;
+};
+
+/*!
+ * \brief The GxsRequestPoolWorker class
+ * 		One thread of the GXS request pool.
+ */
+class GxsRequestPoolWorker: public RsTickingThread
+{
+public:
+	explicit GxsRequestPoolWorker(GxsRequestPool *pool) : mPool(pool) {}
+
+	void threadTick() override; /// @see RsTickingThread
+
+private:
+	GxsRequestPool *mPool ;
+};
+
+/*!
+ * \brief The GxsRequestPool class
+ * 		Small pool of threads shared by all GXS services, that processes token requests as soon
+ * 		as they are made, instead of waiting for the next tick of the service.
+ */
+class GxsRequestPool
+{
+public:
+	/// Asks the pool to call processor->processPendingRequests() as soon as possible.
+	static void schedule(GxsRequestProcessor *processor) ;
+
+	/// Removes the processor from the pool, waiting for it to finish if it is being run.
+	static void unregister(GxsRequestProcessor *processor) ;
+
+	~GxsRequestPool() ;
+
+private:
+	GxsRequestPool() ;
+	static GxsRequestPool& instance() ;
+
+	void locked_startWorkers() ;
+	GxsRequestProcessor *locked_popRunnable() ;
+
+	void workerTick() ;
+	friend class GxsRequestPoolWorker ;
+
+	std::mutex mPoolMtx ;
+	std::condition_variable mPoolCv ;	// signaled when a processor is scheduled or done running
+
+	std::list<GxsRequestProcessor*> mScheduled ;
+	std::set<GxsRequestProcessor*> mRunning ;
+	std::vector<GxsRequestPoolWorker*> mWorkers ;
+	bool mStopping ;
+};
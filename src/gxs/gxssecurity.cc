@@ -24,8 +24,12 @@
 #include "pqi/authgpg.h"
 #include "util/rsdir.h"
 #include "util/rsmemory.h"
+#include "util/rsthreads.h"
 //#include "retroshare/rspeers.h"
 
+#include <list>
+#include <map>
+
 /****
  * #define GXS_SECURITY_DEBUG 	1
  ***/
@@ -34,6 +38,61 @@ static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_HEADER              = 0xFACE;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_HEADER_SIZE         = 2 ;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_NUMBER_OF_KEYS_SIZE = 2 ;
 static const uint32_t MULTI_ENCRYPTION_FORMAT_v001_ENCRYPTED_KEY_SIZE  = 256 ;
+
+static const uint32_t GXS_VERIFIED_SIGNATURE_CACHE_SIZE                 = 16384 ;	// ~3MB
+
+/*!
+ * Remembers the (key, signed data) pairs which signature already passed, so that messages
+ * received again (re-synced, or waiting for their author's key) are not verified again.
+ * Entries are identified by the sha1 of the key data and of the signed data.
+ */
+class GxsVerifiedSignatureCache
+{
+public:
+	explicit GxsVerifiedSignatureCache(uint32_t max_size) : mMtx("GxsVerifiedSignatureCache"), mMaxSize(max_size) {}
+
+	bool find(const Sha1CheckSum& key_hash,const Sha1CheckSum& data_hash)
+	{
+		RS_STACK_MUTEX(mMtx) ;
+
+		std::map<Entry, std::list<Entry>::iterator>::iterator it = mEntries.find(Entry(key_hash,data_hash)) ;
+
+		if(it == mEntries.end())
+			return false ;
+
+		mLru.splice(mLru.begin(), mLru, it->second) ;
+		return true ;
+	}
+
+	void insert(const Sha1CheckSum& key_hash,const Sha1CheckSum& data_hash)
+	{
+		RS_STACK_MUTEX(mMtx) ;
+
+		Entry e(key_hash,data_hash) ;
+
+		if(mEntries.find(e) != mEntries.end())
+			return ;
+
+		mLru.push_front(e) ;
+		mEntries[e] = mLru.begin() ;
+
+		if(mEntries.size() > mMaxSize)
+		{
+			mEntries.erase(mLru.back()) ;
+			mLru.pop_back() ;
+		}
+	}
+
+private:
+	typedef std::pair<Sha1CheckSum,Sha1CheckSum> Entry ;
+
+	RsMutex mMtx ;
+	uint32_t mMaxSize ;
+	std::list<Entry> mLru ;	// most recently used first
+	std::map<Entry, std::list<Entry>::iterator> mEntries ;
+};
+
+static GxsVerifiedSignatureCache verifiedSignatureCache(GXS_VERIFIED_SIGNATURE_CACHE_SIZE) ;
         
 static RsGxsId getRsaKeyFingerprint_old_insecure_method(RSA *pubkey)
 {
@@ -438,34 +497,9 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
                 // no return here. We still proceed checking the signature.
 			}
 
-            /* decode key */
-            const unsigned char *keyptr = (const unsigned char *) key.keyData.bin_data;
-            long keylen = key.keyData.bin_len;
             unsigned int siglen = sign.signData.bin_len;
             unsigned char *sigbuf = (unsigned char *) sign.signData.bin_data;
 
-    #ifdef DISTRIB_DEBUG
-            std::cerr << "GxsSecurity::validateNxsMsg() Decode Key";
-            std::cerr << " keylen: " << keylen << " siglen: " << siglen;
-            std::cerr << std::endl;
-    #endif
-
-            /* extract admin key */
-
-            RSA *rsakey = (key.keyFlags & RSTLV_KEY_TYPE_FULL)?  (d2i_RSAPrivateKey(NULL, &(keyptr), keylen)) : (d2i_RSAPublicKey(NULL, &(keyptr), keylen));
-
-            if (!rsakey)
-            {
-    #ifdef GXS_SECURITY_DEBUG
-                    std::cerr << "GxsSecurity::validateNxsMsg()";
-                    std::cerr << " Invalid RSA Key";
-                    std::cerr << std::endl;
-
-                    key.print(std::cerr, 10);
-    #endif
-            }
-
-
             RsTlvKeySignatureSet signSet = msgMeta.signSet;
             msgMeta.signSet.TlvClear();
 
@@ -479,10 +513,6 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 	    int signOk = 0 ;
 
 	{
-		EVP_PKEY *signKey = EVP_PKEY_new();
-		EVP_PKEY_assign_RSA(signKey, rsakey);
-		EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
-
 		uint32_t metaDataLen = msgMeta.serial_size();
 		uint32_t allMsgDataLen = metaDataLen + msg.msg.bin_len;
 
@@ -498,16 +528,46 @@ bool GxsSecurity::validateNxsMsg(const RsNxsMsg& msg, const RsTlvKeySignature& s
 		memcpy(allMsgData, msg.msg.bin_data, msg.msg.bin_len);
 		memcpy(allMsgData+(msg.msg.bin_len), metaData, metaDataLen);
 
-		/* calc and check signature */
+		/* calc and check signature. The sha1 of the signed data is what RSA signs, so it is computed
+		 * once, and used both to look into the cache and to check the signature. */
 
-		EVP_VerifyInit(mdctx, EVP_sha1());
-		EVP_VerifyUpdate(mdctx, allMsgData, allMsgDataLen);
+		Sha1CheckSum data_hash = RsDirUtil::sha1sum(allMsgData, allMsgDataLen) ;
+		Sha1CheckSum key_hash = RsDirUtil::sha1sum((const uint8_t*)key.keyData.bin_data, key.keyData.bin_len) ;
 
-		signOk = EVP_VerifyFinal(mdctx, sigbuf, siglen, signKey);
+		if(verifiedSignatureCache.find(key_hash, data_hash))
+			signOk = 1 ;
+		else
+		{
+			/* decode key */
+			const unsigned char *keyptr = (const unsigned char *) key.keyData.bin_data;
+			long keylen = key.keyData.bin_len;
 
-		/* clean up */
-		EVP_PKEY_free(signKey);
-		EVP_MD_CTX_destroy(mdctx);
+#ifdef DISTRIB_DEBUG
+			std::cerr << "GxsSecurity::validateNxsMsg() Decode Key";
+			std::cerr << " keylen: " << keylen << " siglen: " << siglen;
+			std::cerr << std::endl;
+#endif
+			RSA *rsakey = (key.keyFlags & RSTLV_KEY_TYPE_FULL)?  (d2i_RSAPrivateKey(NULL, &(keyptr), keylen)) : (d2i_RSAPublicKey(NULL, &(keyptr), keylen));
+
+			if (rsakey)
+			{
+				signOk = RSA_verify(NID_sha1, data_hash.toByteArray(), data_hash.SIZE_IN_BYTES, sigbuf, siglen, rsakey);
+				RSA_free(rsakey);
+
+				if(signOk == 1)
+					verifiedSignatureCache.insert(key_hash, data_hash) ;
+			}
+#ifdef GXS_SECURITY_DEBUG
+			else
+			{
+				std::cerr << "GxsSecurity::validateNxsMsg()";
+				std::cerr << " Invalid RSA Key";
+				std::cerr << std::endl;
+
+				key.print(std::cerr, 10);
+			}
+#endif
+		}
 	}
 
             msgMeta.mOrigMsgId = origMsgId;
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: gxsvalidationpool.cc                                 *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <thread>
+
+#include "gxs/gxsvalidationpool.h"
+
+static const uint32_t MAX_VALIDATION_POOL_THREADS     =     4 ;	//! RSA checks are short, a few threads are enough
+static const uint32_t VALIDATION_POOL_IDLE_WAIT_TIME  =   500 ;	//! 0.5 sec. Only bounds how long stopping a worker takes
+
+GxsValidationPool::GxsValidationPool() : mStopping(false) {}
+
+GxsValidationPool::~GxsValidationPool()
+{
+	std::vector<GxsValidationPoolWorker*> workers ;
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+		mStopping = true ;
+		workers.swap(mWorkers) ;
+	}
+	mPoolCv.notify_all() ;
+
+	for(uint32_t i=0;i<workers.size();++i)
+	{
+		workers[i]->fullstop();
+		delete workers[i];
+	}
+}
+
+GxsValidationPool& GxsValidationPool::instance()
+{
+	static GxsValidationPool pool ;
+	return pool ;
+}
+
+void GxsValidationPool::run(const std::vector<std::function<void()> >& jobs)
+{
+	if(jobs.size() < 2)
+	{
+		for(uint32_t i=0;i<jobs.size();++i)
+			jobs[i]() ;
+		return ;
+	}
+	instance().runBatch(jobs) ;
+}
+
+void GxsValidationPool::locked_startWorkers()
+{
+	uint32_t n = std::min((uint32_t)std::thread::hardware_concurrency(),MAX_VALIDATION_POOL_THREADS) ;
+
+	// The calling thread also works, hence the -1.
+
+	while(mWorkers.size() + 1 < n)
+	{
+		mWorkers.push_back(new GxsValidationPoolWorker(this)) ;
+		mWorkers.back()->start("gxs validation") ;
+	}
+}
+
+void GxsValidationPool::runBatch(const std::vector<std::function<void()> >& jobs)
+{
+	Batch batch ;	// only accessed under mPoolMtx
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+
+		for(uint32_t i=0;i<jobs.size();++i)
+		{
+			Job job ;
+			job.batch = &batch ;
+			job.fn = &jobs[i] ;
+
+			mJobs.push_back(job) ;
+		}
+		batch.remaining = jobs.size() ;
+
+		locked_startWorkers() ;
+	}
+	mPoolCv.notify_all() ;
+
+	// Help until the queue is empty (possibly running jobs of other services), then wait for the
+	// jobs of this batch that are still running in the workers.
+
+	while(runOneJob()) ;
+
+	std::unique_lock<std::mutex> lock(mPoolMtx) ;
+	mPoolCv.wait(lock,[&batch]() { return batch.remaining == 0 ; }) ;
+}
+
+bool GxsValidationPool::runOneJob()
+{
+	Job job ;
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+
+		if(mJobs.empty())
+			return false ;
+
+		job = mJobs.front() ;
+		mJobs.pop_front() ;
+	}
+
+	(*job.fn)() ;
+
+	{
+		std::lock_guard<std::mutex> lock(mPoolMtx) ;
+		--job.batch->remaining ;
+	}
+	mPoolCv.notify_all() ;
+
+	return true ;
+}
+
+void GxsValidationPoolWorker::threadTick()
+{
+	mPool->workerTick() ;
+}
+
+void GxsValidationPool::workerTick()
+{
+	if(runOneJob())
+		return ;
+
+	std::unique_lock<std::mutex> lock(mPoolMtx) ;
+	mPoolCv.wait_for(lock,std::chrono::milliseconds(VALIDATION_POOL_IDLE_WAIT_TIME),[this]() { return mStopping || !mJobs.empty() ; }) ;
+}
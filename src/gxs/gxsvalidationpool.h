@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: gxsvalidationpool.h                                  *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "util/rsthreads.h"
+
+class GxsValidationPool ;
+
+/*!
+ * \brief The GxsValidationPoolWorker class
+ * 		One thread of the GXS validation pool.
+ */
+class GxsValidationPoolWorker: public RsTickingThread
+{
+public:
+	explicit GxsValidationPoolWorker(GxsValidationPool *pool) : mPool(pool) {}
+
+	void threadTick() override; /// @see RsTickingThread
+
+private:
+	GxsValidationPool *mPool ;
+};
+
+/*!
+ * \brief The GxsValidationPool class
+ * 		Small pool of threads shared by all GXS services, used to check the signatures of received
+ * 		data in parallel, while the service mutex is not held.
+ */
+class GxsValidationPool
+{
+public:
+	/// Runs all jobs, using the pool and the calling thread, and returns once they are all done.
+	/// Jobs must be independent from each other, and must not lock the caller's mutexes.
+	static void run(const std::vector<std::function<void()> >& jobs) ;
+
+	~GxsValidationPool() ;
+
+private:
+	struct Batch
+	{
+		Batch() : remaining(0) {}
+		uint32_t remaining ;
+	};
+	struct Job
+	{
+		Batch *batch ;
+		const std::function<void()> *fn ;
+	};
+
+	GxsValidationPool() ;
+	static GxsValidationPool& instance() ;
+
+	void runBatch(const std::vector<std::function<void()> >& jobs) ;
+	bool runOneJob() ;	// returns false if there was nothing to do
+	void locked_startWorkers() ;
+
+	void workerTick() ;
+	friend class GxsValidationPoolWorker ;
+
+	std::mutex mPoolMtx ;
+	std::condition_variable mPoolCv ;	// signaled when jobs are queued or done running
+
+	bool mStopping ;
+	std::list<Job> mJobs ;
+	std::vector<GxsValidationPoolWorker*> mWorkers ;
+};
@@ -45,6 +45,11 @@
 #define GRP_LAST_POST_UPDATE_TRIGGER std::string("LAST_POST_UPDATE")
 
 #define MSG_INDEX_GRPID std::string("INDEX_MESSAGES_GRPID")
+#define MSG_INDEX_GRPID_TIME_STAMP std::string("INDEX_MESSAGES_GRPID_TIMESTAMP")
+#define MSG_INDEX_GRPID_THREAD_ID  std::string("INDEX_MESSAGES_GRPID_THREADID")
+#define MSG_INDEX_GRPID_PARENT_ID  std::string("INDEX_MESSAGES_GRPID_PARENTID")
+#define MSG_INDEX_GRPID_ORIG_MSG_ID std::string("INDEX_MESSAGES_GRPID_ORIGMSGID")
+#define MSG_INDEX_GRPID_STATUS     std::string("INDEX_MESSAGES_GRPID_STATUS")
 
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
@@ -111,6 +116,118 @@ const std::string RsGeneralDataService::MSG_META_STATUS = KEY_MSG_STATUS;
 
 const uint32_t RsGeneralDataService::GXS_MAX_ITEM_SIZE = 1572864; // 1.5 Mbytes
 
+bool RsGxsMsgMetaQuery::matches(const RsGxsMsgMetaData& meta) const
+{
+    if(!mMsgId.isNull() && meta.mMsgId != mMsgId) return false;
+    if(!mThreadId.isNull() && meta.mThreadId != mThreadId) return false;
+    if(!mParentId.isNull() && meta.mParentId != mParentId) return false;
+    if(!mOrigMsgId.isNull() && meta.mOrigMsgId != mOrigMsgId) return false;
+
+    if(mThreadHeadsOnly && !meta.mParentId.isNull()) return false;
+    if(mOrigMsgsOnly && !meta.mOrigMsgId.isNull() && meta.mOrigMsgId != meta.mMsgId) return false;
+
+    if(mStatusMask && (meta.mMsgStatus & mStatusMask) != (mStatusFilter & mStatusMask)) return false;
+    if(mMsgFlagMask && (meta.mMsgFlags & mMsgFlagMask) != (mMsgFlagFilter & mMsgFlagMask)) return false;
+
+    if(mAfter && meta.mPublishTs <= mAfter) return false;
+    if(mBefore && meta.mPublishTs >= mBefore) return false;
+
+    return true;
+}
+
+void RsGxsMsgMetaQuery::apply(std::vector<std::shared_ptr<RsGxsMsgMetaData> >& metas) const
+{
+    // A msg has been edited when another msg refers to it as its original version.
+    std::set<RsGxsMessageId> editedMsgs;
+
+    if(mLatestMsgsOnly)
+        for(const auto& m: metas)
+            if(!m->mOrigMsgId.isNull() && m->mOrigMsgId != m->mMsgId)
+                editedMsgs.insert(m->mOrigMsgId);
+
+    // collapse results while keeping the order
+
+    uint32_t j = 0;
+
+    for(uint32_t i=0;i<metas.size();++i)
+        if(matches(*metas[i]) && editedMsgs.find(metas[i]->mMsgId) == editedMsgs.end())
+            metas[j++] = metas[i];
+
+    metas.resize(j);
+
+    if(!isPaged())
+        return;
+
+    // same order as the db query, so that pages do not depend on the cache state
+    std::sort(metas.begin(), metas.end(),
+              [](const std::shared_ptr<RsGxsMsgMetaData>& a, const std::shared_ptr<RsGxsMsgMetaData>& b)
+              { return a->mPublishTs > b->mPublishTs || (a->mPublishTs == b->mPublishTs && a->mMsgId < b->mMsgId); });
+
+    if(mOffset >= metas.size())
+        metas.clear();
+    else
+        metas.erase(metas.begin(), metas.begin() + mOffset);
+
+    if(mLimit > 0 && metas.size() > mLimit)
+        metas.resize(mLimit);
+}
+
+// Null ids are stored as a string of zeros, but be lenient with older rows.
+static std::string nullIdSql(const std::string& column)
+{
+    return "(" + column + " IS NULL OR " + column + "='' OR " + column + "='" + RsGxsMessageId().toStdString() + "')";
+}
+
+/*!
+ * Translates a msg meta query into a WHERE clause on the message table, and
+ * the matching ORDER BY clause (which carries LIMIT/OFFSET when paged).
+ */
+static std::string msgMetaQueryToSql(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::string& orderBy)
+{
+    std::string where = KEY_GRP_ID + "='" + grpId.toStdString() + "'";
+
+    if(!query.mMsgId.isNull())
+        where += " AND " + KEY_MSG_ID + "='" + query.mMsgId.toStdString() + "'";
+    if(!query.mThreadId.isNull())
+        where += " AND " + KEY_MSG_THREAD_ID + "='" + query.mThreadId.toStdString() + "'";
+    if(!query.mParentId.isNull())
+        where += " AND " + KEY_MSG_PARENT_ID + "='" + query.mParentId.toStdString() + "'";
+    if(!query.mOrigMsgId.isNull())
+        where += " AND " + KEY_ORIG_MSG_ID + "='" + query.mOrigMsgId.toStdString() + "'";
+
+    if(query.mThreadHeadsOnly)
+        where += " AND " + nullIdSql(KEY_MSG_PARENT_ID);
+    if(query.mOrigMsgsOnly)
+        where += " AND (" + nullIdSql(KEY_ORIG_MSG_ID) + " OR " + KEY_ORIG_MSG_ID + "=" + KEY_MSG_ID + ")";
+
+    if(query.mLatestMsgsOnly)
+        where += " AND NOT EXISTS (SELECT 1 FROM " + MSG_TABLE_NAME + " AS edits WHERE"
+                 " edits." + KEY_GRP_ID + "=" + MSG_TABLE_NAME + "." + KEY_GRP_ID +
+                 " AND edits." + KEY_ORIG_MSG_ID + "=" + MSG_TABLE_NAME + "." + KEY_MSG_ID +
+                 " AND edits." + KEY_MSG_ID + "<>" + MSG_TABLE_NAME + "." + KEY_MSG_ID + ")";
+
+    if(query.mStatusMask)
+        where += " AND (" + KEY_MSG_STATUS + " & " + std::to_string(query.mStatusMask) + ")="
+                 + std::to_string(query.mStatusFilter & query.mStatusMask);
+    if(query.mMsgFlagMask)
+        where += " AND (" + KEY_NXS_FLAGS + " & " + std::to_string(query.mMsgFlagMask) + ")="
+                 + std::to_string(query.mMsgFlagFilter & query.mMsgFlagMask);
+
+    if(query.mAfter)
+        where += " AND " + KEY_TIME_STAMP + ">" + std::to_string(query.mAfter);
+    if(query.mBefore)
+        where += " AND " + KEY_TIME_STAMP + "<" + std::to_string(query.mBefore);
+
+    orderBy.clear();
+
+    if(query.isPaged())
+        orderBy = KEY_TIME_STAMP + " DESC," + KEY_MSG_ID
+                + " LIMIT " + (query.mLimit > 0 ? std::to_string(query.mLimit) : std::string("-1"))
+                + " OFFSET " + std::to_string(query.mOffset);
+
+    return where;
+}
+
 static int addColumn(std::list<std::string> &list, const std::string &attribute)
 {
     list.push_back(attribute);
@@ -126,6 +243,12 @@ RsDataService::RsDataService(const std::string &serviceDir, const std::string &d
     mDb = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE_CREATE, key);
     mUseCache = true;
 
+    mMsgMetaCacheBudget = DEFAULT_MSG_META_CACHE_SIZE;
+    mMetaCacheClock = 0;
+    mMetaCacheHits = 0;
+    mMetaCacheMisses = 0;
+    mMetaCachePageOuts = 0;
+
     initialise(isNewDatabase);
 
     // for retrieving msg meta
@@ -291,7 +414,7 @@ static bool moveDataFromFileToDatabase(RetroDb *db, const std::string serviceDir
 
 void RsDataService::initialise(bool isNewDatabase)
 {
-    const int databaseRelease = 1;
+    const int databaseRelease = 2;
     int currentDatabaseRelease = 0;
     bool ok = true;
 
@@ -366,6 +489,7 @@ void RsDataService::initialise(bool isNewDatabase)
                 + std::string("END;"));
 
         mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+        createMsgIndexes();
 
         // Insert release, no need to upgrade
         ContentValue cv;
@@ -441,6 +565,20 @@ void RsDataService::initialise(bool isNewDatabase)
                 currentDatabaseRelease = newRelease;
             }
         }
+
+        // Release 2
+        newRelease = 2;
+        if (ok && currentDatabaseRelease < newRelease) {
+            ok = startReleaseUpdate(newRelease);
+
+            // Indexes for the msg meta queries (threads, replies, paging by date)
+            ok = ok && createMsgIndexes();
+
+            ok = finishReleaseUpdate(newRelease, ok);
+            if (ok) {
+                currentDatabaseRelease = newRelease;
+            }
+        }
     }
 
     if (ok) {
@@ -450,6 +588,19 @@ void RsDataService::initialise(bool isNewDatabase)
     }
 }
 
+bool RsDataService::createMsgIndexes()
+{
+    bool ok = true;
+
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_TIME_STAMP + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_TIME_STAMP + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_THREAD_ID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_THREAD_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_PARENT_ID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_PARENT_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_ORIG_MSG_ID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_ORIG_MSG_ID + ");");
+    ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_STATUS + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_MSG_STATUS + ");");
+
+    return ok;
+}
+
 bool RsDataService::startReleaseUpdate(int release)
 {
     // Update database
@@ -507,14 +658,11 @@ std::shared_ptr<RsGxsGrpMetaData> RsDataService::locked_getGrpMeta(RetroCursor&
     if(grpId.isNull())			// not in the DB!
         return nullptr;
 
-    if(mUseCache)
-        grpMeta = mGrpMetaDataCache.getOrCreateMeta(grpId);
-	else
-        grpMeta = std::make_shared<RsGxsGrpMetaData>();
-
-    if(!grpMeta->mGroupId.isNull())	// the grpMeta is already initialized because it comes from the cache
+    if(mUseCache && (grpMeta = mGrpMetaDataCache.getMeta(grpId)))	// already initialized because it comes from the cache
         return grpMeta;
 
+    grpMeta = std::make_shared<RsGxsGrpMetaData>();
+
     grpMeta->mGroupId = RsGxsGroupId(tempId);
     c.getString(mColGrpMeta_NxsIdentity + colOffset, tempId);
     grpMeta->mAuthorId = RsGxsId(tempId);
@@ -596,7 +744,13 @@ std::shared_ptr<RsGxsGrpMetaData> RsDataService::locked_getGrpMeta(RetroCursor&
 	}
 
     if(ok)
+    {
+        // only now that it is filled, so that its size can be accounted for
+        if(mUseCache)
+            mGrpMetaDataCache.updateMeta(grpId,grpMeta);
+
         return grpMeta;
+    }
     else
 		return NULL;
 }
@@ -666,14 +820,11 @@ std::shared_ptr<RsGxsMsgMetaData> RsDataService::locked_getMsgMeta(RetroCursor &
 
     std::shared_ptr<RsGxsMsgMetaData> msgMeta;
 
-    if(mUseCache)
-        msgMeta = mMsgMetaDataCache[group_id].getOrCreateMeta(msg_id);
-	else
-        msgMeta = std::make_shared<RsGxsMsgMetaData>();
-
-    if(!msgMeta->mGroupId.isNull())	// we cannot do that because the cursor needs to advance. Is there a method to skip some data in the db?
+    if(mUseCache && (msgMeta = locked_msgMetaCache(group_id).getMeta(msg_id)))	// we cannot do that because the cursor needs to advance. Is there a method to skip some data in the db?
         return msgMeta;
 
+    msgMeta = std::make_shared<RsGxsMsgMetaData>();
+
 	msgMeta->mGroupId = group_id;
 	msgMeta->mMsgId = msg_id;
 
@@ -708,7 +859,13 @@ std::shared_ptr<RsGxsMsgMetaData> RsDataService::locked_getMsgMeta(RetroCursor &
     msgMeta->mChildTs = c.getInt32(mColMsgMeta_ChildTs + colOffset);
 
     if(ok)
+    {
+        // only now that it is filled, so that its size can be accounted for
+        if(mUseCache)
+            locked_msgMetaCache(group_id).updateMeta(msg_id,msgMeta);
+
         return msgMeta;
+    }
 
     return nullptr;
 }
@@ -759,8 +916,10 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
 
     RsStackMutex stack(mDbMutex);
 
-    // start a transaction
-    mDb->beginTransaction();
+    // rows are written in one go below, so that they share a single cached
+    // INSERT statement
+    std::list<ContentValue> rows;
+    std::vector<std::pair<RsGxsGroupId, RsGxsMessageId> > rowIds;
 
     for(std::list<RsNxsMsg*>::const_iterator mit = msg.begin(); mit != msg.end(); ++mit)
     {
@@ -784,7 +943,9 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
             continue;
         }
 
-        ContentValue cv;
+        rows.push_back(ContentValue());
+        ContentValue& cv = rows.back();
+        rowIds.push_back(std::make_pair(msgMetaPtr->mGroupId, msgMetaPtr->mMsgId));
 
         uint32_t dataLen = msgPtr->msg.TlvSize();
         char msgData[dataLen];
@@ -824,27 +985,36 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         cv.put(KEY_MSG_STATUS, (int32_t)msgMetaPtr->mMsgStatus);
         cv.put(KEY_CHILD_TS, (int32_t)msgMetaPtr->mChildTs);
 
-        if (!mDb->sqlInsert(MSG_TABLE_NAME, "", cv))
-        {
-            std::cerr << "RsDataService::storeMessage() sqlInsert Failed";
-            std::cerr << std::endl;
-            std::cerr << "\t For GroupId: " << msgMetaPtr->mGroupId.toStdString();
-            std::cerr << std::endl;
-            std::cerr << "\t & MessageId: " << msgMetaPtr->mMsgId.toStdString();
-            std::cerr << std::endl;
-        }
-
         // This is needed so that mLastPost is correctly updated in the group meta when it is re-loaded.
 
         if(mUseCache)
-                mMsgMetaDataCache[msgMetaPtr->mGroupId].updateMeta(msgMetaPtr->mMsgId,*msgMetaPtr);
+                locked_msgMetaCache(msgMetaPtr->mGroupId).updateMeta(msgMetaPtr->mMsgId,*msgMetaPtr);
 
         delete *mit;
     }
 
+    // start a transaction
+    mDb->beginTransaction();
+
+    std::vector<uint32_t> failed;
+    mDb->sqlInsertBatch(MSG_TABLE_NAME, rows, &failed);
+
+    for(std::vector<uint32_t>::const_iterator fit = failed.begin(); fit != failed.end(); ++fit)
+    {
+        std::cerr << "RsDataService::storeMessage() sqlInsert Failed";
+        std::cerr << std::endl;
+        std::cerr << "\t For GroupId: " << rowIds[*fit].first.toStdString();
+        std::cerr << std::endl;
+        std::cerr << "\t & MessageId: " << rowIds[*fit].second.toStdString();
+        std::cerr << std::endl;
+    }
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
+    if(mUseCache)
+        locked_enforceMsgMetaCacheBudget();
+
     return ret;
 }
 
@@ -861,8 +1031,10 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 
     RsStackMutex stack(mDbMutex);
 
-    // begin transaction
-    mDb->beginTransaction();
+    // rows are written in one go below, so that they share a single cached
+    // INSERT statement
+    std::list<ContentValue> rows;
+    std::vector<RsGxsGroupId> rowIds;
 
     for(std::list<RsNxsGrp*>::const_iterator sit = grp.begin();sit != grp.end(); ++sit)
 	{
@@ -887,7 +1059,9 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 		 * id signature, admin signatue, key set, last posting ts
 		 * and meta data
 		 **/
-		ContentValue cv;
+		rows.push_back(ContentValue());
+		ContentValue& cv = rows.back();
+		rowIds.push_back(grpMetaPtr->mGroupId);
 
 		uint32_t dataLen = grpPtr->grp.TlvSize();
 		char grpData[dataLen];
@@ -933,16 +1107,23 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 
 		mGrpMetaDataCache.updateMeta(grpMetaPtr->mGroupId,*grpMetaPtr);
 
-		if (!mDb->sqlInsert(GRP_TABLE_NAME, "", cv))
-		{
-			std::cerr << "RsDataService::storeGroup() sqlInsert Failed";
-			std::cerr << std::endl;
-			std::cerr << "\t For GroupId: " << grpMetaPtr->mGroupId.toStdString();
-			std::cerr << std::endl;
-		}
-
         delete *sit;
 	}
+
+    // begin transaction
+    mDb->beginTransaction();
+
+    std::vector<uint32_t> failed;
+    mDb->sqlInsertBatch(GRP_TABLE_NAME, rows, &failed);
+
+    for(std::vector<uint32_t>::const_iterator fit = failed.begin(); fit != failed.end(); ++fit)
+    {
+        std::cerr << "RsDataService::storeGroup() sqlInsert Failed";
+        std::cerr << std::endl;
+        std::cerr << "\t For GroupId: " << rowIds[*fit].toStdString();
+        std::cerr << std::endl;
+    }
+
     // finish transaction
     bool ret = mDb->commitTransaction();
 
@@ -1270,12 +1451,15 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         // if vector empty then request all messages
 
         // The pointer here is a trick to not initialize a new cache entry when cache is disabled, while keeping the unique variable all along.
-        t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> *cache(mUseCache? (&mMsgMetaDataCache[grpId]) : nullptr);
+        t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> *cache(mUseCache? (&locked_msgMetaCache(grpId)) : nullptr);
 
         if(msgIdV.empty())
         {
             if(mUseCache && cache->isCacheUpToDate())
+            {
                 cache->getFullMetaList(msgMeta[grpId]);
+                mMetaCacheHits += cache->size();
+            }
             else
 			{
 				RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
@@ -1283,6 +1467,7 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
 				if (c)
 				{
                     locked_retrieveMsgMetaList(c, msgMeta[grpId]);
+                    mMetaCacheMisses += msgMeta[grpId].size();
 
                     if(mUseCache)
                             cache->setCacheUpToDate(true);
@@ -1298,6 +1483,16 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
             // request each msg meta
 			auto& metaSet(msgMeta[grpId]);
 
+            // On the first miss, page in the whole group rather than reading
+            // metas one by one: requests on a group tend to come in bursts.
+            if(mUseCache && !cache->isCacheUpToDate())
+                for(auto sit(msgIdV.begin()); sit!=msgIdV.end(); ++sit)
+                    if(!cache->getMeta(*sit))
+                    {
+                        locked_pageInMsgMetas(grpId, *cache);
+                        break;
+                    }
+
             for(auto sit(msgIdV.begin()); sit!=msgIdV.end(); ++sit)
 			{
 				const RsGxsMessageId& msgId = *sit;
@@ -1305,22 +1500,24 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
                 auto meta = mUseCache?cache->getMeta(msgId): (std::shared_ptr<RsGxsMsgMetaData>());
 
                 if(meta)
+                {
                     metaSet.push_back(meta);
+                    ++mMetaCacheHits;
+                }
+                else if(mUseCache && cache->isCacheUpToDate())
+                    continue;	// the whole group is in the cache, so msg is not in the db
                 else
 				{
+                    ++mMetaCacheMisses;
+
 					RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
 
                     c->moveToFirst();
                     auto meta = locked_getMsgMeta(*c, 0);
 
                     if(meta)
-                    {
                         metaSet.push_back(meta);
 
-                        if(mUseCache)
-                            mMsgMetaDataCache[grpId].updateMeta(msgId,meta);
-                    }
-
                     delete c;
 				}
 			}
@@ -1330,6 +1527,9 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         }
     }
 
+    if(mUseCache)
+        locked_enforceMsgMetaCacheBudget();
+
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     if(mDbName==std::string("gxsforums_db"))
     std::cerr << "RsDataService::retrieveGxsMsgMetaData() " << mDbName << ", Requests: " << reqIds.size() << ", Results: " << resultCount << ", Time: " << timer.duration() << std::endl;
@@ -1338,6 +1538,52 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
     return 1;
 }
 
+int RsDataService::retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta)
+{
+    RsStackMutex stack(mDbMutex);
+
+    // When the whole group is already in memory, filtering it is cheaper than a db query.
+    if(mUseCache)
+    {
+        auto& cache(locked_msgMetaCache(grpId));
+
+        if(cache.isCacheUpToDate())
+        {
+            std::vector<std::shared_ptr<RsGxsMsgMetaData> > metas;
+            cache.getFullMetaList(metas);
+            query.apply(metas);
+
+            mMetaCacheHits += metas.size();
+            msgMeta.insert(msgMeta.end(), metas.begin(), metas.end());
+
+            return 1;
+        }
+    }
+
+    std::string orderBy;
+    std::string where = msgMetaQueryToSql(grpId, query, orderBy);
+
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, where, orderBy);
+
+    if(c)
+    {
+        size_t previousSize = msgMeta.size();
+        locked_retrieveMsgMetaList(c, msgMeta);
+        mMetaCacheMisses += msgMeta.size() - previousSize;
+    }
+    delete c;
+
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+    std::cerr << mDbName << ": Retrieving queried Msg metadata grpId=" << grpId << " where " << where << ", " << std::dec << msgMeta.size() << " messages" << std::endl;
+#endif
+
+    // The group is only partly read, so its cache entry stays incomplete.
+    if(mUseCache)
+        locked_enforceMsgMetaCacheBudget();
+
+    return 1;
+}
+
 void RsDataService::locked_retrieveGrpMetaList(RetroCursor *c, std::map<RsGxsGroupId,std::shared_ptr<RsGxsGrpMetaData> >& grpMeta)
 {
 	if(!c)
@@ -1403,6 +1649,7 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
 #endif
 
 			mGrpMetaDataCache.getFullMetaList(grp) ;
+            mMetaCacheHits += grp.size();
         }
         else
 		{
@@ -1416,6 +1663,7 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
             if(c)
 			{
                 locked_retrieveGrpMetaList(c,grp);
+                mMetaCacheMisses += grp.size();
 
                 if(mUseCache)
                         mGrpMetaDataCache.setCacheUpToDate(true);
@@ -1434,12 +1682,16 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
             auto meta = mUseCache?mGrpMetaDataCache.getMeta(mit->first): (std::shared_ptr<RsGxsGrpMetaData>()) ;
 
 			if(meta)
+			{
 				mit->second = meta;
+				++mMetaCacheHits;
+			}
 			else
 			{
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
 				std::cerr << mDbName << ": Retrieving Grp metadata grpId=" << mit->first ;
 #endif
+				++mMetaCacheMisses;
 
 				const RsGxsGroupId& grpId = mit->first;
 				RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
@@ -1449,13 +1701,8 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId,std::shared_ptr<
                 auto meta = locked_getGrpMeta(*c, 0);
 
                 if(meta)
-                {
                     mit->second = meta;
 
-                    if(mUseCache)
-                        mGrpMetaDataCache.updateMeta(grpId,meta);
-                }
-
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
 				++resultCount;
 #endif
@@ -1493,11 +1740,19 @@ int RsDataService::resetDataStore()
     {
         RsStackMutex stack(mDbMutex);
 
-        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_TIME_STAMP);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_THREAD_ID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_PARENT_ID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_ORIG_MSG_ID);
+        mDb->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_STATUS);
         mDb->execSQL("DROP TABLE " + DATABASE_RELEASE_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + MSG_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + GRP_TABLE_NAME);
-        mDb->execSQL("DROP TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER);
+        mDb->execSQL("DROP TRIGGER IF EXISTS " + GRP_LAST_POST_UPDATE_TRIGGER);
+
+        mGrpMetaDataCache = t_MetaDataCache<RsGxsGroupId,RsGxsGrpMetaData>();
+        mMsgMetaDataCache.clear();
     }
 
     // recreate database
@@ -1519,7 +1774,10 @@ int RsDataService::updateGroupMetaData(const GrpLocMetaData& meta)
     std::cerr << (void*)this << ": erasing old entry from cache." << std::endl;
 #endif
 
-    if( mDb->sqlUpdate(GRP_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString() + "'", meta.val))
+    ContentValue where;
+    where.put(KEY_GRP_ID, grpId.toStdString());
+
+    if( mDb->sqlUpdate(GRP_TABLE_NAME, where, meta.val))
     {
         // If we use the cache, update the meta data immediately.
 
@@ -1555,7 +1813,11 @@ int RsDataService::updateMessageMetaData(const MsgLocMetaData& metaData)
     const RsGxsGroupId& grpId = metaData.msgId.first;
     const RsGxsMessageId& msgId = metaData.msgId.second;
 
-    if(mDb->sqlUpdate(MSG_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString() + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", metaData.val) )
+    ContentValue where;
+    where.put(KEY_GRP_ID, grpId.toStdString());
+    where.put(KEY_MSG_ID, msgId.toStdString());
+
+    if(mDb->sqlUpdate(MSG_TABLE_NAME, where, metaData.val) )
     {
         // If we use the cache, update the meta data immediately.
 
@@ -1571,7 +1833,7 @@ int RsDataService::updateMessageMetaData(const MsgLocMetaData& metaData)
             mUseCache=true;
 
             if(meta)
-                mMsgMetaDataCache[grpId].updateMeta(msgId,meta);
+                locked_msgMetaCache(grpId).updateMeta(msgId,meta);
 
             delete c;
         }
@@ -1703,13 +1965,14 @@ bool RsDataService::locked_removeMessageEntries(const GxsMsgReq& msgIds)
     {
         const RsGxsGroupId& grpId = mit->first;
         const std::set<RsGxsMessageId>& msgsV = mit->second;
-        auto& cache(mMsgMetaDataCache[grpId]);
+        auto cit = mMsgMetaDataCache.find(grpId);
 
         for(auto& msgId:msgsV)
         {
             mDb->sqlDelete(MSG_TABLE_NAME, KEY_GRP_ID+ "='" + grpId.toStdString() + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
 
-            cache.clear(msgId);
+            if(cit != mMsgMetaDataCache.end())
+                cit->second.clear(msgId);
         }
     }
 
@@ -1736,12 +1999,77 @@ bool RsDataService::locked_removeGroupEntries(const std::vector<RsGxsGroupId>& g
 }
 
 uint32_t RsDataService::cacheSize() const {
-    return 0;
+    return mMsgMetaCacheBudget;
 }
 
-int RsDataService::setCacheSize(uint32_t /* size */)
+int RsDataService::setCacheSize(uint32_t size)
 {
-    return 0;
+    RS_STACK_MUTEX(mDbMutex);
+
+    mMsgMetaCacheBudget = size;
+    locked_enforceMsgMetaCacheBudget();
+
+    return 1;
+}
+
+t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& RsDataService::locked_msgMetaCache(const RsGxsGroupId& grpId)
+{
+    auto& cache(mMsgMetaDataCache[grpId]);
+    cache.setLastAccess(++mMetaCacheClock);
+
+    return cache;
+}
+
+void RsDataService::locked_pageInMsgMetas(const RsGxsGroupId& grpId, t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& cache)
+{
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+
+    if(c)
+    {
+        // locked_getMsgMeta() stores each meta in the cache
+        std::vector<std::shared_ptr<RsGxsMsgMetaData> > metas;
+        locked_retrieveMsgMetaList(c, metas);
+
+        cache.setCacheUpToDate(true);
+    }
+    delete c;
+
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+    std::cerr << mDbName << ": paged in msg metadata of grpId=" << grpId << ", " << cache.size() << " messages, " << cache.memorySize() << " bytes" << std::endl;
+#endif
+}
+
+void RsDataService::locked_enforceMsgMetaCacheBudget()
+{
+    uint64_t total_size = 0;
+
+    for(auto& it:mMsgMetaDataCache)
+        total_size += it.second.memorySize();
+
+    if(total_size <= mMsgMetaCacheBudget || mMsgMetaDataCache.size() < 2)
+        return;
+
+    // oldest first, the last one being the most recently used is never paged out
+    std::vector<std::pair<uint64_t,RsGxsGroupId> > lru;
+
+    for(auto& it:mMsgMetaDataCache)
+        lru.push_back(std::make_pair(it.second.lastAccess(),it.first));
+
+    std::sort(lru.begin(),lru.end());
+
+    for(uint32_t i=0;i+1<lru.size() && total_size > mMsgMetaCacheBudget;++i)
+    {
+        auto it = mMsgMetaDataCache.find(lru[i].second);
+
+        // metas still held by clients stay valid thanks to the shared_ptr
+        total_size -= it->second.memorySize();
+        mMsgMetaDataCache.erase(it);
+
+        ++mMetaCachePageOuts;
+    }
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+    std::cerr << mDbName << ": msg metadata cache paged out down to " << total_size << " bytes in " << mMsgMetaDataCache.size() << " groups" << std::endl;
+#endif
 }
 
 void RsDataService::debug_printCacheSize()
@@ -1769,7 +2097,8 @@ void RsDataService::debug_printCacheSize()
         nb_items += tmp_nb_items;
         total_size += tmp_total_size;
     }
-    RsDbg() << "[CACHE]    Msgs:   " << " total: " << nb_items << ", size: " << total_size << std::endl;
+    RsDbg() << "[CACHE]    Msgs:   " << " total: " << nb_items << ", size: " << total_size << ", groups: " << mMsgMetaDataCache.size() << ", budget: " << mMsgMetaCacheBudget << std::endl;
+    RsDbg() << "[CACHE]    Hits: " << mMetaCacheHits << ", misses: " << mMetaCacheMisses << ", paged out groups: " << mMetaCachePageOuts << std::endl;
 }
 
 
@@ -35,58 +35,51 @@ public:
 	ContentValue cv;
 };
 
+/*!
+ * Metadata cache of a single table (groups) or of a single group's messages.
+ * Besides the metas it keeps an estimate of the memory they use, and the time
+ * of last use so that RsDataService can page out least recently used groups
+ * when over its memory budget.
+ */
 template<class ID, class MetaDataClass> class t_MetaDataCache
 {
 public:
     t_MetaDataCache()
-        : mCache_ContainsAllMetas(false)
+        : mCache_ContainsAllMetas(false), mMemorySize(0), mLastAccess(0)
     {}
     virtual ~t_MetaDataCache() = default;
 
     bool isCacheUpToDate() const { return mCache_ContainsAllMetas ; }
     void setCacheUpToDate(bool b) { mCache_ContainsAllMetas = b; }
 
-    void getFullMetaList(std::map<ID,std::shared_ptr<MetaDataClass> >& mp) const { mp = mMetas ; }
-    void getFullMetaList(std::vector<std::shared_ptr<MetaDataClass> >& mp) const { for(auto& m:mMetas) mp.push_back(m.second) ; }
+    void getFullMetaList(std::map<ID,std::shared_ptr<MetaDataClass> >& mp) const { for(auto& m:mMetas) mp[m.first] = m.second.meta ; }
+    void getFullMetaList(std::vector<std::shared_ptr<MetaDataClass> >& mp) const { for(auto& m:mMetas) mp.push_back(m.second.meta) ; }
 
     std::shared_ptr<MetaDataClass> getMeta(const ID& id)
     {
 		auto itt = mMetas.find(id);
 
 		if(itt != mMetas.end())
-			return itt->second ;
+			return itt->second.meta ;
         else
             return nullptr;
     }
 
-    std::shared_ptr<MetaDataClass> getOrCreateMeta(const ID& id)
-    {
-		auto it = mMetas.find(id) ;
-
-		if(it != mMetas.end())
-		{
-#ifdef RS_DATA_SERVICE_DEBUG
-			RsDbg() << __PRETTY_FUNCTION__ << ": getting group meta " << grpId << " from cache." << std::endl;
-#endif
-            return it->second ;
-		}
-		else
-		{
-#ifdef RS_DATA_SERVICE_DEBUG
-			RsDbg() << __PRETTY_FUNCTION__ << ": group meta " << grpId << " not in cache. Loading it from DB..." << std::endl;
-#endif
-            return (mMetas[id] = std::make_shared<MetaDataClass>());
-        }
-    }
-
     void updateMeta(const ID& id,const MetaDataClass& meta)
     {
-        mMetas[id] = std::make_shared<MetaDataClass>(meta);     // create a new shared_ptr to possibly replace the previous one
+        updateMeta(id,std::make_shared<MetaDataClass>(meta));     // create a new shared_ptr to possibly replace the previous one
     }
 
     void updateMeta(const ID& id,const std::shared_ptr<MetaDataClass>& meta)
 	{
-        mMetas[id] = meta;     // create a new shared_ptr to possibly replace the previous one
+        Entry& e(mMetas[id]);
+
+        mMemorySize -= e.size;
+
+        e.meta = meta;     // replaces the previous shared_ptr, which callers may still hold
+        e.size = sizeof(Entry) + sizeof(MetaDataClass) + meta->serial_size();	// rough estimate of heap usage
+
+        mMemorySize += e.size;
 	}
 
     void clear(const ID& id)
@@ -101,9 +94,10 @@ public:
 		if(it != mMetas.end())
 		{
 #ifdef RS_DATA_SERVICE_DEBUG
-			std::cerr << "(II) moving database cache entry " << (void*)(*it).second << " to dead list." << std::endl;
+			std::cerr << "(II) moving database cache entry " << (void*)(*it).second.meta.get() << " to dead list." << std::endl;
 #endif
 
+			mMemorySize -= it->second.size;
 			mMetas.erase(it) ;
 
             // No need to modify  mCache_ContainsAllMetas since, assuming that the cache always contains
@@ -112,19 +106,37 @@ public:
         }
 	}
 
+    /*!
+     * @return estimated memory used by the cached metas, in bytes
+     */
+    uint64_t memorySize() const { return mMemorySize; }
+
+    uint32_t size() const { return mMetas.size(); }
+
+    uint64_t lastAccess() const { return mLastAccess; }
+    void setLastAccess(uint64_t t) { mLastAccess = t; }
+
     void debug_computeSize(uint32_t& nb_items, uint64_t& total_size) const
     {
         nb_items = mMetas.size();
         total_size = 0;
 
-        for(auto it:mMetas) total_size += it.second->serial_size();
+        for(auto& it:mMetas) total_size += it.second.meta->serial_size();
     }
 private:
-    std::map<ID,std::shared_ptr<MetaDataClass> > mMetas;
+    struct Entry
+    {
+        Entry() : size(0) {}
 
-	static const uint32_t CACHE_ENTRY_GRACE_PERIOD = 600 ; // Unused items are deleted 10 minutes after last usage.
+        std::shared_ptr<MetaDataClass> meta;
+        uint32_t size;		// accounted memory, computed when the meta is stored
+    };
+
+    std::map<ID,Entry> mMetas;
 
     bool mCache_ContainsAllMetas ;
+    uint64_t mMemorySize ;
+    uint64_t mLastAccess ;	// RsDataService access counter value at last use
 };
 
 class RsDataService : public RsGeneralDataService
@@ -168,6 +180,17 @@ public:
      */
     int retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta) override;
 
+    /*!
+     * Retrieves meta data of the messages of a group that match a query.
+     * When the whole group is in the cache the query is evaluated there,
+     * otherwise it is translated into SQL so that the indexes are used.
+     * @param grpId group to look into
+     * @param query selection
+     * @param msgMeta matching metas are appended to it
+     * @return error code
+     */
+    int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta) override;
+
     /*!
      * remove msgs in data store
      * @param grpId group Id of message to be removed
@@ -269,6 +292,13 @@ public:
 
     void debug_printCacheSize() ;
 
+    /*!
+     * Default memory budget of the message metadata cache of each service.
+     * Groups whose metadata were least recently used are paged out when it is
+     * exceeded, and paged in again as a whole on next use.
+     */
+    static const uint32_t DEFAULT_MSG_META_CACHE_SIZE = 16*1024*1024;
+
 private:
 
     /*!
@@ -339,6 +369,13 @@ private:
     bool locked_removeGroupEntries(const std::vector<RsGxsGroupId>& grpIds);
 
 private:
+    /*!
+     * Creates the secondary indexes of the message table used by
+     * msg meta queries
+     * @return true/false
+     */
+    bool createMsgIndexes();
+
     /*!
      * Start release update
      * @param release
@@ -450,10 +487,35 @@ private:
     void locked_clearGrpMetaCache(const RsGxsGroupId& gid);
 	void locked_updateGrpMetaCache(const RsGxsGrpMetaData& meta);
 
+    /*!
+     * @return message metadata cache of the group, created if needed, and
+     *         marked as most recently used
+     */
+    t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& locked_msgMetaCache(const RsGxsGroupId& grpId);
+
+    /*!
+     * Loads the metadata of all messages of a group into its cache
+     */
+    void locked_pageInMsgMetas(const RsGxsGroupId& grpId, t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData>& cache);
+
+    /*!
+     * Pages out least recently used groups from the message metadata cache
+     * until it fits mMsgMetaCacheBudget. The most recently used group is
+     * always kept, so that a group larger than the budget is not re-read
+     * from the db at every access.
+     */
+    void locked_enforceMsgMetaCacheBudget();
+
     t_MetaDataCache<RsGxsGroupId,RsGxsGrpMetaData> mGrpMetaDataCache;
     std::map<RsGxsGroupId,t_MetaDataCache<RsGxsMessageId,RsGxsMsgMetaData> > mMsgMetaDataCache;
 
     bool mUseCache;
+
+    uint32_t mMsgMetaCacheBudget;	// bytes
+    uint64_t mMetaCacheClock;		// incremented at each group access, for LRU
+    uint64_t mMetaCacheHits;
+    uint64_t mMetaCacheMisses;
+    uint32_t mMetaCachePageOuts;
 };
 
 #endif // RSDATASERVICE_H
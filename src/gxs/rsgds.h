@@ -86,6 +86,55 @@ struct RsGroupNetworkStats
 	rstime_t   mLastGroupModificationTS;
 };
 
+/*!
+ * Selection of message metas within one group. It is handed to the data store
+ * so that the selection is evaluated where the data lives, and only matching
+ * metas get loaded. Default values select all messages of the group.
+ */
+struct RsGxsMsgMetaQuery
+{
+	RsGxsMsgMetaQuery() :
+	    mThreadHeadsOnly(false), mOrigMsgsOnly(false), mLatestMsgsOnly(false),
+	    mStatusMask(0), mStatusFilter(0), mMsgFlagMask(0), mMsgFlagFilter(0),
+	    mAfter(0), mBefore(0), mLimit(0), mOffset(0) {}
+
+	RsGxsMessageId mMsgId;     /// only this message, if not null
+	RsGxsMessageId mThreadId;  /// only messages of this thread, if not null
+	RsGxsMessageId mParentId;  /// only direct replies to this message, if not null
+	RsGxsMessageId mOrigMsgId; /// only versions of this message, if not null
+
+	bool mThreadHeadsOnly; /// only messages without parent
+	bool mOrigMsgsOnly;    /// only first versions of messages
+	bool mLatestMsgsOnly;  /// drops messages that have been edited by another one
+
+	/// (status & mStatusMask) == (mStatusFilter & mStatusMask), if mask not 0
+	uint32_t mStatusMask, mStatusFilter;
+	/// same for the message flags
+	uint32_t mMsgFlagMask, mMsgFlagFilter;
+
+	/// publish time stamp range, bounds excluded. 0 means no bound.
+	rstime_t mAfter;
+	rstime_t mBefore;
+
+	/// Paging: skips mOffset messages, then returns at most mLimit of them
+	/// (0 means no limit), most recently published first.
+	uint32_t mLimit;
+	uint32_t mOffset;
+
+	/// true when results need to be sorted and cut.
+	bool isPaged() const { return mLimit > 0 || mOffset > 0; }
+
+	/// checks the conditions that only depend on the meta itself
+	bool matches(const RsGxsMsgMetaData& meta) const;
+
+	/*!
+	 * Applies the whole query, paging included, to a list of metas. For
+	 * mLatestMsgsOnly to be correct the list must contain all the candidate
+	 * messages, as edits are only looked for among them.
+	 */
+	void apply(std::vector<std::shared_ptr<RsGxsMsgMetaData> >& metas) const;
+};
+
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > NxsMsgDataResult;
 typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsNxsMsg*> > NxsMsgRelatedDataResult;
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > GxsMsgResult; // <grpId, msgs>
@@ -175,6 +224,16 @@ public:
      */
     virtual int retrieveGxsMsgMetaData(const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta) = 0;
 
+    /*!
+     * Retrieves meta data of the messages of a group that match a query. The
+     * selection is done by the store, so unselected metas are not loaded.
+     * @param grpId group to look into
+     * @param query selection, @see RsGxsMsgMetaQuery
+     * @param msgMeta matching metas are appended to it
+     * @return error code
+     */
+    virtual int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMeta) = 0;
+
     /*!
      * remove msgs in data store listed in msgIds param
      * @param msgIds ids of messages to be removed
@@ -27,6 +27,7 @@
 #include "pqi/pqihash.h"
 #include "rsgenexchange.h"
 #include "gxssecurity.h"
+#include "gxsvalidationpool.h"
 #include "util/contentvalue.h"
 #include "util/rsprint.h"
 #include "util/rstime.h"
@@ -176,6 +177,7 @@ RsGenExchange::RsGenExchange(
         RsSerialType* serviceSerialiser, uint16_t servType, RsGixs* gixs,
         uint32_t authenPolicy ) :
     mGenMtx("GenExchange"),
+    mRequestProcessingMtx("GenExchange requests"),
     mDataStore(gds),
     mNetService(ns),
     mSerialiser(serviceSerialiser),
@@ -198,6 +200,7 @@ RsGenExchange::RsGenExchange(
   VALIDATE_MAX_WAITING_TIME(60)
 {
     mDataAccess = new RsGxsDataAccess(gds);
+    mDataAccess->setRequestProcessor(this);
 }
 
 void RsGenExchange::setNetworkExchangeService(RsNetworkExchangeService *ns)
@@ -211,6 +214,9 @@ void RsGenExchange::setNetworkExchangeService(RsNetworkExchangeService *ns)
 RsGenExchange::~RsGenExchange()
 {
     // need to destruct in a certain order (bad thing, TODO: put down instance ownership rules!)
+    // Stop the request pool from processing our requests first: they may use the network service.
+    GxsRequestPool::unregister(this);
+
     delete mNetService;
 
     delete mDataAccess;
@@ -242,8 +248,10 @@ void RsGenExchange::threadTick()
 	rstime::rs_usleep((int) (timeDelta * 1000 *1000)); // timeDelta sec
 }
 
-void RsGenExchange::tick()
+void RsGenExchange::processPendingRequests()
 {
+	RS_STACK_MUTEX(mRequestProcessingMtx);
+
 	// Meta Changes should happen first.
 	// This is important, as services want to change Meta, then get results.
 	// Services shouldn't rely on this ordering - but some do.
@@ -251,6 +259,11 @@ void RsGenExchange::tick()
 	processMsgMetaChanges();
 
 	mDataAccess->processRequests();
+}
+
+void RsGenExchange::tick()
+{
+	processPendingRequests();
 
 	publishGrps();
 
@@ -834,14 +847,13 @@ int RsGenExchange::createMessage(RsNxsMsg* msg)
 	}
 }
 
-int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uint32_t& /*signFlag*/, RsTlvSecurityKeySet& grpKeySet)
+void RsGenExchange::msgSignaturesNeeded(const RsNxsMsg* msg, uint32_t grpFlag, bool& needPublishSign, bool& needIdentitySign) const
 {
-    // 1 - determine which signatures are needed, by looking for the flags corresponding to the
-    //     type of message we have, in the authentication policy of the service
+    // Determine which signatures are needed, by looking for the flags corresponding to the
+    // type of message we have, in the authentication policy of the service
 
-    bool needIdentitySign = false;
-    bool needPublishSign = false;
-    bool publishValidate = true, idValidate = true;
+    needIdentitySign = false;
+    needPublishSign = false;
 
     // These are the types of flags we want to check in the authenticaiton policy
 
@@ -874,6 +886,65 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
     // Check required permissions, if they have signed it anyway - we need to validate it.
     if ((checkAuthenFlag(pos, author_flag)) || (!msg->metaData->mAuthorId.isNull()))
         needIdentitySign = true;
+}
+
+RsGxsId RsGenExchange::findPublishKeyId(const RsTlvSecurityKeySet& grpKeySet, bool& oldStyleKey)
+{
+    oldStyleKey = false;
+
+    for(std::map<RsGxsId, RsTlvPublicRSAKey>::const_iterator mit = grpKeySet.public_keys.begin(); mit != grpKeySet.public_keys.end() ; ++mit)
+    {
+        const RsTlvPublicRSAKey& key = mit->second;
+
+        if(key.keyFlags & RSTLV_KEY_DISTRIB_PUBLIC_deprecated)
+        {
+            oldStyleKey = true;
+            return key.keyId;
+        }
+        if(key.keyFlags & RSTLV_KEY_DISTRIB_PUBLISH) // we might have the private key, but we still should be able to check the signature
+            return key.keyId;
+    }
+    return RsGxsId();
+}
+
+void RsGenExchange::locked_collectMsgSignatures(const RsNxsMsg* msg, uint32_t grpFlag, const RsTlvSecurityKeySet& grpKeySet,
+                                                std::vector<std::pair<RsTlvKeySignature, RsTlvPublicRSAKey> >& signatures)
+{
+    bool needPublishSign, needIdentitySign;
+    msgSignaturesNeeded(msg, grpFlag, needPublishSign, needIdentitySign);
+
+    const RsGxsMsgMetaData& metaData = *(msg->metaData);
+    std::map<SignType, RsTlvKeySignature>::const_iterator sit;
+
+    if(needPublishSign && (sit = metaData.signSet.keySignSet.find(INDEX_AUTHEN_PUBLISH)) != metaData.signSet.keySignSet.end())
+    {
+        bool oldStyleKey;
+        RsGxsId keyId = findPublishKeyId(grpKeySet, oldStyleKey);
+
+        if(!keyId.isNull())
+            signatures.push_back(std::make_pair(sit->second, grpKeySet.public_keys.find(keyId)->second));
+    }
+
+    if(needIdentitySign && mGixs && (sit = metaData.signSet.keySignSet.find(INDEX_AUTHEN_IDENTITY)) != metaData.signSet.keySignSet.end()
+            && mGixs->haveKey(metaData.mAuthorId))
+    {
+        RsTlvPublicRSAKey authorKey;
+
+        if(mGixs->getKey(metaData.mAuthorId, authorKey))
+            signatures.push_back(std::make_pair(sit->second, authorKey));
+    }
+}
+
+int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uint32_t& /*signFlag*/, RsTlvSecurityKeySet& grpKeySet)
+{
+    // 1 - determine which signatures are needed, by looking for the flags corresponding to the
+    //     type of message we have, in the authentication policy of the service
+
+    bool needIdentitySign = false;
+    bool needPublishSign = false;
+    bool publishValidate = true, idValidate = true;
+
+    msgSignaturesNeeded(msg, grpFlag, needPublishSign, needIdentitySign);
 
 #ifdef GEN_EXCH_DEBUG	
     std::cerr << "Validate message: msgId=" << msg->msgId << ", grpId=" << msg->grpId << " grpFlags=" << std::hex << grpFlag << std::dec
@@ -889,25 +960,14 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 		RsTlvKeySignature sign = metaData.signSet.keySignSet[INDEX_AUTHEN_PUBLISH];
 
 		std::map<RsGxsId, RsTlvPublicRSAKey>& keys = grpKeySet.public_keys;
-		std::map<RsGxsId, RsTlvPublicRSAKey>::iterator mit = keys.begin();
 
-		RsGxsId keyId;
-		for(; mit != keys.end() ; ++mit)
-		{
-			RsTlvPublicRSAKey& key = mit->second;
+		bool oldStyleKey;
+		RsGxsId keyId = findPublishKeyId(grpKeySet, oldStyleKey);
 
-			if(key.keyFlags & RSTLV_KEY_DISTRIB_PUBLIC_deprecated)
-			{
-				keyId = key.keyId;
-				std::cerr << "WARNING: old style publish key with flags " << key.keyFlags << std::endl;
-				std::cerr << "         this cannot be fixed, but RS will deal with it." << std::endl;
-				break ;
-			}
-			if(key.keyFlags & RSTLV_KEY_DISTRIB_PUBLISH) // we might have the private key, but we still should be able to check the signature
-			{
-				keyId = key.keyId;
-				break;
-			}
+		if(oldStyleKey)
+		{
+			std::cerr << "WARNING: old style publish key with flags " << keys[keyId].keyFlags << std::endl;
+			std::cerr << "         this cannot be fixed, but RS will deal with it." << std::endl;
 		}
 
 		if(!keyId.isNull())
@@ -1995,6 +2055,8 @@ void RsGenExchange::setGroupSubscribeFlags(uint32_t& token, const RsGxsGroupId&
     g.val.put(RsGeneralDataService::GRP_META_SUBSCRIBE_FLAG, (int32_t)flag);
     g.val.put(RsGeneralDataService::GRP_META_SUBSCRIBE_FLAG+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+
+    GxsRequestPool::schedule(this);
 }
 
 void RsGenExchange::setGroupStatusFlags(uint32_t& token, const RsGxsGroupId& grpId, const uint32_t& status, const uint32_t& mask)
@@ -2008,6 +2070,8 @@ void RsGenExchange::setGroupStatusFlags(uint32_t& token, const RsGxsGroupId& grp
     g.val.put(RsGeneralDataService::GRP_META_STATUS, (int32_t)status);
     g.val.put(RsGeneralDataService::GRP_META_STATUS+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+
+    GxsRequestPool::schedule(this);
 }
 
 
@@ -2020,6 +2084,8 @@ void RsGenExchange::setGroupServiceString(uint32_t& token, const RsGxsGroupId& g
     g.grpId = grpId;
     g.val.put(RsGeneralDataService::GRP_META_SERV_STRING, servString);
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+
+    GxsRequestPool::schedule(this);
 }
 
 void RsGenExchange::setMsgStatusFlags(uint32_t& token, const RsGxsGrpMsgIdPair& msgId, const uint32_t& status, const uint32_t& mask)
@@ -2033,6 +2099,8 @@ void RsGenExchange::setMsgStatusFlags(uint32_t& token, const RsGxsGrpMsgIdPair&
     m.val.put(RsGeneralDataService::MSG_META_STATUS+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     m.msgId = msgId;
     mMsgLocMetaMap.insert(std::make_pair(token, m));
+
+    GxsRequestPool::schedule(this);
 }
 
 void RsGenExchange::setMsgServiceString(uint32_t& token, const RsGxsGrpMsgIdPair& msgId, const std::string& servString )
@@ -2044,6 +2112,8 @@ void RsGenExchange::setMsgServiceString(uint32_t& token, const RsGxsGrpMsgIdPair
     m.val.put(RsGeneralDataService::MSG_META_SERV_STRING, servString);
     m.msgId = msgId;
     mMsgLocMetaMap.insert(std::make_pair(token, m));
+
+    GxsRequestPool::schedule(this);
 }
 
 void RsGenExchange::processMsgMetaChanges()
@@ -3059,6 +3129,17 @@ void RsGenExchange::processRecvdMessages()
 {
     std::list<RsGxsMessageId> messages_to_reject ;
 
+    RsGxsGrpMetaTemporaryMap grpMetas;
+
+    // Signatures of each message to validate, checked off-mutex (see below).
+    struct MsgSignatures
+    {
+        RsGxsMessageId pendingId;	// key in mMsgPendingValidate
+        RsNxsMsg *msg;
+        std::vector<std::pair<RsTlvKeySignature, RsTlvPublicRSAKey> > signatures;
+    };
+    std::vector<MsgSignatures> msgs_to_validate;
+
     {
 	    RS_STACK_MUTEX(mGenMtx) ;
 
@@ -3072,8 +3153,6 @@ void RsGenExchange::processRecvdMessages()
 #endif
 		// 1 - First, make sure items metadata is deserialised, clean old failed items, and collect the groups Ids we have to check
 
-		RsGxsGrpMetaTemporaryMap grpMetas;
-
 	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();)
 	    {
 		    GxsPendingItem<RsNxsMsg*, RsGxsGrpMsgIdPair>& gpsi = pend_it->second;
@@ -3116,6 +3195,49 @@ void RsGenExchange::processRecvdMessages()
 		if(!grpMetas.empty())
 			mDataStore->retrieveGxsGrpMetaData(grpMetas);
 
+		// 3 - Collect the signatures to check, with their keys. The pending messages are only deleted
+		//     by this thread, so they can be used off-mutex.
+
+	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();++pend_it)
+	    {
+		    RsNxsMsg* msg = pend_it->second.mItem;
+            auto mit = grpMetas.find(msg->grpId);
+
+			if(mit == grpMetas.end())
+			{
+				std::cerr << "RsGenExchange::processRecvdMessages(): impossible situation: grp meta " << msg->grpId << " not available." << std::endl;
+				continue ;
+			}
+
+			RsTlvSecurityKeySet keys = mit->second->keys ;
+			GxsSecurity::createPublicKeysFromPrivateKeys(keys);
+
+			msgs_to_validate.push_back(MsgSignatures());
+			msgs_to_validate.back().pendingId = pend_it->first;
+			msgs_to_validate.back().msg = msg;
+			locked_collectMsgSignatures(msg, mit->second->mGroupFlags, keys, msgs_to_validate.back().signatures);
+	    }
+    }
+
+    // 4 - Check the signatures in parallel, without holding mGenMtx. GxsSecurity keeps the signatures
+    //     that passed in a cache, so validateMsg() below does not check them again. Signatures of a
+    //     given message are checked in the same job, since checking temporarily modifies its meta data.
+
+    std::vector<std::function<void()> > jobs;
+
+    for(auto& m: msgs_to_validate)
+        if(!m.signatures.empty())
+            jobs.push_back([&m]()
+            {
+                for(auto& s: m.signatures)
+                    GxsSecurity::validateNxsMsg(*m.msg, s.first, s.second);
+            });
+
+    GxsValidationPool::run(jobs);
+
+    {
+	    RS_STACK_MUTEX(mGenMtx) ;
+
 	    GxsMsgReq msgIds;
         std::list<RsNxsMsg*> msgs_to_store;
         std::map<RsGxsGroupId,time_t> groups_last_post_update;
@@ -3124,11 +3246,11 @@ void RsGenExchange::processRecvdMessages()
 	    std::cerr << "  updating received messages:" << std::endl;
 #endif
 
-		// 3 - Validate each message
+		// 5 - Validate each message, and store the valid ones in a single batch
 
-	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();)
+	    for(auto& m: msgs_to_validate)
 	    {
-		    RsNxsMsg* msg = pend_it->second.mItem;
+		    RsNxsMsg* msg = m.msg;
 
             // (cyril) Normally we should discard posts that are older than the sync request. But that causes a problem because
             // 	RsGxsNetService requests posts to sync by chunks of 20. So if the 20 are discarded, they will be re-synced next time, and the sync process
@@ -3152,13 +3274,6 @@ void RsGenExchange::processRecvdMessages()
 #endif
 			// validate msg
 
-			if(mit == grpMetas.end())
-			{
-				std::cerr << "RsGenExchange::processRecvdMessages(): impossible situation: grp meta " << msg->grpId << " not available." << std::endl;
-				++pend_it ;
-				continue ;
-			}
-
             const auto& grpMeta = mit->second;
 			RsTlvSecurityKeySet keys = grpMeta->keys ;
 
@@ -3211,17 +3326,11 @@ void RsGenExchange::processRecvdMessages()
 				delete msg ;
 			}
 			else if(validateReturn == VALIDATE_FAIL_TRY_LATER)
-			{
-				++pend_it ;
 				continue;
-			}
 
 			// Remove the entry from mMsgPendingValidate, but do not delete msg since it's either pushed into msg_to_store or deleted in the FAIL case!
 
-			NxsMsgPendingVect::iterator tmp = pend_it ;
-			++tmp ;
-			mMsgPendingValidate.erase(pend_it) ;
-			pend_it = tmp ;
+			mMsgPendingValidate.erase(m.pendingId) ;
 	    }
 
 	    if(!msgIds.empty())
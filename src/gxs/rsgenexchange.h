@@ -35,6 +35,7 @@
 #include "rsitems/rsnxsitems.h"
 #include "gxs/rsgxsnotify.h"
 #include "rsgxsutil.h"
+#include "gxsrequestpool.h"
 
 template<class GxsItem, typename Identity = std::string>
 class GxsPendingItem
@@ -96,7 +97,7 @@ typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsGxsMsgItem*> > GxsMsgRelatedDa
 
 class RsGixs;
 
-class RsGenExchange : public RsNxsObserver, public RsTickingThread, public RsGxsIface
+class RsGenExchange : public RsNxsObserver, public RsTickingThread, public RsGxsIface, public GxsRequestProcessor
 {
 public:
 
@@ -165,6 +166,12 @@ public:
      */
     void tick();
 
+    /*!
+     * Applies pending meta changes and processes pending token requests.
+     * Called on tick, and by the GXS request pool as soon as a request is made.
+     */
+    void processPendingRequests() override;
+
     /*!
      * Any backgroup processing needed by
      */
@@ -893,6 +900,26 @@ private:
      */
     int validateMsg(RsNxsMsg* msg, const uint32_t& grpFlag, const uint32_t &signFlag, RsTlvSecurityKeySet& grpKeySet);
 
+    /*!
+     * Determines which signatures validateMsg() will check on this message
+     * @param needPublishSign set if the group publish signature is required
+     * @param needIdentitySign set if the author signature is required or present
+     */
+    void msgSignaturesNeeded(const RsNxsMsg* msg, uint32_t grpFlag, bool& needPublishSign, bool& needIdentitySign) const;
+
+    /*!
+     * Collects the signatures of a message, with the keys they should be checked against, so that
+     * they can be checked off-mutex before validateMsg() is called. Keys that are not available yet
+     * are skipped: validateMsg() deals with them.
+     */
+    void locked_collectMsgSignatures(const RsNxsMsg* msg, uint32_t grpFlag, const RsTlvSecurityKeySet& grpKeySet,
+                                     std::vector<std::pair<RsTlvKeySignature, RsTlvPublicRSAKey> >& signatures);
+
+    /*!
+     * @return the id of the key of the group used for publish signatures, or a null id
+     */
+    static RsGxsId findPublishKeyId(const RsTlvSecurityKeySet& grpKeySet, bool& oldStyleKey);
+
     /*!
 	 * Attempts to validate group signatures
 	 * @param grp group to be validated
@@ -943,6 +970,7 @@ private:
     void removeDeleteExistingMessages(std::list<RsNxsMsg*>& msgs, GxsMsgReq& msgIdsNotify);
 
     RsMutex mGenMtx;
+    RsMutex mRequestProcessingMtx;	// only one thread processes the requests of a service at a time
     RsGxsDataAccess* mDataAccess;
     RsGeneralDataService* mDataStore;
     RsNetworkExchangeService *mNetService;
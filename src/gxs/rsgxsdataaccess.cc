@@ -24,6 +24,7 @@
 
 #include "rsgxsutil.h"
 #include "rsgxsdataaccess.h"
+#include "gxsrequestpool.h"
 #include "retroshare/rsgxsflags.h"
 
 /***********
@@ -79,7 +80,7 @@ bool operator<(const std::pair<uint32_t,GxsRequest*>& p1,const std::pair<uint32_
 }
 
 RsGxsDataAccess::RsGxsDataAccess(RsGeneralDataService* ds) :
-    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0) {}
+    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0), mRequestProcessor(nullptr) {}
 
 
 RsGxsDataAccess::~RsGxsDataAccess()
@@ -349,20 +350,27 @@ void RsGxsDataAccess::setReq(GxsRequest* req, uint32_t token, uint32_t ansType,
 }
 void RsGxsDataAccess::storeRequest(GxsRequest* req)
 {
-	RS_STACK_MUTEX(mDataMutex);
-	req->status = PENDING;
-	req->reqTime = time(nullptr);
+	{
+		RS_STACK_MUTEX(mDataMutex);
+		req->status = PENDING;
+		req->reqTime = time(nullptr);
 
-	mRequestQueue.insert(std::make_pair(req->token,req));
-    mPublicToken[req->token] = PENDING;
+		mRequestQueue.insert(std::make_pair(req->token,req));
+		mPublicToken[req->token] = PENDING;
 
 #ifdef DATA_DEBUG
-    GXSDATADEBUG << "Stored request token=" << req->token << " priority = " << static_cast<int>(req->Options.mPriority) << " Current request Queue is:" ;
-    for(auto it(mRequestQueue.begin());it!=mRequestQueue.end();++it)
-        GXSDATADEBUG << it->first << " (p=" << static_cast<int>(req->Options.mPriority) << ") ";
-    GXSDATADEBUG << std::endl;
-    GXSDATADEBUG << "PublicToken size: " << mPublicToken.size() << " Completed requests waiting for client: " << mCompletedRequests.size() << std::endl;
+		GXSDATADEBUG << "Stored request token=" << req->token << " priority = " << static_cast<int>(req->Options.mPriority) << " Current request Queue is:" ;
+		for(auto it(mRequestQueue.begin());it!=mRequestQueue.end();++it)
+			GXSDATADEBUG << it->first << " (p=" << static_cast<int>(req->Options.mPriority) << ") ";
+		GXSDATADEBUG << std::endl;
+		GXSDATADEBUG << "PublicToken size: " << mPublicToken.size() << " Completed requests waiting for client: " << mCompletedRequests.size() << std::endl;
 #endif
+	}
+
+	// Don't wait for the next tick of the service.
+
+	if(mRequestProcessor)
+		GxsRequestPool::schedule(mRequestProcessor);
 }
 
 RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
@@ -378,6 +386,39 @@ RsTokenService::GxsRequestStatus RsGxsDataAccess::requestStatus(uint32_t token)
 	return status;
 }
 
+RsTokenService::GxsRequestStatus RsGxsDataAccess::waitForRequest(uint32_t token, std::chrono::milliseconds maxWait)
+{
+	// Status is re-checked at least this often, in case a status change is not notified.
+	static const std::chrono::milliseconds MAX_WAIT_STEP(1000);
+
+	auto timeout = std::chrono::steady_clock::now() + maxWait;
+	std::unique_lock<std::mutex> lock(mWaitMutex);
+
+	while(true)
+	{
+		GxsRequestStatus st = requestStatus(token);
+
+		if(st == FAILED || st >= COMPLETE)
+			return st;
+
+		auto now = std::chrono::steady_clock::now();
+
+		if(now >= timeout)
+			return st;
+
+		mWaitCondition.wait_until(lock, std::min(timeout, now + MAX_WAIT_STEP));
+	}
+}
+
+void RsGxsDataAccess::notifyRequestStatusChanged()
+{
+	// Taking the lock makes sure that a waiter is either before its status check, or waiting.
+	{
+		std::lock_guard<std::mutex> lock(mWaitMutex);
+	}
+	mWaitCondition.notify_all();
+}
+
 bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
 {
 	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
@@ -769,6 +810,7 @@ void RsGxsDataAccess::processRequests()
 			{
 				if(now > mRequestQueue.begin()->second->reqTime + MAX_REQUEST_AGE)
 				{
+					// Too old: the caller has given up waiting already, so no need to notify.
 					mPublicToken[mRequestQueue.begin()->second->token] = CANCELLED;
 					delete mRequestQueue.begin()->second;
 					mRequestQueue.erase(mRequestQueue.begin());
@@ -891,6 +933,7 @@ void RsGxsDataAccess::processRequests()
 			}
 		} // END OF MUTEX.
 
+		notifyRequestStatusChanged();
 	}
 }
 
@@ -1027,193 +1070,70 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
 	return true;
 }
 
-bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result )
+void RsGxsDataAccess::buildMsgMetaQuery(const RsTokReqOptions& opts, RsGxsMsgMetaQuery& query)
 {
-    // First get all message metas, then filter out the ones we want to keep.
-    result.clear();
-    mDataStore->retrieveGxsMsgMetaData(msgIds, result);
-
-    /* CASEs this handles.
-     * Input is groupList + Flags.
-     * 1) No Flags => All Messages in those Groups.
-     *
-     */
-#ifdef DATA_DEBUG
-    GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": RsGxsDataAccess::getMsgList()" << std::endl;
-#endif
-
-    bool onlyOrigMsgs = false;
-    bool onlyLatestMsgs = false;
-    bool onlyThreadHeadMsgs = false;
+    query = RsGxsMsgMetaQuery();
 
     // Can only choose one of these two.
     if (opts.mOptions & RS_TOKREQOPT_MSG_ORIGMSG)
-    {
-#ifdef DATA_DEBUG
-            GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": RsGxsDataAccess::getMsgList() MSG_ORIGMSG" << std::endl;
-#endif
-            onlyOrigMsgs = true;
-    }
+        query.mOrigMsgsOnly = true;
     else if (opts.mOptions & RS_TOKREQOPT_MSG_LATEST)
-    {
-#ifdef DATA_DEBUG
-            GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": RsGxsDataAccess::getMsgList() MSG_LATEST" << std::endl;
-#endif
-            onlyLatestMsgs = true;
-    }
+        query.mLatestMsgsOnly = true;
 
     if (opts.mOptions & RS_TOKREQOPT_MSG_THREAD)
-    {
-#ifdef DATA_DEBUG
-            GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": RsGxsDataAccess::getMsgList() MSG_THREAD" << std::endl;
-#endif
-            onlyThreadHeadMsgs = true;
-    }
+        query.mThreadHeadsOnly = true;
 
-    GxsMsgMetaResult::iterator meta_it;
+    query.mStatusMask = opts.mStatusMask;
+    query.mStatusFilter = opts.mStatusFilter;
+    query.mMsgFlagMask = opts.mMsgFlagMask;
+    query.mMsgFlagFilter = opts.mMsgFlagFilter;
 
-    for(meta_it = result.begin(); meta_it != result.end(); ++meta_it)
-    {
-            //const RsGxsGroupId& grpId = meta_it->first;
-
-            //auto& filter( metaFilter[grpId] ); // does the initialization of metaFilter[grpId] and avoids further O(log(n)) calls
-
-            auto& metaV = meta_it->second;
-
-            if (onlyLatestMsgs) // if we only consider latest messages, we need to first filter out messages with "children"
-            {
-                // The strategy is the following: for each msg we only know its direct ancestor. So we build a map to be able to find for a given message
-                // which messages derive from it.
-                // Then when this map is fuly build, we follow this map and every message that has no direct follow up will be kept.
-                // Because msgs are stored in a std::vector we build a map to convert each vector to its position in metaV.
+    query.mAfter = opts.mAfter;
+    query.mBefore = opts.mBefore;
 
-               std::vector<bool> keep(metaV.size(),true);	   // this vector will tell wether we keep or not a given Meta
-               std::map<RsGxsMessageId,uint32_t> index_in_metaV; // holds the index of each group Id in metaV
-
-               for(uint32_t i=0;i<metaV.size();++i)
-                   index_in_metaV[metaV[i]->mMsgId] = i;
-
-               // Now loop once over message Metas and see if they have a parent. If yes, then mark the parent to be discarded.
-
-               for(uint32_t i=0;i<metaV.size();++i)
-                   if(!metaV[i]->mOrigMsgId.isNull() && metaV[i]->mOrigMsgId != metaV[i]->mMsgId)	// this one is a follow up
-                   {
-                       auto it = index_in_metaV.find(metaV[i]->mOrigMsgId);
-
-                       if(it != index_in_metaV.end())
-                           keep[it->second] = false;
-                       else
-                           std::cerr << "Found a msg that has a parent that is not locally known. Not an error anyway." << std::endl;
-
-                   }
-
-               // Finally we just discard the messages for which the keep flag has been set to false.
-
-               for(uint32_t i=0;i<metaV.size();++i)
-                   if(!keep[i])
-                   {
-                       //delete metaV[i];
-                       metaV[i] = nullptr;
-                   }
-			}
-
-// old version of the code. I keep it for future reference if something happens.
-
-#ifdef OLD_VERSION_OF_THE_CODE
-                    // RUN THROUGH ALL MSGS... in map origId -> TS.
-                    std::map<RsGxsMessageId, std::pair<RsGxsMessageId, rstime_t> > origMsgTs;
+    query.mLimit = opts.mLimit;
+    query.mOffset = opts.mOffset;
+}
 
-                    for(uint32_t i=0;i<metaV.size();++i)
-                    {
-                        RsGxsMsgMetaData* msgMeta = metaV[i];
-
-                        /* if we are grabbing thread Head... then parentId == empty. */
-                        if (onlyThreadHeadMsgs && !(msgMeta->mParentId.isNull()))
-                        {
-                            delete msgMeta;
-                            metaV[i] = nullptr;
-                            continue;
-                        }
-
-                        auto oit = origMsgTs.find(msgMeta->mOrigMsgId);
-
-                        bool addMsg = false;
-                        if (oit != origMsgTs.end())
-                        {
-                            if(oit->second.second > msgMeta->mPublishTs)
-                            {
+bool RsGxsDataAccess::getMsgMetaDataList( const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgMetaResult& result )
+{
+    /* CASEs this handles.
+     * Input is groupList + Flags.
+     * 1) No Flags => All Messages in those Groups.
+     *
+     */
 #ifdef DATA_DEBUG
-								std::cerr << "RsGxsDataAccess::getMsgList() Found New OrigMsgId: ";
-								std::cerr << msgMeta->mOrigMsgId;
-								std::cerr << " MsgId: " << msgMeta->mMsgId;
-								std::cerr << " TS: " << msgMeta->mPublishTs;
-								std::cerr << std::endl;
+    GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": RsGxsDataAccess::getMsgList() options: " << std::hex << opts.mOptions << std::dec << std::endl;
 #endif
-								origMsgTs[msgMeta->mOrigMsgId] = std::make_pair(msgMeta->mMsgId, msgMeta->mPublishTs); // add as latest. (overwriting if necessary)
-                            }
-                        }
-                        else
-                        {
-                            delete msgMeta;
-                            metaV[i] = nullptr;
-                            continue;
-                        }
 
+    result.clear();
 
-                    }
+    RsGxsMsgMetaQuery query;
+    buildMsgMetaQuery(opts, query);
 
-                    // Add the discovered Latest Msgs.
-                    for(auto oit = origMsgTs.begin(); oit != origMsgTs.end(); ++oit)
-                    {
-						msgIdsOut[grpId].insert(oit->second.first);
-                    }
-#endif
+    // Whole groups are filtered by the data store, so that only the selected
+    // metas are loaded. Explicit lists of msgs are filtered here, among themselves.
 
-			for(uint32_t i=0;i<metaV.size();++i)
-                if(metaV[i] != nullptr)
-				{
-					const auto& msgMeta = metaV[i];
-
-					/* if we are grabbing thread Head... then parentId == empty. */
-					if (onlyThreadHeadMsgs && !msgMeta->mParentId.isNull())
-					{
-						//delete msgMeta;
-						metaV[i] = nullptr;
-						continue;
-					}
-
-					if (onlyOrigMsgs && !msgMeta->mOrigMsgId.isNull() && msgMeta->mMsgId != msgMeta->mOrigMsgId)
-					{
-						//delete msgMeta;
-						metaV[i] = nullptr;
-						continue;
-					}
-				}
-    }
+    GxsMsgReq explicitMsgIds;
 
-    // collapse results while keeping the order, eliminating empty slots
+    for(auto it(msgIds.begin());it!=msgIds.end();++it)
+        if(it->second.empty())
+            mDataStore->retrieveGxsMsgMetaData(it->first, query, result[it->first]);
+        else
+            explicitMsgIds.insert(*it);
 
-    for(auto it(result.begin());it!=result.end();++it)
-    {
-        uint32_t j=0; // j is the end of the cleaned-up tab, at the first available place
+    if(explicitMsgIds.empty())
+        return true;
 
-        for(uint32_t i=0;i<it->second.size();++i) // i is the index in the tab possibly containing nullptr's
-            if(it->second[i] != nullptr)
-            {
-				it->second[j] = it->second[i]; // move the pointer to the first available place
-                ++j;
-            }
+    GxsMsgMetaResult explicitResult;
+    mDataStore->retrieveGxsMsgMetaData(explicitMsgIds, explicitResult);
 
-        it->second.resize(j);	// normally all pointers have been moved forward so there is nothing to delete here.
+    for(auto it(explicitResult.begin());it!=explicitResult.end();++it)
+    {
+        query.apply(it->second);
+        result[it->first] = std::move(it->second);
     }
 
-    // filterMsgIdList(msgIdsOut, opts, metaFilter); // this call is absurd: we already have in metaFilter the content we want.
-
-    //metaFilter.clear();
-
-    // delete meta data
-    //cleanseMsgMetaMap(result);
-
     return true;
 }
 
@@ -1330,38 +1250,53 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
     {
         MsgMetaFilter filterMap;
 
-
         const RsGxsGrpMsgIdPair& grpMsgIdPair = *vit_msgIds;
 
-        // get meta data for all in group
-        GxsMsgMetaResult result;
-        GxsMsgReq msgIds;
-        msgIds.insert(std::make_pair(grpMsgIdPair.first, std::set<RsGxsMessageId>()));
-        mDataStore->retrieveGxsMsgMetaData(msgIds, result);
-        auto& metaV = result[grpMsgIdPair.first];
-
         // msg id to relate to
         const RsGxsMessageId& msgId = grpMsgIdPair.second;
         const RsGxsGroupId& grpId = grpMsgIdPair.first;
 
         std::set<RsGxsMessageId> outMsgIds;
 
-        std::shared_ptr<RsGxsMsgMetaData> origMeta;
+        // Only the related msgs are asked to the data store, using its
+        // indexes, rather than the whole group being loaded and scanned.
 
-        for(auto vit_meta = metaV.begin(); vit_meta != metaV.end(); ++vit_meta)
-            if(msgId == (*vit_meta)->mMsgId)
-            {
-                origMeta = *vit_meta;
-                break;
-            }
+        std::vector<std::shared_ptr<RsGxsMsgMetaData> > origMetaV;
+        RsGxsMsgMetaQuery origQuery;
+        origQuery.mMsgId = msgId;
+        mDataStore->retrieveGxsMsgMetaData(grpId, origQuery, origMetaV);
 
-		if(!origMeta)
+		if(origMetaV.empty())
 		{
 			RS_ERR("Cannot find meta of msgId: ", msgId, " to relate to");
 			return false;
 		}
 
+        std::shared_ptr<RsGxsMsgMetaData> origMeta = origMetaV.front();
         const RsGxsMessageId& origMsgId = origMeta->mOrigMsgId;
+
+        RsGxsMsgMetaQuery query;
+
+        if (onlyChildMsgs)
+        {
+            // a null origMsgId has null parent ids as children
+            if(origMsgId.isNull())
+                query.mThreadHeadsOnly = true;
+            else
+                query.mParentId = origMsgId;
+        }
+        else if (onlyThreadMsgs)
+            query.mThreadId = msgId;
+        else
+            query.mOrigMsgId = origMsgId;
+
+        std::vector<std::shared_ptr<RsGxsMsgMetaData> > metaV;
+
+        if(query.mOrigMsgId.isNull() && !onlyChildMsgs && !onlyThreadMsgs)
+            metaV.push_back(origMeta);	// no version info: the msg is its only version
+        else
+            mDataStore->retrieveGxsMsgMetaData(grpId, query, metaV);
+
         auto& metaMap = filterMap[grpId];
 
         if (onlyLatestMsgs)
@@ -1376,23 +1311,6 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
                 {
                     auto meta = *vit_meta;
 
-                    // skip msgs that aren't children.
-                    if (onlyChildMsgs)
-                    {
-                        if (meta->mParentId != origMsgId)
-                        {
-                            continue;
-                        }
-                    }
-                    else /* onlyThreadMsgs */
-                    {
-                        if (meta->mThreadId != msgId)
-                        {
-                            continue;
-                        }
-                    }
-
-
                     oit = origMsgTs.find(meta->mOrigMsgId);
 
                     bool addMsg = false;
@@ -1445,14 +1363,11 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
                 std::shared_ptr<RsGxsMsgMetaData> latestMeta;
 
                 for(auto vit_meta = metaV.begin(); vit_meta != metaV.end(); ++vit_meta)
-                    if ((*vit_meta)->mOrigMsgId == origMsgId)
+                    if ((*vit_meta)->mPublishTs > latestTs)
                     {
-                        if ((*vit_meta)->mPublishTs > latestTs)
-                        {
-                            latestTs = (*vit_meta)->mPublishTs;
-                            latestMsgId = (*vit_meta)->mMsgId;
-                            latestMeta = (*vit_meta);
-                        }
+                        latestTs = (*vit_meta)->mPublishTs;
+                        latestMsgId = (*vit_meta)->mMsgId;
+                        latestMeta = (*vit_meta);
                     }
 
                 outMsgIds.insert(latestMsgId);
@@ -1462,11 +1377,10 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
         else if (onlyAllVersions)
         {
             for(auto vit_meta = metaV.begin(); vit_meta != metaV.end(); ++vit_meta)
-                if ((*vit_meta)->mOrigMsgId == origMsgId)
-                {
-                    outMsgIds.insert((*vit_meta)->mMsgId);
-                    metaMap.insert(std::make_pair((*vit_meta)->mMsgId, (*vit_meta)));
-                }
+            {
+                outMsgIds.insert((*vit_meta)->mMsgId);
+                metaMap.insert(std::make_pair((*vit_meta)->mMsgId, (*vit_meta)));
+            }
         }
 
         GxsMsgIdResult filteredOutMsgIds;
@@ -1481,9 +1395,11 @@ bool RsGxsDataAccess::getMsgRelatedInfo(MsgRelatedInfoReq *req)
             }
             else if(req->Options.mReqType == GXS_REQUEST_TYPE_MSG_RELATED_META)
             {
-                GxsMsgMetaResult metaResult;
-                mDataStore->retrieveGxsMsgMetaData(filteredOutMsgIds, metaResult);
-                req->mMsgMetaResult[grpMsgIdPair] = metaResult[grpId];
+                // the metas are already at hand
+                auto& metaResult(req->mMsgMetaResult[grpMsgIdPair]);
+
+                for(const auto& id: filteredOutMsgIds[grpId])
+                    metaResult.push_back(metaMap[id]);
             }
             else if(req->Options.mReqType == GXS_REQUEST_TYPE_MSG_RELATED_DATA)
             {
@@ -1601,23 +1517,10 @@ bool RsGxsDataAccess::getServiceStatistic(ServiceStatisticRequest *req)
 
 bool RsGxsDataAccess::getMsgIdList(MsgIdReq* req)
 {
-
-    GxsMsgMetaResult result;
-    mDataStore->retrieveGxsMsgMetaData(req->mMsgIds, result);
-
-    for(auto mit = result.begin(); mit != result.end(); ++mit)
-    {
-        const RsGxsGroupId grpId = mit->first;
-        auto& metaV = mit->second;
-
-        for(auto vit=metaV.begin(); vit != metaV.end(); ++vit)
-            req->mMsgIdResult[grpId].insert((*vit)->mMsgId);
-    }
-
     GxsMsgReq msgIdOut;
 
     // filter based on options
-    getMsgIdList(req->mMsgIdResult, req->Options, msgIdOut);
+    getMsgIdList(req->mMsgIds, req->Options, msgIdOut);
     req->mMsgIdResult = msgIdOut;
 
     return true;
@@ -1812,20 +1715,22 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 
 bool RsGxsDataAccess::updatePublicRequestStatus( uint32_t token, RsTokenService::GxsRequestStatus status )
 {
-	RS_STACK_MUTEX(mDataMutex);
+	{
+		RS_STACK_MUTEX(mDataMutex);
 
-	auto mit = mPublicToken.find(token);
+		auto mit = mPublicToken.find(token);
 
-	if(mit != mPublicToken.end())
-    {
-        mit->second = status;
+		if(mit == mPublicToken.end())
+			return false;
+
+		mit->second = status;
 #ifdef DATA_DEBUG
-        GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": updating public token " << token << " to state  " << tokenStatusString[status] << std::endl;
+		GXSDATADEBUG << "Service " << std::hex << mDataStore->serviceType() << std::dec << ": updating public token " << token << " to state  " << tokenStatusString[status] << std::endl;
 #endif
-        return true;
-    }
-	else
-        return false;
+	}
+
+	notifyRequestStatusChanged();
+	return true;
 }
 
 
@@ -23,10 +23,14 @@
 #define RSGXSDATAACCESS_H
 
 #include <queue>
+#include <mutex>
+#include <condition_variable>
 #include "retroshare/rstokenservice.h"
 #include "rsgxsrequesttypes.h"
 #include "rsgds.h"
 
+class GxsRequestProcessor;
+
 
 typedef std::map< RsGxsGroupId, std::map<RsGxsMessageId, std::shared_ptr<RsGxsMsgMetaData> > > MsgMetaFilter;
 typedef std::map< RsGxsGroupId, std::shared_ptr<RsGxsGrpMetaData> > GrpMetaFilter;
@@ -128,6 +132,9 @@ public:
     /* Cancel Request */
     bool cancelRequest(const uint32_t &token);
 
+    /* Wait for request completion */
+	GxsRequestStatus waitForRequest(uint32_t token, std::chrono::milliseconds maxWait) override;
+
 
     /** E: RsTokenService **/
 
@@ -175,6 +182,12 @@ public:
      */
     void processRequests();
 
+    /*!
+     * Sets who is asked to call processRequests() as soon as a new request is stored.
+     * Without one, requests are only processed when processRequests() is called periodically.
+     */
+    void setRequestProcessor(GxsRequestProcessor *processor) { mRequestProcessor = processor; }
+
     /*!
      * @param token
      * @param grpStatistic
@@ -480,6 +493,14 @@ private:
      */
     bool checkMsgFilter(const RsTokReqOptions& opts, const std::shared_ptr<RsGxsMsgMetaData>& meta) const;
 
+    /*!
+     * Translates the options of a message list request into a query the data
+     * store can evaluate by itself
+     * @param opts request options
+     * @param query resulting query
+     */
+    static void buildMsgMetaQuery(const RsTokReqOptions& opts, RsGxsMsgMetaQuery& query);
+
     /*!
      * This applies the options to the meta to find out if the given group satisfies
      * them
@@ -513,6 +534,14 @@ private:
     std::set<std::pair<uint32_t,GxsRequest*> > mRequestQueue;
     std::map<uint32_t, GxsRequest*> mCompletedRequests;
 
+    GxsRequestProcessor *mRequestProcessor;
+
+    // Wakes up the callers of waitForRequest(). Must never be locked while holding mDataMutex.
+    std::mutex mWaitMutex;
+    std::condition_variable mWaitCondition;
+
+    void notifyRequestStatusChanged();
+
     bool mUseMetaCache;
 };
 
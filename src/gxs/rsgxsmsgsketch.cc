@@ -0,0 +1,243 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsmsgsketch.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "gxs/rsgxsmsgsketch.h"
+#include "serialiser/rsbaseserial.h"
+
+const uint32_t RsGxsMsgIdSketch::HASH_COUNT       = 3;
+const uint32_t RsGxsMsgIdSketch::MIN_CELL_COUNT   = 60;
+const uint32_t RsGxsMsgIdSketch::MAX_CELL_COUNT   = 6000;	// ~170kB on the wire
+const uint8_t  RsGxsMsgIdSketch::SERIAL_VERSION   = 0x01;
+const uint32_t RsGxsMsgIdSketch::CELL_SERIAL_SIZE = 4 + RsGxsMessageId::SIZE_IN_BYTES + 4;
+
+static const uint32_t SKETCH_HEADER_SIZE = 1 + 4 + 4;
+
+RsGxsMsgIdSketch::RsGxsMsgIdSketch(uint32_t cellCount) : mElementCount(0)
+{
+	cellCount = std::max(MIN_CELL_COUNT, std::min(MAX_CELL_COUNT, cellCount));
+
+	// Each hash function addresses its own slice of the table, so that an ID
+	// never lands twice in the same cell.
+	cellCount -= cellCount % HASH_COUNT;
+	mCells.resize(cellCount);
+}
+
+uint32_t RsGxsMsgIdSketch::suggestedCellCount(uint32_t setSize)
+{
+	// Peeling succeeds with high probability as long as the difference stays
+	// below ~2/3 of the number of cells. A 1/16 ratio means the sketch is
+	// still ~100 times smaller than the full list of sync items it replaces.
+	return std::max(MIN_CELL_COUNT, std::min(MAX_CELL_COUNT, setSize / 16));
+}
+
+uint64_t RsGxsMsgIdSketch::mix(uint64_t seed, const RsGxsMessageId& id)
+{
+	// FNV-1a followed by the splitmix64 finalizer. Not cryptographic, but
+	// message IDs are already hashes of signed data.
+	uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+	const uint8_t *b = id.toByteArray();
+
+	for(uint32_t i=0; i<RsGxsMessageId::SIZE_IN_BYTES; ++i)
+		h = (h ^ b[i]) * 0x100000001b3ULL;
+
+	h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+
+	return h;
+}
+
+uint32_t RsGxsMsgIdSketch::checkSumOf(const RsGxsMessageId& id)
+{
+	return static_cast<uint32_t>(mix(HASH_COUNT + 1, id) >> 32);
+}
+
+uint32_t RsGxsMsgIdSketch::cellIndex(uint32_t hash_number, const RsGxsMessageId& id) const
+{
+	uint32_t slice = cellCount() / HASH_COUNT;
+	return hash_number * slice + static_cast<uint32_t>(mix(hash_number + 1, id) % slice);
+}
+
+void RsGxsMsgIdSketch::xorInto(RsGxsMessageId& dst, const RsGxsMessageId& src)
+{
+	uint8_t *d = dst.asByteArray();
+	const uint8_t *s = src.toByteArray();
+
+	for(uint32_t i=0; i<RsGxsMessageId::SIZE_IN_BYTES; ++i)
+		d[i] ^= s[i];
+}
+
+void RsGxsMsgIdSketch::insert(const RsGxsMessageId& id)
+{
+	uint32_t cs = checkSumOf(id);
+
+	for(uint32_t i=0; i<HASH_COUNT; ++i)
+	{
+		Cell& c(mCells[cellIndex(i, id)]);
+
+		++c.count;
+		xorInto(c.idSum, id);
+		c.checkSum ^= cs;
+	}
+	++mElementCount;
+}
+
+bool RsGxsMsgIdSketch::decodeDifference( const RsGxsMsgIdSketch& other,
+                                         std::set<RsGxsMessageId>& onlyHere,
+                                         std::set<RsGxsMessageId>& onlyThere ) const
+{
+	onlyHere.clear();
+	onlyThere.clear();
+
+	if(other.cellCount() != cellCount())
+		return false;
+
+	// A sketch cannot decode more than its number of cells, no need to try
+	if( static_cast<uint32_t>(std::abs( static_cast<int64_t>(mElementCount)
+	                                    - static_cast<int64_t>(other.mElementCount) ))
+	        > cellCount() )
+		return false;
+
+	std::vector<Cell> diff(mCells);
+
+	for(uint32_t i=0; i<diff.size(); ++i)
+	{
+		diff[i].count -= other.mCells[i].count;
+		xorInto(diff[i].idSum, other.mCells[i].idSum);
+		diff[i].checkSum ^= other.mCells[i].checkSum;
+	}
+
+	auto isPure = [](const Cell& c)
+	{
+		return (c.count == 1 || c.count == -1) && c.checkSum == checkSumOf(c.idSum);
+	};
+
+	std::vector<uint32_t> pure;
+
+	for(uint32_t i=0; i<diff.size(); ++i)
+		if(isPure(diff[i]))
+			pure.push_back(i);
+
+	while(!pure.empty())
+	{
+		uint32_t idx = pure.back();
+		pure.pop_back();
+
+		// The cell may have been emptied since it was queued
+		if(!isPure(diff[idx]))
+			continue;
+
+		const RsGxsMessageId id = diff[idx].idSum;
+		int32_t sign = diff[idx].count;
+		uint32_t cs = diff[idx].checkSum;
+
+		if(sign > 0)
+			onlyHere.insert(id);
+		else
+			onlyThere.insert(id);
+
+		// Cannot happen with honest sketches, protects against crafted ones
+		if(onlyHere.size() + onlyThere.size() > cellCount())
+			return false;
+
+		for(uint32_t i=0; i<HASH_COUNT; ++i)
+		{
+			uint32_t j = cellIndex(i, id);
+			Cell& c(diff[j]);
+
+			c.count -= sign;
+			xorInto(c.idSum, id);
+			c.checkSum ^= cs;
+
+			if(isPure(c))
+				pure.push_back(j);
+		}
+	}
+
+	for(uint32_t i=0; i<diff.size(); ++i)
+		if(diff[i].count != 0 || diff[i].checkSum != 0 || !diff[i].idSum.isNull())
+			return false;
+
+	return true;
+}
+
+bool RsGxsMsgIdSketch::serialise(RsTlvBinaryData& data) const
+{
+	uint32_t size = SKETCH_HEADER_SIZE + cellCount() * CELL_SERIAL_SIZE;
+	std::vector<uint8_t> mem(size);
+	uint32_t offset = 0;
+	bool ok = true;
+
+	ok = ok && setRawUInt8(mem.data(), size, &offset, SERIAL_VERSION);
+	ok = ok && setRawUInt32(mem.data(), size, &offset, cellCount());
+	ok = ok && setRawUInt32(mem.data(), size, &offset, mElementCount);
+
+	for(uint32_t i=0; ok && i<mCells.size(); ++i)
+	{
+		ok = ok && setRawUInt32(mem.data(), size, &offset, static_cast<uint32_t>(mCells[i].count));
+		ok = ok && mCells[i].idSum.serialise(mem.data(), size, offset);
+		ok = ok && setRawUInt32(mem.data(), size, &offset, mCells[i].checkSum);
+	}
+
+	return ok && data.setBinData(mem.data(), size);
+}
+
+bool RsGxsMsgIdSketch::deserialise(const RsTlvBinaryData& data)
+{
+	const void *mem = data.bin_data;
+	uint32_t size = data.bin_len;
+	uint32_t offset = 0;
+	uint8_t version = 0;
+	uint32_t cells = 0;
+	uint32_t elements = 0;
+
+	if( !mem || !getRawUInt8(mem, size, &offset, &version)
+	        || version != SERIAL_VERSION
+	        || !getRawUInt32(mem, size, &offset, &cells)
+	        || !getRawUInt32(mem, size, &offset, &elements) )
+		return false;
+
+	if( cells < MIN_CELL_COUNT || cells > MAX_CELL_COUNT || cells % HASH_COUNT
+	        || size != SKETCH_HEADER_SIZE + cells * CELL_SERIAL_SIZE )
+		return false;
+
+	std::vector<Cell> tmp(cells);
+
+	for(uint32_t i=0; i<cells; ++i)
+	{
+		uint32_t count = 0;
+
+		if( !getRawUInt32(mem, size, &offset, &count)
+		        || !tmp[i].idSum.deserialise(mem, size, offset)
+		        || !getRawUInt32(mem, size, &offset, &tmp[i].checkSum) )
+			return false;
+
+		tmp[i].count = static_cast<int32_t>(count);
+	}
+
+	mCells.swap(tmp);
+	mElementCount = elements;
+	return true;
+}
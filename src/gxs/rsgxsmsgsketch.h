@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * libretroshare/src/gxs: rsgxsmsgsketch.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <vector>
+#include <set>
+
+#include "retroshare/rsids.h"
+#include "serialiser/rstlvbinary.h"
+
+/*!
+ * Invertible Bloom Lookup Table of message IDs, used by RsGxsNetService to
+ * reconcile the message sets of two peers without exchanging the full list.
+ *
+ * The requesting peer sends the sketch of the messages it already has. The
+ * answering peer builds the sketch of its own set with the same number of
+ * cells, subtracts the two and peels the result. When peeling succeeds it
+ * gives exactly the IDs that are on one side only, so that only the missing
+ * message IDs need to be sent back. When the difference is larger than what
+ * the sketch can hold, decoding fails and the caller falls back to sending the
+ * full list.
+ *
+ * Message IDs are SHA1 hashes, so the cell indices are simply derived from
+ * (seeded) mixes of their bytes.
+ */
+class RsGxsMsgIdSketch
+{
+public:
+	/// Number of cells each ID is hashed into
+	static const uint32_t HASH_COUNT;
+
+	/// Bounds on the size of a sketch, also enforced when deserialising
+	static const uint32_t MIN_CELL_COUNT;
+	static const uint32_t MAX_CELL_COUNT;
+
+	explicit RsGxsMsgIdSketch(uint32_t cellCount = MIN_CELL_COUNT);
+
+	/*!
+	 * Number of cells to use for a set of the given size. Most of the time
+	 * only a few messages differ between friends, so this grows slowly with
+	 * the size of the set.
+	 */
+	static uint32_t suggestedCellCount(uint32_t setSize);
+
+	void insert(const RsGxsMessageId& id);
+
+	uint32_t cellCount() const { return static_cast<uint32_t>(mCells.size()); }
+	uint32_t elementCount() const { return mElementCount; }
+
+	/*!
+	 * Subtract the other sketch from this one and decode the difference.
+	 * @param[in] other sketch of the remote set, must have the same size
+	 * @param[out] onlyHere IDs present in this set but not in the other one
+	 * @param[out] onlyThere IDs present in the other set only
+	 * @return false if the sketches are incompatible or if the difference is
+	 *  too large to be decoded. Output sets are left in an unspecified state.
+	 */
+	bool decodeDifference( const RsGxsMsgIdSketch& other,
+	                       std::set<RsGxsMessageId>& onlyHere,
+	                       std::set<RsGxsMessageId>& onlyThere ) const;
+
+	bool serialise(RsTlvBinaryData& data) const;
+	bool deserialise(const RsTlvBinaryData& data);
+
+private:
+	struct Cell
+	{
+		Cell() : count(0), checkSum(0) {}
+
+		int32_t count;
+		RsGxsMessageId idSum;
+		uint32_t checkSum;
+	};
+
+	static const uint8_t  SERIAL_VERSION;
+	static const uint32_t CELL_SERIAL_SIZE;
+
+	static uint64_t mix(uint64_t seed, const RsGxsMessageId& id);
+	static uint32_t checkSumOf(const RsGxsMessageId& id);
+
+	uint32_t cellIndex(uint32_t hash_number, const RsGxsMessageId& id) const;
+	static void xorInto(RsGxsMessageId& dst, const RsGxsMessageId& src);
+
+	std::vector<Cell> mCells;
+	uint32_t mElementCount;
+};
@@ -259,6 +259,7 @@
 #include "util/rsmemory.h"
 #include "util/stacktrace.h"
 #include "util/rsdebug.h"
+#include "util/rsperfstats.h"
 #include "util/cxx17retrocompat.h"
 
 /***
@@ -309,6 +310,9 @@ static const uint32_t GROUP_STATS_UPDATE_NB_PEERS             =            2; //
 static const uint32_t MAX_ALLOWED_GXS_MESSAGE_SIZE            =       199000; // 200,000 bytes including signature and headers
 static const uint32_t MIN_DELAY_BETWEEN_GROUP_SEARCH          =           40; // dont search same group more than every 40 secs.
 static const uint32_t SAFETY_DELAY_FOR_UNSUCCESSFUL_UPDATE    =            0; // avoid re-sending the same msg list to a peer who asks twice for the same update in less than this time
+static const uint32_t MSG_ID_SKETCH_TIME_GRANULARITY          =          600; // requester side sketches are re-computed at most every 10 mins unless new messages arrive
+static const uint32_t MSG_ID_SKETCH_CAPABILITY_TIMEOUT        =          600; // forget that a peer supports msg ID sketches if it did not say so for that long
+static const uint32_t MSG_ID_SKETCH_MIN_MSG_COUNT             =           32; // below this number of messages, the full list is small enough
 
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN             = 0x00 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_NO_ERROR            = 0x01 ;
@@ -380,7 +384,8 @@ RsGxsNetService::RsGxsNetService(uint16_t servType, RsGeneralDataService *gds,
                                    mReputations(reputations), mPgpUtils(pgpUtils), mGxsNetTunnel(mGxsNT),
                                    mSyncFlags(sync_flags),
                                    mServiceInfo(serviceInfo), mDefaultMsgStorePeriod(default_store_period),
-                                   mDefaultMsgSyncPeriod(default_sync_period)
+                                   mDefaultMsgSyncPeriod(default_sync_period),
+                                   mTickPerfCounter(RsPerfStats::counter("RsGxsNetService::threadTick/" + serviceInfo.mServiceName))
 {
 	addSerialType(new RsNxsSerialiser(mServType));
 	mOwnId = mNetMgr->getOwnId();
@@ -409,6 +414,7 @@ void RsGxsNetService::getItemNames(std::map<uint8_t,std::string>& names) const
 	names[RS_PKT_SUBTYPE_NXS_SESSION_KEY_ITEM     ] = "Session Key" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM        ] = "Message Sync" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM    ] = "Message Sync Request" ;
+	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_REQ_ITEM] = "Message Sync Sketch Request" ;
 	names[RS_PKT_SUBTYPE_NXS_MSG_ITEM             ] = "Message Data" ;
 	names[RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         ] = "Transaction" ;
 	names[RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM ] = "Publish key" ;
@@ -650,6 +656,20 @@ std::error_condition RsGxsNetService::checkUpdatesFromPeers(
 	    }
     }
 
+    // Drop cached message ID sketches of groups we don't sync anymore
+
+    for(auto it(mMsgIdSketchCache.begin());it!=mMsgIdSketchCache.end();)
+        if(toRequest.find(it->first) == toRequest.end())
+            it = mMsgIdSketchCache.erase(it) ;
+        else
+            ++it ;
+
+    for(auto it(mMsgIdSketchResponseCache.begin());it!=mMsgIdSketchResponseCache.end();)
+        if(toRequest.find(it->first) == toRequest.end())
+            it = mMsgIdSketchResponseCache.erase(it) ;
+        else
+            ++it ;
+
     // Synchronise group msg for groups which we're subscribed to
     // For each peer and each group, we send to the peer the time stamp of the most
     // recent modification the peer has sent. If the peer has more recent messages he will send them, because its latest
@@ -705,12 +725,6 @@ std::error_condition RsGxsNetService::checkUpdatesFromPeers(
 
             // get sync params for this group
 
-            RsNxsSyncMsgReqItem* msg = new RsNxsSyncMsgReqItem(mServType);
-
-            msg->clear();
-            msg->PeerId(peerId);
-            msg->updateTS = updateTS;
-
             int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
             int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
 
@@ -721,10 +735,49 @@ std::error_condition RsGxsNetService::checkUpdatesFromPeers(
 
             // The last post will be set to TS 0 if the req delay is 0, which means "Indefinitly"
 
+            uint32_t createdSinceTS = 0 ;
+
             if(req_delay > 0)
-				msg->createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
-			else
-				msg->createdSinceTS = 0 ;
+				createdSinceTS = std::max(0,(int)time(NULL) - req_delay);
+
+            // Peers that understand message ID sketches get the sketch of what we already have, so that they only
+            // send back the IDs we miss. Never do that for circle-restricted groups: the request is sent in clear.
+            // Whether the peer has anything new can only be decided on its side, by comparing updateTS with its own
+            // server TS, so the sketch is attached whenever the peer supports it. It is cached, so this costs little.
+
+            RsNxsSyncMsgReqItem* msg = NULL ;
+
+            if(encrypt_to_this_circle_id.isNull() && locked_peerSupportsMsgIdSketch(peerId))
+            {
+                // Round up the time window so that the same sketch can be re-used for a while. This only makes the
+                // window shorter, so we never ask for posts that we would delete right away.
+
+                uint32_t sketchCreatedSinceTS = createdSinceTS ;
+
+                if(sketchCreatedSinceTS > 0 && sketchCreatedSinceTS % MSG_ID_SKETCH_TIME_GRANULARITY > 0)
+                    sketchCreatedSinceTS += MSG_ID_SKETCH_TIME_GRANULARITY - sketchCreatedSinceTS % MSG_ID_SKETCH_TIME_GRANULARITY ;
+
+                RsNxsSyncMsgSketchReqItem *sketch_msg = new RsNxsSyncMsgSketchReqItem(mServType);
+
+                if(locked_getMsgIdSketch(grpId,sketchCreatedSinceTS,sketch_msg->sketch))
+                {
+                    createdSinceTS = sketchCreatedSinceTS ;
+                    msg = sketch_msg ;
+                }
+                else
+                    delete sketch_msg ;
+            }
+
+            if(!msg)
+            {
+                msg = new RsNxsSyncMsgReqItem(mServType);
+                msg->clear();
+            }
+
+            msg->PeerId(peerId);
+            msg->updateTS = updateTS;
+            msg->createdSinceTS = createdSinceTS ;
+            msg->flag |= RsNxsSyncMsgReqItem::FLAG_MSG_ID_SKETCH_SUPPORTED ;
 
             if(encrypt_to_this_circle_id.isNull())
                 msg->grpId = grpId;
@@ -1793,6 +1846,7 @@ void RsGxsNetService::recvNxsItemQueue()
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_STATS_ITEM:    handleRecvSyncGrpStatistics   (dynamic_cast<RsNxsSyncGrpStatsItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_REQ_ITEM:      handleRecvSyncGroup           (dynamic_cast<RsNxsSyncGrpReqItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:      handleRecvSyncMessage         (dynamic_cast<RsNxsSyncMsgReqItem*>(ni),item_was_encrypted) ; break ;
+            case RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_REQ_ITEM: handleRecvSyncMessage       (dynamic_cast<RsNxsSyncMsgReqItem*>(ni),item_was_encrypted) ; break ;
             case RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM:   handleRecvPublishKeys         (dynamic_cast<RsNxsGroupPublishKeyItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_PULL_REQUEST_ITEM: handlePullRequest             (dynamic_cast<RsNxsPullRequestItem*>(ni)) ; break ;
 
@@ -2015,6 +2069,8 @@ void RsGxsNetService::threadTick()
         //Start waiting as nothing to do in runup
         rstime::rs_usleep((int) (timeDelta * 1000 * 1000)); // timeDelta sec
 
+        RsPerfScope perf_scope(mTickPerfCounter,true) ;
+
         if(mUpdateCounter >= 120) // 60 seconds
         {
             updateServerSyncTS();
@@ -4369,6 +4425,9 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     bool grp_is_known = false;
     bool was_circle_protected = item_was_encrypted || bool(item->flag & RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID);
 
+    if(item->flag & RsNxsSyncMsgReqItem::FLAG_MSG_ID_SKETCH_SUPPORTED)
+        mMsgIdSketchCapablePeers[peer] = time(NULL) ;
+
     // This call determines if the peer can receive updates from us, meaning that our last TS is larger than what the peer sent.
     // It also changes the items' group id into the un-hashed group ID if the group is a distant group.
 
@@ -4455,6 +4514,17 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  Sending MSG meta data created since TS=" << item->createdSinceTS << std::endl;
 #endif
 
+    // If the peer told us which messages it already has, only send the ones it misses. If the difference cannot be
+    // computed (e.g. too many differences for the size of the sketch) we fall back to sending the full list.
+
+    std::set<RsGxsMessageId> missing_msg_ids ;
+    const RsNxsSyncMsgSketchReqItem *sketch_item = dynamic_cast<const RsNxsSyncMsgSketchReqItem*>(item) ;
+    bool send_only_missing = sketch_item != NULL && locked_computeMissingMsgIds(*sketch_item,msgMetas,missing_msg_ids) ;
+
+#ifdef NXS_NET_DEBUG_0
+    if(sketch_item)
+        GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  received msg ID sketch. Decoding " << (send_only_missing?"succeeded":"failed") << ": " << missing_msg_ids.size() << " msgs missing at peer." << std::endl;
+#endif
     std::list<RsNxsItem*> itemL;
 
     uint32_t transN = locked_getTransactionId();
@@ -4476,6 +4546,9 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 		{
             const auto& m = *vit;
 
+            if(send_only_missing && missing_msg_ids.find(m->mMsgId) == missing_msg_ids.end())
+                continue ;
+
             // Check reputation
 
             if(!m->mAuthorId.isNull())
@@ -4578,6 +4651,104 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	//     delete *vit;
 }
 
+bool RsGxsNetService::locked_peerSupportsMsgIdSketch(const RsPeerId& pid) const
+{
+    auto it = mMsgIdSketchCapablePeers.find(pid) ;
+
+    return it != mMsgIdSketchCapablePeers.end() && it->second + MSG_ID_SKETCH_CAPABILITY_TIMEOUT > time(NULL) ;
+}
+
+bool RsGxsNetService::locked_getMsgIdSketch(const RsGxsGroupId& grpId, uint32_t createdSinceTS, RsTlvBinaryData& sketch)
+{
+    uint32_t localUpdateTS = 0 ;
+    ServerMsgMap::const_iterator sit = mServerMsgUpdateMap.find(grpId) ;
+
+    if(sit != mServerMsgUpdateMap.end())
+        localUpdateTS = sit->second.msgUpdateTS ;
+
+    auto cit = mMsgIdSketchCache.find(grpId) ;
+
+    if(cit == mMsgIdSketchCache.end() || cit->second.msgUpdateTS != localUpdateTS || cit->second.createdSinceTS != createdSinceTS)
+    {
+        GxsMsgReq req;
+        req[grpId] = std::set<RsGxsMessageId>();
+
+        GxsMsgMetaResult metaResult;
+        mDataStore->retrieveGxsMsgMetaData(req, metaResult);
+
+        std::vector<RsGxsMessageId> ids ;
+
+        for(const auto& m : metaResult[grpId])
+            if(m->mPublishTs >= createdSinceTS)
+                ids.push_back(m->mMsgId) ;
+
+        MsgIdSketchCacheEntry& e(mMsgIdSketchCache[grpId]) ;
+
+        e.msgUpdateTS = localUpdateTS ;
+        e.createdSinceTS = createdSinceTS ;
+        e.usable = ids.size() >= MSG_ID_SKETCH_MIN_MSG_COUNT ;
+        e.sketch = RsGxsMsgIdSketch(RsGxsMsgIdSketch::suggestedCellCount(ids.size())) ;
+
+        if(e.usable)
+            for(const auto& id : ids)
+                e.sketch.insert(id) ;
+
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG__G(grpId) << "  computed msg ID sketch for group " << grpId << ": " << ids.size() << " msgs, " << e.sketch.cellCount() << " cells." << std::endl;
+#endif
+        cit = mMsgIdSketchCache.find(grpId) ;
+    }
+
+    return cit->second.usable && cit->second.sketch.serialise(sketch) ;
+}
+
+bool RsGxsNetService::locked_computeMissingMsgIds( const RsNxsSyncMsgSketchReqItem& item,
+                                                   const std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMetas,
+                                                   std::set<RsGxsMessageId>& missing )
+{
+    RsGxsMsgIdSketch peerSketch ;
+
+    if(!peerSketch.deserialise(item.sketch))
+    {
+        RS_WARN("malformed msg ID sketch from peer ", item.PeerId()) ;
+        return false ;
+    }
+
+    // Must be computed over the same set definition as the requester: all messages published after createdSinceTS.
+    // Requesters round createdSinceTS, so the sketch of the group can usually be re-used until its messages change.
+    // The message count catches changes that happen within the same second as the server TS, and deletions.
+
+    uint32_t localUpdateTS = 0 ;
+    ServerMsgMap::const_iterator sit = mServerMsgUpdateMap.find(item.grpId) ;
+
+    if(sit != mServerMsgUpdateMap.end())
+        localUpdateTS = sit->second.msgUpdateTS ;
+
+    MsgIdSketchCacheEntry& e(mMsgIdSketchResponseCache[item.grpId]) ;
+
+    if(e.msgUpdateTS != localUpdateTS || e.createdSinceTS != item.createdSinceTS || e.msgCount != msgMetas.size()
+            || e.sketch.cellCount() != peerSketch.cellCount())
+    {
+        e.msgUpdateTS = localUpdateTS ;
+        e.createdSinceTS = item.createdSinceTS ;
+        e.msgCount = msgMetas.size() ;
+        e.usable = true ;
+        e.sketch = RsGxsMsgIdSketch(peerSketch.cellCount()) ;
+
+        for(const auto& m : msgMetas)
+            if(m->mPublishTs >= item.createdSinceTS)
+                e.sketch.insert(m->mMsgId) ;
+
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG_PG(item.PeerId(),item.grpId) << "  computed own msg ID sketch for group " << item.grpId << ": " << e.sketch.cellCount() << " cells." << std::endl;
+#endif
+    }
+
+    std::set<RsGxsMessageId> onlyAtPeer ;
+
+    return e.sketch.decodeDifference(peerSketch,missing,onlyAtPeer) ;
+}
+
 void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId& grp_id,const uint32_t& transN)
 {
 #ifdef NXS_NET_DEBUG_1
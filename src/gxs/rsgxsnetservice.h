@@ -34,6 +34,7 @@
 #include "rsitems/rsgxsupdateitems.h"
 #include "rsgxsnettunnel.h"
 #include "rsgxsnetutils.h"
+#include "rsgxsmsgsketch.h"
 #include "pqi/p3cfgmgr.h"
 #include "rsgixs.h"
 
@@ -57,6 +58,7 @@ typedef std::map<uint32_t, NxsTransaction*> TransactionIdMap;
 typedef std::map<RsPeerId, TransactionIdMap > TransactionsPeerMap;
 
 class PgpAuxUtils;
+class RsPerfCounter;
 
 class RsGroupNetworkStatsRecord
 {
@@ -508,6 +510,19 @@ private:
     bool locked_CanReceiveUpdate(const RsNxsSyncGrpReqItem *item);
     bool locked_CanReceiveUpdate(RsNxsSyncMsgReqItem *item, bool &grp_is_known);
 	void locked_resetClientTS(const RsGxsGroupId& grpId);
+
+    /*!
+     * Message ID set reconciliation. Peers advertise support through
+     * RsNxsSyncMsgReqItem::FLAG_MSG_ID_SKETCH_SUPPORTED, in which case we send
+     * them a sketch of our own message IDs and they only answer with the
+     * messages we miss.
+     */
+    bool locked_peerSupportsMsgIdSketch(const RsPeerId& pid) const;
+    bool locked_getMsgIdSketch(const RsGxsGroupId& grpId, uint32_t createdSinceTS, RsTlvBinaryData& sketch);
+    bool locked_computeMissingMsgIds( const RsNxsSyncMsgSketchReqItem& item,
+                                      const std::vector<std::shared_ptr<RsGxsMsgMetaData> >& msgMetas,
+                                      std::set<RsGxsMessageId>& missing );
+
 	bool locked_checkResendingOfUpdates(const RsPeerId& pid, const RsGxsGroupId &grpId, rstime_t incoming_ts, RsPeerUpdateTsRecord& rec);
 
     static RsGxsGroupId hashGrpId(const RsGxsGroupId& gid,const RsPeerId& pid) ;
@@ -650,6 +665,21 @@ private:
 	std::map<RsPeerId, std::set<RsGxsGroupId> > mExplicitRequest;
     std::map<RsPeerId, std::set<RsGxsGroupId> > mPartialMsgUpdates ;
 
+    struct MsgIdSketchCacheEntry
+    {
+        MsgIdSketchCacheEntry() : msgUpdateTS(0), createdSinceTS(0), msgCount(0), usable(false) {}
+
+        uint32_t msgUpdateTS;		// local server TS of the group when the sketch was computed
+        uint32_t createdSinceTS;
+        size_t msgCount;		// number of messages in the group, only used for the sketches we answer with
+        bool usable;			// false when the group is too small for a sketch to be worth it
+        RsGxsMsgIdSketch sketch;
+    };
+
+    std::map<RsPeerId, rstime_t> mMsgIdSketchCapablePeers ;	// last time each peer advertised sketch support
+    std::map<RsGxsGroupId, MsgIdSketchCacheEntry> mMsgIdSketchCache ;		// sketches we send in our requests
+    std::map<RsGxsGroupId, MsgIdSketchCacheEntry> mMsgIdSketchResponseCache ;	// sketches we decode peer requests against
+
     // nxs sync optimisation
     // can pull dynamically the latest timestamp for each message
 
@@ -685,6 +715,8 @@ private:
 	uint32_t mDefaultMsgStorePeriod ;
 	uint32_t mDefaultMsgSyncPeriod ;
 
+	RsPerfCounter& mTickPerfCounter ;	// duration and CPU time of threadTick(), named after the service
+
     std::map<Sha1CheckSum, RsNxsGrp*> mGroupHashCache;
     std::map<TurtleRequestId,RsGxsGroupId> mSearchRequests;
     std::map<RsGxsGroupId,GroupRequestRecord> mSearchedGroups ;
@@ -48,6 +48,8 @@ file_lists {
 			file_sharing/directory_updater.h \
 			file_sharing/rsfilelistitems.h \
 			file_sharing/dir_hierarchy.h \
+			file_sharing/filename_index.h \
+			file_sharing/mapped_hierarchy.h \
 			file_sharing/file_sharing_defaults.h
 
 	SOURCES *= file_sharing/p3filelists.cc \
@@ -56,6 +58,8 @@ file_lists {
 			file_sharing/directory_storage.cc \
 			file_sharing/directory_updater.cc \
 			file_sharing/dir_hierarchy.cc \
+			file_sharing/filename_index.cc \
+			file_sharing/mapped_hierarchy.cc \
 			file_sharing/file_tree.cc \
 			file_sharing/rsfilelistitems.cc
 }
@@ -86,6 +90,7 @@ SOURCES +=	dht/p3bitdht.cc  \
 
 HEADERS +=	tcponudp/udppeer.h \
 		tcponudp/bio_tou.h \
+		tcponudp/tcpcongestion.h \
 		tcponudp/tcppacket.h \
 		tcponudp/tcpstream.h \
 		tcponudp/tou.h \
@@ -94,6 +99,7 @@ HEADERS +=	tcponudp/udppeer.h \
 		pqi/pqissludp.h \
 
 SOURCES +=	tcponudp/udppeer.cc \
+		tcponudp/tcpcongestion.cc \
 		tcponudp/tcppacket.cc \
 		tcponudp/tcpstream.cc \
 		tcponudp/tou.cc \
@@ -332,7 +338,9 @@ LIBS *= $${OPENPGPSDK_DIR}/lib/libops.a -lbz2
 
 ################################### HEADERS & SOURCES #############################
 
-HEADERS +=	ft/ftchunkmap.h \
+HEADERS +=	ft/ftchunkbitset.h \
+			ft/ftchunkmap.h \
+			ft/ftchunkverifier.h \
 			ft/ftcontroller.h \
 			ft/ftdata.h \
 			ft/ftdatamultiplex.h \
@@ -369,12 +377,14 @@ HEADERS +=	pqi/authssl.h \
 			pgp/rscertificate.h \
 			pgp/pgpauxutils.h \
 			pqi/p3cfgmgr.h \
+			pqi/p3cfgjournal.h \
 			pqi/p3peermgr.h \
 			pqi/p3linkmgr.h \
 			pqi/p3netmgr.h \
 			pqi/p3notify.h \
 			pqi/p3upnpmgr.h \
 			pqi/pqiqos.h \
+			pqi/pqibwscheduler.h \
 			pqi/pqi.h \
 			pqi/pqi_base.h \
 			pqi/pqiassist.h \
@@ -382,6 +392,7 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqihandler.h \
 			pqi/pqihash.h \
 			pqi/p3historymgr.h \
+			pqi/p3historystore.h \
 			pqi/pqiindic.h \
 			pqi/pqiipset.h \
 			pqi/pqilistener.h \
@@ -400,6 +411,7 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqistore.h \
 			pqi/pqistreamer.h \
 			pqi/pqithreadstreamer.h \
+			pqi/pqireactor.h \
 			pqi/pqiqosstreamer.h \
 			pqi/sslfns.h \
 			pqi/pqinetstatebox.h \
@@ -504,6 +516,8 @@ HEADERS +=	util/folderiterator.h \
 			util/rswin.h \
 			util/rsrandom.h \
 			util/rsmemcache.h \
+			util/rsmpscring.h \
+			util/rsperfstats.h \
 			util/rstickevent.h \
 			util/rsrecogn.h \
 			util/rstime.h \
@@ -516,7 +530,9 @@ HEADERS +=	util/folderiterator.h \
     util/rsurl.h \
     util/rsmacrosugar.hpp
 
-SOURCES +=	ft/ftchunkmap.cc \
+SOURCES +=	ft/ftchunkbitset.cc \
+			ft/ftchunkmap.cc \
+			ft/ftchunkverifier.cc \
 			ft/ftcontroller.cc \
 			ft/ftdatamultiplex.cc \
 			ft/ftextralist.cc \
@@ -546,6 +562,7 @@ SOURCES +=	pqi/authgpg.cc \
 			pgp/rscertificate.cc \
 			pgp/pgpauxutils.cc \
 			pqi/p3cfgmgr.cc \
+			pqi/p3cfgjournal.cc \
 			pqi/p3peermgr.cc \
 			pqi/p3linkmgr.cc \
 			pqi/pqifdbin.cc \
@@ -553,9 +570,11 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/p3netmgr.cc \
 			pqi/p3notify.cc \
 			pqi/pqiqos.cc \
+			pqi/pqibwscheduler.cc \
 			pqi/pqibin.cc \
 			pqi/pqihandler.cc \
 			pqi/p3historymgr.cc \
+			pqi/p3historystore.cc \
 			pqi/pqiipset.cc \
 			pqi/pqiloopback.cc \
 			pqi/pqimonitor.cc \
@@ -571,6 +590,7 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/pqistore.cc \
 			pqi/pqistreamer.cc \
 			pqi/pqithreadstreamer.cc \
+			pqi/pqireactor.cc \
 			pqi/pqiqosstreamer.cc \
 			pqi/sslfns.cc \
 			pqi/pqinetstatebox.cc \
@@ -653,6 +673,7 @@ SOURCES +=	util/folderiterator.cc \
 			util/rsprint.cc \
 			util/rsstring.cc \
 			util/rsthreads.cc \
+			util/rsperfstats.cc \
 			util/rsrandom.cc \
 			util/rstickevent.cc \
 			util/rsrecogn.cc \
@@ -692,6 +713,8 @@ HEADERS += rsitems/rsnxsitems.h \
 	gxs/rsgxsutil.h \
 	gxs/rsgxsnotify.h \
 	gxs/gxssecurity.h \
+	gxs/gxsvalidationpool.h \
+	gxs/gxsrequestpool.h \
 	gxs/rsgds.h \
 	gxs/rsgxs.h \
 	gxs/rsdataservice.h \
@@ -704,6 +727,7 @@ HEADERS += rsitems/rsnxsitems.h \
 	gxs/rsgxsdataaccess.h \
 	gxs/gxstokenqueue.h \
 	gxs/rsgxsnetutils.h \
+	gxs/rsgxsmsgsketch.h \
 	gxs/rsgxsrequesttypes.h
 
 
@@ -713,6 +737,8 @@ SOURCES += rsitems/rsnxsitems.cc \
 	util/contentvalue.cc \
 	util/rsdbbind.cc \
 	gxs/gxssecurity.cc \
+	gxs/gxsvalidationpool.cc \
+	gxs/gxsrequestpool.cc \
 	gxs/rsgxsdataaccess.cc \
 	gxs/rsdataservice.cc \
 	gxs/rsgenexchange.cc \
@@ -721,6 +747,7 @@ SOURCES += rsitems/rsnxsitems.cc \
 	gxs/rsgxsdata.cc \
 	gxs/gxstokenqueue.cc \
 	gxs/rsgxsnetutils.cc \
+	gxs/rsgxsmsgsketch.cc \
 	gxs/rsgxsutil.cc \
         gxs/rsgxsrequesttypes.cc \
         gxs/rsnxsobserver.cpp
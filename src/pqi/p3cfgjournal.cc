@@ -0,0 +1,578 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3cfgjournal.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <string.h>
+
+#include "pqi/p3cfgjournal.h"
+#include "pqi/authssl.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsdebug.h"
+#include "util/rsdir.h"
+#include "util/rsprint.h"
+#include "util/rsrandom.h"
+
+/*
+#define JOURNAL_DEBUG 1
+*/
+
+/* file layout:
+ *   header:  "RSJ1" | snapshot hash | uint64 journal id | uint64 first seqno
+ *            | uint32 len | sealed key | uint32 len | signature
+ *   records: uint32 len | encrypted chunk of (uint64 journal id | uint64 seqno | serialised items)
+ */
+static const uint8_t  JOURNAL_MAGIC[4] = { 'R', 'S', 'J', '1' };
+static const uint32_t JOURNAL_MAX_SEALED_KEY_SIZE = 4096;
+static const uint32_t JOURNAL_MAX_SIGNATURE_SIZE  = 4096;
+static const uint32_t JOURNAL_MAX_RECORD_SIZE     = 64 * 1024 * 1024;
+static const uint32_t JOURNAL_RECORD_HEADER_SIZE  = 16;
+
+const uint64_t p3ConfigJournal::MIN_COMPACTION_SIZE = 64 * 1024;
+
+p3ConfigJournal::p3ConfigJournal(const std::string& fname) :
+    mJournalMtx("p3ConfigJournal"), mFilename(fname), mFile(NULL),
+    mValid(false), mFailed(false), mSnapshotSize(0), mHaveKey(false),
+    mJournalId(0), mFirstSeq(0), mHeaderSize(0), mSize(0), mNextSeq(0),
+    mGeneration(0)
+{
+	memset(mKey, 0, sizeof(mKey));
+}
+
+p3ConfigJournal::~p3ConfigJournal()
+{
+	RS_STACK_MUTEX(mJournalMtx);
+	locked_close();
+	memset(mKey, 0, sizeof(mKey));
+}
+
+bool p3ConfigJournal::load( const RsFileHash& snapshotHash, uint64_t snapshotSize,
+                            std::list<std::vector<uint8_t> >& records )
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	locked_close();
+	mValid = false;
+	mFailed = false;
+	mSnapshotHash = snapshotHash;
+	mSnapshotSize = snapshotSize;
+
+	// The "_new" file is there if a crash happened while the journal was
+	// rewritten for a new snapshot. It is the one to use if that snapshot got
+	// installed.
+
+	const std::string candidates[2] = { mFilename, mFilename + "_new" };
+
+	for(const std::string& fname : candidates)
+	{
+		std::vector<uint8_t> content;
+		uint32_t headerSize;
+		uint64_t journalId;
+		uint64_t firstSeq;
+
+		if(!locked_loadFile(fname, snapshotHash, content, headerSize, journalId, firstSeq))
+			continue;
+
+		uint64_t validSize;
+		uint64_t nextSeq;
+		records.clear();
+		locked_readRecords(content, headerSize, journalId, firstSeq, records, validSize, nextSeq);
+
+		mJournalId = journalId;
+		mFirstSeq = firstSeq;
+		mNextSeq = nextSeq;
+
+		if(fname != mFilename || validSize < content.size())
+		{
+			RS_INFO("restoring ", mFilename, " (", content.size() - validSize, " bytes dropped)");
+
+			// Under a new id, as the sequence numbers of the dropped records
+			// are going to be used again.
+			std::string tmpFname = mFilename + "_new";
+			uint64_t newJournalId = RSRandom::random_u64();
+
+			if( !locked_writeFile( tmpFname, snapshotHash, newJournalId, firstSeq,
+			                       records, headerSize, validSize ) ||
+			    !RsDirUtil::renameFile(tmpFname, mFilename) )
+			{
+				RS_ERR("cannot rewrite ", mFilename);
+				mFailed = true;
+				return true;
+			}
+
+			mJournalId = newJournalId;
+		}
+
+		mHeaderSize = headerSize;
+		mSize = validSize;
+		mValid = locked_open();
+
+#ifdef JOURNAL_DEBUG
+		std::cerr << "p3ConfigJournal::load() " << mFilename << " "
+		          << records.size() << " records" << std::endl;
+#endif
+		return true;
+	}
+
+	return false;
+}
+
+bool p3ConfigJournal::append(const uint8_t *data, uint32_t size)
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	if(mFailed)
+		return false;
+
+	if(!mValid)
+	{
+		// first change since the snapshot: start a journal following it
+		std::string tmpFname = mFilename + "_new";
+		uint64_t journalId = RSRandom::random_u64();
+		uint32_t headerSize;
+		uint64_t fileSize;
+
+		if( !locked_writeFile( tmpFname, mSnapshotHash, journalId, mNextSeq,
+		                       std::list<std::vector<uint8_t> >(), headerSize, fileSize ) ||
+		    !RsDirUtil::renameFile(tmpFname, mFilename) || !locked_open() )
+		{
+			RS_ERR("cannot create ", mFilename);
+			locked_close();
+			return false;
+		}
+
+		mJournalId = journalId;
+		mFirstSeq = mNextSeq;
+		mHeaderSize = headerSize;
+		mSize = fileSize;
+		mValid = true;
+	}
+
+	std::vector<uint8_t> record;
+
+	if( !locked_makeRecord(mJournalId, mNextSeq, data, size, record) ||
+	    fwrite(record.data(), 1, record.size(), mFile) != record.size() ||
+	    fflush(mFile) != 0 )
+	{
+		// The end of the file is unknown now. Appending more would be lost
+		// at load time, so wait for the next snapshot to start over.
+		RS_ERR("cannot write to ", mFilename);
+		mFailed = true;
+		return false;
+	}
+
+	mSize += record.size();
+	++mNextSeq;
+
+	return true;
+}
+
+p3ConfigJournal::Mark p3ConfigJournal::mark()
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	Mark m;
+	m.generation = mGeneration;
+	m.offset = mValid ? mSize : 0;
+	m.seq = mNextSeq;
+
+	return m;
+}
+
+bool p3ConfigJournal::rotate( const RsFileHash& snapshotHash, uint64_t snapshotSize,
+                              const Mark& mark, const std::function<bool()>& installSnapshot )
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	// Records appended since the mark may have been missed by the snapshot.
+
+	std::list<std::vector<uint8_t> > tail;
+	uint64_t tailSeq = mNextSeq;
+
+	if(mValid)
+	{
+		uint64_t from = mHeaderSize;
+		tailSeq = mFirstSeq;
+
+		if(mark.generation == mGeneration && mark.offset > mHeaderSize)
+		{
+			from = mark.offset;
+			tailSeq = mark.seq;
+		}
+
+		std::vector<uint8_t> content;
+		FILE *f = RsDirUtil::rs_fopen(mFilename.c_str(), "rb");
+
+		if(f && mSize > from && fseek(f, from, SEEK_SET) == 0)
+		{
+			content.resize(mSize - from);
+			content.resize(fread(content.data(), 1, content.size(), f));
+		}
+		if(f)
+			fclose(f);
+
+		// stops before what a failed append may have left
+		uint64_t validSize;
+		uint64_t nextSeq;
+		locked_readRecords(content, 0, mJournalId, tailSeq, tail, validSize, nextSeq);
+	}
+
+	// The records are encrypted again, for the new journal.
+
+	std::string tmpFname = mFilename + "_new";
+	uint64_t journalId = RSRandom::random_u64();
+	uint32_t headerSize = 0;
+	uint64_t fileSize = 0;
+	bool journalWritten = !tail.empty() &&
+	        locked_writeFile(tmpFname, snapshotHash, journalId, tailSeq, tail, headerSize, fileSize);
+
+	if(!tail.empty() && !journalWritten)
+	{
+		RS_ERR("cannot write ", tmpFname, ", the last changes may be lost");
+		RsDirUtil::removeFile(tmpFname);
+	}
+
+	if(!installSnapshot())
+	{
+		if(journalWritten)
+			RsDirUtil::removeFile(tmpFname);
+
+		return false;
+	}
+
+	locked_close();
+
+	mSnapshotHash = snapshotHash;
+	mSnapshotSize = snapshotSize;
+	mFailed = false;
+	mValid = false;
+	++mGeneration;
+
+	// With no journal, the next append starts one. A journal left on disk
+	// does not follow the new snapshot, and is ignored at load time.
+
+	if(journalWritten && RsDirUtil::renameFile(tmpFname, mFilename))
+	{
+		mJournalId = journalId;
+		mFirstSeq = tailSeq;
+		mHeaderSize = headerSize;
+		mSize = fileSize;
+		mValid = locked_open();
+	}
+
+	return true;
+}
+
+bool p3ConfigJournal::needsCompaction()
+{
+	RS_STACK_MUTEX(mJournalMtx);
+
+	if(!mValid)
+		return mFailed;
+
+	return mSize - mHeaderSize > std::max(MIN_COMPACTION_SIZE, mSnapshotSize);
+}
+
+bool p3ConfigJournal::signHeader(const uint8_t *data, uint32_t size, std::string& signature)
+{
+	return AuthSSL::getAuthSSL()->SignData(data, size, signature);
+}
+
+bool p3ConfigJournal::verifyHeader( const uint8_t *data, uint32_t size,
+                                    uint8_t *signature, uint32_t signatureSize )
+{
+	return AuthSSL::getAuthSSL()->VerifyOwnSignBin(data, size, signature, signatureSize);
+}
+
+bool p3ConfigJournal::sealKey(const uint8_t *key, uint32_t size, std::vector<uint8_t>& sealedKey)
+{
+	void *out = NULL;
+	int outSize = 0;
+
+	if(!AuthSSL::getAuthSSL()->encrypt(out, outSize, key, size, AuthSSL::getAuthSSL()->OwnId()))
+	{
+		free(out);
+		return false;
+	}
+
+	sealedKey.assign((uint8_t*)out, (uint8_t*)out + outSize);
+	free(out);
+
+	return true;
+}
+
+bool p3ConfigJournal::unsealKey(const uint8_t *sealedKey, uint32_t size, std::vector<uint8_t>& key)
+{
+	void *out = NULL;
+	int outSize = 0;
+
+	if(!AuthSSL::getAuthSSL()->decrypt(out, outSize, sealedKey, size))
+	{
+		free(out);
+		return false;
+	}
+
+	key.assign((uint8_t*)out, (uint8_t*)out + outSize);
+	memset(out, 0, outSize);
+	free(out);
+
+	return true;
+}
+
+bool p3ConfigJournal::locked_loadFile( const std::string& fname, const RsFileHash& snapshotHash,
+                                       std::vector<uint8_t>& content, uint32_t& headerSize,
+                                       uint64_t& journalId, uint64_t& firstSeq )
+{
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(), "rb");
+
+	if(!f)
+		return false;
+
+	uint8_t buf[4096];
+	size_t n;
+
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		content.insert(content.end(), buf, buf + n);
+
+	fclose(f);
+
+	uint32_t size = content.size();
+	uint32_t offset = sizeof(JOURNAL_MAGIC) + RsFileHash::SIZE_IN_BYTES;
+	uint32_t sealedKeySize;
+	uint32_t signatureSize;
+
+	if( size < offset || memcmp(content.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) ||
+	    RsFileHash(content.data() + sizeof(JOURNAL_MAGIC)) != snapshotHash )
+		return false;
+
+	if( !getRawUInt64(content.data(), size, &offset, &journalId) ||
+	    !getRawUInt64(content.data(), size, &offset, &firstSeq) )
+		return false;
+
+	if( !getRawUInt32(content.data(), size, &offset, &sealedKeySize) ||
+	    sealedKeySize > JOURNAL_MAX_SEALED_KEY_SIZE || offset + sealedKeySize > size )
+		return false;
+
+	const uint8_t *sealedKey = content.data() + offset;
+	offset += sealedKeySize;
+	uint32_t signedSize = offset;
+
+	if( !getRawUInt32(content.data(), size, &offset, &signatureSize) ||
+	    signatureSize > JOURNAL_MAX_SIGNATURE_SIZE || offset + signatureSize > size )
+		return false;
+
+	std::vector<uint8_t> signature(signatureSize / 2);
+
+	if( !RsUtil::HexToBin( std::string((const char*)content.data() + offset, signatureSize),
+	                       signature.data(), signature.size() ) ||
+	    !verifyHeader(content.data(), signedSize, signature.data(), signature.size()) )
+	{
+		RS_ERR("wrong signature for ", fname);
+		return false;
+	}
+
+	headerSize = offset + signatureSize;
+
+	std::vector<uint8_t> key;
+
+	if(!unsealKey(sealedKey, sealedKeySize, key) || key.size() != sizeof(mKey))
+	{
+		RS_ERR("cannot decrypt the key of ", fname);
+		return false;
+	}
+
+	memcpy(mKey, key.data(), sizeof(mKey));
+	memset(key.data(), 0, key.size());
+
+	mSealedKey.assign(sealedKey, sealedKey + sealedKeySize);
+	mEncryption = librs::crypto::EncryptionContext(mKey);
+	mHaveKey = true;
+
+	return true;
+}
+
+bool p3ConfigJournal::locked_readRecords( const std::vector<uint8_t>& content, uint64_t from,
+                                          uint64_t journalId, uint64_t firstSeq,
+                                          std::list<std::vector<uint8_t> >& records,
+                                          uint64_t& validSize, uint64_t& nextSeq )
+{
+	uint64_t offset = from;
+	nextSeq = firstSeq;
+
+	// Stops at the first record that is incomplete, does not authenticate,
+	// belongs to another journal or does not follow the previous one.
+
+	while(offset + 4 <= content.size())
+	{
+		uint32_t chunkSize;
+		uint32_t o = 0;
+		getRawUInt32(content.data() + offset, 4, &o, &chunkSize);
+
+		if(chunkSize > JOURNAL_MAX_RECORD_SIZE || offset + 4 + chunkSize > content.size())
+			break;
+
+		std::vector<uint8_t> chunk( content.begin() + offset + 4,
+		                            content.begin() + offset + 4 + chunkSize );
+		uint32_t clearOffset;
+		uint32_t clearSize;
+		uint64_t recordJournalId;
+		uint64_t seq;
+
+		if( !mEncryption.decryptInPlace(chunk.data(), chunk.size(), clearOffset, clearSize) ||
+		    clearSize < JOURNAL_RECORD_HEADER_SIZE )
+			break;
+
+		o = 0;
+		getRawUInt64(chunk.data() + clearOffset, JOURNAL_RECORD_HEADER_SIZE, &o, &recordJournalId);
+		getRawUInt64(chunk.data() + clearOffset, JOURNAL_RECORD_HEADER_SIZE, &o, &seq);
+
+		if(recordJournalId != journalId || seq != nextSeq)
+			break;
+
+		records.push_back( std::vector<uint8_t>( chunk.begin() + clearOffset + JOURNAL_RECORD_HEADER_SIZE,
+		                                         chunk.begin() + clearOffset + clearSize ) );
+		++nextSeq;
+		offset += 4 + chunkSize;
+	}
+
+	validSize = offset;
+	return offset == content.size();
+}
+
+bool p3ConfigJournal::locked_writeFile( const std::string& fname, const RsFileHash& snapshotHash,
+                                        uint64_t journalId, uint64_t firstSeq,
+                                        const std::list<std::vector<uint8_t> >& records,
+                                        uint32_t& headerSize, uint64_t& size )
+{
+	std::vector<uint8_t> header;
+
+	if(!locked_makeHeader(snapshotHash, journalId, firstSeq, header))
+		return false;
+
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(), "wb");
+
+	if(!f)
+		return false;
+
+	bool ok = fwrite(header.data(), 1, header.size(), f) == header.size();
+
+	headerSize = header.size();
+	size = header.size();
+
+	uint64_t seq = firstSeq;
+	std::vector<uint8_t> record;
+
+	for(auto it = records.begin(); ok && it != records.end(); ++it)
+	{
+		ok = locked_makeRecord(journalId, seq++, it->data(), it->size(), record) &&
+		     fwrite(record.data(), 1, record.size(), f) == record.size();
+		size += record.size();
+	}
+
+	ok = (fflush(f) == 0) && ok;
+	ok = (fclose(f) == 0) && ok;
+
+	return ok;
+}
+
+bool p3ConfigJournal::locked_makeHeader( const RsFileHash& snapshotHash, uint64_t journalId,
+                                         uint64_t firstSeq, std::vector<uint8_t>& header )
+{
+	if(!locked_setupKey())
+		return false;
+
+	uint32_t signedSize = sizeof(JOURNAL_MAGIC) + RsFileHash::SIZE_IN_BYTES + 8 + 8 + 4 + mSealedKey.size();
+	header.resize(signedSize);
+
+	uint32_t offset = 0;
+	memcpy(header.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+	offset += sizeof(JOURNAL_MAGIC);
+	memcpy(header.data() + offset, snapshotHash.toByteArray(), RsFileHash::SIZE_IN_BYTES);
+	offset += RsFileHash::SIZE_IN_BYTES;
+	setRawUInt64(header.data(), signedSize, &offset, journalId);
+	setRawUInt64(header.data(), signedSize, &offset, firstSeq);
+	setRawUInt32(header.data(), signedSize, &offset, mSealedKey.size());
+	memcpy(header.data() + offset, mSealedKey.data(), mSealedKey.size());
+
+	std::string signature;
+
+	if(!signHeader(header.data(), signedSize, signature))
+		return false;
+
+	header.resize(signedSize + 4);
+	offset = signedSize;
+	setRawUInt32(header.data(), header.size(), &offset, signature.size());
+	header.insert(header.end(), signature.begin(), signature.end());
+
+	return true;
+}
+
+bool p3ConfigJournal::locked_makeRecord( uint64_t journalId, uint64_t seq, const uint8_t *data,
+                                         uint32_t size, std::vector<uint8_t>& record )
+{
+	uint32_t clearSize = JOURNAL_RECORD_HEADER_SIZE + size;
+	uint32_t chunkSize = librs::crypto::EncryptionContext::encryptedSize(clearSize);
+	record.resize(4 + chunkSize);
+
+	uint32_t offset = 0;
+	setRawUInt32(record.data(), 4, &offset, chunkSize);
+
+	uint8_t *clear = record.data() + 4 + librs::crypto::EncryptionContext::CLEAR_DATA_OFFSET;
+	offset = 0;
+	setRawUInt64(clear, JOURNAL_RECORD_HEADER_SIZE, &offset, journalId);
+	setRawUInt64(clear, JOURNAL_RECORD_HEADER_SIZE, &offset, seq);
+	memcpy(clear + JOURNAL_RECORD_HEADER_SIZE, data, size);
+
+	return mEncryption.encryptInPlace(record.data() + 4, clearSize);
+}
+
+bool p3ConfigJournal::locked_setupKey()
+{
+	if(mHaveKey)
+		return true;
+
+	RSRandom::random_bytes(mKey, sizeof(mKey));
+
+	if(!sealKey(mKey, sizeof(mKey), mSealedKey))
+	{
+		RS_ERR("cannot seal the journal key");
+		return false;
+	}
+
+	mEncryption = librs::crypto::EncryptionContext(mKey);
+	mHaveKey = true;
+
+	return true;
+}
+
+bool p3ConfigJournal::locked_open()
+{
+	mFile = RsDirUtil::rs_fopen(mFilename.c_str(), "ab");
+	return mFile != NULL;
+}
+
+void p3ConfigJournal::locked_close()
+{
+	if(mFile)
+		fclose(mFile);
+
+	mFile = NULL;
+}
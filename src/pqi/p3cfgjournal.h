@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3cfgjournal.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <functional>
+#include <list>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "crypto/rscrypto.h"
+#include "retroshare/rstypes.h"
+#include "util/rsthreads.h"
+
+/*!
+ * Append-only journal of configuration changes, kept next to a configuration
+ * file (the snapshot) and replayed on top of it when loading.
+ *
+ * The journal starts with a header signed with the node's SSL key. It holds
+ * the hash of the snapshot it follows, a random id, the sequence number of the
+ * first record and a random key sealed with the node's public key. Each record
+ * is then encrypted and authenticated on its own with that key, together with
+ * the journal id and its sequence number, so that records cannot be altered,
+ * reordered, dropped from the start or moved to another journal.
+ * A crash while appending leaves at most one incomplete record at the end,
+ * which is dropped at load time.
+ *
+ * When a new snapshot is saved, the journal is rewritten to follow it, with the
+ * records that the snapshot may miss. The new journal is written before the
+ * snapshot is installed, so that after a crash the journal matching whichever
+ * snapshot is on disk can be found.
+ */
+class p3ConfigJournal
+{
+public:
+	/// position in the journal, see rotate()
+	struct Mark
+	{
+		Mark() : generation(0), offset(0), seq(0) {}
+
+		uint32_t generation;
+		uint64_t offset;
+		uint64_t seq;      /// of the record at offset
+	};
+
+	explicit p3ConfigJournal(const std::string& fname);
+	virtual ~p3ConfigJournal();
+
+	/*!
+	 * Reads the records that follow a snapshot, oldest first.
+	 * @param snapshotHash hash of the snapshot that was loaded, null if none
+	 * @param snapshotSize size of that snapshot, see needsCompaction()
+	 * @param records clear content of the records
+	 * @return false if no journal follows this snapshot
+	 */
+	bool load( const RsFileHash& snapshotHash, uint64_t snapshotSize,
+	           std::list<std::vector<uint8_t> >& records );
+
+	/// appends a record, and flushes it to the file.
+	bool append(const uint8_t *data, uint32_t size);
+
+	/// to be taken before the state is read for a new snapshot
+	Mark mark();
+
+	/*!
+	 * Makes the journal follow a new snapshot. Records appended after mark
+	 * are kept, as the snapshot may or may not contain them.
+	 * @param installSnapshot puts the new snapshot files in place. It is
+	 *   called once the new journal is written, with appends blocked.
+	 * @return false if the snapshot could not be installed
+	 */
+	bool rotate( const RsFileHash& snapshotHash, uint64_t snapshotSize,
+	             const Mark& mark, const std::function<bool()>& installSnapshot );
+
+	/// true once the records take more room than the snapshot
+	bool needsCompaction();
+
+	static const uint64_t MIN_COMPACTION_SIZE;
+
+protected:
+	/* Header signature and key sealing, with the node's SSL key. */
+	virtual bool signHeader(const uint8_t *data, uint32_t size, std::string& signature);
+	virtual bool verifyHeader( const uint8_t *data, uint32_t size,
+	                           uint8_t *signature, uint32_t signatureSize );
+	virtual bool sealKey(const uint8_t *key, uint32_t size, std::vector<uint8_t>& sealedKey);
+	virtual bool unsealKey(const uint8_t *sealedKey, uint32_t size, std::vector<uint8_t>& key);
+
+private:
+	bool locked_loadFile( const std::string& fname, const RsFileHash& snapshotHash,
+	                      std::vector<uint8_t>& content, uint32_t& headerSize,
+	                      uint64_t& journalId, uint64_t& firstSeq );
+	bool locked_readRecords( const std::vector<uint8_t>& content, uint64_t from,
+	                         uint64_t journalId, uint64_t firstSeq,
+	                         std::list<std::vector<uint8_t> >& records,
+	                         uint64_t& validSize, uint64_t& nextSeq );
+	bool locked_writeFile( const std::string& fname, const RsFileHash& snapshotHash,
+	                       uint64_t journalId, uint64_t firstSeq,
+	                       const std::list<std::vector<uint8_t> >& records,
+	                       uint32_t& headerSize, uint64_t& size );
+	bool locked_makeHeader( const RsFileHash& snapshotHash, uint64_t journalId,
+	                        uint64_t firstSeq, std::vector<uint8_t>& header );
+	bool locked_makeRecord( uint64_t journalId, uint64_t seq, const uint8_t *data,
+	                        uint32_t size, std::vector<uint8_t>& record );
+	bool locked_setupKey();
+	bool locked_open();
+	void locked_close();
+
+	RsMutex mJournalMtx;
+
+	std::string mFilename;
+	FILE *mFile;                   /// open for appending, if valid
+
+	bool mValid;                   /// file on disk follows mSnapshotHash
+	bool mFailed;                  /// a write failed, wait for the next rotation
+	RsFileHash mSnapshotHash;
+	uint64_t mSnapshotSize;
+
+	bool mHaveKey;
+	uint8_t mKey[32];
+	std::vector<uint8_t> mSealedKey;
+	librs::crypto::EncryptionContext mEncryption;
+
+	uint64_t mJournalId;           /// of the file on disk, if valid
+	uint64_t mFirstSeq;            /// of the first record in the file on disk
+	uint32_t mHeaderSize;
+	uint64_t mSize;                /// of the whole file
+	uint64_t mNextSeq;
+	uint32_t mGeneration;          /// incremented at each rotation
+};
@@ -22,6 +22,7 @@
 #include "util/rsdir.h"
 //#include "retroshare/rspeers.h"
 #include "pqi/p3cfgmgr.h"
+#include "pqi/p3cfgjournal.h"
 #include "pqi/authssl.h"
 #include "pqi/pqibin.h"
 #include "pqi/pqistore.h"
@@ -77,7 +78,7 @@ void p3ConfigMgr::saveConfig(CheckPriority t)
 
 	std::list<pqiConfig *>::iterator it;
 	for(it = mConfigs.begin(); it != mConfigs.end(); ++it)
-        if ((*it)->HasConfigChanged(t))
+        if ((*it)->HasConfigChanged(t) || (*it)->needsFullSave())
 		{
 #ifdef CONFIG_DEBUG
 			std::cerr << "p3ConfigMgr::globalSaveConfig() Saving Element: ";
@@ -169,11 +170,22 @@ void    p3ConfigMgr::completeConfiguration()
 
 
 p3Config::p3Config()
-	:pqiConfig()
+	:pqiConfig(), mUseJournal(false), mJournal(NULL)
 {
 	return;
 }
 
+p3Config::~p3Config()
+{
+	delete mJournal;
+}
+
+void p3Config::enableJournal()
+{
+	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+	mUseJournal = true;
+}
+
 
 bool p3Config::loadConfiguration(RsFileHash& /* loadHash */)
 {
@@ -196,6 +208,7 @@ bool p3Config::loadConfig()
 
 	std::list<RsItem *> load;
 	std::list<RsItem *>::iterator it;
+	std::string loadedFname = cfgFname;
 
 	// try 1st attempt
 	if(!loadAttempt(cfgFname, signFname, load))
@@ -233,17 +246,125 @@ bool p3Config::loadConfig()
 			pass = false;
 		}
 		else
+		{
 			pass = true;
+			loadedFname = cfgFnameBackup;
+		}
 	}
 
-
+	uint64_t snapshotSize = 0;
 
 	if(pass)
+	{
+		snapshotSize = BinFileInterface(loadedFname.c_str(), BIN_FLAGS_READABLE).getFileSize();
 		loadList(load);
+	}
 	else
+		setHash(RsFileHash()); // a journal may follow an empty configuration
+
+	// changes made since the configuration file was saved
+	bool replayed = loadJournal(snapshotSize);
+
+	return pass || replayed;
+}
+
+bool p3Config::loadJournal(uint64_t snapshotSize)
+{
+	std::string journalFname = Filename() + ".jnl";
+	p3ConfigJournal *journal;
+
+	{
+		RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+
+		if(!mUseJournal)
+			return false;
+
+		if(!mJournal)
+			mJournal = new p3ConfigJournal(journalFname);
+
+		journal = mJournal;
+	}
+
+	std::list<std::vector<uint8_t> > records;
+
+	if(!journal->load(Hash(), snapshotSize, records))
 		return false;
 
-	return pass;
+	RsSerialiser *rss = setupSerialiser();
+
+	for(std::vector<uint8_t>& record: records)
+	{
+		std::list<RsItem *> load;
+		uint32_t offset = 0;
+
+		while(offset + 8 <= record.size())
+		{
+			uint32_t size = getRsItemSize(record.data() + offset);
+
+			if(size < 8 || size > record.size() - offset)
+				break;
+
+			RsItem *item = rss->deserialise(record.data() + offset, &size);
+
+			if(item)
+				load.push_back(item);
+
+			offset += getRsItemSize(record.data() + offset);
+		}
+
+		loadJournalItems(load);
+	}
+
+	delete rss;
+
+	RS_INFO("replayed ", records.size(), " journal records for ", Filename());
+
+	return true;
+}
+
+bool p3Config::journalItems(std::list<RsItem *>& items)
+{
+	p3ConfigJournal *journal;
+
+	{
+		RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+		journal = mJournal;
+	}
+
+	bool ok = (journal != NULL);
+	RsSerialiser *rss = setupSerialiser();
+	std::vector<uint8_t> record;
+
+	for(std::list<RsItem *>::iterator it = items.begin(); it != items.end(); ++it)
+	{
+		if(ok)
+		{
+			uint32_t size = rss->size(*it);
+			uint32_t offset = record.size();
+
+			record.resize(offset + size);
+			ok = size > 0 && rss->serialise(*it, record.data() + offset, &size);
+		}
+
+		delete *it;
+	}
+
+	items.clear();
+	delete rss;
+
+	return ok && journal->append(record.data(), record.size());
+}
+
+bool p3Config::needsFullSave()
+{
+	p3ConfigJournal *journal;
+
+	{
+		RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+		journal = mJournal;
+	}
+
+	return journal && journal->needsCompaction();
 }
 
 bool p3Config::loadAttempt(const std::string& cfgFname,const std::string& signFname, std::list<RsItem *>& load)
@@ -312,6 +433,19 @@ bool p3Config::saveConfiguration()
 
 bool p3Config::saveConfig()
 {
+	p3ConfigJournal *journal;
+
+	{
+		RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+		journal = mJournal;
+	}
+
+	// journal records appended from now on may be missing from the snapshot
+	p3ConfigJournal::Mark journalMark;
+
+	if(journal)
+		journalMark = journal->mark();
+
 	bool cleanup = true;
 	std::list<RsItem *> toSave;
 	saveList(cleanup, toSave);
@@ -345,6 +479,7 @@ bool p3Config::saveConfig()
 
 	/* store the hash */
 	setHash(cfg_bio->gethash());
+	uint64_t snapshotSize = cfg_bio->BinFileInterface::bytecount();
 
 	// bio is taken care of in stream's destructor, also forces file to close
 	delete stream;
@@ -362,31 +497,41 @@ bool p3Config::saveConfig()
 
     delete signbio;
 
-    // now rewrite current files to temp files
-	// rename back-up to current file
-	if(!RsDirUtil::renameFile(cfgFname, tmpCfgFname)  || !RsDirUtil::renameFile(signFname, tmpSignFname)){
+	auto installFiles = [&]()
+	{
+		// now rewrite current files to temp files
+		// rename back-up to current file
+		if(!RsDirUtil::renameFile(cfgFname, tmpCfgFname)  || !RsDirUtil::renameFile(signFname, tmpSignFname))
+		{
 #ifdef CONFIG_DEBUG
-		std::cerr << "p3Config::backedUpFileSave() Failed to rename backup meta files: " << std::endl
-				<< cfgFname << " to " << tmpCfgFname << std::endl
-				<< signFname << " to " << tmpSignFname << std::endl;
+			std::cerr << "p3Config::backedUpFileSave() Failed to rename backup meta files: " << std::endl
+			          << cfgFname << " to " << tmpCfgFname << std::endl
+			          << signFname << " to " << tmpSignFname << std::endl;
 #endif
 			written = false;
 		}
 
+		// rename new files to current files
+		if(!RsDirUtil::renameFile(newCfgFname, cfgFname)  || !RsDirUtil::renameFile(newSignFname, signFname))
+		{
+#ifdef CONFIG_DEBUG
+			std::cerr << "p3Config::() Failed to rename meta files: " << std::endl
+			          << newCfgFname << " to " << cfgFname << std::endl
+			          << newSignFname << " to " << signFname << std::endl;
+#endif
+			written = false;
+			return false;
+		}
 
+		return true;
+	};
 
-	// now rewrite current files to temp files
-	// rename back-up to current file
-	if(!RsDirUtil::renameFile(newCfgFname, cfgFname)  || !RsDirUtil::renameFile(newSignFname, signFname)){
-	#ifdef CONFIG_DEBUG
-				std::cerr << "p3Config::() Failed to rename meta files: " << std::endl
-						<< newCfgFname << " to " << cfgFname << std::endl
-						<< newSignFname << " to " << signFname << std::endl;
-	#endif
-
-				written = false;
-			}
-
+	// The journal is rewritten to follow the new files, keeping the records
+	// appended meanwhile, before they get in place.
+	if(journal)
+		journal->rotate(Hash(), snapshotSize, journalMark, installFiles);
+	else
+		installFiles();
 
 
 	saveDone(); // callback to inherited class to unlock any Mutexes protecting saveList() data
@@ -401,6 +546,7 @@ bool p3Config::saveConfig()
 p3GeneralConfig::p3GeneralConfig()
 	:p3Config()
 {
+	enableJournal();
 	return;
 }
 
@@ -446,7 +592,16 @@ void            p3GeneralConfig::setSetting(const std::string &opt, const std::s
 		settings[opt] = val;
 	}
 	/* outside mutex */
-	IndicateConfigChanged();
+	std::list<RsItem *> items;
+	RsConfigKeyValueSet *item = new RsConfigKeyValueSet();
+	RsTlvKeyValue kv;
+	kv.key = opt;
+	kv.value = val;
+	item->tlvkvs.pairs.push_back(kv);
+	items.push_back(item);
+
+	if(!journalItems(items))
+		IndicateConfigChanged();
 
 	return;
 }
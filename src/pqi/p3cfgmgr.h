@@ -60,6 +60,7 @@
  */
 
 class p3ConfigMgr;
+class p3ConfigJournal;
 
 
 
@@ -113,6 +114,12 @@ protected:
 
     void	setHash(const RsFileHash& h);
 
+    /**
+     * Asks for a full save even if no change was indicated, e.g. when the
+     * changes recorded incrementally take too much room.
+     */
+    virtual bool needsFullSave() { return false; }
+
     RsMutex cfgMtx;
 
     /**
@@ -219,12 +226,40 @@ class p3Config : public pqiConfig
 {
 public:
 	p3Config();
+	virtual ~p3Config();
 
 	virtual bool loadConfiguration(RsFileHash &loadHash);
 	virtual bool saveConfiguration();
 
 protected:
 
+	/**
+	 * Records changes in a journal next to the configuration file, instead of
+	 * rewriting the whole file for each of them. To be called from the
+	 * constructor. The file is still rewritten when the journal gets larger
+	 * than it, or when IndicateConfigChanged() is called.
+	 */
+	void enableJournal();
+
+	/**
+	 * Appends items to the journal, to be replayed with loadJournalItems()
+	 * after the configuration file is loaded. Items must describe the new
+	 * state rather than the change, as they may be replayed on top of a file
+	 * that already contains them, and are to be journaled after the change is
+	 * made. Items are deleted.
+	 * @return false if the journal is not enabled or cannot be written, the
+	 *   caller should then call IndicateConfigChanged()
+	 */
+	bool journalItems(std::list<RsItem *>& items);
+
+	/**
+	 * loads up the items of one journal record. By default they are handled
+	 * as a partial configuration.
+	 */
+	virtual bool loadJournalItems(std::list<RsItem *>& load) { return loadList(load); }
+
+	virtual bool needsFullSave();
+
 	/// Key Functions to be overloaded for Full Configuration
 	virtual RsSerialiser *setupSerialiser() = 0;
 
@@ -257,6 +292,10 @@ private:
 
 	bool loadAttempt( const std::string&, const std::string&,
 	                  std::list<RsItem *>& load );
+	bool loadJournal(uint64_t snapshotSize);
+
+	bool mUseJournal;
+	p3ConfigJournal *mJournal; /* protected by cfgMtx, created at load time */
 }; // end of p3Config
 
 
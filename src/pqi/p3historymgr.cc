@@ -22,6 +22,7 @@
 #include "util/rstime.h"
 
 #include "p3historymgr.h"
+#include "p3historystore.h"
 #include "rsitems/rshistoryitems.h"
 #include "rsitems/rsconfigitems.h"
 #include "retroshare/rsiface.h"
@@ -40,19 +41,25 @@
 
 RsHistory *rsHistory = NULL;
 
-p3HistoryMgr::p3HistoryMgr()
+p3HistoryMgr::p3HistoryMgr(const std::string& dbPath, const std::string& dbKey)
     : p3Config()
-    , nextMsgId(1)
+    , nextMsgId(1), mStore(NULL), mLegacyMessagesMoved(false)
     , mPublicEnable(false), mLobbyEnable(true), mPrivateEnable(true), mDistantEnable(true)
     , mPublicSaveCount(0), mLobbySaveCount(0), mPrivateSaveCount(0), mDistantSaveCount(0)
     , mMaxStorageDurationSeconds(10*86400) // store for 10 days at most.
     , mLastCleanTime(0)
     , mHistoryMtx("p3HistoryMgr")
 {
+	mStore = new p3HistoryStore(dbPath, dbKey);
+	nextMsgId = mStore->lastMsgId() + 1;
 }
 
 p3HistoryMgr::~p3HistoryMgr()
 {
+	for(std::list<RsHistoryMsgItem*>::iterator it = mLegacyMessages.begin(); it != mLegacyMessages.end(); ++it)
+		delete *it;
+
+	delete mStore;
 }
 
 /***** p3HistoryMgr *****/
@@ -119,49 +126,35 @@ void p3HistoryMgr::addMessage(const ChatMessage& cm)
 		if(!chatIdToVirtualPeerId(cm.chat_id, chatPeerId))
 			return;
 
-		RsHistoryMsgItem* item = new RsHistoryMsgItem;
-		item->chatPeerId = chatPeerId;
-		item->incoming = cm.incoming;
-		item->msgPeerId = msgPeerId;
-		item->peerName = peerName;
-		item->sendTime = cm.sendTime;
-		item->recvTime = cm.recvTime;
+		RsHistoryMsgItem item;
+		item.chatPeerId = chatPeerId;
+		item.incoming = cm.incoming;
+		item.msgPeerId = msgPeerId;
+		item.peerName = peerName;
+		item.sendTime = cm.sendTime;
+		item.recvTime = cm.recvTime;
 
-		item->message = cm.msg ;
+		item.message = cm.msg ;
 		//librs::util::ConvertUtf16ToUtf8(chatItem->message, item->message);
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(item->chatPeerId);
-		if (mit != mMessages.end()) {
-			item->msgId = nextMsgId++;
-			mit->second.insert(std::make_pair(item->msgId, item));
-			addMsgId = item->msgId;
-
-			// check the limit
-			uint32_t limit;
-			if (chatPeerId.isNull()) 
-				limit = mPublicSaveCount;
-			else if (cm.chat_id.isLobbyId())
-				limit = mLobbySaveCount;
-			else 
-				limit = mPrivateSaveCount;
-
-			if (limit) {
-				while (mit->second.size() > limit) {
-					delete(mit->second.begin()->second);
-					mit->second.erase(mit->second.begin());
-				}
-			}
-		} else {
-			std::map<uint32_t, RsHistoryMsgItem*> msgs;
-			item->msgId = nextMsgId++;
-			msgs.insert(std::make_pair(item->msgId, item));
-			mMessages.insert(std::make_pair(item->chatPeerId, msgs));
-			addMsgId = item->msgId;
-
-			// no need to check the limit
-		}
+		item.msgId = nextMsgId++;
 
-		IndicateConfigChanged();
+		if (!mStore->addMessage(item))
+			return;
+
+		addMsgId = item.msgId;
+
+		// check the limit
+		uint32_t limit;
+		if (chatPeerId.isNull())
+			limit = mPublicSaveCount;
+		else if (cm.chat_id.isLobbyId())
+			limit = mLobbySaveCount;
+		else
+			limit = mPrivateSaveCount;
+
+		if (limit)
+			mStore->pruneChat(chatPeerId, limit);
 	}
 
 	if (addMsgId) {
@@ -176,51 +169,35 @@ void p3HistoryMgr::cleanOldMessages()
 #ifdef HISTMGR_DEBUG
 	std::cerr << "****** cleaning old messages." << std::endl;
 #endif
-	rstime_t now = time(NULL) ;
-	bool changed = false ;
+	// retry the messages that could not be moved when loading
+	moveLegacyMessages();
 
-	for(std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.begin(); mit != mMessages.end();) 
-	{
-		if (mMaxStorageDurationSeconds > 0)
-		{
-			for(std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.begin();lit!=mit->second.end();)
-				if(lit->second->recvTime + mMaxStorageDurationSeconds < now)
-				{
-					std::map<uint32_t, RsHistoryMsgItem*>::iterator lit2 = lit ;
-					++lit2 ;
-
-#ifdef HISTMGR_DEBUG
-					std::cerr << "   removing msg id " << lit->first << ", for peer id " << mit->first << std::endl;
-#endif
-					delete lit->second ;
-
-					mit->second.erase(lit) ;
-					lit = lit2 ;
-
-					changed = true ;
-				}
-				else
-					++lit ;
-		}
-
-		if(mit->second.empty())
-		{
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit2 = mit ;
-			++mit2 ;
-#ifdef HISTMGR_DEBUG
-			std::cerr << "   removing peer id " << mit->first << ", since it has no messages" << std::endl;
-#endif
-			mMessages.erase(mit) ;
-			mit = mit2 ;
+	if (mMaxStorageDurationSeconds > 0)
+		mStore->pruneOlderThan(time(NULL) - (rstime_t)mMaxStorageDurationSeconds) ;
+}
 
-			changed = true ;
-		}
-		else
-			++mit ;
+void p3HistoryMgr::moveLegacyMessages()
+{
+	if (mLegacyMessages.empty())
+		return;
+
+	// An exit between the import and the next save of the configuration
+	// file leaves the messages in both, they must not be imported twice.
+	if (mStore->legacyMessagesImported())
+		std::cerr << "(II) Chat history messages of the configuration file already moved to the database" << std::endl;
+	else if (mStore->importLegacyMessages(mLegacyMessages))
+		std::cerr << "(II) Moved " << mLegacyMessages.size() << " chat history messages to the database" << std::endl;
+	else
+	{
+		RS_ERR("cannot move ", mLegacyMessages.size(), " chat history messages to the database, keeping them in the configuration file. They are not shown nor searched until moved.");
+		return;
 	}
 
-	if(changed)
-		IndicateConfigChanged() ;
+	for (std::list<RsHistoryMsgItem*>::iterator lit = mLegacyMessages.begin(); lit != mLegacyMessages.end(); ++lit)
+		delete *lit;
+
+	mLegacyMessages.clear();
+	mLegacyMessagesMoved = true;
 }
 
 /***** p3Config *****/
@@ -240,15 +217,9 @@ bool p3HistoryMgr::saveList(bool& cleanup, std::list<RsItem*>& saveData)
 
 	mHistoryMtx.lock(); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			if (lit->second->saveToDisc) {
-				saveData.push_back(lit->second);
-			}
-		}
-	}
+	// messages that could not be moved to the database
+	saveData.insert(saveData.end(), mLegacyMessages.begin(), mLegacyMessages.end());
+	mLegacyMessagesMoved = false;
 
 	RsConfigKeyValueSet *vitem = new RsConfigKeyValueSet;
 
@@ -315,27 +286,18 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 
 	RsHistoryMsgItem *msgItem;
 	std::list<RsItem*>::iterator it;
+	std::list<RsHistoryMsgItem*> legacyMessages;
 
 	for (it = load.begin(); it != load.end(); ++it) 
    	 {
 		if (NULL != (msgItem = dynamic_cast<RsHistoryMsgItem*>(*it))) {
 
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(msgItem->chatPeerId);
 			msgItem->msgId = nextMsgId++;
 
 #ifdef HISTMGR_DEBUG
 			std::cerr << "Loading msg history item: peer id=" << msgItem->chatPeerId << "), msg id =" << msgItem->msgId  << std::endl;
 #endif
-
-			if (mit != mMessages.end()) {
-				mit->second.insert(std::make_pair(msgItem->msgId, msgItem));
-			} else {
-				std::map<uint32_t, RsHistoryMsgItem*> msgs;
-				msgs.insert(std::make_pair(msgItem->msgId, msgItem));
-				mMessages.insert(std::make_pair(msgItem->chatPeerId, msgs));
-			}
-
-			// don't delete the item !!
+			legacyMessages.push_back(msgItem);
 
 			continue;
 		}
@@ -401,9 +363,21 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 	}
 
     load.clear() ;
+
+	// Messages of a configuration file written before the database was used.
+	// Once moved, the file is saved again without them.
+	mLegacyMessages.splice(mLegacyMessages.end(), legacyMessages);
+	moveLegacyMessages();
+
 	return true;
 }
 
+bool p3HistoryMgr::needsFullSave()
+{
+	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
+	return mLegacyMessagesMoved;
+}
+
 // have to convert to virtual peer id, to be able to use existing serialiser and file format
 bool p3HistoryMgr::chatIdToVirtualPeerId(const ChatId& chat_id, RsPeerId &peer_id)
 {
@@ -438,25 +412,8 @@ bool p3HistoryMgr::chatIdToVirtualPeerId(const ChatId& chat_id, RsPeerId &peer_i
 
 /***** p3History *****/
 
-static void convertMsg(const RsHistoryMsgItem* item, HistoryMsg &msg)
+bool p3HistoryMgr::locked_getChatPeerId(const ChatId &chatId, RsPeerId &chatPeerId)
 {
-	msg.msgId = item->msgId;
-	msg.chatPeerId = item->chatPeerId;
-	msg.incoming = item->incoming;
-	msg.peerId = item->msgPeerId;
-	msg.peerName = item->peerName;
-	msg.sendTime = item->sendTime;
-	msg.recvTime = item->recvTime;
-	msg.message = item->message;
-}
-
-bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs, uint32_t loadCount)
-{
-	msgs.clear();
-
-	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
-
-    RsPeerId chatPeerId;
     bool enabled = false;
     if (chatId.isBroadcast() && mPublicEnable == true) {
         enabled = true;
@@ -474,53 +431,71 @@ bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs
     if(enabled == false)
         return false;
 
-    if(!chatIdToVirtualPeerId(chatId, chatPeerId))
-        return false;
+    return chatIdToVirtualPeerId(chatId, chatPeerId);
+}
 
-#ifdef HISTMGR_DEBUG
-    std::cerr << "Getting history for virtual peer " << chatPeerId << std::endl;
-#endif
+bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs, uint32_t loadCount)
+{
+	return getMessagesPage(chatId, 0, loadCount, msgs);
+}
 
-	uint32_t foundCount = 0;
+bool p3HistoryMgr::getMessagesPage(const ChatId &chatId, uint32_t beforeMsgId, uint32_t count, std::list<HistoryMsg> &msgs)
+{
+	msgs.clear();
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
+	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-	if (mit != mMessages.end()) 
-	{
-		std::map<uint32_t, RsHistoryMsgItem*>::reverse_iterator lit;
+	RsPeerId chatPeerId;
+	if(!locked_getChatPeerId(chatId, chatPeerId))
+		return false;
+
+#ifdef HISTMGR_DEBUG
+	std::cerr << "Getting history for virtual peer " << chatPeerId << " before " << beforeMsgId << std::endl;
+#endif
+
+	bool ok = mStore->getMessages(chatPeerId, beforeMsgId, count, msgs);
 
-		for (lit = mit->second.rbegin(); lit != mit->second.rend(); ++lit)
-		{
-			HistoryMsg msg;
-			convertMsg(lit->second, msg);
-			msgs.insert(msgs.begin(), msg);
-			foundCount++;
-			if (loadCount && foundCount >= loadCount) {
-				break;
-			}
-		}
-	}
 #ifdef HISTMGR_DEBUG
 	std::cerr << msgs.size() << " messages added." << std::endl;
 #endif
 
-	return true;
+	return ok;
 }
 
-bool p3HistoryMgr::getMessage(uint32_t msgId, HistoryMsg &msg)
+bool p3HistoryMgr::getMessagesInRange(const ChatId &chatId, rstime_t from, rstime_t to, uint32_t maxCount, std::list<HistoryMsg> &msgs)
 {
+	msgs.clear();
+
 	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(msgId);
-		if (lit != mit->second.end()) {
-			convertMsg(lit->second, msg);
-			return true;
-		}
-	}
+	RsPeerId chatPeerId;
+	if(!locked_getChatPeerId(chatId, chatPeerId))
+		return false;
+
+	return mStore->getMessagesInRange(chatPeerId, from, to, maxCount, msgs);
+}
+
+bool p3HistoryMgr::searchMessages(const ChatId &chatId, const std::string &text, uint32_t maxCount, std::list<HistoryMsg> &msgs)
+{
+	msgs.clear();
+
+	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
+
+	if (chatId.isNotSet())
+		return mStore->searchMessages(NULL, text, maxCount, msgs);
+
+	RsPeerId chatPeerId;
+	if(!locked_getChatPeerId(chatId, chatPeerId))
+		return false;
 
-	return false;
+	return mStore->searchMessages(&chatPeerId, text, maxCount, msgs);
+}
+
+bool p3HistoryMgr::getMessage(uint32_t msgId, HistoryMsg &msg)
+{
+	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
+
+	return mStore->getMessage(msgId, msg);
 }
 
 void p3HistoryMgr::clear(const ChatId &chatId)
@@ -536,19 +511,8 @@ void p3HistoryMgr::clear(const ChatId &chatId)
         std::cerr << "********** p3History::clear()called for virtual peer id " << chatPeerId << std::endl;
 #endif
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
-		if (mit == mMessages.end()) {
+		if (!mStore->clear(chatPeerId))
 			return;
-		}
-
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			delete(lit->second);
-		}
-		mit->second.clear();
-		mMessages.erase(mit);
-
-		IndicateConfigChanged();
 	}
 
 	RsServer::notify()->notifyHistoryChanged(0, NOTIFY_TYPE_MOD);
@@ -556,7 +520,6 @@ void p3HistoryMgr::clear(const ChatId &chatId)
 
 void p3HistoryMgr::removeMessages(const std::list<uint32_t> &msgIds)
 {
-	std::list<uint32_t> ids = msgIds;
 	std::list<uint32_t> removedIds;
 	std::list<uint32_t>::iterator iit;
 
@@ -566,40 +529,12 @@ void p3HistoryMgr::removeMessages(const std::list<uint32_t> &msgIds)
 	{
 		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-		for (mit = mMessages.begin(); mit != mMessages.end(); ++mit)
-		{
-			iit = ids.begin();
-			while ( !ids.empty() || (iit != ids.end()) )
-			{
-				std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(*iit);
-				if (lit != mit->second.end())
-				{
-#ifdef HISTMGR_DEBUG
-					std::cerr << "**** Removing " << mit->first << " msg id = " << lit->first << std::endl;
-#endif
-
-					delete(lit->second);
-					mit->second.erase(lit);
-
-					removedIds.push_back(*iit);
-					iit = ids.erase(iit);
-
-					continue;
-				}
-
-				++iit;
-			}
-		}
+		if (!mStore->removeMessages(msgIds, removedIds))
+			return;
 	}
 
-	if (!removedIds.empty())
-	{
-		IndicateConfigChanged();
-
-		for (iit = removedIds.begin(); iit != removedIds.end(); ++iit)
-			RsServer::notify()->notifyHistoryChanged(*iit, NOTIFY_TYPE_DEL);
-	}
+	for (iit = removedIds.begin(); iit != removedIds.end(); ++iit)
+		RsServer::notify()->notifyHistoryChanged(*iit, NOTIFY_TYPE_DEL);
 }
 
 bool p3HistoryMgr::getEnable(uint32_t chat_type)
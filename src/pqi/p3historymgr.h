@@ -31,16 +31,24 @@
 
 class RsChatMsgItem;
 class ChatMessage;
+class p3HistoryStore;
 
 //! handles history
 /*!
  * The is a retroshare service which allows peers
  * to store the history of the chat messages
+ *
+ * Messages are kept in a database (@see p3HistoryStore) and only read when
+ * asked for, the configuration file only holds the settings.
  */
 class p3HistoryMgr: public p3Config
 {
 public:
-	p3HistoryMgr();
+	/*!
+	 * @param dbPath chat history database
+	 * @param dbKey database encryption key
+	 */
+	p3HistoryMgr(const std::string& dbPath, const std::string& dbKey);
 	virtual ~p3HistoryMgr();
 
 	/******** p3HistoryMgr *********/
@@ -50,6 +58,9 @@ public:
 	/********* RsHistory ***********/
 
     bool getMessages(const ChatId &chatPeerId, std::list<HistoryMsg> &msgs, uint32_t loadCount);
+	bool getMessagesPage(const ChatId &chatPeerId, uint32_t beforeMsgId, uint32_t count, std::list<HistoryMsg> &msgs);
+	bool getMessagesInRange(const ChatId &chatPeerId, rstime_t from, rstime_t to, uint32_t maxCount, std::list<HistoryMsg> &msgs);
+	bool searchMessages(const ChatId &chatPeerId, const std::string &text, uint32_t maxCount, std::list<HistoryMsg> &msgs);
 	bool getMessage(uint32_t msgId, HistoryMsg &msg);
     void clear(const ChatId &chatPeerId);
 	void removeMessages(const std::list<uint32_t> &msgIds);
@@ -67,12 +78,25 @@ public:
 	virtual bool saveList(bool& cleanup, std::list<RsItem*>& saveData);
 	virtual void saveDone();
 	virtual bool loadList(std::list<RsItem*>& load);
+	virtual bool needsFullSave();
 
 	static bool chatIdToVirtualPeerId(const ChatId& chat_id, RsPeerId& peer_id);
 
 private:
+	// Checks that history is enabled for this chat, and gets its virtual peer id
+	bool locked_getChatPeerId(const ChatId& chat_id, RsPeerId& peer_id);
+
 	uint32_t nextMsgId;
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> > mMessages;
+	p3HistoryStore *mStore;
+
+	// Messages from a configuration file written before the database was used.
+	// They are moved to the database at load time, and only kept here (and
+	// saved again) until that succeeds.
+	std::list<RsHistoryMsgItem*> mLegacyMessages;
+	bool mLegacyMessagesMoved;
+
+	// Moves mLegacyMessages to the database, unless already done. Called locked.
+	void moveLegacyMessages();
 
 	// Removes messages stored for more than mMaxMsgStorageDurationSeconds seconds.
 	// This avoids the stored list to grow crazy with time.
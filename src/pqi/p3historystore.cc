@@ -0,0 +1,511 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3historystore.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <sstream>
+
+#include "pqi/p3historystore.h"
+#include "util/retrodb.h"
+#include "util/rsdebug.h"
+
+/****
+ * #define HISTSTORE_DEBUG 1
+ ***/
+
+static const std::string HISTORY_TABLE_NAME = "HISTORY";
+static const std::string HISTORY_FTS_TABLE_NAME = "HISTORY_FTS";
+static const std::string HISTORY_INFO_TABLE_NAME = "HISTORY_INFO";
+
+static const std::string KEY_MSG_ID = "msgId";
+static const std::string KEY_CHAT_PEER_ID = "chatPeerId";
+static const std::string KEY_INCOMING = "incoming";
+static const std::string KEY_MSG_PEER_ID = "msgPeerId";
+static const std::string KEY_PEER_NAME = "peerName";
+static const std::string KEY_SEND_TIME = "sendTime";
+static const std::string KEY_RECV_TIME = "recvTime";
+static const std::string KEY_MESSAGE = "message";
+
+static const std::string KEY_INFO_NAME = "name";
+static const std::string KEY_INFO_VALUE = "value";
+
+/// set once the messages of the configuration file are in the database
+static const std::string INFO_LEGACY_IMPORTED = "legacyImported";
+
+static const std::string HISTORY_INDEX_CHAT_PEER_ID = "INDEX_HISTORY_CHAT_PEER_ID";
+static const std::string HISTORY_INDEX_CHAT_PEER_ID_RECV_TIME = "INDEX_HISTORY_CHAT_PEER_ID_RECV_TIME";
+static const std::string HISTORY_INDEX_RECV_TIME = "INDEX_HISTORY_RECV_TIME";
+
+/// SQL string literal
+static std::string sqlQuote(const std::string& s)
+{
+	std::string quoted = "'";
+
+	for(char c: s)
+	{
+		if(c == '\'')
+			quoted += '\'';
+		quoted += c;
+	}
+
+	return quoted + "'";
+}
+
+static std::string chatSelection(const RsPeerId& chatPeerId)
+{
+	return KEY_CHAT_PEER_ID + "='" + chatPeerId.toStdString() + "'";
+}
+
+p3HistoryStore::p3HistoryStore(const std::string& dbPath, const std::string& key, bool useFts)
+    : mDb(NULL), mHaveFts(false)
+{
+	mDb = new RetroDb(dbPath, RetroDb::OPEN_READWRITE_CREATE, key);
+
+	if(!mDb->isOpen())
+	{
+		RS_ERR("cannot open ", dbPath, ", chat history will not be kept after exit");
+
+		delete mDb;
+		mDb = new RetroDb(":memory:", RetroDb::OPEN_READWRITE_CREATE, key);
+	}
+
+	mMsgColumns.push_back(KEY_MSG_ID);
+	mMsgColumns.push_back(KEY_CHAT_PEER_ID);
+	mMsgColumns.push_back(KEY_INCOMING);
+	mMsgColumns.push_back(KEY_MSG_PEER_ID);
+	mMsgColumns.push_back(KEY_PEER_NAME);
+	mMsgColumns.push_back(KEY_SEND_TIME);
+	mMsgColumns.push_back(KEY_RECV_TIME);
+	mMsgColumns.push_back(KEY_MESSAGE);
+
+	initialise(useFts);
+}
+
+p3HistoryStore::~p3HistoryStore()
+{
+	delete mDb;
+}
+
+void p3HistoryStore::initialise(bool useFts)
+{
+	// Each message is stored in its own small transaction. With a WAL journal
+	// these do not need to wait for the data to reach the disk.
+	mDb->execPragma("journal_mode=WAL");
+	mDb->execPragma("synchronous=NORMAL");
+
+	bool ok = true;
+
+	ok = ok && mDb->execSQL("CREATE TABLE IF NOT EXISTS " + HISTORY_TABLE_NAME + "(" +
+	                        KEY_MSG_ID + " INTEGER PRIMARY KEY," +
+	                        KEY_CHAT_PEER_ID + " TEXT," +
+	                        KEY_INCOMING + " INT," +
+	                        KEY_MSG_PEER_ID + " TEXT," +
+	                        KEY_PEER_NAME + " TEXT," +
+	                        KEY_SEND_TIME + " INT," +
+	                        KEY_RECV_TIME + " INT," +
+	                        KEY_MESSAGE + " TEXT);");
+
+	// Index entries carry the message id, so that this one is enough to
+	// page through a chat in message order.
+	ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + HISTORY_INDEX_CHAT_PEER_ID + " ON " + HISTORY_TABLE_NAME + "(" + KEY_CHAT_PEER_ID + ");");
+	ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + HISTORY_INDEX_CHAT_PEER_ID_RECV_TIME + " ON " + HISTORY_TABLE_NAME + "(" + KEY_CHAT_PEER_ID + "," + KEY_RECV_TIME + ");");
+	ok = ok && mDb->execSQL("CREATE INDEX IF NOT EXISTS " + HISTORY_INDEX_RECV_TIME + " ON " + HISTORY_TABLE_NAME + "(" + KEY_RECV_TIME + ");");
+
+	ok = ok && mDb->execSQL("CREATE TABLE IF NOT EXISTS " + HISTORY_INFO_TABLE_NAME + "(" +
+	                        KEY_INFO_NAME + " TEXT PRIMARY KEY," +
+	                        KEY_INFO_VALUE + " INT);");
+
+	if(!ok)
+		RS_ERR("chat history database initialisation failed");
+
+	// An index that is not kept up to date is dropped, so that it is rebuilt
+	// when it is used again.
+	if(!useFts)
+	{
+		mDb->execSQL("DROP TABLE IF EXISTS " + HISTORY_FTS_TABLE_NAME + ";");
+		return;
+	}
+
+	// The text index refers to the messages table rather than holding a copy
+	// of the messages. It is optional as SQLite may be built without FTS5.
+	bool ftsExisted = mDb->tableExists(HISTORY_FTS_TABLE_NAME);
+
+	mHaveFts = mDb->execSQL( "CREATE VIRTUAL TABLE IF NOT EXISTS " + HISTORY_FTS_TABLE_NAME +
+	                         " USING fts5(" + KEY_MESSAGE + ", content='" + HISTORY_TABLE_NAME +
+	                         "', content_rowid='" + KEY_MSG_ID + "');" );
+
+	if(mHaveFts && !ftsExisted)
+		mHaveFts = mDb->execSQL( "INSERT INTO " + HISTORY_FTS_TABLE_NAME + "(" +
+		                         HISTORY_FTS_TABLE_NAME + ") VALUES('rebuild');" );
+
+	if(!mHaveFts)
+		RS_INFO("full text search not available, chat history search will be slower");
+}
+
+uint32_t p3HistoryStore::lastMsgId()
+{
+	std::list<std::string> columns;
+	columns.push_back("MAX(" + KEY_MSG_ID + ")");
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, columns, "", "");
+	uint32_t msgId = 0;
+
+	if(c->moveToFirst())
+		msgId = (uint32_t)c->getInt64(0);
+
+	delete c;
+	return msgId;
+}
+
+bool p3HistoryStore::addMessage(const RsHistoryMsgItem& item)
+{
+	ContentValue cv;
+	cv.put(KEY_MSG_ID, (int64_t)item.msgId);
+	cv.put(KEY_CHAT_PEER_ID, item.chatPeerId.toStdString());
+	cv.put(KEY_INCOMING, item.incoming);
+	cv.put(KEY_MSG_PEER_ID, item.msgPeerId.toStdString());
+	cv.put(KEY_PEER_NAME, item.peerName);
+	cv.put(KEY_SEND_TIME, (int64_t)item.sendTime);
+	cv.put(KEY_RECV_TIME, (int64_t)item.recvTime);
+	cv.put(KEY_MESSAGE, item.message);
+
+	if(!mHaveFts)
+		return mDb->sqlInsert(HISTORY_TABLE_NAME, "", cv);
+
+	bool ok = mDb->beginTransaction();
+
+	ok = ok && mDb->sqlInsert(HISTORY_TABLE_NAME, "", cv);
+	ok = ok && mDb->execSQL( "INSERT INTO " + HISTORY_FTS_TABLE_NAME + "(rowid," + KEY_MESSAGE + ") SELECT " +
+	                         KEY_MSG_ID + "," + KEY_MESSAGE + " FROM " + HISTORY_TABLE_NAME +
+	                         " WHERE " + KEY_MSG_ID + "=" + std::to_string(item.msgId) + ";" );
+
+	if(ok)
+		return mDb->commitTransaction();
+
+	mDb->rollbackTransaction();
+	return false;
+}
+
+bool p3HistoryStore::addMessages(const std::list<RsHistoryMsgItem*>& items)
+{
+	if(items.empty())
+		return true;
+
+	bool ok = mDb->beginTransaction();
+
+	ok = ok && insertMessages(items);
+
+	if(ok)
+		return mDb->commitTransaction();
+
+	mDb->rollbackTransaction();
+	return false;
+}
+
+bool p3HistoryStore::legacyMessagesImported()
+{
+	std::list<std::string> columns;
+	columns.push_back(KEY_INFO_VALUE);
+
+	RetroCursor *c = mDb->sqlQuery( HISTORY_INFO_TABLE_NAME, columns,
+	                                KEY_INFO_NAME + "=" + sqlQuote(INFO_LEGACY_IMPORTED), "" );
+	bool imported = c->moveToFirst() && c->getInt64(0) != 0;
+
+	delete c;
+	return imported;
+}
+
+bool p3HistoryStore::importLegacyMessages(const std::list<RsHistoryMsgItem*>& items)
+{
+	ContentValue cv;
+	cv.put(KEY_INFO_NAME, INFO_LEGACY_IMPORTED);
+	cv.put(KEY_INFO_VALUE, (int64_t)1);
+
+	// The mark is committed with the messages, so that they are never
+	// imported twice.
+	bool ok = mDb->beginTransaction();
+
+	ok = ok && (items.empty() || insertMessages(items));
+	ok = ok && mDb->sqlInsert(HISTORY_INFO_TABLE_NAME, "", cv);
+
+	if(ok)
+		return mDb->commitTransaction();
+
+	mDb->rollbackTransaction();
+	return false;
+}
+
+bool p3HistoryStore::insertMessages(const std::list<RsHistoryMsgItem*>& items)
+{
+	std::list<ContentValue> rows;
+	uint32_t firstMsgId = items.front()->msgId;
+	uint32_t lastMsgId = items.front()->msgId;
+
+	for(const RsHistoryMsgItem *item: items)
+	{
+		rows.push_back(ContentValue());
+		ContentValue& cv(rows.back());
+
+		cv.put(KEY_MSG_ID, (int64_t)item->msgId);
+		cv.put(KEY_CHAT_PEER_ID, item->chatPeerId.toStdString());
+		cv.put(KEY_INCOMING, item->incoming);
+		cv.put(KEY_MSG_PEER_ID, item->msgPeerId.toStdString());
+		cv.put(KEY_PEER_NAME, item->peerName);
+		cv.put(KEY_SEND_TIME, (int64_t)item->sendTime);
+		cv.put(KEY_RECV_TIME, (int64_t)item->recvTime);
+		cv.put(KEY_MESSAGE, item->message);
+
+		firstMsgId = std::min(firstMsgId, item->msgId);
+		lastMsgId = std::max(lastMsgId, item->msgId);
+	}
+
+	bool ok = mDb->sqlInsertBatch(HISTORY_TABLE_NAME, rows);
+
+	// Only indexes the rows of the batch, in case messages with higher ids
+	// are already there.
+	if(mHaveFts)
+		ok = ok && mDb->execSQL( "INSERT INTO " + HISTORY_FTS_TABLE_NAME + "(rowid," + KEY_MESSAGE + ") SELECT " +
+		                         KEY_MSG_ID + "," + KEY_MESSAGE + " FROM " + HISTORY_TABLE_NAME +
+		                         " WHERE " + KEY_MSG_ID + " BETWEEN " + std::to_string(firstMsgId) +
+		                         " AND " + std::to_string(lastMsgId) + ";" );
+
+	return ok;
+}
+
+bool p3HistoryStore::getMessage(uint32_t msgId, HistoryMsg& msg)
+{
+	std::list<HistoryMsg> msgs;
+
+	if(!queryMessages(KEY_MSG_ID + "=" + std::to_string(msgId), 1, msgs) || msgs.empty())
+		return false;
+
+	msg = msgs.front();
+	return true;
+}
+
+bool p3HistoryStore::getMessages( const RsPeerId& chatPeerId, uint32_t beforeMsgId, uint32_t count,
+                                  std::list<HistoryMsg>& msgs )
+{
+	std::string selection = chatSelection(chatPeerId);
+
+	if(beforeMsgId)
+		selection += " AND " + KEY_MSG_ID + "<" + std::to_string(beforeMsgId);
+
+	return queryMessages(selection, count, msgs);
+}
+
+bool p3HistoryStore::getMessagesInRange( const RsPeerId& chatPeerId, rstime_t from, rstime_t to,
+                                         uint32_t count, std::list<HistoryMsg>& msgs )
+{
+	std::string selection = chatSelection(chatPeerId) +
+	        " AND " + KEY_RECV_TIME + ">=" + std::to_string(from) +
+	        " AND " + KEY_RECV_TIME + "<" + std::to_string(to);
+
+	return queryMessages(selection, count, msgs);
+}
+
+bool p3HistoryStore::searchMessages( const RsPeerId *chatPeerId, const std::string& text, uint32_t count,
+                                     std::list<HistoryMsg>& msgs )
+{
+	std::list<std::string> words;
+	std::istringstream is(text);
+	std::string word;
+
+	while(is >> word)
+		words.push_back(word);
+
+	if(words.empty())
+		return false;
+
+	std::string chatPart;
+
+	if(chatPeerId)
+		chatPart = " AND " + chatSelection(*chatPeerId);
+
+	if(mHaveFts)
+	{
+		// each word as a quoted prefix, so that the user input is not taken
+		// for FTS query syntax
+		std::string match;
+
+		for(const std::string& w: words)
+		{
+			if(!match.empty())
+				match += " ";
+
+			match += "\"";
+			for(char c: w)
+			{
+				if(c == '"')
+					match += '"';
+				match += c;
+			}
+			match += "\"*";
+		}
+
+		if(queryMessages( KEY_MSG_ID + " IN (SELECT rowid FROM " + HISTORY_FTS_TABLE_NAME +
+		                  " WHERE " + HISTORY_FTS_TABLE_NAME + " MATCH " + sqlQuote(match) + ")" +
+		                  chatPart, count, msgs ))
+			return true;
+
+		// The index is not kept up to date from now on, so it is dropped and
+		// rebuilt on the next start, as when it is disabled.
+		RS_ERR("full text search failed, falling back to a full scan");
+		mHaveFts = false;
+		mDb->execSQL("DROP TABLE IF EXISTS " + HISTORY_FTS_TABLE_NAME + ";");
+	}
+
+	std::string selection;
+
+	for(const std::string& w: words)
+	{
+		std::string pattern = "%";
+		for(char c: w)
+		{
+			if(c == '%' || c == '_' || c == '\\')
+				pattern += '\\';
+			pattern += c;
+		}
+		pattern += "%";
+
+		if(!selection.empty())
+			selection += " AND ";
+
+		selection += KEY_MESSAGE + " LIKE " + sqlQuote(pattern) + " ESCAPE '\\'";
+	}
+
+	return queryMessages(selection + chatPart, count, msgs);
+}
+
+bool p3HistoryStore::removeMessages(const std::list<uint32_t>& msgIds, std::list<uint32_t>& removedIds)
+{
+	if(msgIds.empty())
+		return true;
+
+	std::string selection = KEY_MSG_ID + " IN (";
+
+	for(std::list<uint32_t>::const_iterator it = msgIds.begin(); it != msgIds.end(); ++it)
+	{
+		if(it != msgIds.begin())
+			selection += ",";
+		selection += std::to_string(*it);
+	}
+	selection += ")";
+
+	std::list<std::string> columns;
+	columns.push_back(KEY_MSG_ID);
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, columns, selection, "");
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+		removedIds.push_back((uint32_t)c->getInt64(0));
+
+	delete c;
+
+	if(removedIds.empty())
+		return true;
+
+	return removeWhere(selection);
+}
+
+bool p3HistoryStore::clear(const RsPeerId& chatPeerId)
+{
+	return removeWhere(chatSelection(chatPeerId));
+}
+
+bool p3HistoryStore::pruneChat(const RsPeerId& chatPeerId, uint32_t keepCount)
+{
+	// nothing matches while the chat has no more than keepCount messages
+	return removeWhere( chatSelection(chatPeerId) + " AND " + KEY_MSG_ID + "<=(SELECT " + KEY_MSG_ID +
+	                    " FROM " + HISTORY_TABLE_NAME + " WHERE " + chatSelection(chatPeerId) +
+	                    " ORDER BY " + KEY_MSG_ID + " DESC LIMIT 1 OFFSET " + std::to_string(keepCount) + ")" );
+}
+
+bool p3HistoryStore::pruneOlderThan(rstime_t recvTime)
+{
+	return removeWhere(KEY_RECV_TIME + "<" + std::to_string(recvTime));
+}
+
+bool p3HistoryStore::removeWhere(const std::string& selection)
+{
+	bool ok = mDb->beginTransaction();
+
+	// external content index entries are removed by giving back their text
+	if(mHaveFts)
+		ok = ok && mDb->execSQL( "INSERT INTO " + HISTORY_FTS_TABLE_NAME + "(" + HISTORY_FTS_TABLE_NAME +
+		                         ",rowid," + KEY_MESSAGE + ") SELECT 'delete'," + KEY_MSG_ID + "," +
+		                         KEY_MESSAGE + " FROM " + HISTORY_TABLE_NAME + " WHERE " + selection + ";" );
+
+	ok = ok && mDb->sqlDelete(HISTORY_TABLE_NAME, selection, "");
+
+	if(ok)
+		return mDb->commitTransaction();
+
+	mDb->rollbackTransaction();
+	return false;
+}
+
+bool p3HistoryStore::queryMessages( const std::string& selection, uint32_t count,
+                                    std::list<HistoryMsg>& msgs )
+{
+	// newest first so that LIMIT keeps the latest ones
+	std::string orderBy = KEY_MSG_ID + " DESC";
+
+	if(count)
+		orderBy += " LIMIT " + std::to_string(count);
+
+#ifdef HISTSTORE_DEBUG
+	std::cerr << "p3HistoryStore::queryMessages() " << selection << " ORDER BY " << orderBy << std::endl;
+#endif
+
+	RetroCursor *c = mDb->sqlQuery(HISTORY_TABLE_NAME, mMsgColumns, selection, orderBy);
+
+	if(!c->isOpen())
+	{
+		delete c;
+		return false;
+	}
+
+	std::list<HistoryMsg> found;
+
+	for(bool valid = c->moveToFirst(); valid; valid = c->moveToNext())
+	{
+		found.push_front(HistoryMsg());
+		readMessage(*c, found.front());
+	}
+
+	delete c;
+
+	msgs.splice(msgs.end(), found);
+	return true;
+}
+
+void p3HistoryStore::readMessage(RetroCursor& c, HistoryMsg& msg)
+{
+	msg.msgId = (uint32_t)c.getInt64(0);
+	c.getStringT<RsPeerId>(1, msg.chatPeerId);
+	msg.incoming = c.getBool(2);
+	c.getStringT<RsPeerId>(3, msg.peerId);
+	c.getString(4, msg.peerName);
+	msg.sendTime = (uint32_t)c.getInt64(5);
+	msg.recvTime = (uint32_t)c.getInt64(6);
+	c.getString(7, msg.message);
+}
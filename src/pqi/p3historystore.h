@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: p3historystore.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#pragma once
+
+#include <list>
+#include <string>
+
+#include "retroshare/rshistory.h"
+#include "rsitems/rshistoryitems.h"
+#include "util/rstime.h"
+
+class RetroDb;
+class RetroCursor;
+
+/*!
+ * On disk storage of the chat history, in a database encrypted like the GXS
+ * ones. Messages are indexed per chat (virtual peer id, @see
+ * p3HistoryMgr::chatIdToVirtualPeerId) so that the history of a chat can be
+ * read a page at a time, and the text is indexed for searching when SQLite has
+ * FTS5.
+ *
+ * Not thread safe, calls are serialised by p3HistoryMgr.
+ */
+class p3HistoryStore
+{
+public:
+	/*!
+	 * @param dbPath database file, an in memory database is used instead if
+	 *   it cannot be opened
+	 * @param key database encryption key
+	 * @param useFts use a text index for searching, if SQLite has FTS5
+	 */
+	p3HistoryStore(const std::string& dbPath, const std::string& key, bool useFts = true);
+	~p3HistoryStore();
+
+	/// highest message id in store, 0 if empty
+	uint32_t lastMsgId();
+
+	/// stores a message, with the id already set
+	bool addMessage(const RsHistoryMsgItem& item);
+
+	/// same for many messages at once, in one transaction
+	bool addMessages(const std::list<RsHistoryMsgItem*>& items);
+
+	/// true once importLegacyMessages() succeeded on this database
+	bool legacyMessagesImported();
+
+	/// adds the messages of the configuration file and marks them imported, in one transaction
+	bool importLegacyMessages(const std::list<RsHistoryMsgItem*>& items);
+
+	bool getMessage(uint32_t msgId, HistoryMsg& msg);
+
+	/*!
+	 * Reads a page of the history of a chat
+	 * @param chatPeerId virtual peer id of the chat
+	 * @param beforeMsgId only messages older than this one, 0 for the latest
+	 * @param count maximum number of messages, 0 for all
+	 * @param msgs the newest matching messages, oldest first
+	 */
+	bool getMessages( const RsPeerId& chatPeerId, uint32_t beforeMsgId, uint32_t count,
+	                  std::list<HistoryMsg>& msgs );
+
+	/// messages of a chat received in [from, to), oldest first
+	bool getMessagesInRange( const RsPeerId& chatPeerId, rstime_t from, rstime_t to,
+	                         uint32_t count, std::list<HistoryMsg>& msgs );
+
+	/*!
+	 * Looks for messages containing all the words of text
+	 * @param chatPeerId only in this chat, if not null
+	 * @param count maximum number of messages, 0 for all
+	 * @param msgs the newest matching messages, oldest first
+	 */
+	bool searchMessages( const RsPeerId *chatPeerId, const std::string& text, uint32_t count,
+	                     std::list<HistoryMsg>& msgs );
+
+	/// @param removedIds the ids that were in store
+	bool removeMessages(const std::list<uint32_t>& msgIds, std::list<uint32_t>& removedIds);
+
+	/// removes the whole history of a chat
+	bool clear(const RsPeerId& chatPeerId);
+
+	/// only keeps the keepCount latest messages of a chat
+	bool pruneChat(const RsPeerId& chatPeerId, uint32_t keepCount);
+
+	/// removes the messages received before recvTime
+	bool pruneOlderThan(rstime_t recvTime);
+
+private:
+	void initialise(bool useFts);
+
+	/// inserts messages in the table and the text index, in the current transaction
+	bool insertMessages(const std::list<RsHistoryMsgItem*>& items);
+
+	/// removes the messages matching selection from the table and the text index
+	bool removeWhere(const std::string& selection);
+
+	bool queryMessages( const std::string& selection, uint32_t count,
+	                    std::list<HistoryMsg>& msgs );
+	void readMessage(RetroCursor& c, HistoryMsg& msg);
+
+	RetroDb *mDb;
+	bool mHaveFts;   /// text index available, LIKE is used otherwise
+
+	std::list<std::string> mMsgColumns;
+};
@@ -28,6 +28,7 @@
 #include "rsitems/rsnxsitems.h"
 #include "pqi/p3cfgmgr.h"
 #include "pqi/pqiservice.h"
+#include "pqi/pqibwscheduler.h"
 #include "retroshare/rspeers.h"
 #include "retroshare/rsevents.h"
 
@@ -36,6 +37,7 @@
 /*******************************/
 
 static const uint8_t RS_PKT_SUBTYPE_SERVICE_CONTROL_SERVICE_PERMISSIONS = 0x01 ;
+static const uint8_t RS_PKT_SUBTYPE_SERVICE_CONTROL_BANDWIDTH_WEIGHTS   = 0x02 ;
 
 class RsServiceControlItem: public RsItem
 {
@@ -62,6 +64,21 @@ public:
     virtual void clear() {}
 };
 
+class RsServiceBandwidthWeightsItem: public RsServiceControlItem
+{
+public:
+	RsServiceBandwidthWeightsItem(): RsServiceControlItem(RS_PKT_SUBTYPE_SERVICE_CONTROL_BANDWIDTH_WEIGHTS) {}
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+	{
+		RsTypeSerializer::serial_process(j,ctx,mWeights,"mWeights") ;
+	}
+
+	virtual void clear() { mWeights.clear(); }
+
+	std::map<uint32_t,uint32_t> mWeights ;	// class => weight
+};
+
 class ServiceControlSerialiser: public RsServiceSerializer
 {
 public:
@@ -75,6 +92,7 @@ public:
 		switch(item_subtype)
         {
         case RS_PKT_SUBTYPE_SERVICE_CONTROL_SERVICE_PERMISSIONS:	return new RsServicePermissionItem();
+        case RS_PKT_SUBTYPE_SERVICE_CONTROL_BANDWIDTH_WEIGHTS:	return new RsServiceBandwidthWeightsItem();
         default:
             return NULL ;
         }
@@ -113,6 +131,25 @@ bool p3ServiceControl::getServiceItemNames(uint32_t serviceId,std::map<uint8_t,s
     return false ;
 }
 
+bool p3ServiceControl::getBandwidthClasses(std::vector<RsServiceBandwidthClassInfo>& classes)
+{
+	pqiBwClasses::getStats(classes);
+	return true;
+}
+
+bool p3ServiceControl::setBandwidthClassWeight(RsServiceBandwidthClass bwClass, uint32_t weight)
+{
+	if(!pqiBwClasses::setWeight(bwClass, weight))
+	{
+		std::cerr << "p3ServiceControl::setBandwidthClassWeight() ERROR invalid class " << (int)bwClass << " or weight " << weight;
+		std::cerr << std::endl;
+		return false;
+	}
+
+	IndicateConfigChanged();
+	return true;
+}
+
 /* Interface for Services */
 bool p3ServiceControl::registerService(const RsServiceInfo &info, bool defaultOn)
 {
@@ -1033,6 +1070,8 @@ void	p3ServiceControl::tick()
 	notifyAboutFriends();
 	notifyServices();
 
+	pqiBwClasses::updateRates();
+
 #ifdef SERVICECONTROL_DEBUG
 	std::cerr << "p3ServiceControl::tick()";
 	std::cerr << std::endl;
@@ -1053,6 +1092,13 @@ bool p3ServiceControl::saveList(bool &cleanup, std::list<RsItem *> &saveList)
         RsServicePermissionItem *item = new RsServicePermissionItem(it->second) ;
         saveList.push_back(item) ;
     }
+
+    RsServiceBandwidthWeightsItem *witem = new RsServiceBandwidthWeightsItem ;
+
+    for(uint32_t i=0;i<pqiBwScheduler::NB_CLASSES;++i)
+        witem->mWeights[i] = pqiBwClasses::weight(RsServiceBandwidthClass(i)) ;
+
+    saveList.push_back(witem) ;
 	return true;
 }
 
@@ -1069,6 +1115,12 @@ bool p3ServiceControl::loadList(std::list<RsItem *>& loadList)
         if(item != NULL)
 		mServicePermissionMap[item->mServiceId] = *item ;
 
+        RsServiceBandwidthWeightsItem *witem = dynamic_cast<RsServiceBandwidthWeightsItem*>(*it) ;
+
+        if(witem != NULL)
+            for(std::map<uint32_t,uint32_t>::const_iterator wit(witem->mWeights.begin());wit!=witem->mWeights.end();++wit)
+                pqiBwClasses::setWeight(RsServiceBandwidthClass(wit->first),wit->second) ;
+
         delete *it ;
     }
 
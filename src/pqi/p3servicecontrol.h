@@ -101,6 +101,10 @@ virtual bool isPeerConnected(uint32_t serviceId, const RsPeerId &peerId);
     // Gets the list of items used by that service
 virtual bool getServiceItemNames(uint32_t serviceId,std::map<uint8_t,std::string>& names) ;
 
+	// Outgoing bandwidth classes.
+virtual bool getBandwidthClasses(std::vector<RsServiceBandwidthClassInfo>& classes);
+virtual bool setBandwidthClassWeight(RsServiceBandwidthClass bwClass, uint32_t weight);
+
 	/**
 	 * Registration for all Services.
 	 */
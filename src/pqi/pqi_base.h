@@ -24,6 +24,8 @@
 
 #include <list>
 #include <string>
+#include <vector>
+#include <memory>
 #include <iostream>
 #include <functional>
 #include <algorithm>
@@ -52,13 +54,16 @@ class RsBwRates
 {
 	public:
 	RsBwRates()
-	:mRateIn(0), mRateOut(0), mMaxRateIn(0), mMaxRateOut(0), mQueueIn(0), mQueueOut(0) {return;}
+	:mRateIn(0), mRateOut(0), mMaxRateIn(0), mMaxRateOut(0), mQueueIn(0), mQueueOut(0),
+	 mQueueOutPending(0), mSendContention(0) {return;}
 	float mRateIn;
 	float mRateOut;
 	float mMaxRateIn;
 	float mMaxRateOut;
 	int   mQueueIn;
 	int   mQueueOut;
+	int   mQueueOutPending;	// sent items not yet taken by the streamer thread
+	uint64_t mSendContention;	// sender retries on the lock-free send queues + times they were full
 };
 
 
@@ -260,6 +265,24 @@ const uint32_t PQI_CONNECT_HIDDEN_I2P_TCP = 0x0008;
 #define BIN_FLAGS_NO_DELETE 0x0008
 #define BIN_FLAGS_HASH_DATA 0x0010
 
+/*!
+ * Read-only view on a part of a refcounted buffer. Used to hand out slices of
+ * serialised packets to the output path without copying them: the underlying
+ * buffer is released when the last view on it goes away.
+ */
+struct BinSlice
+{
+	BinSlice() : offset(0), size(0) {}
+	BinSlice(const std::shared_ptr<uint8_t>& buf, uint32_t off, uint32_t len)
+	    : buffer(buf), offset(off), size(len) {}
+
+	const uint8_t *data() const { return buffer.get() + offset; }
+
+	std::shared_ptr<uint8_t> buffer;
+	uint32_t offset;
+	uint32_t size;
+};
+
 /*!
  * This defines the binary interface used by Network/loopback/file
  * interfaces
@@ -284,6 +307,28 @@ public:
      */
 	virtual int senddata(void *data, int len) = 0;
 
+	/**
+	 * Vectored version of senddata(): sends the slices as if they were one
+	 * contiguous buffer. Same return convention as senddata(). When less than
+	 * the full length is sent, the caller passes the very same slices again.
+	 * The default implementation sends a single slice in place and gathers
+	 * several slices into a temporary buffer; interfaces that need the retry
+	 * buffer to stay at the same address (e.g. SSL) must override it.
+	 *@param slices the data to send, in order
+	 *@returns total number of bytes actually sent
+	 */
+	virtual int senddatav(const std::vector<BinSlice>& slices)
+	{
+		if(slices.size() == 1)
+			return senddata(const_cast<uint8_t*>(slices[0].data()), slices[0].size);
+
+		std::vector<uint8_t> buf;
+		for(const BinSlice& s: slices)
+			buf.insert(buf.end(), s.data(), s.data() + s.size);
+
+		return senddata(buf.data(), buf.size());
+	}
+
 	/**
 	 * reads data from a prescribed location (implementation dependent)
      * -- WARNING -- if used to feed a pqistreamer, the streamer will assume one of the two situations:
@@ -325,6 +370,12 @@ public:
 	 *  used by pqistreamer to limit transfers
 	 **/
 	virtual bool bandwidthLimited() { return true; }
+
+	/**
+	 * Descriptor that can be waited on for incoming data (see pqiReactor),
+	 * -1 if the transport is not backed by a kernel socket.
+	 */
+	virtual int pollableFd() { return -1; }
 };
 
 
@@ -0,0 +1,347 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqibwscheduler.cc                                    *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+#include "pqi/pqibwscheduler.h"
+#include "rsitems/rsserviceids.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsthreads.h"
+
+//#define DEBUG_BW_SCHEDULER 1
+
+// Tokens a class may accumulate while it is idle, in seconds of its guaranteed rate. This is
+// the size of the burst it can send right away when it becomes active again.
+static const double   BW_SCHEDULER_BURST_DURATION = 0.2 ;
+static const double   BW_SCHEDULER_MIN_BURST      = 4096.0 ;
+static const float    BW_CLASSES_RATE_AVG_FRAC    = 0.8f ;
+
+static const uint32_t BW_CLASSES_DEFAULT_WEIGHTS[pqiBwScheduler::NB_CLASSES] = { 25, 25, 40, 10 } ;
+
+static uint64_t currentTimeUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	            std::chrono::steady_clock::now().time_since_epoch() ).count() ;
+}
+
+namespace
+{
+struct BwClassesRegistry
+{
+	BwClassesRegistry() : mRatesMtx("pqiBwClasses"), mLastRateUpdateUs(0)
+	{
+		for(uint32_t i=0;i<pqiBwScheduler::NB_CLASSES;++i)
+		{
+			mWeights[i] = BW_CLASSES_DEFAULT_WEIGHTS[i] ;
+			mBytesSent[i] = 0 ;
+			mQueuedBytes[i] = 0 ;
+			mLastBytesSent[i] = 0 ;
+			mRatesKBs[i] = 0.0f ;
+		}
+	}
+
+	std::atomic<uint32_t> mWeights[pqiBwScheduler::NB_CLASSES] ;
+	std::atomic<uint64_t> mBytesSent[pqiBwScheduler::NB_CLASSES] ;
+	std::atomic<int64_t>  mQueuedBytes[pqiBwScheduler::NB_CLASSES] ;
+
+	RsMutex mRatesMtx ;	// protects below
+	uint64_t mLastRateUpdateUs ;
+	uint64_t mLastBytesSent[pqiBwScheduler::NB_CLASSES] ;
+	float mRatesKBs[pqiBwScheduler::NB_CLASSES] ;
+};
+
+BwClassesRegistry& bwClassesRegistry()
+{
+	static BwClassesRegistry registry ;
+	return registry ;
+}
+}
+
+/*****************************************************************************************/
+/*                                   pqiBwClasses                                        */
+/*****************************************************************************************/
+
+uint32_t pqiBwClasses::weight(RsServiceBandwidthClass c)
+{
+	if(uint32_t(c) >= pqiBwScheduler::NB_CLASSES)
+		return MIN_WEIGHT ;
+
+	return bwClassesRegistry().mWeights[uint32_t(c)].load(std::memory_order_relaxed) ;
+}
+
+bool pqiBwClasses::setWeight(RsServiceBandwidthClass c,uint32_t w)
+{
+	if(uint32_t(c) >= pqiBwScheduler::NB_CLASSES || w < MIN_WEIGHT || w > MAX_WEIGHT)
+		return false ;
+
+	bwClassesRegistry().mWeights[uint32_t(c)].store(w,std::memory_order_relaxed) ;
+	return true ;
+}
+
+void pqiBwClasses::recordQueued(RsServiceBandwidthClass c,int64_t bytes)
+{
+	bwClassesRegistry().mQueuedBytes[uint32_t(c)].fetch_add(bytes,std::memory_order_relaxed) ;
+}
+
+void pqiBwClasses::recordSent(RsServiceBandwidthClass c,uint32_t bytes)
+{
+	bwClassesRegistry().mBytesSent[uint32_t(c)].fetch_add(bytes,std::memory_order_relaxed) ;
+}
+
+void pqiBwClasses::updateRates()
+{
+	BwClassesRegistry& r(bwClassesRegistry()) ;
+	RsMutex& mtx(r.mRatesMtx) ;
+	RS_STACK_MUTEX(mtx) ;
+
+	uint64_t now = currentTimeUs() ;
+
+	if(now < r.mLastRateUpdateUs + 1000000)
+		return ;
+
+	double dt = (now - r.mLastRateUpdateUs) * 1e-6 ;
+	bool first_update = (r.mLastRateUpdateUs == 0) ;
+
+	for(uint32_t i=0;i<pqiBwScheduler::NB_CLASSES;++i)
+	{
+		uint64_t sent = r.mBytesSent[i].load(std::memory_order_relaxed) ;
+
+		if(!first_update)
+			r.mRatesKBs[i] = BW_CLASSES_RATE_AVG_FRAC * r.mRatesKBs[i] + (1.0f - BW_CLASSES_RATE_AVG_FRAC) * (sent - r.mLastBytesSent[i]) / (1024.0 * dt) ;
+
+		r.mLastBytesSent[i] = sent ;
+	}
+	r.mLastRateUpdateUs = now ;
+}
+
+void pqiBwClasses::getStats(std::vector<RsServiceBandwidthClassInfo>& classes)
+{
+	BwClassesRegistry& r(bwClassesRegistry()) ;
+	RsMutex& mtx(r.mRatesMtx) ;
+	RS_STACK_MUTEX(mtx) ;
+
+	classes.clear() ;
+
+	for(uint32_t i=0;i<pqiBwScheduler::NB_CLASSES;++i)
+	{
+		RsServiceBandwidthClassInfo info ;
+
+		info.mClass = RsServiceBandwidthClass(i) ;
+		info.mWeight = r.mWeights[i].load(std::memory_order_relaxed) ;
+		info.mBytesSent = r.mBytesSent[i].load(std::memory_order_relaxed) ;
+		info.mRateKBs = r.mRatesKBs[i] ;
+		info.mQueuedBytes = std::max(int64_t(0),r.mQueuedBytes[i].load(std::memory_order_relaxed)) ;
+
+		classes.push_back(info) ;
+	}
+}
+
+/*****************************************************************************************/
+/*                                  pqiBwScheduler                                       */
+/*****************************************************************************************/
+
+pqiBwScheduler::pqiBwScheduler(uint32_t nb_levels,float alpha)
+	: _classes(NB_CLASSES,ClassQueue(nb_levels,alpha)),_nb_items(0),_id_counter(0)
+{
+	_last_refill_us = currentTimeUs() ;
+}
+
+pqiBwScheduler::~pqiBwScheduler()
+{
+	clear() ;
+}
+
+RsServiceBandwidthClass pqiBwScheduler::serviceClass(uint16_t service_type)
+{
+	switch(static_cast<RsServiceType>(service_type))
+	{
+	case RsServiceType::CHAT:
+	case RsServiceType::STATUS:
+	case RsServiceType::HEARTBEAT:
+	case RsServiceType::RTT:
+	case RsServiceType::GOSSIP_DISCOVERY:
+	case RsServiceType::SERVICEINFO:
+	case RsServiceType::BANDWIDTH_CONTROL:
+	case RsServiceType::SERVICE_CONTROL:
+		return RsServiceBandwidthClass::INTERACTIVE ;
+
+	case RsServiceType::MSG:
+	case RsServiceType::MAIL:
+	case RsServiceType::GROUTER:
+	case RsServiceType::FILE_DATABASE:
+	case RsServiceType::BANLIST:
+	case RsServiceType::GXS_TRANS:
+	case RsServiceType::GXS_DISTANT:
+		return RsServiceBandwidthClass::SYNC ;
+
+	case RsServiceType::TURTLE:
+	case RsServiceType::TUNNEL:
+	case RsServiceType::FILE_TRANSFER:
+		return RsServiceBandwidthClass::BULK ;
+
+	default:
+		break ;
+	}
+
+	// all GXS services, including their sync traffic through RsGxsNetService
+	if((service_type & 0xff00) == uint16_t(RsServiceType::NXS))
+		return RsServiceBandwidthClass::SYNC ;
+
+	return RsServiceBandwidthClass::OTHER ;
+}
+
+void pqiBwScheduler::in_rsItem(void *ptr,int size,int priority)
+{
+	// RsItem header: [version 1B] [service 2B] [subtype 1B] [size 4B]
+
+	uint32_t type = 0 ;
+	uint32_t offset = 0 ;
+
+	if(size >= 4)
+		getRawUInt32(ptr,4,&offset,&type) ;
+
+	RsServiceBandwidthClass c = serviceClass((type >> 8) & 0xffff) ;
+	ClassQueue& cq(_classes[uint32_t(c)]) ;
+
+	cq.queue.in_rsItem(ptr,size,priority,_id_counter++) ;
+	cq.queued_bytes += size ;
+	++_nb_items ;
+
+	pqiBwClasses::recordQueued(c,size) ;
+
+	if(_id_counter >= pqiQoS::MAX_PACKET_COUNTER_VALUE)
+		_id_counter = 0 ;
+}
+
+void pqiBwScheduler::clear()
+{
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+	{
+		_classes[i].queue.clear() ;
+		pqiBwClasses::recordQueued(RsServiceBandwidthClass(i),-int64_t(_classes[i].queued_bytes)) ;
+
+		_classes[i].queued_bytes = 0 ;
+		_classes[i].tokens = 0.0 ;
+	}
+	_nb_items = 0 ;
+}
+
+void pqiBwScheduler::refill(double rate,double dt)
+{
+	if(rate <= 0.0)
+		return ;
+
+	uint32_t total_weight = 0 ;
+
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+		total_weight += pqiBwClasses::weight(RsServiceBandwidthClass(i)) ;
+
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+	{
+		double class_rate = rate * pqiBwClasses::weight(RsServiceBandwidthClass(i)) / total_weight ;
+		double burst = std::max(BW_SCHEDULER_MIN_BURST,class_rate * BW_SCHEDULER_BURST_DURATION) ;
+
+		_classes[i].tokens = std::min(burst,_classes[i].tokens + dt * class_rate) ;
+	}
+}
+
+int pqiBwScheduler::selectClass()
+{
+	bool backlogged = false ;
+
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+		if(_classes[i].queue.qos_queue_size() > 0)
+		{
+			if(_classes[i].tokens >= 0.0)
+				return i ;
+
+			backlogged = true ;
+		}
+		else if(_classes[i].tokens < 0.0)
+			_classes[i].tokens = 0.0 ;	// idle classes do not keep the debt of past borrowing
+
+	if(!backlogged)
+		return -1 ;
+
+	// All backlogged classes are in debt: lend them bandwidth in proportion to their weight,
+	// just enough for the least indebted one to be allowed to send.
+
+	double lend = std::numeric_limits<double>::max() ;
+	int best = -1 ;
+
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+		if(_classes[i].queue.qos_queue_size() > 0)
+		{
+			double l = -_classes[i].tokens / pqiBwClasses::weight(RsServiceBandwidthClass(i)) ;
+
+			if(l < lend)
+			{
+				lend = l ;
+				best = i ;
+			}
+		}
+
+	for(uint32_t i=0;i<NB_CLASSES;++i)
+		if(_classes[i].queue.qos_queue_size() > 0)
+			_classes[i].tokens = std::min(0.0,_classes[i].tokens + lend * pqiBwClasses::weight(RsServiceBandwidthClass(i))) ;
+
+	_classes[best].tokens = 0.0 ;
+
+#ifdef DEBUG_BW_SCHEDULER
+	std::cerr << "pqiBwScheduler: lending " << lend << " bytes per weight unit. Selected class " << best << std::endl;
+#endif
+	return best ;
+}
+
+bool pqiBwScheduler::out_rsItem(double rate,uint32_t max_slice_size,BinSlice& slice,bool& starts,bool& ends,uint32_t& packet_id)
+{
+	if(_nb_items == 0)
+		return false ;
+
+	uint64_t now = currentTimeUs() ;
+
+	refill(rate,std::min(1.0,(now - _last_refill_us) * 1e-6)) ;
+	_last_refill_us = now ;
+
+	int c = selectClass() ;
+
+	if(c < 0)
+		return false ;
+
+	ClassQueue& cq(_classes[c]) ;
+
+	if(!cq.queue.out_rsItem(max_slice_size,slice,starts,ends,packet_id))
+		return false ;
+
+	cq.tokens -= slice.size ;
+	cq.queued_bytes -= std::min(cq.queued_bytes,uint64_t(slice.size)) ;
+
+	pqiBwClasses::recordQueued(RsServiceBandwidthClass(c),-int64_t(slice.size)) ;
+	pqiBwClasses::recordSent(RsServiceBandwidthClass(c),slice.size) ;
+
+	if(ends)
+		--_nb_items ;
+
+	return true ;
+}
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqibwscheduler.h                                     *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+// Hierarchical token bucket scheduling of outgoing traffic.
+//
+// The hierarchy has three levels:
+//
+//   global  -> total upload rate, shared among connections by pqihandler::UpdateRates()
+//   peer    -> max rate of each connection, enforced by pqistreamer::outAllowedBytes_locked()
+//   class   -> share of a connection given to each service class, handled here.
+//
+// Each class of a connection owns a token bucket, refilled at weight/sum(weights)
+// times the connection rate. A class with tokens left is served first, in class
+// order, so that interactive traffic gets out before the others. When no
+// backlogged class has tokens left, the unused bandwidth is lent to backlogged
+// classes in proportion to their weight, which keeps the scheduler work-conserving
+// and also handles connections that are not bandwidth limited.
+//
+// Inside a class, items are still ordered by priority level using pqiQoS.
+
+#include <stdint.h>
+#include <vector>
+
+#include "pqi/pqiqos.h"
+#include "retroshare/rsservicecontrol.h"
+
+class pqiBwScheduler
+{
+public:
+	pqiBwScheduler(uint32_t nb_levels,float alpha) ;
+	~pqiBwScheduler() ;
+
+	static const uint32_t NB_CLASSES = 4 ;
+
+	// Queues a serialized packet. The class is taken from the service id in the packet header.
+	void in_rsItem(void *ptr,int size,int priority) ;
+
+	// Pops the next slice to send. rate is the max outgoing rate of the connection in bytes/sec,
+	// or 0 if the connection is not bandwidth limited.
+	bool out_rsItem(double rate,uint32_t max_slice_size,BinSlice& slice,bool& starts,bool& ends,uint32_t& packet_id) ;
+
+	uint64_t qos_queue_size() const { return _nb_items ; }
+	void clear() ;
+
+	static RsServiceBandwidthClass serviceClass(uint16_t service_type) ;
+
+protected:
+	// The scheduling steps are kept apart from the clock, so that they can be checked with
+	// known elapsed times.
+
+	struct ClassQueue
+	{
+		ClassQueue(uint32_t nb_levels,float alpha) : queue(nb_levels,alpha),tokens(0.0),queued_bytes(0) {}
+
+		pqiQoS queue ;
+		double tokens ;
+		uint64_t queued_bytes ;
+	};
+
+	// Adds dt seconds worth of tokens to each class, up to its burst size.
+	void refill(double rate,double dt) ;
+
+	// Returns the class to send from, or -1 if nothing is queued.
+	int selectClass() ;
+
+	std::vector<ClassQueue> _classes ;
+
+private:
+	uint64_t _nb_items ;
+	uint32_t _id_counter ;
+	uint64_t _last_refill_us ;
+};
+
+// Process-wide class weights and usage counters. Weights are set by p3ServiceControl,
+// counters are updated by all the pqiBwScheduler instances.
+
+class pqiBwClasses
+{
+public:
+	static const uint32_t MIN_WEIGHT = 1 ;
+	static const uint32_t MAX_WEIGHT = 1000 ;
+
+	static uint32_t weight(RsServiceBandwidthClass c) ;
+	static bool setWeight(RsServiceBandwidthClass c,uint32_t w) ;
+
+	static void recordQueued(RsServiceBandwidthClass c,int64_t bytes) ;
+	static void recordSent(RsServiceBandwidthClass c,uint32_t bytes) ;
+
+	// Updates the per-class rate estimates. Meant to be called regularly, does nothing if called
+	// less than one second after the previous update.
+	static void updateRates() ;
+
+	static void getStats(std::vector<RsServiceBandwidthClassInfo>& classes) ;
+};
@@ -295,6 +295,8 @@ int     pqihandler::ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRat
 	total.mRateOut = 0;
 	total.mQueueIn = 0;
 	total.mQueueOut = 0;
+	total.mQueueOutPending = 0;
+	total.mSendContention = 0;
 
 	/* Lock once rates have been retrieved */
 	RS_STACK_MUTEX(coreMtx); /**************** LOCKED MUTEX ****************/
@@ -311,6 +313,8 @@ int     pqihandler::ExtractRates(std::map<RsPeerId, RsBwRates> &ratemap, RsBwRat
 		total.mRateOut += peerRates.mRateOut;
 		total.mQueueIn  += peerRates.mQueueIn;
 		total.mQueueOut += peerRates.mQueueOut;
+		total.mQueueOutPending += peerRates.mQueueOutPending;
+		total.mSendContention += peerRates.mSendContention;
 
 		ratemap[it->first] = peerRates;
 
@@ -51,11 +51,8 @@ for(int i=((int)nb_levels)-1;i>=0;--i,c *= alpha)
 
 void pqiQoS::clear()
 {
-	void *item ;
-
 	for(uint32_t i=0;i<_item_queues.size();++i)
-		while( (item = _item_queues[i].pop()) != NULL)
-			free(item) ;
+		while(_item_queues[i].pop()) ;
 
 	_nb_items = 0 ;
 }
@@ -71,6 +68,14 @@ void pqiQoS::print() const
 }
 
 void pqiQoS::in_rsItem(void *ptr,int size,int priority)
+{
+	in_rsItem(ptr,size,priority,_id_counter++) ;
+
+    	if(_id_counter >= MAX_PACKET_COUNTER_VALUE)
+            _id_counter = 0 ;
+}
+
+void pqiQoS::in_rsItem(void *ptr,int size,int priority,uint32_t packet_id)
 {
 	if(uint32_t(priority) >= _item_queues.size())
 	{
@@ -78,11 +83,8 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 		priority = _item_queues.size()-1 ;
 	}
 
-	_item_queues[priority].push(ptr,size,_id_counter++) ;
+	_item_queues[priority].push(ptr,size,packet_id) ;
 	++_nb_items ;
-    
-    	if(_id_counter >= MAX_PACKET_COUNTER_VALUE)
-            _id_counter = 0 ;
 }
 
 // int pqiQoS::gatherStatistics(std::vector<uint32_t>& per_service_count,std::vector<uint32_t>& per_priority_count) const
@@ -109,12 +111,12 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 // }
 
 
-void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+bool pqiQoS::out_rsItem(uint32_t max_slice_size, BinSlice& slice, bool& starts, bool& ends, uint32_t& packet_id) 
 {
 	// Go through the queues. Increment counters.
 
 	if(_nb_items == 0)
-		return NULL ;
+		return false ;
 
 	float inc = 1.0f ;
 	int i = _item_queues.size()-1 ;
@@ -139,7 +141,7 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
         
         	// now chop a slice of this item
         
-        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id) ;
+        	bool res = _item_queues[last].slice(max_slice_size,slice,starts,ends,packet_id) ;
             
             	if(ends)
 			--_nb_items ;
@@ -147,7 +149,7 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
 		return res ;
 	}
 	else
-		return NULL ;
+		return false ;
 }
 
 
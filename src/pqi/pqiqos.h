@@ -37,17 +37,21 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <memory>
 
 #include <util/rsmemory.h>
+#include "pqi/pqi_base.h"
 
 class pqiQoS
 {
 public:
 	pqiQoS(uint32_t max_levels,float alpha) ;
 
+	static const uint32_t MAX_PACKET_COUNTER_VALUE ;
+
 	struct ItemRecord
 	{
-		void *data ;
+		std::shared_ptr<uint8_t> data ;
 		uint32_t current_offset ;
 		uint32_t size ;
 		uint32_t id ;
@@ -61,21 +65,23 @@ public:
 		  , _counter(0.0)
 		  , _inc(0.0)
 		{}
-		void *pop() 
+		bool pop() 
 		{
 			if(_items.empty())
-				return NULL ;
+				return false ;
 
-			void *item = _items.front().data ;
 			_items.pop_front() ;
-
-			return item ;
+			return true ;
 		}
 
-		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		// Hands out a view on the next slice of the first item. No data is copied: the slice
+		// shares ownership of the item buffer, which is released once the item has been
+		// entirely sliced and the last slice has been sent.
+
+		bool slice(uint32_t max_size,BinSlice& out,bool& starts,bool& ends,uint32_t& packet_id) 
 		{
 			if(_items.empty())
-				return NULL ;
+				return false ;
 
 			ItemRecord& rec(_items.front()) ;
 			packet_id = rec.id ;
@@ -86,9 +92,10 @@ public:
 			{
 				starts = true ;
 				ends = true ;
-				size = rec.size ;
+				out = BinSlice(rec.data,0,rec.size) ;
 
-				return pop() ;
+				_items.pop_front() ;
+				return true ;
 			}
 			starts = (rec.current_offset == 0) ;
 			ends   = (rec.current_offset + max_size >= rec.size) ;
@@ -97,37 +104,24 @@ public:
 			{
 				std::cerr << "(EE) severe error in slicing in QoS." << std::endl;
 				pop() ;
-				return NULL ;
-			}
-
-			size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
-			void *mem = rs_malloc(size) ;
-
-			if(!mem)
-			{
-				std::cerr << "(EE) memory allocation error in QoS." << std::endl;
-				pop() ;
-				return NULL ;
+				return false ;
 			}
 
-			memcpy(mem,&((unsigned char*)rec.data)[rec.current_offset],size) ;
+			out = BinSlice(rec.data,rec.current_offset,std::min(max_size, rec.size - rec.current_offset)) ;
 
-			if(ends)	// we're taking the whole stuff. So we can delete the entry.
-			{
-				free(rec.data) ;
+			if(ends)	// we're taking the whole stuff. So we can drop the entry.
 				_items.pop_front() ;
-			}
 			else
-				rec.current_offset += size ;	// by construction, !ends  implies  rec.current_offset < rec.size
+				rec.current_offset += out.size ;	// by construction, !ends  implies  rec.current_offset < rec.size
 
-			return mem ;
+			return true ;
 		}
 
 		void push(void *item,uint32_t size,uint32_t id) 
 		{
 			ItemRecord rec ;
 
-			rec.data = item ;
+			rec.data = std::shared_ptr<uint8_t>((uint8_t*)item,free) ;
 			rec.current_offset = 0 ;
 			rec.size = size ;
 			rec.id = id ;
@@ -144,14 +138,20 @@ public:
 		std::list<ItemRecord> _items ;
 	};
 
-	// This function pops items from the queue, y order of priority
+	// This function pops items from the queue, y order of priority. The returned slice is a
+	// view on the queued item, so it needs no copy and no free.
 	//
-	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+	bool out_rsItem(uint32_t max_slice_size,BinSlice& slice,bool& starts,bool& ends,uint32_t& packet_id) ;
 
 	// This function is used to queue items.
 	//
 	void in_rsItem(void *item, int size, int priority) ;
 
+	// Same, with a packet id supplied by the caller, for when several queues share
+	// the same packet id space.
+	//
+	void in_rsItem(void *item, int size, int priority, uint32_t packet_id) ;
+
 	void print() const ;
 	uint64_t qos_queue_size() const { return _nb_items ; }
 
@@ -172,8 +172,6 @@ private:
 	float _alpha ;
 	uint64_t _nb_items ;
 	uint32_t _id_counter ;
-
-	static const uint32_t MAX_PACKET_COUNTER_VALUE ;
 };
 
 
@@ -26,7 +26,7 @@
 const float    pqiQoSstreamer::PQI_QOS_STREAMER_ALPHA      = 2.0f ;
 
 pqiQoSstreamer::pqiQoSstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& peerid, BinInterface *bio_in, int bio_flagsin)
-	: pqithreadstreamer(parent,rss,peerid,bio_in,bio_flagsin), pqiQoS(PQI_QOS_STREAMER_MAX_LEVELS, PQI_QOS_STREAMER_ALPHA)
+	: pqithreadstreamer(parent,rss,peerid,bio_in,bio_flagsin), pqiBwScheduler(PQI_QOS_STREAMER_MAX_LEVELS, PQI_QOS_STREAMER_ALPHA)
 {
 	_total_item_size = 0 ;
 	_total_item_count = 0 ;
@@ -39,7 +39,7 @@ int pqiQoSstreamer::getQueueSize(bool in)
 	else
 	{
 		RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
-		return qos_queue_size() ;
+		return qos_queue_size() + pendingSendRingsSize() ;
 	}
 }
 
@@ -53,7 +53,7 @@ void pqiQoSstreamer::locked_storeInOutputQueue(void *ptr,int size,int priority)
 	_total_item_size += size ;
 	++_total_item_count ;
 
-	pqiQoS::in_rsItem(ptr,size,priority) ;
+	pqiBwScheduler::in_rsItem(ptr,size,priority) ;
 }
 
 void pqiQoSstreamer::locked_clear_out_queue()
@@ -63,18 +63,23 @@ void pqiQoSstreamer::locked_clear_out_queue()
 	    std::cerr << "  pqiQoSstreamer::locked_clear_out_queue(): clearing " << qos_queue_size() << " pending outqueue elements." << std::endl;
 #endif
     
-	pqiQoS::clear() ;
+	pqiBwScheduler::clear() ;
 	_total_item_size = 0 ;
 	_total_item_count = 0 ;
 }
 
-void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+bool pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, BinSlice& slice, bool& starts, bool& ends, uint32_t& packet_id)
 {
-	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id) ;
+	// The class scheduler needs the connection rate to compute the guaranteed share of each
+	// service class. 0 means that the connection is not limited.
 
-	if(out != NULL) 
+	double rate = mBio->bandwidthLimited() ? getMaxRate_locked(false) * 1024.0 : 0.0 ;
+
+	bool out = pqiBwScheduler::out_rsItem(rate,max_slice_size,slice,starts,ends,packet_id) ;
+
+	if(out) 
 	{
-		_total_item_size -= size ;
+		_total_item_size -= slice.size ;
         
         	if(ends)
 			--_total_item_count ;
@@ -0,0 +1,527 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqireactor.cc                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "pqi/pqireactor.h"
+#include "util/rstime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+//#define DEBUG_PQIREACTOR 1
+
+static const uint32_t PQIREACTOR_MAX_EVENTS     = 64 ;	// events handled per epoll_wait() call
+static const uint32_t PQIREACTOR_RESYNC_PERIODS = 33 ;	// re-arm every descriptor about once per second
+
+RsMutex pqiReactor::mReactorMtx("pqiReactor") ;
+uint32_t pqiReactor::mThreadCount = 0 ;
+std::vector<pqiReactorThread*> pqiReactor::mThreads ;
+std::map<pqiReactorClient*, pqiReactorThread*> pqiReactor::mClientThreads ;
+
+//=========================================================================================//
+//                                        pqiReactor                                       //
+//=========================================================================================//
+
+void pqiReactor::setThreadCount(uint32_t n)
+{
+	RS_STACK_MUTEX(mReactorMtx) ;
+
+#ifdef __linux__
+	mThreadCount = (n > MAX_THREADS) ? MAX_THREADS : n ;
+
+	if(mThreadCount > 0)
+		std::cerr << "pqiReactor: servicing connections from " << mThreadCount << " I/O thread(s)." << std::endl;
+#else
+	if(n > 0)
+		std::cerr << "(WW) pqiReactor: not available on this platform. Using one thread per connection." << std::endl;
+#endif
+}
+
+bool pqiReactor::enabled()
+{
+	RS_STACK_MUTEX(mReactorMtx) ;
+	return mThreadCount > 0 ;
+}
+
+pqiReactorThread *pqiReactor::locked_threadFor(pqiReactorClient *client, bool create)
+{
+	std::map<pqiReactorClient*, pqiReactorThread*>::const_iterator it = mClientThreads.find(client) ;
+
+	if(it != mClientThreads.end())
+		return it->second ;
+
+	if(!create || mThreadCount == 0)
+		return NULL ;
+
+	// Start threads as needed, then give the client to the least loaded one.
+
+	if(mThreads.size() < mThreadCount)
+	{
+		pqiReactorThread *thread = new pqiReactorThread ;
+
+		if(thread->init())
+		{
+			thread->start("pqi reactor " + std::to_string(mThreads.size())) ;
+			mThreads.push_back(thread) ;
+		}
+		else
+			delete thread ;
+	}
+
+	pqiReactorThread *best = NULL ;
+	uint32_t best_count = 0 ;
+
+	for(uint32_t i=0;i<mThreads.size();++i)
+	{
+		uint32_t count = mThreads[i]->nbClients() ;
+
+		if(best == NULL || count < best_count)
+		{
+			best = mThreads[i] ;
+			best_count = count ;
+		}
+	}
+
+	if(best != NULL)
+		mClientThreads[client] = best ;
+
+	return best ;
+}
+
+void pqiReactor::attach(pqiReactorClient *client)
+{
+	pqiReactorThread *thread = NULL ;
+	{
+		RS_STACK_MUTEX(mReactorMtx) ;
+		thread = locked_threadFor(client, true) ;
+	}
+
+	if(thread != NULL)
+		thread->attach(client) ;
+	else
+		std::cerr << "(EE) pqiReactor::attach(): no reactor thread available. Connection will not be serviced." << std::endl;
+}
+
+void pqiReactor::detach(pqiReactorClient *client, bool wait)
+{
+	pqiReactorThread *thread = NULL ;
+	{
+		RS_STACK_MUTEX(mReactorMtx) ;
+		thread = locked_threadFor(client, false) ;
+	}
+
+	// Threads are only deleted by shutdown(), which makes detaching useless anyway.
+
+	if(thread == NULL)
+		return ;
+
+	thread->detach(client, wait) ;
+
+	// Waiting is done before deleting the client: forget it, so that a new client allocated at
+	// the same address is given to the least loaded thread.
+
+	if(wait)
+	{
+		RS_STACK_MUTEX(mReactorMtx) ;
+		mClientThreads.erase(client) ;
+	}
+}
+
+void pqiReactor::wakeUp(pqiReactorClient *client)
+{
+	pqiReactorThread *thread = NULL ;
+	{
+		RS_STACK_MUTEX(mReactorMtx) ;
+		thread = locked_threadFor(client, false) ;
+	}
+
+	if(thread != NULL)
+		thread->wakeUp(client) ;
+}
+
+void pqiReactor::shutdown()
+{
+	std::vector<pqiReactorThread*> threads ;
+	{
+		RS_STACK_MUTEX(mReactorMtx) ;
+
+		threads.swap(mThreads) ;
+		mClientThreads.clear() ;
+		mThreadCount = 0 ;
+	}
+
+	for(uint32_t i=0;i<threads.size();++i)
+	{
+		threads[i]->fullstop() ;
+		delete threads[i] ;
+	}
+}
+
+//=========================================================================================//
+//                                     pqiReactorThread                                    //
+//=========================================================================================//
+
+pqiReactorThread::pqiReactorThread()
+	: mEpollFd(-1), mEventFd(-1), mNextTimerTS(0), mNbPeriods(0),
+	  mThreadMtx("pqiReactorThread"), mSignalled(false), mThreadIdSet(false)
+{
+}
+
+pqiReactorThread::~pqiReactorThread()
+{
+	if(mEpollFd >= 0) close(mEpollFd) ;
+	if(mEventFd >= 0) close(mEventFd) ;
+}
+
+bool pqiReactorThread::init()
+{
+#ifdef __linux__
+	mEpollFd = epoll_create1(EPOLL_CLOEXEC) ;
+	mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+
+	if(mEpollFd < 0 || mEventFd < 0)
+	{
+		std::cerr << "(EE) pqiReactorThread: cannot create epoll/eventfd descriptors: " << strerror(errno) << std::endl;
+		return false ;
+	}
+
+	// The eventfd is the only descriptor registered with a NULL pointer.
+
+	struct epoll_event ev ;
+	memset(&ev, 0, sizeof(ev)) ;
+	ev.events = EPOLLIN ;
+	ev.data.ptr = NULL ;
+
+	if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev) < 0)
+	{
+		std::cerr << "(EE) pqiReactorThread: cannot register eventfd: " << strerror(errno) << std::endl;
+		return false ;
+	}
+	return true ;
+#else
+	return false ;
+#endif
+}
+
+bool pqiReactorThread::onReactorThread()
+{
+	RS_STACK_MUTEX(mThreadMtx) ;
+	return mThreadIdSet && pthread_equal(mThreadId, pthread_self()) ;
+}
+
+void pqiReactorThread::signal()
+{
+#ifdef __linux__
+	uint64_t one = 1 ;
+
+	if(write(mEventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		std::cerr << "(EE) pqiReactorThread: cannot write to eventfd: " << strerror(errno) << std::endl;
+#endif
+}
+
+uint32_t pqiReactorThread::nbClients()
+{
+	RS_STACK_MUTEX(mThreadMtx) ;
+	return mAttached.size() ;
+}
+
+void pqiReactorThread::attach(pqiReactorClient *client)
+{
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+
+		mCommands.push_back(std::make_pair(client, (int)CMD_ATTACH)) ;
+		mAttached.insert(client) ;
+	}
+	signal() ;
+}
+
+void pqiReactorThread::detach(pqiReactorClient *client, bool wait)
+{
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+
+		mCommands.push_back(std::make_pair(client, (int)CMD_DETACH)) ;
+		mWakeUps.erase(client) ;
+	}
+	signal() ;
+
+	if(!wait || onReactorThread())
+		return ;
+
+	// The command is processed at the beginning of the next loop, when no client is being serviced.
+
+	std::unique_lock<RsMutex> lock(mThreadMtx) ;
+
+	mCommandsDoneCv.wait(lock,[this,client]()
+	{
+		bool pending = mAttached.find(client) != mAttached.end() ;
+
+		for(std::list<std::pair<pqiReactorClient*, int> >::const_iterator it(mCommands.begin());!pending && it!=mCommands.end();++it)
+			pending = (it->first == client) ;
+
+		return !pending ;
+	}) ;
+}
+
+void pqiReactorThread::wakeUp(pqiReactorClient *client)
+{
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+
+		mWakeUps.insert(client) ;
+
+		if(mSignalled)
+			return ;
+
+		mSignalled = true ;
+	}
+	signal() ;
+}
+
+void pqiReactorThread::processCommands()
+{
+	std::list<std::pair<pqiReactorClient*, int> > commands ;
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+		commands.swap(mCommands) ;
+	}
+
+	if(commands.empty())
+		return ;
+
+	for(std::list<std::pair<pqiReactorClient*, int> >::const_iterator it(commands.begin());it!=commands.end();++it)
+		if(it->second == CMD_ATTACH)
+		{
+			// The descriptor is registered on the next timer period.
+			mClients.insert(std::make_pair(it->first, ClientState())) ;
+		}
+		else
+		{
+			std::map<pqiReactorClient*, ClientState>::iterator cit = mClients.find(it->first) ;
+
+			if(cit != mClients.end())
+			{
+				unregister(cit->second) ;
+				mClients.erase(cit) ;
+			}
+		}
+
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+
+		for(std::list<std::pair<pqiReactorClient*, int> >::const_iterator it(commands.begin());it!=commands.end();++it)
+			if(mClients.find(it->first) != mClients.end())
+				mAttached.insert(it->first) ;
+			else
+				mAttached.erase(it->first) ;
+	}
+	mCommandsDoneCv.notify_all() ;
+}
+
+void pqiReactorThread::arm(pqiReactorClient *client, ClientState& state)
+{
+#ifdef __linux__
+	if(state.fd < 0)
+		return ;
+
+	// One-shot registration: the descriptor is re-armed once the data has been read, or on the
+	// next timer period if the rate limit stopped reading, so that throttled peers do not spin.
+
+	struct epoll_event ev ;
+	memset(&ev, 0, sizeof(ev)) ;
+	ev.events = EPOLLIN | EPOLLONESHOT ;
+	ev.data.ptr = client ;
+
+	if(epoll_ctl(mEpollFd, EPOLL_CTL_MOD, state.fd, &ev) == 0)
+		return ;
+
+	// Not registered yet, or removed from the set because the descriptor was closed.
+
+	if(errno == ENOENT && epoll_ctl(mEpollFd, EPOLL_CTL_ADD, state.fd, &ev) == 0)
+		return ;
+
+#ifdef DEBUG_PQIREACTOR
+	std::cerr << "pqiReactorThread::arm(): cannot register fd " << state.fd << ": " << strerror(errno) << std::endl;
+#endif
+	state.fd = -1 ;	// will retry on next timer period
+#endif
+}
+
+void pqiReactorThread::unregister(ClientState& state)
+{
+#ifdef __linux__
+	// Errors are expected here: the descriptor is usually closed already.
+
+	if(state.fd >= 0)
+		epoll_ctl(mEpollFd, EPOLL_CTL_DEL, state.fd, NULL) ;
+#endif
+	state.fd = -1 ;
+}
+
+void pqiReactorThread::serviceRecv(pqiReactorClient *client, ClientState& state)
+{
+	state.recv_deferred = client->reactorRecv() ;
+
+	if(!state.recv_deferred)
+		arm(client, state) ;
+}
+
+void pqiReactorThread::timerTick()
+{
+	bool resync = (++mNbPeriods % PQIREACTOR_RESYNC_PERIODS) == 0 ;
+
+	for(std::map<pqiReactorClient*, ClientState>::iterator it(mClients.begin());it!=mClients.end();++it)
+	{
+		pqiReactorClient *client = it->first ;
+		ClientState& state = it->second ;
+
+		client->reactorTimer() ;
+
+		bool active = client->reactorIsActive() ;
+		int fd = active ? client->reactorFd() : -1 ;
+
+		if(fd != state.fd)
+		{
+			// New connection, or the connection was reset. Read straight away, as data may already
+			// be buffered by SSL, which does not make the socket readable.
+
+			unregister(state) ;
+			state.fd = fd ;
+			state.recv_deferred = (fd >= 0) ;
+		}
+
+		if(!active)
+			continue ;
+
+		if(fd < 0 || state.recv_deferred)
+			serviceRecv(client, state) ;
+		else if(resync)
+			arm(client, state) ;	// in case the descriptor was closed and its number reused in between
+
+		client->reactorSend() ;
+	}
+}
+
+void pqiReactorThread::threadTick()
+{
+#ifdef __linux__
+	{
+		RS_STACK_MUTEX(mThreadMtx) ;
+
+		if(!mThreadIdSet)
+		{
+			mThreadId = pthread_self() ;
+			mThreadIdSet = true ;
+		}
+	}
+
+	processCommands() ;
+
+	double now = rstime::RsScopeTimer::currentTime() ;
+
+	if(mNextTimerTS == 0)
+		mNextTimerTS = now ;
+
+	int timeout_ms = std::max(0, (int)((mNextTimerTS - now) * 1000.0)) ;
+
+	struct epoll_event events[PQIREACTOR_MAX_EVENTS] ;
+	int n = epoll_wait(mEpollFd, events, PQIREACTOR_MAX_EVENTS, timeout_ms) ;
+
+	if(n < 0)
+	{
+		if(errno != EINTR)
+		{
+			std::cerr << "(EE) pqiReactorThread: epoll_wait() failed: " << strerror(errno) << std::endl;
+			std::this_thread::sleep_for(std::chrono::milliseconds(pqiReactor::TIMER_PERIOD_MS)) ;
+		}
+		n = 0 ;
+	}
+
+	bool woken_up = false ;
+
+	for(int i=0;i<n;++i)
+	{
+		pqiReactorClient *client = static_cast<pqiReactorClient*>(events[i].data.ptr) ;
+
+		if(client == NULL)
+		{
+			uint64_t count ;
+			if(read(mEventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+				std::cerr << "(EE) pqiReactorThread: cannot read eventfd: " << strerror(errno) << std::endl;
+
+			woken_up = true ;
+			continue ;
+		}
+
+		// Clients are only removed in processCommands(), before waiting, so the pointer is valid.
+
+		std::map<pqiReactorClient*, ClientState>::iterator it = mClients.find(client) ;
+
+		if(it == mClients.end())
+			continue ;
+
+#ifdef DEBUG_PQIREACTOR
+		std::cerr << "pqiReactorThread: fd " << it->second.fd << " readable." << std::endl;
+#endif
+		serviceRecv(client, it->second) ;
+		client->reactorSend() ;	// replies are often queued while handling incoming items
+	}
+
+	if(woken_up)
+	{
+		std::set<pqiReactorClient*> wakeups ;
+		{
+			RS_STACK_MUTEX(mThreadMtx) ;
+
+			wakeups.swap(mWakeUps) ;
+			mSignalled = false ;
+		}
+
+		for(std::set<pqiReactorClient*>::const_iterator it(wakeups.begin());it!=wakeups.end();++it)
+			if(mClients.find(*it) != mClients.end())
+				(*it)->reactorSend() ;
+	}
+
+	now = rstime::RsScopeTimer::currentTime() ;
+
+	if(now >= mNextTimerTS)
+	{
+		timerTick() ;
+
+		// Don't try to catch up with missed periods: this is not a clock.
+
+		mNextTimerTS = std::max(mNextTimerTS + pqiReactor::TIMER_PERIOD_MS / 1000.0, now) ;
+	}
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(pqiReactor::TIMER_PERIOD_MS)) ;
+#endif
+}
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * libretroshare/src/pqi: pqireactor.h                                         *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "util/rsthreads.h"
+
+class pqiReactorThread ;
+
+/*!
+ * \brief The pqiReactorClient class
+ * 		A connection serviced by the pqiReactor. All methods are called from a single reactor thread.
+ */
+class pqiReactorClient
+{
+public:
+	virtual ~pqiReactorClient() {}
+
+	/// True when the connection is established and should be serviced.
+	virtual bool reactorIsActive() = 0;
+
+	/// Descriptor to wait on for incoming data, or -1 if the transport has no kernel socket
+	/// (e.g. TCP-over-UDP), in which case the connection is polled on each timer period.
+	virtual int  reactorFd() = 0;
+
+	/// Reads and dispatches incoming data. Returns true when reading stopped on the incoming
+	/// rate limit, so that the descriptor is only watched again on the next timer period.
+	virtual bool reactorRecv() = 0;
+
+	/// Sends whatever the outgoing queue and the rate limit allow.
+	virtual void reactorSend() = 0;
+
+	/// Called once per timer period, before anything else.
+	virtual void reactorTimer() = 0;
+};
+
+/*!
+ * \brief The pqiReactor class
+ * 		Services the peer connections from a small fixed pool of threads, waiting on socket
+ * 		readiness (epoll) instead of running one polling thread per connection.
+ *
+ * 		Framing, QoS and rate limits are still handled by each pqistreamer: the reactor only
+ * 		decides when to call it. Incoming data is read as soon as the socket becomes readable,
+ * 		outgoing data as soon as an item is queued, and everything (rates, polled transports,
+ * 		throttled connections) is serviced at least once per timer period, which matches the
+ * 		sleep period of pqithreadstreamer.
+ *
+ * 		The reactor is disabled by default. It is enabled at startup with setThreadCount(), and
+ * 		is only available on Linux. Connections attached before that keep their own thread.
+ */
+class pqiReactor
+{
+public:
+	static const uint32_t MAX_THREADS = 16 ;
+	static const uint32_t TIMER_PERIOD_MS = 30 ;
+
+	/// Number of I/O threads to use. 0 (the default) keeps one thread per connection.
+	static void setThreadCount(uint32_t n) ;
+	static bool enabled() ;
+
+	/// Starts servicing the client. Can be called again after detach().
+	static void attach(pqiReactorClient *client) ;
+
+	/// Stops servicing the client. When wait is true, returns once the reactor will not call the
+	/// client anymore, unless called from the reactor thread itself (e.g. a connection reset
+	/// while reading), in which case the client is dropped when the current call returns.
+	static void detach(pqiReactorClient *client, bool wait) ;
+
+	/// Asks for reactorSend() to be called soon. Thread safe, cheap to call for every item.
+	static void wakeUp(pqiReactorClient *client) ;
+
+	/// Stops all threads. Clients still attached are dropped.
+	static void shutdown() ;
+
+private:
+	static pqiReactorThread *locked_threadFor(pqiReactorClient *client, bool create) ;
+
+	static RsMutex mReactorMtx ;
+	static uint32_t mThreadCount ;
+	static std::vector<pqiReactorThread*> mThreads ;
+	static std::map<pqiReactorClient*, pqiReactorThread*> mClientThreads ;
+};
+
+/*!
+ * \brief The pqiReactorThread class
+ * 		One thread of the reactor, with its own epoll set and clients.
+ */
+class pqiReactorThread: public RsTickingThread
+{
+public:
+	pqiReactorThread() ;
+	~pqiReactorThread() override ;
+
+	bool init() ;
+
+	void attach(pqiReactorClient *client) ;
+	void detach(pqiReactorClient *client, bool wait) ;
+	void wakeUp(pqiReactorClient *client) ;
+
+	uint32_t nbClients() ;
+
+	void threadTick() override; /// @see RsTickingThread
+
+private:
+	struct ClientState
+	{
+		ClientState() : fd(-1), recv_deferred(false) {}
+
+		int  fd ;				// descriptor currently registered in the epoll set, or -1
+		bool recv_deferred ;	// reading stopped on the rate limit, resume on next timer period
+	};
+
+	enum { CMD_ATTACH = 1, CMD_DETACH = 2 } ;
+
+	void signal() ;
+	void processCommands() ;
+	void timerTick() ;
+	void serviceRecv(pqiReactorClient *client, ClientState& state) ;
+	void arm(pqiReactorClient *client, ClientState& state) ;
+	void unregister(ClientState& state) ;
+	bool onReactorThread() ;
+
+	int mEpollFd ;
+	int mEventFd ;
+	double mNextTimerTS ;
+	uint32_t mNbPeriods ;
+
+	// owned by the reactor thread
+
+	std::map<pqiReactorClient*, ClientState> mClients ;
+
+	// shared with other threads
+
+	RsMutex mThreadMtx ;
+	std::condition_variable_any mCommandsDoneCv ;	// signaled when commands have been processed
+	std::list<std::pair<pqiReactorClient*, int> > mCommands ;
+	std::set<pqiReactorClient*> mAttached ;	// clients of mClients, as seen from other threads
+	std::set<pqiReactorClient*> mWakeUps ;
+	bool mSignalled ;		// eventfd written, not read yet
+	bool mThreadIdSet ;
+	pthread_t mThreadId ;
+};
@@ -22,6 +22,7 @@
 #include "pqi/pqiservice.h"
 #include "util/rsdebug.h"
 #include "util/rsstring.h"
+#include "util/rsperfstats.h"
 
 #ifdef  SERVICE_DEBUG
 const int pqiservicezone = 60478;
@@ -75,6 +76,7 @@ int	p3ServiceServer::addService(pqiService *ts, bool defaultOn)
 
 	ts->setServiceServer(this);
 	services[info.mServiceType] = ts;
+	mTickCounters[info.mServiceType] = &RsPerfStats::counter("p3ServiceServer::tick/" + info.mServiceName);
 
 	// This doesn't need to be in Mutex.
 	mServiceControl->registerService(info,defaultOn);
@@ -118,6 +120,7 @@ int p3ServiceServer::removeService(pqiService *ts)
 	}
 
 	services.erase(it);
+	mTickCounters.erase(info.mServiceType);
 
 	return 1;
 }
@@ -187,14 +190,17 @@ int	p3ServiceServer::tick()
 
 	// make a copy of the service map
 	std::map<uint32_t,pqiService *> local_map;
+	std::map<uint32_t,RsPerfCounter *> local_counters;
 	{	
 		RS_STACK_MUTEX(srvMtx);
 		local_map=services;
+		local_counters=mTickCounters;
 	}
 
 	// tick all services off mutex
 	for(auto it(local_map.begin());it!=local_map.end();++it)
 	{
+		RsPerfScope scope(*local_counters[it->first], true);
 		(it->second)->tick();
 	}
 
@@ -51,6 +51,7 @@
 
 class RsRawItem;
 class p3ServiceServerIface;
+class RsPerfCounter;
 
 
 class pqiService
@@ -123,6 +124,7 @@ private:
 
 	RsMutex srvMtx;
 	std::map<uint32_t, pqiService *> services;
+	std::map<uint32_t, RsPerfCounter *> mTickCounters;	// per service tick duration, never deleted
 
 };
 
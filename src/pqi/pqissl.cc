@@ -1513,6 +1513,28 @@ int 	pqissl::senddata(void *data, int len)
 	return tmppktlen;
 }
 
+int pqissl::senddatav(const std::vector<BinSlice>& slices)
+{
+	// A single slice is written in place. On a partial send the streamer passes
+	// the same slices again, hence the same buffer as SSL_write() requires.
+	if(slices.size() == 1)
+		return senddata(const_cast<uint8_t*>(slices[0].data()), slices[0].size);
+
+	// SSL has no vectored write, so gather into a buffer that is only
+	// reallocated when it needs to grow. A retry has the same total size, so
+	// the data stays at the same address between retries.
+	size_t len = 0;
+	for(const BinSlice& s: slices) len += s.size;
+
+	mSendGatherBuf.clear();
+	mSendGatherBuf.reserve(len);
+
+	for(const BinSlice& s: slices)
+		mSendGatherBuf.insert(mSendGatherBuf.end(), s.data(), s.data() + s.size);
+
+	return senddata(mSendGatherBuf.data(), len);
+}
+
 int pqissl::readdata(void *data, int len)
 {
 	RS_STACK_MUTEX(mSslMtx);
@@ -1707,6 +1729,12 @@ int 	pqissl::isactive()
     return active;	// no need to mutex this. It's atomic.
 }
 
+int 	pqissl::pollableFd()
+{
+	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
+	return sockfd;
+}
+
 bool 	pqissl::moretoread(uint32_t usec)
 {
 	RsStackMutex stack(mSslMtx); /**** LOCKED MUTEX ****/
@@ -165,6 +165,7 @@ virtual int	tick();
 virtual int     status();
 
 virtual int senddata(void*, int);
+virtual int senddatav(const std::vector<BinSlice>& slices);
 virtual int readdata(void*, int);
 virtual int netstatus();
 virtual int isactive();
@@ -174,6 +175,7 @@ virtual bool cansend(uint32_t usec);
 virtual int close(); /* BinInterface version of reset() */
 virtual RsFileHash gethash(); /* not used here */
 virtual bool bandwidthLimited() { return true ; }
+virtual int pollableFd();
 
 public:
 
@@ -254,6 +256,8 @@ bool  	CheckConnectionTimeout();
 	int pktlen;
 	int total_len ; // saves the reading state accross successive calls.
 
+	std::vector<uint8_t> mSendGatherBuf; // contiguous copy of the slices given to senddatav()
+
 	int attempt_ts;
 
 	int n_read_zero; /* a counter to determine if the connection is really dead */
@@ -55,6 +55,7 @@ public:
 	virtual bool cansend(uint32_t usec);
 	/* UDP always through firewalls -> always bandwidth Limited */
 	virtual bool bandwidthLimited() { return true; }
+	virtual int pollableFd() { return -1; } // TOU sockets live in userspace
 
 protected:
 
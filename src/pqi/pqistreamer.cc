@@ -25,7 +25,7 @@
 #include <stdlib.h>               // for free, realloc, exit
 #include <string.h>               // for memcpy, memset, memcmp
 #include "util/rstime.h"                 // for NULL, time, rstime_t
-#include <algorithm>              // for min
+#include <algorithm>              // for min, max
 #include <iostream>               // for operator<<, ostream, basic_ostream
 #include <string>                 // for string, allocator, operator<<, oper...
 #include <utility>                // for pair
@@ -97,7 +97,7 @@ static double getCurrentTS()
 pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
 	:PQInterface(id), mStreamerMtx("pqistreamer"),
 	mBio(bio_in), mBio_flags(bio_flags_in), mRsSerialiser(rss), 
-	mPkt_wpending(NULL), mPkt_wpending_size(0),
+	mPkt_wpending_size(0),
 	mTotalRead(0), mTotalSent(0),
 	mCurrRead(0), mCurrSent(0),
 	mAvgReadCount(0), mAvgSentCount(0),
@@ -125,6 +125,7 @@ pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bi
 	mPkt_rpend_size = 0;
 	mPkt_rpending = 0;
 	mReading_state = reading_state_initial ;
+	mReadQuotaReached = false ;
 
 	pqioutput(PQL_DEBUG_ALL, pqistreamerzone, "pqistreamer::pqistreamer() Initialisation!");
 
@@ -136,6 +137,9 @@ pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bi
 
 	mFailed_read_attempts = 0;  // reset failed read, as no packet is still read.
 
+	for(uint32_t i=0;i<PQISTREAM_SEND_RING_LEVELS;++i)
+		mSendRings[i].reset(new RsMpscRing<OutgoingPacket>(PQISTREAM_SEND_RING_SIZE)) ;
+
 	return;
 }
 
@@ -192,9 +196,86 @@ int	pqistreamer::SendItem(RsItem *si,uint32_t& out_size)
 	}
 #endif
 
-	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
-	
-	return queue_outpqi_locked(si,out_size);
+	// Serialisation is done by the calling thread, without holding mStreamerMtx.
+
+	out_size = mRsSerialiser->size(si);
+	void *ptr = rs_malloc(out_size);
+
+	if(ptr == NULL)
+		return 0 ;
+
+#ifdef DEBUG_PQISTREAMER
+	std::cerr << "pqistreamer::SendItem() serializing packet with packet size : " << out_size << std::endl;
+#endif
+
+	if (!mRsSerialiser->serialise(si, ptr, &out_size))
+	{
+		/* cleanup serialiser */
+		free(ptr);
+
+		std::string out = "pqistreamer::SendItem() Null Pkt generated!\nCaused By:\n";
+		si -> print_string(out);
+		pqioutput(PQL_ALERT, pqistreamerzone, out);
+
+		if (!(mBio_flags & BIN_FLAGS_NO_DELETE))
+			delete si;
+
+		return 1; // keep error internal.
+	}
+
+	OutgoingPacket pkt ;
+	pkt.data = ptr ;
+	pkt.size = out_size ;
+	pkt.service_id = si->PacketService() ;
+	pkt.service_sub_id = si->PacketSubType() ;
+
+	uint32_t priority = std::min(uint32_t(si->priority_level()), PQISTREAM_SEND_RING_LEVELS-1) ;
+
+	if (!(mBio_flags & BIN_FLAGS_NO_DELETE))
+		delete si;
+
+	if(!mSendRings[priority]->push(pkt))
+	{
+		// Ring is full: the streamer thread is late. Queue directly, after what is in the rings so that
+		// packets from a given sender are not re-ordered.
+
+		RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+
+		locked_drainSendRings();
+		locked_storeOutgoingPacket(pkt,priority);
+	}
+	return 1;
+}
+
+void pqistreamer::locked_drainSendRings()
+{
+	OutgoingPacket pkt ;
+
+	for(int priority=PQISTREAM_SEND_RING_LEVELS-1;priority>=0;--priority)
+		while(mSendRings[priority]->pop(pkt))
+			locked_storeOutgoingPacket(pkt,priority) ;
+}
+
+void pqistreamer::locked_storeOutgoingPacket(const OutgoingPacket& pkt,int priority)
+{
+	/*******************************************************************************************/
+	// keep info for stats for a while. Only keep the items for the last two seconds. sec n is ongoing and second n-1
+	// is a full statistics chunk that can be used in the GUI
+
+	locked_addTrafficClue(pkt.service_id,pkt.service_sub_id,priority,pkt.size,mCurrentStatsChunk_Out) ;
+
+	/*******************************************************************************************/
+
+	locked_storeInOutputQueue(pkt.data,pkt.size,priority) ;
+}
+
+void pqistreamer::locked_clearSendRings()
+{
+	OutgoingPacket pkt ;
+
+	for(uint32_t i=0;i<PQISTREAM_SEND_RING_LEVELS;++i)
+		while(mSendRings[i]->pop(pkt))
+			free(pkt.data) ;
 }
 
 RsItem *pqistreamer::GetItem()
@@ -306,6 +387,8 @@ int 	pqistreamer::tick_bio()
 
 int 	pqistreamer::tick_recv(uint32_t timeout)
 {
+	mReadQuotaReached = false;
+
 	if (mBio->moretoread(timeout))
 	{
 		handleincoming();
@@ -363,60 +446,6 @@ void pqistreamer::locked_storeInOutputQueue(void *ptr,int,int)
 	mOutPkts.push_back(ptr);
 }
 
-int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
-{
-	pktsize = 0 ;
-#ifdef DEBUG_PQISTREAMER
-        std::cerr << "pqistreamer::queue_outpqi() called." << std::endl;
-#endif
-
-	/* decide which type of packet it is */
-
-	pktsize = mRsSerialiser->size(pqi);
-	void *ptr = rs_malloc(pktsize);
-    
-    	if(ptr == NULL)
-            return 0 ;
-
-#ifdef DEBUG_PQISTREAMER
-	std::cerr << "pqistreamer::queue_outpqi() serializing packet with packet size : " << pktsize << std::endl;
-#endif
-
-        /*******************************************************************************************/
-    	// keep info for stats for a while. Only keep the items for the last two seconds. sec n is ongoing and second n-1
-    	// is a full statistics chunk that can be used in the GUI
-
-    	locked_addTrafficClue(pqi,pktsize,mCurrentStatsChunk_Out) ;
-
-        /*******************************************************************************************/
-
-	if (mRsSerialiser->serialise(pqi, ptr, &pktsize))
-	{
-		locked_storeInOutputQueue(ptr,pktsize,pqi->priority_level()) ;
-
-		if (!(mBio_flags & BIN_FLAGS_NO_DELETE))
-		{
-			delete pqi;
-		}
-		return 1;
-	}
-	else
-	{
-		/* cleanup serialiser */
-		free(ptr);
-	}
-
-	std::string out = "pqistreamer::queue_outpqi() Null Pkt generated!\nCaused By:\n";
-	pqi -> print_string(out);
-	pqioutput(PQL_ALERT, pqistreamerzone, out);
-
-	if (!(mBio_flags & BIN_FLAGS_NO_DELETE))
-	{
-		delete pqi;
-	}
-	return 1; // keep error internal.
-}
-
 int 	pqistreamer::handleincomingitem(RsItem *pqi,int len)
 {
 
@@ -447,6 +476,11 @@ int 	pqistreamer::handleincomingitem(RsItem *pqi,int len)
 }
 
 void pqistreamer::locked_addTrafficClue(const RsItem *pqi,uint32_t pktsize,std::list<RSTrafficClue>& lst)
+{
+    locked_addTrafficClue(pqi->PacketService(),pqi->PacketSubType(),pqi->priority_level(),pktsize,lst) ;
+}
+
+void pqistreamer::locked_addTrafficClue(uint16_t service_id,uint8_t service_sub_id,int priority,uint32_t pktsize,std::list<RSTrafficClue>& lst)
 {
     rstime_t now = time(NULL) ;
 
@@ -463,11 +497,11 @@ void pqistreamer::locked_addTrafficClue(const RsItem *pqi,uint32_t pktsize,std::
     RSTrafficClue tc ;
     tc.TS = now ;
     tc.size = pktsize ;
-    tc.priority = pqi->priority_level() ;
-    tc.peer_id = pqi->PeerId() ;
+    tc.priority = priority ;
+    tc.peer_id = PeerId() ;
     tc.count = 1 ;
-    tc.service_id = pqi->PacketService() ;
-    tc.service_sub_id = pqi->PacketSubType() ;
+    tc.service_id = service_id ;
+    tc.service_sub_id = service_sub_id ;
 
     lst.push_back(tc) ;
 }
@@ -519,6 +553,9 @@ int	pqistreamer::handleoutgoing_locked()
 
     std::list<void *>::iterator it;
 
+    // collect what was sent since last time. Also when not active, so that these packets are cleared below.
+    locked_drainSendRings();
+
     // if not connection, or cannot send anything... pause.
     if (!(mBio->isactive()))
     {
@@ -530,12 +567,8 @@ int	pqistreamer::handleoutgoing_locked()
         	mAcceptsPacketSlicing = false ;
 
 	    /* also remove the pending packets */
-	    if (mPkt_wpending)
-	    {
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    	mPkt_wpending_size = 0 ;
-	    }
+	    mPkt_wpending.clear();
+	    mPkt_wpending_size = 0 ;
 
 	    return 0;
     }
@@ -562,9 +595,9 @@ int	pqistreamer::handleoutgoing_locked()
             //	- grab as many packets as possible while below the optimal packet size, so as to allow some packing and decrease encryption padding overhead (suposeddly)
             //	- limit packets size to OPTIMAL_PACKET_SIZE when sending big packets so as to keep as much QoS as possible.
         
-	    if (!mPkt_wpending)
+	    if (mPkt_wpending.empty())
 	{
-		void *dta;
+		BinSlice dta;
 		mPkt_wpending_size = 0 ;
 		int k=0;
 
@@ -578,35 +611,35 @@ int	pqistreamer::handleoutgoing_locked()
                 	std::cerr << "(II) Inserting packet slicing probe in traffic" << std::endl;
 #endif
                     
+                    	// static buffer: use an empty owner so that it never gets freed.
+                    	mPkt_wpending.push_back(BinSlice(std::shared_ptr<uint8_t>(std::shared_ptr<uint8_t>(),PACKET_SLICING_PROBE_BYTES),0,8)) ;
                     	mPkt_wpending_size = 8 ;
-                    	mPkt_wpending = rs_malloc(8) ;
-                        memcpy(mPkt_wpending,PACKET_SLICING_PROBE_BYTES,8) ;
                         
                 	mLastSentPacketSlicingProbe = now ;
         	}
             
-        	uint32_t slice_size=0;
 		bool slice_starts=true ;
 		bool slice_ends=true ;
 		uint32_t slice_packet_id=0 ;
 
+		// Slices are views on the queued packets, so that nothing gets copied here. Partial slices are
+		// preceded by their own small header buffer.
+
 		do
 		{
             		int desired_packet_size = mAcceptsPacketSlicing?PQISTREAM_OPTIMAL_PACKET_SIZE:(getRsPktMaxSize());
                     
-			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
-
-			if(!dta)
+			if(!locked_pop_out_data(desired_packet_size,dta,slice_starts,slice_ends,slice_packet_id))
 				break ;
 
+			uint32_t slice_size = dta.size ;
+
 			if(slice_starts && slice_ends)	// good old method. Send the packet as is, since it's a full packet.
 			{
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
-				free(dta);
+				mPkt_wpending.push_back(dta) ;
 				mPkt_wpending_size += slice_size ;
 				++k ;
 			}
@@ -615,17 +648,14 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
-					free(mPkt_wpending) ;
+					mPkt_wpending.clear() ;
 					mPkt_wpending_size = 0;
 					return -1 ;
 				}
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice_size << std::endl;
 #endif
-
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
-				free(dta);
+				std::shared_ptr<uint8_t> header(new uint8_t[PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],std::default_delete<uint8_t[]>()) ;
 
 				// New2: pp ff xxxxxxxx ssss  [data, sss bytes] => [flags 1B] [protocol version 1B] [2^32 packet count] [2^16 size]
 
@@ -633,14 +663,17 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_starts) partial_flags |= PQISTREAM_SLICE_FLAG_STARTS  ;
 				if(slice_ends  ) partial_flags |= PQISTREAM_SLICE_FLAG_ENDS  ;
 
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x01] = partial_flags ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x06] = uint8_t(slice_size      >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x07] = uint8_t(slice_size      >>  0) & 0xff ;
+				header.get()[0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
+				header.get()[0x01] = partial_flags ;
+				header.get()[0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
+				header.get()[0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
+				header.get()[0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
+				header.get()[0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
+				header.get()[0x06] = uint8_t(slice_size      >>  8) & 0xff ;
+				header.get()[0x07] = uint8_t(slice_size      >>  0) & 0xff ;
+
+				mPkt_wpending.push_back(BinSlice(header,0,PQISTREAM_PARTIAL_PACKET_HEADER_SIZE)) ;
+				mPkt_wpending.push_back(dta) ;
 
 				mPkt_wpending_size += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
 				++k ;
@@ -654,7 +687,7 @@ int	pqistreamer::handleoutgoing_locked()
 #endif
 	}
         
-	    if (mPkt_wpending)
+	    if (!mPkt_wpending.empty())
 	    {
 		    // write packet.
 #ifdef DEBUG_PQISTREAMER
@@ -662,7 +695,7 @@ int	pqistreamer::handleoutgoing_locked()
 #endif
             		int ss=0;
 
-		    if (mPkt_wpending_size != (uint32_t)(ss = mBio->senddata(mPkt_wpending, mPkt_wpending_size)))
+		    if (mPkt_wpending_size != (uint32_t)(ss = mBio->senddatav(mPkt_wpending)))
 		    {
 #ifdef DEBUG_PQISTREAMER
 			    std::string out;
@@ -692,8 +725,7 @@ int	pqistreamer::handleoutgoing_locked()
 
 		    sentbytes += mPkt_wpending_size;
             
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
+		    mPkt_wpending.clear();
 		    mPkt_wpending_size = 0 ;
 
             sent = true;
@@ -1021,6 +1053,8 @@ continue_packet:
     if(maxin > readbytes && mBio->moretoread(0))
 	    goto start_packet_read ;
 
+    mReadQuotaReached = (readbytes >= maxin);
+
 #ifdef DEBUG_PQISTREAMER
 	if (readbytes > maxin)
 		RsDbg() << "PQISTREAMER pqistreamer::handleincoming() stopped reading max reached, readbytes " << std::dec << readbytes << " maxin " << maxin;
@@ -1167,7 +1201,9 @@ int     pqistreamer::outAllowedBytes_locked()
 	// now calculate the amount of data allowed to be sent during the next round
 	// we take into account the possible excess (but not deficit) of the previous round
 	// (this is handled differently when reading data, see below)
-	double quota = mAvgDtOut * maxout - mCurrSent;
+	// Rounds are not regular when driven by pqiReactor: a round following a long pause
+	// gets the elapsed time, otherwise frequent short rounds would starve later ones.
+	double quota = std::max(mAvgDtOut, dt) * maxout - mCurrSent;
 
 #ifdef DEBUG_PQISTREAMER
 	RsDbg() << "PQISTREAMER pqistreamer::outAllowedBytes_locked() dt " << std::dec << (int)(1000 * dt) << "ms, mAvgDtOut " << (int)(1000 * mAvgDtOut) << "ms, maxout " << (int)(maxout) << " bytes/s, mCurrSent " << mCurrSent << " bytes, quota " << (int)(quota) << " bytes";
@@ -1204,15 +1240,18 @@ int     pqistreamer::inAllowedBytes()
 	mCurrRead -= int(dt * maxin);
 
 	// we allow negative value up to the average amount of data received during one round
+	// (or the elapsed time, if longer, see outAllowedBytes_locked())
 	// in that case we will use this credit during the next around
-	if (mCurrRead < - mAvgDtIn * maxin)
-		mCurrRead = - mAvgDtIn * maxin;
+	double round_dt = std::max(mAvgDtIn, dt);
+
+	if (mCurrRead < - round_dt * maxin)
+		mCurrRead = - round_dt * maxin;
 
 	mCurrReadTS = t;
 
 	// we now calculate the max amount of data allowed to be received during the next round
 	// we take into account the excess/deficit of the previous round
-	double quota = mAvgDtIn * maxin - mCurrRead;
+	double quota = round_dt * maxin - mCurrRead;
 
 #ifdef DEBUG_PQISTREAMER
 	RsDbg() << "PQISTREAMER pqistreamer::inAllowedBytes() dt " << std::dec << (int)(1000 * dt) << "ms, mAvgDtIn " << (int)(1000 * mAvgDtIn) << "ms, maxin " << (int)(maxin) << " bytes/s, mCurrRead " << mCurrRead << " bytes, quota " << (int)(quota) << " bytes";
@@ -1308,13 +1347,12 @@ void pqistreamer::free_pend()
 	}
 	mPkt_rpend_size = 0;
 
-	if (mPkt_wpending)
+	if (!mPkt_wpending.empty())
 	{
 #ifdef DEBUG_PQISTREAMER
         		std::cerr << "pqistreamer::free_pend(): pending output packet buffer" << std::endl;
 #endif
-		free(mPkt_wpending);
-		mPkt_wpending = NULL;
+		mPkt_wpending.clear();
 	}
 	mPkt_wpending_size = 0 ;
 
@@ -1330,6 +1368,7 @@ void pqistreamer::free_pend()
     
 	// clean up outgoing. (cntrl packets)
 	locked_clear_out_queue() ;
+	locked_clearSendRings() ;
 }
 
 int     pqistreamer::gatherStatistics(std::list<RSTrafficClue>& outqueue_lst,std::list<RSTrafficClue>& inqueue_lst)
@@ -1348,7 +1387,7 @@ int     pqistreamer::getQueueSize(bool in)
 	else
 	{
 		RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
-		return locked_out_queue_size();
+		return locked_out_queue_size() + pendingSendRingsSize();
 	}
 }
 
@@ -1376,6 +1415,24 @@ void    pqistreamer::getRates(RsBwRates &rates)
 		RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
 		rates.mQueueOut = locked_out_queue_size();
 	}
+
+	// lock-free hand-off from senders: not drained yet, and contention between senders
+	rates.mSendContention = 0;
+
+	rates.mQueueOutPending = pendingSendRingsSize();
+
+	for(uint32_t i=0;i<PQISTREAM_SEND_RING_LEVELS;++i)
+		rates.mSendContention += mSendRings[i]->retries() + mSendRings[i]->overflows();
+}
+
+uint32_t pqistreamer::pendingSendRingsSize() const
+{
+	uint32_t n = 0;
+
+	for(uint32_t i=0;i<PQISTREAM_SEND_RING_LEVELS;++i)
+		n += mSendRings[i]->size();
+
+	return n;
 }
 
 // this method is overloaded by pqiqosstreamer
@@ -1423,9 +1480,8 @@ int pqistreamer::locked_gatherStatistics(std::list<RSTrafficClue>& out_lst,std::
 }
 
 // this method is overloaded by pqiqosstreamer
-void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
+bool pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, BinSlice& slice, bool &starts, bool &ends, uint32_t &packet_id)
 {
-    size = 0 ;
     starts = true ;
     ends = true ;
     packet_id = 0 ;
@@ -1438,13 +1494,13 @@ void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &si
 		mOutPkts.pop_front();
 
         // In pqistreamer, we do not split outgoing packets. For now only pqiQoSStreamer supports packet slicing.
-        size = getRsItemSize(res);
+        slice = BinSlice(std::shared_ptr<uint8_t>((uint8_t*)res,free),0,getRsItemSize(res));
 
 #ifdef DEBUG_TRANSFERS
         std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt " << std::hex << res << std::dec << " from mOutPkts queue";
 		std::cerr << std::endl;
 #endif
 	}
-	return res ;
+	return res != NULL ;
 }
 
@@ -27,11 +27,13 @@
 #include <iostream>               // for operator<<, basic_ostream, cerr, endl
 #include <list>                   // for list
 #include <map>                    // for map
+#include <memory>                 // for unique_ptr
 
 #include "pqi/pqi_base.h"         // for BinInterface (ptr only), PQInterface
 #include "retroshare/rsconfig.h"  // for RSTrafficClue
 #include "retroshare/rstypes.h"   // for RsPeerId
 #include "util/rsthreads.h"       // for RsMutex
+#include "util/rsmpscring.h"      // for RsMpscRing
 
 struct RsItem;
 class RsSerialiser;
@@ -86,6 +88,7 @@ class pqistreamer: public PQInterface
 		int tick_bio();
 		int tick_send(uint32_t timeout);
 		int tick_recv(uint32_t timeout);
+		bool readQuotaReached() const { return mReadQuotaReached; } // last tick_recv() stopped on the incoming rate limit
 
 		/* Implementation */
 
@@ -95,7 +98,7 @@ class pqistreamer: public PQInterface
 		virtual int locked_out_queue_size() const ;
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const ;
-		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		virtual bool locked_pop_out_data(uint32_t max_slice_size,BinSlice& slice,bool& starts,bool& ends,uint32_t& packet_id);
 		virtual int   locked_gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
 
         	void updateRates() ;
@@ -107,8 +110,27 @@ class pqistreamer: public PQInterface
 		BinInterface *mBio;
 		unsigned int  mBio_flags; // BIN_FLAGS_NO_CLOSE | BIN_FLAGS_NO_DELETE
 
+		// Packets pushed by SendItem() that the streamer thread did not move to the output queue yet.
+		uint32_t pendingSendRingsSize() const;
+
 	private:
-		int queue_outpqi_locked(RsItem *i,uint32_t& serialized_size);
+		// Serialized packet handed over from SendItem() to the streamer thread.
+		struct OutgoingPacket
+		{
+			void *data ;
+			uint32_t size ;
+			uint16_t service_id ;	// kept for traffic statistics
+			uint8_t  service_sub_id ;
+		};
+
+		static const uint32_t PQISTREAM_SEND_RING_LEVELS = 10 ;		// one ring per QoS priority level
+		static const uint32_t PQISTREAM_SEND_RING_SIZE   = 128 ;	// packets per ring
+
+		// Moves packets pushed by SendItem() into the output queue, highest priority first.
+		void locked_drainSendRings();
+		void locked_storeOutgoingPacket(const OutgoingPacket& pkt, int priority);
+		void locked_clearSendRings();
+
 		int handleincomingitem(RsItem *i, int len);
 
 		// ticked regularly (manages out queues and sending
@@ -131,8 +153,8 @@ class pqistreamer: public PQInterface
 		// RsSerialiser - determines which packets can be serialised.
 		RsSerialiser *mRsSerialiser;
 
-		void *mPkt_wpending; // storage for pending packet to write.
-        	uint32_t mPkt_wpending_size; // ... and its size.
+		std::vector<BinSlice> mPkt_wpending; // pending slices to write, sent as a whole with senddatav().
+        	uint32_t mPkt_wpending_size; // ... and their total size.
 
 		void allocate_rpend(); // use these two functions to allocate/free the buffer below
         
@@ -143,6 +165,7 @@ class pqistreamer: public PQInterface
 
 		int   mReading_state ;
 		int   mFailed_read_attempts ;
+		bool  mReadQuotaReached ;
 
 		// Temp Storage for transient data.....
 		std::list<void *> mOutPkts; // Cntrl / Search / Results queue
@@ -182,9 +205,15 @@ class pqistreamer: public PQInterface
 		bool mAcceptsPacketSlicing ;
 		rstime_t mLastSentPacketSlicingProbe ;
 		void locked_addTrafficClue(const RsItem *pqi, uint32_t pktsize, std::list<RSTrafficClue> &lst);
+		void locked_addTrafficClue(uint16_t service_id, uint8_t service_sub_id, int priority, uint32_t pktsize, std::list<RSTrafficClue> &lst);
 		RsItem *addPartialPacket(const void *block, uint32_t len, uint32_t slice_packet_id,bool packet_starting,bool packet_ending,uint32_t& total_len);
         
 		std::map<uint32_t,PartialPacketRecord> mPartialPackets ;
+
+		// Outgoing packets are serialized by the calling (service) thread and pushed into these lock-free
+		// rings, which the streamer thread drains. This way senders never wait for mStreamerMtx, which
+		// is held while writing to the network. The lock is only taken when a ring is full.
+		std::unique_ptr<RsMpscRing<OutgoingPacket> > mSendRings[PQISTREAM_SEND_RING_LEVELS] ;
 };
 
 #endif //MRK_PQI_STREAMER_HEADER
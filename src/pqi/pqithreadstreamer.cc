@@ -30,12 +30,55 @@
 // #define PQISTREAMER_DEBUG
 
 pqithreadstreamer::pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
-:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer")
+:pqistreamer(rss, id, bio_in, bio_flags_in), mParent(parent), mTimeout(0), mThreadMutex("pqithreadstreamer"),
+ mInReactor(false), mSendWakeUpPending(false)
 {
 	mTimeout = DEFAULT_STREAMER_TIMEOUT;
 	mSleepPeriod = DEFAULT_STREAMER_SLEEP;
 }
 
+pqithreadstreamer::~pqithreadstreamer()
+{
+	if(mInReactor)
+		pqiReactor::detach(this, true);
+}
+
+void pqithreadstreamer::startStreaming(const std::string& name)
+{
+	if(pqiReactor::enabled())
+	{
+		mInReactor = true;
+		pqiReactor::attach(this);
+	}
+	else
+		start(name);
+}
+
+void pqithreadstreamer::stopStreaming(bool wait)
+{
+	if(mInReactor)
+	{
+		pqiReactor::detach(this, wait);
+		mInReactor = false;
+	}
+	else if(wait)
+		fullstop();
+	else
+		askForStop();
+}
+
+int pqithreadstreamer::SendItem(RsItem *item, uint32_t& serialized_size)
+{
+	int ret = pqistreamer::SendItem(item, serialized_size);
+
+	// In reactor mode, nothing would send the item before the next timer period.
+
+	if(mInReactor && !mSendWakeUpPending.exchange(true))
+		pqiReactor::wakeUp(this);
+
+	return ret;
+}
+
 bool pqithreadstreamer::RecvItem(RsItem *item)
 {
 	return mParent->RecvItem(item);
@@ -99,3 +142,42 @@ void	pqithreadstreamer::threadTick()
 	}
 }
 
+bool pqithreadstreamer::reactorIsActive()
+{
+	RsStackMutex stack(mStreamerMtx);
+	return mBio->isactive();
+}
+
+int pqithreadstreamer::reactorFd()
+{
+	return mBio->pollableFd();
+}
+
+void pqithreadstreamer::reactorTimer()
+{
+	updateRates();
+}
+
+bool pqithreadstreamer::reactorRecv()
+{
+	bool quota_reached = false;
+	{
+		RsStackMutex stack(mThreadMutex);
+		tick_recv(0);
+		quota_reached = readQuotaReached();
+	}
+
+	RsItem *incoming = NULL;
+	while((incoming = GetItem()))
+		RecvItem(incoming);
+
+	return quota_reached;
+}
+
+void pqithreadstreamer::reactorSend()
+{
+	mSendWakeUpPending = false;
+
+	RsStackMutex stack(mThreadMutex);
+	tick_send(0);
+}
@@ -23,20 +23,41 @@
 #define MRK_PQI_THREAD_STREAMER_HEADER
 
 #include "pqi/pqistreamer.h"
+#include "pqi/pqireactor.h"
 #include "util/rsthreads.h"
 
-class pqithreadstreamer: public pqistreamer, public RsTickingThread
+#include <atomic>
+
+/**
+ * Runs a pqistreamer, either from its own thread or, when pqiReactor is enabled,
+ * from one of the shared reactor threads. Use startStreaming()/stopStreaming()
+ * rather than the RsThread methods so that both modes are handled.
+ */
+class pqithreadstreamer: public pqistreamer, public RsTickingThread, public pqiReactorClient
 {
 public:
     pqithreadstreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& peerid, BinInterface *bio_in, int bio_flagsin);
+    virtual ~pqithreadstreamer();
+
+    void startStreaming(const std::string& name);
+    void stopStreaming(bool wait);
 
     // from pqistreamer
+    using pqistreamer::SendItem;
+    virtual int  SendItem(RsItem *item, uint32_t& serialized_size) override;
     virtual bool RecvItem(RsItem *item) override;
     virtual int  tick() override;
 
 protected:
 	void threadTick() override; /// @see RsTickingThread
 
+	// pqiReactorClient
+	bool reactorIsActive() override;
+	int  reactorFd() override;
+	bool reactorRecv() override;
+	void reactorSend() override;
+	void reactorTimer() override;
+
     PQInterface *mParent;
     uint32_t mTimeout;
     uint32_t mSleepPeriod;
@@ -44,6 +65,9 @@ protected:
 private:
     /* thread variables */
     RsMutex mThreadMutex;
+
+    std::atomic<bool> mInReactor;		// serviced by pqiReactor instead of our own thread
+    std::atomic<bool> mSendWakeUpPending;	// reactor already asked to send, don't ask again
 };
 
 #endif //MRK_PQI_THREAD_STREAMER_HEADER
@@ -27,6 +27,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 /* The New Config Interface Class */
 class RsServerConfig;
@@ -149,7 +150,8 @@ struct RsConfigDataRates : RsSerializable
 	    mAllocTs(0),
 	    mRateOut(0), mRateMaxOut(0), mAllowedOut(0),
 	    mAllowedTs(0),
-	    mQueueIn(0), mQueueOut(0)
+	    mQueueIn(0), mQueueOut(0),
+	    mQueueOutPending(0), mSendContention(0)
 	{}
 
 	/* all in kB/s */
@@ -168,6 +170,11 @@ struct RsConfigDataRates : RsSerializable
 	int	mQueueIn;
 	int	mQueueOut;
 
+	/// outgoing items handed over by services but not yet queued for sending
+	int	mQueueOutPending;
+	/// contention counter of the lock-free outgoing queues (sender retries and overflows)
+	uint64_t mSendContention;
+
 	// RsSerializable interface
 	void serial_process(RsGenericSerializer::SerializeJob j, RsGenericSerializer::SerializeContext &ctx) {
 		RS_SERIAL_PROCESS(mRateIn);
@@ -184,6 +191,9 @@ struct RsConfigDataRates : RsSerializable
 
 		RS_SERIAL_PROCESS(mQueueIn);
 		RS_SERIAL_PROCESS(mQueueOut);
+
+		RS_SERIAL_PROCESS(mQueueOutPending);
+		RS_SERIAL_PROCESS(mSendContention);
 	}
 };
 
@@ -212,6 +222,43 @@ struct RSTrafficClue : RsSerializable
 	}
 };
 
+/**
+ * Summary of a latency histogram kept for an instrumented hot path (service
+ * tick, queue wait...) since the counters were last reset. Durations are in
+ * microseconds, percentiles are accurate to about 6%.
+ */
+struct RsPerfCounterStats : RsSerializable
+{
+	RsPerfCounterStats() :
+	    since(0), count(0), totalUs(0), cpuUs(0), maxUs(0),
+	    p50Us(0), p90Us(0), p99Us(0), p999Us(0) {}
+
+	std::string name;
+	rstime_t since;    /// time of the last reset
+	uint64_t count;    /// number of samples
+	uint64_t totalUs;  /// sum of all samples
+	uint64_t cpuUs;    /// CPU time of the calling thread, for ticks. 0 otherwise
+	uint64_t maxUs;
+	uint64_t p50Us;
+	uint64_t p90Us;
+	uint64_t p99Us;
+	uint64_t p999Us;
+
+	// RsSerializable interface
+	void serial_process(RsGenericSerializer::SerializeJob j, RsGenericSerializer::SerializeContext &ctx) {
+		RS_SERIAL_PROCESS(name);
+		RS_SERIAL_PROCESS(since);
+		RS_SERIAL_PROCESS(count);
+		RS_SERIAL_PROCESS(totalUs);
+		RS_SERIAL_PROCESS(cpuUs);
+		RS_SERIAL_PROCESS(maxUs);
+		RS_SERIAL_PROCESS(p50Us);
+		RS_SERIAL_PROCESS(p90Us);
+		RS_SERIAL_PROCESS(p99Us);
+		RS_SERIAL_PROCESS(p999Us);
+	}
+};
+
 struct RsConfigNetStatus : RsSerializable
 {
 	RsConfigNetStatus() : netLocalOk(true)
@@ -338,6 +385,24 @@ public:
 	 */
     virtual int getTrafficInfo(std::list<RSTrafficClue>& out_lst,std::list<RSTrafficClue>& in_lst) = 0 ;
 
+	/**
+	 * @brief getPerformanceCounters get the latency histograms of the
+	 *	instrumented hot paths: service ticks, with the CPU time they used, and
+	 *	time spent by items in service queues. The same data is periodically
+	 *	dumped to perf_counters.json in the account directory.
+	 * @jsonapi{development}
+	 * @param[out] counters one summary per instrumented path
+	 * @return false on error
+	 */
+	virtual bool getPerformanceCounters(std::vector<RsPerfCounterStats>& counters) = 0;
+
+	/**
+	 * @brief resetPerformanceCounters clear all latency histograms, e.g. to
+	 *	measure a given period of time
+	 * @jsonapi{development}
+	 */
+	virtual void resetPerformanceCounters() = 0;
+
     /* From RsInit */
 
     // NOT IMPLEMENTED YET!
@@ -170,6 +170,10 @@ public:
 	}
 
     virtual void linearize(LinearizedExpression& e) const ;
+
+    const Expression *leftExpression() const { return Lexp; }
+    const Expression *rightExpression() const { return Rexp; }
+    enum LogicalOperator logicalOperator() const { return Op; }
 private:
     Expression *Lexp;
     Expression *Rexp;
@@ -184,6 +188,9 @@ public:
 
     virtual void linearize(LinearizedExpression& e) const ;
 	virtual std::string toStdStringWithParam(const std::string& varstr) const;
+
+    enum StringOperator stringOperator() const { return Op; }
+    const std::list<std::string>& stringTerms() const { return terms; }
 protected:
     bool evalStr(const std::string &str);
 
@@ -311,6 +311,50 @@ struct SharedDirStats
     uint64_t total_shared_size ;
 };
 
+/// Activity of the local shared directories watcher
+struct RsSharedDirectoriesWatchInfo : RsSerializable
+{
+	RsSharedDirectoriesWatchInfo() :
+	    notificationsActive(false), watchedDirectories(0),
+	    pendingChangedDirectories(0), changedDirectories(0),
+	    fullSweeps(0), lastFullSweepTS(0), lastFullSweepDurationMs(0),
+	    lastChangedDirectoriesUpdateTS(0),
+	    lastChangedDirectoriesUpdateCount(0),
+	    lastChangedDirectoriesUpdateDurationMs(0) {}
+
+	/// true when directories are watched through kernel notifications
+	bool notificationsActive;
+	uint32_t watchedDirectories;
+	/// directories reported as changed, waiting to be re-indexed
+	uint32_t pendingChangedDirectories;
+	/// total number of directories re-indexed after a change notification
+	uint64_t changedDirectories;
+
+	uint64_t fullSweeps;
+	rstime_t lastFullSweepTS;
+	uint32_t lastFullSweepDurationMs;
+
+	rstime_t lastChangedDirectoriesUpdateTS;
+	uint32_t lastChangedDirectoriesUpdateCount;
+	uint32_t lastChangedDirectoriesUpdateDurationMs;
+
+	/// @see RsSerializable::serial_process
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,
+	                            RsGenericSerializer::SerializeContext& ctx)
+	{
+		RS_SERIAL_PROCESS(notificationsActive);
+		RS_SERIAL_PROCESS(watchedDirectories);
+		RS_SERIAL_PROCESS(pendingChangedDirectories);
+		RS_SERIAL_PROCESS(changedDirectories);
+		RS_SERIAL_PROCESS(fullSweeps);
+		RS_SERIAL_PROCESS(lastFullSweepTS);
+		RS_SERIAL_PROCESS(lastFullSweepDurationMs);
+		RS_SERIAL_PROCESS(lastChangedDirectoriesUpdateTS);
+		RS_SERIAL_PROCESS(lastChangedDirectoriesUpdateCount);
+		RS_SERIAL_PROCESS(lastChangedDirectoriesUpdateDurationMs);
+	}
+};
+
 /** This class represents a tree of directories and files, only with their names
  * size and hash. It is used to create collection links in the GUI and to
  * transmit directory information between services. This class is independent
@@ -1030,11 +1074,55 @@ public:
         virtual void setWatchEnabled(bool b) =0;
         virtual int  watchPeriod() const =0;
         virtual bool watchEnabled() =0;
+
+	/**
+	 * @brief Watch shared directories through kernel notifications (inotify
+	 * on Linux) and re-index only the directories that changed. Full sweeps
+	 * of the shared directories are still done from time to time. Has no
+	 * effect on other platforms.
+	 * @jsonapi{development}
+	 * @param[in] enable true to use notifications
+	 */
+	virtual void setWatchNotificationsEnabled(bool enable) = 0;
+
+	/**
+	 * @brief Check whether shared directories are watched through kernel
+	 * notifications
+	 * @jsonapi{development}
+	 * @return true if enabled
+	 */
+	virtual bool watchNotificationsEnabled() = 0;
+
+	/**
+	 * @brief Get statistics about the shared directories watcher: watched and
+	 * changed directories, full sweep times
+	 * @jsonapi{development}
+	 * @param[out] info storage for the statistics
+	 * @return false if something failed, true otherwhise
+	 */
+	virtual bool getSharedDirectoriesWatchInfo(
+	        RsSharedDirectoriesWatchInfo& info ) = 0;
+
         virtual bool followSymLinks() const=0;
         virtual void setFollowSymLinks(bool b)=0 ;
 		virtual void togglePauseHashingProcess() =0;		// pauses/resumes the hashing process.
 		virtual bool hashingProcessPaused() =0;
 
+	/**
+	 * @brief Set the number of threads used to hash shared files. Files stored
+	 * on a spinning disk are still hashed one at a time.
+	 * @jsonapi{development}
+	 * @param[in] threads number of hashing threads
+	 */
+	virtual void setHashingThreadsCount(uint32_t threads) = 0;
+
+	/**
+	 * @brief Get the number of threads used to hash shared files
+	 * @jsonapi{development}
+	 * @return number of hashing threads
+	 */
+	virtual uint32_t hashingThreadsCount() = 0;
+
 		virtual bool	getShareDownloadDirectory() = 0;
 		virtual bool 	shareDownloadDirectory(bool share) = 0;
 
@@ -470,13 +470,14 @@ protected:
 	 * Useful for blocking API implementation.
 	 * @param[in] token token associated to the request caller is waiting for
 	 * @param[in] maxWait maximum waiting time in milliseconds
-	 * @param[in] checkEvery time in millisecond between status checks
+	 * @param[in] checkEvery unused, the token service wakes the caller up as
+	 *	soon as the request completes. Kept for source compatibility.
 	 * @param[in] auto_delete_if_unsuccessful delete the request when it fails. This avoid leaving useless pending requests in the queue that would slow down additional calls.
 	 */
 	RsTokenService::GxsRequestStatus waitToken(
 	        uint32_t token,
 	        std::chrono::milliseconds maxWait = std::chrono::milliseconds(20000),
-	        std::chrono::milliseconds checkEvery = std::chrono::milliseconds(100),
+	        std::chrono::milliseconds /*checkEvery*/ = std::chrono::milliseconds(100),
 	        bool auto_delete_if_unsuccessful=true)
 	{
 #if defined(__ANDROID__) && (__ANDROID_API__ < 24)
@@ -484,15 +485,8 @@ protected:
 		int maxWorkAroundCnt = 10;
 LLwaitTokenBeginLabel:
 #endif
-		auto timeout = std::chrono::steady_clock::now() + maxWait;
-		auto st = requestStatus(token);
+		auto st = mTokenService.waitForRequest(token, maxWait);
 
-		while( !(st == RsTokenService::FAILED || st >= RsTokenService::COMPLETE)
-		       && std::chrono::steady_clock::now() < timeout )
-		{
-			std::this_thread::sleep_for(checkEvery);
-			st = requestStatus(token);
-		}
 		if(st != RsTokenService::COMPLETE && auto_delete_if_unsuccessful)
 			cancelRequest(token);
 
@@ -505,12 +499,10 @@ LLwaitTokenBeginLabel:
 		        && maxWorkAroundCnt-- > 0 )
 		{
 			maxWait *= 10;
-			checkEvery *= 3;
 			Dbg3() << __PRETTY_FUNCTION__ << " Slow Android device "
 			       << " workaround st: " << st
 			       << " maxWorkAroundCnt: " << maxWorkAroundCnt
-			       << " maxWait: " << maxWait.count()
-			       << " checkEvery: " << checkEvery.count() << std::endl;
+			       << " maxWait: " << maxWait.count() << std::endl;
 			goto LLwaitTokenBeginLabel;
 		}
 		Dbg3() << __PRETTY_FUNCTION__ << " lasted: "
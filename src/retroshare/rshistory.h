@@ -93,6 +93,44 @@ public:
      */
     virtual bool getMessages(const ChatId& chatPeerId, std::list<HistoryMsg> &msgs, uint32_t loadCount) = 0;
 
+    /*!
+     * @brief Retrieves a page of the history of a chat, to go back in history
+     *  without loading all of it
+     * @jsonapi{development}
+     * @param[in]  chatPeerId    Chat Id for which the history needs to be retrieved
+     * @param[in]  beforeMsgId   only messages older than this one, 0 for the latest ones
+     * @param[in]  count         maximum number of messages to get
+     * @param[out] msgs          retrieved messages, oldest first
+     * @return true if messages can be retrieved, false otherwise.
+     */
+    virtual bool getMessagesPage( const ChatId& chatPeerId, uint32_t beforeMsgId, uint32_t count,
+                                  std::list<HistoryMsg>& msgs ) = 0;
+
+    /*!
+     * @brief Retrieves the messages of a chat received during a time range
+     * @jsonapi{development}
+     * @param[in]  chatPeerId    Chat Id for which the history needs to be retrieved
+     * @param[in]  from          start of the range, included
+     * @param[in]  to            end of the range, excluded
+     * @param[in]  maxCount      maximum number of messages to get (the latest), 0 for all
+     * @param[out] msgs          retrieved messages, oldest first
+     * @return true if messages can be retrieved, false otherwise.
+     */
+    virtual bool getMessagesInRange( const ChatId& chatPeerId, rstime_t from, rstime_t to,
+                                     uint32_t maxCount, std::list<HistoryMsg>& msgs ) = 0;
+
+    /*!
+     * @brief Looks for messages containing all the given words
+     * @jsonapi{development}
+     * @param[in]  chatPeerId    Chat Id to search in, unset to search all chats
+     * @param[in]  text          words to look for
+     * @param[in]  maxCount      maximum number of messages to get (the latest), 0 for all
+     * @param[out] msgs          matching messages, oldest first
+     * @return true if the search could be done, false otherwise.
+     */
+    virtual bool searchMessages( const ChatId& chatPeerId, const std::string& text,
+                                 uint32_t maxCount, std::list<HistoryMsg>& msgs ) = 0;
+
     /*!
      * @brief Retrieves a specific message from the history
      * @jsonapi{development}
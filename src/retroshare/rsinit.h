@@ -145,6 +145,8 @@ struct RsConfigOptions
 
 	uint16_t    jsonApiPort;		/* port to use fo Json API */
 	std::string jsonApiBindAddress; /* bind address for Json API */
+
+	uint32_t    ioReactorThreads;	/* number of threads servicing peer connections (Linux only). 0 = one thread per connection */
 };
 
 
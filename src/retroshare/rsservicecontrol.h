@@ -27,6 +27,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 #include <retroshare/rstypes.h>
 
 /* The Main Interface Class - for information about your Peers */
@@ -120,6 +121,46 @@ struct RsServicePermissions : RsSerializable
 	}
 };
 
+/**
+ * Outgoing traffic of each connection is split in these classes, depending on
+ * the service that emits it. When a connection is saturated, every class gets
+ * a share of its bandwidth proportional to its weight, and may borrow what the
+ * other classes do not use.
+ */
+enum class RsServiceBandwidthClass : uint8_t
+{
+	INTERACTIVE = 0x00, /// chat, status, discovery, heartbeat...
+	SYNC        = 0x01, /// GXS, mail and file list synchronisation
+	BULK        = 0x02, /// file transfer and turtle tunnels
+	OTHER       = 0x03  /// everything else, e.g. plugins
+};
+
+struct RsServiceBandwidthClassInfo : RsSerializable
+{
+	RsServiceBandwidthClassInfo() :
+	    mClass(RsServiceBandwidthClass::OTHER), mWeight(0), mBytesSent(0),
+	    mRateKBs(0), mQueuedBytes(0) {}
+
+	RsServiceBandwidthClass mClass;
+	uint32_t mWeight;
+
+	/// total amount of data sent in this class since start
+	uint64_t mBytesSent;
+	/// recent outgoing rate, summed over all connections
+	float mRateKBs;
+	/// data waiting in the output queues of all connections
+	uint64_t mQueuedBytes;
+
+	// RsSerializable interface
+	void serial_process(RsGenericSerializer::SerializeJob j, RsGenericSerializer::SerializeContext &ctx) {
+		RS_SERIAL_PROCESS(mClass);
+		RS_SERIAL_PROCESS(mWeight);
+		RS_SERIAL_PROCESS(mBytesSent);
+		RS_SERIAL_PROCESS(mRateKBs);
+		RS_SERIAL_PROCESS(mQueuedBytes);
+	}
+};
+
 class RsServiceControl
 {
 public:
@@ -196,6 +237,25 @@ public:
 	 */
 	virtual void getPeersConnected( uint32_t serviceId,
 	                                std::set<RsPeerId>& peerSet ) = 0;
+
+	/**
+	 * @brief getBandwidthClasses return weight and usage of the outgoing
+	 *  bandwidth classes.
+	 * @jsonapi{development}
+	 * @param[out] classes storage for per-class information
+	 * @return always true
+	 */
+	virtual bool getBandwidthClasses(std::vector<RsServiceBandwidthClassInfo>& classes) = 0;
+
+	/**
+	 * @brief setBandwidthClassWeight change the share of outgoing bandwidth
+	 *  a class gets when connections are saturated.
+	 * @jsonapi{development}
+	 * @param[in] bwClass class to update
+	 * @param[in] weight new weight, between 1 and 1000
+	 * @return false if class or weight is out of range
+	 */
+	virtual bool setBandwidthClassWeight(RsServiceBandwidthClass bwClass, uint32_t weight) = 0;
 };
 
 #endif
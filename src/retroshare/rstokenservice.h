@@ -26,6 +26,7 @@
 #include <inttypes.h>
 #include <string>
 #include <list>
+#include <chrono>
 
 #include "retroshare/rsgxsifacetypes.h"
 #include "util/rsdeprecate.h"
@@ -80,7 +81,8 @@ struct RsTokReqOptions
 {
 	RsTokReqOptions() : mOptions(0), mStatusFilter(0), mStatusMask(0),
 	    mMsgFlagMask(0), mMsgFlagFilter(0), mReqType(0), mSubscribeFilter(0),
-	    mSubscribeMask(0), mBefore(0), mAfter(0),mPriority(GxsRequestPriority::NORMAL) {}
+	    mSubscribeMask(0), mBefore(0), mAfter(0), mLimit(0), mOffset(0),
+	    mPriority(GxsRequestPriority::NORMAL) {}
 
 	/**
 	 * Can be one or multiple RS_TOKREQOPT_*
@@ -108,6 +110,11 @@ struct RsTokReqOptions
 	rstime_t   mBefore;
 	rstime_t   mAfter;
 
+	// Paging of message list requests: skips mOffset messages then returns at
+	// most mLimit of them (0 = no limit), most recently published first.
+	uint32_t mLimit;
+	uint32_t mOffset;
+
     GxsRequestPriority mPriority;
 };
 
@@ -224,6 +231,17 @@ public:
 	 */
 	virtual bool cancelRequest(const uint32_t &token) = 0;
 
+	/*!
+	 * @brief Block caller until the request is no longer pending, or until
+	 * maxWait expires. Returns as soon as the request completes, without
+	 * polling.
+	 * @param token the token of the request to wait for
+	 * @param maxWait maximum waiting time
+	 * @return the status of the request when returning
+	 */
+	virtual GxsRequestStatus waitForRequest(
+	        uint32_t token, std::chrono::milliseconds maxWait ) = 0;
+
 #ifdef TO_REMOVE
 	/**
 	 * Block caller while request is being processed.
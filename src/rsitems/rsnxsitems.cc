@@ -39,6 +39,7 @@ const uint8_t RsNxsSyncGrpItem::FLAG_USE_SYNC_HASH       = 0x0001;
 const uint8_t RsNxsSyncMsgItem::FLAG_USE_SYNC_HASH       = 0x0001;
 
 const uint8_t RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID = 0x02;
+const uint8_t RsNxsSyncMsgReqItem::FLAG_MSG_ID_SKETCH_SUPPORTED = 0x04;
 
 /** transaction state **/
 const uint16_t RsNxsTransacItem::FLAG_BEGIN_P1         = 0x0001;
@@ -77,6 +78,7 @@ RsItem *RsNxsSerialiser::create_item(uint16_t service_id,uint8_t item_subtype) c
         case RS_PKT_SUBTYPE_NXS_ENCRYPTED_DATA_ITEM: return new RsNxsEncryptedDataItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_GRP_STATS_ITEM: return new RsNxsSyncGrpStatsItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_PULL_REQUEST_ITEM: return new RsNxsPullRequestItem(SERVICE_TYPE) ;
+        case RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_REQ_ITEM: return new RsNxsSyncMsgSketchReqItem(SERVICE_TYPE) ;
 
         default:
                 return NULL;
@@ -153,6 +155,11 @@ void RsNxsSyncMsgReqItem::serial_process(RsGenericSerializer::SerializeJob j,RsG
     RsTypeSerializer::serial_process          (j,ctx,grpId            ,"grpId") ;
     RsTypeSerializer::serial_process<uint32_t>(j,ctx,updateTS         ,"updateTS") ;
 }
+void RsNxsSyncMsgSketchReqItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsNxsSyncMsgReqItem::serial_process(j,ctx) ;
+    RsTypeSerializer::serial_process<RsTlvItem>(j,ctx,sketch          ,"sketch") ;
+}
 void RsNxsGroupPublishKeyItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
     RsTypeSerializer::serial_process           (j,ctx,grpId            ,"grpId") ;
@@ -214,6 +221,11 @@ void RsNxsSyncMsgReqItem::clear()
     updateTS = 0;
     syncHash.clear();
 }
+void RsNxsSyncMsgSketchReqItem::clear()
+{
+    RsNxsSyncMsgReqItem::clear();
+    sketch.TlvClear();
+}
 void RsNxsSyncGrpItem::clear()
 {
     flag = 0;
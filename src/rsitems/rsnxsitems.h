@@ -49,6 +49,7 @@ const uint8_t RS_PKT_SUBTYPE_NXS_MSG_ITEM             = 0x20;
 const uint8_t RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         = 0x40;
 const uint8_t RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM = 0x80;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_PULL_REQUEST_ITEM = 0x90;
+const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_REQ_ITEM = 0xa0;
 
 
 #ifdef RS_DEAD_CODE
@@ -325,6 +326,7 @@ public:
     static const uint8_t FLAG_USE_SYNC_HASH;
 #endif
     static const uint8_t FLAG_USE_HASHED_GROUP_ID;
+    static const uint8_t FLAG_MSG_ID_SKETCH_SUPPORTED; // sender understands RsNxsSyncMsgSketchReqItem
 
     explicit RsNxsSyncMsgReqItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM) { clear(); }
 
@@ -337,6 +339,28 @@ public:
     uint32_t createdSinceTS;
     uint32_t updateTS; // time of last update
     std::string syncHash;
+
+protected:
+    RsNxsSyncMsgReqItem(uint16_t servtype, uint8_t subtype) : RsNxsItem(servtype, subtype) { clear(); }
+};
+
+/*!
+ * Same as RsNxsSyncMsgReqItem, but also carries a RsGxsMsgIdSketch of the
+ * messages the requester already has for the group (published after
+ * createdSinceTS), so that the answer only lists the missing ones.
+ * Only sent to peers that advertised FLAG_MSG_ID_SKETCH_SUPPORTED.
+ */
+class RsNxsSyncMsgSketchReqItem : public RsNxsSyncMsgReqItem
+{
+public:
+    explicit RsNxsSyncMsgSketchReqItem(uint16_t servtype)
+      : RsNxsSyncMsgReqItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_REQ_ITEM), sketch(servtype) { clear(); }
+
+    virtual void clear() override;
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx) override;
+
+    RsTlvBinaryData sketch;
 };
 
 /*!
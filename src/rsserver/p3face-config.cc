@@ -38,6 +38,7 @@
 
 #include "pqi/p3peermgr.h"
 #include "pqi/p3netmgr.h"
+#include "pqi/pqireactor.h"
 
 
 // TO SHUTDOWN THREADS.
@@ -99,6 +100,8 @@ void RsServer::rsGlobalShutDown()
 		// kill all registered service threads
 		for(RsTickingThread* service: mRegisteredServiceThreads)
 			service->fullstop();
+
+		pqiReactor::shutdown();
 	}
 
 	fullstop();
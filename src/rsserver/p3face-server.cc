@@ -36,6 +36,8 @@
 #include "pqi/p3netmgr.h"
 
 #include "util/rsdebug.h"
+#include "util/rsperfstats.h"
+#include "retroshare/rsinit.h"
 
 #include "retroshare/rsevents.h"
 #include "services/rseventsservice.h"
@@ -46,6 +48,8 @@
 
 #define WARN_BIG_CYCLE_TIME	(0.2)
 
+static const std::string PERF_COUNTERS_FILE_NAME = "perf_counters.json";
+
 #ifdef WINDOWS_SYS
 #include "util/rstime.h"
 #include <sys/timeb.h>
@@ -222,6 +226,9 @@ void RsServer::threadTick()
 		// AuthSSL::getAuthSSL()->CheckSaveCertificates();
 		mCycle3 = ts;
         mConfigMgr->tick(RsConfigMgr::CheckPriority::SAVE_OFTEN); // This most of the time does nothing, since it only saved the urgent ones, which is not the default.
+
+		// latency histograms of the hot paths, so that they can be looked at without attaching a profiler
+		RsPerfStats::dumpToFile(RsAccounts::AccountDirectory() + "/" + PERF_COUNTERS_FILE_NAME);
     }
 
 // stuff we do every hour
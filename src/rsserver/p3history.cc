@@ -49,6 +49,21 @@ bool p3History::getMessages(const ChatId &chatPeerId, std::list<HistoryMsg> &msg
 	return mHistoryMgr->getMessages(chatPeerId, msgs, loadCount);
 }
 
+bool p3History::getMessagesPage(const ChatId &chatPeerId, uint32_t beforeMsgId, uint32_t count, std::list<HistoryMsg> &msgs)
+{
+	return mHistoryMgr->getMessagesPage(chatPeerId, beforeMsgId, count, msgs);
+}
+
+bool p3History::getMessagesInRange(const ChatId &chatPeerId, rstime_t from, rstime_t to, uint32_t maxCount, std::list<HistoryMsg> &msgs)
+{
+	return mHistoryMgr->getMessagesInRange(chatPeerId, from, to, maxCount, msgs);
+}
+
+bool p3History::searchMessages(const ChatId &chatPeerId, const std::string &text, uint32_t maxCount, std::list<HistoryMsg> &msgs)
+{
+	return mHistoryMgr->searchMessages(chatPeerId, text, maxCount, msgs);
+}
+
 bool p3History::getMessage(uint32_t msgId, HistoryMsg &msg)
 {
 	return mHistoryMgr->getMessage(msgId, msg);
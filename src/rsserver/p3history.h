@@ -39,6 +39,9 @@ public:
 
 	virtual bool chatIdToVirtualPeerId(const ChatId &chat_id, RsPeerId &peer_id);
 	virtual bool getMessages(const ChatId &chatPeerId, std::list<HistoryMsg> &msgs, uint32_t loadCount);
+	virtual bool getMessagesPage(const ChatId &chatPeerId, uint32_t beforeMsgId, uint32_t count, std::list<HistoryMsg> &msgs);
+	virtual bool getMessagesInRange(const ChatId &chatPeerId, rstime_t from, rstime_t to, uint32_t maxCount, std::list<HistoryMsg> &msgs);
+	virtual bool searchMessages(const ChatId &chatPeerId, const std::string &text, uint32_t maxCount, std::list<HistoryMsg> &msgs);
 	virtual bool getMessage(uint32_t msgId, HistoryMsg &msg);
 	virtual void removeMessages(const std::list<uint32_t> &msgIds);
 	virtual void clear(const ChatId &chatPeerId);
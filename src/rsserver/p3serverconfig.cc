@@ -22,6 +22,7 @@
 #include <retroshare/rsturtle.h>
 #include "rsserver/p3serverconfig.h"
 #include "services/p3bwctrl.h"
+#include "util/rsperfstats.h"
 
 #include "pqi/authgpg.h"
 #include "pqi/authssl.h"
@@ -184,6 +185,17 @@ int p3ServerConfig::getTrafficInfo(std::list<RSTrafficClue>& out_lst,std::list<R
         return 0 ;
 }
 
+bool p3ServerConfig::getPerformanceCounters(std::vector<RsPerfCounterStats>& counters)
+{
+	RsPerfStats::getStats(counters);
+	return true;
+}
+
+void p3ServerConfig::resetPerformanceCounters()
+{
+	RsPerfStats::reset();
+}
+
 int 	p3ServerConfig::getTotalBandwidthRates(RsConfigDataRates &rates)
 {
 	if (rsBandwidthControl)
@@ -88,6 +88,7 @@ RsDht *rsDht = NULL ;
 
 #include "pqi/authssl.h"
 #include "pqi/sslfns.h"
+#include "pqi/pqireactor.h"
 #include "pqi/authgpg.h"
 
 #ifdef ENABLE_GROUTER
@@ -136,6 +137,7 @@ RsConfigOptions::RsConfigOptions()
           ,jsonApiPort(0)					// JSonAPI server is enabled in each main()
           ,jsonApiBindAddress("127.0.0.1")
 #endif
+          ,ioReactorThreads(0)
 {
 }
 
@@ -314,6 +316,8 @@ int RsInit::InitRetroShare(const RsConfigOptions& conf)
     rsInitConfig->jsonApiBindAddress = conf.jsonApiBindAddress;
     rsInitConfig->mainExecutablePath = conf.main_executable_path;
 
+	pqiReactor::setThreadCount(conf.ioReactorThreads);
+
 #ifdef PTW32_STATIC_LIB
 	// for static PThreads under windows... we need to init the library...
 	pthread_win32_process_attach_np();
@@ -913,7 +917,8 @@ int RsServer::StartupRetroShare()
 	std::cerr << "setup classes / structures" << std::endl;
 
 	/* History Manager */
-	mHistoryMgr = new p3HistoryMgr();
+	mHistoryMgr = new p3HistoryMgr( RsAccounts::AccountDirectory() + "/history_db",
+	                                rsInitConfig->gxs_passwd );
 	mPeerMgr = new p3PeerMgrIMPL( AuthSSL::getAuthSSL()->OwnId(),
                 AuthPGP::getPgpOwnId(),
                 AuthPGP::getPgpOwnName(),
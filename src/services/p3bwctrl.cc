@@ -242,6 +242,8 @@ int  p3BandwidthControl::getTotalBandwidthRates(RsConfigDataRates &rates)
 
 	rates.mQueueIn = mTotalRates.mQueueIn;
 	rates.mQueueOut = mTotalRates.mQueueOut;
+	rates.mQueueOutPending = mTotalRates.mQueueOutPending;
+	rates.mSendContention = mTotalRates.mSendContention;
 
 	return 1;
 }
@@ -268,6 +270,8 @@ int p3BandwidthControl::getAllBandwidthRates(std::map<RsPeerId, RsConfigDataRate
 
         	rates.mQueueIn = bit->second.mRates.mQueueIn;
         	rates.mQueueOut = bit->second.mRates.mQueueOut;
+        	rates.mQueueOutPending = bit->second.mRates.mQueueOutPending;
+        	rates.mSendContention = bit->second.mRates.mSendContention;
 
 		ratemap[bit->first] = rates;
 	}			
@@ -24,6 +24,7 @@
 #include "pqi/pqi.h"
 #include "util/rsstring.h"
 #include "services/p3service.h"
+#include "util/rsperfstats.h"
 #include <iomanip>
 
 #ifdef WINDOWS_SYS
@@ -38,16 +39,32 @@
 
 RsItem *p3Service::recvItem()
 {
-	RsStackMutex stack(srvMtx);  /*****   LOCK MUTEX *****/
+	RsItem *item;
+	uint64_t queued_us;
 
-	if (recv_queue.empty())
 	{
-		return NULL; /* nothing there! */
+		RsStackMutex stack(srvMtx);  /*****   LOCK MUTEX *****/
+
+		if (recv_queue.empty())
+		{
+			return NULL; /* nothing there! */
+		}
+
+		/* get something off front */
+		item = recv_queue.front().first;
+		queued_us = recv_queue.front().second;
+		recv_queue.pop_front();
 	}
 
-	/* get something off front */
-	RsItem *item = recv_queue.front();
-	recv_queue.pop_front();
+	RsPerfCounter *counter = mQueueWaitCounter.load(std::memory_order_acquire);
+
+	if(!counter)
+	{
+		counter = &RsPerfStats::counter(
+		            "p3Service/queue_wait/" + getServiceInfo().mServiceName );
+		mQueueWaitCounter.store(counter, std::memory_order_release);
+	}
+	counter->record(RsPerfStats::nowUs() - queued_us);
 
 	return item;
 }
@@ -67,7 +84,7 @@ bool p3Service::recvItem(RsItem *item)
 	{
 		RsStackMutex stack(srvMtx);  /*****   LOCK MUTEX *****/
 
-		recv_queue.push_back(item);
+		recv_queue.push_back(std::make_pair(item, RsPerfStats::nowUs()));
 	}
 	return true;
 }
@@ -26,6 +26,10 @@
 #include "pqi/pqiservice.h"
 #include "util/rsthreads.h"
 
+#include <atomic>
+
+class RsPerfCounter;
+
 /* This provides easy to use extensions to the pqiservice class provided in src/pqi.
  * 
  * We will have a number of different strains.
@@ -96,7 +100,7 @@ class p3Service: public p3FastService
 	protected:
 
 	p3Service() 
-	:p3FastService()
+	:p3FastService(), mQueueWaitCounter(nullptr)
 	{
 		return; 
 	}
@@ -119,7 +123,11 @@ virtual bool	recvItem(RsItem *item);
 	private:
 
 	/* below locked by srvMtx Mutex */
-	std::list<RsItem *> recv_queue;
+	std::list<std::pair<RsItem *, uint64_t> > recv_queue;	// items, and when they were queued
+
+	// time spent by items in recv_queue, created on first use since the
+	// service name is not known at construction time.
+	std::atomic<RsPerfCounter *> mQueueWaitCounter;
 };
 
 
@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * libretroshare/src/tcponudp: tcpcongestion.cc                                *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include "tcpcongestion.h"
+
+#include <math.h>
+
+static const double CUBIC_C    = 0.4; /* segments / sec^3 */
+static const double CUBIC_BETA = 0.7; /* window kept on loss */
+
+TcpCongestionControl::TcpCongestionControl(uint32 m, uint32 w)
+	: mss(m), maxWin(w)
+{
+	reset();
+}
+
+void	TcpCongestionControl::reset()
+{
+	cwnd       = mss;
+	ssthresh   = maxWin;
+	wMax       = 0;
+	epochStart = 0;
+	originWin  = 0;
+	K          = 0;
+	renoWin    = 0;
+}
+
+void	TcpCongestionControl::enterCongestionAvoidance(double now)
+{
+	epochStart = now;
+	renoWin = cwnd;
+
+	if (cwnd < wMax)
+	{
+		K = cbrt((wMax - cwnd) / mss / CUBIC_C);
+		originWin = wMax;
+	}
+	else
+	{
+		K = 0;
+		originWin = cwnd;
+	}
+}
+
+void	TcpCongestionControl::onAck(uint32 ackedBytes, double rtt, double now)
+{
+	if (cwnd < ssthresh)
+	{
+		/* slow start */
+		cwnd += ackedBytes;
+	}
+	else
+	{
+		if (epochStart == 0)
+		{
+			enterCongestionAvoidance(now);
+		}
+
+		/* where the window should be one rtt from now */
+		double t = now - epochStart + rtt;
+		double target = originWin + CUBIC_C * (t - K) * (t - K) * (t - K) * mss;
+
+		if (target > 1.5 * cwnd)
+		{
+			target = 1.5 * cwnd;
+		}
+
+		if (target > cwnd)
+		{
+			cwnd += (target - cwnd) * ackedBytes / cwnd;
+		}
+		else
+		{
+			/* plateau: probe very slowly */
+			cwnd += 0.01 * mss * ackedBytes / cwnd;
+		}
+
+		/* never be less aggressive than standard TCP would be */
+		renoWin += 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA) * mss * ackedBytes / renoWin;
+
+		if (renoWin > cwnd)
+		{
+			cwnd = renoWin;
+		}
+	}
+
+	if (cwnd > maxWin)
+	{
+		cwnd = maxWin;
+	}
+}
+
+void	TcpCongestionControl::reduce()
+{
+	/* fast convergence: release bandwidth to newer flows */
+	if (cwnd < wMax)
+	{
+		wMax = cwnd * (1.0 + CUBIC_BETA) / 2.0;
+	}
+	else
+	{
+		wMax = cwnd;
+	}
+
+	ssthresh = cwnd * CUBIC_BETA;
+
+	if (ssthresh < 2 * mss)
+	{
+		ssthresh = 2 * mss;
+	}
+
+	epochStart = 0;
+}
+
+void	TcpCongestionControl::onLoss()
+{
+	reduce();
+	cwnd = ssthresh;
+}
+
+void	TcpCongestionControl::onTimeout()
+{
+	reduce();
+	cwnd = mss;
+}
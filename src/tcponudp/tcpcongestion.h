@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * libretroshare/src/tcponudp: tcpcongestion.h                                 *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#ifndef TOU_TCP_CONGESTION_H
+#define TOU_TCP_CONGESTION_H
+
+#include "tcppacket.h"
+
+/* CUBIC congestion control (RFC 8312) for TcpStream.
+ *
+ * All sizes are in bytes, times are in (fractional) seconds as given by
+ * TcpStream. The window grows as a cubic function of the time elapsed since
+ * the last congestion event, centered on the window at which that event
+ * happened, so that it quickly gets back to the previous operating point and
+ * then probes carefully around it. It never grows slower than a standard
+ * (Reno) window would.
+ */
+
+class TcpCongestionControl
+{
+	public:
+
+	TcpCongestionControl(uint32 mss, uint32 maxWin);
+
+	/* new connection -> slow start from one segment */
+void	reset();
+
+	/* new data has been acknowledged */
+void	onAck(uint32 ackedBytes, double rtt, double now);
+
+	/* loss detected while data still flows (SACK) -> multiplicative decrease */
+void	onLoss();
+
+	/* retransmission timeout -> back to one segment */
+void	onTimeout();
+
+uint32	window() const { return (uint32) cwnd; }
+uint32	threshold() const { return (uint32) ssthresh; }
+uint32	lastMaxWindow() const { return (uint32) wMax; }
+
+	private:
+
+void	enterCongestionAvoidance(double now);
+void	reduce();
+
+	uint32 mss;
+	uint32 maxWin;
+
+	double cwnd;     /* congestion window */
+	double ssthresh; /* slow start threshold */
+
+	double wMax;       /* window before the last reduction */
+	double epochStart; /* start of the current avoidance epoch, 0 if none */
+	double originWin;  /* window the cubic function plateaus at */
+	double K;          /* time to get back to originWin */
+	double renoWin;    /* what a Reno window would be, for TCP friendliness */
+};
+
+#endif
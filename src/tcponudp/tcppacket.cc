@@ -65,10 +65,14 @@
 #define TCP_SYN_BIT  0x0040
 #define TCP_FIN_BIT  0x0080
 
+/* extensions, in bits that older peers ignore */
+#define TCP_SACK_PERMITTED_BIT  0x0001 /* on SYN: understands SACK blocks */
+#define TCP_SACK_BIT            0x0002 /* SACK blocks precede the data */
+
 
 TcpPacket::TcpPacket(uint8 *ptr, int size)
 	:data(0), datasize(0), seqno(0), ackno(0), hlen_flags(0), 
-	 winsize(0), ts(0), retrans(0)
+	 winsize(0), sackCount(0), ts(0), retrans(0), sacked(false), lost(false)
 	{
 		if (size > 0)
 		{
@@ -83,7 +87,7 @@ TcpPacket::TcpPacket(uint8 *ptr, int size)
 
 TcpPacket::TcpPacket() /* likely control packet */
 	:data(0), datasize(0), seqno(0), ackno(0), hlen_flags(0), 
-	 winsize(0), ts(0), retrans(0)
+	 winsize(0), sackCount(0), ts(0), retrans(0), sacked(false), lost(false)
 	{
 		return;
 	}
@@ -98,12 +102,21 @@ TcpPacket::~TcpPacket()
 
 int	TcpPacket::writePacket(void *buf, int &size)
 {
-	if (size < TCP_PSEUDO_HDR_SIZE + datasize)
+	int sackSize = TCP_SACK_HDR_SIZE(sackCount);
+
+	if (size < TCP_PSEUDO_HDR_SIZE + sackSize + datasize)
 	{
 		size = 0;
 		return -1;
 	}
 
+	/* packets are rewritten on retransmission, with fresh sack blocks */
+	hlen_flags &= ~TCP_SACK_BIT;
+	if (sackCount)
+	{
+		hlen_flags |= TCP_SACK_BIT;
+	}
+
 	/* byte:  0 => uint16 srcport = 0 */
 	*((uint16 *) &(((uint8 *) buf)[0])) = htons(0); 
 
@@ -130,10 +143,24 @@ int	TcpPacket::writePacket(void *buf, int &size)
 
 	/* total 20 bytes */
 
+	/* then the sack blocks */
+	if (sackCount)
+	{
+		uint8 *sack = &(((uint8 *) buf)[TCP_PSEUDO_HDR_SIZE]);
+		sack[0] = sackCount;
+		sack[1] = sack[2] = sack[3] = 0;
+
+		for(int i = 0; i < sackCount; i++)
+		{
+			*((uint32 *) &(sack[4 + 8 * i])) = htonl(sackLeft[i]);
+			*((uint32 *) &(sack[8 + 8 * i])) = htonl(sackRight[i]);
+		}
+	}
+
 	/* now the data */
-	memcpy((void *) &(((uint8 *) buf)[20]), data, datasize);
+	memcpy((void *) &(((uint8 *) buf)[TCP_PSEUDO_HDR_SIZE + sackSize]), data, datasize);
 
-	return size = TCP_PSEUDO_HDR_SIZE + datasize;
+	return size = TCP_PSEUDO_HDR_SIZE + sackSize + datasize;
 }
 
 
@@ -176,12 +203,37 @@ int	TcpPacket::readPacket(void *buf, int size)
 
 	/* total 20 bytes */
 
+	int hdrSize = TCP_PSEUDO_HDR_SIZE;
+	sackCount = 0;
+
+	if (hlen_flags & TCP_SACK_BIT)
+	{
+		uint8 *sack = &(((uint8 *) buf)[TCP_PSEUDO_HDR_SIZE]);
+
+		if ((size < TCP_PSEUDO_HDR_SIZE + 4) || (sack[0] == 0) ||
+			(sack[0] > TCP_MAX_SACK_BLOCKS) ||
+			(size < TCP_PSEUDO_HDR_SIZE + TCP_SACK_HDR_SIZE(sack[0])))
+		{
+			std::cerr << "TcpPacket::readPacket() Failed Bad SACK blocks!";
+			std::cerr << std::endl;
+			return -1;
+		}
+
+		sackCount = sack[0];
+		for(int i = 0; i < sackCount; i++)
+		{
+			sackLeft[i]  = ntohl( *((uint32 *) &(sack[4 + 8 * i])) );
+			sackRight[i] = ntohl( *((uint32 *) &(sack[8 + 8 * i])) );
+		}
+		hdrSize += TCP_SACK_HDR_SIZE(sackCount);
+	}
+
 	if (data)
 	{
 		free(data);
 		data = NULL ;
 	}
-	datasize = size - TCP_PSEUDO_HDR_SIZE;
+	datasize = size - hdrSize;
 
 	// this happens for control packets (e.g. syn/ack/fin)
 	if(datasize == 0)
@@ -201,7 +253,7 @@ int	TcpPacket::readPacket(void *buf, int size)
 	}
 
 	/* now the data */
-	memcpy(data, (void *) &(((uint8 *) buf)[20]), datasize);
+	memcpy(data, (void *) &(((uint8 *) buf)[hdrSize]), datasize);
 
 	return size;
 }
@@ -227,6 +279,11 @@ bool	TcpPacket::hasRst()
 	return (hlen_flags & TCP_RST_BIT);
 }
 
+bool	TcpPacket::hasSackPermitted()
+{
+	return (hlen_flags & TCP_SACK_PERMITTED_BIT);
+}
+
 
 void    TcpPacket::setSyn()
 {
@@ -248,6 +305,11 @@ void    TcpPacket::setAckFlag()
 	hlen_flags |= TCP_ACK_BIT;
 }
 
+void    TcpPacket::setSackPermitted()
+{
+	hlen_flags |= TCP_SACK_PERMITTED_BIT;
+}
+
 void    TcpPacket::setAck(uint32 val)
 {
 	setAckFlag();
@@ -260,3 +322,50 @@ uint32  TcpPacket::getAck()
 }
 
 
+TcpPacketRing::TcpPacketRing()
+	:ring(NULL), capacity(0), head(0), count(0)
+{
+	capacity = 64;
+	ring = new TcpPacket *[capacity];
+}
+
+TcpPacketRing::~TcpPacketRing()
+{
+	/* packets are owned (and deleted) by TcpStream */
+	delete[] ring;
+}
+
+void	TcpPacketRing::push_back(TcpPacket *pkt)
+{
+	if (count == capacity)
+	{
+		TcpPacket **bigger = new TcpPacket *[2 * capacity];
+
+		for(uint32 i = 0; i < count; i++)
+		{
+			bigger[i] = (*this)[i];
+		}
+
+		delete[] ring;
+		ring = bigger;
+		capacity *= 2;
+		head = 0;
+	}
+
+	ring[(head + count) & (capacity - 1)] = pkt;
+	count++;
+}
+
+TcpPacket *TcpPacketRing::pop_front()
+{
+	if (!count)
+	{
+		return NULL;
+	}
+
+	TcpPacket *pkt = ring[head];
+	head = (head + 1) & (capacity - 1);
+	count--;
+
+	return pkt;
+}
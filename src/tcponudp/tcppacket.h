@@ -31,6 +31,14 @@ typedef unsigned char  uint8;
 
 #define TCP_PSEUDO_HDR_SIZE 20
 
+/* Selective acknowledgments, only used once both ends announced them
+ * in their SYN. The blocks go between the header and the data:
+ * uint8 count, 3 bytes padding, then count * (uint32 left, uint32 right).
+ */
+#define TCP_MAX_SACK_BLOCKS 4
+#define TCP_SACK_HDR_SIZE(n)  ((n) ? 4 + 8 * (n) : 0)
+#define TCP_MAX_SACK_SIZE     TCP_SACK_HDR_SIZE(TCP_MAX_SACK_BLOCKS)
+
 class TcpPacket
 {
 	public:
@@ -50,11 +58,17 @@ class TcpPacket
 	 **************************/
 	/* no options.
 	 **************************/
-	
+
+	/* received data ranges [left, right) beyond ackno */
+	uint8  sackCount;
+	uint32 sackLeft[TCP_MAX_SACK_BLOCKS];
+	uint32 sackRight[TCP_MAX_SACK_BLOCKS];
 
 	/* other variables */
 	double  ts; /* transmit time */ 
 	uint16  retrans; /* retransmit counter */
+	bool    sacked; /* peer reported it got it */
+	bool    lost; /* needs a fast retransmit */
 
 	TcpPacket(uint8 *ptr, int size);
 	TcpPacket(); /* likely control packet */
@@ -75,10 +89,13 @@ bool 	hasFin();
 bool	hasAck();
 bool	hasRst();
 
+bool	hasSackPermitted();
+
 void    setSyn();
 void    setFin();
 void    setRst();
 void    setAckFlag();
+void    setSackPermitted();
 
 void    setAck(uint32 val);
 uint32  getAck();
@@ -87,5 +104,39 @@ uint32  getAck();
 };
 
 
+/* Packets waiting for acks, in sequence order. They are only added at
+ * the back and acknowledged from the front, so a ring buffer avoids
+ * the per packet allocations of a list, and gives indexed access for
+ * walking the SACK scoreboard.
+ */
+class TcpPacketRing
+{
+	public:
+
+	TcpPacketRing();
+	~TcpPacketRing();
+
+bool	empty() const { return count == 0; }
+uint32	size() const { return count; }
+
+	/* i-th oldest packet */
+TcpPacket *operator[](uint32 i) const { return ring[(head + i) & (capacity - 1)]; }
+TcpPacket *front() const { return ring[head]; }
+
+void	push_back(TcpPacket *pkt); /* grows when full */
+TcpPacket *pop_front();
+
+	private:
+
+	TcpPacketRing(const TcpPacketRing &);
+	TcpPacketRing &operator=(const TcpPacketRing &);
+
+	TcpPacket **ring;
+	uint32 capacity; /* power of 2 */
+	uint32 head;
+	uint32 count;
+};
+
+
 #endif
 
@@ -29,6 +29,8 @@
 #include <errno.h>
 #include <math.h>
 #include <limits.h>
+#include <algorithm>
+#include <vector>
 
 #include <sys/time.h>
 #include "util/rstime.h"
@@ -71,6 +73,9 @@ static const int    TCP_DEFAULT_FIREWALL_TTL = 4;
 
 static const double RTT_ALPHA = 0.875;
 
+/* a segment is lost once this much data beyond it has been SACKed (RFC 6675) */
+static const uint32 kSackDupThresh = 3 * MAX_SEG;
+
 int dumpPacket(std::ostream &out, unsigned char *pkt, uint32_t size);
 
 // platform independent fractional timestamp.
@@ -100,9 +105,11 @@ TcpStream::TcpStream(UdpSubReceiver *lyr)
 	/* retranmission variables - init to large */
 	rtt_est(TCP_RETRANS_TIMEOUT), 
 	rtt_dev(0),
-	congestThreshold(TCP_MAX_WIN),
-	congestWinSize(MAX_SEG),
-	congestUpdate(0),
+	congestion(MAX_SEG, TCP_MAX_WIN),
+	sackPermitted(true),
+	sackEnabled(false),
+	inRecovery(false),
+	recoveryPoint(0),
 	ttl(0),
         mTTL_period(0), 
         mTTL_start(0),
@@ -150,15 +157,21 @@ int	TcpStream::connect(const struct sockaddr_in &raddr, uint32_t conn_period)
 	outAcked = outSeqno; /* min - 1 expected */
 	inWinSize = maxWinSize;
 
-	congestThreshold = TCP_MAX_WIN;
-	congestWinSize   = MAX_SEG;
-	congestUpdate    = outAcked + congestWinSize;
+	congestion.reset();
+	inRecovery = false;
+	sackEnabled = false;
 
 	/* Init Connection */
 	/* send syn packet */
 	TcpPacket *pkt = new TcpPacket();
 	pkt -> setSyn();
 
+	/* SACK is used if the peer offers it in return */
+	if (sackPermitted)
+	{
+		pkt -> setSackPermitted();
+	}
+
 #ifdef DEBUG_TCP_STREAM
 	std::cerr << "TcpStream::connect() Send Init Pkt" << std::endl;
 #endif
@@ -314,6 +327,16 @@ bool	TcpStream::isConnected()
 	return isConn;
 }
 
+void	TcpStream::setSackPermitted(bool allowed)
+{
+	tcpMtx.lock();   /********** LOCK MUTEX *********/
+
+	/* takes effect on the next handshake */
+	sackPermitted = allowed;
+
+	tcpMtx.unlock(); /******** UNLOCK MUTEX *********/
+}
+
 int TcpStream::status(std::ostream &out)
 {
 	tcpMtx.lock();   /********** LOCK MUTEX *********/
@@ -1060,12 +1083,11 @@ int	TcpStream::cleanup()
 		delete db;
 	}
 
-	while(outPkt.size() > 0)
+	while(!outPkt.empty())
 	{
-		TcpPacket *pkt = outPkt.front();
-		outPkt.pop_front();
-		delete pkt;
+		delete outPkt.pop_front();
 	}
+	inRecovery = false;
 
 
 	// clear arrays.
@@ -1235,6 +1257,8 @@ int TcpStream::incoming_Closed(TcpPacket *pkt)
 		inAckno = initPeerSeqno + 1;
 		outWinSize = pkt -> winsize;
 
+		/* our SYN (if any) offered SACK already, so the peer decides */
+		sackEnabled = sackPermitted && pkt -> hasSackPermitted();
 
 		inWinSize = maxWinSize;
 
@@ -1252,11 +1276,14 @@ int TcpStream::incoming_Closed(TcpPacket *pkt)
 			outAcked = outSeqno; /* min - 1 expected */
 
 			/* setup Congestion Charging */
-			congestThreshold = TCP_MAX_WIN;
-			congestWinSize   = MAX_SEG;
-			congestUpdate    = outAcked + congestWinSize;
+			congestion.reset();
+			inRecovery = false;
 
 			rsp -> setSyn();
+			if (sackEnabled)
+			{
+				rsp -> setSackPermitted();
+			}
 		}
 		
 		rsp -> setAck(inAckno);
@@ -1326,6 +1353,8 @@ int TcpStream::incoming_SynSent(TcpPacket *pkt)
 		outWinSize = pkt -> winsize;
 
 		outAcked = pkt -> getAck();
+
+		sackEnabled = sackPermitted && pkt -> hasSackPermitted();
 	
 		/* before ACK, reset the TTL 
 		 * As they have sent something, and we have received 
@@ -1500,6 +1529,11 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 
 		outWinSize = pkt->winsize;
 
+		if ((sackEnabled) && (pkt->sackCount))
+		{
+			processSack(pkt);
+		}
+
 #ifdef DEBUG_TCP_STREAM
 		std::cerr << "\tUpdating OutWinSize to: " << outWinSize;
 		std::cerr << std::endl;
@@ -1535,6 +1569,8 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 	}
 
 
+	bool hasData = (pkt->datasize > 0);
+
 	/* add to queue */
 	inPkt.push_back(pkt);
 
@@ -1552,7 +1588,16 @@ int TcpStream::incoming_Established(TcpPacket *pkt)
 	}
 
 	/* use as many packets as possible */
-	return check_InPkts();
+	int ret = check_InPkts();
+
+	/* data left out of order -> something is missing, 
+	 * tell the sender straight away what we have got.
+	 */
+	if ((sackEnabled) && (hasData) && (!inPkt.empty()))
+	{
+		sendAck();
+	}
+	return ret;
 }
 
 int TcpStream::check_InPkts()
@@ -1865,7 +1910,7 @@ void TcpStream::setRemoteAddress(const struct sockaddr_in &raddr)
 
 int TcpStream::toSend(TcpPacket *pkt, bool retrans)
 {
-	int  outPktSize = MAX_SEG + TCP_PSEUDO_HDR_SIZE;
+	int  outPktSize = MAX_SEG + TCP_PSEUDO_HDR_SIZE + TCP_MAX_SACK_SIZE;
 	char tmpOutPkt[outPktSize];
 
 	if (!peerKnown)
@@ -1909,6 +1954,7 @@ int TcpStream::toSend(TcpPacket *pkt, bool retrans)
 	{
 		/* cannot auto Ack SynPackets */
 		pkt -> setAck(inAckno);
+		fillSackBlocks(pkt);
 	}
 
 	pkt -> winsize = inWinSize;
@@ -2037,7 +2083,7 @@ void TcpStream::incRetransmitTimeout()
 
 int TcpStream::retrans()
 {
-	int  outPktSize = MAX_SEG + TCP_PSEUDO_HDR_SIZE;
+	int  outPktSize = MAX_SEG + TCP_PSEUDO_HDR_SIZE + TCP_MAX_SACK_SIZE;
 	char tmpOutPkt[outPktSize];
 
 	if (!peerKnown)
@@ -2061,7 +2107,7 @@ int TcpStream::retrans()
 		return 0;
 	}
 
-	if (outPkt.begin() == outPkt.end())
+	if (outPkt.empty())
 	{
 		resetRetransmitTimer();
 		return 0;
@@ -2075,19 +2121,22 @@ int TcpStream::retrans()
 		return 0;
 	}
 	
-	/* retransmission -> adjust the congestWinSize and congestThreshold 
-	*/
+	/* retransmission -> back to slow start.
+	 * Only the first timeout of a packet lowers the threshold,
+	 * (or a timeout of a fast retransmit, which was lost again).
+	 */
 
-	congestThreshold = congestWinSize / 2;
-	congestWinSize = MAX_SEG;
-	congestUpdate  = outAcked + congestWinSize; // point when we can up the winSize.
+	if ((pkt->retrans == 0) || (inRecovery))
+	{
+		congestion.onTimeout();
+	}
+	inRecovery = false;
 	
 #ifdef DEBUG_TCP_STREAM
 	std::cerr << "TcpStream::retrans() Adjusting Congestion Parameters: ";
 	std::cerr << std::endl;
-	std::cerr << "\tcongestWinSize: " << congestWinSize;
-	std::cerr << "  congestThreshold: " << congestThreshold;
-	std::cerr << "  congestUpdate: " << congestUpdate;
+	std::cerr << "\tcongestWinSize: " << congestion.window();
+	std::cerr << "  congestThreshold: " << congestion.threshold();
 	std::cerr << std::endl;
 #endif
 	
@@ -2096,6 +2145,7 @@ int TcpStream::retrans()
 	{
 		pkt->setAck(inAckno);
 		lastSentAck = pkt -> ackno;
+		fillSackBlocks(pkt);
 	}
 	
 	pkt->winsize = inWinSize;
@@ -2212,57 +2262,195 @@ int TcpStream::retrans()
 }
 
 
-void TcpStream::acknowledge()
+/* Receiver side: describe the out of order data waiting in inPkt, 
+ * as merged [left, right) ranges, lowest first.
+ */
+void TcpStream::fillSackBlocks(TcpPacket *pkt)
 {
-	/* cleans up acknowledge packets */
-	/* packets are pushed back in order */
-	std::list<TcpPacket *>::iterator it;
-	double cts = getCurrentTS();
-	bool updateRTT = true;
-	bool clearedPkts = false;
+	pkt->sackCount = 0;
 
-	for(it = outPkt.begin(); (it != outPkt.end()) && 
-			(isOldSequence((*it)->seqno, outAcked)); 
-			it = outPkt.erase(it))
+	if ((!sackEnabled) || (inPkt.empty()))
 	{
-		TcpPacket *pkt = (*it);
-		clearedPkts = true;
+		return;
+	}
 
-		/* adjust the congestWinSize and congestThreshold 
-		 * congestUpdate <= outAcked
-		 *
-		 ***/
+	/* offsets from inAckno, so sorting copes with seqno rollover */
+	std::vector<std::pair<uint32, uint32> > ranges;
+	std::list<TcpPacket *>::iterator it;
+	for(it = inPkt.begin(); it != inPkt.end(); ++it)
+	{
+		if (((*it)->datasize > 0) && (isOldSequence(inAckno, (*it)->seqno)))
+		{
+			uint32 offset = (*it)->seqno - inAckno;
+			ranges.push_back(std::make_pair(offset, offset + (*it)->datasize));
+		}
+	}
 
-		if (!isOldSequence(outAcked, congestUpdate))
+	std::sort(ranges.begin(), ranges.end());
+
+	for(uint32 i = 0; i < ranges.size(); i++)
+	{
+		int last = pkt->sackCount - 1;
+		if ((last >= 0) && (ranges[i].first <= pkt->sackRight[last] - inAckno))
 		{
-			if (congestWinSize < congestThreshold)
+			/* overlapping or contiguous -> extend */
+			if (ranges[i].second > pkt->sackRight[last] - inAckno)
 			{
-				/* double it baby! */
-				congestWinSize *= 2;
-			}
-			else
-			{
-				/* linear increase */
-				congestWinSize += MAX_SEG;
+				pkt->sackRight[last] = inAckno + ranges[i].second;
 			}
+			continue;
+		}
 
-			if (congestWinSize > maxWinSize)
+		if (pkt->sackCount == TCP_MAX_SACK_BLOCKS)
+		{
+			break;
+		}
+
+		pkt->sackLeft[pkt->sackCount]  = inAckno + ranges[i].first;
+		pkt->sackRight[pkt->sackCount] = inAckno + ranges[i].second;
+		pkt->sackCount++;
+	}
+
+#ifdef DEBUG_TCP_STREAM
+	std::cerr << "TcpStream::fillSackBlocks() inAckno: " << inAckno;
+	for(int i = 0; i < pkt->sackCount; i++)
+	{
+		std::cerr << " [" << pkt->sackLeft[i] << ", " << pkt->sackRight[i] << ")";
+	}
+	std::cerr << std::endl;
+#endif
+}
+
+
+/* Sender side: mark what the peer reported as received, then the
+ * packets below enough SACKed data are taken as lost, and get
+ * resent by fastRetrans() without waiting for the timeout.
+ */
+void TcpStream::processSack(TcpPacket *pkt)
+{
+	for(uint32 i = 0; i < outPkt.size(); i++)
+	{
+		TcpPacket *out = outPkt[i];
+		if ((out->sacked) || (out->datasize == 0))
+		{
+			continue;
+		}
+
+		for(int j = 0; j < pkt->sackCount; j++)
+		{
+			if ((!isOldSequence(out->seqno, pkt->sackLeft[j])) && 
+				(!isOldSequence(pkt->sackRight[j], out->seqno + out->datasize)))
 			{
-				congestWinSize = maxWinSize;
+				out->sacked = true;
+				out->lost = false;
+				break;
 			}
+		}
+	}
 
-			congestUpdate  = outAcked + congestWinSize; // point when we can up the winSize.
+	/* walk down from the newest packet, counting SACKed bytes above */
+	uint32 sackedAbove = 0;
+	bool newLoss = false;
+	for(uint32 i = outPkt.size(); i > 0; i--)
+	{
+		TcpPacket *out = outPkt[i - 1];
+		if (out->sacked)
+		{
+			sackedAbove += out->datasize;
+		}
+		else if ((sackedAbove >= kSackDupThresh) && (out->datasize > 0) && 
+				(!out->lost) && (out->retrans == 0) && 
+				(!isOldSequence(out->seqno, outAcked)))
+		{
+			out->lost = true;
+			newLoss = true;
+		}
+	}
+
+	/* one window reduction per loss episode */
+	if ((newLoss) && (!inRecovery))
+	{
+		congestion.onLoss();
+		inRecovery = true;
+		recoveryPoint = outSeqno;
 
 #ifdef DEBUG_TCP_STREAM
-			std::cerr << "TcpStream::acknowledge() Adjusting Congestion Parameters: ";
-			std::cerr << std::endl;
-			std::cerr << "\tcongestWinSize: " << congestWinSize;
-			std::cerr << "  congestThreshold: " << congestThreshold;
-			std::cerr << "  congestUpdate: " << congestUpdate;
-			std::cerr << std::endl;
+		std::cerr << "TcpStream::processSack() Loss detected, recovery until: ";
+		std::cerr << recoveryPoint << " congestWinSize: " << congestion.window();
+		std::cerr << std::endl;
 #endif
+	}
+}
+
+
+int TcpStream::fastRetrans()
+{
+	int  outPktSize;
+	char tmpOutPkt[MAX_SEG + TCP_PSEUDO_HDR_SIZE + TCP_MAX_SACK_SIZE];
+
+	if ((!peerKnown) || (!inRecovery))
+	{
+		return 0;
+	}
+
+	double cts = getCurrentTS();
+	int sent = 0;
+
+	for(uint32 i = 0; i < outPkt.size(); i++)
+	{
+		TcpPacket *pkt = outPkt[i];
+		if (!pkt->lost)
+		{
+			continue;
 		}
 
+		pkt->setAck(inAckno);
+		pkt->winsize = inWinSize;
+		fillSackBlocks(pkt);
+
+		lastSentAck = pkt -> ackno;
+		lastSentWinSize = pkt -> winsize;
+		keepAliveTimer = cts;
+
+		outPktSize = sizeof(tmpOutPkt);
+		pkt->writePacket(tmpOutPkt, outPktSize);
+
+#ifdef DEBUG_TCP_STREAM_RETRANS
+		std::cerr << "TcpStream::fastRetrans()";
+		std::cerr << " peer: " << peeraddr;
+		std::cerr << " Seqno: ";
+		std::cerr << pkt->seqno << " size: " << pkt->datasize;
+		std::cerr << std::endl;
+#endif
+
+		udp -> sendPkt(tmpOutPkt, outPktSize, peeraddr, ttl);
+
+		/* retrans also keeps it out of the RTT estimate (Karn) */
+		pkt->lost = false;
+		pkt->ts = cts;
+		pkt->retrans++;
+		sent++;
+	}
+	return sent;
+}
+
+
+void TcpStream::acknowledge()
+{
+	/* cleans up acknowledge packets */
+	/* packets are pushed back in order */
+	double cts = getCurrentTS();
+	bool updateRTT = true;
+	bool clearedPkts = false;
+	uint32 ackedBytes = 0;
+
+	while((!outPkt.empty()) && 
+			(isOldSequence(outPkt.front()->seqno, outAcked)))
+	{
+		TcpPacket *pkt = outPkt.pop_front();
+		clearedPkts = true;
+		ackedBytes += pkt->datasize;
+
 
 		/* update the RoundTripTime, 
 		 * using Jacobson's values.
@@ -2328,6 +2516,31 @@ void TcpStream::acknowledge()
 		delete pkt;
 	}
 
+	/* adjust the congestion window, 
+	 * it stays reduced while repairing SACK detected losses.
+	 */
+	if (ackedBytes)
+	{
+		if ((inRecovery) && (!isOldSequence(outAcked, recoveryPoint)))
+		{
+			inRecovery = false;
+		}
+
+		if (!inRecovery)
+		{
+			congestion.onAck(ackedBytes, rtt_est, cts);
+		}
+
+#ifdef DEBUG_TCP_STREAM
+		std::cerr << "TcpStream::acknowledge() Adjusting Congestion Parameters: ";
+		std::cerr << std::endl;
+		std::cerr << "\tcongestWinSize: " << congestion.window();
+		std::cerr << "  congestThreshold: " << congestion.threshold();
+		std::cerr << "  inRecovery: " << inRecovery;
+		std::cerr << std::endl;
+#endif
+	}
+
 	/* This is triggered if we have recieved acks for retransmitted packets....
 	 * In this case we want to reset the timeout, and remove the doubling.
 	 *
@@ -2342,7 +2555,7 @@ void TcpStream::acknowledge()
 	 * if have acked all data - resetRetransTimer()
 	 */
 
-	if (it == outPkt.end())
+	if (outPkt.empty())
 	{
 
 #ifdef DEBUG_TCP_STREAM
@@ -2371,6 +2584,8 @@ int TcpStream::send()
 	/* handle network interface always */
 	/* clean up as much as possible */
 	acknowledge();
+	/* resend what SACKs reported missing */
+	fastRetrans();
 	/* send any old packets */
 	retrans();
 
@@ -2384,10 +2599,10 @@ int TcpStream::send()
 
 
 	/* determine exactly how much we can send */
-	uint32 maxsend = congestWinSize;
+	uint32 maxsend = congestion.window();
 	uint32 inTransit;
 
-	if (outWinSize < congestWinSize)
+	if (outWinSize < maxsend)
 	{
 		maxsend = outWinSize;
 	}
@@ -2401,6 +2616,15 @@ int TcpStream::send()
 		inTransit = outSeqno - outAcked;
 	}
 
+	/* SACKed data has left the network */
+	for(uint32 i = 0; i < outPkt.size(); i++)
+	{
+		if ((outPkt[i]->sacked) && (inTransit >= (uint32) outPkt[i]->datasize))
+		{
+			inTransit -= outPkt[i]->datasize;
+		}
+	}
+
 	if (maxsend > inTransit)
 	{
 		maxsend -= inTransit;
@@ -2414,13 +2638,13 @@ int TcpStream::send()
 	int availSend = inQueue.size() * MAX_SEG + inSize;
 		std::cerr << "TcpStream::send() CC: ";
 		std::cerr << "oWS: " << outWinSize;
-		std::cerr << " cWS: " << congestWinSize;
+		std::cerr << " cWS: " << congestion.window();
 		std::cerr << " | inT: " << inTransit;
 		std::cerr << " mSnd: " << maxsend;
 		std::cerr << " aSnd: " << availSend;
 		std::cerr << " | oSeq: " << outSeqno;
 		std::cerr << "  oAck: " << outAcked;
-		std::cerr << "  cUpd: " << congestUpdate;
+		std::cerr << "  ssT: " << congestion.threshold();
 		std::cerr << std::endl;
 #endif
 
@@ -2728,9 +2952,14 @@ int TcpStream::dumpstate_locked(std::ostream &out)
 	out << " rtt_dev: " << rtt_dev;
 	out << std::endl;
 
-	out << "(congestion) congestThreshold: " << congestThreshold;
-	out << " congestWinSize: " << congestWinSize;
-	out << " congestUpdate: " << congestUpdate;
+	out << "(congestion) congestThreshold: " << congestion.threshold();
+	out << " congestWinSize: " << congestion.window();
+	out << " lastMaxWinSize: " << congestion.lastMaxWindow();
+	out << std::endl;
+
+	out << "(sack) sackEnabled: " << sackEnabled;
+	out << " inRecovery: " << inRecovery;
+	out << " recoveryPoint: " << recoveryPoint;
 	out << std::endl;
 
 	out << "(TTL) mTTL_period: " << mTTL_period;
@@ -30,6 +30,7 @@
  */
 
 #include "tcppacket.h"
+#include "tcpcongestion.h"
 #include "udppeer.h"
 
 // WINDOWS doesn't like UDP packets bigger than 1492 (truncates them). 
@@ -115,6 +116,9 @@ uint32 	rbytes();
 	/* Exposed for debugging */
 int     dumpstate(std::ostream &out);
 
+	/* offer SACK in the handshake (default), disable to talk like old peers */
+void	setSackPermitted(bool allowed);
+
 	private: 
 
 	/* Internal Functions - use the Mutex (not reentrant) */
@@ -160,6 +164,11 @@ void 	setRemoteAddress(const struct sockaddr_in &raddr);
 int	getTTL() { return ttl; }
 void	setTTL(int t) { ttl = t; }
 
+/* selective acknowledgments */
+void	fillSackBlocks(TcpPacket *pkt);
+void	processSack(TcpPacket *pkt);
+int	fastRetrans();
+
 /* retransmission */
 void 	startRetransmitTimer();
 void 	restartRetransmitTimer();
@@ -191,7 +200,8 @@ uint32 	int_rbytes();
 	std::deque<dataBuffer *>   inQueue, outQueue;
 
 	/* packets waiting for acks */
-	std::list<TcpPacket *> inPkt, outPkt;
+	std::list<TcpPacket *> inPkt;
+	TcpPacketRing outPkt;
 
 
 	uint8  state; /* stream state */
@@ -234,9 +244,13 @@ uint32 	int_rbytes();
 	double rtt_dev;
 
 	/* congestion limits */
-	uint32 congestThreshold;
-	uint32 congestWinSize;
-	uint32 congestUpdate;
+	TcpCongestionControl congestion;
+
+	/* SACK: negotiated in the SYNs */
+	bool   sackPermitted;
+	bool   sackEnabled;
+	bool   inRecovery; /* after a SACK detected loss, until recoveryPoint is acked */
+	uint32 recoveryPoint;
 
 	/* existing TTL for this stream (tweaked at startup) */
 	int ttl;
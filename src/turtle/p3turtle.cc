@@ -1302,12 +1302,13 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 		}
 
 		TurtleTunnel& tunnel(it->second) ;
+		uint32_t item_size = RsTurtleSerialiser().size(item);
 
 		// Only file data transfer updates tunnels time_stamp field, to avoid maintaining tunnel that are incomplete.
 		if(item->shouldStampTunnel())
 			tunnel.time_stamp = time(NULL) ;
 
-		tunnel.transfered_bytes += RsTurtleSerialiser().size(item);
+		tunnel.transfered_bytes += item_size;
 
 		if(item->PeerId() == tunnel.local_dst)
 			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
@@ -1333,7 +1334,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 #endif
 			item->PeerId(tunnel.local_src) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item) ;
+			_traffic_info_buffer.unknown_updn_Bps += item_size ;
 
 			// This has been disabled for compilation reasons. Not sure we actually need it.
 			//
@@ -1351,7 +1352,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 #endif
 			item->PeerId(tunnel.local_dst) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item);
+			_traffic_info_buffer.unknown_updn_Bps += item_size;
 
 			sendItem(item) ;
 			return ;
@@ -1359,7 +1360,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 
         // item is for us. Use the locked region to record the data.
 
-        _traffic_info_buffer.data_dn_Bps += RsTurtleSerialiser().size(item);
+        _traffic_info_buffer.data_dn_Bps += item_size;
     }
 
 	// The packet was not forwarded, so it is for us. Let's treat it.
@@ -1371,6 +1372,97 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 	delete item ;
 }
 
+// Generic tunnel items all serialise their tunnel id first, right after the item
+// header, which is all a middle hop needs to route them. Returns false for
+// subtypes that are not generic tunnel items.
+//
+static bool getRawTunnelItemInfo(uint8_t subtype,uint8_t& priority,bool& stamps_tunnel)
+{
+	switch(subtype)
+	{
+	case RS_TURTLE_SUBTYPE_FILE_REQUEST:      priority = QOS_PRIORITY_RS_TURTLE_FILE_REQUEST;      stamps_tunnel = false; return true;
+	case RS_TURTLE_SUBTYPE_FILE_DATA:         priority = QOS_PRIORITY_RS_TURTLE_FILE_DATA;         stamps_tunnel = true;  return true;
+	case RS_TURTLE_SUBTYPE_FILE_MAP_REQUEST:  priority = QOS_PRIORITY_RS_TURTLE_FILE_MAP_REQUEST;  stamps_tunnel = false; return true;
+	case RS_TURTLE_SUBTYPE_FILE_MAP:          priority = QOS_PRIORITY_RS_TURTLE_FILE_MAP;          stamps_tunnel = false; return true;
+	case RS_TURTLE_SUBTYPE_CHUNK_CRC_REQUEST: priority = QOS_PRIORITY_RS_CHUNK_CRC_REQUEST;        stamps_tunnel = false; return true;
+	case RS_TURTLE_SUBTYPE_CHUNK_CRC:         priority = QOS_PRIORITY_RS_CHUNK_CRC;                stamps_tunnel = true;  return true;
+	case RS_TURTLE_SUBTYPE_GENERIC_DATA:      priority = QOS_PRIORITY_RS_TURTLE_GENERIC_DATA;      stamps_tunnel = true;  return true;
+	case RS_TURTLE_SUBTYPE_GENERIC_FAST_DATA: priority = QOS_PRIORITY_RS_TURTLE_GENERIC_FAST_DATA; stamps_tunnel = true;  return true;
+	default:
+		return false;
+	}
+}
+
+bool p3turtle::recv(RsRawItem *item)
+{
+	if(relayRawTunnelItem(item))
+		return true;
+
+	return p3Service::recv(item);
+}
+
+// Called by the service server off-mutex, for each incoming raw turtle packet.
+// Relaying is most of the turtle traffic, so packets that only transit
+// through us are forwarded as is. Accounting is done from the packet length,
+// which is the serialised size of the item.
+//
+bool p3turtle::relayRawTunnelItem(RsRawItem *item)
+{
+	uint8_t priority ;
+	bool stamps_tunnel ;
+
+	if(!getRawTunnelItemInfo(item->PacketSubType(),priority,stamps_tunnel))
+		return false;
+
+	uint32_t item_size = item->getRawLength();
+	uint32_t offset = 8;	// item header
+	uint32_t tunnel_id = 0;
+
+	if(!getRawUInt32(item->getRawData(),item_size,&offset,&tunnel_id))
+		return false;	// let the deserialiser complain about it
+
+	RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+	if(!(_turtle_routing_enabled && _turtle_routing_session_enabled))
+		return false;
+
+	std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(tunnel_id)) ;
+
+	if(it == _local_tunnels.end())
+	{
+#ifdef P3TURTLE_DEBUG
+		std::cerr << "p3turtle: got raw tunnel item with unknown tunnel id " << HEX_PRINT(tunnel_id) << std::endl ;
+#endif
+		delete item;
+		return true;
+	}
+
+	TurtleTunnel& tunnel(it->second) ;
+	RsPeerId next_hop ;
+
+	if(item->PeerId() == tunnel.local_dst && tunnel.local_src != _own_id)
+		next_hop = tunnel.local_src ;
+	else if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id)
+		next_hop = tunnel.local_dst ;
+	else
+		return false;	// we are an end point of that tunnel, or the item is lost.
+
+	if(stamps_tunnel)
+		tunnel.time_stamp = time(NULL) ;
+
+	tunnel.transfered_bytes += item_size;
+	_traffic_info_buffer.unknown_updn_Bps += item_size ;
+
+#ifdef P3TURTLE_DEBUG
+	std::cerr << "  Forwarding raw tunnel item of size " << item_size << " to peer " << next_hop << std::endl ;
+#endif
+	item->PeerId(next_hop) ;
+	item->setPriorityLevel(priority) ;
+
+	pqiService::send(item) ;
+	return true;
+}
+
 void p3turtle::handleRecvGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 {
 #ifdef P3TURTLE_DEBUG
@@ -305,6 +305,12 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		///
 		virtual int tick();
 
+		/// Tunnel packets for which we are a middle hop are relayed here
+		/// from their raw bytes, without being deserialised. Everything
+		/// else goes through the regular p3Service path.
+		///
+		virtual bool recv(RsRawItem *item);
+
 		virtual void getItemNames(std::map<uint8_t,std::string>& names) const;
 
 		/************* from p3Config *******************/
@@ -380,6 +386,11 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// Generic routing function for all tunnel packets that derive from RsTurtleGenericTunnelItem
 		void routeGenericTunnelItem(RsTurtleGenericTunnelItem *item) ;
 
+		/// Forwards a raw tunnel packet if we are a middle hop of its tunnel. Returns
+		/// true if the packet was consumed (forwarded or dropped), false if it needs
+		/// to be deserialised and handled by routeGenericTunnelItem().
+		bool relayRawTunnelItem(RsRawItem *item) ;
+
 		/// specific routing functions for handling particular packets.
 		void handleRecvGenericTunnelItem(RsTurtleGenericTunnelItem *item);
 		bool getTunnelServiceInfo(TurtleTunnelId, RsPeerId& virtual_peer_id, RsFileHash& hash, RsTurtleClientService*&) ;
@@ -154,6 +154,9 @@ RetroDb::~RetroDb() { closeDb(); }
 
 void RetroDb::closeDb()
 {
+	// cached statements would make sqlite3_close fail with SQLITE_BUSY
+	clearStatementCache();
+
 	// no-op if mDb is nullptr (https://www.sqlite.org/c3ref/close.html)
 	int rc = sqlite3_close(mDb);
 	mDb = nullptr;
@@ -278,6 +281,56 @@ bool RetroDb::isOpen() const {
 
 bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColumnHack */, const ContentValue &cv){
 
+    std::string sqlQuery;
+    std::list<RetroBind*> paramBindings;
+    buildInsertQuery(table, cv, sqlQuery, paramBindings);
+
+#ifdef RETRODB_DEBUG
+    std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
+#endif
+
+    return execCachedSQL_bind(sqlQuery, paramBindings);
+}
+
+bool RetroDb::sqlInsertBatch(const std::string &table, const std::list<ContentValue> &rows,
+                             std::vector<uint32_t> *failed)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // do not nest transactions, if the caller has one open just join it
+    bool ownTransaction = (sqlite3_get_autocommit(mDb) != 0);
+
+    if(ownTransaction && !beginTransaction())
+        return false;
+
+    bool ok = true;
+    uint32_t pos = 0;
+
+    for(std::list<ContentValue>::const_iterator it = rows.begin(); it != rows.end(); ++it, ++pos)
+    {
+        std::string sqlQuery;
+        std::list<RetroBind*> paramBindings;
+        buildInsertQuery(table, *it, sqlQuery, paramBindings);
+
+        if(!execCachedSQL_bind(sqlQuery, paramBindings))
+        {
+            ok = false;
+            if(failed)
+                failed->push_back(pos);
+        }
+    }
+
+    if(ownTransaction)
+        ok = commitTransaction() && ok;
+
+    return ok;
+}
+
+void RetroDb::buildInsertQuery(const std::string &table, const ContentValue &cv,
+                               std::string &query, std::list<RetroBind*> &paramBindings)
+{
     std::map<std::string, uint8_t> keyTypeMap;
     cv.getKeyTypeMap(keyTypeMap);
     std::map<std::string, uint8_t>::iterator mit = keyTypeMap.begin();
@@ -302,19 +355,10 @@ bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColu
 
     // build values part of insertion
     std::string qValues;
-    std::list<RetroBind*> paramBindings;
     buildInsertQueryValue(keyTypeMap, cv, qValues, paramBindings);
 
     // complete insertion query
-    std::string sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
-
-    bool ok = execSQL_bind(sqlQuery, paramBindings);
-
-#ifdef RETRODB_DEBUG
-    std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
-#endif
-
-    return ok;
+    query = "INSERT INTO " + qColumns + " " + qValues;
 }
 
 std::string RetroDb::getKey() const
@@ -322,6 +366,25 @@ std::string RetroDb::getKey() const
 	return mKey;
 }
 
+bool RetroDb::execPragma(const std::string &pragma)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    std::string query = "PRAGMA " + pragma + ";";
+
+    int rc = sqlite3_exec(mDb, query.c_str(), nullptr, nullptr, nullptr);
+
+    if(rc != SQLITE_OK){
+        std::cerr << "RetroDb::execPragma(): Error executing " << query
+                  << " Error: " << sqlite3_errmsg(mDb) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 bool RetroDb::beginTransaction()
 {
     if (!isOpen()) {
@@ -364,9 +427,43 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         std::cerr << "RetroDb::execSQL_bind(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
+
+        for(std::list<RetroBind*>::iterator lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+        paramBindings.clear();
+
+        return false;
+    }
+
+    bool ok = bindAndStep(stm, query, paramBindings);
+
+    // finalise statement or else db cannot be closed
+    sqlite3_finalize(stm);
+    return ok;
+}
+
+bool RetroDb::execCachedSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings){
+
+    sqlite3_stmt* stm = getCachedStatement(query);
+
+    if(!stm){
+        for(std::list<RetroBind*>::iterator lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+        paramBindings.clear();
+
         return false;
     }
 
+    bool ok = bindAndStep(stm, query, paramBindings);
+
+    // keep the compiled statement around for the next row
+    sqlite3_reset(stm);
+    sqlite3_clear_bindings(stm);
+    return ok;
+}
+
+bool RetroDb::bindAndStep(sqlite3_stmt *stm, const std::string &query, std::list<RetroBind*> &paramBindings){
+
     std::list<RetroBind*>::iterator lit = paramBindings.begin();
 
     for(; lit != paramBindings.end(); ++lit){
@@ -381,10 +478,11 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         delete rb;
         rb = NULL;
     }
+    paramBindings.clear();
 
-    uint32_t delta = 3;
-    rstime_t stamp = time(NULL), now = 0;
+    rstime_t stamp = time(NULL);
     bool timeOut = false, ok = false;
+    int rc = SQLITE_OK;
 
     while(!timeOut){
 
@@ -400,10 +498,8 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
             break;
         }
 
-        now = time(NULL);
-        delta = stamp - now;
-
-        if(delta > TIME_LIMIT){
+        if(time(NULL) > stamp + TIME_LIMIT)
+        {
             ok = false;
             timeOut = true;
         }
@@ -424,11 +520,53 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         }
     }
 
-    // finalise statement or else db cannot be closed
-    sqlite3_finalize(stm);
     return ok;
 }
 
+/* Queries only differ by table and column names, so a handful of statements
+ * covers all callers. The bound is a safety net against callers building
+ * many different column sets. */
+#define MAX_CACHED_STATEMENTS 64
+
+sqlite3_stmt* RetroDb::getCachedStatement(const std::string &query){
+
+    std::map<std::string, sqlite3_stmt*>::iterator mit = mStatementCache.find(query);
+
+    if(mit != mStatementCache.end())
+        return mit->second;
+
+    if(mStatementCache.size() >= MAX_CACHED_STATEMENTS)
+        clearStatementCache();
+
+#ifdef RETRODB_DEBUG
+    std::cerr << "Caching query: " << query << std::endl;
+#endif
+
+    sqlite3_stmt* stm = NULL;
+    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+
+    if(rc != SQLITE_OK){
+        std::cerr << "RetroDb::getCachedStatement(): Error preparing statement\n";
+        std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
+                  << std::endl;
+        sqlite3_finalize(stm);
+        return NULL;
+    }
+
+    mStatementCache[query] = stm;
+    return stm;
+}
+
+void RetroDb::clearStatementCache(){
+
+    std::map<std::string, sqlite3_stmt*>::iterator mit = mStatementCache.begin();
+
+    for(; mit != mStatementCache.end(); ++mit)
+        sqlite3_finalize(mit->second);
+
+    mStatementCache.clear();
+}
+
 void RetroDb::buildInsertQueryValue(const std::map<std::string, uint8_t> keyTypeMap,
 		const ContentValue& cv, std::string& parameter,
 		std::list<RetroBind*>& paramBindings)
@@ -504,11 +642,12 @@ void RetroDb::buildInsertQueryValue(const std::map<std::string, uint8_t> keyType
 
 void RetroDb::buildUpdateQueryValue(const std::map<std::string, uint8_t> keyTypeMap,
 		const ContentValue& cv, std::string& parameter,
-		std::list<RetroBind*>& paramBindings)
+		std::list<RetroBind*>& paramBindings,
+		const std::string& separator, int firstIndex)
 {
 	std::map<std::string, uint8_t>::const_iterator mit = keyTypeMap.begin();
 
-	int index = 0;
+	int index = firstIndex;
     for(mit=keyTypeMap.begin(); mit!=keyTypeMap.end(); ++mit)
     {
 
@@ -563,7 +702,7 @@ void RetroDb::buildUpdateQueryValue(const std::map<std::string, uint8_t> keyType
         	if(mit == keyTypeMap.end())
         		parameter += key + "=?";
         	else
-        		parameter += key + "=?,";
+        		parameter += key + "=?" + separator;
 
         	--mit;
         }
@@ -615,6 +754,83 @@ bool RetroDb::sqlUpdate(const std::string &tableName, std::string whereClause, c
     return execSQL_bind(sqlQuery, paramBindings);
 }
 
+bool RetroDb::sqlUpdate(const std::string &tableName, const ContentValue &where, const ContentValue &cv){
+
+    std::string sqlQuery;
+    std::list<RetroBind*> paramBindings;
+
+    if(!buildUpdateQuery(tableName, where, cv, sqlQuery, paramBindings))
+        return false;
+
+    return execCachedSQL_bind(sqlQuery, paramBindings);
+}
+
+bool RetroDb::sqlUpdateBatch(const std::string &tableName, const std::list<UpdateRow> &rows,
+                             std::vector<uint32_t> *failed)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // do not nest transactions, if the caller has one open just join it
+    bool ownTransaction = (sqlite3_get_autocommit(mDb) != 0);
+
+    if(ownTransaction && !beginTransaction())
+        return false;
+
+    bool ok = true;
+    uint32_t pos = 0;
+
+    for(std::list<UpdateRow>::const_iterator it = rows.begin(); it != rows.end(); ++it, ++pos)
+    {
+        std::string sqlQuery;
+        std::list<RetroBind*> paramBindings;
+
+        if(!buildUpdateQuery(tableName, it->where, it->values, sqlQuery, paramBindings)
+                || !execCachedSQL_bind(sqlQuery, paramBindings))
+        {
+            ok = false;
+            if(failed)
+                failed->push_back(pos);
+        }
+    }
+
+    if(ownTransaction)
+        ok = commitTransaction() && ok;
+
+    return ok;
+}
+
+bool RetroDb::buildUpdateQuery(const std::string &table, const ContentValue &where, const ContentValue &cv,
+                               std::string &query, std::list<RetroBind*> &paramBindings)
+{
+    std::map<std::string, uint8_t> keyTypeMap;
+    cv.getKeyTypeMap(keyTypeMap);
+
+    // build SET part of update
+    std::string qValues;
+    buildUpdateQueryValue(keyTypeMap, cv, qValues, paramBindings);
+
+    if(qValues.empty())
+        return false;
+
+    query = "UPDATE " + table + " SET " + qValues;
+
+    // build WHERE part, numbering its parameters after the SET ones
+    std::map<std::string, uint8_t> whereTypeMap;
+    where.getKeyTypeMap(whereTypeMap);
+
+    std::string qWhere;
+    buildUpdateQueryValue(whereTypeMap, where, qWhere, paramBindings,
+                          " AND ", static_cast<int>(paramBindings.size()));
+
+    if(!qWhere.empty())
+        query += " WHERE " + qWhere;
+
+    query += ";";
+    return true;
+}
+
 bool RetroDb::tableExists(const std::string &tableName)
 {
     if (!isOpen()) {
@@ -31,6 +31,7 @@
 #include <set>
 #include <list>
 #include <map>
+#include <vector>
 
 #include "util/rsdebug.h"
 #include "util/rsdbbind.h"
@@ -118,6 +119,14 @@ public:
      */
     bool execSQL(const std::string& query);
 
+    /*!
+     * Runs a PRAGMA statement, whether it returns a value or not, unlike \n
+     * execSQL() which fails on PRAGMA returning data (e.g. journal_mode)
+     * @param pragma statement without the PRAGMA keyword, e.g. "journal_mode=WAL"
+     * @return false if there was an sqlite error, true otherwise
+     */
+    bool execPragma(const std::string& pragma);
+
     /*!
      * inserts a row in a database table
      * @param table table you want to insert content values into
@@ -137,6 +146,52 @@ public:
      */
     bool sqlUpdate(const std::string& tableName, const std::string whereClause, const ContentValue& cv);
 
+    /*!
+     * update rows in a database table, selecting them by value rather than by \n
+     * a literal where clause so that the prepared statement can be cached
+     * @param tableName the table on which to apply the UPDATE
+     * @param where column values identifying the rows to update, all of them \n
+     *        must match (ANDed equality tests)
+     * @param cv Values used to replace current values in accessed record
+     * @return true if update was successful, false otherwise
+     */
+    bool sqlUpdate(const std::string& tableName, const ContentValue& where, const ContentValue& cv);
+
+    /*!
+     * One row of a batched update, see sqlUpdateBatch()
+     */
+    struct UpdateRow
+    {
+        ContentValue values;	// columns to SET
+        ContentValue where;		// columns selecting the rows to update
+    };
+
+    /*!
+     * inserts many rows in a database table. Rows having the same set of \n
+     * columns share one cached prepared statement and all rows are written \n
+     * inside a single transaction, which is opened here unless the caller \n
+     * already has one open
+     * @param table table you want to insert content values into
+     * @param rows entries to insert, one ContentValue per row
+     * @param failed if not null, receives the position in rows of every \n
+     *        insertion that failed
+     * @return true if all insertions were successful, false otherwise
+     */
+    bool sqlInsertBatch(const std::string& table, const std::list<ContentValue>& rows,
+                        std::vector<uint32_t> *failed = nullptr);
+
+    /*!
+     * batched version of sqlUpdate(tableName, where, cv), same transaction \n
+     * and statement caching rules as sqlInsertBatch()
+     * @param tableName the table on which to apply the UPDATE
+     * @param rows values and row selection of each update
+     * @param failed if not null, receives the position in rows of every \n
+     *        update that failed
+     * @return true if all updates were successful, false otherwise
+     */
+    bool sqlUpdateBatch(const std::string& tableName, const std::list<UpdateRow>& rows,
+                        std::vector<uint32_t> *failed = nullptr);
+
     /*!
      * Query the given table, returning a Cursor over the result set
      * @param tableName the table name
@@ -182,6 +237,42 @@ private:
 
     bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs);
 
+    /*!
+     * Same as execSQL_bind() but the statement is taken from (or added to) \n
+     * the statement cache and only reset after execution
+     */
+    bool execCachedSQL_bind(const std::string &query, std::list<RetroBind*>& paramBindings);
+
+    /*!
+     * Binds parameters (and deletes the bindings) then steps statement \n
+     * until done, busy for too long or failed
+     */
+    bool bindAndStep(sqlite3_stmt* stm, const std::string& query, std::list<RetroBind*>& paramBindings);
+
+    /*!
+     * @return prepared statement for query, owned by the cache, NULL on error
+     */
+    sqlite3_stmt* getCachedStatement(const std::string& query);
+
+    /*!
+     * finalizes all cached statements, must be done before closing db
+     */
+    void clearStatementCache();
+
+    /*!
+     * Build a complete "INSERT INTO table(...) VALUES(...)" query
+     */
+    void buildInsertQuery(const std::string& table, const ContentValue& cv,
+            std::string& query, std::list<RetroBind*>& paramBindings);
+
+    /*!
+     * Build a complete "UPDATE table SET ... WHERE ..." query with the where \n
+     * part bound as parameters too
+     * @return false if there is nothing to update
+     */
+    bool buildUpdateQuery(const std::string& table, const ContentValue& where, const ContentValue& cv,
+            std::string& query, std::list<RetroBind*>& paramBindings);
+
     /*!
      * Build the "VALUE" part of an insertiong sql query
      * @param parameter contains place holder query
@@ -194,15 +285,22 @@ private:
      * Build the "VALUE" part of an insertiong sql query
      * @param parameter contains place holder query
      * @param paramBindings
+     * @param separator put between "key=?" place holders
+     * @param firstIndex number of parameters already bound before these
      */
     void buildUpdateQueryValue(const std::map<std::string, uint8_t> keyMap, const ContentValue& cv,
-            std::string& parameter, std::list<RetroBind*>& paramBindings);
+            std::string& parameter, std::list<RetroBind*>& paramBindings,
+            const std::string& separator = ",", int firstIndex = 0);
 
 private:
 
     sqlite3* mDb;
     const std::string mKey;
 
+    /* prepared statements by query text, so effectively by table and set of
+     * columns as values themselves are always bound as parameters */
+    std::map<std::string, sqlite3_stmt*> mStatementCache;
+
 	RS_SET_CONTEXT_DEBUG_LEVEL(3)
 };
 
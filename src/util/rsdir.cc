@@ -666,20 +666,28 @@ bool RsDirUtil::getFileHash(const std::string& filepath, RsFileHash &hash, uint6
 	size = ftello64(fd);
 	fseeko64(fd, 0, SEEK_SET);
 
-	/* check if thread is running */
-	bool isRunning = thread ? thread->isRunning() : true;
-	int runningCheckCount = 0;
+	/* check if the thread was asked to stop */
+	bool isRunning = thread ? !thread->shouldStop() : true;
+
+#ifdef __linux__
+	// Overlap disk reads with hashing: ask the kernel to read ahead the next
+	// buffer while the current one goes through SHA1.
+	uint64_t read_offset = 0;
+	posix_fadvise(fileno(fd), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
 	SHA1_Init(sha_ctx);
 	while(isRunning && (len = fread(gblBuf,1, HASH_BUFFER_SIZE, fd)) > 0)
 	{
+#ifdef __linux__
+		read_offset += len;
+		posix_fadvise(fileno(fd), read_offset, HASH_BUFFER_SIZE, POSIX_FADV_WILLNEED);
+#endif
 		SHA1_Update(sha_ctx, gblBuf, len);
 
-		if (thread && ++runningCheckCount > (10 * 1024)) {
-			/* check all 50MB if thread is running */
-			isRunning = thread->isRunning();
-			runningCheckCount = 0;
-		}
+		/* check every buffer, so that a hashing thread stops quickly */
+		if (thread)
+			isRunning = !thread->shouldStop();
 	}
 
 	/* Thread has ended */
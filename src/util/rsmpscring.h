@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsmpscring.h                                        *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+/*!
+ * Bounded lock-free multi-producer single-consumer ring buffer.
+ *
+ * Any number of threads may push() concurrently, while a single thread at a
+ * time (or several ones serialized by a mutex of their own) may pop(). Each
+ * cell carries a sequence number telling whether it is free for the producer
+ * that reserved it or filled for the consumer, so neither side ever blocks
+ * the other. When the ring is full push() fails and callers must fall back to
+ * some slower path, nothing is dropped silently.
+ *
+ * Contention metrics: retries() counts the producer compare-and-swap attempts
+ * that lost against another producer, overflows() the pushes refused because
+ * the ring was full.
+ */
+template<class T> class RsMpscRing
+{
+public:
+	/// @param capacity rounded up to the next power of two
+	explicit RsMpscRing(uint32_t capacity) :
+	    mRetries(0), mOverflows(0), mEnqueuePos(0), mDequeuePos(0)
+	{
+		uint32_t n = 2;
+		while(n < capacity) n <<= 1;
+
+		mMask = n - 1;
+		mCells.reset(new Cell[n]);
+
+		for(uint32_t i=0;i<n;++i)
+			mCells[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	RsMpscRing(const RsMpscRing&) = delete;
+	RsMpscRing& operator=(const RsMpscRing&) = delete;
+
+	/// @return false if the ring is full, in which case v is left untouched
+	bool push(const T& v)
+	{
+		Cell *cell;
+		size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+		for(;;)
+		{
+			cell = &mCells[pos & mMask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+			if(diff == 0)
+			{
+				if(mEnqueuePos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+
+				mRetries.fetch_add(1, std::memory_order_relaxed);	// pos was reloaded by the failed CAS
+			}
+			else if(diff < 0)
+			{
+				mOverflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else
+				pos = mEnqueuePos.load(std::memory_order_relaxed);	// another producer took this cell
+		}
+
+		cell->data = v;
+		cell->seq.store(pos+1, std::memory_order_release);
+		return true;
+	}
+
+	/// Consumer side only. @return false if there is nothing to pop
+	bool pop(T& v)
+	{
+		size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+		Cell& cell(mCells[pos & mMask]);
+		size_t seq = cell.seq.load(std::memory_order_acquire);
+
+		if((intptr_t)seq - (intptr_t)(pos+1) < 0)
+			return false;
+
+		v = cell.data;
+		cell.seq.store(pos + mMask + 1, std::memory_order_release);
+		mDequeuePos.store(pos+1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/// Approximate number of items, exact when no push/pop is in progress
+	uint32_t size() const
+	{
+		size_t in  = mEnqueuePos.load(std::memory_order_relaxed);
+		size_t out = mDequeuePos.load(std::memory_order_relaxed);
+
+		return in > out ? (uint32_t)(in - out) : 0;
+	}
+
+	uint32_t capacity() const { return mMask + 1; }
+
+	uint64_t retries() const { return mRetries.load(std::memory_order_relaxed); }
+	uint64_t overflows() const { return mOverflows.load(std::memory_order_relaxed); }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	std::unique_ptr<Cell[]> mCells;
+	size_t mMask;
+
+	std::atomic<uint64_t> mRetries;
+	std::atomic<uint64_t> mOverflows;
+
+	// producers and consumer positions on separate cache lines
+	alignas(64) std::atomic<size_t> mEnqueuePos;
+	alignas(64) std::atomic<size_t> mDequeuePos;
+};
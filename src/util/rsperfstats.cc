@@ -0,0 +1,251 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsperfstats.cc                                      *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <time.h>
+
+#include "util/rsperfstats.h"
+#include "util/rsthreads.h"
+#include "util/rsdir.h"
+#include "util/rsdebug.h"
+#include "util/rstime.h"
+
+RsPerfCounter::RsPerfCounter(const std::string& name) :
+    mName(name), mCount(0), mTotalUs(0), mCpuUs(0), mMaxUs(0)
+{
+	for(uint32_t i=0;i<NB_BUCKETS;++i)
+		mBuckets[i].store(0, std::memory_order_relaxed);
+}
+
+uint32_t RsPerfCounter::bucketIndex(uint64_t usec)
+{
+	if(usec < SUB_BUCKETS)
+		return (uint32_t)usec;
+
+	uint32_t magnitude = 63 - __builtin_clzll(usec);
+
+	if(magnitude > MAX_MAGNITUDE)
+		return NB_BUCKETS - 1;
+
+	uint32_t shift = magnitude - SUB_BUCKET_BITS;
+	uint32_t sub = (usec >> shift) & (SUB_BUCKETS - 1);
+
+	return SUB_BUCKETS * (shift + 1) + sub;
+}
+
+uint64_t RsPerfCounter::bucketLowestValue(uint32_t index)
+{
+	if(index < SUB_BUCKETS)
+		return index;
+
+	uint32_t shift = index / SUB_BUCKETS - 1;
+	uint64_t sub = index % SUB_BUCKETS;
+
+	return (SUB_BUCKETS + sub) << shift;
+}
+
+uint64_t RsPerfCounter::bucketHighestValue(uint32_t index)
+{
+	if(index < SUB_BUCKETS)
+		return index;
+
+	uint32_t shift = index / SUB_BUCKETS - 1;
+
+	return bucketLowestValue(index) + (uint64_t(1) << shift) - 1;
+}
+
+void RsPerfCounter::record(uint64_t usec)
+{
+	mBuckets[bucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+	mCount.fetch_add(1, std::memory_order_relaxed);
+	mTotalUs.fetch_add(usec, std::memory_order_relaxed);
+
+	uint64_t max = mMaxUs.load(std::memory_order_relaxed);
+	while( usec > max && !mMaxUs.compare_exchange_weak(
+	           max, usec, std::memory_order_relaxed ) );
+}
+
+void RsPerfCounter::getStats(RsPerfCounterStats& stats) const
+{
+	stats.name = mName;
+	stats.totalUs = mTotalUs.load(std::memory_order_relaxed);
+	stats.cpuUs = mCpuUs.load(std::memory_order_relaxed);
+	stats.maxUs = mMaxUs.load(std::memory_order_relaxed);
+
+	// Count from the buckets themselves, so that percentiles are consistent
+	// even when samples are being added meanwhile.
+	uint64_t buckets[NB_BUCKETS];
+	uint64_t count = 0;
+
+	for(uint32_t i=0;i<NB_BUCKETS;++i)
+		count += (buckets[i] = mBuckets[i].load(std::memory_order_relaxed));
+
+	stats.count = count;
+
+	const double percentiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+	uint64_t* results[4] = { &stats.p50Us, &stats.p90Us, &stats.p99Us, &stats.p999Us };
+
+	uint64_t seen = 0;
+	uint32_t p = 0;
+
+	for(uint32_t i=0;i<NB_BUCKETS && p<4;++i)
+	{
+		seen += buckets[i];
+
+		while(p < 4 && count > 0 && seen >= (uint64_t)std::ceil(percentiles[p] * count))
+			*results[p++] = std::min(bucketHighestValue(i), stats.maxUs);
+	}
+	for(;p<4;++p)
+		*results[p] = 0;
+}
+
+void RsPerfCounter::reset()
+{
+	for(uint32_t i=0;i<NB_BUCKETS;++i)
+		mBuckets[i].store(0, std::memory_order_relaxed);
+
+	mCount.store(0, std::memory_order_relaxed);
+	mTotalUs.store(0, std::memory_order_relaxed);
+	mCpuUs.store(0, std::memory_order_relaxed);
+	mMaxUs.store(0, std::memory_order_relaxed);
+}
+
+namespace
+{
+struct PerfRegistry
+{
+	PerfRegistry() : mMtx("RsPerfStats"), mSince(time(nullptr)) {}
+
+	RsMutex mMtx;
+	rstime_t mSince;
+	std::map<std::string, std::unique_ptr<RsPerfCounter> > mCounters;
+};
+
+PerfRegistry& registry()
+{
+	static PerfRegistry r;
+	return r;
+}
+
+struct PerfCountersDump : RsSerializable
+{
+	rstime_t time;
+	std::vector<RsPerfCounterStats> counters;
+
+	void serial_process( RsGenericSerializer::SerializeJob j,
+	                     RsGenericSerializer::SerializeContext& ctx ) override
+	{
+		RS_SERIAL_PROCESS(time);
+		RS_SERIAL_PROCESS(counters);
+	}
+};
+}
+
+RsPerfCounter& RsPerfStats::counter(const std::string& name)
+{
+	PerfRegistry& r(registry());
+	RsMutex& mtx(r.mMtx);
+	RS_STACK_MUTEX(mtx);
+
+	std::unique_ptr<RsPerfCounter>& c(r.mCounters[name]);
+	if(!c) c.reset(new RsPerfCounter(name));
+
+	return *c;
+}
+
+void RsPerfStats::getStats(std::vector<RsPerfCounterStats>& stats)
+{
+	PerfRegistry& r(registry());
+	RsMutex& mtx(r.mMtx);
+	RS_STACK_MUTEX(mtx);
+
+	stats.clear();
+	stats.resize(r.mCounters.size());
+
+	uint32_t i = 0;
+	for(auto& it: r.mCounters)
+	{
+		it.second->getStats(stats[i]);
+		stats[i++].since = r.mSince;
+	}
+}
+
+void RsPerfStats::reset()
+{
+	PerfRegistry& r(registry());
+	RsMutex& mtx(r.mMtx);
+	RS_STACK_MUTEX(mtx);
+
+	for(auto& it: r.mCounters)
+		it.second->reset();
+
+	r.mSince = time(nullptr);
+}
+
+bool RsPerfStats::dumpToFile(const std::string& fname)
+{
+	PerfCountersDump dump;
+	dump.time = time(nullptr);
+	getStats(dump.counters);
+
+	{
+		std::ofstream f(fname + ".tmp", std::ios::out | std::ios::trunc);
+
+		if(!f)
+		{
+			RS_ERR("Cannot open ", fname, ".tmp for writing");
+			return false;
+		}
+
+		f << dump << std::endl;
+
+		if(!f)
+		{
+			RS_ERR("Cannot write performance counters to ", fname, ".tmp");
+			return false;
+		}
+	}
+
+	return RsDirUtil::renameFile(fname + ".tmp", fname);
+}
+
+uint64_t RsPerfStats::nowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+uint64_t RsPerfStats::threadCpuUs()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+	return 0;
+}
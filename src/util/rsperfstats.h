@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * libretroshare/src/util: rsperfstats.h                                       *
+ *                                                                             *
+ * libretroshare: retroshare core library                                      *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "retroshare/rsconfig.h"
+
+/*!
+ * Lightweight instrumentation of hot paths, meant to stay enabled on
+ * production nodes.
+ *
+ * Each RsPerfCounter is an HDR-style log-linear latency histogram: values up to
+ * 15us have their own bucket, above that each power of two is split into 16
+ * buckets, so percentiles are accurate to about 6% up to several days.
+ * Recording is a couple of relaxed atomic increments and never locks, so any
+ * number of threads may record into the same counter.
+ *
+ * Counters are created once by name in the RsPerfStats registry (which locks)
+ * and then kept by reference. RS_PERF_TICK_SCOPE does that for call sites with
+ * a fixed name:
+ *
+ *     bool ftDataMultiplex::doWork()
+ *     {
+ *         RS_PERF_TICK_SCOPE("ftDataMultiplex::doWork");
+ *         ...
+ *
+ * p3ServiceServer times the tick() of every registered service into
+ * "p3ServiceServer::tick/<service name>". Only code running in threads of its
+ * own needs explicit scopes.
+ */
+class RsPerfCounter
+{
+public:
+	explicit RsPerfCounter(const std::string& name);
+
+	RsPerfCounter(const RsPerfCounter&) = delete;
+	RsPerfCounter& operator=(const RsPerfCounter&) = delete;
+
+	const std::string& name() const { return mName; }
+
+	/// Adds a sample, in microseconds. Lock-free.
+	void record(uint64_t usec);
+
+	/// Adds CPU time spent by the thread in the measured section. Lock-free.
+	void addCpuTime(uint64_t usec) { mCpuUs.fetch_add(usec, std::memory_order_relaxed); }
+
+	/// Summarizes the histogram. Concurrent records may be partially seen.
+	void getStats(RsPerfCounterStats& stats) const;
+
+	void reset();
+
+	static const uint32_t SUB_BUCKET_BITS = 4;
+	static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const uint32_t MAX_MAGNITUDE = 40;	// 2^40us is about 12 days
+	static const uint32_t NB_BUCKETS = SUB_BUCKETS * (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2);
+
+	static uint32_t bucketIndex(uint64_t usec);
+	static uint64_t bucketLowestValue(uint32_t index);
+	static uint64_t bucketHighestValue(uint32_t index);
+
+private:
+	std::string mName;
+
+	std::atomic<uint64_t> mCount;
+	std::atomic<uint64_t> mTotalUs;
+	std::atomic<uint64_t> mCpuUs;
+	std::atomic<uint64_t> mMaxUs;
+	std::atomic<uint64_t> mBuckets[NB_BUCKETS];
+};
+
+/*!
+ * Registry of all counters. Counters are never destroyed, so references
+ * returned by counter() stay valid for the lifetime of the process.
+ */
+class RsPerfStats
+{
+public:
+	/// Returns the counter with that name, creating it if needed. Locks.
+	static RsPerfCounter& counter(const std::string& name);
+
+	static void getStats(std::vector<RsPerfCounterStats>& stats);
+	static void reset();
+
+	/// Writes all counters as JSON, atomically replacing the file.
+	static bool dumpToFile(const std::string& fname);
+
+	/// Monotonic clock, in microseconds
+	static uint64_t nowUs();
+
+	/// CPU time used by the calling thread, in microseconds. 0 if unsupported
+	static uint64_t threadCpuUs();
+};
+
+/*!
+ * Records the time spent between construction and destruction, and optionally
+ * the CPU time used by the thread meanwhile.
+ */
+class RsPerfScope
+{
+public:
+	explicit RsPerfScope(RsPerfCounter& counter, bool measure_cpu = false) :
+	    mCounter(counter), mMeasureCpu(measure_cpu),
+	    mStartUs(RsPerfStats::nowUs()),
+	    mStartCpuUs(measure_cpu ? RsPerfStats::threadCpuUs() : 0) {}
+
+	~RsPerfScope()
+	{
+		mCounter.record(RsPerfStats::nowUs() - mStartUs);
+
+		if(mMeasureCpu)
+			mCounter.addCpuTime(RsPerfStats::threadCpuUs() - mStartCpuUs);
+	}
+
+private:
+	RsPerfCounter& mCounter;
+	bool mMeasureCpu;
+	uint64_t mStartUs;
+	uint64_t mStartCpuUs;
+};
+
+#define RS_PERF_CONCAT_(a, b) a ## b
+#define RS_PERF_CONCAT(a, b) RS_PERF_CONCAT_(a, b)
+
+/// Measures duration and CPU time of the enclosing scope into counter "name"
+#define RS_PERF_TICK_SCOPE(name) \
+	static RsPerfCounter& RS_PERF_CONCAT(rsPerfCounter, __LINE__) = \
+	    RsPerfStats::counter(name); \
+	RsPerfScope RS_PERF_CONCAT(rsPerfScope, __LINE__)( \
+	    RS_PERF_CONCAT(rsPerfCounter, __LINE__), true )
@@ -0,0 +1,75 @@
+################################################################################
+# benchmarks.pri                                                               #
+# Copyright (C) 2026, Retroshare team <retroshare.team@gmailcom>               #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+# Settings shared by the benchmarks. Unlike the unit tests these are built with
+# optimizations on, and print their measurements instead of checking them.
+
+!include("../../retroshare.pri"): error("Could not include file ../../retroshare.pri")
+
+CONFIG -= qt
+CONFIG += console release
+
+TEMPLATE = app
+
+OPENPGPSDK_DIR = ../../openpgpsdk/src
+INCLUDEPATH *= $${OPENPGPSDK_DIR} ../openpgpsdk
+
+################################# Linux ##########################################
+
+linux-* {
+	QMAKE_CXXFLAGS *= -D_FILE_OFFSET_BITS=64
+
+	PRE_TARGETDEPS *= ../../libretroshare/src/lib/libretroshare.a
+	PRE_TARGETDEPS *= ../../openpgpsdk/src/lib/libops.a
+
+	LIBS += ../../libretroshare/src/lib/libretroshare.a
+	LIBS += ../../openpgpsdk/src/lib/libops.a -lbz2
+	LIBS += -lssl -lupnp -lixml
+	LIBS *= -lcrypto -ldl -lz -lpthread
+
+	no_sqlcipher {
+		DEFINES *= NO_SQLCIPHER
+		PKGCONFIG *= sqlite3
+	} else {
+		LIBS += -lsqlcipher
+	}
+}
+
+##################################### MacOS ######################################
+
+macx {
+	LIBS += ../../libretroshare/src/lib/libretroshare.a
+	LIBS += ../../openpgpsdk/src/lib/libops.a -lbz2
+	LIBS += -lssl -lcrypto -lz
+	for(lib, LIB_DIR):exists($$lib/libminiupnpc.a){ LIBS += $$lib/libminiupnpc.a}
+	LIBS += -framework CoreFoundation
+	LIBS += -framework Security
+
+	for(lib, LIB_DIR):LIBS += -L"$$lib"
+
+	LIBS += /usr/local/lib/libsqlcipher.a
+}
+
+############################## Common stuff ######################################
+
+bitdht {
+	LIBS += ../../libbitdht/src/lib/libbitdht.a
+	PRE_TARGETDEPS *= ../../libbitdht/src/lib/libbitdht.a
+}
+
+INCLUDEPATH += ../../libretroshare/src/
@@ -0,0 +1,340 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/serialiser: serialiser_benchmark.cc                *
+ *                                                                             *
+ * RetroShare benchmarks                                                       *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+// Measures the cost of the RsGenericSerializer stack on a few representative items.
+// For each item and each job (size estimate, serialisation, deserialisation), prints
+// the time per item, the throughput and the number of heap allocations per item.
+//
+// usage: serialiser_benchmark [min_time_per_measure_in_ms] [item name filter]
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// from libretroshare
+
+#include "rsitems/rsnxsitems.h"
+#include "rsitems/rsserviceids.h"
+#include "ft/ftturtlefiletransferitem.h"
+#include "chat/rschatitems.h"
+#include "file_sharing/rsfilelistitems.h"
+#include "serialiser/rstypeserializer.h"
+#include "serialiser/rstlvbinary.h"
+
+/******************************** Allocation counting ***************************/
+
+// With glibc, malloc is interposed so that both operator new and rs_malloc()
+// are counted. Elsewhere only operator new is counted.
+
+static uint64_t gAllocationCount = 0 ;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t) ;
+extern "C" void *__libc_calloc(size_t,size_t) ;
+extern "C" void *__libc_realloc(void *,size_t) ;
+
+extern "C" void *malloc(size_t s) { ++gAllocationCount ; return __libc_malloc(s) ; }
+extern "C" void *calloc(size_t n,size_t s) { ++gAllocationCount ; return __libc_calloc(n,s) ; }
+extern "C" void *realloc(void *p,size_t s) { ++gAllocationCount ; return __libc_realloc(p,s) ; }
+#else
+void *operator new(size_t s)
+{
+	++gAllocationCount ;
+
+	void *p = malloc(s) ;
+
+	if(!p)
+		throw std::bad_alloc() ;
+
+	return p ;
+}
+void *operator new[](size_t s) { return operator new(s) ; }
+void operator delete(void *p) noexcept { free(p) ; }
+void operator delete[](void *p) noexcept { free(p) ; }
+void operator delete(void *p,size_t) noexcept { free(p) ; }
+void operator delete[](void *p,size_t) noexcept { free(p) ; }
+#endif
+
+/************************************ Test items *********************************/
+
+static const uint8_t BENCH_SUBTYPE_BINARY_DATA = 0x01 ;
+
+// Holds nothing but a binary TLV, to measure the cost of large RsTlvBinaryData alone.
+//
+class BenchBinaryDataItem: public RsItem
+{
+public:
+	BenchBinaryDataItem()
+	    : RsItem(RS_PKT_VERSION_SERVICE,RsServiceType::PLUGIN_ZERORESERVE,BENCH_SUBTYPE_BINARY_DATA,QOS_PRIORITY_DEFAULT),
+	      data(TLV_TYPE_BIN_SERIALISE) {}
+
+	virtual void clear() { data.TlvClear() ; }
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+	{
+		RsTypeSerializer::serial_process(j,ctx,data,"data") ;
+	}
+
+	RsTlvBinaryData data ;
+};
+
+class BenchBinaryDataSerialiser: public RsServiceSerializer
+{
+public:
+	BenchBinaryDataSerialiser() : RsServiceSerializer(static_cast<uint16_t>(RsServiceType::PLUGIN_ZERORESERVE)) {}
+
+	virtual RsItem *create_item(uint16_t service,uint8_t item_subtype) const
+	{
+		if(service != static_cast<uint16_t>(RsServiceType::PLUGIN_ZERORESERVE) || item_subtype != BENCH_SUBTYPE_BINARY_DATA)
+			return NULL ;
+
+		return new BenchBinaryDataItem() ;
+	}
+};
+
+// The turtle serialiser only creates file items through the registered ftServer, so
+// we use a minimal serialiser for them.
+//
+class BenchTurtleFileSerialiser: public RsServiceSerializer
+{
+public:
+	BenchTurtleFileSerialiser() : RsServiceSerializer(RS_SERVICE_TYPE_TURTLE) {}
+
+	virtual RsItem *create_item(uint16_t service,uint8_t item_subtype) const
+	{
+		if(service != RS_SERVICE_TYPE_TURTLE || item_subtype != RS_TURTLE_SUBTYPE_FILE_DATA)
+			return NULL ;
+
+		return new RsTurtleFileDataItem() ;
+	}
+};
+
+static void fillRandom(void *data,uint32_t size)
+{
+	for(uint32_t i=0;i<size;++i)
+		static_cast<uint8_t*>(data)[i] = rand() ;
+}
+
+static void fillBinary(RsTlvBinaryData& b,uint32_t size)
+{
+	std::vector<uint8_t> tmp(size) ;
+	fillRandom(tmp.data(),size) ;
+	b.setBinData(tmp.data(),size) ;
+}
+
+/************************************ Benchmark *********************************/
+
+struct BenchCase
+{
+	std::string name ;
+	std::unique_ptr<RsGenericSerializer> serialiser ;
+	std::unique_ptr<RsItem> item ;
+};
+
+struct BenchResult
+{
+	double ns_per_item ;
+	double allocations_per_item ;
+};
+
+// Runs op until at least min_time has elapsed, doubling the number of iterations each time.
+//
+static BenchResult measure(const std::function<bool()>& op,std::chrono::milliseconds min_time)
+{
+	typedef std::chrono::steady_clock clock ;
+
+	for(uint64_t n=1;;n *= 2)
+	{
+		uint64_t allocations_before = gAllocationCount ;
+		clock::time_point start = clock::now() ;
+
+		for(uint64_t i=0;i<n;++i)
+			if(!op())
+			{
+				std::cerr << "  (EE) operation failed. Results are not meaningful." << std::endl;
+				return BenchResult{ 0.0, 0.0 } ;
+			}
+
+		clock::duration elapsed = clock::now() - start ;
+		uint64_t allocations = gAllocationCount - allocations_before ;
+
+		if(elapsed >= min_time)
+		{
+			BenchResult r ;
+			r.ns_per_item = std::chrono::duration<double,std::nano>(elapsed).count() / n ;
+			r.allocations_per_item = allocations / (double)n ;
+			return r ;
+		}
+	}
+}
+
+static void printResult(const std::string& name,const std::string& job,uint32_t size,const BenchResult& r)
+{
+	double mb_per_sec = (r.ns_per_item > 0)?(size * 1e9 / r.ns_per_item / (1024.0*1024.0)):0.0 ;
+
+	std::cout << std::left << std::setw(34) << name
+	          << std::setw(13) << job
+	          << std::right << std::setw(10) << size << " B"
+	          << std::setw(14) << std::fixed << std::setprecision(1) << r.ns_per_item << " ns/item"
+	          << std::setw(12) << std::setprecision(1) << mb_per_sec << " MB/s"
+	          << std::setw(10) << std::setprecision(2) << r.allocations_per_item << " allocs/item"
+	          << std::endl;
+}
+
+static void runCase(BenchCase& c,std::chrono::milliseconds min_time)
+{
+	RsGenericSerializer& ser(*c.serialiser) ;
+	RsItem *item = c.item.get() ;
+
+	uint32_t size = ser.size(item) ;
+	std::vector<uint8_t> buffer(size) ;
+
+	{
+		uint32_t s = size ;
+
+		if(!ser.serialise(item,buffer.data(),&s) || s != size)
+		{
+			std::cerr << c.name << ": (EE) cannot serialise item. Skipping." << std::endl;
+			return ;
+		}
+	}
+
+	printResult(c.name,"size",size,measure([&]() { return ser.size(item) == size ; },min_time)) ;
+
+	printResult(c.name,"serialise",size,measure([&]()
+	{
+		uint32_t s = size ;
+		return ser.serialise(item,buffer.data(),&s) ;
+	},min_time)) ;
+
+	printResult(c.name,"deserialise",size,measure([&]()
+	{
+		uint32_t s = size ;
+		RsItem *res = ser.deserialise(buffer.data(),&s) ;
+		delete res ;
+		return res != NULL ;
+	},min_time)) ;
+}
+
+int main(int argc,char *argv[])
+{
+	std::chrono::milliseconds min_time(200) ;
+	std::string filter ;
+
+	if(argc > 1) min_time = std::chrono::milliseconds(atoi(argv[1])) ;
+	if(argc > 2) filter = argv[2] ;
+
+	srand(0) ;
+	std::vector<BenchCase> cases ;
+
+	// GXS message as exchanged by RsGxsNetService, with typical meta and body sizes
+
+	for(uint32_t msg_size : { 1024u, 64u*1024u })
+	{
+		RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_GXS_TYPE_CHANNELS) ;
+		msg->grpId = RsGxsGroupId::random() ;
+		msg->msgId = RsGxsMessageId::random() ;
+		fillBinary(msg->meta,400) ;
+		fillBinary(msg->msg,msg_size) ;
+
+		BenchCase c ;
+		c.name = "RsNxsMsg (" + std::to_string(msg_size/1024) + "KB)" ;
+		c.serialiser.reset(new RsNxsSerialiser(RS_SERVICE_GXS_TYPE_CHANNELS)) ;
+		c.item.reset(msg) ;
+		cases.push_back(std::move(c)) ;
+	}
+
+	// Turtle file data, as sent through tunnels
+
+	{
+		RsTurtleFileDataItem *item = new RsTurtleFileDataItem ;
+		item->tunnel_id = 0x4ff823e2 ;
+		item->chunk_offset = 1234567 ;
+		item->chunk_size = 16*1024 ;
+		item->chunk_data = rs_malloc(item->chunk_size) ;
+		fillRandom(item->chunk_data,item->chunk_size) ;
+
+		BenchCase c ;
+		c.name = "RsTurtleFileDataItem (16KB)" ;
+		c.serialiser.reset(new BenchTurtleFileSerialiser) ;
+		c.item.reset(item) ;
+		cases.push_back(std::move(c)) ;
+	}
+
+	// Chat message
+
+	{
+		RsChatMsgItem *item = new RsChatMsgItem ;
+		item->chatFlags = 0x42 ;
+		item->sendTime = 1500000000 ;
+		item->message = std::string(200,'x') ;
+
+		BenchCase c ;
+		c.name = "RsChatMsgItem (200 chars)" ;
+		c.serialiser.reset(new RsChatSerialiser) ;
+		c.item.reset(item) ;
+		cases.push_back(std::move(c)) ;
+	}
+
+	// File list sync response, carrying an encoded directory
+
+	{
+		RsFileListsSyncResponseItem *item = new RsFileListsSyncResponseItem ;
+		item->entry_hash = RsFileHash::random() ;
+		item->checksum = RsFileHash::random() ;
+		item->flags = RsFileListsItem::FLAGS_SYNC_RESPONSE | RsFileListsItem::FLAGS_SYNC_DIR_CONTENT ;
+		item->request_id = 0x1234 ;
+		fillBinary(item->directory_content_data,8*1024) ;
+
+		BenchCase c ;
+		c.name = "RsFileListsSyncResponseItem (8KB)" ;
+		c.serialiser.reset(new RsFileListsSerialiser) ;
+		c.item.reset(item) ;
+		cases.push_back(std::move(c)) ;
+	}
+
+	// Large binary TLV alone
+
+	{
+		BenchBinaryDataItem *item = new BenchBinaryDataItem ;
+		fillBinary(item->data,1024*1024) ;
+
+		BenchCase c ;
+		c.name = "RsTlvBinaryData (1MB)" ;
+		c.serialiser.reset(new BenchBinaryDataSerialiser) ;
+		c.item.reset(item) ;
+		cases.push_back(std::move(c)) ;
+	}
+
+	for(uint32_t i=0;i<cases.size();++i)
+		if(filter.empty() || cases[i].name.find(filter) != std::string::npos)
+			runCase(cases[i],min_time) ;
+
+	return 0 ;
+}
@@ -0,0 +1,259 @@
+/*******************************************************************************
+ * benchmarks/libretroshare/tcponudp: tou_benchmark.cc                         *
+ *                                                                             *
+ * RetroShare benchmarks                                                       *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Lesser General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ *******************************************************************************/
+
+// Measures the goodput of TcpStream (TCP over UDP) across an emulated link
+// with configurable loss, delay and rate. Two streams, each behind its own
+// UdpPeerReceiver, talk through the link in the same process, once with
+// selective acknowledgments disabled and once with them negotiated.
+//
+// usage: tou_benchmark [loss_percent] [one_way_delay_ms] [rate_KBps] [size_KB]
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+
+// from libretroshare
+
+#include "tcponudp/udppeer.h"
+#include "tcponudp/tcpstream.h"
+#include "util/rstime.h"
+
+/******************************** Emulated link *********************************/
+
+// One direction of the link: drops packets at random, then serialises the
+// remaining ones at the given rate through a drop-tail queue, and delivers
+// them after the propagation delay.
+
+class LossyLink: public UdpPublisher
+{
+public:
+	LossyLink(double loss,double delay,double rate,const sockaddr_in& from)
+	    : mLoss(loss), mDelay(delay), mRate(rate), mFrom(from),
+	      mLinkFree(0), mQueuedBytes(0), mReceiver(nullptr),
+	      mSent(0), mDropped(0) {}
+
+	void setReceiver(UdpReceiver *r) { mReceiver = r ; }
+
+	virtual int sendPkt(const void *data,int size,const sockaddr_in& /*to*/,int /*ttl*/)
+	{
+		++mSent ;
+
+		if(rand() < mLoss * RAND_MAX || mQueuedBytes + size > MAX_QUEUED_BYTES)
+		{
+			++mDropped ;
+			return size ;
+		}
+
+		double now = rstime::RsScopeTimer::currentTime() ;
+		double departure = std::max(now,mLinkFree) + size / mRate ;
+		mLinkFree = departure ;
+
+		Packet p ;
+		p.arrival = departure + mDelay ;
+		p.data.assign((const uint8_t*)data,(const uint8_t*)data + size) ;
+
+		mQueuedBytes += size ;
+		mInFlight.push_back(p) ;
+
+		return size ;
+	}
+
+	// hands the packets that have arrived by now to the other side
+	void deliver(double now)
+	{
+		while(!mInFlight.empty() && mInFlight.front().arrival <= now)
+		{
+			Packet p = mInFlight.front() ;
+			mInFlight.pop_front() ;
+			mQueuedBytes -= p.data.size() ;
+
+			sockaddr_in from = mFrom ;
+			mReceiver->recvPkt(p.data.data(),p.data.size(),from) ;
+		}
+	}
+
+	uint32_t sent() const { return mSent ; }
+	uint32_t dropped() const { return mDropped ; }
+
+private:
+	static const uint32_t MAX_QUEUED_BYTES = 256*1024 ;
+
+	struct Packet
+	{
+		double arrival ;
+		std::vector<uint8_t> data ;
+	};
+
+	double mLoss ;
+	double mDelay ;
+	double mRate ;
+	sockaddr_in mFrom ;
+
+	double mLinkFree ;
+	uint32_t mQueuedBytes ;
+	std::deque<Packet> mInFlight ;
+	UdpReceiver *mReceiver ;
+
+	uint32_t mSent ;
+	uint32_t mDropped ;
+};
+
+static sockaddr_in localAddress(uint16_t port)
+{
+	sockaddr_in addr ;
+	memset(&addr,0,sizeof(addr)) ;
+	addr.sin_family = AF_INET ;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK) ;
+	addr.sin_port = htons(port) ;
+
+	return addr ;
+}
+
+/******************************** Measure ****************************************/
+
+static const double MAX_TRANSFER_TIME = 300 ; // seconds
+
+// content of the stream at a given offset, so that the receiver can check it
+static char streamByte(uint32_t offset) { return (char)(offset * 31 + (offset >> 12)) ; }
+
+static void runTransfer(bool sack,double loss,double delay,double rate,uint32_t size)
+{
+	srand(1234) ;	// same losses for both runs
+
+	sockaddr_in addrA = localAddress(7001) ;
+	sockaddr_in addrB = localAddress(7002) ;
+
+	LossyLink linkAB(loss,delay,rate,addrA) ;
+	LossyLink linkBA(loss,delay,rate,addrB) ;
+
+	UdpPeerReceiver recvA(&linkAB) ;
+	UdpPeerReceiver recvB(&linkBA) ;
+
+	linkAB.setReceiver(&recvB) ;
+	linkBA.setReceiver(&recvA) ;
+
+	TcpStream sender(&recvA) ;
+	TcpStream receiver(&recvB) ;
+
+	sender.setSackPermitted(sack) ;
+	receiver.setSackPermitted(sack) ;
+
+	recvA.addUdpPeer(&sender,addrB) ;
+	recvB.addUdpPeer(&receiver,addrA) ;
+
+	receiver.listenfor(addrA) ;
+	sender.connect(addrB,10) ;
+
+	std::vector<char> buffer(64*1024) ;
+
+	uint32_t written = 0 ;
+	uint32_t received = 0 ;
+	bool corrupted = false ;
+	double start = 0 ;
+	double now = rstime::RsScopeTimer::currentTime() ;
+	double timeout = now + MAX_TRANSFER_TIME ;
+
+	while(received < size && now < timeout)
+	{
+		linkAB.deliver(now) ;
+		linkBA.deliver(now) ;
+
+		sender.tick() ;
+		receiver.tick() ;
+
+		if(sender.isConnected())
+		{
+			if(start == 0)
+				start = now ;
+
+			int allowed = std::min(sender.write_allowed(),(int)std::min<uint32_t>(size - written,buffer.size())) ;
+
+			for(int i=0;i<allowed;++i)
+				buffer[i] = streamByte(written + i) ;
+
+			if(allowed > 0)
+				written += std::max(0,sender.write(buffer.data(),allowed)) ;
+		}
+
+		int pending = std::min(receiver.read_pending(),(int)buffer.size()) ;
+		int n = pending > 0 ? receiver.read(buffer.data(),pending) : 0 ;
+
+		for(int i=0;i<n;++i)
+			if(buffer[i] != streamByte(received + i))
+				corrupted = true ;
+
+		if(n > 0)
+			received += n ;
+
+		rstime::rs_usleep(500) ;
+		now = rstime::RsScopeTimer::currentTime() ;
+	}
+
+	double elapsed = now - start ;
+
+	std::cout << std::setw(8) << (sack ? "SACK" : "no SACK")
+	          << std::setw(12) << std::fixed << std::setprecision(2) << elapsed << " s"
+	          << std::setw(12) << std::setprecision(1) << received / elapsed / 1024.0 << " KB/s"
+	          << std::setw(10) << linkAB.sent() << " pkts"
+	          << std::setw(8) << linkAB.dropped() << " lost" ;
+
+	if(received < size)
+		std::cout << "  (timed out after " << received / 1024 << " KB)" ;
+
+	if(corrupted)
+		std::cout << "  CORRUPTED DATA" ;
+
+	std::cout << std::endl ;
+
+	sender.close() ;
+	receiver.close() ;
+
+	recvA.removeUdpPeer(&sender) ;
+	recvB.removeUdpPeer(&receiver) ;
+}
+
+int main(int argc,char *argv[])
+{
+	double loss = 1.0 ;		// %
+	double delay = 50 ;		// ms, one way
+	double rate = 1024 ;	// KB/s
+	uint32_t size = 4096 ;	// KB
+
+	if(argc > 1) loss = atof(argv[1]) ;
+	if(argc > 2) delay = atof(argv[2]) ;
+	if(argc > 3) rate = atof(argv[3]) ;
+	if(argc > 4) size = atoi(argv[4]) ;
+
+	std::cout << "Transferring " << size << " KB over a " << rate << " KB/s link, "
+	          << delay << " ms one way delay, " << loss << " % loss" << std::endl ;
+
+	runTransfer(false,loss/100.0,delay/1000.0,rate*1024.0,size*1024) ;
+	runTransfer(true,loss/100.0,delay/1000.0,rate*1024.0,size*1024) ;
+
+	return 0 ;
+}
@@ -0,0 +1,25 @@
+################################################################################
+# serialiser_benchmark.pro                                                     #
+# Copyright (C) 2026, Retroshare team <retroshare.team@gmailcom>               #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+# usage: serialiser_benchmark [min_time_per_measure_in_ms] [item name filter]
+
+!include("benchmarks.pri"): error("Could not include file benchmarks.pri")
+
+TARGET = serialiser_benchmark
+
+SOURCES += libretroshare/serialiser/serialiser_benchmark.cc
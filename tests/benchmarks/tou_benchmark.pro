@@ -0,0 +1,33 @@
+################################################################################
+# tou_benchmark.pro                                                            #
+# Copyright (C) 2026, Retroshare team <retroshare.team@gmailcom>               #
+#                                                                              #
+# This program is free software: you can redistribute it and/or modify         #
+# it under the terms of the GNU Affero General Public License as               #
+# published by the Free Software Foundation, either version 3 of the           #
+# License, or (at your option) any later version.                              #
+#                                                                              #
+# This program is distributed in the hope that it will be useful,              #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of               #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                #
+# GNU Lesser General Public License for more details.                          #
+#                                                                              #
+# You should have received a copy of the GNU Lesser General Public License     #
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.       #
+################################################################################
+
+# Goodput of TCP over UDP through an emulated lossy link.
+#
+# usage: tou_benchmark [loss_percent] [one_way_delay_ms] [rate_KBps] [size_KB]
+
+# tcponudp is built on the udp stack of libbitdht
+CONFIG *= bitdht
+
+!include("benchmarks.pri"): error("Could not include file benchmarks.pri")
+
+TARGET = tou_benchmark
+
+DEFINES *= RS_USE_BITDHT
+INCLUDEPATH += ../../libbitdht/src
+
+SOURCES += libretroshare/tcponudp/tou_benchmark.cc
@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/dir_sync_delta_test.cc                 *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <set>
+
+#include "file_sharing/directory_storage.h"
+#include "file_sharing/filelist_io.h"
+
+static const char LOCAL_FILE_NAME[]  = "dir_sync_delta_local.tmp";
+static const char REMOTE_FILE_NAME[] = "dir_sync_delta_remote.tmp";
+
+typedef std::set<std::pair<std::string,RsFileHash> > DirFiles;
+
+// Shares a single directory "share" below the root, with the given files, all of them hashed.
+
+static DirectoryStorage::EntryIndex setLocalFiles(LocalDirectoryStorage& local,const std::set<std::string>& names)
+{
+	std::set<std::string> subdirs;
+	subdirs.insert("share");
+	local.updateSubDirectoryList(local.root(),subdirs,RsFileHash::random());
+
+	DirectoryStorage::EntryIndex dir = DirectoryStorage::NO_INDEX;
+	local.getChildIndex(local.root(),0,dir);
+
+	std::map<std::string,DirectoryStorage::FileTS> subfiles,new_files;
+
+	for(std::set<std::string>::const_iterator it(names.begin());it!=names.end();++it)
+	{
+		DirectoryStorage::FileTS& ts(subfiles[*it]);
+		ts.size = 1000 + it->size();
+		ts.modtime = 1234;
+	}
+	local.updateSubFilesList(dir,subfiles,new_files);
+
+	for(DirectoryStorage::FileIterator it(&local,dir);it;++it)
+		if(it.hash().isNull())
+			local.updateHash(*it,RsFileHash::random(),true);
+
+	return dir;
+}
+
+static DirFiles dirFiles(DirectoryStorage& storage,DirectoryStorage::EntryIndex dir)
+{
+	DirFiles res;
+
+	for(DirectoryStorage::FileIterator it(&storage,dir);it;++it)
+		res.insert(std::make_pair(it.name(),it.hash()));
+
+	return res;
+}
+
+// The root of a friend list is only sent to peers allowed to browse it, so it is written by hand here: it only holds
+// the shared directory, which the remote side creates empty.
+
+static DirectoryStorage::EntryIndex setRemoteRoot(RemoteDirectoryStorage& remote,const RsFileHash& dir_hash)
+{
+	uint32_t size = 1024;
+	uint32_t offset = 0;
+	unsigned char *data = (unsigned char*)malloc(size);
+
+	EXPECT_TRUE( FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_DIR_NAME       ,std::string())
+	          && FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)1234)
+	          && FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)1234)
+	          && FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,(uint32_t)1)
+	          && FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,(uint32_t)0)
+	          && FileListIO::writeField(data,size,offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,dir_hash));
+
+	RsTlvBinaryData bindata;
+	bindata.bin_data = data;
+	bindata.bin_len = offset;
+
+	EXPECT_TRUE(remote.deserialiseUpdateDirEntry(remote.root(),bindata));
+
+	DirectoryStorage::EntryIndex dir = DirectoryStorage::NO_INDEX;
+	EXPECT_TRUE(remote.getIndexFromDirHash(dir_hash,dir));
+
+	return dir;
+}
+
+static bool syncDelta(LocalDirectoryStorage& local,DirectoryStorage::EntryIndex local_dir,
+                      RemoteDirectoryStorage& remote,DirectoryStorage::EntryIndex remote_dir,
+                      const RsTlvBinaryData& known)
+{
+	RsTlvBinaryData delta;
+
+	if(!local.serialiseDirEntryDelta(local_dir,known,delta,remote.peerId()))
+		return false;
+
+	return remote.deserialiseUpdateDirEntryDelta(remote_dir,delta);
+}
+
+TEST(libretroshare_file_sharing, DirSyncDeltaRoundTrip)
+{
+	{
+		LocalDirectoryStorage local(LOCAL_FILE_NAME,RsPeerId::random());
+		RemoteDirectoryStorage remote(RsPeerId::random(),REMOTE_FILE_NAME);
+
+		std::set<std::string> names;
+		names.insert("a.txt");
+		names.insert("b.txt");
+		names.insert("c.txt");
+
+		DirectoryStorage::EntryIndex local_dir = setLocalFiles(local,names);
+		RsFileHash dir_hash;
+		ASSERT_TRUE(local.getDirHashFromIndex(local_dir,dir_hash));
+		DirectoryStorage::EntryIndex remote_dir = setRemoteRoot(remote,dir_hash);
+
+		// Nothing known yet: the delta holds every file.
+
+		RsTlvBinaryData known;
+		ASSERT_TRUE(remote.getKnownEntries(remote_dir,known));
+		EXPECT_EQ(0u,known.bin_len);
+
+		ASSERT_TRUE(syncDelta(local,local_dir,remote,remote_dir,known));
+		EXPECT_EQ(3u,dirFiles(remote,remote_dir).size());
+		EXPECT_EQ(dirFiles(local,local_dir),dirFiles(remote,remote_dir));
+
+		// One file removed, one added, one re-hashed: the delta applies on top of what the remote side has.
+
+		names.erase("b.txt");
+		names.insert("d.txt");
+		local_dir = setLocalFiles(local,names);
+
+		for(DirectoryStorage::FileIterator it(&local,local_dir);it;++it)
+			if(it.name() == "c.txt")
+				local.updateHash(*it,RsFileHash::random(),true);
+
+		ASSERT_TRUE(remote.getKnownEntries(remote_dir,known));
+		EXPECT_EQ(3u*8,known.bin_len);
+
+		ASSERT_TRUE(syncDelta(local,local_dir,remote,remote_dir,known));
+		EXPECT_EQ(3u,dirFiles(remote,remote_dir).size());
+		EXPECT_EQ(dirFiles(local,local_dir),dirFiles(remote,remote_dir));
+
+		// Same content on both sides: applying an empty delta changes nothing.
+
+		ASSERT_TRUE(remote.getKnownEntries(remote_dir,known));
+		ASSERT_TRUE(syncDelta(local,local_dir,remote,remote_dir,known));
+		EXPECT_EQ(dirFiles(local,local_dir),dirFiles(remote,remote_dir));
+	}
+	remove(LOCAL_FILE_NAME);
+	remove(REMOTE_FILE_NAME);
+}
+
+TEST(libretroshare_file_sharing, DirSyncDeltaBaseMismatchNeedsFullList)
+{
+	{
+		LocalDirectoryStorage local(LOCAL_FILE_NAME,RsPeerId::random());
+		RemoteDirectoryStorage remote(RsPeerId::random(),REMOTE_FILE_NAME);
+
+		std::set<std::string> names;
+		names.insert("a.txt");
+		names.insert("b.txt");
+		names.insert("c.txt");
+
+		DirectoryStorage::EntryIndex local_dir = setLocalFiles(local,names);
+		RsFileHash dir_hash;
+		ASSERT_TRUE(local.getDirHashFromIndex(local_dir,dir_hash));
+		DirectoryStorage::EntryIndex remote_dir = setRemoteRoot(remote,dir_hash);
+
+		RsTlvBinaryData known;
+		ASSERT_TRUE(remote.getKnownEntries(remote_dir,known));
+		ASSERT_TRUE(syncDelta(local,local_dir,remote,remote_dir,known));
+		ASSERT_TRUE(remote.getKnownEntries(remote_dir,known));
+
+		// The remote copy changes after the request was sent (e.g. a full list answered in between), so the files
+		// the delta relies on are not there anymore.
+
+		names.erase("a.txt");
+		names.insert("d.txt");
+		local_dir = setLocalFiles(local,names);
+
+		RsTlvBinaryData delta;
+		ASSERT_TRUE(local.serialiseDirEntryDelta(local_dir,known,delta,remote.peerId()));
+
+		names.clear();
+		names.insert("e.txt");
+		LocalDirectoryStorage other(std::string(LOCAL_FILE_NAME) + ".other",RsPeerId::random());
+		DirectoryStorage::EntryIndex other_dir = setLocalFiles(other,names);
+
+		RsTlvBinaryData other_full;
+		ASSERT_TRUE(other.serialiseDirEntry(other_dir,other_full,remote.peerId()));
+		ASSERT_TRUE(remote.deserialiseUpdateDirEntry(remote_dir,other_full));
+
+		DirFiles before = dirFiles(remote,remote_dir);
+
+		EXPECT_FALSE(remote.deserialiseUpdateDirEntryDelta(remote_dir,delta));
+		EXPECT_EQ(before,dirFiles(remote,remote_dir));
+
+		// This is where p3FileDatabase asks for the full list, which always applies.
+
+		RsTlvBinaryData full;
+		ASSERT_TRUE(local.serialiseDirEntry(local_dir,full,remote.peerId()));
+		ASSERT_TRUE(remote.deserialiseUpdateDirEntry(remote_dir,full));
+		EXPECT_EQ(dirFiles(local,local_dir),dirFiles(remote,remote_dir));
+	}
+	remove(LOCAL_FILE_NAME);
+	remove((std::string(LOCAL_FILE_NAME) + ".other").c_str());
+	remove(REMOTE_FILE_NAME);
+}
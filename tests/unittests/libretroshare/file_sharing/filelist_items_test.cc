@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/filelist_items_test.cc                 *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "file_sharing/rsfilelistitems.h"
+#include "serialiser/rsbaseserial.h"
+
+// Layout of a sync request as sent by peers that do not know about known_entries.
+
+static std::vector<uint8_t> oldSyncRequest(const RsFileHash& hash,uint32_t flags,uint32_t ts,uint64_t request_id)
+{
+	RsFileListsSyncRequestItem item;
+	std::vector<uint8_t> data(8 + RsFileHash::SIZE_IN_BYTES + 4 + 4 + 8);
+	uint32_t offset = 8;
+
+	setRsItemHeader(data.data(),data.size(),item.PacketId(),data.size());
+	memcpy(data.data() + offset,hash.toByteArray(),RsFileHash::SIZE_IN_BYTES);
+	offset += RsFileHash::SIZE_IN_BYTES;
+
+	setRawUInt32(data.data(),data.size(),&offset,flags);
+	setRawUInt32(data.data(),data.size(),&offset,ts);
+	setRawUInt64(data.data(),data.size(),&offset,request_id);
+
+	return data;
+}
+
+TEST(libretroshare_file_sharing, SyncRequestOldLayoutDeserialises)
+{
+	RsFileHash hash = RsFileHash::random();
+	std::vector<uint8_t> data = oldSyncRequest(hash,RsFileListsItem::FLAGS_SYNC_REQUEST,1234,0x0102030405060708ull);
+	uint32_t size = data.size();
+
+	RsFileListsSerialiser serialiser;
+	RsItem *item = serialiser.deserialise(data.data(),&size);
+	RsFileListsSyncRequestItem *ritem = dynamic_cast<RsFileListsSyncRequestItem*>(item);
+
+	ASSERT_TRUE(ritem != NULL);
+	EXPECT_EQ(data.size(),size);
+	EXPECT_EQ(hash,ritem->entry_hash);
+	EXPECT_EQ(+RsFileListsItem::FLAGS_SYNC_REQUEST,ritem->flags);
+	EXPECT_EQ(1234u,ritem->last_known_recurs_modf_TS);
+	EXPECT_EQ(0x0102030405060708ull,ritem->request_id);
+	EXPECT_EQ(0u,ritem->known_entries.bin_len);
+
+	delete item;
+}
+
+TEST(libretroshare_file_sharing, SyncRequestWithoutKnownEntriesKeepsOldLayout)
+{
+	RsFileListsSyncRequestItem item;
+	item.entry_hash = RsFileHash::random();
+	item.flags = RsFileListsItem::FLAGS_SYNC_REQUEST | RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED;
+	item.last_known_recurs_modf_TS = 42;
+	item.request_id = 77;
+
+	std::vector<uint8_t> expected = oldSyncRequest(item.entry_hash,item.flags,42,77);
+
+	RsFileListsSerialiser serialiser;
+	uint32_t size = serialiser.size(&item);
+	ASSERT_EQ(expected.size(),size);
+
+	std::vector<uint8_t> data(size);
+	ASSERT_TRUE(serialiser.serialise(&item,data.data(),&size));
+	EXPECT_EQ(expected,data);
+}
+
+TEST(libretroshare_file_sharing, SyncRequestKnownEntriesRoundTrip)
+{
+	const uint8_t fingerprints[16] = { 1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16 };
+
+	RsFileListsSyncRequestItem item;
+	item.entry_hash = RsFileHash::random();
+	item.flags = RsFileListsItem::FLAGS_SYNC_REQUEST | RsFileListsItem::FLAGS_SYNC_DELTA_SUPPORTED;
+	item.request_id = 5;
+	item.known_entries.setBinData(fingerprints,sizeof(fingerprints));
+
+	RsFileListsSerialiser serialiser;
+	uint32_t size = serialiser.size(&item);
+	EXPECT_GT(size,oldSyncRequest(item.entry_hash,item.flags,0,5).size());
+
+	std::vector<uint8_t> data(size);
+	ASSERT_TRUE(serialiser.serialise(&item,data.data(),&size));
+
+	RsItem *ditem = serialiser.deserialise(data.data(),&size);
+	RsFileListsSyncRequestItem *ritem = dynamic_cast<RsFileListsSyncRequestItem*>(ditem);
+
+	ASSERT_TRUE(ritem != NULL);
+	EXPECT_EQ(item.entry_hash,ritem->entry_hash);
+	EXPECT_EQ(item.flags,ritem->flags);
+	EXPECT_EQ(5u,ritem->request_id);
+	ASSERT_EQ(sizeof(fingerprints),ritem->known_entries.bin_len);
+	EXPECT_EQ(0,memcmp(fingerprints,ritem->known_entries.bin_data,sizeof(fingerprints)));
+
+	delete ditem;
+}
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/filename_index_test.cc                 *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "file_sharing/filename_index.h"
+#include "file_sharing/dir_hierarchy.h"
+
+static DirectoryStorage::EntryIndex findFile(const InternalFileHierarchyStorage& s,const std::string& name)
+{
+	const InternalFileHierarchyStorage::DirEntry *root = s.getDirEntry(0);
+
+	for(uint32_t i=0;i<root->subfiles.size();++i)
+		if(s.getFileEntry(root->subfiles[i])->file_name == name)
+			return root->subfiles[i];
+
+	return 0;
+}
+
+static std::list<DirectoryStorage::EntryIndex> searchTerm(const InternalFileHierarchyStorage& s,const std::string& term)
+{
+	std::list<DirectoryStorage::EntryIndex> results;
+	s.searchTerms(std::list<std::string>(1,term),results);
+	return results;
+}
+
+TEST(libretroshare_file_sharing, FileNameIndexCandidates)
+{
+	FileNameIndex index;
+
+	index.insert(1,"holiday_photo.jpg");
+	index.insert(4,"Report2026.pdf");
+	index.insert(2,"photo_album.png");
+
+	std::vector<uint32_t> c;
+
+	EXPECT_TRUE(index.candidates("photo",c));
+	EXPECT_EQ(std::vector<uint32_t>({1,2}),c);
+
+	EXPECT_TRUE(index.candidates("REPORT",c));
+	EXPECT_EQ(std::vector<uint32_t>({4}),c);
+
+	EXPECT_TRUE(index.candidates("nothing",c));
+	EXPECT_TRUE(c.empty());
+
+	// Terms shorter than a trigram cannot be looked up
+
+	EXPECT_FALSE(index.candidates("ph",c));
+	EXPECT_FALSE(index.candidates("",c));
+}
+
+TEST(libretroshare_file_sharing, FileNameIndexFollowsHierarchy)
+{
+	InternalFileHierarchyStorage s;
+
+	std::map<std::string,DirectoryStorage::FileTS> files,new_files;
+
+	files["holiday_photo.jpg"] = { 1000, 10 };
+	files["Report2026.pdf"]    = { 2000, 10 };
+	files["ab.txt"]            = { 3000, 10 };
+
+	ASSERT_TRUE(s.updateSubFilesList(0,files,new_files));
+
+	for(auto& it: files)
+		ASSERT_TRUE(s.updateHash(findFile(s,it.first),RsFileHash::random()));
+
+	DirectoryStorage::EntryIndex photo = findFile(s,"holiday_photo.jpg");
+	DirectoryStorage::EntryIndex report = findFile(s,"Report2026.pdf");
+	DirectoryStorage::EntryIndex ab = findFile(s,"ab.txt");
+
+	// Insert. The index is built by the first search.
+
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,photo),searchTerm(s,"photo"));
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,report),searchTerm(s,"report"));
+
+	files["new_photo.png"] = { 4000, 10 };
+	ASSERT_TRUE(s.updateSubFilesList(0,files,new_files));
+	DirectoryStorage::EntryIndex new_photo = findFile(s,"new_photo.png");
+	ASSERT_TRUE(s.updateHash(new_photo,RsFileHash::random()));
+
+	std::list<DirectoryStorage::EntryIndex> r = searchTerm(s,"photo");
+	r.sort();
+	std::list<DirectoryStorage::EntryIndex> expected({photo,new_photo});
+	expected.sort();
+	EXPECT_EQ(expected,r);
+
+	// Rename
+
+	RsFileHash h;
+	ASSERT_TRUE(s.getFileEntry(photo) != NULL);
+	h = s.getFileEntry(photo)->file_hash;
+	ASSERT_TRUE(s.updateFile(photo,h,"vacation.jpg",1000,10));
+
+	files.erase("holiday_photo.jpg");
+	files["vacation.jpg"] = { 1000, 10 };
+
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,new_photo),searchTerm(s,"photo"));
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,photo),searchTerm(s,"VACATION"));
+
+	// Remove
+
+	files.erase("Report2026.pdf");
+	ASSERT_TRUE(s.updateSubFilesList(0,files,new_files));
+
+	EXPECT_TRUE(searchTerm(s,"report").empty());
+
+	// Terms under 3 chars fall back to the linear search
+
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,ab),searchTerm(s,"ab"));
+	EXPECT_EQ(std::list<DirectoryStorage::EntryIndex>(1,photo),searchTerm(s,"va"));
+}
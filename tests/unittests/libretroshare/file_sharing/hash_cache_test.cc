@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/hash_cache_test.cc                     *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <openssl/sha.h>
+#include <unistd.h>
+
+#include "file_sharing/hash_cache.h"
+#include "util/rsdir.h"
+
+class TestHashClient: public HashStorageClient
+{
+public:
+	void hash_callback(uint32_t client_param, const std::string& name, const RsFileHash& hash, uint64_t size) override
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		mResults.push_back(Result{client_param,name,hash,size});
+		mCv.notify_all();
+	}
+
+	bool hash_confirm(uint32_t) override { return true; }
+
+	bool waitForResults(size_t n)
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		return mCv.wait_for(lock,std::chrono::seconds(30),[this,n]() { return mResults.size() >= n; });
+	}
+
+	struct Result
+	{
+		uint32_t param;
+		std::string name;
+		RsFileHash hash;
+		uint64_t size;
+	};
+
+	std::mutex mMtx;
+	std::condition_variable mCv;
+	std::vector<Result> mResults;
+};
+
+static const uint32_t FILE_COUNT = 12;
+
+/* Files of different sizes, so that workers finish them in a different order
+ * than they pick them. Names are zero-padded so that path order is index order.
+ */
+class HashStorageTest: public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		char tmpl[] = "/tmp/rs_hash_cache_test_XXXXXX";
+		ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+		mDir = tmpl;
+
+		for(uint32_t i=0;i<FILE_COUNT;++i)
+		{
+			char name[32];
+			sprintf(name,"/file_%02u",i);
+
+			std::string data((FILE_COUNT-i)*256*1024 + i,char('a'+i));
+
+			FILE *f = fopen((mDir+name).c_str(),"wb");
+			ASSERT_TRUE(f != NULL);
+			ASSERT_EQ(data.size(),fwrite(data.data(),1,data.size(),f));
+			fclose(f);
+
+			unsigned char sha1[SHA_DIGEST_LENGTH];
+			SHA1(reinterpret_cast<const unsigned char*>(data.data()),data.size(),sha1);
+
+			mFiles.push_back(mDir+name);
+			mHashes.push_back(RsFileHash::fromBufferUnsafe(sha1));
+			mSizes.push_back(data.size());
+		}
+	}
+
+	void TearDown() override
+	{
+		for(const std::string& f: mFiles)
+			remove(f.c_str());
+
+		remove((mDir+"/hash_cache.bin").c_str());
+		remove((mDir+"/hash_cache.bin.tmp").c_str());
+		rmdir(mDir.c_str());
+	}
+
+	/// Requests all files, last one first, so that the order of the requests is not the order of the paths.
+	void requestAll(HashStorage& storage,TestHashClient& client)
+	{
+		for(uint32_t i=FILE_COUNT;i>0;--i)
+		{
+			RsFileHash hash;
+			EXPECT_FALSE(storage.requestHash(mFiles[i-1],mSizes[i-1],1000+i-1,hash,&client,i-1));
+		}
+	}
+
+	void checkResults(const TestHashClient& client)
+	{
+		ASSERT_EQ(FILE_COUNT,client.mResults.size());
+
+		std::vector<bool> seen(FILE_COUNT,false);
+
+		for(const TestHashClient::Result& r: client.mResults)
+		{
+			ASSERT_LT(r.param,FILE_COUNT);
+			EXPECT_FALSE(seen[r.param]);
+			seen[r.param] = true;
+
+			EXPECT_EQ(mFiles[r.param],r.name);
+			EXPECT_EQ(mHashes[r.param],r.hash);
+			EXPECT_EQ(mSizes[r.param],r.size);
+		}
+	}
+
+	std::string mDir;
+	std::vector<std::string> mFiles;
+	std::vector<RsFileHash> mHashes;
+	std::vector<uint64_t> mSizes;
+};
+
+TEST_F(HashStorageTest, HashesBatchWithSeveralWorkers)
+{
+	TestHashClient client;
+	HashStorage storage(mDir+"/hash_cache.bin");
+
+	storage.setHashingThreadsCount(4);
+	requestAll(storage,client);
+
+	ASSERT_TRUE(client.waitForResults(FILE_COUNT));
+	checkResults(client);
+
+	// the results are kept, so that files are not hashed again
+
+	for(uint32_t i=0;i<FILE_COUNT;++i)
+	{
+		RsFileHash hash;
+		EXPECT_TRUE(storage.requestHash(mFiles[i],mSizes[i],1000+i,hash,&client,i));
+		EXPECT_EQ(mHashes[i],hash);
+	}
+
+	storage.fullstop();
+}
+
+TEST_F(HashStorageTest, HashesFilesOfADeviceInPathOrder)
+{
+	TestHashClient client;
+	HashStorage storage(mDir+"/hash_cache.bin");
+
+	// a single thread takes the files in path order, whatever the device. The
+	// pool is paused while queuing, otherwise it starts with the first request.
+
+	storage.setHashingThreadsCount(1);
+	storage.togglePauseHashingProcess();
+	requestAll(storage,client);
+	storage.togglePauseHashingProcess();
+
+	ASSERT_TRUE(client.waitForResults(FILE_COUNT));
+	checkResults(client);
+
+	for(uint32_t i=0;i<FILE_COUNT;++i)
+		EXPECT_EQ(i,client.mResults[i].param);
+
+	storage.fullstop();
+}
+
+TEST_F(HashStorageTest, ShrinkingThePoolKeepsQueuedFiles)
+{
+	TestHashClient client;
+	HashStorage storage(mDir+"/hash_cache.bin");
+
+	storage.setHashingThreadsCount(4);
+	requestAll(storage,client);
+
+	// surplus workers are stopped, and give back the file they were hashing
+
+	for(uint32_t i=0;i<8;++i)
+	{
+		usleep(2000);
+		storage.setHashingThreadsCount(1 + i%4);
+	}
+	storage.setHashingThreadsCount(1);
+	EXPECT_EQ(1u,storage.hashingThreadsCount());
+
+	ASSERT_TRUE(client.waitForResults(FILE_COUNT));
+	checkResults(client);
+
+	storage.setHashingThreadsCount(3);
+	storage.fullstop();
+}
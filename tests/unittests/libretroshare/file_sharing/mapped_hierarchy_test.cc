@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * unittests/libretroshare/file_sharing/mapped_hierarchy_test.cc               *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "file_sharing/mapped_hierarchy.h"
+
+// Builds root(0) -> dir(1) -> file(2), with an empty slot at index 3. Hooks can break the result afterwards.
+
+static void buildHierarchy(std::vector<unsigned char>& data,uint32_t dir_parent = 0,uint32_t root_child = 1)
+{
+	MappedFileHierarchy::Builder builder(4);
+
+	uint32_t root_subdirs[] = { root_child };
+	uint32_t dir_subfiles[] = { 2 };
+
+	builder.addDirNode(0,0,"",0,"",0,10,0,0,0,RsFileHash(),root_subdirs,1,NULL,0);
+	builder.addDirNode(dir_parent,0,"music",5,"",0,10,0,0,0,RsFileHash::random(),NULL,0,dir_subfiles,1);
+	RsFileHash file_hash = RsFileHash::random();
+
+	builder.addFileNode(1,0,"song.ogg",8,10,1234,file_hash);
+	builder.addEmptyNode();
+	builder.addFileHash(file_hash,2,true);
+
+	ASSERT_TRUE(builder.build(data,1,10));
+}
+
+TEST(libretroshare_file_sharing, MappedHierarchyRoundTrip)
+{
+	std::vector<unsigned char> data;
+	buildHierarchy(data);
+
+	ASSERT_TRUE(MappedFileHierarchy::isMappedData(data.data(),data.size()));
+
+	MappedFileHierarchy m;
+	ASSERT_TRUE(m.open(data.data(),data.size()));
+
+	EXPECT_EQ(4u,m.nodeCount());
+	EXPECT_EQ(1u,m.totalFiles());
+	EXPECT_EQ(10u,m.totalSize());
+	EXPECT_EQ(+MappedFileHierarchy::TYPE_DIR,+m.node(1).type);
+	EXPECT_EQ(+MappedFileHierarchy::TYPE_EMPTY,+m.node(3).type);
+	EXPECT_EQ("music",m.name(1));
+	EXPECT_EQ("song.ogg",m.name(2));
+	EXPECT_EQ(2u,m.children(1)[0]);
+
+	uint32_t indx = 0;
+	EXPECT_TRUE(m.findFileHash(m.hash(2),indx));
+	EXPECT_EQ(2u,indx);
+}
+
+TEST(libretroshare_file_sharing, MappedHierarchyRejectsInvalidData)
+{
+	std::vector<unsigned char> data;
+	MappedFileHierarchy m;
+
+	// truncated
+
+	buildHierarchy(data);
+	EXPECT_FALSE(m.open(data.data(),data.size()/2));
+
+	// a dir listed as child of the root, but with another parent
+
+	buildHierarchy(data,2);
+	EXPECT_FALSE(m.open(data.data(),data.size()));
+
+	// the root listed as its own child, which loops
+
+	buildHierarchy(data,0,0);
+	EXPECT_FALSE(m.open(data.data(),data.size()));
+
+	// not a mapped hierarchy at all
+
+	std::vector<unsigned char> garbage(data.size(),0x42);
+	EXPECT_FALSE(MappedFileHierarchy::isMappedData(garbage.data(),garbage.size()));
+	EXPECT_FALSE(m.open(garbage.data(),garbage.size()));
+}
@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * unittests/libretroshare/ft/ftchunkbitset_test.cc                            *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "ft/ftchunkbitset.h"
+#include "retroshare/rstypes.h"
+
+// Sizes around the 64 bits words, and large enough for a Fenwick tree of several levels.
+static const uint32_t sizes[] = { 0, 1, 2, 63, 64, 65, 127, 128, 129, 200, 1000 };
+
+/* Checks every query of the bit set against a plain vector of bits. */
+static void checkAgainstNaive(const ChunkBitSet& s,const std::vector<bool>& naive)
+{
+	const uint32_t n = naive.size();
+
+	ASSERT_EQ(n, s.size());
+
+	std::vector<uint32_t> ones, zeros;
+
+	for(uint32_t i=0;i<n;++i)
+	{
+		ASSERT_EQ(naive[i], s.test(i)) << "bit " << i;
+		EXPECT_EQ(ones.size(), s.rank(i)) << "rank " << i;
+
+		(naive[i] ? ones : zeros).push_back(i);
+	}
+
+	EXPECT_EQ(ones.size(), s.count());
+	EXPECT_EQ(ones.size(), s.rank(n));
+	EXPECT_EQ(ones.size(), s.rank(n+100));
+
+	for(uint32_t k=0;k<ones.size();++k)
+		EXPECT_EQ(ones[k], s.select(k)) << "select " << k;
+
+	for(uint32_t k=0;k<zeros.size();++k)
+		EXPECT_EQ(zeros[k], s.selectZero(k)) << "selectZero " << k;
+
+	// out of range queries return size()
+
+	EXPECT_EQ(n, s.select(ones.size()));
+	EXPECT_EQ(n, s.selectZero(zeros.size()));
+
+	// first missing chunk, and first chunk we have
+
+	EXPECT_EQ(zeros.empty() ? n : zeros.front(), s.selectZero(0));
+	EXPECT_EQ(ones.empty() ? n : ones.front(), s.select(0));
+
+	EXPECT_EQ(zeros.empty(), s.allSet(0,n));
+	EXPECT_EQ(ones.empty(), s.noneSet(0,n));
+}
+
+TEST(libretroshare_ft, ChunkBitSetEmptyAndFull)
+{
+	for(uint32_t n: sizes)
+	{
+		ChunkBitSet s;
+
+		s.resize(n,false);
+		checkAgainstNaive(s,std::vector<bool>(n,false));
+
+		// the bits after the last chunk of a full set must not be counted
+
+		s.resize(n,true);
+		checkAgainstNaive(s,std::vector<bool>(n,true));
+
+		EXPECT_TRUE(s.allSet(0,n));
+		EXPECT_TRUE(s.noneSet(n,n));
+	}
+}
+
+TEST(libretroshare_ft, ChunkBitSetRandomOperations)
+{
+	std::mt19937 rng(1234);
+
+	for(uint32_t n: sizes)
+	{
+		if(n == 0)
+			continue;
+
+		for(bool initial: { false, true })
+		{
+			ChunkBitSet s;
+			std::vector<bool> naive(n,initial);
+			s.resize(n,initial);
+
+			for(uint32_t op=0;op<4*n;++op)
+			{
+				uint32_t i = rng() % n;
+
+				// also sets bits that are already set, and resets bits that are not
+				if(rng() % 2)
+				{
+					s.set(i);
+					naive[i] = true;
+				}
+				else
+				{
+					s.reset(i);
+					naive[i] = false;
+				}
+
+				if(op % (n/8+1) == 0)
+					checkAgainstNaive(s,naive);
+			}
+			checkAgainstNaive(s,naive);
+
+			// ranges, including empty ones and the last word
+
+			for(uint32_t t=0;t<50;++t)
+			{
+				uint32_t b = rng() % (n+1);
+				uint32_t e = rng() % (n+1);
+
+				bool all = true, none = true;
+
+				for(uint32_t i=b;i<e;++i)
+				{
+					all = all && naive[i];
+					none = none && !naive[i];
+				}
+				EXPECT_EQ(all, s.allSet(b,e)) << b << " " << e;
+				EXPECT_EQ(none, s.noneSet(b,e)) << b << " " << e;
+			}
+		}
+	}
+}
+
+TEST(libretroshare_ft, ChunkBitSetCompressedChunkMap)
+{
+	std::mt19937 rng(5678);
+
+	for(uint32_t n: sizes)
+	{
+		ChunkBitSet a;
+		std::vector<bool> na(n);
+		a.resize(n,false);
+
+		CompressedChunkMap m(n,0);
+		std::vector<bool> nm(n);
+
+		for(uint32_t i=0;i<n;++i)
+		{
+			if(rng() % 3)
+			{
+				a.set(i);
+				na[i] = true;
+			}
+			if(rng() % 2)
+			{
+				m.set(i);
+				nm[i] = true;
+			}
+		}
+
+		// what a peer has among what we still need
+
+		ChunkBitSet r;
+		r.assignAnd(a,m);
+
+		std::vector<bool> nr(n);
+		for(uint32_t i=0;i<n;++i)
+			nr[i] = na[i] && nm[i];
+
+		checkAgainstNaive(r,nr);
+
+		// and back to the format sent to peers
+
+		CompressedChunkMap out;
+		r.toCompressedChunkMap(out);
+
+		ASSERT_EQ(CompressedChunkMap::getCompressedSize(n), out._map.size());
+
+		for(uint32_t i=0;i<n;++i)
+			EXPECT_EQ(nr[i], out[i]) << i;
+
+		// padding bits after the last chunk are zero
+
+		for(uint32_t i=n;i<32*out._map.size();++i)
+			EXPECT_FALSE(out[i]) << i;
+	}
+}
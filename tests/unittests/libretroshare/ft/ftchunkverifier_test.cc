@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * unittests/libretroshare/ft/ftchunkverifier_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "ft/ftchunkverifier.h"
+#include "ft/ftfilecreator.h"
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+
+TEST(libretroshare_ft, ChunkVerifierOnlyReAsksCorruptChunk)
+{
+	const uint32_t chunk_size = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE;
+	const uint32_t nb_chunks = 3;
+	const std::string fname = "ftchunkverifier_test.tmp";
+
+	std::vector<unsigned char> data(nb_chunks*chunk_size);
+	RSRandom::random_bytes(data.data(),data.size());
+
+	FILE *f = fopen(fname.c_str(),"wb");
+	ASSERT_TRUE(f != NULL);
+	ASSERT_EQ(data.size(),fwrite(data.data(),1,data.size(),f));
+	fclose(f);
+
+	{
+		ftFileCreator creator(fname,data.size(),RsFileHash::random(),true);
+		creator.forceCheck();
+
+		std::vector<uint32_t> to_check;
+		creator.getChunksToCheck(to_check);
+		ASSERT_EQ(nb_chunks,to_check.size());
+
+		ftChunkVerifier verifier;
+
+		// Chunk 1 gets the sum of some other data, as if it had been corrupted during the transfer.
+
+		for(uint32_t i=0;i<nb_chunks;++i)
+			verifier.queueChunk(&creator,i,RsDirUtil::sha1sum(data.data() + i*chunk_size + (i == 1 ? 1 : 0),chunk_size));
+
+		for(int i=0;i<500 && verifier.pendingChunks() > 0;++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		verifier.removeFileCreator(&creator);
+
+		FileChunksInfo info;
+		creator.getChunkMap(info);
+
+		ASSERT_EQ(nb_chunks,info.chunks.size());
+		EXPECT_EQ(FileChunksInfo::CHUNK_DONE,       info.chunks[0]);
+		EXPECT_EQ(FileChunksInfo::CHUNK_OUTSTANDING,info.chunks[1]);
+		EXPECT_EQ(FileChunksInfo::CHUNK_DONE,       info.chunks[2]);
+
+		// All slices asked to a source must be in the corrupt chunk.
+
+		RsPeerId peer = RsPeerId::random();
+		uint64_t offset;
+		uint32_t size;
+		bool map_needed;
+		int nb_slices = 0;
+
+		while(creator.getMissingChunk(peer,128*1024,offset,size,map_needed) && nb_slices < 100)
+		{
+			EXPECT_LE(chunk_size,offset);
+			EXPECT_GE(2*(uint64_t)chunk_size,offset+size);
+			++nb_slices;
+		}
+		EXPECT_LT(0,nb_slices);
+	}
+	remove(fname.c_str());
+}
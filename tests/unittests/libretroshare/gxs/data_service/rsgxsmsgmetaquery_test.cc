@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/data_service/rsgxsmsgmetaquery_test.cc          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "gxs/rsdataservice.h"
+#include "rsitems/rsnxsitems.h"
+#include "rsitems/rsserviceids.h"
+
+#define META_QUERY_DB_NAME "msg_meta_query_store"
+
+static RsGxsMessageId storeMsg(std::list<RsNxsMsg*>& msgs, const RsGxsGroupId& grpId, rstime_t ts,
+                               const RsGxsMessageId& parentId = RsGxsMessageId(),
+                               const RsGxsMessageId& threadId = RsGxsMessageId(),
+                               const RsGxsMessageId& origMsgId = RsGxsMessageId(),
+                               uint32_t status = 0)
+{
+	RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_GXS_TYPE_FORUMS);
+	RsGxsMsgMetaData *meta = new RsGxsMsgMetaData();
+
+	meta->mGroupId = msg->grpId = grpId;
+	meta->mMsgId = msg->msgId = RsGxsMessageId::random();
+	meta->mPublishTs = ts;
+	meta->mParentId = parentId;
+	meta->mThreadId = threadId;
+	meta->mOrigMsgId = origMsgId;
+	meta->mMsgStatus = status;
+
+	msg->metaData = meta;
+	msgs.push_back(msg);
+
+	return meta->mMsgId;
+}
+
+static std::vector<RsGxsMessageId> queryIds(RsDataService& store, const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query)
+{
+	std::vector<std::shared_ptr<RsGxsMsgMetaData> > metas;
+	store.retrieveGxsMsgMetaData(grpId, query, metas);
+
+	std::vector<RsGxsMessageId> ids;
+	for(const auto& m: metas)
+		ids.push_back(m->mMsgId);
+
+	// Without paging the order is not specified.
+	if(!query.isPaged())
+		std::sort(ids.begin(), ids.end());
+
+	return ids;
+}
+
+/*!
+ * The data store answers a msg meta query either with SQL, when the group is
+ * not entirely in its cache, or by filtering the cached metas with
+ * RsGxsMsgMetaQuery::apply(). Both must give the same messages, in the same
+ * order when paged.
+ */
+TEST(libretroshare_gxs, RsGxsMsgMetaQueryCachedMatchesSql)
+{
+	remove(META_QUERY_DB_NAME);
+	RsDataService store(".", META_QUERY_DB_NAME, RS_SERVICE_GXS_TYPE_FORUMS);
+
+	RsGxsGroupId grpId = RsGxsGroupId::random();
+	RsGxsGroupId otherGrpId = RsGxsGroupId::random();
+	std::list<RsNxsMsg*> msgs;
+
+	RsGxsMessageId m1 = storeMsg(msgs, grpId, 100);
+	RsGxsMessageId m2 = storeMsg(msgs, grpId, 200);
+	RsGxsMessageId m3 = storeMsg(msgs, grpId, 150, m1, m1);
+	RsGxsMessageId m4 = storeMsg(msgs, grpId, 300, RsGxsMessageId(), RsGxsMessageId(), m1);	// edits of m1, same time stamp
+	RsGxsMessageId m5 = storeMsg(msgs, grpId, 300, RsGxsMessageId(), RsGxsMessageId(), m1);
+	RsGxsMessageId m6 = storeMsg(msgs, grpId, 150, m3, m1, RsGxsMessageId(), 0x4);
+	RsGxsMessageId m7 = storeMsg(msgs, grpId, 250);
+	storeMsg(msgs, grpId, 50, RsGxsMessageId(), RsGxsMessageId(), m7);
+
+	// an edit of m2 in another group must not hide m2
+	storeMsg(msgs, otherGrpId, 400, RsGxsMessageId(), RsGxsMessageId(), m2);
+
+	ASSERT_EQ(1, store.storeMessage(msgs));
+
+	std::vector<RsGxsMsgMetaQuery> queries;
+	RsGxsMsgMetaQuery q;
+
+	queries.push_back(q);
+
+	q = RsGxsMsgMetaQuery(); q.mLatestMsgsOnly = true;              queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mThreadHeadsOnly = true;             queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mOrigMsgsOnly = true;                queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mMsgId = m2;                         queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mThreadId = m1;                      queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mParentId = m3;                      queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mOrigMsgId = m1;                     queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mStatusMask = 0x4; q.mStatusFilter = 0x4; queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mAfter = 100; q.mBefore = 300;       queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mLimit = 3;                          queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mLimit = 3; q.mOffset = 3;           queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mOffset = 5;                         queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mOffset = 20;                        queries.push_back(q);
+	q = RsGxsMsgMetaQuery(); q.mLatestMsgsOnly = true; q.mThreadHeadsOnly = true; q.mLimit = 2; q.mOffset = 1; queries.push_back(q);
+
+	// Nothing asked for the whole group yet, so these come from the db.
+	std::vector<std::vector<RsGxsMessageId> > sqlResults;
+	for(const auto& query: queries)
+		sqlResults.push_back(queryIds(store, grpId, query));
+
+	// Loads the whole group in the cache. Next queries are answered from it.
+	GxsMsgReq req;
+	req[grpId];
+	GxsMsgMetaResult all;
+	store.retrieveGxsMsgMetaData(req, all);
+	ASSERT_EQ(8u, all[grpId].size());
+
+	for(uint32_t i=0;i<queries.size();++i)
+		EXPECT_EQ(sqlResults[i], queryIds(store, grpId, queries[i])) << "query " << i;
+
+	// a few known answers, so that both paths cannot agree on a wrong result
+	std::vector<RsGxsMessageId> latest = queryIds(store, grpId, queries[1]);
+	EXPECT_EQ(6u, latest.size());
+	EXPECT_TRUE(std::find(latest.begin(), latest.end(), m1) == latest.end());
+	EXPECT_TRUE(std::find(latest.begin(), latest.end(), m7) == latest.end());
+	EXPECT_TRUE(std::find(latest.begin(), latest.end(), m2) != latest.end());
+
+	EXPECT_EQ(6u, sqlResults[2].size());	// m1, m2, m4, m5, m7 and the edit of m7
+	EXPECT_EQ(std::vector<RsGxsMessageId>(1, m6), sqlResults[6]);
+
+	std::vector<RsGxsMessageId> firstPage = sqlResults[10];
+	ASSERT_EQ(3u, firstPage.size());
+	EXPECT_EQ(std::min(m4, m5), firstPage[0]);
+	EXPECT_EQ(std::max(m4, m5), firstPage[1]);
+	EXPECT_EQ(m7, firstPage[2]);
+	EXPECT_EQ(3u, sqlResults[11].size());
+	EXPECT_TRUE(sqlResults[13].empty());
+
+	store.resetDataStore();
+	remove(META_QUERY_DB_NAME);
+}
@@ -0,0 +1,286 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/gen_exchange/gxsrequestpool_test.cc             *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "gxs/gxsrequestpool.h"
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgenexchange.h"
+#include "gxs/rsnxs.h"
+#include "rsitems/rsserviceids.h"
+
+#define REQUEST_POOL_DB_NAME "gxsRequestPoolDb"
+
+static const uint16_t TEST_SERVICE_TYPE = static_cast<uint16_t>(RsServiceType::FORUMS);
+
+// Blocks request processing until released, and counts the runs.
+
+class ProcessingGate
+{
+public:
+	ProcessingGate() : mOpen(false), mEntered(0), mRunning(0) {}
+
+	void enter()
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		++mEntered;
+		++mRunning;
+		mCv.notify_all();
+		mCv.wait(lock,[this]() { return mOpen; });
+	}
+	void leave()
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		--mRunning;
+	}
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mMtx);
+		mOpen = true;
+		mCv.notify_all();
+	}
+	bool waitEntered(uint32_t n)
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+		return mCv.wait_for(lock,std::chrono::seconds(5),[this,n]() { return mEntered >= n; });
+	}
+
+	uint32_t entered()  { std::lock_guard<std::mutex> lock(mMtx); return mEntered; }
+	uint32_t running()  { std::lock_guard<std::mutex> lock(mMtx); return mRunning; }
+
+private:
+	std::mutex mMtx;
+	std::condition_variable mCv;
+	bool mOpen;
+	uint32_t mEntered;
+	uint32_t mRunning;
+};
+
+class GatedProcessor: public GxsRequestProcessor
+{
+public:
+	void processPendingRequests() override { gate.enter(); gate.leave(); }
+
+	ProcessingGate gate;
+};
+
+// The gate outlives the services, which are deleted while being processed.
+
+static ProcessingGate *gServiceGate = nullptr;
+
+class GatedExchange: public RsGenExchange
+{
+public:
+	GatedExchange(RsGeneralDataService* dataServ, RsNetworkExchangeService* nxs)
+	    : RsGenExchange(dataServ,nxs,NULL,TEST_SERVICE_TYPE,NULL,0) {}
+
+	RsServiceInfo getServiceInfo() override { return RsServiceInfo(); }
+	void service_tick() override {}
+	void notifyChanges(std::vector<RsGxsNotify*>& changes) override
+	{
+		for(uint32_t i=0;i<changes.size();++i)
+			delete changes[i];
+		changes.clear();
+	}
+
+	void processPendingRequests() override
+	{
+		gServiceGate->enter();
+		RsGenExchange::processPendingRequests();
+		gServiceGate->leave();
+	}
+};
+
+// Network service that only records whether it is deleted while the exchange processes requests.
+
+class CheckedNetService: public RsNetworkExchangeService
+{
+public:
+	explicit CheckedNetService(bool& deleted_while_processing) : mDeletedWhileProcessing(deleted_while_processing) {}
+	~CheckedNetService() override { mDeletedWhileProcessing = gServiceGate->running() > 0; }
+
+	uint16_t serviceType() const override { return TEST_SERVICE_TYPE; }
+	void setSyncAge(const RsGxsGroupId&,uint32_t) override {}
+	void setKeepAge(const RsGxsGroupId&,uint32_t) override {}
+	uint32_t getSyncAge(const RsGxsGroupId&) override { return 0; }
+	uint32_t getKeepAge(const RsGxsGroupId&) override { return 0; }
+	bool syncOldMsgVersions() override { return false; }
+	void setDefaultKeepAge(uint32_t) override {}
+	void setDefaultSyncAge(uint32_t) override {}
+	uint32_t getDefaultSyncAge() override { return 0; }
+	uint32_t getDefaultKeepAge() override { return 0; }
+	bool msgAutoSync() const override { return false; }
+	bool grpAutoSync() const override { return false; }
+
+	std::error_condition distantSearchRequest(rs_owner_ptr<uint8_t>,uint32_t,RsServiceType,TurtleRequestId&) override
+	{ return std::errc::not_supported; }
+	std::error_condition handleDistantSearchRequest(rs_view_ptr<uint8_t>,uint32_t,rs_owner_ptr<uint8_t>&,uint32_t&) override
+	{ return std::errc::not_supported; }
+	std::error_condition receiveDistantSearchResult(const TurtleRequestId,rs_owner_ptr<uint8_t>&,uint32_t&) override
+	{ return std::errc::not_supported; }
+	TurtleRequestId turtleGroupRequest(const RsGxsGroupId&) override { return 0; }
+	TurtleRequestId turtleSearchRequest(const std::string&) override { return 0; }
+	void receiveTurtleSearchResults(TurtleRequestId,const std::list<RsGxsGroupSummary>&) override {}
+	void receiveTurtleSearchResults(TurtleRequestId,rs_owner_ptr<const uint8_t>,uint32_t) override {}
+	bool retrieveDistantSearchResults(TurtleRequestId,std::map<RsGxsGroupId,RsGxsGroupSearchResults>&) override { return false; }
+	bool clearDistantSearchResults(const TurtleRequestId&) override { return false; }
+	bool retrieveDistantGroupSummary(const RsGxsGroupId&,RsGxsGroupSearchResults&) override { return false; }
+	bool search(const std::string&,std::list<RsGxsGroupSummary>&) override { return false; }
+	bool search(const Sha1CheckSum&,unsigned char *&,uint32_t&) override { return false; }
+	DistantSearchGroupStatus getDistantSearchStatus(const RsGxsGroupId&) override { return DistantSearchGroupStatus::UNKNOWN; }
+
+	void pauseSynchronisation(bool) override {}
+	int requestMsg(const RsGxsGrpMsgIdPair&) override { return 0; }
+	int requestGrp(const std::list<RsGxsGroupId>&,const RsPeerId&) override { return 0; }
+	bool getGroupNetworkStats(const RsGxsGroupId&,RsGroupNetworkStats&) override { return false; }
+	void subscribeStatusChanged(const RsGxsGroupId&,bool) override {}
+	int sharePublishKey(const RsGxsGroupId&,const std::set<RsPeerId>&) override { return 0; }
+	void rejectMessage(const RsGxsMessageId&) override {}
+	bool getGroupServerUpdateTS(const RsGxsGroupId&,rstime_t&,rstime_t&) override { return false; }
+	bool stampMsgServerUpdateTS(const RsGxsGroupId&) override { return false; }
+	bool isDistantPeer(const RsPeerId&) override { return false; }
+	bool removeGroups(const std::list<RsGxsGroupId>&) override { return false; }
+	std::error_condition checkUpdatesFromPeers(std::set<RsPeerId>) override { return std::error_condition(); }
+	std::error_condition requestPull(std::set<RsPeerId>) override { return std::error_condition(); }
+
+private:
+	bool& mDeletedWhileProcessing;
+};
+
+static uint32_t requestGroupIds(RsGenExchange& service)
+{
+	uint32_t token = 0;
+	RsTokReqOptions opts;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS;
+
+	EXPECT_TRUE(service.getTokenService()->requestGroupInfo(token,RS_TOKREQ_ANSTYPE_LIST,opts));
+
+	return token;
+}
+
+TEST(libretroshare_gxs, GxsRequestPoolUnregisterWaitsAndRemoves)
+{
+	GatedProcessor processor;
+
+	GxsRequestPool::schedule(&processor);
+	ASSERT_TRUE(processor.gate.waitEntered(1));
+
+	// Scheduled again while being run: it is queued for another run, which unregister() drops.
+
+	GxsRequestPool::schedule(&processor);
+
+	std::atomic<bool> unregistered(false);
+	std::atomic<uint32_t> running_when_unregistered(1);
+
+	std::thread t([&]()
+	{
+		GxsRequestPool::unregister(&processor);
+		running_when_unregistered = processor.gate.running();
+		unregistered = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	EXPECT_FALSE(unregistered);
+
+	processor.gate.release();
+	t.join();
+
+	EXPECT_EQ(0u,running_when_unregistered);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	EXPECT_EQ(1u,processor.gate.entered());
+}
+
+TEST(libretroshare_gxs, GxsWaitTokenWakesOnCompletion)
+{
+	remove(REQUEST_POOL_DB_NAME);
+
+	ProcessingGate gate;
+	gServiceGate = &gate;
+	{
+		GatedExchange service(new RsDataService("./",REQUEST_POOL_DB_NAME,TEST_SERVICE_TYPE,NULL,""),NULL);
+
+		// The request is processed by the pool right away, without ticking the service.
+
+		uint32_t token = requestGroupIds(service);
+		ASSERT_TRUE(gate.waitEntered(1));
+		EXPECT_EQ(RsTokenService::PENDING,service.getTokenService()->requestStatus(token));
+
+		std::thread releaser([&gate]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			gate.release();
+		});
+
+		// Without a wake-up the waiter would only see the completion when re-checking, after a second.
+
+		auto start = std::chrono::steady_clock::now();
+		EXPECT_EQ(RsTokenService::COMPLETE,service.getTokenService()->waitForRequest(token,std::chrono::seconds(20)));
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		releaser.join();
+
+		EXPECT_GE(elapsed,std::chrono::milliseconds(150));
+		EXPECT_LT(elapsed,std::chrono::milliseconds(800));
+	}
+	gServiceGate = nullptr;
+
+	remove(REQUEST_POOL_DB_NAME);
+}
+
+TEST(libretroshare_gxs, GxsRequestPoolUnregisteredBeforeNetServiceDeletion)
+{
+	remove(REQUEST_POOL_DB_NAME);
+
+	ProcessingGate gate;
+	gServiceGate = &gate;
+
+	bool deleted_while_processing = true;
+	GatedExchange *service = new GatedExchange(
+	            new RsDataService("./",REQUEST_POOL_DB_NAME,TEST_SERVICE_TYPE,NULL,""),
+	            new CheckedNetService(deleted_while_processing) );
+
+	requestGroupIds(*service);
+	ASSERT_TRUE(gate.waitEntered(1));
+
+	// Deleting the service waits for the pool to be done with it, before deleting the network service.
+
+	std::atomic<bool> deleted(false);
+	std::thread t([&]() { delete service; deleted = true; });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	EXPECT_FALSE(deleted);
+
+	gate.release();
+	t.join();
+
+	EXPECT_FALSE(deleted_while_processing);
+
+	gServiceGate = nullptr;
+
+	remove(REQUEST_POOL_DB_NAME);
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * unittests/libretroshare/gxs/nxs_test/rsgxsmsgsketch_test.cc                 *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "gxs/rsgxsmsgsketch.h"
+
+TEST(libretroshare_gxs, RsGxsMsgIdSketchDecodesSmallDifference)
+{
+	std::set<RsGxsMessageId> common, onlyA, onlyB;
+
+	for(int i=0; i<5000; ++i) common.insert(RsGxsMessageId::random());
+	for(int i=0; i<40; ++i) onlyA.insert(RsGxsMessageId::random());
+	for(int i=0; i<25; ++i) onlyB.insert(RsGxsMessageId::random());
+
+	uint32_t cells = RsGxsMsgIdSketch::suggestedCellCount(5040);
+	RsGxsMsgIdSketch a(cells), b(cells);
+
+	for(auto& id : common) { a.insert(id); b.insert(id); }
+	for(auto& id : onlyA) a.insert(id);
+	for(auto& id : onlyB) b.insert(id);
+
+	// Go through the wire format, as RsGxsNetService does
+	RsTlvBinaryData data(0);
+	EXPECT_TRUE(b.serialise(data));
+
+	RsGxsMsgIdSketch received;
+	EXPECT_TRUE(received.deserialise(data));
+	EXPECT_EQ(received.cellCount(), a.cellCount());
+	EXPECT_EQ(received.elementCount(), b.elementCount());
+
+	std::set<RsGxsMessageId> here, there;
+	EXPECT_TRUE(a.decodeDifference(received, here, there));
+	EXPECT_TRUE(here == onlyA);
+	EXPECT_TRUE(there == onlyB);
+}
+
+TEST(libretroshare_gxs, RsGxsMsgIdSketchFailsOnLargeDifference)
+{
+	RsGxsMsgIdSketch a(RsGxsMsgIdSketch::MIN_CELL_COUNT);
+	RsGxsMsgIdSketch b(RsGxsMsgIdSketch::MIN_CELL_COUNT);
+
+	for(int i=0; i<500; ++i) a.insert(RsGxsMessageId::random());
+
+	std::set<RsGxsMessageId> here, there;
+	EXPECT_FALSE(a.decodeDifference(b, here, there));
+}
+
+TEST(libretroshare_gxs, RsGxsMsgIdSketchRejectsMalformedData)
+{
+	RsGxsMsgIdSketch a;
+	RsTlvBinaryData data(0);
+	EXPECT_TRUE(a.serialise(data));
+
+	// Truncated
+	RsTlvBinaryData truncated(0);
+	truncated.setBinData(data.bin_data, data.bin_len - 1);
+
+	RsGxsMsgIdSketch b;
+	EXPECT_FALSE(b.deserialise(truncated));
+
+	// Sketches of different sizes cannot be compared
+	RsGxsMsgIdSketch c(RsGxsMsgIdSketch::MIN_CELL_COUNT * 2);
+	std::set<RsGxsMessageId> here, there;
+	EXPECT_FALSE(a.decodeDifference(c, here, there));
+}
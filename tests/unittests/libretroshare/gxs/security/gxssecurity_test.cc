@@ -93,3 +93,56 @@ TEST(libretroshare_gxs, GxsSecurity)
 }
 
 
+
+TEST(libretroshare_gxs, GxsSecurityMsgSignature)
+{
+	RsTlvPublicRSAKey pub_key ;
+	RsTlvPrivateRSAKey priv_key ;
+
+	EXPECT_TRUE(GxsSecurity::generateKeyPair(pub_key,priv_key)) ;
+
+	RsNxsMsg msg(0) ;
+	msg.metaData = new RsGxsMsgMetaData ;
+	msg.metaData->mGroupId = RsGxsGroupId::random() ;
+	msg.metaData->mAuthorId = pub_key.keyId ;
+	msg.metaData->mPublishTs = pub_key.startTS + 1 ;
+	msg.metaData->mMsgName = "test message" ;
+
+	msg.msg.setBinData("some message data", 17) ;
+
+	// Sign the message the way RsGenExchange does: msg data followed by meta data, without the msg id nor signatures.
+
+	uint32_t meta_len = msg.metaData->serial_size() ;
+	uint32_t all_len = msg.msg.bin_len + meta_len ;
+	RsTemporaryMemory all_data(all_len) ;
+
+	memcpy(all_data, msg.msg.bin_data, msg.msg.bin_len) ;
+	EXPECT_TRUE(msg.metaData->serialise(all_data + msg.msg.bin_len, &meta_len)) ;
+
+	RsTlvKeySignature signature ;
+	EXPECT_TRUE(GxsSecurity::getSignature((char*)(unsigned char*)all_data,all_len,priv_key,signature)) ;
+
+	msg.metaData->mMsgId = RsGxsMessageId::random() ;
+	msg.metaData->mOrigMsgId = msg.metaData->mMsgId ;
+
+	// The second check is answered by the cache of verified signatures. Meta data must be left untouched.
+
+	EXPECT_TRUE(GxsSecurity::validateNxsMsg(msg,signature,pub_key)) ;
+	EXPECT_TRUE(GxsSecurity::validateNxsMsg(msg,signature,pub_key)) ;
+	EXPECT_TRUE(msg.metaData->mOrigMsgId == msg.metaData->mMsgId) ;
+
+	// Tampered data must not match the cache.
+
+	msg.msg.setBinData("some message dat4", 17) ;
+	EXPECT_FALSE(GxsSecurity::validateNxsMsg(msg,signature,pub_key)) ;
+	msg.msg.setBinData("some message data", 17) ;
+
+	// Neither must another key.
+
+	RsTlvPublicRSAKey pub_key2 ;
+	RsTlvPrivateRSAKey priv_key2 ;
+
+	EXPECT_TRUE(GxsSecurity::generateKeyPair(pub_key2,priv_key2)) ;
+	pub_key2.startTS = pub_key.startTS ;
+	EXPECT_FALSE(GxsSecurity::validateNxsMsg(msg,signature,pub_key2)) ;
+}
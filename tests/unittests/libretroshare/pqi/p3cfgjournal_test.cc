@@ -0,0 +1,337 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/p3cfgjournal_test.cc                            *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "pqi/p3cfgjournal.h"
+#include "util/rsdir.h"
+
+#define JOURNAL_FILE_NAME "p3cfgjournal_test.jnl"
+
+typedef std::list<std::vector<uint8_t> > Records;
+
+/* Stands in for the node's SSL key, which the tests do not have. */
+class TestJournal: public p3ConfigJournal
+{
+public:
+	TestJournal() : p3ConfigJournal(JOURNAL_FILE_NAME) {}
+
+protected:
+	bool signHeader(const uint8_t *data, uint32_t size, std::string& signature) override
+	{
+		signature = sign(data, size).toStdString();
+		return true;
+	}
+	bool verifyHeader( const uint8_t *data, uint32_t size,
+	                   uint8_t *signature, uint32_t signatureSize ) override
+	{
+		return signatureSize == Sha1CheckSum::SIZE_IN_BYTES &&
+		        Sha1CheckSum(signature) == sign(data, size);
+	}
+	bool sealKey(const uint8_t *key, uint32_t size, std::vector<uint8_t>& sealedKey) override
+	{
+		sealedKey.assign(key, key + size);
+		for(uint32_t i=0;i<size;++i)
+			sealedKey[i] ^= 0x5a;
+		return true;
+	}
+	bool unsealKey(const uint8_t *sealedKey, uint32_t size, std::vector<uint8_t>& key) override
+	{
+		return sealKey(sealedKey, size, key);
+	}
+
+private:
+	static Sha1CheckSum sign(const uint8_t *data, uint32_t size)
+	{
+		std::vector<uint8_t> d(data, data + size);
+		d.insert(d.end(), 8, 0x42);
+		return RsDirUtil::sha1sum(d.data(), d.size());
+	}
+};
+
+static std::vector<uint8_t> record(const std::string& s)
+{
+	return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+static bool append(p3ConfigJournal& journal, const std::string& s)
+{
+	return journal.append((const uint8_t*)s.data(), s.size());
+}
+
+static Records records(const std::string& a, const std::string& b = "", const std::string& c = "")
+{
+	Records r;
+	for(const std::string& s : { a, b, c })
+		if(!s.empty())
+			r.push_back(record(s));
+	return r;
+}
+
+static std::vector<uint8_t> readFile(const std::string& fname)
+{
+	std::vector<uint8_t> content;
+	FILE *f = fopen(fname.c_str(), "rb");
+
+	if(!f)
+		return content;
+
+	uint8_t buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		content.insert(content.end(), buf, buf + n);
+
+	fclose(f);
+	return content;
+}
+
+static void writeFile(const std::string& fname, const std::vector<uint8_t>& content)
+{
+	FILE *f = fopen(fname.c_str(), "wb");
+	ASSERT_TRUE(f != NULL);
+	ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), f));
+	fclose(f);
+}
+
+static void cleanup()
+{
+	remove(JOURNAL_FILE_NAME);
+	remove(JOURNAL_FILE_NAME "_new");
+}
+
+TEST(libretroshare_pqi, ConfigJournalReplay)
+{
+	cleanup();
+	RsFileHash h1 = RsFileHash::random();
+	RsFileHash h2 = RsFileHash::random();
+
+	{
+		TestJournal j;
+		Records r;
+		EXPECT_FALSE(j.load(h1, 100, r));
+		EXPECT_TRUE(append(j, "aaa"));
+		EXPECT_TRUE(append(j, "bbb"));
+	}
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h1, 100, r));
+		EXPECT_EQ(records("aaa", "bbb"), r);
+		EXPECT_TRUE(append(j, "ccc"));
+	}
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h1, 100, r));
+		EXPECT_EQ(records("aaa", "bbb", "ccc"), r);
+	}
+	{
+		// follows another snapshot
+		TestJournal j;
+		Records r;
+		EXPECT_FALSE(j.load(h2, 100, r));
+	}
+
+	cleanup();
+}
+
+TEST(libretroshare_pqi, ConfigJournalTornTail)
+{
+	cleanup();
+	RsFileHash h = RsFileHash::random();
+
+	{
+		TestJournal j;
+		Records r;
+		j.load(h, 100, r);
+		EXPECT_TRUE(append(j, "aaa"));
+		EXPECT_TRUE(append(j, "bbb"));
+		EXPECT_TRUE(append(j, "ccc"));
+	}
+
+	std::vector<uint8_t> content = readFile(JOURNAL_FILE_NAME);
+	content.resize(content.size() - 5);
+	writeFile(JOURNAL_FILE_NAME, content);
+
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h, 100, r));
+		EXPECT_EQ(records("aaa", "bbb"), r);
+		EXPECT_GT(content.size(), readFile(JOURNAL_FILE_NAME).size());
+		EXPECT_TRUE(append(j, "ddd"));
+	}
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h, 100, r));
+		EXPECT_EQ(records("aaa", "bbb", "ddd"), r);
+	}
+
+	cleanup();
+}
+
+TEST(libretroshare_pqi, ConfigJournalRotation)
+{
+	cleanup();
+	RsFileHash h1 = RsFileHash::random();
+	RsFileHash h2 = RsFileHash::random();
+
+	{
+		TestJournal j;
+		Records r;
+		j.load(h1, 100, r);
+		EXPECT_TRUE(append(j, "aaa"));
+
+		p3ConfigJournal::Mark mark = j.mark();
+		EXPECT_TRUE(append(j, "bbb"));
+		EXPECT_TRUE(append(j, "ccc"));
+
+		bool installed = false;
+		EXPECT_TRUE(j.rotate(h2, 100, mark, [&]() { installed = true; return true; }));
+		EXPECT_TRUE(installed);
+		EXPECT_TRUE(append(j, "ddd"));
+	}
+	{
+		TestJournal j;
+		Records r;
+		EXPECT_FALSE(j.load(h1, 100, r));
+		ASSERT_TRUE(j.load(h2, 100, r));
+		EXPECT_EQ(records("bbb", "ccc", "ddd"), r);
+
+		// failed install: the journal keeps following the previous snapshot
+		p3ConfigJournal::Mark mark = j.mark();
+		EXPECT_FALSE(j.rotate(h1, 100, mark, []() { return false; }));
+		EXPECT_TRUE(append(j, "eee"));
+	}
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h2, 100, r));
+		EXPECT_EQ(4u, r.size());
+
+		// nothing after the mark: no journal follows the new snapshot
+		p3ConfigJournal::Mark mark = j.mark();
+		EXPECT_TRUE(j.rotate(h1, 100, mark, []() { return true; }));
+	}
+	{
+		TestJournal j;
+		Records r;
+		EXPECT_FALSE(j.load(h1, 100, r));
+	}
+
+	cleanup();
+}
+
+TEST(libretroshare_pqi, ConfigJournalForgedHeader)
+{
+	cleanup();
+	RsFileHash h = RsFileHash::random();
+
+	{
+		TestJournal j;
+		Records r;
+		j.load(h, 100, r);
+		EXPECT_TRUE(append(j, "aaa"));
+	}
+
+	std::vector<uint8_t> content = readFile(JOURNAL_FILE_NAME);
+
+	// journal id, then first sequence number, right after the snapshot hash
+	for(uint32_t offset : { 4 + 20, 4 + 20 + 8 + 7 })
+	{
+		std::vector<uint8_t> forged(content);
+		forged[offset] ^= 1;
+		writeFile(JOURNAL_FILE_NAME, forged);
+
+		TestJournal j;
+		Records r;
+		EXPECT_FALSE(j.load(h, 100, r)) << "offset " << offset;
+	}
+
+	cleanup();
+}
+
+TEST(libretroshare_pqi, ConfigJournalRecordsAreBoundToTheirJournal)
+{
+	cleanup();
+	RsFileHash h1 = RsFileHash::random();
+	RsFileHash h2 = RsFileHash::random();
+	std::vector<uint8_t> oldContent;
+
+	{
+		TestJournal j;
+		Records r;
+		j.load(h1, 100, r);
+
+		p3ConfigJournal::Mark mark = j.mark();
+		EXPECT_TRUE(append(j, "aaa"));
+		EXPECT_TRUE(append(j, "bbb"));
+		oldContent = readFile(JOURNAL_FILE_NAME);
+
+		EXPECT_TRUE(j.rotate(h2, 100, mark, []() { return true; }));
+	}
+
+	// Both journals hold records 0 and 1, encrypted with the same key.
+	// The records of the first one must not be accepted by the second.
+
+	std::vector<uint8_t> content = readFile(JOURNAL_FILE_NAME);
+	ASSERT_EQ(oldContent.size(), content.size());
+
+	uint32_t recordsSize = 0;
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h2, 100, r));
+		EXPECT_EQ(records("aaa", "bbb"), r);
+		EXPECT_TRUE(append(j, "ccc"));
+		recordsSize = readFile(JOURNAL_FILE_NAME).size() - content.size();
+	}
+
+	uint32_t headerSize = content.size() - 2 * recordsSize;
+	std::vector<uint8_t> spliced(content.begin(), content.begin() + headerSize);
+	spliced.insert(spliced.end(), oldContent.begin() + headerSize, oldContent.end());
+	writeFile(JOURNAL_FILE_NAME, spliced);
+
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h2, 100, r));
+		EXPECT_TRUE(r.empty());
+	}
+
+	// Dropping the first record leaves records that do not start the journal.
+
+	std::vector<uint8_t> truncated(content.begin(), content.begin() + headerSize);
+	truncated.insert(truncated.end(), content.begin() + headerSize + recordsSize, content.end());
+	writeFile(JOURNAL_FILE_NAME, truncated);
+
+	{
+		TestJournal j;
+		Records r;
+		ASSERT_TRUE(j.load(h2, 100, r));
+		EXPECT_TRUE(r.empty());
+	}
+
+	cleanup();
+}
@@ -0,0 +1,277 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/p3historystore_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "pqi/p3historystore.h"
+
+static RsPeerId chatA = RsPeerId::random();
+static RsPeerId chatB = RsPeerId::random();
+
+static RsHistoryMsgItem *makeItem(uint32_t msgId, const RsPeerId& chat, uint32_t recvTime, const std::string& text)
+{
+	RsHistoryMsgItem *item = new RsHistoryMsgItem();
+	item->msgId = msgId;
+	item->chatPeerId = chat;
+	item->msgPeerId = chat;
+	item->incoming = (msgId % 2) == 0;
+	item->peerName = "peer";
+	item->sendTime = recvTime - 1;
+	item->recvTime = recvTime;
+	item->message = text;
+	return item;
+}
+
+static void addMessage(p3HistoryStore& store, uint32_t msgId, const RsPeerId& chat, uint32_t recvTime, const std::string& text)
+{
+	RsHistoryMsgItem *item = makeItem(msgId, chat, recvTime, text);
+	EXPECT_TRUE(store.addMessage(*item));
+	delete item;
+}
+
+static std::vector<uint32_t> ids(const std::list<HistoryMsg>& msgs)
+{
+	std::vector<uint32_t> v;
+	for(const HistoryMsg& m: msgs)
+		v.push_back(m.msgId);
+	return v;
+}
+
+/* Messages 1 to 20, alternating between chats A (odd) and B (even), received
+ * at 1000 + 10 * id. */
+static void fill(p3HistoryStore& store)
+{
+	const char *texts[] = { "hello world", "100% sure", "it's \"quoted\"", "under_score", "Hello again" };
+
+	for(uint32_t i=1;i<=20;++i)
+		addMessage(store, i, (i % 2) ? chatA : chatB, 1000 + 10 * i, texts[i % 5]);
+}
+
+TEST(libretroshare_pqi, HistoryStorePaging)
+{
+	p3HistoryStore store(":memory:", "");
+	fill(store);
+
+	EXPECT_EQ(20u, store.lastMsgId());
+
+	std::list<HistoryMsg> msgs;
+	ASSERT_TRUE(store.getMessages(chatA, 0, 3, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 15, 17, 19 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.getMessages(chatA, 15, 3, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 9, 11, 13 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.getMessages(chatA, 3, 3, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 1 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.getMessages(chatB, 0, 0, msgs));
+	EXPECT_EQ(10u, msgs.size());
+
+	HistoryMsg msg;
+	ASSERT_TRUE(store.getMessage(4, msg));
+	EXPECT_EQ(chatB, msg.chatPeerId);
+	EXPECT_TRUE(msg.incoming);
+	EXPECT_EQ(1040u, msg.recvTime);
+	EXPECT_EQ(1039u, msg.sendTime);
+	EXPECT_EQ("Hello again", msg.message);
+	EXPECT_FALSE(store.getMessage(21, msg));
+}
+
+TEST(libretroshare_pqi, HistoryStoreRange)
+{
+	p3HistoryStore store(":memory:", "");
+	fill(store);
+
+	// [from, to)
+	std::list<HistoryMsg> msgs;
+	ASSERT_TRUE(store.getMessagesInRange(chatA, 1030, 1090, 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 3, 5, 7 }), ids(msgs));
+
+	// the latest ones when limited
+	msgs.clear();
+	ASSERT_TRUE(store.getMessagesInRange(chatA, 1030, 1090, 2, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 5, 7 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.getMessagesInRange(chatB, 0, 1000, 0, msgs));
+	EXPECT_TRUE(msgs.empty());
+}
+
+TEST(libretroshare_pqi, HistoryStoreSearch)
+{
+	p3HistoryStore ftsStore(":memory:", "");
+	p3HistoryStore scanStore(":memory:", "", false);
+	fill(ftsStore);
+	fill(scanStore);
+
+	// text index and full scan must find the same messages
+	const char *queries[] = { "hello", "HELLO world", "wor", "100%", "\"quoted\"", "it's", "under_score", "nothing" };
+
+	for(const char *query: queries)
+	{
+		std::list<HistoryMsg> fts, scan;
+		ASSERT_TRUE(ftsStore.searchMessages(NULL, query, 0, fts)) << query;
+		ASSERT_TRUE(scanStore.searchMessages(NULL, query, 0, scan)) << query;
+		EXPECT_EQ(ids(scan), ids(fts)) << query;
+	}
+
+	std::list<HistoryMsg> msgs;
+	ASSERT_TRUE(ftsStore.searchMessages(NULL, "hello world", 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 5, 10, 15, 20 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(ftsStore.searchMessages(&chatA, "hello", 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 5, 9, 15, 19 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(scanStore.searchMessages(&chatA, "hello", 1, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 19 }), ids(msgs));
+
+	EXPECT_FALSE(ftsStore.searchMessages(NULL, "  ", 0, msgs));
+}
+
+TEST(libretroshare_pqi, HistoryStorePruning)
+{
+	for(bool useFts: { true, false })
+	{
+		p3HistoryStore store(":memory:", "", useFts);
+		fill(store);
+
+		std::list<uint32_t> removed;
+		ASSERT_TRUE(store.removeMessages({ 1, 2, 42 }, removed));
+		EXPECT_EQ(std::list<uint32_t>({ 1, 2 }), removed);
+
+		// keeps the 3 latest messages of chat A
+		ASSERT_TRUE(store.pruneChat(chatA, 3));
+
+		std::list<HistoryMsg> msgs;
+		ASSERT_TRUE(store.getMessages(chatA, 0, 0, msgs));
+		EXPECT_EQ(std::vector<uint32_t>({ 15, 17, 19 }), ids(msgs));
+
+		// nothing to do when the chat is small enough
+		ASSERT_TRUE(store.pruneChat(chatA, 10));
+		msgs.clear();
+		ASSERT_TRUE(store.getMessages(chatA, 0, 0, msgs));
+		EXPECT_EQ(3u, msgs.size());
+
+		ASSERT_TRUE(store.pruneOlderThan(1160));
+		msgs.clear();
+		ASSERT_TRUE(store.getMessages(chatB, 0, 0, msgs));
+		EXPECT_EQ(std::vector<uint32_t>({ 16, 18, 20 }), ids(msgs));
+
+		// removed messages are not found anymore
+		msgs.clear();
+		ASSERT_TRUE(store.searchMessages(NULL, "hello", 0, msgs));
+		EXPECT_EQ(std::vector<uint32_t>({ 19, 20 }), ids(msgs));
+
+		ASSERT_TRUE(store.clear(chatB));
+		msgs.clear();
+		ASSERT_TRUE(store.getMessages(chatB, 0, 0, msgs));
+		EXPECT_TRUE(msgs.empty());
+	}
+}
+
+/* Messages of the old configuration file are moved to the store in one batch,
+ * possibly after messages with higher ids were added. */
+TEST(libretroshare_pqi, HistoryStoreLegacyMigration)
+{
+	p3HistoryStore store(":memory:", "");
+
+	addMessage(store, 10, chatA, 2000, "new message");
+	addMessage(store, 11, chatB, 2010, "new message");
+
+	std::list<RsHistoryMsgItem*> legacy;
+	legacy.push_back(makeItem(3, chatA, 1030, "old message"));
+	legacy.push_back(makeItem(1, chatA, 1010, "old message"));
+	legacy.push_back(makeItem(2, chatB, 1020, "old message"));
+
+	EXPECT_FALSE(store.legacyMessagesImported());
+	EXPECT_TRUE(store.importLegacyMessages(legacy));
+	EXPECT_TRUE(store.legacyMessagesImported());
+
+	// a second import, as after an exit before the configuration file was
+	// saved again, is refused as a whole
+	EXPECT_FALSE(store.importLegacyMessages(legacy));
+
+	for(RsHistoryMsgItem *item: legacy)
+		delete item;
+
+	EXPECT_EQ(11u, store.lastMsgId());
+
+	std::list<HistoryMsg> msgs;
+	ASSERT_TRUE(store.getMessages(chatA, 0, 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 1, 3, 10 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.searchMessages(NULL, "message", 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 1, 2, 3, 10, 11 }), ids(msgs));
+
+	msgs.clear();
+	ASSERT_TRUE(store.searchMessages(NULL, "old", 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 1, 2, 3 }), ids(msgs));
+
+	// the text index follows removed messages, even when their id is used again
+	std::list<uint32_t> removed;
+	ASSERT_TRUE(store.removeMessages({ 10, 11 }, removed));
+	addMessage(store, 10, chatA, 2020, "other text");
+
+	msgs.clear();
+	ASSERT_TRUE(store.searchMessages(NULL, "new", 0, msgs));
+	EXPECT_TRUE(msgs.empty());
+
+	msgs.clear();
+	ASSERT_TRUE(store.searchMessages(NULL, "other", 0, msgs));
+	EXPECT_EQ(std::vector<uint32_t>({ 10 }), ids(msgs));
+}
+
+TEST(libretroshare_pqi, HistoryStoreLegacyMigrationKept)
+{
+	const std::string dbPath = "p3historystore_test.db";
+	remove(dbPath.c_str());
+
+	{
+		p3HistoryStore store(dbPath, "");
+
+		std::list<RsHistoryMsgItem*> legacy;
+		legacy.push_back(makeItem(1, chatA, 1010, "old message"));
+
+		EXPECT_TRUE(store.importLegacyMessages(legacy));
+
+		for(RsHistoryMsgItem *item: legacy)
+			delete item;
+	}
+
+	{
+		p3HistoryStore store(dbPath, "");
+		EXPECT_TRUE(store.legacyMessagesImported());
+
+		std::list<HistoryMsg> msgs;
+		ASSERT_TRUE(store.getMessages(chatA, 0, 0, msgs));
+		EXPECT_EQ(std::vector<uint32_t>({ 1 }), ids(msgs));
+	}
+
+	remove(dbPath.c_str());
+}
@@ -0,0 +1,238 @@
+/*******************************************************************************
+ * unittests/libretroshare/pqi/pqibwscheduler_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "pqi/pqibwscheduler.h"
+#include "rsitems/rsserviceids.h"
+#include "serialiser/rsbaseserial.h"
+
+static const RsServiceBandwidthClass INTERACTIVE = RsServiceBandwidthClass::INTERACTIVE;
+static const RsServiceBandwidthClass SYNC        = RsServiceBandwidthClass::SYNC;
+static const RsServiceBandwidthClass BULK        = RsServiceBandwidthClass::BULK;
+static const RsServiceBandwidthClass OTHER       = RsServiceBandwidthClass::OTHER;
+
+static const double RATE = 100000.0;	// bytes/sec
+
+class TestBwScheduler: public pqiBwScheduler
+{
+public:
+	TestBwScheduler() : pqiBwScheduler(10,2.0f)
+	{
+		// weights are process-wide, other tests may have changed them
+
+		pqiBwClasses::setWeight(INTERACTIVE,25);
+		pqiBwClasses::setWeight(SYNC,25);
+		pqiBwClasses::setWeight(BULK,40);
+		pqiBwClasses::setWeight(OTHER,10);
+	}
+
+	using pqiBwScheduler::refill;
+	using pqiBwScheduler::selectClass;
+
+	double& tokens(RsServiceBandwidthClass c) { return _classes[uint32_t(c)].tokens; }
+	uint64_t queued(RsServiceBandwidthClass c) const { return _classes[uint32_t(c)].queue.qos_queue_size(); }
+};
+
+static void queueItem(pqiBwScheduler& s,RsServiceType service,uint32_t size = 1000)
+{
+	uint8_t *data = (uint8_t*)malloc(size);
+	uint32_t offset = 0;
+
+	memset(data,0,size);
+	setRawUInt32(data,size,&offset,(2u << 24) | (uint32_t(service) << 8));
+	setRawUInt32(data,size,&offset,size);
+
+	s.in_rsItem(data,size,1);
+}
+
+// Pops a whole item from a connection that is not bandwidth limited, and returns its class.
+
+static RsServiceBandwidthClass popItem(pqiBwScheduler& s)
+{
+	BinSlice slice;
+	bool starts,ends;
+	uint32_t packet_id;
+
+	EXPECT_TRUE(s.out_rsItem(0.0,1 << 20,slice,starts,ends,packet_id));
+	EXPECT_TRUE(starts && ends);
+
+	uint32_t type = 0;
+	uint32_t offset = 0;
+	getRawUInt32(const_cast<uint8_t*>(slice.data()),slice.size,&offset,&type);
+
+	return pqiBwScheduler::serviceClass((type >> 8) & 0xffff);
+}
+
+TEST(libretroshare_pqi, BwSchedulerServiceClasses)
+{
+	EXPECT_EQ(INTERACTIVE,pqiBwScheduler::serviceClass(uint16_t(RsServiceType::CHAT)));
+	EXPECT_EQ(INTERACTIVE,pqiBwScheduler::serviceClass(uint16_t(RsServiceType::HEARTBEAT)));
+	EXPECT_EQ(INTERACTIVE,pqiBwScheduler::serviceClass(uint16_t(RsServiceType::RTT)));
+	EXPECT_EQ(SYNC,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::MSG)));
+	EXPECT_EQ(SYNC,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::FILE_DATABASE)));
+	EXPECT_EQ(SYNC,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::GXS_TRANS)));
+	EXPECT_EQ(SYNC,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::FORUMS)));
+	EXPECT_EQ(SYNC,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::GXSID)));
+	EXPECT_EQ(BULK,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::FILE_TRANSFER)));
+	EXPECT_EQ(BULK,       pqiBwScheduler::serviceClass(uint16_t(RsServiceType::TURTLE)));
+	EXPECT_EQ(OTHER,      pqiBwScheduler::serviceClass(uint16_t(RsServiceType::PLUGIN_FEEDREADER)));
+	EXPECT_EQ(OTHER,      pqiBwScheduler::serviceClass(uint16_t(RsServiceType::FORUMS_CONFIG)));
+
+	// Items are queued in the class of the service found in their header
+
+	TestBwScheduler s;
+
+	queueItem(s,RsServiceType::CHAT);
+	queueItem(s,RsServiceType::CHANNELS);
+	queueItem(s,RsServiceType::CHANNELS);
+	queueItem(s,RsServiceType::TURTLE);
+
+	EXPECT_EQ(4u,s.qos_queue_size());
+	EXPECT_EQ(1u,s.queued(INTERACTIVE));
+	EXPECT_EQ(2u,s.queued(SYNC));
+	EXPECT_EQ(1u,s.queued(BULK));
+	EXPECT_EQ(0u,s.queued(OTHER));
+}
+
+TEST(libretroshare_pqi, BwSchedulerRefillAndBurstCap)
+{
+	TestBwScheduler s;
+
+	// 10ms of a 100kB/s connection, shared as 25/25/40/10
+
+	s.refill(RATE,0.01);
+
+	EXPECT_DOUBLE_EQ(250.0,s.tokens(INTERACTIVE));
+	EXPECT_DOUBLE_EQ(250.0,s.tokens(SYNC));
+	EXPECT_DOUBLE_EQ(400.0,s.tokens(BULK));
+	EXPECT_DOUBLE_EQ(100.0,s.tokens(OTHER));
+
+	// Idle classes keep at most 200ms of their rate, and never less than 4kB
+
+	s.refill(RATE,1.0);
+
+	EXPECT_DOUBLE_EQ(5000.0,s.tokens(INTERACTIVE));
+	EXPECT_DOUBLE_EQ(5000.0,s.tokens(SYNC));
+	EXPECT_DOUBLE_EQ(8000.0,s.tokens(BULK));
+	EXPECT_DOUBLE_EQ(4096.0,s.tokens(OTHER));
+
+	// Debts are paid back at the class rate
+
+	s.tokens(BULK) = -1000.0;
+	s.refill(RATE,0.02);
+
+	EXPECT_DOUBLE_EQ(-200.0,s.tokens(BULK));
+	EXPECT_DOUBLE_EQ(5000.0,s.tokens(INTERACTIVE));
+
+	// Weights are taken into account right away
+
+	pqiBwClasses::setWeight(OTHER,110);
+	s.tokens(OTHER) = 0.0;
+	s.refill(RATE,0.01);
+
+	EXPECT_DOUBLE_EQ(550.0,s.tokens(OTHER));
+
+	// Unlimited connections do not refill
+
+	s.tokens(OTHER) = 0.0;
+	s.refill(0.0,1.0);
+
+	EXPECT_DOUBLE_EQ(0.0,s.tokens(OTHER));
+}
+
+TEST(libretroshare_pqi, BwSchedulerSelectClass)
+{
+	TestBwScheduler s;
+
+	EXPECT_EQ(-1,s.selectClass());
+
+	queueItem(s,RsServiceType::TURTLE);
+	queueItem(s,RsServiceType::PLUGIN_FEEDREADER);
+	queueItem(s,RsServiceType::CHAT);
+
+	// Classes with tokens are served in class order
+
+	EXPECT_EQ(int(INTERACTIVE),s.selectClass());
+
+	s.tokens(INTERACTIVE) = -100.0;
+	EXPECT_EQ(int(BULK),s.selectClass());
+
+	s.tokens(BULK) = -1.0;
+	EXPECT_EQ(int(OTHER),s.selectClass());
+
+	// When all backlogged classes are in debt, they are lent tokens in proportion to their weight, so that the least
+	// indebted one per weight unit is selected. The idle class loses its debt.
+
+	s.tokens(INTERACTIVE) = -100.0;	// 4 per weight unit
+	s.tokens(BULK) = -800.0;		// 20 per weight unit
+	s.tokens(OTHER) = -100.0;		// 10 per weight unit
+	s.tokens(SYNC) = -50.0;
+
+	EXPECT_EQ(int(INTERACTIVE),s.selectClass());
+
+	EXPECT_DOUBLE_EQ(0.0,s.tokens(INTERACTIVE));
+	EXPECT_DOUBLE_EQ(-800.0 + 4*40,s.tokens(BULK));
+	EXPECT_DOUBLE_EQ(-100.0 + 4*10,s.tokens(OTHER));
+	EXPECT_DOUBLE_EQ(0.0,s.tokens(SYNC));
+}
+
+TEST(libretroshare_pqi, BwSchedulerNoStarvation)
+{
+	TestBwScheduler s;
+
+	for(uint32_t i=0;i<200;++i)
+	{
+		queueItem(s,RsServiceType::CHAT);
+		queueItem(s,RsServiceType::TURTLE);
+		queueItem(s,RsServiceType::PLUGIN_FEEDREADER);
+	}
+
+	// Interactive traffic goes first, but as soon as it is in debt the other classes get their share, in proportion
+	// to their weight: 25/40/10 of the 750 items sent.
+
+	EXPECT_EQ(INTERACTIVE,popItem(s));
+
+	uint32_t sent[pqiBwScheduler::NB_CLASSES] = { 1, 0, 0, 0 };
+	uint32_t first_other = 0;
+
+	for(uint32_t i=1;i<150;++i)
+	{
+		RsServiceBandwidthClass c = popItem(s);
+
+		if(c == OTHER && first_other == 0)
+			first_other = i;
+
+		++sent[uint32_t(c)];
+	}
+
+	EXPECT_GT(first_other,0u);
+	EXPECT_LT(first_other,10u);
+	EXPECT_EQ(0u,sent[uint32_t(SYNC)]);
+	EXPECT_NEAR(50,sent[uint32_t(INTERACTIVE)],2);
+	EXPECT_NEAR(80,sent[uint32_t(BULK)],2);
+	EXPECT_NEAR(20,sent[uint32_t(OTHER)],2);
+
+	s.clear();
+	EXPECT_EQ(0u,s.qos_queue_size());
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * unittests/libretroshare/tcponudp/tcppacket_test.cc                          *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "tcponudp/tcppacket.h"
+
+TEST(libretroshare_tcponudp, TcpPacketSackRoundTrip)
+{
+	const char payload[] = "some data";
+
+	for(int n = 0; n <= TCP_MAX_SACK_BLOCKS; n++)
+	{
+		TcpPacket pkt((uint8 *) payload, sizeof(payload)); /* copies the data */
+		pkt.seqno = 1000 + n;
+		pkt.winsize = 500;
+		pkt.setAck(2000);
+		pkt.sackCount = n;
+
+		for(int i = 0; i < n; i++)
+		{
+			pkt.sackLeft[i] = 3000 + 100 * i;
+			pkt.sackRight[i] = 3050 + 100 * i;
+		}
+
+		uint8 buf[TCP_PSEUDO_HDR_SIZE + TCP_MAX_SACK_SIZE + sizeof(payload)];
+		int size = sizeof(buf);
+
+		ASSERT_EQ(TCP_PSEUDO_HDR_SIZE + TCP_SACK_HDR_SIZE(n) + (int) sizeof(payload), pkt.writePacket(buf, size));
+
+		TcpPacket read;
+		ASSERT_EQ(size, read.readPacket(buf, size));
+
+		EXPECT_EQ(pkt.seqno, read.seqno);
+		EXPECT_EQ(2000u, read.ackno);
+		EXPECT_TRUE(read.hasAck());
+		EXPECT_EQ(500, read.winsize);
+		ASSERT_EQ(n, read.sackCount);
+
+		for(int i = 0; i < n; i++)
+		{
+			EXPECT_EQ(pkt.sackLeft[i], read.sackLeft[i]);
+			EXPECT_EQ(pkt.sackRight[i], read.sackRight[i]);
+		}
+
+		ASSERT_EQ((int) sizeof(payload), read.datasize);
+		EXPECT_EQ(0, memcmp(payload, read.data, sizeof(payload)));
+	}
+}
+
+TEST(libretroshare_tcponudp, TcpPacketBadSackRejected)
+{
+	TcpPacket pkt;
+	pkt.sackCount = 2;
+	pkt.sackLeft[0] = pkt.sackLeft[1] = 1;
+	pkt.sackRight[0] = pkt.sackRight[1] = 2;
+
+	uint8 buf[TCP_PSEUDO_HDR_SIZE + TCP_MAX_SACK_SIZE];
+	int size = sizeof(buf);
+	ASSERT_LT(0, pkt.writePacket(buf, size));
+
+	TcpPacket read;
+
+	/* truncated blocks */
+	EXPECT_EQ(-1, read.readPacket(buf, size - 1));
+
+	/* more blocks than allowed */
+	buf[TCP_PSEUDO_HDR_SIZE] = TCP_MAX_SACK_BLOCKS + 1;
+	EXPECT_EQ(-1, read.readPacket(buf, size));
+}
+
+TEST(libretroshare_tcponudp, TcpPacketRingGrowsWithWrappedHead)
+{
+	std::vector<TcpPacket *> pkts;
+	for(int i = 0; i < 200; i++)
+	{
+		pkts.push_back(new TcpPacket());
+	}
+
+	TcpPacketRing ring;
+	uint32 next_in = 0;
+	uint32 next_out = 0;
+
+	/* move the head forward, so that the ring wraps before it is full */
+	for(; next_in < 40; next_in++)
+	{
+		ring.push_back(pkts[next_in]);
+	}
+	for(; next_out < 30; next_out++)
+	{
+		EXPECT_EQ(pkts[next_out], ring.pop_front());
+	}
+
+	/* fills the 64 initial slots across the wrap, then grows twice */
+	for(; next_in < 200; next_in++)
+	{
+		ring.push_back(pkts[next_in]);
+	}
+
+	ASSERT_EQ(200u - next_out, ring.size());
+	for(uint32 i = 0; i < ring.size(); i++)
+	{
+		EXPECT_EQ(pkts[next_out + i], ring[i]);
+	}
+
+	for(; next_out < 200; next_out++)
+	{
+		EXPECT_EQ(pkts[next_out], ring.front());
+		EXPECT_EQ(pkts[next_out], ring.pop_front());
+	}
+
+	EXPECT_TRUE(ring.empty());
+	EXPECT_TRUE(ring.pop_front() == NULL);
+
+	for(uint32 i = 0; i < pkts.size(); i++)
+	{
+		delete pkts[i];
+	}
+}
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsmpscring_test.cc                             *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "util/rsmpscring.h"
+
+TEST(libretroshare_util, MpscRingFifo)
+{
+	RsMpscRing<uint32_t> ring(5);
+
+	EXPECT_EQ(8u, ring.capacity());
+
+	uint32_t v = 0;
+	EXPECT_FALSE(ring.pop(v));
+
+	// several times around the ring, so that positions wrap over the cells
+
+	uint32_t next_in = 0, next_out = 0;
+
+	for(uint32_t round=0;round<10;++round)
+	{
+		for(uint32_t i=0;i<5;++i)
+			EXPECT_TRUE(ring.push(next_in++));
+
+		EXPECT_EQ(5u, ring.size());
+
+		for(uint32_t i=0;i<5;++i)
+		{
+			ASSERT_TRUE(ring.pop(v));
+			EXPECT_EQ(next_out++, v);
+		}
+		EXPECT_EQ(0u, ring.size());
+		EXPECT_FALSE(ring.pop(v));
+	}
+	EXPECT_EQ(0u, ring.overflows());
+}
+
+/* pqistreamer::SendItem() queues packets directly, after draining the ring,
+ * when the ring is full. Doing the same here must keep the order in which
+ * packets were pushed. */
+TEST(libretroshare_util, MpscRingOverflowFallback)
+{
+	RsMpscRing<uint32_t> ring(4);
+	std::list<uint32_t> queue;
+
+	for(uint32_t i=0;i<4;++i)
+		EXPECT_TRUE(ring.push(i));
+
+	EXPECT_FALSE(ring.push(4));
+	EXPECT_FALSE(ring.push(4));
+	EXPECT_EQ(2u, ring.overflows());
+	EXPECT_EQ(4u, ring.size());
+
+	uint32_t v;
+	while(ring.pop(v))
+		queue.push_back(v);
+	queue.push_back(4);
+
+	// room again once drained
+
+	for(uint32_t i=5;i<8;++i)
+		EXPECT_TRUE(ring.push(i));
+
+	while(ring.pop(v))
+		queue.push_back(v);
+
+	EXPECT_EQ(std::list<uint32_t>({ 0, 1, 2, 3, 4, 5, 6, 7 }), queue);
+}
+
+/* Producers push (producer, counter) pairs while a consumer pops. Every item
+ * arrives exactly once, and the items of each producer arrive in order. Full
+ * rings make producers retry, like SendItem() falls back to the slow path. */
+TEST(libretroshare_util, MpscRingMultiProducer)
+{
+	const uint32_t PRODUCERS = 4;
+	const uint32_t ITEMS = 20000;
+
+	RsMpscRing<uint64_t> ring(64);
+	std::atomic<uint32_t> done(0);
+	std::vector<std::thread> producers;
+
+	for(uint32_t p=0;p<PRODUCERS;++p)
+		producers.push_back(std::thread([&ring,&done,p,ITEMS]()
+		{
+			for(uint32_t i=0;i<ITEMS;++i)
+				while(!ring.push((uint64_t(p) << 32) | i))
+					std::this_thread::yield();
+
+			++done;
+		}));
+
+	std::vector<uint32_t> expected(PRODUCERS,0);
+	uint32_t received = 0;
+	uint64_t v;
+
+	while(received < PRODUCERS*ITEMS)
+	{
+		if(!ring.pop(v))
+		{
+			ASSERT_FALSE(done == PRODUCERS && ring.size() == 0) << "items were lost";
+			std::this_thread::yield();
+			continue;
+		}
+
+		uint32_t p = v >> 32;
+		uint32_t i = v & 0xffffffff;
+
+		ASSERT_LT(p, PRODUCERS);
+		ASSERT_EQ(expected[p], i);
+
+		++expected[p];
+		++received;
+	}
+
+	for(uint32_t p=0;p<PRODUCERS;++p)
+		producers[p].join();
+
+	EXPECT_FALSE(ring.pop(v));
+	EXPECT_EQ(0u, ring.size());
+}
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * unittests/libretroshare/util/rsperfstats_test.cc                            *
+ *                                                                             *
+ * Copyright (C) 2026  RetroShare Team <contact@retroshare.cc>                 *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify        *
+ * it under the terms of the GNU Affero General Public License as              *
+ * published by the Free Software Foundation, either version 3 of the          *
+ * License, or (at your option) any later version.                             *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful,             *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                *
+ * GNU Lesser General Public License for more details.                         *
+ *                                                                             *
+ * You should have received a copy of the GNU Lesser General Public License    *
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.       *
+ *                                                                             *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "util/rsperfstats.h"
+
+static const uint32_t SUB_BUCKETS = RsPerfCounter::SUB_BUCKETS;
+static const uint32_t NB_BUCKETS = RsPerfCounter::NB_BUCKETS;
+
+TEST(libretroshare_util, PerfCounterBucketEdges)
+{
+	// Small values have their own bucket
+
+	for(uint32_t v=0;v<SUB_BUCKETS;++v)
+	{
+		EXPECT_EQ(v,RsPerfCounter::bucketIndex(v));
+		EXPECT_EQ(v,RsPerfCounter::bucketLowestValue(v));
+		EXPECT_EQ(v,RsPerfCounter::bucketHighestValue(v));
+	}
+
+	// Then each power of two is split in SUB_BUCKETS buckets
+
+	EXPECT_EQ(16u,RsPerfCounter::bucketIndex(16));
+	EXPECT_EQ(31u,RsPerfCounter::bucketIndex(31));
+	EXPECT_EQ(32u,RsPerfCounter::bucketIndex(32));
+	EXPECT_EQ(32u,RsPerfCounter::bucketIndex(33));
+	EXPECT_EQ(33u,RsPerfCounter::bucketIndex(34));
+	EXPECT_EQ(32u,RsPerfCounter::bucketLowestValue(32));
+	EXPECT_EQ(33u,RsPerfCounter::bucketHighestValue(32));
+	EXPECT_EQ(47u,RsPerfCounter::bucketIndex(63));
+	EXPECT_EQ(48u,RsPerfCounter::bucketIndex(64));
+	EXPECT_EQ(67u,RsPerfCounter::bucketHighestValue(48));
+
+	// Buckets are contiguous, each bound falls in its own bucket, and the width is at most 1/16th of the values.
+
+	for(uint32_t i=SUB_BUCKETS;i+1<NB_BUCKETS;++i)
+	{
+		uint64_t low = RsPerfCounter::bucketLowestValue(i);
+		uint64_t high = RsPerfCounter::bucketHighestValue(i);
+
+		ASSERT_EQ(i,RsPerfCounter::bucketIndex(low));
+		ASSERT_EQ(i,RsPerfCounter::bucketIndex(high));
+		ASSERT_EQ(high+1,RsPerfCounter::bucketLowestValue(i+1));
+		ASSERT_LE((high-low+1)*SUB_BUCKETS,low);
+	}
+
+	// Anything too large ends up in the last bucket
+
+	EXPECT_EQ(NB_BUCKETS-1,RsPerfCounter::bucketIndex(uint64_t(1) << 50));
+	EXPECT_EQ(NB_BUCKETS-1,RsPerfCounter::bucketIndex(~uint64_t(0)));
+}
+
+TEST(libretroshare_util, PerfCounterUniformPercentiles)
+{
+	RsPerfCounter counter("test/uniform");
+
+	for(uint64_t v=1;v<=1000;++v)
+		counter.record(v);
+
+	RsPerfCounterStats stats;
+	counter.getStats(stats);
+
+	EXPECT_EQ(1000u,stats.count);
+	EXPECT_EQ(500500u,stats.totalUs);
+	EXPECT_EQ(1000u,stats.maxUs);
+
+	// Exact percentiles are 500, 900, 990 and 999. Each is reported as the highest value of its bucket,
+	// capped to the max.
+
+	EXPECT_EQ(511u,stats.p50Us);	// [496,511]
+	EXPECT_EQ(927u,stats.p90Us);	// [896,927]
+	EXPECT_EQ(991u,stats.p99Us);	// [960,991]
+	EXPECT_EQ(1000u,stats.p999Us);	// [992,1023]
+
+	const uint64_t exact[4] = { 500, 900, 990, 999 };
+	const uint64_t reported[4] = { stats.p50Us, stats.p90Us, stats.p99Us, stats.p999Us };
+
+	for(uint32_t i=0;i<4;++i)
+	{
+		EXPECT_GE(reported[i],exact[i]);
+		EXPECT_LE(reported[i]-exact[i],exact[i]/SUB_BUCKETS);
+	}
+}
+
+TEST(libretroshare_util, PerfCounterSkewedPercentiles)
+{
+	RsPerfCounter counter("test/skewed");
+
+	for(uint32_t i=0;i<990;++i)
+		counter.record(10);
+	for(uint32_t i=0;i<10;++i)
+		counter.record(100000);
+
+	RsPerfCounterStats stats;
+	counter.getStats(stats);
+
+	EXPECT_EQ(1000u,stats.count);
+	EXPECT_EQ(990u*10 + 10u*100000,stats.totalUs);
+	EXPECT_EQ(100000u,stats.maxUs);
+
+	// The 990th sample is still 10, the 999th is in the [98304,102399] bucket, capped to the max.
+
+	EXPECT_EQ(10u,stats.p50Us);
+	EXPECT_EQ(10u,stats.p90Us);
+	EXPECT_EQ(10u,stats.p99Us);
+	EXPECT_EQ(100000u,stats.p999Us);
+
+	counter.reset();
+	counter.getStats(stats);
+
+	EXPECT_EQ(0u,stats.count);
+	EXPECT_EQ(0u,stats.totalUs);
+	EXPECT_EQ(0u,stats.maxUs);
+	EXPECT_EQ(0u,stats.p50Us);
+	EXPECT_EQ(0u,stats.p999Us);
+}
@@ -344,7 +344,8 @@ SOURCES +=  libretroshare/gxs/nxs_test/nxsdummyservices.cc \
 	libretroshare/gxs/nxs_test/rsgxsnetservice_test.cc \
 	libretroshare/gxs/nxs_test/nxsmsgsync_test.cc \
 	libretroshare/gxs/nxs_test/nxsgrpsync_test.cc \ 
-	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc
+	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc \
+	libretroshare/gxs/nxs_test/rsgxsmsgsketch_test.cc
 	
 HEADERS += libretroshare/gxs/gen_exchange/genexchangetester.h \
 	libretroshare/gxs/gen_exchange/gxspublishmsgtest.h \
@@ -362,6 +363,7 @@ SOURCES += libretroshare/gxs/gen_exchange/gxspublishgrouptest.cc \
 	libretroshare/gxs/gen_exchange/rsgenexchange_test.cc \
 	libretroshare/gxs/gen_exchange/genexchangetester.cc \
 	libretroshare/gxs/gen_exchange/genexchangetestservice.cc \
+	libretroshare/gxs/gen_exchange/gxsrequestpool_test.cc \
 
 SOURCES += libretroshare/gxs/security/gxssecurity_test.cc
 
@@ -371,6 +373,7 @@ HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
 
 SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 	libretroshare/gxs/data_service/rsgxsdata_test.cc \
+	libretroshare/gxs/data_service/rsgxsmsgmetaquery_test.cc \
 
 
 ################################ dbase #####################################
@@ -388,6 +391,34 @@ SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 
 SOURCES += libretroshare/services/status/status_test.cc \
 
+################################### ft #####################################
+
+SOURCES += libretroshare/ft/ftchunkbitset_test.cc \
+	libretroshare/ft/ftchunkverifier_test.cc \
+
+############################# file_sharing #################################
+
+SOURCES += libretroshare/file_sharing/dir_sync_delta_test.cc \
+	libretroshare/file_sharing/filelist_items_test.cc \
+	libretroshare/file_sharing/filename_index_test.cc \
+	libretroshare/file_sharing/hash_cache_test.cc \
+	libretroshare/file_sharing/mapped_hierarchy_test.cc \
+
+############################### tcponudp ###################################
+
+SOURCES += libretroshare/tcponudp/tcppacket_test.cc \
+
+################################## pqi #####################################
+
+SOURCES += libretroshare/pqi/p3cfgjournal_test.cc \
+	libretroshare/pqi/p3historystore_test.cc \
+	libretroshare/pqi/pqibwscheduler_test.cc \
+
+################################## util ####################################
+
+SOURCES += libretroshare/util/rsmpscring_test.cc \
+	libretroshare/util/rsperfstats_test.cc \
+
 ############################### gxs ########################################
 
 HEADERS += libretroshare/services/gxs/rsgxstestitems.h \